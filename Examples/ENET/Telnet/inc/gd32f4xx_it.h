@@ -54,7 +54,7 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 /* this function handles PendSV exception */
 void PendSV_Handler(void);
-/* this function handles SysTick exception */
-void SysTick_Handler(void);
+/* this function handles TIMER1 interrupt request */
+void TIMER1_IRQHandler(void);
 
 #endif /* GD32F4XX_IT_H */
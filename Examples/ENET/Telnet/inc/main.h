@@ -41,7 +41,7 @@ OF SUCH DAMAGE.
 
 //#define USE_DHCP       1 /* enable DHCP, if disabled static address is used */
 
-//#define USE_ENET_INTERRUPT
+#define USE_ENET_INTERRUPT
 //#define TIMEOUT_CHECK_USE_LWIP
 /* MAC address: BOARD_MAC_ADDR0:BOARD_MAC_ADDR1:BOARD_MAC_ADDR2:BOARD_MAC_ADDR3:BOARD_MAC_ADDR4:BOARD_MAC_ADDR5 */
 #define BOARD_MAC_ADDR0   0x20
@@ -42,7 +42,7 @@ void lwip_dhcp_address_get(void);
 
 void lwip_stack_init(void);
 void lwip_frame_recv(void);
-void lwip_timeouts_check(__IO uint32_t localtime);
+uint32_t lwip_timeouts_check(__IO uint32_t localtime);
 void lwip_netif_status_callback(struct netif *netif);
 
 #endif /* NETCONF_H */
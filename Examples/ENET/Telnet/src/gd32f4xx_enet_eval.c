@@ -35,6 +35,7 @@ OF SUCH DAMAGE.
 #include "gd32f4xx_enet.h"
 #include "gd32f4xx_enet_eval.h"
 #include "main.h"
+#include "timebase.h"
 
 const uint8_t gd32_str[] = {"\r\n ############ Welcome GigaDevice ############\r\n"};
 static __IO uint32_t enet_init_status = 0;
@@ -52,7 +53,6 @@ static void nvic_configuration(void);
 */
 void enet_system_setup(void)
 {
-    uint32_t ahb_frequency = 0;
 
 #ifdef USE_ENET_INTERRUPT
     nvic_configuration();
@@ -78,12 +78,9 @@ void enet_system_setup(void)
     enet_desc_select_enhanced_mode();
 #endif /* SELECT_DESCRIPTORS_ENHANCED_MODE */
 
-    /* configure systick clock source as HCLK */
-    systick_clksource_set(SYSTICK_CLKSOURCE_HCLK);
-
-    /* an interrupt every 10ms */
-    ahb_frequency = rcu_clock_freq_get(CK_AHB);
-    SysTick_Config(ahb_frequency / 100);
+    /* the free-running timebase replaces the 10ms systick */
+    timebase_config();
+    timebase_systick_disable();
 }
 
 /*!
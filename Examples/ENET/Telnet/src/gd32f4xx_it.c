@@ -35,9 +35,10 @@ OF SUCH DAMAGE.
 #include "gd32f4xx.h"
 #include "gd32f4xx_it.h"
 #include "main.h"
+#include "timebase.h"
+#include "scheduler.h"
 
-extern void lwip_frame_recv(void);
-extern void time_update(void);
+extern sched_task_struct enet_rx_task;
 
 /*!
     \brief      this function handles NMI exception
@@ -144,15 +145,15 @@ void PendSV_Handler(void)
 }
 
 /*!
-    \brief      this function handles SysTick exception
+    \brief      this function handles TIMER1 interrupt request
     \param[in]  none
     \param[out] none
     \retval     none
 */
-void SysTick_Handler(void)
+void TIMER1_IRQHandler(void)
 {
-    /* update the g_localtime by adding SYSTEMTICK_PERIOD_MS each SysTick interrupt */
-    time_update();
+    /* timebase overflow and compare wakeup */
+    timebase_irq_handler();
 }
 
 /*!
@@ -171,20 +172,11 @@ void SysTick_Handler(void)
 */
 void ENET_IRQHandler(void)
 {
-    uint32_t reval;
-
     /* clear the enet DMA Rx interrupt pending bits */
     enet_interrupt_flag_clear(ENET_DMA_INT_FLAG_RS_CLR);
     enet_interrupt_flag_clear(ENET_DMA_INT_FLAG_NI_CLR);
-    /* handles all the received frames */
-    do {
-        reval = enet_rxframe_size_get();
-
-        if(reval > 1) {
-            lwip_frame_recv();
-        }
-    } while(reval != 0);
-
 
+    /* the frames are handed to lwIP by the receive task */
+    sched_post(&enet_rx_task);
 }
 #endif /* USE_ENET_INTERRUPT */
@@ -33,57 +33,157 @@ OF SUCH DAMAGE.
 */
 
 #include "gd32f4xx.h"
+#include <stdio.h>
 #include "netconf.h"
 #include "main.h"
 #include "lwip/tcp.h"
 #include "lwip/timeouts.h"
+#include "netif/etharp.h"
 #include "gd32f450i_eval.h"
 #include "hello_gigadevice.h"
+#include "timebase.h"
+#include "scheduler.h"
 
 
 #define SYSTEMTICK_PERIOD_MS  10
+#define ENET_RX_POLL_PERIOD_US  1000U
+/* period of the timing report on EVAL_COM0 */
+#ifndef STATS_REPORT_PERIOD_US
+#define STATS_REPORT_PERIOD_US  10000000U
+#endif /* STATS_REPORT_PERIOD_US */
 
-__IO uint32_t g_localtime = 0; /* for creating a time reference incremented by 10ms */
-uint32_t g_timedelay;
+__IO uint32_t g_localtime = 0; /* time reference in ms, sampled from the timebase */
+
+sched_task_struct enet_rx_task;
+static sched_task_struct lwip_timer_task;
+static sched_task_struct stats_task;
+static sched_stats_struct stats_last;
+static uint32_t stats_last_time;
 
 /*!
-    \brief      main function
-    \param[in]  none
+    \brief      receive task, posted by the ENET interrupt or polled
+    \param[in]  arg: unused
     \param[out] none
     \retval     none
 */
-int main(void)
+static void enet_rx_handler(void *arg)
 {
-    gd_eval_com_init(EVAL_COM0);
-    gd_eval_key_init(KEY_TAMPER, KEY_MODE_EXTI);
-    /* setup ethernet system(GPIOs, clocks, MAC, DMA, systick) */
-    enet_system_setup();
+    uint32_t size;
 
-    /* initilaize the LwIP stack */
-    lwip_stack_init();
+    (void)arg;
+    time_update();
 
-    while(1) {
+    /* handles all the received frames */
+    do {
+        size = enet_rxframe_size_get();
 
-#ifndef USE_ENET_INTERRUPT
-        /* check if any packet received */
-        if(enet_rxframe_size_get()) {
-            /* process received ethernet packet */
+        if(size > 1) {
             lwip_frame_recv();
         }
+    } while(size != 0);
+
+#ifndef USE_ENET_INTERRUPT
+    sched_post_in(&enet_rx_task, ENET_RX_POLL_PERIOD_US);
 #endif /* USE_ENET_INTERRUPT */
+}
+
+/*!
+    \brief      lwIP timer task, reschedules itself for the next due timer
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void lwip_timer_handler(void *arg)
+{
+    uint32_t next_ms;
+
+    (void)arg;
+    time_update();
 
-        /* handle periodic timers for LwIP */
 #ifdef TIMEOUT_CHECK_USE_LWIP
-        sys_check_timeouts();
+    sys_check_timeouts();
 
 #ifdef USE_DHCP
-        lwip_dhcp_address_get();
+    lwip_dhcp_address_get();
 #endif /* USE_DHCP */
 
+    next_ms = sys_timeouts_sleeptime();
+    if(SYS_TIMEOUTS_SLEEPTIME_INFINITE == next_ms) {
+        next_ms = ARP_TMR_INTERVAL;
+    }
 #else
-        lwip_timeouts_check(g_localtime);
+    next_ms = lwip_timeouts_check(g_localtime);
 #endif /* TIMEOUT_CHECK_USE_LWIP */
+
+    /* at the millisecond the timer is due, a relative post would lose the part already elapsed */
+    sched_post_at(&lwip_timer_task, (g_localtime + next_ms) * 1000U);
+}
+
+/*!
+    \brief      report task, prints the wake latency and the idle share of the last period
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void stats_handler(void *arg)
+{
+    timebase_stats_struct wake;
+    sched_stats_struct sched;
+    uint32_t now = timebase_now_us();
+    uint32_t period = now - stats_last_time;
+    uint32_t idle = 0U;
+
+    (void)arg;
+    timebase_stats_get(&wake);
+    timebase_stats_reset();
+    sched_stats_get(&sched);
+
+    if(0U != period) {
+        idle = (uint32_t)((sched.idle_us - stats_last.idle_us) * 1000U / period);
     }
+    printf("\r\nwake: %lu, latency min %lu us, avg %lu us, max %lu us\r\n",
+           (unsigned long)wake.wakeups, (unsigned long)wake.latency_min,
+           (unsigned long)((0U != wake.wakeups) ? (wake.latency_sum / wake.wakeups) : 0U),
+           (unsigned long)wake.latency_max);
+    printf("sched: %lu runs, idle %lu.%lu%%\r\n",
+           (unsigned long)(sched.dispatches - stats_last.dispatches),
+           (unsigned long)(idle / 10U), (unsigned long)(idle % 10U));
+
+    stats_last = sched;
+    stats_last_time = now;
+    sched_post_in(&stats_task, STATS_REPORT_PERIOD_US);
+}
+
+/*!
+    \brief      main function
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+int main(void)
+{
+    gd_eval_com_init(EVAL_COM0);
+    gd_eval_key_init(KEY_TAMPER, KEY_MODE_EXTI);
+    /* setup ethernet system(GPIOs, clocks, MAC, DMA, timebase) */
+    enet_system_setup();
+
+    /* initilaize the LwIP stack */
+    lwip_stack_init();
+
+    /* packet reception and lwIP timers run as tasks, the core sleeps in between */
+    sched_init();
+    sched_task_init(&enet_rx_task, enet_rx_handler, NULL, 0U);
+    sched_task_init(&lwip_timer_task, lwip_timer_handler, NULL, 1U);
+    sched_post(&enet_rx_task);
+    sched_post(&lwip_timer_task);
+
+    /* the report blocks on the USART, it runs at the lowest priority */
+    sched_task_init(&stats_task, stats_handler, NULL, (uint8_t)(SCHED_PRIORITIES - 1U));
+    timebase_stats_reset();
+    stats_last_time = timebase_now_us();
+    sched_post_in(&stats_task, STATS_REPORT_PERIOD_US);
+
+    sched_run();
 }
 
 /*!
@@ -108,12 +208,9 @@ void lwip_netif_status_callback(struct netif *netif)
 */
 void delay_10ms(uint32_t ncount)
 {
-    /* capture the current local time */
-    g_timedelay = g_localtime + ncount;
-
-    /* wait until the desired delay finish */
-    while(g_timedelay > g_localtime) {
-    }
+    /* sleep on the timebase compare instead of spinning on g_localtime */
+    timebase_delay_ms(ncount * SYSTEMTICK_PERIOD_MS);
+    time_update();
 }
 
 /*!
@@ -124,7 +221,7 @@ void delay_10ms(uint32_t ncount)
 */
 void time_update(void)
 {
-    g_localtime += SYSTEMTICK_PERIOD_MS;
+    g_localtime = timebase_now_ms();
 }
 
 /* retarget the C library printf function to the USART */
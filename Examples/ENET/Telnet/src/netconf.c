@@ -45,6 +45,7 @@ OF SUCH DAMAGE.
 #include <stdio.h>
 #include "lwip/priv/tcp_priv.h"
 #include "lwip/timeouts.h"
+#include "timebase.h"
 
 #define DHCP_TRIES_MAX_TIMES        4
 
@@ -128,14 +129,33 @@ void lwip_frame_recv(void)
     ethernetif_input(&g_mynetif);
 }
 
+/*!
+    \brief      get the time until a periodic timer is due
+    \param[in]  curtime: the value of current time
+    \param[in]  lasttime: the time the timer ran last
+    \param[in]  interval: the period of the timer
+    \param[in]  next: the earliest due time found so far
+    \param[out] none
+    \retval     the earlier one of next and the due time of this timer
+*/
+static uint32_t lwip_timer_next(uint32_t curtime, uint32_t lasttime, uint32_t interval, uint32_t next)
+{
+    uint32_t elapsed = curtime - lasttime;
+    uint32_t remaining = (elapsed >= interval) ? 0U : (interval - elapsed);
+
+    return (remaining < next) ? remaining : next;
+}
+
 /*!
     \brief      call the time-related function periodicallytasks
     \param[in]  curtime: the value of current time
     \param[out] none
-    \retval     none
+    \retval     time in ms until the next timer is due
 */
-void lwip_timeouts_check(__IO uint32_t curtime)
+uint32_t lwip_timeouts_check(__IO uint32_t curtime)
 {
+    uint32_t next = ARP_TMR_INTERVAL;
+
 #if LWIP_TCP
     /* called periodically to dispatch TCP timers every 250 ms */
     if(curtime - tcpcurtime >= TCP_TMR_INTERVAL) {
@@ -176,6 +196,19 @@ if((curtime - acdcurtime) >= ACD_TMR_INTERVAL) {
 #endif /* LWIP_ACD */
 #endif /* USE_DHCP */
 
+#if LWIP_TCP
+    next = lwip_timer_next(curtime, tcpcurtime, TCP_TMR_INTERVAL, next);
+#endif /* LWIP_TCP */
+    next = lwip_timer_next(curtime, arpcurtime, ARP_TMR_INTERVAL, next);
+#ifdef USE_DHCP
+    next = lwip_timer_next(curtime, finecurtime, DHCP_FINE_TIMER_MSECS, next);
+    next = lwip_timer_next(curtime, coarsecurtime, DHCP_COARSE_TIMER_MSECS, next);
+#ifdef LWIP_ACD
+    next = lwip_timer_next(curtime, acdcurtime, ACD_TMR_INTERVAL, next);
+#endif /* LWIP_ACD */
+#endif /* USE_DHCP */
+
+    return next;
 }
 
 #ifdef USE_DHCP
@@ -233,6 +266,5 @@ void lwip_dhcp_address_get(void)
 
 unsigned long sys_now(void)
 {
-    extern volatile unsigned int g_localtime;
-    return g_localtime;
+    return timebase_now_ms();
 }
@@ -572,6 +572,69 @@ uint8_t nand_format(void)
     return NAND_OK;
 }
 
+/*!
+    \brief      erase a block
+    \param[in]  block: block number, 0 .. NAND_BLOCK_COUNT - 1
+    \param[out] none
+    \retval     NAND_OK, NAND_FAIL
+*/
+uint8_t nand_block_erase(uint32_t block)
+{
+    if(block >= NAND_BLOCK_COUNT) {
+        return NAND_FAIL;
+    }
+    if(NAND_READY != exmc_nand_eraseblock(block)) {
+        return NAND_FAIL;
+    }
+
+    return NAND_OK;
+}
+
+/*!
+    \brief      read the main area of a page
+    \param[in]  page: page number, block * NAND_BLOCK_SIZE + page in the block
+    \param[in]  pbuffer: pointer on the buffer of NAND_PAGE_SIZE bytes filling data to be read
+    \param[out] none
+    \retval     NAND_OK, NAND_FAIL
+*/
+uint8_t nand_page_read(uint32_t page, uint8_t *pbuffer)
+{
+    nand_address_struct address;
+
+    if(page >= NAND_BLOCK_COUNT * NAND_BLOCK_SIZE) {
+        return NAND_FAIL;
+    }
+    address.zone = 0;
+    address.block = page >> PAGE_BIT;
+    address.page = page & (NAND_BLOCK_SIZE - 1);
+    address.page_in_offset = 0;
+
+    return exmc_nand_readpage(pbuffer, address, NAND_PAGE_SIZE);
+}
+
+/*!
+    \brief      program the main area of an erased page, the pages of a block have to be
+                programmed in ascending order
+    \param[in]  page: page number, block * NAND_BLOCK_SIZE + page in the block
+    \param[in]  pbuffer: pointer on the buffer of NAND_PAGE_SIZE bytes containing data to be written
+    \param[out] none
+    \retval     NAND_OK, NAND_FAIL
+*/
+uint8_t nand_page_write(uint32_t page, uint8_t *pbuffer)
+{
+    nand_address_struct address;
+
+    if(page >= NAND_BLOCK_COUNT * NAND_BLOCK_SIZE) {
+        return NAND_FAIL;
+    }
+    address.zone = 0;
+    address.block = page >> PAGE_BIT;
+    address.page = page & (NAND_BLOCK_SIZE - 1);
+    address.page_in_offset = 0;
+
+    return exmc_nand_writepage(pbuffer, address, NAND_PAGE_SIZE);
+}
+
 /*!
     \brief      fill the buffer with specified value
     \param[in]  pbuffer: pointer on the buffer to fill
@@ -131,5 +131,11 @@ void fill_buffer_nand(uint8_t *pbuffer, uint16_t buffer_lenght, uint32_t value);
 uint8_t exmc_nand_readspare(uint8_t *pbuffer, nand_address_struct address, uint16_t bytecount);
 /* write the spare area information for the specified pages addresses */
 uint8_t exmc_nand_writespare(uint8_t *pbuffer, nand_address_struct address, uint16_t bytecount);
+/* erase a block */
+uint8_t nand_block_erase(uint32_t block);
+/* read the main area of a page */
+uint8_t nand_page_read(uint32_t page, uint8_t *pbuffer);
+/* program the main area of an erased page */
+uint8_t nand_page_write(uint32_t page, uint8_t *pbuffer);
 
 #endif /* EXMC_NANDFLASH_H */
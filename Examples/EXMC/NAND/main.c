@@ -36,8 +36,12 @@ OF SUCH DAMAGE.
 #include <stdio.h>
 #include "gd32f450i_eval.h"
 #include "exmc_nandflash.h"
+#include "ff_gen_drv.h"
+#include "nand_diskio.h"
+#include "disk_trim.h"
 
 #define BUFFER_SIZE                 (0x100U)
+#define FILE_CHUNKS                 (128U)
 #define NAND_GD_MAKERID             (0xC8U)
 #define NAND_HY_MAKERID             (0xADU)
 #define NAND_DEVICEID               (0xF1U)
@@ -49,6 +53,13 @@ uint32_t j = 0;
 uint32_t k = 0;
 uint32_t writereadaddr ;
 uint16_t zone, block, page, pageoffset;
+FATFS fs;
+FIL file;
+char nand_path[4];
+BYTE work[FF_MAX_SS];
+uint32_t filebuffer[1024];
+
+void fatfs_test(void);
 
 /*!
     \brief      main function
@@ -143,6 +154,9 @@ int main(void)
         for(k = 0; k < BUFFER_SIZE; k ++) {
             printf("0x%02X ", rxbuffer[k]);
         }
+
+        /* a file system on the whole flash, the data above is formatted away */
+        fatfs_test();
     } else {
         printf("\n\rread NAND ID failure!\n\r");
 
@@ -154,6 +168,75 @@ int main(void)
     while(1);
 }
 
+/*!
+    \brief      format the flash, write and delete a 512KB file and trim its blocks when idle
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fatfs_test(void)
+{
+    char name[16];
+    FRESULT res;
+    UINT bytes;
+    uint32_t i;
+    BYTE pdrv;
+    nand_diskio_stats_struct stats;
+    disk_trim_stats_struct trim_stats;
+
+    printf("\r\n\r\nFatFs test:");
+    if(0U != FATFS_LinkDriver(&NAND_Driver, nand_path)) {
+        printf("\r\nFatFs driver link fail!");
+        return;
+    }
+    pdrv = nand_path[0] - '0';
+
+    /* f_mkfs trims the whole volume, the driver knows every block is erased afterwards */
+    res = f_mkfs(nand_path, FM_FAT, 0, work, sizeof(work));
+    if(FR_OK == res) {
+        /* clusters the file operations release wait in the queue until the device is idle */
+        disk_trim_attach(pdrv);
+        res = f_mount(&fs, nand_path, 1);
+    }
+    sprintf(name, "%snand.bin", nand_path);
+    if(FR_OK == res) {
+        res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+    }
+    if(FR_OK == res) {
+        for(i = 0; i < sizeof(filebuffer) / sizeof(filebuffer[0]); i++) {
+            filebuffer[i] = i;
+        }
+        for(i = 0; (FR_OK == res) && (i < FILE_CHUNKS); i++) {
+            res = f_write(&file, filebuffer, sizeof(filebuffer), &bytes);
+        }
+        if(FR_OK == res) {
+            res = f_close(&file);
+        } else {
+            f_close(&file);
+        }
+    }
+    if(FR_OK == res) {
+        res = f_unlink(name);
+    }
+    if(FR_OK == res) {
+        /* idle time, the blocks of the deleted file are erased for the next one */
+        disk_trim_process(pdrv, 1U);
+    }
+
+    if(FR_OK != res) {
+        printf("\r\nFatFs file operation fail (%d)!", res);
+    } else {
+        nand_diskio_stats_get(&stats);
+        disk_trim_stats_get(pdrv, &trim_stats);
+        printf("\r\n## 512KB file written and deleted: %d blocks read, %d programmed, %d erased ##",
+               stats.loads, stats.programs, stats.erases);
+        printf("\r\n## trim: %d ranges released, %d commands, %d blocks erased or dropped ##",
+               trim_stats.requests, trim_stats.issued, stats.blocks_trimmed);
+    }
+    disk_trim_detach(pdrv);
+    f_mount(NULL, nand_path, 0);
+}
+
 /* retarget the C library printf function to the USART */
 int fputc(int ch, FILE *f)
 {
@@ -138,17 +138,3 @@ void PendSV_Handler(void)
     while(1) {
     }
 }
-
-/*!
-    \brief      this function handles external lines 10 to 15 interrupt request
-    \param[in]  none
-    \param[out] none
-    \retval     none
-*/
-void EXTI10_15_IRQHandler(void)
-{
-    if(RESET != exti_interrupt_flag_get(TAMPER_KEY_EXTI_LINE)) {
-        gd_eval_led_toggle(LED2);
-        exti_interrupt_flag_clear(TAMPER_KEY_EXTI_LINE);
-    }
-}
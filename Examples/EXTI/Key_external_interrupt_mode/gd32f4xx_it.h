@@ -54,7 +54,5 @@ void SVC_Handler(void);
 void DebugMon_Handler(void);
 /* PendSV handle function */
 void PendSV_Handler(void);
-/* EXTI4_15 handle function */
-void EXTI10_15_IRQHandler(void);
 
 #endif /* GD32F4XX_IT_H */
@@ -0,0 +1,55 @@
+/*!
+    \file    vectors.cpp
+    \brief   vector table of the example, the tamper key bound to its driver object
+
+    The EXTI10_15 vector points straight at tamper_key::on_interrupt() through the trampoline of
+    bind_member, the other entries keep the handlers of gd32f4xx_it.c and the weak defaults of
+    the startup code. The static_asserts check the generated table against the default one.
+*/
+
+#include <cstddef>
+#include <cstdint>
+
+#include "gd32f4xx_vectors.hpp"
+#include "gd32f450i_eval.h"
+
+namespace {
+	// the tamper key on EXTI line 13, every press toggles LED2
+	class tamper_key {
+	public:
+		auto on_interrupt() -> void {
+			if (RESET != exti_interrupt_flag_get(TAMPER_KEY_EXTI_LINE)) {
+				gd_eval_led_toggle(LED2);
+				++presses_;
+				exti_interrupt_flag_clear(TAMPER_KEY_EXTI_LINE);
+			}
+		}
+
+	private:
+		volatile std::uint32_t presses_ = 0;
+	};
+
+	tamper_key key;
+
+	using key_binding = gd32::vectors::bind_member<EXTI10_15_IRQn, key, &tamper_key::on_interrupt>;
+
+	constexpr auto table = gd32::vectors::make_table<key_binding>();
+
+	// every entry but the bound one is the default of the startup code
+	constexpr auto only_bound_slot_changed() -> bool {
+		for (std::size_t i = 0; i < gd32::vectors::handler_count; ++i) {
+			if (i != gd32::vectors::slot(EXTI10_15_IRQn) &&
+				table.handlers[i] != gd32::vectors::default_table.handlers[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static_assert(table.initial_sp == gd32::vectors::default_table.initial_sp);
+	static_assert(table.handlers[0] == &Reset_Handler);
+	static_assert(table.handlers[gd32::vectors::slot(EXTI10_15_IRQn)] == key_binding::handler);
+	static_assert(only_bound_slot_changed());
+}  // namespace
+
+GD32_VECTOR_TABLE(key_binding);
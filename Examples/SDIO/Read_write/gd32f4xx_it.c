@@ -34,6 +34,7 @@ OF SUCH DAMAGE.
 
 #include "gd32f4xx_it.h"
 #include "sdcard.h"
+#include "timebase.h"
 
 /*!
     \brief      this function handles NMI exception
@@ -149,3 +150,25 @@ void SDIO_IRQHandler(void)
 {
     sd_interrupts_process();
 }
+
+/*!
+    \brief      this function handles DMA1 channel3 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void DMA1_Channel3_IRQHandler(void)
+{
+    sd_dma_interrupts_process();
+}
+
+/*!
+    \brief      this function handles Timer1 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void TIMER1_IRQHandler(void)
+{
+    timebase_irq_handler();
+}
@@ -58,5 +58,9 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 /* this function handles SDIO interrupt request */
 void SDIO_IRQHandler(void);
+/* this function handles DMA1 channel3 interrupt request */
+void DMA1_Channel3_IRQHandler(void);
+/* this function handles Timer1 interrupt request */
+void TIMER1_IRQHandler(void);
 
 #endif /* GD32F4XX_IT_H */
@@ -0,0 +1,16 @@
+/*!
+    \file    gd32f4xx_libopt.h
+    \brief   library configuration of the host build, no peripheral driver is linked, the
+             headers give sdcard.c its definitions and sdio_model.c the functions it stands in for
+*/
+
+#ifndef GD32F4XX_LIBOPT_H
+#define GD32F4XX_LIBOPT_H
+
+#include <stddef.h>
+#include "gd32f4xx_rcu.h"
+#include "gd32f4xx_gpio.h"
+#include "gd32f4xx_dma.h"
+#include "gd32f4xx_sdio.h"
+
+#endif /* GD32F4XX_LIBOPT_H */
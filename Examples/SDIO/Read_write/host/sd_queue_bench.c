@@ -0,0 +1,571 @@
+/*!
+    \file    sd_queue_bench.c
+    \brief   the request queue of Examples/SDIO/Read_write/sdcard.c on a model of the SDIO, the
+             DMA and the card
+
+    sdcard.c is compiled into this file, so that the checks can look at the state of the queue
+    and set the card type and the bus clock step that sd_init() would find. Its library calls
+    go to sdio_model.c, the registers it reads directly and PRIMASK to the variables of the
+    model. The bench plays the interrupts and the main loop of the example: every
+    sdio_model_step() moves one DMA segment and runs the DMA and SDIO interrupts it raises,
+    when no data moves sd_queue_process() polls the programming card.
+
+    The checks run requests through sd_request_submit(), sd_queue_start(),
+    sd_queue_batch_issue(), sd_queue_transfer_end() and sd_queue_retry() and compare the
+    commands and data phases on the card with the expected ones: single blocks (CMD17,
+    CMD24), requests merged into one CMD18 or CMD25 with the DMA switching buffers at every
+    request, partial merges split by the direction, a gap or SD_QUEUE_MAX_BLOCKS, data errors
+    repeated at a lower clock, retries running out, a command the card does not answer,
+    requests submitted while a transfer moves data, from a completion callback and while the
+    card programs, and standard capacity cards. Every request has to complete once, in order,
+    with its data; the buffers are separated by guard blocks that no DMA may touch. The table
+    at the end counts the transfers and commands of 32 sequential requests of 8 blocks
+    submitted one by one and all at once.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sdio_model.h"
+
+/* sdcard.c reads these registers directly and masks the interrupts with PRIMASK */
+#undef SDIO_STAT
+#define SDIO_STAT                       sdio_model_stat
+#undef DMA_CHCTL
+#define DMA_CHCTL(dma, channel)         sdio_model_dma_chctl
+#define __get_PRIMASK()                 (sdio_model_primask)
+#define __set_PRIMASK(primask)          (sdio_model_primask = (primask))
+#define __disable_irq()                 (sdio_model_primask = 1U)
+
+#include "sdcard.c"
+
+#define DISK_BLOCKS                     1024U
+#define MEMORY_BLOCKS                   512U
+#define REQUESTS                        40U
+#define GUARD                           0xDEADBEEFU
+#define STREAM_REQUESTS                 32U
+#define STREAM_BLOCKS                   8U
+
+static uint32_t disk[DISK_BLOCKS * SDIO_MODEL_BLOCK_WORDS];
+static uint32_t memory[MEMORY_BLOCKS * SDIO_MODEL_BLOCK_WORDS];
+static uint8_t memory_used[MEMORY_BLOCKS];
+static uint32_t memory_next;
+static sd_request_struct requests[REQUESTS];
+static char done_order[REQUESTS + 1U];
+static uint32_t done_count;
+static uint32_t chain_end;                              /* the callback submits the next request up to this one */
+static uint8_t idle_in_callback;
+static int failures;
+
+/*!
+    \brief      report a failed check
+    \param[in]  ok: result of the check
+    \param[in]  what: description
+    \param[out] none
+    \retval     none
+*/
+static void expect(int ok, const char *what)
+{
+    if(!ok) {
+        printf("  %s\n", what);
+        failures++;
+    }
+}
+
+/*!
+    \brief      compare the log of the model
+    \param[in]  expected: tokens of the commands and data phases
+    \param[in]  what: description
+    \param[out] none
+    \retval     none
+*/
+static void expect_log(const char *expected, const char *what)
+{
+    if(0 != strcmp(sdio_model_log(), expected)) {
+        printf("  %s:\n    card    \"%s\"\n    expected \"%s\"\n", what, sdio_model_log(), expected);
+        failures++;
+    }
+}
+
+/*!
+    \brief      word of the disk image
+    \param[in]  block: block on the card
+    \param[in]  word: word of the block
+    \param[in]  seed: 0 for the content of a fresh card, another value for written data
+    \param[out] none
+    \retval     the word
+*/
+static uint32_t pattern(uint32_t block, uint32_t word, uint32_t seed)
+{
+    return (block << 16) ^ (word << 4) ^ (seed * 0x9E3779B9U);
+}
+
+/*!
+    \brief      insert a fresh card and reset the queue to the state sd_init() leaves in DMA mode
+    \param[in]  high_capacity: 1 for an SDHC card, 0 for a standard capacity card
+    \param[out] none
+    \retval     none
+*/
+static void card_insert(uint8_t high_capacity)
+{
+    uint32_t i;
+
+    for(i = 0U; i < DISK_BLOCKS * SDIO_MODEL_BLOCK_WORDS; i++) {
+        disk[i] = pattern(i / SDIO_MODEL_BLOCK_WORDS, i % SDIO_MODEL_BLOCK_WORDS, 0U);
+    }
+    for(i = 0U; i < MEMORY_BLOCKS * SDIO_MODEL_BLOCK_WORDS; i++) {
+        memory[i] = GUARD;
+    }
+    memset(memory_used, 0, sizeof(memory_used));
+    memory_next = 0U;
+    memset(requests, 0, sizeof(requests));
+    memset(done_order, 0, sizeof(done_order));
+    done_count = 0U;
+    chain_end = 0U;
+    idle_in_callback = 0U;
+
+    sdio_model_init(disk, DISK_BLOCKS, high_capacity, memory, MEMORY_BLOCKS * SDIO_MODEL_BLOCK_WORDS);
+    cardtype = high_capacity ? SDIO_HIGH_CAPACITY_SD_CARD : SDIO_STD_CAPACITY_SD_CARD_V2_0;
+    sd_rca = 1U;
+    transmode = SD_DMA_MODE;
+    memset(&queue_stats, 0, sizeof(queue_stats));
+    speed_stats.crc_errors = 0U;
+    speed_stats.timeouts = 0U;
+    speed_stats.retries = 0U;
+    speed_stats.fallbacks = 0U;
+    sd_clock_step_set(SD_CLK_STEP_TRANS);
+}
+
+/*!
+    \brief      completion callback of the requests, records the order and continues a chain
+    \param[in]  request: the completed request
+    \param[out] none
+    \retval     none
+*/
+static void request_done(sd_request_struct *request)
+{
+    uint32_t index = (uint32_t)(request - requests);
+
+    done_order[done_count++] = (char)('A' + index);
+    if(index + 1U < chain_end) {
+        idle_in_callback |= sd_queue_idle();
+        expect(SD_OK == sd_request_submit(&requests[index + 1U]), "submit from the completion callback");
+    }
+}
+
+/*!
+    \brief      set up a request on a buffer of its own, followed by a guard block
+    \param[in]  index: request, 'A' + index in the completion order
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[in]  block: first block on the card
+    \param[in]  count: blocks
+    \param[out] none
+    \retval     the request
+*/
+static sd_request_struct *request_make(uint32_t index, uint8_t direction, uint32_t block, uint32_t count)
+{
+    sd_request_struct *request = &requests[index];
+    uint32_t i;
+
+    if(memory_next + count + 1U > MEMORY_BLOCKS) {
+        expect(0, "memory of the bench exhausted");
+        memory_next = 0U;
+    }
+    request->buffer = &memory[memory_next * SDIO_MODEL_BLOCK_WORDS];
+    memset(&memory_used[memory_next], 1, count);
+    memory_next += count + 1U;
+
+    for(i = 0U; i < count * SDIO_MODEL_BLOCK_WORDS; i++) {
+        request->buffer[i] = (SD_REQUEST_WRITE == direction) ?
+                             pattern(block + i / SDIO_MODEL_BLOCK_WORDS, i % SDIO_MODEL_BLOCK_WORDS, index + 1U) : 0U;
+    }
+    request->block = block;
+    request->count = count;
+    request->direction = direction;
+    request->callback = request_done;
+    request->arg = NULL;
+    return request;
+}
+
+/*!
+    \brief      submit a request that has to be accepted
+    \param[in]  index: request
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[in]  block: first block on the card
+    \param[in]  count: blocks
+    \param[out] none
+    \retval     none
+*/
+static void submit(uint32_t index, uint8_t direction, uint32_t block, uint32_t count)
+{
+    expect(SD_OK == sd_request_submit(request_make(index, direction, block, count)), "submit of a valid request");
+    expect(0U == sdio_model_primask, "PRIMASK left set by sd_request_submit()");
+}
+
+/*!
+    \brief      move data and poll the programming card until the queue is idle
+    \param[in]  steps: DMA segments to move at most, 0 for all until the queue is idle
+    \param[out] none
+    \retval     none
+*/
+static void queue_run(uint32_t steps)
+{
+    uint32_t moved = 0U;
+    uint32_t polls = 0U;
+
+    while(!sd_queue_idle() && ((0U == steps) || (moved < steps))) {
+        if(sdio_model_step()) {
+            moved++;
+        } else if(SD_QUEUE_PROGRAMMING == queue_state) {
+            /* the main loop of the example */
+            sd_queue_process();
+            polls++;
+        } else {
+            expect(0, "the queue waits for an interrupt that never comes");
+            return;
+        }
+        expect(0U == sdio_model_primask, "PRIMASK left set by the queue");
+        if((moved > 100000U) || (polls > 100000U)) {
+            expect(0, "the queue does not finish");
+            return;
+        }
+    }
+}
+
+/*!
+    \brief      check the end of a test: requests done in order with their data, everything at rest
+    \param[in]  order: expected completion order, 'A' for request 0
+    \param[in]  what: name of the test
+    \param[out] none
+    \retval     none
+*/
+static void expect_end(const char *order, const char *what)
+{
+    sdio_model_stats_struct stats;
+    const sd_request_struct *request;
+    uint32_t i;
+    uint32_t n;
+
+    printf("%s\n", what);
+    expect(sd_queue_idle(), "queue idle at the end");
+    expect(sdio_model_rest(), "SDIO, DMA and card at rest at the end");
+    sdio_model_stats_get(&stats);
+    expect(0U == stats.violations, "no misuse of the SDIO, the DMA and the card");
+
+    if(0 != strcmp(done_order, order)) {
+        printf("  completion order \"%s\", expected \"%s\"\n", done_order, order);
+        failures++;
+    }
+
+    for(n = 0U; '\0' != order[n]; n++) {
+        request = &requests[order[n] - 'A'];
+        if((SD_OK != request->status) || !request->done) {
+            continue;
+        }
+        if(0 != memcmp(request->buffer, &disk[request->block * SDIO_MODEL_BLOCK_WORDS],
+                       request->count * SDIO_MODEL_BLOCK_WORDS * 4U)) {
+            printf("  data of request %c differs from the card\n", order[n]);
+            failures++;
+        }
+    }
+    for(i = 0U; i < MEMORY_BLOCKS * SDIO_MODEL_BLOCK_WORDS; i++) {
+        if(!memory_used[i / SDIO_MODEL_BLOCK_WORDS] && (GUARD != memory[i])) {
+            printf("  guard word %u overwritten\n", i);
+            failures++;
+            break;
+        }
+    }
+}
+
+/*!
+    \brief      a single block read and a single block write
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_single(void)
+{
+    card_insert(1U);
+    submit(0U, SD_REQUEST_READ, 5U, 1U);
+    expect_log("17@5", "an idle queue issues a request right away");
+    submit(1U, SD_REQUEST_WRITE, 6U, 1U);
+    queue_run(0U);
+    expect_log("17@5 d1 24@6 d1 13 13", "single blocks");
+    expect_end("AB", "single blocks");
+}
+
+/*!
+    \brief      requests that continue each other merged into one transfer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_merge(void)
+{
+    sd_queue_stats_struct queue;
+    sdio_model_stats_struct stats;
+
+    card_insert(1U);
+    submit(0U, SD_REQUEST_READ, 0U, 8U);
+    submit(1U, SD_REQUEST_READ, 8U, 8U);
+    submit(2U, SD_REQUEST_READ, 16U, 1U);
+    submit(3U, SD_REQUEST_READ, 17U, 15U);
+    /* A ends and B, C and D start as one transfer, E continues D but comes too late to join */
+    queue_run(1U);
+    expect_log("18@0 d8 12 18@8", "A alone, then B, C and D merged");
+    submit(4U, SD_REQUEST_READ, 32U, 8U);
+    queue_run(0U);
+    expect_log("18@0 d8 12 18@8 d24 12 18@32 d8 12", "merged reads");
+
+    sdio_model_log_clear();
+    submit(5U, SD_REQUEST_WRITE, 100U, 4U);
+    submit(6U, SD_REQUEST_WRITE, 104U, 4U);
+    submit(7U, SD_REQUEST_WRITE, 108U, 4U);
+    queue_run(0U);
+    expect_log("55 23 25@100 d4 12 13 13 55 23 25@104 d8 12 13 13", "merged writes");
+
+    sd_queue_stats_get(&queue);
+    sdio_model_stats_get(&stats);
+    expect((8U == queue.requests) && (5U == queue.transfers) && (3U == queue.merged) && (52U == queue.blocks),
+           "queue statistics of the merges");
+    expect(3U == stats.dma_switches, "DMA switched to the buffer of every merged request");
+    expect_end("ABCDEFGH", "merge");
+}
+
+/*!
+    \brief      merges split by a change of direction, a gap on the card and SD_QUEUE_MAX_BLOCKS
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_partial_merge(void)
+{
+    sd_queue_stats_struct queue;
+    sdio_model_stats_struct stats;
+
+    card_insert(1U);
+    submit(0U, SD_REQUEST_READ, 200U, 8U);
+    submit(1U, SD_REQUEST_READ, 208U, 8U);
+    submit(2U, SD_REQUEST_WRITE, 216U, 8U);
+    submit(3U, SD_REQUEST_WRITE, 224U, 8U);
+    submit(4U, SD_REQUEST_WRITE, 240U, 8U);
+    submit(5U, SD_REQUEST_WRITE, 248U, 4U);
+    submit(6U, SD_REQUEST_READ, 0U, 64U);
+    submit(7U, SD_REQUEST_READ, 64U, 64U);
+    submit(8U, SD_REQUEST_READ, 128U, 8U);
+    queue_run(0U);
+    expect_log("18@200 d8 12 18@208 d8 12 55 23 25@216 d16 12 13 13 55 23 25@240 d12 12 13 13 "
+               "18@0 d128 12 18@128 d8 12", "partial merges");
+
+    sd_queue_stats_get(&queue);
+    sdio_model_stats_get(&stats);
+    expect((6U == queue.transfers) && (3U == queue.merged), "queue statistics of the partial merges");
+    expect(3U == stats.dma_switches, "DMA switches of the partial merges");
+    expect_end("ABCDEFGHI", "partial merge");
+}
+
+/*!
+    \brief      data errors repeated at a lower clock, retries that run out and a command the card does not answer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_retry(void)
+{
+    sd_speed_stats_struct speed;
+    sd_queue_stats_struct queue;
+    sdio_model_stats_struct stats;
+
+    /* a CRC error in a merged read, repeated one clock step lower from the first buffer on */
+    card_insert(1U);
+    sd_clock_step_set(SD_CLK_STEP_HIGH_SPEED);
+    sdio_model_fail(SDIO_FLAG_DTCRCERR, 1U, 1U);
+    submit(0U, SD_REQUEST_READ, 290U, 1U);
+    submit(1U, SD_REQUEST_READ, 300U, 8U);
+    submit(2U, SD_REQUEST_READ, 308U, 8U);
+    queue_run(0U);
+    expect_log("17@290 d1 18@300 e 12 18@300 d16 12", "read repeated after a CRC error");
+    sd_speed_stats_get(&speed);
+    sdio_model_stats_get(&stats);
+    expect((1U == speed.crc_errors) && (1U == speed.retries) && (1U == speed.fallbacks), "speed statistics of a read retry");
+    expect((24000000U == speed.clock) && (24000000U == sdio_model_clock()), "clock one step lower after the CRC error");
+    expect(1U == stats.dma_switches, "the retry switched buffers again");
+    expect_end("ABC", "read retry");
+
+    /* two timeouts in a merged write, each repeated after the card programmed */
+    card_insert(1U);
+    sd_clock_step_set(SD_CLK_STEP_FAST);
+    sdio_model_fail(SDIO_FLAG_DTTMOUT, 1U, 2U);
+    submit(0U, SD_REQUEST_READ, 310U, 1U);
+    submit(1U, SD_REQUEST_WRITE, 320U, 8U);
+    submit(2U, SD_REQUEST_WRITE, 328U, 8U);
+    queue_run(0U);
+    expect_log("17@310 d1 55 23 25@320 e 12 13 13 55 23 25@320 e 12 13 13 55 23 25@320 d16 12 13 13",
+               "write repeated after two timeouts");
+    sd_speed_stats_get(&speed);
+    expect((2U == speed.timeouts) && (2U == speed.retries) && (1U == speed.fallbacks), "speed statistics of a write retry");
+    expect(12000000U == sdio_model_clock(), "clock at the lowest step after the timeouts");
+    expect_end("ABC", "write retry");
+
+    /* the retries run out, the error goes to all merged requests and the queue goes on */
+    card_insert(1U);
+    sdio_model_fail(SDIO_FLAG_DTCRCERR, 1U, 3U);
+    submit(0U, SD_REQUEST_READ, 340U, 1U);
+    submit(1U, SD_REQUEST_READ, 344U, 4U);
+    submit(2U, SD_REQUEST_READ, 348U, 4U);
+    submit(3U, SD_REQUEST_WRITE, 400U, 1U);
+    queue_run(0U);
+    expect_log("17@340 d1 18@344 e 12 18@344 e 12 18@344 e 12 24@400 d1 13 13", "retries run out");
+    sd_speed_stats_get(&speed);
+    sd_queue_stats_get(&queue);
+    expect((3U == speed.crc_errors) && (SD_TRANSFER_RETRIES == speed.retries) && (1U == queue.errors),
+           "statistics of the failed transfer");
+    expect((SD_DATA_CRC_ERROR == requests[1].status) && (SD_DATA_CRC_ERROR == requests[2].status) &&
+           (SD_OK == requests[3].status), "the error goes to the merged requests only");
+    expect_end("ABCD", "retries run out");
+
+    /* a read and a write command without response end their transfer without a retry */
+    card_insert(1U);
+    submit(0U, SD_REQUEST_READ, 450U, 1U);
+    sdio_model_reject(SD_CMD_READ_MULTIPLE_BLOCK);
+    submit(1U, SD_REQUEST_READ, 460U, 2U);
+    submit(2U, SD_REQUEST_READ, 470U, 1U);
+    queue_run(0U);
+    sdio_model_reject(SD_CMD_WRITE_MULTIPLE_BLOCK);
+    submit(3U, SD_REQUEST_WRITE, 480U, 2U);
+    queue_run(0U);
+    expect_log("17@450 d1 18@460! 17@470 d1 55 23 25@480!", "commands without response");
+    sd_speed_stats_get(&speed);
+    expect((SD_CMD_RESP_TIMEOUT == requests[1].status) && (SD_CMD_RESP_TIMEOUT == requests[3].status) &&
+           (0U == speed.retries), "command timeouts are not repeated");
+    expect_end("ABCD", "command timeout");
+}
+
+/*!
+    \brief      requests submitted while the queue is busy: during a data phase, from a completion
+                callback and while the card programs
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_submit_busy(void)
+{
+    char expected[256];
+    uint32_t len = 0U;
+    uint32_t i;
+    uint32_t *buffer;
+    sd_request_struct invalid;
+
+    /* each completion submits the next request, the queue never goes idle in between */
+    card_insert(1U);
+    chain_end = 6U;
+    for(i = 1U; i < chain_end; i++) {
+        request_make(i, SD_REQUEST_READ, 500U + 4U * i, 4U);
+    }
+    submit(0U, SD_REQUEST_READ, 500U, 4U);
+    queue_run(0U);
+    for(i = 0U; i < chain_end; i++) {
+        len += (uint32_t)snprintf(&expected[len], sizeof(expected) - len, "%s18@%u d4 12", (0U == i) ? "" : " ", 500U + 4U * i);
+    }
+    expect_log(expected, "requests submitted by the completion callback");
+    expect(!idle_in_callback, "queue busy while the callback submits");
+    expect_end("ABCDEF", "submit from the callback");
+
+    /* requests submitted while the card programs wait for the end of the write */
+    card_insert(1U);
+    submit(0U, SD_REQUEST_WRITE, 10U, 2U);
+    queue_run(1U);
+    expect(SD_QUEUE_PROGRAMMING == queue_state, "write waits for the card to program");
+    submit(1U, SD_REQUEST_READ, 12U, 2U);
+    submit(2U, SD_REQUEST_WRITE, 14U, 2U);
+    expect_log("55 23 25@10 d2 12", "no command while the card programs");
+    queue_run(0U);
+    expect_log("55 23 25@10 d2 12 13 13 18@12 d2 12 55 23 25@14 d2 12 13 13", "submit while programming");
+    expect_end("ABC", "submit while programming");
+
+    /* requests the queue refuses */
+    card_insert(1U);
+    buffer = request_make(0U, SD_REQUEST_READ, 0U, 1U)->buffer;
+    memset(&invalid, 0, sizeof(invalid));
+    invalid.buffer = buffer;
+    invalid.count = 1U;
+    invalid.direction = SD_REQUEST_READ;
+    expect(SD_OK == sd_request_submit(&invalid), "valid request");
+    queue_run(0U);
+    invalid.count = 0U;
+    expect(SD_PARAMETER_INVALID == sd_request_submit(&invalid), "request without blocks refused");
+    invalid.count = 1U;
+    invalid.buffer = (uint32_t *)((uint8_t *)buffer + 2U);
+    expect(SD_PARAMETER_INVALID == sd_request_submit(&invalid), "unaligned buffer refused");
+    invalid.buffer = buffer;
+    transmode = SD_POLLING_MODE;
+    expect(SD_OPERATION_IMPROPER == sd_request_submit(&invalid), "request in polling mode refused");
+    transmode = SD_DMA_MODE;
+    expect(sd_queue_idle(), "refused requests leave the queue idle");
+}
+
+/*!
+    \brief      a standard capacity card, byte addresses and CMD16 before every transfer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_standard_capacity(void)
+{
+    card_insert(0U);
+    submit(0U, SD_REQUEST_READ, 3U, 2U);
+    submit(1U, SD_REQUEST_WRITE, 5U, 1U);
+    queue_run(0U);
+    expect_log("16 18@1536 d2 12 16 24@2560 d1 13 13", "standard capacity card");
+    expect_end("AB", "standard capacity");
+}
+
+/*!
+    \brief      transfers and commands of sequential requests submitted one by one and all at once
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[in]  depth: requests submitted before the queue runs
+    \param[out] none
+    \retval     none
+*/
+static void stream(uint8_t direction, uint32_t depth)
+{
+    sd_queue_stats_struct queue;
+    sdio_model_stats_struct stats;
+    uint32_t i;
+
+    card_insert(1U);
+    for(i = 0U; i < STREAM_REQUESTS; i++) {
+        submit(i, direction, i * STREAM_BLOCKS, STREAM_BLOCKS);
+        if(0U == (i + 1U) % depth) {
+            queue_run(0U);
+        }
+    }
+    queue_run(0U);
+
+    sd_queue_stats_get(&queue);
+    sdio_model_stats_get(&stats);
+    expect((STREAM_REQUESTS == done_count) && (0U == stats.violations), "stream of requests");
+    printf("%-8s %6u %10u %9u %9u\n", (SD_REQUEST_READ == direction) ? "read" : "write", depth, queue.transfers,
+           stats.commands, stats.dma_switches);
+}
+
+int main(void)
+{
+    check_single();
+    check_merge();
+    check_partial_merge();
+    check_retry();
+    check_submit_busy();
+    check_standard_capacity();
+
+    printf("\n%u requests of %u blocks\n", STREAM_REQUESTS, STREAM_BLOCKS);
+    printf("%-8s %6s %10s %9s %9s\n", "", "depth", "transfers", "commands", "switches");
+    stream(SD_REQUEST_READ, 1U);
+    stream(SD_REQUEST_READ, STREAM_REQUESTS);
+    stream(SD_REQUEST_WRITE, 1U);
+    stream(SD_REQUEST_WRITE, STREAM_REQUESTS);
+
+    printf("%s\n", (0 == failures) ? "all checks passed" : "checks failed");
+
+    return (0 == failures) ? 0 : 1;
+}
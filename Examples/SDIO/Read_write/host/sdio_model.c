@@ -0,0 +1,900 @@
+/*!
+    \file    sdio_model.c
+    \brief   SDIO, DMA1 channel 3 and SD card model behind the functions of gd32f4xx_sdio.h and
+             gd32f4xx_dma.h, for running the request queue of Examples/SDIO/Read_write/sdcard.c
+
+    The functions of the library set the registers of the model instead of the peripherals.
+    A command runs on the card when sdio_csm_enable() is called, its response and the
+    CMDRECV flag are there right away. A data command puts the card into its data state, the
+    data then moves when the bench calls sdio_model_step(): one DMA segment per call, between
+    the disk image and the buffer the DMA address points to. With the DMA as flow controller
+    a segment ends when the transfer number runs out: the channel disables itself, FTF is set
+    and the DMA interrupt (sd_dma_interrupts_process()) may start the channel again on the next
+    buffer. With the SDIO as flow controller the segment is the rest of the data. At the end
+    of the data DTEND is set and the SDIO interrupt (sd_interrupts_process()) runs. A data phase
+    set to fail by sdio_model_fail() moves one block and then ends with the error flag instead.
+
+    The card follows the states of the SD specification the queue relies on: CMD17 and CMD24
+    end with their block, CMD18 and CMD25 run until CMD12, a write ends with the card
+    programming for a CMD13 poll. Every 32 bit DMA address is resolved in the memory given to
+    sdio_model_init(), the bench runs on 64 bit hosts where sdcard.c keeps the low half of a
+    pointer.
+
+    Misuse is counted as a violation: a command other than CMD13 while the card programs, a
+    data command outside of the transfer state, CMD12 without a multiple block transfer,
+    ACMD23 with another count than the data phase, a data length that does not fit the
+    command or the card, data directions of the SDIO and the DMA that do not match the
+    command, a DMA that is not running while the SDIO moves data, a merged transfer without
+    the hardware flow control of the card clock, a DMA reconfigured while its channel runs,
+    a DMA expecting more data than the transfer has, a buffer outside of the memory and an
+    interrupt delivered while PRIMASK is set.
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sdio_model.h"
+#include "sdcard.h"
+
+#define SDIO_MODEL_BLOCK_SIZE           512U
+#define SDIO_MODEL_SDIOCLK              48000000U
+#define SDIO_MODEL_PROGRAM_POLLS        1U
+#define SDIO_MODEL_LOG_SIZE             4096U
+#define SDIO_MODEL_NO_COMMAND           0xFFU
+
+/* states of the card, the CURRENT_STATE field of R1 */
+#define CARD_TRANSFER                   4U
+#define CARD_DATA                       5U
+#define CARD_RECEIVING                  6U
+#define CARD_PROGRAMMING                7U
+
+__IO uint32_t sdio_model_stat;
+__IO uint32_t sdio_model_dma_chctl;
+uint32_t sdio_model_primask;
+
+static uint32_t *card_disk;
+static uint32_t card_blocks;
+static uint8_t card_high_capacity;
+static uint8_t card_state;
+static uint8_t card_app;                                /* the last command was CMD55 */
+static uint32_t card_preerase;                          /* count of ACMD23 for the next CMD25 */
+static uint32_t card_blocklen;
+static uint32_t card_polls;                             /* CMD13 polls the programming still lasts */
+static uint8_t card_phase;                              /* a data command was accepted and its data did not end */
+static uint8_t card_multiple;                           /* the data command was CMD18 or CMD25 */
+static uint8_t card_write;
+static uint8_t card_fails;                              /* the running data phase ends with fail_flag */
+static uint32_t card_block;
+static uint32_t card_moved;                             /* bytes of the data phase moved */
+
+static uint32_t fail_flag;
+static uint32_t fail_skip;
+static uint32_t fail_count;
+static uint8_t reject_cmd = SDIO_MODEL_NO_COMMAND;
+
+static uint32_t cmd_index;
+static uint32_t cmd_arg;
+static uint8_t resp_index;
+static uint32_t resp;
+static uint32_t sdio_inten;
+static uint32_t data_length;
+static uint32_t data_direction;
+static uint8_t sdio_dsm;
+static uint8_t sdio_dma;
+static uint8_t sdio_hwclock;
+static uint32_t sdio_clock = SDIO_MODEL_SDIOCLK / 2U;
+
+static uint32_t dma_memory;
+static uint32_t dma_offset;                             /* bytes moved since the channel was enabled */
+static uint32_t dma_number;
+static uint32_t dma_direction;
+static uint32_t dma_flow;
+static uint32_t dma_intf;
+
+static uint32_t *memory_base;
+static uint32_t memory_words;
+
+static char log_text[SDIO_MODEL_LOG_SIZE];
+static uint32_t log_len;
+static sdio_model_stats_struct stats;
+
+/*!
+    \brief      count and report a misuse
+    \param[in]  what: description
+    \param[out] none
+    \retval     none
+*/
+static void violation(const char *what)
+{
+    stats.violations++;
+    printf("  sdio model: %s\n", what);
+}
+
+/*!
+    \brief      append a token to the log
+    \param[in]  format: printf format of the token
+    \param[out] none
+    \retval     none
+*/
+static void log_add(const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if((0U != log_len) && (log_len + 1U < SDIO_MODEL_LOG_SIZE)) {
+        log_text[log_len++] = ' ';
+    }
+    va_start(args, format);
+    len = vsnprintf(&log_text[log_len], SDIO_MODEL_LOG_SIZE - log_len, format, args);
+    va_end(args);
+    if(len > 0) {
+        log_len += (uint32_t)len;
+        if(log_len >= SDIO_MODEL_LOG_SIZE) {
+            log_len = SDIO_MODEL_LOG_SIZE - 1U;
+        }
+    }
+}
+
+/*!
+    \brief      resolve a DMA address in the memory of the bench
+    \param[in]  address: low 32 bits of the address
+    \param[in]  words: words that have to follow it
+    \param[out] none
+    \retval     the words, NULL if they are not all in the memory
+*/
+static uint32_t *memory_at(uint32_t address, uint32_t words)
+{
+    uint32_t offset = address - (uint32_t)(uintptr_t)memory_base;
+
+    if((0U != (offset & 0x3U)) || (offset / 4U > memory_words) || (words > memory_words - offset / 4U)) {
+        violation("DMA buffer outside of the memory");
+        return NULL;
+    }
+    return &memory_base[offset / 4U];
+}
+
+/*!
+    \brief      run the SDIO interrupt if one of its flags is enabled
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void irq_sdio(void)
+{
+    if(0U != (sdio_model_stat & sdio_inten)) {
+        if(0U != sdio_model_primask) {
+            violation("interrupt while PRIMASK is set");
+        }
+        sd_interrupts_process();
+    }
+}
+
+/*!
+    \brief      run the DMA interrupt if one of its flags is enabled
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void irq_dma(void)
+{
+    if(((0U != (dma_intf & DMA_INT_FLAG_FTF)) && (0U != (sdio_model_dma_chctl & DMA_INT_FTF))) ||
+            ((0U != (dma_intf & DMA_INT_FLAG_TAE)) && (0U != (sdio_model_dma_chctl & DMA_INT_TAE)))) {
+        if(0U != sdio_model_primask) {
+            violation("interrupt while PRIMASK is set");
+        }
+        sd_dma_interrupts_process();
+    }
+}
+
+/*!
+    \brief      accept CMD17, CMD18, CMD24 or CMD25
+    \param[in]  index: command index
+    \param[out] none
+    \retval     none
+*/
+static void data_command(uint8_t index)
+{
+    if(CARD_TRANSFER != card_state) {
+        violation("data command outside of the transfer state");
+    }
+    if(!card_high_capacity && ((0U != (cmd_arg % SDIO_MODEL_BLOCK_SIZE)) || (SDIO_MODEL_BLOCK_SIZE != card_blocklen))) {
+        violation("standard capacity transfer not in 512 byte blocks");
+    }
+
+    card_block = card_high_capacity ? cmd_arg : (cmd_arg / SDIO_MODEL_BLOCK_SIZE);
+    card_moved = 0U;
+    card_phase = 1U;
+    card_multiple = (uint8_t)((SD_CMD_READ_MULTIPLE_BLOCK == index) || (SD_CMD_WRITE_MULTIPLE_BLOCK == index));
+    card_write = (uint8_t)((SD_CMD_WRITE_BLOCK == index) || (SD_CMD_WRITE_MULTIPLE_BLOCK == index));
+    card_state = card_write ? CARD_RECEIVING : CARD_DATA;
+    log_add("%u@%u", index, cmd_arg);
+}
+
+/*!
+    \brief      check the setup of a data phase that starts to move data
+    \param[in]  none
+    \param[out] none
+    \retval     1 if the data phase can run
+*/
+static uint8_t data_start(void)
+{
+    uint32_t blocks = data_length / SDIO_MODEL_BLOCK_SIZE;
+
+    if((0U == blocks) || (0U != (data_length % SDIO_MODEL_BLOCK_SIZE)) || (card_multiple != (blocks > 1U)) ||
+            (card_block + blocks > card_blocks)) {
+        violation("data length does not fit the command or the card");
+        return 0U;
+    }
+    if(card_write ? ((SDIO_TRANSDIRECTION_TOCARD != data_direction) || (DMA_MEMORY_TO_PERIPH != dma_direction)) :
+            ((SDIO_TRANSDIRECTION_TOSDIO != data_direction) || (DMA_PERIPH_TO_MEMORY != dma_direction))) {
+        violation("data direction of the SDIO or the DMA does not match the command");
+        return 0U;
+    }
+    if(card_write && card_multiple && (0U != card_preerase) && (card_preerase != blocks)) {
+        violation("ACMD23 count differs from the blocks written");
+    }
+    card_preerase = 0U;
+
+    card_fails = 0U;
+    if(0U != fail_skip) {
+        fail_skip--;
+    } else if(0U != fail_count) {
+        fail_count--;
+        card_fails = 1U;
+    }
+    return 1U;
+}
+
+/*!
+    \brief      insert a card with a disk of a number of blocks, the DMA buffers must lie in memory
+    \param[in]  disk: blocks * 128 words of card data
+    \param[in]  blocks: size of the card
+    \param[in]  high_capacity: 1 for block addresses, 0 for byte addresses and CMD16
+    \param[in]  memory: the memory of the bench
+    \param[in]  words: size of the memory
+    \param[out] none
+    \retval     none
+*/
+void sdio_model_init(uint32_t *disk, uint32_t blocks, uint8_t high_capacity, uint32_t *memory, uint32_t words)
+{
+    card_disk = disk;
+    card_blocks = blocks;
+    card_high_capacity = high_capacity;
+    card_state = CARD_TRANSFER;
+    card_app = 0U;
+    card_preerase = 0U;
+    card_blocklen = 0U;
+    card_phase = 0U;
+    card_multiple = 0U;
+    fail_skip = 0U;
+    fail_count = 0U;
+    reject_cmd = SDIO_MODEL_NO_COMMAND;
+
+    sdio_model_stat = 0U;
+    sdio_model_dma_chctl = 0U;
+    sdio_model_primask = 0U;
+    sdio_inten = 0U;
+    sdio_dsm = 0U;
+    sdio_dma = 0U;
+    sdio_hwclock = 0U;
+    dma_intf = 0U;
+
+    memory_base = memory;
+    memory_words = words;
+
+    memset(&stats, 0, sizeof(stats));
+    sdio_model_log_clear();
+}
+
+/*!
+    \brief      let count data phases after the next skip ones end with an error after their first block
+    \param[in]  flag: SDIO_FLAG_DTCRCERR, SDIO_FLAG_DTTMOUT, SDIO_FLAG_STBITE, SDIO_FLAG_RXORE or SDIO_FLAG_TXURE
+    \param[in]  skip: data phases that run without an error first
+    \param[in]  count: data phases that fail
+    \param[out] none
+    \retval     none
+*/
+void sdio_model_fail(uint32_t flag, uint32_t skip, uint32_t count)
+{
+    fail_flag = flag;
+    fail_skip = skip;
+    fail_count = count;
+}
+
+/*!
+    \brief      let the next command with an index time out
+    \param[in]  cmdindex: command index
+    \param[out] none
+    \retval     none
+*/
+void sdio_model_reject(uint8_t cmdindex)
+{
+    reject_cmd = cmdindex;
+}
+
+/*!
+    \brief      move the current DMA segment of a data phase and raise the interrupts of its end
+    \param[in]  none
+    \param[out] none
+    \retval     1 if data moved, 0 if no data phase is ready
+*/
+uint8_t sdio_model_step(void)
+{
+    uint32_t length;
+    uint32_t words;
+    uint32_t *buffer;
+    uint32_t *data;
+
+    if(!card_phase || !sdio_dsm) {
+        return 0U;
+    }
+    if(!sdio_dma || (0U == (sdio_model_dma_chctl & DMA_CHXCTL_CHEN))) {
+        violation("data phase without a running DMA, the SDIO holds the card clock for good");
+        card_phase = 0U;
+        return 0U;
+    }
+    if((0U == card_moved) && !data_start()) {
+        card_phase = 0U;
+        return 0U;
+    }
+
+    length = data_length - card_moved;
+    if((DMA_FLOW_CONTROLLER_DMA == dma_flow) && (dma_number * 4U < length)) {
+        length = dma_number * 4U;
+    }
+    if(card_fails && (length > SDIO_MODEL_BLOCK_SIZE)) {
+        length = SDIO_MODEL_BLOCK_SIZE;
+    }
+    words = length / 4U;
+
+    buffer = memory_at(dma_memory + dma_offset, words);
+    if(NULL == buffer) {
+        card_phase = 0U;
+        return 0U;
+    }
+    data = &card_disk[card_block * SDIO_MODEL_BLOCK_WORDS + card_moved / 4U];
+    if(card_write) {
+        memcpy(data, buffer, length);
+    } else {
+        memcpy(buffer, data, length);
+    }
+    card_moved += length;
+    dma_offset += length;
+    if(DMA_FLOW_CONTROLLER_DMA == dma_flow) {
+        dma_number -= words;
+    }
+
+    if(card_fails) {
+        /* a multiple block transfer waits for CMD12, a single block one is dropped by the card */
+        card_phase = 0U;
+        if(!card_multiple) {
+            card_state = CARD_TRANSFER;
+        }
+        stats.data_phases++;
+        log_add("e");
+        sdio_model_stat |= fail_flag;
+        irq_sdio();
+        return 1U;
+    }
+
+    if((DMA_FLOW_CONTROLLER_DMA == dma_flow) && (0U == dma_number)) {
+        sdio_model_dma_chctl &= ~DMA_CHXCTL_CHEN;
+        dma_intf |= DMA_INT_FLAG_FTF;
+        irq_dma();
+        if((card_moved < data_length) && (0U != (sdio_model_dma_chctl & DMA_CHXCTL_CHEN))) {
+            stats.dma_switches++;
+            if(!sdio_hwclock) {
+                violation("DMA switched buffers without the hardware flow control, the FIFO overruns");
+            }
+        }
+    }
+
+    if(card_moved == data_length) {
+        if(DMA_FLOW_CONTROLLER_PERI == dma_flow) {
+            sdio_model_dma_chctl &= ~DMA_CHXCTL_CHEN;
+        } else if(0U != dma_number) {
+            violation("the DMA waits for more data than the transfer has");
+        }
+        card_phase = 0U;
+        if(!card_multiple) {
+            card_state = card_write ? CARD_PROGRAMMING : CARD_TRANSFER;
+            card_polls = SDIO_MODEL_PROGRAM_POLLS;
+        }
+        stats.data_phases++;
+        stats.blocks += data_length / SDIO_MODEL_BLOCK_SIZE;
+        log_add("d%u", data_length / SDIO_MODEL_BLOCK_SIZE);
+        sdio_model_stat |= SDIO_FLAG_DTEND | SDIO_FLAG_DTBLKEND;
+        irq_sdio();
+    }
+    return 1U;
+}
+
+/*!
+    \brief      check whether the SDIO, the DMA and the card are back at rest
+    \param[in]  none
+    \param[out] none
+    \retval     1 if no data phase is set up and the card is in the transfer state
+*/
+uint8_t sdio_model_rest(void)
+{
+    return (uint8_t)(!card_phase && !sdio_dsm && !sdio_dma && !sdio_hwclock && (CARD_TRANSFER == card_state) &&
+                     (0U == (sdio_model_dma_chctl & DMA_CHXCTL_CHEN)));
+}
+
+/*!
+    \brief      bus clock set by sdio_clock_config()
+    \param[in]  none
+    \param[out] none
+    \retval     clock in Hz
+*/
+uint32_t sdio_model_clock(void)
+{
+    return sdio_clock;
+}
+
+/*!
+    \brief      commands and data phases since the last sdio_model_log_clear()
+    \param[in]  none
+    \param[out] none
+    \retval     tokens separated by spaces: "<index>" for a command, "<index>@<argument>" for a
+                data command, "!" after a command that timed out, "d<blocks>" for the end of a
+                data phase and "e" for a data phase that failed
+*/
+const char *sdio_model_log(void)
+{
+    return log_text;
+}
+
+/*!
+    \brief      clear the log
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sdio_model_log_clear(void)
+{
+    log_len = 0U;
+    log_text[0] = '\0';
+}
+
+/*!
+    \brief      read the statistics since sdio_model_init()
+    \param[in]  none
+    \param[out] stats_out: copy of the statistics
+    \retval     none
+*/
+void sdio_model_stats_get(sdio_model_stats_struct *stats_out)
+{
+    *stats_out = stats;
+}
+
+/*!
+    \brief      send the configured command to the card
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sdio_csm_enable(void)
+{
+    uint8_t index = (uint8_t)cmd_index;
+    uint8_t app = 0U;
+
+    stats.commands++;
+    if(reject_cmd == index) {
+        reject_cmd = SDIO_MODEL_NO_COMMAND;
+        if((SD_CMD_READ_SINGLE_BLOCK == index) || (SD_CMD_READ_MULTIPLE_BLOCK == index) ||
+                (SD_CMD_WRITE_BLOCK == index) || (SD_CMD_WRITE_MULTIPLE_BLOCK == index)) {
+            log_add("%u@%u!", index, cmd_arg);
+        } else {
+            log_add("%u!", index);
+        }
+        sdio_model_stat |= SDIO_FLAG_CMDTMOUT;
+        return;
+    }
+    if((CARD_PROGRAMMING == card_state) && (SD_CMD_SEND_STATUS != index)) {
+        violation("command while the card programs");
+    }
+
+    resp = (uint32_t)card_state << 9;
+    switch(index) {
+    case SD_CMD_SEND_STATUS:
+        stats.cmd13++;
+        log_add("%u", index);
+        if((CARD_PROGRAMMING == card_state) && (0U == card_polls--)) {
+            card_state = CARD_TRANSFER;
+            resp = (uint32_t)card_state << 9;
+        }
+        break;
+    case SD_CMD_SET_BLOCKLEN:
+        card_blocklen = cmd_arg;
+        log_add("%u", index);
+        break;
+    case SD_CMD_APP_CMD:
+        app = 1U;
+        log_add("%u", index);
+        break;
+    case SD_APPCMD_SET_WR_BLK_ERASE_COUNT:
+        if(!card_app) {
+            violation("CMD23 without CMD55");
+        }
+        card_preerase = cmd_arg;
+        log_add("%u", index);
+        break;
+    case SD_CMD_READ_SINGLE_BLOCK:
+    case SD_CMD_READ_MULTIPLE_BLOCK:
+    case SD_CMD_WRITE_BLOCK:
+    case SD_CMD_WRITE_MULTIPLE_BLOCK:
+        data_command(index);
+        break;
+    case SD_CMD_STOP_TRANSMISSION:
+        if(!card_multiple || ((CARD_DATA != card_state) && (CARD_RECEIVING != card_state))) {
+            violation("CMD12 without a multiple block transfer");
+        }
+        card_phase = 0U;
+        card_multiple = 0U;
+        if(CARD_RECEIVING == card_state) {
+            card_state = CARD_PROGRAMMING;
+            card_polls = SDIO_MODEL_PROGRAM_POLLS;
+        } else {
+            card_state = CARD_TRANSFER;
+        }
+        log_add("%u", index);
+        break;
+    default:
+        violation("command the queue does not send");
+        break;
+    }
+    card_app = app;
+
+    resp_index = index;
+    sdio_model_stat |= SDIO_FLAG_CMDRECV;
+}
+
+/*!
+    \brief      configure the command to send
+    \param[in]  cmd_index_in: command index
+    \param[in]  cmd_argument: command argument
+    \param[in]  response_type: SDIO_RESPONSETYPE_x, the model always answers
+    \param[out] none
+    \retval     none
+*/
+void sdio_command_response_config(uint32_t cmd_index_in, uint32_t cmd_argument, uint32_t response_type)
+{
+    cmd_index = cmd_index_in;
+    cmd_arg = cmd_argument;
+}
+
+/*!
+    \brief      index of the command the last response belongs to
+    \param[in]  none
+    \param[out] none
+    \retval     command index
+*/
+uint8_t sdio_command_index_get(void)
+{
+    return resp_index;
+}
+
+/*!
+    \brief      read a response register
+    \param[in]  sdio_responsex: SDIO_RESPONSEx, the model only has the R1 of SDIO_RESPONSE0
+    \param[out] none
+    \retval     response
+*/
+uint32_t sdio_response_get(uint32_t sdio_responsex)
+{
+    return (SDIO_RESPONSE0 == sdio_responsex) ? resp : 0U;
+}
+
+/*!
+    \brief      read flags of the SDIO
+    \param[in]  flag: SDIO_FLAG_x
+    \param[out] none
+    \retval     SET if one of them is set
+*/
+FlagStatus sdio_flag_get(uint32_t flag)
+{
+    return (0U != (sdio_model_stat & flag)) ? SET : RESET;
+}
+
+/*!
+    \brief      clear flags of the SDIO
+    \param[in]  flag: SDIO_FLAG_x
+    \param[out] none
+    \retval     none
+*/
+void sdio_flag_clear(uint32_t flag)
+{
+    sdio_model_stat &= ~flag;
+}
+
+/*!
+    \brief      read interrupt flags of the SDIO
+    \param[in]  int_flag: SDIO_INT_FLAG_x
+    \param[out] none
+    \retval     SET if one of them is set
+*/
+FlagStatus sdio_interrupt_flag_get(uint32_t int_flag)
+{
+    return (0U != (sdio_model_stat & int_flag)) ? SET : RESET;
+}
+
+/*!
+    \brief      clear interrupt flags of the SDIO
+    \param[in]  int_flag: SDIO_INT_FLAG_x
+    \param[out] none
+    \retval     none
+*/
+void sdio_interrupt_flag_clear(uint32_t int_flag)
+{
+    sdio_model_stat &= ~int_flag;
+}
+
+/*!
+    \brief      enable interrupts of the SDIO
+    \param[in]  int_flag: SDIO_INT_x
+    \param[out] none
+    \retval     none
+*/
+void sdio_interrupt_enable(uint32_t int_flag)
+{
+    sdio_inten |= int_flag;
+}
+
+/*!
+    \brief      disable interrupts of the SDIO
+    \param[in]  int_flag: SDIO_INT_x
+    \param[out] none
+    \retval     none
+*/
+void sdio_interrupt_disable(uint32_t int_flag)
+{
+    sdio_inten &= ~int_flag;
+}
+
+/*!
+    \brief      configure the length of the data phase
+    \param[in]  data_timeout: not used
+    \param[in]  data_length_in: bytes of the data phase
+    \param[in]  data_blocksize: not used, the queue moves 512 byte blocks
+    \param[out] none
+    \retval     none
+*/
+void sdio_data_config(uint32_t data_timeout, uint32_t data_length_in, uint32_t data_blocksize)
+{
+    data_length = data_length_in;
+}
+
+/*!
+    \brief      configure the direction of the data phase
+    \param[in]  transfer_mode: not used
+    \param[in]  transfer_direction: SDIO_TRANSDIRECTION_TOCARD or SDIO_TRANSDIRECTION_TOSDIO
+    \param[out] none
+    \retval     none
+*/
+void sdio_data_transfer_config(uint32_t transfer_mode, uint32_t transfer_direction)
+{
+    data_direction = transfer_direction;
+}
+
+/*!
+    \brief      enable or disable the data state machine, the DMA requests and the hardware
+                flow control of the card clock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sdio_dsm_enable(void)
+{
+    sdio_dsm = 1U;
+}
+
+void sdio_dsm_disable(void)
+{
+    sdio_dsm = 0U;
+}
+
+void sdio_dma_enable(void)
+{
+    sdio_dma = 1U;
+}
+
+void sdio_dma_disable(void)
+{
+    sdio_dma = 0U;
+}
+
+void sdio_hardware_clock_enable(void)
+{
+    sdio_hwclock = 1U;
+}
+
+void sdio_hardware_clock_disable(void)
+{
+    sdio_hwclock = 0U;
+}
+
+/*!
+    \brief      configure the bus clock
+    \param[in]  clock_edge: not used
+    \param[in]  clock_bypass: SDIO_CLOCKBYPASS_ENABLE for SDIOCLK, else SDIOCLK / (clock_division + 2)
+    \param[in]  clock_powersave: not used
+    \param[in]  clock_division: divider
+    \param[out] none
+    \retval     none
+*/
+void sdio_clock_config(uint32_t clock_edge, uint32_t clock_bypass, uint32_t clock_powersave, uint16_t clock_division)
+{
+    sdio_clock = (SDIO_CLOCKBYPASS_ENABLE == clock_bypass) ? SDIO_MODEL_SDIOCLK : (SDIO_MODEL_SDIOCLK / (clock_division + 2U));
+}
+
+/*!
+    \brief      reset the channel
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[out] none
+    \retval     none
+*/
+void dma_deinit(uint32_t dma_periph, dma_channel_enum channelx)
+{
+    sdio_model_dma_chctl = 0U;
+    dma_memory = 0U;
+    dma_number = 0U;
+    dma_intf = 0U;
+}
+
+/*!
+    \brief      configure the channel
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  init_struct: memory address, transfer number and direction are used
+    \param[out] none
+    \retval     none
+*/
+void dma_multi_data_mode_init(uint32_t dma_periph, dma_channel_enum channelx, dma_multi_data_parameter_struct *init_struct)
+{
+    if(0U != (sdio_model_dma_chctl & DMA_CHXCTL_CHEN)) {
+        violation("DMA configured while its channel runs");
+    }
+    dma_memory = init_struct->memory0_addr;
+    dma_number = init_struct->number;
+    dma_direction = init_struct->direction;
+}
+
+/*!
+    \brief      select the flow controller
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  controller: DMA_FLOW_CONTROLLER_DMA or DMA_FLOW_CONTROLLER_PERI
+    \param[out] none
+    \retval     none
+*/
+void dma_flow_controller_config(uint32_t dma_periph, dma_channel_enum channelx, uint32_t controller)
+{
+    dma_flow = controller;
+}
+
+/*!
+    \brief      set the memory address of the next segment
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  memory_flag: DMA_MEMORY_0
+    \param[in]  address: low 32 bits of the buffer
+    \param[out] none
+    \retval     none
+*/
+void dma_memory_address_config(uint32_t dma_periph, dma_channel_enum channelx, uint8_t memory_flag, uint32_t address)
+{
+    if(0U != (sdio_model_dma_chctl & DMA_CHXCTL_CHEN)) {
+        violation("DMA address changed while its channel runs");
+    }
+    dma_memory = address;
+}
+
+/*!
+    \brief      set the words of the next segment
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  number: words
+    \param[out] none
+    \retval     none
+*/
+void dma_transfer_number_config(uint32_t dma_periph, dma_channel_enum channelx, uint32_t number)
+{
+    if(0U != (sdio_model_dma_chctl & DMA_CHXCTL_CHEN)) {
+        violation("DMA transfer number changed while its channel runs");
+    }
+    dma_number = number;
+}
+
+/*!
+    \brief      enable the channel, it starts at the memory address
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[out] none
+    \retval     none
+*/
+void dma_channel_enable(uint32_t dma_periph, dma_channel_enum channelx)
+{
+    sdio_model_dma_chctl |= DMA_CHXCTL_CHEN;
+    dma_offset = 0U;
+}
+
+/*!
+    \brief      disable the channel
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[out] none
+    \retval     none
+*/
+void dma_channel_disable(uint32_t dma_periph, dma_channel_enum channelx)
+{
+    sdio_model_dma_chctl &= ~DMA_CHXCTL_CHEN;
+}
+
+/*!
+    \brief      enable or disable interrupts of the channel, their enable bits are in CHCTL
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  source: DMA_INT_FTF, DMA_INT_TAE
+    \param[out] none
+    \retval     none
+*/
+void dma_interrupt_enable(uint32_t dma_periph, dma_channel_enum channelx, uint32_t source)
+{
+    sdio_model_dma_chctl |= source;
+}
+
+void dma_interrupt_disable(uint32_t dma_periph, dma_channel_enum channelx, uint32_t source)
+{
+    sdio_model_dma_chctl &= ~source;
+}
+
+/*!
+    \brief      read an interrupt flag of the channel, set only if its interrupt is enabled
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  interrupt: DMA_INT_FLAG_FTF, DMA_INT_FLAG_TAE
+    \param[out] none
+    \retval     SET or RESET
+*/
+FlagStatus dma_interrupt_flag_get(uint32_t dma_periph, dma_channel_enum channelx, uint32_t interrupt)
+{
+    uint32_t enable = (DMA_INT_FLAG_FTF == interrupt) ? DMA_INT_FTF : ((DMA_INT_FLAG_TAE == interrupt) ? DMA_INT_TAE : 0U);
+
+    return ((0U != (dma_intf & interrupt)) && (0U != (sdio_model_dma_chctl & enable))) ? SET : RESET;
+}
+
+/*!
+    \brief      clear flags of the channel
+    \param[in]  dma_periph: DMA1
+    \param[in]  channelx: DMA_CH3
+    \param[in]  interrupt: DMA_INT_FLAG_x, DMA_FLAG_x for dma_flag_clear()
+    \param[out] none
+    \retval     none
+*/
+void dma_interrupt_flag_clear(uint32_t dma_periph, dma_channel_enum channelx, uint32_t interrupt)
+{
+    dma_intf &= ~interrupt;
+}
+
+void dma_flag_clear(uint32_t dma_periph, dma_channel_enum channelx, uint32_t flag)
+{
+    dma_intf &= ~flag;
+}
+
+/* the rest of the library sdcard.c calls is only used outside of the queued transfers */
+void dma_channel_subperipheral_select(uint32_t dma_periph, dma_channel_enum channelx, dma_subperipheral_enum sub_periph) {}
+void sdio_deinit(void) {}
+void sdio_clock_enable(void) {}
+void sdio_bus_mode_set(uint32_t bus_mode) {}
+void sdio_power_state_set(uint32_t power_state) {}
+uint32_t sdio_power_state_get(void) { return SDIO_POWER_ON; }
+void sdio_wait_type_set(uint32_t wait_type) {}
+uint32_t sdio_data_read(void) { return 0U; }
+void sdio_data_write(uint32_t data) {}
+void gpio_af_set(uint32_t gpio_periph, uint32_t alt_func_num, uint32_t pin) {}
+void gpio_mode_set(uint32_t gpio_periph, uint32_t mode, uint32_t pull_up_down, uint32_t pin) {}
+void gpio_output_options_set(uint32_t gpio_periph, uint8_t otype, uint32_t speed, uint32_t pin) {}
+void rcu_periph_clock_enable(rcu_periph_enum periph) {}
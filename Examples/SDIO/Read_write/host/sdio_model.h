@@ -0,0 +1,57 @@
+/*!
+    \file    sdio_model.h
+    \brief   SDIO, DMA1 channel 3 and SD card model behind the functions of gd32f4xx_sdio.h and
+             gd32f4xx_dma.h, for running the request queue of Examples/SDIO/Read_write/sdcard.c
+*/
+
+#ifndef SDIO_MODEL_H
+#define SDIO_MODEL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+
+#define SDIO_MODEL_BLOCK_WORDS          128U
+
+/* commands, data phases and misuse seen by the model */
+typedef struct {
+    uint32_t commands;                                  /*!< commands sent, CMD13 polls included */
+    uint32_t cmd13;                                     /*!< status polls */
+    uint32_t data_phases;                               /*!< data phases that ended, with or without an error */
+    uint32_t blocks;                                    /*!< blocks moved by data phases without an error */
+    uint32_t dma_switches;                              /*!< DMA restarts on the next buffer within a data phase */
+    uint32_t violations;                                /*!< misuse of the SDIO, the DMA or the card, see sdio_model.c */
+} sdio_model_stats_struct;
+
+/* the registers sdcard.c reads directly and the PRIMASK of the core */
+extern __IO uint32_t sdio_model_stat;
+extern __IO uint32_t sdio_model_dma_chctl;
+extern uint32_t sdio_model_primask;
+
+/* function declarations */
+/* insert a card with a disk of a number of blocks, the DMA buffers must lie in memory */
+void sdio_model_init(uint32_t *disk, uint32_t blocks, uint8_t high_capacity, uint32_t *memory, uint32_t memory_words);
+/* let count data phases after the next skip ones end with an SDIO_FLAG_x error after their first block */
+void sdio_model_fail(uint32_t flag, uint32_t skip, uint32_t count);
+/* let the next command with an index time out */
+void sdio_model_reject(uint8_t cmdindex);
+/* move the current DMA segment of a data phase and raise the interrupts of its end */
+uint8_t sdio_model_step(void);
+/* check whether the SDIO, the DMA and the card are back at rest */
+uint8_t sdio_model_rest(void);
+/* bus clock set by sdio_clock_config() in Hz */
+uint32_t sdio_model_clock(void);
+/* commands and data phases since the last sdio_model_log_clear() */
+const char *sdio_model_log(void);
+/* clear the log */
+void sdio_model_log_clear(void);
+/* read the statistics since sdio_model_init() */
+void sdio_model_stats_get(sdio_model_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SDIO_MODEL_H */
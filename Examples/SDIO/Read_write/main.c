@@ -35,17 +35,39 @@ OF SUCH DAMAGE.
 #include "gd32f4xx.h"
 #include "gd32f450i_eval.h"
 #include "sdcard.h"
+#include "timebase.h"
+#include "sd_diskio.h"
+#include "disk_cache.h"
+#include "ff_stream.h"
+#include "ff_dirindex.h"
+#include "disk_trim.h"
 #include <stdio.h>
 
 //#define DATA_PRINT                                          /* uncomment the macro to print out the data */
 
+#define BENCH_BLOCK             4096                        /* first block of the throughput benchmark area, before the first partition */
+#define BENCH_TOTAL_BLOCKS      2048                        /* blocks moved per transfer size, 1MB */
+#define BENCH_MAX_BLOCKS        64                          /* largest transfer of the benchmark */
+#define BENCH_FILE_CHUNKS       32                          /* f_write/f_read calls of buf_bench size, 1MB */
+
 sd_card_info_struct sd_cardinfo;                            /* information of SD card */
 uint32_t buf_write[512];                                    /* store the data written to the card */
 uint32_t buf_read[512];                                     /* store the data read from the card */
+uint32_t buf_bench[BENCH_MAX_BLOCKS * 128];                 /* data of the throughput benchmark */
+FATFS fs;                                                   /* file system on the card */
+FIL file;                                                   /* file of the FatFs benchmark */
+ff_stream_struct stream;                                    /* log file of the streaming benchmark */
+char sd_path[4];                                            /* logical drive of the card */
+uint32_t sd_cache[8192];                                    /* 32KB sector cache of the card */
+uint32_t sd_dirindex[4096];                                 /* 16KB name index of large directories */
 
 void nvic_config(void);
 sd_error_enum sd_io_init(void);
 void card_info_get(void);
+sd_error_enum sd_queue_test(uint32_t block, uint8_t direction, uint32_t *buffer);
+sd_error_enum sd_bench(uint32_t blocks, uint8_t direction, uint32_t *kbps);
+void fatfs_bench(void);
+void stream_bench(void);
 
 /*!
     \brief      main function
@@ -73,6 +95,9 @@ int main(void)
     gd_eval_led_off(LED2);
     gd_eval_led_off(LED3);
 
+    /* microsecond time of the throughput benchmark */
+    timebase_config();
+
     /* initialize the card */
     do {
         sd_error = sd_io_init();
@@ -244,6 +269,65 @@ int main(void)
 #endif /* DATA_PRINT */
     }
 
+    /* queued operation test, adjacent single block requests are merged into one transfer */
+    sd_error = sd_queue_test(300, SD_REQUEST_WRITE, buf_write);
+    if(SD_OK == sd_error) {
+        sd_error = sd_queue_test(300, SD_REQUEST_READ, buf_read);
+    }
+    for(i = 0; (SD_OK == sd_error) && (i < 512); i++) {
+        if(buf_read[i] != buf_write[i]) {
+            sd_error = SD_ERROR;
+        }
+    }
+    if(SD_OK != sd_error) {
+        printf("\r\n Queued block operation fail!");
+        /* turn on LED1, LED3 and turn off LED2 */
+        gd_eval_led_on(LED1);
+        gd_eval_led_on(LED3);
+        gd_eval_led_off(LED2);
+        while(1) {
+        }
+    } else {
+        sd_queue_stats_struct stats;
+
+        sd_queue_stats_get(&stats);
+        printf("\r\n Queued block operation success!");
+        printf("\r\n## %d requests in %d transfers, %d merged ##", stats.requests, stats.transfers, stats.merged);
+    }
+
+    /* sequential throughput at several transfer sizes */
+    printf("\r\n\r\n Throughput test:");
+    for(i = 1; (SD_OK == sd_error) && (i <= BENCH_MAX_BLOCKS); i *= 4) {
+        uint32_t write_kbps = 0, read_kbps = 0;
+
+        sd_error = sd_bench(i, SD_REQUEST_WRITE, &write_kbps);
+        if(SD_OK == sd_error) {
+            sd_error = sd_bench(i, SD_REQUEST_READ, &read_kbps);
+        }
+        if(SD_OK == sd_error) {
+            printf("\r\n## %3d blocks per transfer: write %5d KB/s, read %5d KB/s ##", i, write_kbps, read_kbps);
+        }
+    }
+    if(SD_OK != sd_error) {
+        printf("\r\n Throughput test fail!");
+        /* turn on LED1, LED3 and turn off LED2 */
+        gd_eval_led_on(LED1);
+        gd_eval_led_on(LED3);
+        gd_eval_led_off(LED2);
+        while(1) {
+        }
+    } else {
+        sd_speed_stats_struct speed;
+
+        sd_speed_stats_get(&speed);
+        printf("\r\n## Bus clock %dHz, %s ##", speed.clock, speed.high_speed ? "high speed" : "default speed");
+        printf("\r\n## %d CRC errors, %d timeouts, %d retries, %d clock fallbacks ##",
+               speed.crc_errors, speed.timeouts, speed.retries, speed.fallbacks);
+    }
+
+    /* the same amount of data as a file through the FatFs SD driver */
+    fatfs_bench();
+
     /* turn on all the LEDs */
     gd_eval_led_on(LED1);
     gd_eval_led_on(LED2);
@@ -262,6 +346,8 @@ void nvic_config(void)
 {
     nvic_priority_group_set(NVIC_PRIGROUP_PRE1_SUB3);
     nvic_irq_enable(SDIO_IRQn, 0, 0);
+    /* same priority as SDIO, the queued transfer state is shared by both handlers */
+    nvic_irq_enable(DMA1_Channel3_IRQn, 0, 1);
 }
 
 /*!
@@ -292,10 +378,14 @@ sd_error_enum sd_io_init(void)
         status = sd_bus_mode_config(SDIO_BUSMODE_4BIT);
 //        status = sd_bus_mode_config(SDIO_BUSMODE_1BIT);
     }
+    if(SD_OK == status) {
+        /* switch to high speed if the card supports it and use the fastest working clock */
+        status = sd_high_speed_config();
+    }
     if(SD_OK == status) {
         /* set data transfer mode */
-//        status = sd_transfer_mode_config(SD_DMA_MODE);
-        status = sd_transfer_mode_config(SD_POLLING_MODE);
+        status = sd_transfer_mode_config(SD_DMA_MODE);
+//        status = sd_transfer_mode_config(SD_POLLING_MODE);
     }
     return status;
 }
@@ -377,6 +467,223 @@ void card_info_get(void)
     }
 }
 
+/*!
+    \brief      queue four single block requests at once and wait for all of them
+    \param[in]  block: first block of the four
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[in]  buffer: data of four blocks
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_queue_test(uint32_t block, uint8_t direction, uint32_t *buffer)
+{
+    sd_request_struct request[4];
+    sd_error_enum status = SD_OK;
+    uint32_t i;
+
+    for(i = 0; (SD_OK == status) && (i < 4); i++) {
+        request[i].buffer = &buffer[i * 128];
+        request[i].block = block + i;
+        request[i].count = 1;
+        request[i].direction = direction;
+        request[i].callback = NULL;
+        request[i].arg = NULL;
+        /* the first request starts at once, the other ones queue up behind it */
+        status = sd_request_submit(&request[i]);
+    }
+
+    /* the requests live on this stack, wait for all of them; sd_queue_process() completes
+       writes once the card has programmed them */
+    while(!sd_queue_idle()) {
+        sd_queue_process();
+    }
+
+    for(i = 0; (SD_OK == status) && (i < 4); i++) {
+        status = request[i].status;
+    }
+    return status;
+}
+
+/*!
+    \brief      move BENCH_TOTAL_BLOCKS blocks sequentially and measure the throughput
+    \param[in]  blocks: blocks per transfer, up to BENCH_MAX_BLOCKS
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[out] kbps: throughput in KB/s
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_bench(uint32_t blocks, uint8_t direction, uint32_t *kbps)
+{
+    sd_error_enum status = SD_OK;
+    uint32_t addr, start, elapsed;
+    uint32_t block;
+
+    start = timebase_now_us();
+    for(block = 0; (SD_OK == status) && (block < BENCH_TOTAL_BLOCKS); block += blocks) {
+        addr = (BENCH_BLOCK + block) * 512;
+        if(SD_REQUEST_WRITE == direction) {
+            status = (1 == blocks) ? sd_block_write(buf_bench, addr, 512) :
+                     sd_multiblocks_write(buf_bench, addr, 512, blocks);
+        } else {
+            status = (1 == blocks) ? sd_block_read(buf_bench, addr, 512) :
+                     sd_multiblocks_read(buf_bench, addr, 512, blocks);
+        }
+    }
+    elapsed = timebase_now_us() - start;
+
+    *kbps = (uint32_t)(((uint64_t)BENCH_TOTAL_BLOCKS * 512U * 1000000U) / 1024U / ((0U != elapsed) ? elapsed : 1U));
+    return status;
+}
+
+/*!
+    \brief      write and read a 1MB file through FatFs and print the throughput
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fatfs_bench(void)
+{
+    char name[16];
+    FRESULT res;
+    UINT bytes;
+    uint32_t i, start, write_us = 0, read_us = 0, elapsed_us;
+    sd_diskio_stats_struct stats;
+    disk_cache_stats_struct cache_stats;
+    ff_dirindex_stats_struct index_stats;
+    disk_trim_stats_struct trim_stats;
+
+    printf("\r\n\r\n FatFs test:");
+    if(0U != FATFS_LinkDriver(&SD_Driver, sd_path)) {
+        printf("\r\n FatFs driver link fail!");
+        return;
+    }
+    /* FAT and directory sectors stay in the cache, whole clusters of file data bypass it */
+    if(RES_OK != disk_cache_attach(sd_path[0] - '0', sd_cache, sizeof(sd_cache))) {
+        printf("\r\n Disk cache attach fail!");
+    }
+    /* directories of more than FF_DIRINDEX_MIN_ENTRIES entries are looked up through the index */
+    ff_dirindex_attach(sd_dirindex, sizeof(sd_dirindex));
+    /* clusters freed by deletes are erased on the card in idle time, merged into large ranges */
+    disk_trim_attach(sd_path[0] - '0');
+    /* the card is not formatted by the example, it needs a FAT or exFAT volume already */
+    res = f_mount(&fs, sd_path, 1);
+    if(FR_OK != res) {
+        printf("\r\n No file system on the card (%d), FatFs test skipped!", res);
+        return;
+    }
+    sprintf(name, "%ssdbench.bin", sd_path);
+
+    res = f_open(&file, name, FA_CREATE_ALWAYS | FA_WRITE);
+    if(FR_OK == res) {
+        start = timebase_now_us();
+        for(i = 0; (FR_OK == res) && (i < BENCH_FILE_CHUNKS); i++) {
+            res = f_write(&file, buf_bench, sizeof(buf_bench), &bytes);
+        }
+        /* the close writes the directory entry and syncs the card */
+        if(FR_OK == res) {
+            res = f_close(&file);
+        } else {
+            f_close(&file);
+        }
+        write_us = timebase_now_us() - start;
+    }
+
+    if(FR_OK == res) {
+        res = f_open(&file, name, FA_READ);
+    }
+    if(FR_OK == res) {
+        start = timebase_now_us();
+        for(i = 0; (FR_OK == res) && (i < BENCH_FILE_CHUNKS); i++) {
+            res = f_read(&file, buf_bench, sizeof(buf_bench), &bytes);
+        }
+        read_us = timebase_now_us() - start;
+        f_close(&file);
+        f_unlink(name);
+    }
+
+    if(FR_OK != res) {
+        printf("\r\n FatFs file operation fail (%d)!", res);
+    } else {
+        sd_diskio_stats_get(&stats);
+        printf("\r\n## 1MB file: write %5d KB/s, read %5d KB/s ##",
+               (uint32_t)((uint64_t)BENCH_FILE_CHUNKS * sizeof(buf_bench) * 1000000U / 1024U / ((0U != write_us) ? write_us : 1U)),
+               (uint32_t)((uint64_t)BENCH_FILE_CHUNKS * sizeof(buf_bench) * 1000000U / 1024U / ((0U != read_us) ? read_us : 1U)));
+        printf("\r\n## %d reads, %d writes, %d sectors bounced ##", stats.reads, stats.writes, stats.sectors_bounced);
+        disk_cache_stats_get(sd_path[0] - '0', &cache_stats);
+        printf("\r\n## cache: %d/%d read hits, %d/%d write hits, %d write-backs ##",
+               cache_stats.read_hits, cache_stats.read_hits + cache_stats.read_misses,
+               cache_stats.write_hits, cache_stats.write_hits + cache_stats.write_misses, cache_stats.writebacks);
+        stream_bench();
+        ff_dirindex_stats_get(&index_stats);
+        printf("\r\n## name index: %d lookups, %d linear searches, %d directories indexed ##",
+               index_stats.lookups, index_stats.linear, index_stats.builds);
+        /* both test files are deleted, erase their clusters now that the card is idle */
+        start = timebase_now_us();
+        disk_trim_process(sd_path[0] - '0', 1U);
+        elapsed_us = timebase_now_us() - start;
+        disk_trim_stats_get(sd_path[0] - '0', &trim_stats);
+        printf("\r\n## trim: %d ranges released, %d erase commands, %d sectors, %d us ##",
+               trim_stats.requests, trim_stats.issued, trim_stats.sectors_issued, elapsed_us);
+    }
+    disk_trim_detach(sd_path[0] - '0');
+    ff_dirindex_detach();
+    disk_cache_detach(sd_path[0] - '0');
+    f_mount(NULL, sd_path, 0);
+}
+
+/*!
+    \brief      stream a 1MB log file into a preallocated extent and print the worst buffer latency
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void stream_bench(void)
+{
+    char name[16];
+    FRESULT res;
+    BYTE *buffer;
+    uint32_t i, k, start, elapsed, total_us, max_us = 0;
+    ff_stream_stats_struct stats;
+
+    sprintf(name, "%slog.bin", sd_path);
+    /* buf_bench holds both halves of the double buffer, 16KB each, committed every 128KB */
+    res = ff_stream_open(&stream, name, (FSIZE_t)BENCH_FILE_CHUNKS * sizeof(buf_bench), buf_bench, sizeof(buf_bench) / 2U, 128U * 1024U);
+    if(FR_OK != res) {
+        printf("\r\n Log stream open fail (%d)!", res);
+        return;
+    }
+
+    start = timebase_now_us();
+    for(i = 0; (FR_OK == res) && (i < 2U * BENCH_FILE_CHUNKS); i++) {
+        /* stands in for a DMA transfer filling the free half */
+        buffer = ff_stream_buffer_get(&stream);
+        for(k = 0; k < sizeof(buf_bench) / 2U; k += 4U) {
+            *(uint32_t *)&buffer[k] = i * sizeof(buf_bench) / 2U + k;
+        }
+        elapsed = timebase_now_us();
+        res = ff_stream_buffer_submit(&stream);
+        elapsed = timebase_now_us() - elapsed;
+        if(elapsed > max_us) {
+            max_us = elapsed;
+        }
+    }
+    total_us = timebase_now_us() - start;
+    if(FR_OK == res) {
+        res = ff_stream_close(&stream);
+    } else {
+        ff_stream_close(&stream);
+    }
+    f_unlink(name);
+
+    if(FR_OK != res) {
+        printf("\r\n Log stream write fail (%d)!", res);
+    } else {
+        ff_stream_stats_get(&stream, &stats);
+        printf("\r\n## 1MB log stream: %5d KB/s, worst 16KB buffer %d us, %d commits ##",
+               (uint32_t)((uint64_t)BENCH_FILE_CHUNKS * sizeof(buf_bench) * 1000000U / 1024U / ((0U != total_us) ? total_us : 1U)),
+               max_us, stats.commits);
+    }
+}
+
 /* retarget the C library printf function to the USART */
 int fputc(int ch, FILE *f)
 {
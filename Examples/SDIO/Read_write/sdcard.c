@@ -105,6 +105,22 @@ OF SUCH DAMAGE.
 #define SD_RCA_SHIFT                        ((uint8_t)0x10)           /* RCA shift bits */
 #define SD_CLK_DIV_INIT                     ((uint16_t)0x0076)        /* SD clock division in initialization phase */
 #define SD_CLK_DIV_TRANS                    ((uint16_t)0x0002)        /* SD clock division in transmission phase */
+#define SD_CLK_DIV_FAST                     ((uint16_t)0x0000)        /* SD clock division for the fastest default speed clock */
+#define SD_SDIOCLK                          ((uint32_t)48000000)      /* SDIOCLK from CK_PLL48M */
+
+/* bus clock steps, a transfer that fails with a data CRC error or timeout moves one step down */
+#define SD_CLK_STEP_HIGH_SPEED              ((uint8_t)0x00)           /* SDIOCLK bypassed, 48MHz, card in high speed mode */
+#define SD_CLK_STEP_FAST                    ((uint8_t)0x01)           /* SD_CLK_DIV_FAST, 24MHz */
+#define SD_CLK_STEP_TRANS                   ((uint8_t)0x02)           /* SD_CLK_DIV_TRANS, 12MHz */
+
+/* arguments of CMD6(SWITCH_FUNC), all groups but group 1 (access mode) keep their function */
+#define SD_SWITCH_CHECK_HIGH_SPEED          ((uint32_t)0x00FFFFF1)    /* check whether the card supports high speed */
+#define SD_SWITCH_SET_HIGH_SPEED            ((uint32_t)0x80FFFFF1)    /* switch the card to high speed */
+#define SD_SWITCH_STATUS_GROUP1_SUPPORT     13U                       /* byte of the switch status with bits [407:400] */
+#define SD_SWITCH_STATUS_GROUP1_RESULT      16U                       /* byte of the switch status with bits [383:376] */
+#define SD_SWITCH_HIGH_SPEED                ((uint8_t)0x01)           /* function 1 of group 1 */
+
+#define SD_TRANSFER_RETRIES                 ((uint8_t)0x02)           /* attempts to repeat a failed queued transfer */
 
 #define SDIO_MASK_INTC_FLAGS                ((uint32_t)0x00C007FF)    /* mask flags of SDIO_INTC */
 
@@ -116,8 +132,27 @@ static uint32_t sd_cid[4] = {0, 0, 0, 0};                             /* content
 static uint16_t sd_rca = 0;                                           /* RCA of SD card */
 static uint32_t transmode = SD_POLLING_MODE;
 static uint32_t totalnumber_bytes = 0, stopcondition = 0;
-static __IO sd_error_enum transerror = SD_OK;
-static __IO uint32_t transend = 0, number_bytes = 0;
+
+/* state of the request queue */
+#define SD_QUEUE_IDLE                       ((uint8_t)0x00)           /* no transfer, the next submit starts one */
+#define SD_QUEUE_TRANSFER                   ((uint8_t)0x01)           /* a transfer is being issued or moves data */
+#define SD_QUEUE_PROGRAMMING                ((uint8_t)0x02)           /* the card programs the data of a write transfer */
+
+#define SD_BLOCK_WORDS                      ((uint32_t)0x00000080)    /* words of a 512 byte block */
+#define SD_INTS_TRANSFER                    (SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE | \
+                                             SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE)
+
+static sd_request_struct *queue_head = NULL;                          /* first pending request */
+static sd_request_struct *queue_tail = NULL;                          /* last pending request */
+static sd_request_struct *queue_batch = NULL;                         /* requests of the running transfer */
+static sd_request_struct *queue_segment = NULL;                       /* request the DMA is moving */
+static sd_error_enum queue_batch_status = SD_OK;                      /* result of the running transfer */
+static __IO uint8_t queue_state = SD_QUEUE_IDLE;
+static sd_queue_stats_struct queue_stats = {0, 0, 0, 0, 0};
+static uint8_t queue_batch_retries = 0;                               /* repeats of the running transfer */
+
+static uint8_t sd_clk_step = SD_CLK_STEP_TRANS;                       /* current bus clock step */
+static sd_speed_stats_struct speed_stats = {SD_SDIOCLK / (SD_CLK_DIV_TRANS + 2U), 0, 0, 0, 0, 0};
 
 /* check if the command sent error occurs */
 static sd_error_enum cmdsent_error_check(void);
@@ -140,17 +175,34 @@ static sd_error_enum sd_card_state_get(uint8_t *pcardstate);
 static sd_error_enum sd_bus_width_config(uint32_t buswidth);
 /* get the SCR of corresponding card */
 static sd_error_enum sd_scr_get(uint16_t rca, uint32_t *pscr);
+/* erase a continuous area of a card in card addresses */
+static sd_error_enum sd_erase_range(uint32_t startaddr, uint32_t endaddr);
+/* send CMD6(SWITCH_FUNC) and read the 512 bit switch status */
+static sd_error_enum sd_switch_function(uint32_t argument, uint32_t *pstatus);
 /* get the data block size */
 static uint32_t sd_datablocksize_get(uint16_t bytesnumber);
+/* set the SDIO clock to a bus clock step */
+static void sd_clock_step_set(uint8_t step);
 
 /* configure the GPIO of SDIO interface */
 static void gpio_config(void);
 /* configure the RCU of SDIO and DMA */
 static void rcu_config(void);
-/* configure the DMA for SDIO transfer request */
-static void dma_transfer_config(uint32_t *srcbuf, uint32_t bufsize);
-/* configure the DMA for SDIO reveive request */
-static void dma_receive_config(uint32_t *dstbuf, uint32_t bufsize);
+/* configure the DMA for a queued SDIO transfer */
+static void dma_config(uint32_t *buffer, uint32_t direction, uint32_t words);
+
+/* run a blocking transfer through the request queue */
+static sd_error_enum sd_queue_transfer(uint32_t *buffer, uint32_t addr, uint16_t blocksize, uint32_t blocksnumber, uint8_t direction);
+/* start the next transfer of the queue or go idle */
+static void sd_queue_start(void);
+/* send the commands of the transfer in queue_batch and start its data phase */
+static sd_error_enum sd_queue_batch_issue(void);
+/* end the data phase of the running transfer */
+static void sd_queue_transfer_end(sd_error_enum status);
+/* complete all requests of the running transfer */
+static void sd_queue_batch_complete(sd_error_enum status);
+/* count a failed transfer and decide whether to repeat it at a lower clock */
+static uint8_t sd_queue_retry(sd_error_enum status);
 
 /*!
     \brief      initialize the SD card and make it in standby state
@@ -178,8 +230,9 @@ sd_error_enum sd_init(void)
         return status;
     }
 
-    /* configure the SDIO peripheral */
-    sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_DISABLE, SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_TRANS);
+    /* configure the SDIO peripheral, a new card starts in default speed */
+    speed_stats.high_speed = 0;
+    sd_clock_step_set(SD_CLK_STEP_TRANS);
     sdio_bus_mode_set(SDIO_BUSMODE_1BIT);
     sdio_hardware_clock_disable();
 
@@ -384,8 +437,7 @@ sd_error_enum sd_bus_mode_config(uint32_t busmode)
             /* configure SD bus width and the SDIO */
             status = sd_bus_width_config(SD_BUS_WIDTH_4BIT);
             if(SD_OK == status) {
-                sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_DISABLE,
-                                  SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_TRANS);
+                sd_clock_step_set(sd_clk_step);
                 sdio_bus_mode_set(busmode);
                 sdio_hardware_clock_disable();
             }
@@ -393,8 +445,7 @@ sd_error_enum sd_bus_mode_config(uint32_t busmode)
             /* configure SD bus width and the SDIO */
             status = sd_bus_width_config(SD_BUS_WIDTH_1BIT);
             if(SD_OK == status) {
-                sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_DISABLE,
-                                  SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_TRANS);
+                sd_clock_step_set(sd_clk_step);
                 sdio_bus_mode_set(busmode);
                 sdio_hardware_clock_disable();
             }
@@ -417,7 +468,10 @@ sd_error_enum sd_transfer_mode_config(uint32_t txmode)
 {
     sd_error_enum status = SD_OK;
     /* set the transfer mode */
-    if((SD_DMA_MODE == txmode) || (SD_POLLING_MODE == txmode)) {
+    if(SD_QUEUE_IDLE != queue_state) {
+        /* queued requests are still running */
+        status = SD_OPERATION_IMPROPER;
+    } else if((SD_DMA_MODE == txmode) || (SD_POLLING_MODE == txmode)) {
         transmode = txmode;
     } else {
         status = SD_PARAMETER_INVALID;
@@ -425,6 +479,62 @@ sd_error_enum sd_transfer_mode_config(uint32_t txmode)
     return status;
 }
 
+/*!
+    \brief      switch the card to high speed mode if it supports it and raise the bus clock,
+                call after sd_bus_mode_config()
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_high_speed_config(void)
+{
+    sd_error_enum status = SD_OK;
+    uint32_t switchstatus[16];
+    uint8_t *pswitch = (uint8_t *)switchstatus;
+    uint8_t step;
+
+    if(SD_QUEUE_IDLE != queue_state) {
+        /* queued requests are still running */
+        status = SD_OPERATION_IMPROPER;
+        return status;
+    }
+    if((SDIO_STD_CAPACITY_SD_CARD_V1_1 != cardtype) && (SDIO_STD_CAPACITY_SD_CARD_V2_0 != cardtype) &&
+            (SDIO_HIGH_CAPACITY_SD_CARD != cardtype)) {
+        status = SD_FUNCTION_UNSUPPORTED;
+        return status;
+    }
+
+    /* CMD6 needs physical layer version 1.10 and the switch command class */
+    if((0U != ((sd_scr[1] & 0x0F000000U) >> 24)) && (0U != (((sd_csd[1] & 0xFFF00000U) >> 20) & SD_CCC_SWITCH))) {
+        /* ask in check mode first, a card without high speed answers with an empty group 1 support mask */
+        status = sd_switch_function(SD_SWITCH_CHECK_HIGH_SPEED, switchstatus);
+        if((SD_OK == status) && (pswitch[SD_SWITCH_STATUS_GROUP1_SUPPORT] & (1U << SD_SWITCH_HIGH_SPEED))) {
+            status = sd_switch_function(SD_SWITCH_SET_HIGH_SPEED, switchstatus);
+            if((SD_OK == status) && (SD_SWITCH_HIGH_SPEED == (pswitch[SD_SWITCH_STATUS_GROUP1_RESULT] & 0x0FU))) {
+                speed_stats.high_speed = 1;
+            }
+        }
+        if(SD_OK != status) {
+            return status;
+        }
+    }
+
+    /* the card switches within 8 clocks after the status, try the fastest clock it allows and
+       step down while reading the SD status fails */
+    step = speed_stats.high_speed ? SD_CLK_STEP_HIGH_SPEED : SD_CLK_STEP_FAST;
+    while(1) {
+        sd_clock_step_set(step);
+        status = sd_sdstatus_get(switchstatus);
+        if((SD_OK == status) || (SD_CLK_STEP_TRANS == step) ||
+                ((SD_DATA_CRC_ERROR != status) && (SD_DATA_TIMEOUT != status) && (SD_START_BIT_ERROR != status))) {
+            break;
+        }
+        ++step;
+        speed_stats.fallbacks++;
+    }
+    return status;
+}
+
 /*!
     \brief      read a block data into a buffer from the specified address of a card
     \param[out] preadbuffer: a pointer that store a block read data
@@ -437,15 +547,17 @@ sd_error_enum sd_block_read(uint32_t *preadbuffer, uint32_t readaddr, uint16_t b
     /* initialize the variables */
     sd_error_enum status = SD_OK;
     uint32_t count = 0, align = 0, datablksize = SDIO_DATABLOCKSIZE_1BYTE, *ptempbuff = preadbuffer;
-    __IO uint32_t timeout = 0;
 
     if(NULL == preadbuffer) {
         status = SD_PARAMETER_INVALID;
         return status;
     }
 
-    transerror = SD_OK;
-    transend = 0;
+    /* in DMA mode the transfer runs through the request queue, which may be busy with other requests */
+    if(SD_DMA_MODE == transmode) {
+        return sd_queue_transfer(preadbuffer, readaddr, blocksize, 1U, SD_REQUEST_READ);
+    }
+
     totalnumber_bytes = 0;
     /* clear all DSM configuration */
     sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
@@ -537,19 +649,6 @@ sd_error_enum sd_block_read(uint32_t *preadbuffer, uint32_t readaddr, uint16_t b
         }
         /* clear the SDIO_INTC flags */
         sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
-    } else if(SD_DMA_MODE == transmode) {
-        /* DMA mode */
-        /* enable the SDIO corresponding interrupts and DMA function */
-        sdio_interrupt_enable(SDIO_INT_CCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND | SDIO_INT_STBITE);
-        sdio_dma_enable();
-        dma_receive_config(preadbuffer, blocksize);
-        timeout = 100000;
-        while((RESET == dma_flag_get(DMA1, DMA_CH3, DMA_FLAG_FTF)) && (timeout > 0)) {
-            timeout--;
-            if(0 == timeout) {
-                return SD_ERROR;
-            }
-        }
     } else {
         status = SD_PARAMETER_INVALID;
     }
@@ -569,15 +668,17 @@ sd_error_enum sd_multiblocks_read(uint32_t *preadbuffer, uint32_t readaddr, uint
     /* initialize the variables */
     sd_error_enum status = SD_OK;
     uint32_t count = 0, align = 0, datablksize = SDIO_DATABLOCKSIZE_1BYTE, *ptempbuff = preadbuffer;
-    __IO uint32_t timeout = 0;
 
     if(NULL == preadbuffer) {
         status = SD_PARAMETER_INVALID;
         return status;
     }
 
-    transerror = SD_OK;
-    transend = 0;
+    /* in DMA mode the transfer runs through the request queue, which may be busy with other requests */
+    if(SD_DMA_MODE == transmode) {
+        return sd_queue_transfer(preadbuffer, readaddr, blocksize, blocksnumber, SD_REQUEST_READ);
+    }
+
     totalnumber_bytes = 0;
     /* clear all DSM configuration */
     sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
@@ -690,25 +791,6 @@ sd_error_enum sd_multiblocks_read(uint32_t *preadbuffer, uint32_t readaddr, uint
                 }
             }
             sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
-        } else if(SD_DMA_MODE == transmode) {
-            /* DMA mode */
-            /* enable the SDIO corresponding interrupts and DMA function */
-            sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND | SDIO_INT_STBITE);
-            sdio_dma_enable();
-            dma_receive_config(preadbuffer, totalnumber_bytes);
-
-            timeout = 100000;
-            while((RESET == dma_flag_get(DMA1, DMA_CH3, DMA_FLAG_FTF)) && (timeout > 0)) {
-                timeout--;
-                if(0 == timeout) {
-                    return SD_ERROR;
-                }
-            }
-            while((0 == transend) && (SD_OK == transerror)) {
-            }
-            if(SD_OK != transerror) {
-                return transerror;
-            }
         } else {
             status = SD_PARAMETER_INVALID;
         }
@@ -738,8 +820,11 @@ sd_error_enum sd_block_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_
         return status;
     }
 
-    transerror = SD_OK;
-    transend = 0;
+    /* in DMA mode the transfer runs through the request queue, which may be busy with other requests */
+    if(SD_DMA_MODE == transmode) {
+        return sd_queue_transfer(pwritebuffer, writeaddr, blocksize, 1U, SD_REQUEST_WRITE);
+    }
+
     totalnumber_bytes = 0;
     /* clear all DSM configuration */
     sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
@@ -867,26 +952,6 @@ sd_error_enum sd_block_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_
             sdio_flag_clear(SDIO_FLAG_STBITE);
             return status;
         }
-    } else if(SD_DMA_MODE == transmode) {
-        /* DMA mode */
-        /* enable the SDIO corresponding interrupts and DMA */
-        sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_TXURE | SDIO_INT_DTEND | SDIO_INT_STBITE);
-        dma_transfer_config(pwritebuffer, blocksize);
-        sdio_dma_enable();
-
-        timeout = 100000;
-        while((RESET == dma_flag_get(DMA1, DMA_CH3, DMA_FLAG_FTF)) && (timeout > 0)) {
-            timeout--;
-            if(0 == timeout) {
-                return SD_ERROR;
-            }
-        }
-        while((0 == transend) && (SD_OK == transerror)) {
-        }
-
-        if(SD_OK != transerror) {
-            return transerror;
-        }
     } else {
         status = SD_PARAMETER_INVALID;
         return status;
@@ -918,15 +983,17 @@ sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, u
     uint8_t cardstate = 0;
     uint32_t count = 0, align = 0, datablksize = SDIO_DATABLOCKSIZE_1BYTE, *ptempbuff = pwritebuffer;
     uint32_t transbytes = 0, restwords = 0;
-    __IO uint32_t timeout = 0;
 
     if(NULL == pwritebuffer) {
         status = SD_PARAMETER_INVALID;
         return status;
     }
 
-    transerror = SD_OK;
-    transend = 0;
+    /* in DMA mode the transfer runs through the request queue, which may be busy with other requests */
+    if(SD_DMA_MODE == transmode) {
+        return sd_queue_transfer(pwritebuffer, writeaddr, blocksize, blocksnumber, SD_REQUEST_WRITE);
+    }
+
     totalnumber_bytes = 0;
     /* clear all DSM configuration */
     sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
@@ -1077,25 +1144,6 @@ sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, u
                 }
             }
             sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
-        } else if(SD_DMA_MODE == transmode) {
-            /* DMA mode */
-            /* enable SDIO corresponding interrupts and DMA */
-            sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_TXURE | SDIO_INT_DTEND | SDIO_INT_STBITE);
-            sdio_dma_enable();
-            dma_transfer_config(pwritebuffer, totalnumber_bytes);
-
-            timeout = 200000;
-            while((RESET == dma_flag_get(DMA1, DMA_CH3, DMA_FLAG_FTF) && (timeout > 0))) {
-                timeout--;
-                if(0 == timeout) {
-                    return SD_ERROR;
-                }
-            }
-            while((0 == transend) && (SD_OK == transerror)) {
-            }
-            if(SD_OK != transerror) {
-                return transerror;
-            }
         } else {
             status = SD_PARAMETER_INVALID;
             return status;
@@ -1121,158 +1169,220 @@ sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, u
 */
 sd_error_enum sd_erase(uint32_t startaddr, uint32_t endaddr)
 {
-    /* initialize the variables */
-    sd_error_enum status = SD_OK;
-    uint32_t count = 0, clkdiv = 0;
-    __IO uint32_t delay = 0;
-    uint8_t cardstate = 0, tempbyte = 0;
-    uint16_t tempccc = 0;
-
-    /* get the card command classes from CSD */
-    tempbyte = (uint8_t)((sd_csd[1] & SD_MASK_24_31BITS) >> 24);
-    tempccc = (uint16_t)((uint16_t)tempbyte << 4);
-    tempbyte = (uint8_t)((sd_csd[1] & SD_MASK_16_23BITS) >> 16);
-    tempccc |= (uint16_t)((uint16_t)(tempbyte & 0xF0) >> 4);
-    if(0 == (tempccc & SD_CCC_ERASE)) {
-        /* don't support the erase command */
-        status = SD_FUNCTION_UNSUPPORTED;
-        return status;
-    }
-    clkdiv = (SDIO_CLKCTL & SDIO_CLKCTL_DIV);
-    clkdiv += ((SDIO_CLKCTL & SDIO_CLKCTL_DIV8) >> 31) * 256;
-    clkdiv += 2;
-    delay = 168000 / clkdiv;
-
-    /* check whether the card is locked */
-    if(sdio_response_get(SDIO_RESPONSE0) & SD_CARDSTATE_LOCKED) {
-        status = SD_LOCK_UNLOCK_FAILED;
-        return(status);
-    }
-
     /* blocksize is fixed in 512B for SDHC card */
     if(SDIO_HIGH_CAPACITY_SD_CARD == cardtype) {
         startaddr /= 512;
         endaddr /= 512;
     }
 
-    if((SDIO_STD_CAPACITY_SD_CARD_V1_1 == cardtype) || (SDIO_STD_CAPACITY_SD_CARD_V2_0 == cardtype) ||
-            (SDIO_HIGH_CAPACITY_SD_CARD == cardtype)) {
-        /* send CMD32(ERASE_WR_BLK_START) to set the address of the first write block to be erased */
-        sdio_command_response_config(SD_CMD_ERASE_WR_BLK_START, startaddr, SDIO_RESPONSETYPE_SHORT);
-        sdio_wait_type_set(SDIO_WAITTYPE_NO);
-        sdio_csm_enable();
-        /* check if some error occurs */
-        status = r1_error_check(SD_CMD_ERASE_WR_BLK_START);
-        if(SD_OK != status) {
-            return status;
-        }
+    return sd_erase_range(startaddr, endaddr);
+}
 
-        /* send CMD33(ERASE_WR_BLK_END) to set the address of the last write block of the continuous range to be erased */
-        sdio_command_response_config(SD_CMD_ERASE_WR_BLK_END, endaddr, SDIO_RESPONSETYPE_SHORT);
-        sdio_wait_type_set(SDIO_WAITTYPE_NO);
-        sdio_csm_enable();
-        /* check if some error occurs */
-        status = r1_error_check(SD_CMD_ERASE_WR_BLK_END);
-        if(SD_OK != status) {
-            return status;
+/*!
+    \brief      erase a continuous area of a card given in 512 byte blocks, reaches beyond 4GB
+    \param[in]  startblock: the first block
+    \param[in]  endblock: the last block
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_blocks_erase(uint32_t startblock, uint32_t endblock)
+{
+    /* standard capacity cards take byte addresses */
+    if(SDIO_HIGH_CAPACITY_SD_CARD != cardtype) {
+        if(endblock > (0xFFFFFFFFU / 512U)) {
+            return SD_PARAMETER_INVALID;
         }
+        startblock *= 512U;
+        endblock *= 512U;
     }
+    return sd_erase_range(startblock, endblock);
+}
 
-    /* send CMD38(ERASE) to set the address of the first write block to be erased */
-    sdio_command_response_config(SD_CMD_ERASE, (uint32_t)0x0, SDIO_RESPONSETYPE_SHORT);
-    sdio_wait_type_set(SDIO_WAITTYPE_NO);
-    sdio_csm_enable();
-    /* check if some error occurs */
-    status = r1_error_check(SD_CMD_ERASE);
-    if(SD_OK != status) {
+/*!
+    \brief      process all the interrupts which the corresponding flags are set
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_interrupts_process(void)
+{
+    sd_error_enum status = SD_OK;
+
+    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_DTCRCERR)) {
+        status = SD_DATA_CRC_ERROR;
+    } else if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_DTTMOUT)) {
+        status = SD_DATA_TIMEOUT;
+    } else if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_STBITE)) {
+        status = SD_START_BIT_ERROR;
+    } else if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_TXURE)) {
+        status = SD_TX_UNDERRUN_ERROR;
+    } else if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_RXORE)) {
+        status = SD_RX_OVERRUN_ERROR;
+    } else if(RESET == sdio_interrupt_flag_get(SDIO_INT_FLAG_DTEND)) {
         return status;
     }
-    /* loop until the counter is reach to the calculated time */
-    for(count = 0; count < delay; count++) {
-    }
-    /* get the card state and wait the card is out of programming and receiving state */
-    status = sd_card_state_get(&cardstate);
-    while((SD_OK == status) && ((SD_CARDSTATE_PROGRAMMING == cardstate) || (SD_CARDSTATE_RECEIVING == cardstate))) {
-        status = sd_card_state_get(&cardstate);
+
+    /* the data phase is over, either completely or by an error */
+    sdio_interrupt_disable(SD_INTS_TRANSFER);
+    sdio_interrupt_flag_clear(SDIO_MASK_INTC_FLAGS);
+    if((SD_QUEUE_TRANSFER == queue_state) && (NULL != queue_batch)) {
+        sd_queue_transfer_end(status);
     }
     return status;
 }
 
 /*!
-    \brief      process all the interrupts which the corresponding flags are set
+    \brief      process the DMA interrupt of a queued transfer, call from DMA1_Channel3_IRQHandler
     \param[in]  none
     \param[out] none
+    \retval     none
+*/
+void sd_dma_interrupts_process(void)
+{
+    if(RESET != dma_interrupt_flag_get(DMA1, DMA_CH3, DMA_INT_FLAG_TAE)) {
+        dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_TAE);
+        if((SD_QUEUE_TRANSFER == queue_state) && (NULL != queue_batch)) {
+            sdio_interrupt_disable(SD_INTS_TRANSFER);
+            sd_queue_transfer_end(SD_ERROR);
+        }
+        return;
+    }
+
+    if(RESET != dma_interrupt_flag_get(DMA1, DMA_CH3, DMA_INT_FLAG_FTF)) {
+        dma_interrupt_flag_clear(DMA1, DMA_CH3, DMA_INT_FLAG_FTF);
+        /* a merged transfer continues with the buffer of the next request, the SDIO stops
+           the card clock while its FIFO waits for the DMA */
+        if((NULL != queue_segment) && (NULL != queue_segment->next)) {
+            queue_segment = queue_segment->next;
+            dma_memory_address_config(DMA1, DMA_CH3, DMA_MEMORY_0, (uint32_t)queue_segment->buffer);
+            dma_transfer_number_config(DMA1, DMA_CH3, queue_segment->count * SD_BLOCK_WORDS);
+            dma_channel_enable(DMA1, DMA_CH3);
+        }
+    }
+}
+
+/*!
+    \brief      queue a block transfer, it runs in the background in DMA mode
+    \param[in]  request: the transfer, buffer, block, count, direction and callback have to be set,
+                the request belongs to the driver until its done flag is set
+    \param[out] none
     \retval     sd_error_enum
 */
-sd_error_enum sd_interrupts_process(void)
+sd_error_enum sd_request_submit(sd_request_struct *request)
 {
-    transerror = SD_OK;
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_DTEND)) {
-        /* send CMD12 to stop data transfer in multipule blocks operation */
-        if(1 == stopcondition) {
-            transerror = sd_transfer_stop();
-        } else {
-            transerror = SD_OK;
+    uint32_t primask;
+    uint8_t start = 0;
+
+    if((NULL == request) || (NULL == request->buffer) || (0U != ((uint32_t)request->buffer & 0x3U)) ||
+            (0U == request->count) || (request->count > (SD_MAX_DATA_LENGTH / 512U)) ||
+            ((SD_REQUEST_READ != request->direction) && (SD_REQUEST_WRITE != request->direction))) {
+        return SD_PARAMETER_INVALID;
+    }
+    if(SD_DMA_MODE != transmode) {
+        return SD_OPERATION_IMPROPER;
+    }
+
+    request->status = SD_OK;
+    request->done = 0;
+    request->next = NULL;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    if(NULL == queue_tail) {
+        queue_head = request;
+    } else {
+        queue_tail->next = request;
+    }
+    queue_tail = request;
+    queue_stats.requests++;
+    /* claim the idle engine, a running one picks the request up when it completes */
+    if(SD_QUEUE_IDLE == queue_state) {
+        queue_state = SD_QUEUE_TRANSFER;
+        start = 1;
+    }
+    __set_PRIMASK(primask);
+
+    if(start) {
+        sd_queue_start();
+    }
+    return SD_OK;
+}
+
+/*!
+    \brief      finish a write once the card has programmed the data, call from the main loop
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sd_queue_process(void)
+{
+    sd_error_enum status;
+    uint8_t cardstate = 0;
+
+    if(SD_QUEUE_PROGRAMMING != queue_state) {
+        return;
+    }
+
+    /* one CMD13 per call, the card holds DAT0 low for milliseconds while it programs */
+    status = sd_card_state_get(&cardstate);
+    if((SD_OK == status) && ((SD_CARDSTATE_PROGRAMMING == cardstate) || (SD_CARDSTATE_RECEIVING == cardstate))) {
+        return;
+    }
+
+    queue_state = SD_QUEUE_TRANSFER;
+    if(SD_OK != queue_batch_status) {
+        status = queue_batch_status;
+    }
+    /* writing the whole transfer again is safe, the card drops the blocks of a failed one */
+    if(sd_queue_retry(status)) {
+        status = sd_queue_batch_issue();
+        if(SD_OK == status) {
+            return;
         }
-        sdio_interrupt_flag_clear(SDIO_INT_DTEND);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        transend = 1;
-        number_bytes = 0;
-        return transerror;
     }
+    sd_queue_batch_complete(status);
+    sd_queue_start();
+}
 
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_DTCRCERR)) {
-        sdio_interrupt_flag_clear(SDIO_INT_DTCRCERR);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        number_bytes = 0;
-        transerror = SD_DATA_CRC_ERROR;
-        return transerror;
-    }
-
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_DTTMOUT)) {
-        sdio_interrupt_flag_clear(SDIO_INT_DTTMOUT);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        number_bytes = 0;
-        transerror = SD_DATA_TIMEOUT;
-        return transerror;
-    }
-
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_STBITE)) {
-        sdio_interrupt_flag_clear(SDIO_INT_STBITE);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        number_bytes = 0;
-        transerror = SD_START_BIT_ERROR;
-        return transerror;
-    }
-
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_TXURE)) {
-        sdio_interrupt_flag_clear(SDIO_INT_TXURE);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        number_bytes = 0;
-        transerror = SD_TX_UNDERRUN_ERROR;
-        return transerror;
-    }
-
-    if(RESET != sdio_interrupt_flag_get(SDIO_INT_FLAG_RXORE)) {
-        sdio_interrupt_flag_clear(SDIO_INT_RXORE);
-        /* disable all the interrupts */
-        sdio_interrupt_disable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_DTEND | SDIO_INT_STBITE |
-                               SDIO_INT_TFH | SDIO_INT_RFH | SDIO_INT_TXURE | SDIO_INT_RXORE);
-        number_bytes = 0;
-        transerror = SD_RX_OVERRUN_ERROR;
-        return transerror;
-    }
-    return transerror;
+/*!
+    \brief      check whether the request queue is idle
+    \param[in]  none
+    \param[out] none
+    \retval     1 if no request is pending or running, 0 otherwise
+*/
+uint8_t sd_queue_idle(void)
+{
+    return (SD_QUEUE_IDLE == queue_state) ? 1U : 0U;
+}
+
+/*!
+    \brief      get the statistics of the request queue
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_queue_stats_get(sd_queue_stats_struct *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = queue_stats;
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief      get the bus clock and the statistics of failed transfers
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_speed_stats_get(sd_speed_stats_struct *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = speed_stats;
+    __set_PRIMASK(primask);
 }
 
 /*!
@@ -2310,43 +2420,223 @@ static sd_error_enum sd_scr_get(uint16_t rca, uint32_t *pscr)
 }
 
 /*!
-    \brief      get the data block size
-    \param[in]  bytesnumber: the number of bytes
+    \brief      erase a continuous area of a card
+    \param[in]  startaddr: the start address in the unit of the card, bytes or blocks for SDHC
+    \param[in]  endaddr: the end address in the unit of the card
     \param[out] none
-    \retval     data block size
-      \arg        SDIO_DATABLOCKSIZE_1BYTE: block size = 1 byte
-      \arg        SDIO_DATABLOCKSIZE_2BYTES: block size = 2 bytes
-      \arg        SDIO_DATABLOCKSIZE_4BYTES: block size = 4 bytes
-      \arg        SDIO_DATABLOCKSIZE_8BYTES: block size = 8 bytes
-      \arg        SDIO_DATABLOCKSIZE_16BYTES: block size = 16 bytes
-      \arg        SDIO_DATABLOCKSIZE_32BYTES: block size = 32 bytes
-      \arg        SDIO_DATABLOCKSIZE_64BYTES: block size = 64 bytes
-      \arg        SDIO_DATABLOCKSIZE_128BYTES: block size = 128 bytes
-      \arg        SDIO_DATABLOCKSIZE_256BYTES: block size = 256 bytes
-      \arg        SDIO_DATABLOCKSIZE_512BYTES: block size = 512 bytes
-      \arg        SDIO_DATABLOCKSIZE_1024BYTES: block size = 1024 bytes
-      \arg        SDIO_DATABLOCKSIZE_2048BYTES: block size = 2048 bytes
-      \arg        SDIO_DATABLOCKSIZE_4096BYTES: block size = 4096 bytes
-      \arg        SDIO_DATABLOCKSIZE_8192BYTES: block size = 8192 bytes
-      \arg        SDIO_DATABLOCKSIZE_16384BYTES: block size = 16384 bytes
+    \retval     sd_error_enum
 */
-static uint32_t sd_datablocksize_get(uint16_t bytesnumber)
+static sd_error_enum sd_erase_range(uint32_t startaddr, uint32_t endaddr)
 {
-    uint8_t exp_val = 0;
-    /* calculate the exponent of 2 */
-    while(1 != bytesnumber) {
-        bytesnumber >>= 1;
-        ++exp_val;
+    /* initialize the variables */
+    sd_error_enum status = SD_OK;
+    uint32_t count = 0, clkdiv = 0;
+    __IO uint32_t delay = 0;
+    uint8_t cardstate = 0, tempbyte = 0;
+    uint16_t tempccc = 0;
+
+    if(SD_QUEUE_IDLE != queue_state) {
+        /* queued requests are still running */
+        status = SD_OPERATION_IMPROPER;
+        return status;
     }
-    return DATACTL_BLKSZ(exp_val);
-}
 
-/*!
-    \brief      configure the GPIO of SDIO interface
-    \param[in]  none
-    \param[out] none
-    \retval     none
-*/
+    /* get the card command classes from CSD */
+    tempbyte = (uint8_t)((sd_csd[1] & SD_MASK_24_31BITS) >> 24);
+    tempccc = (uint16_t)((uint16_t)tempbyte << 4);
+    tempbyte = (uint8_t)((sd_csd[1] & SD_MASK_16_23BITS) >> 16);
+    tempccc |= (uint16_t)((uint16_t)(tempbyte & 0xF0) >> 4);
+    if(0 == (tempccc & SD_CCC_ERASE)) {
+        /* don't support the erase command */
+        status = SD_FUNCTION_UNSUPPORTED;
+        return status;
+    }
+    clkdiv = (SDIO_CLKCTL & SDIO_CLKCTL_DIV);
+    clkdiv += ((SDIO_CLKCTL & SDIO_CLKCTL_DIV8) >> 31) * 256;
+    clkdiv += 2;
+    delay = 168000 / clkdiv;
+
+    /* check whether the card is locked */
+    if(sdio_response_get(SDIO_RESPONSE0) & SD_CARDSTATE_LOCKED) {
+        status = SD_LOCK_UNLOCK_FAILED;
+        return(status);
+    }
+
+    if((SDIO_STD_CAPACITY_SD_CARD_V1_1 == cardtype) || (SDIO_STD_CAPACITY_SD_CARD_V2_0 == cardtype) ||
+            (SDIO_HIGH_CAPACITY_SD_CARD == cardtype)) {
+        /* send CMD32(ERASE_WR_BLK_START) to set the address of the first write block to be erased */
+        sdio_command_response_config(SD_CMD_ERASE_WR_BLK_START, startaddr, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_WAITTYPE_NO);
+        sdio_csm_enable();
+        /* check if some error occurs */
+        status = r1_error_check(SD_CMD_ERASE_WR_BLK_START);
+        if(SD_OK != status) {
+            return status;
+        }
+
+        /* send CMD33(ERASE_WR_BLK_END) to set the address of the last write block of the continuous range to be erased */
+        sdio_command_response_config(SD_CMD_ERASE_WR_BLK_END, endaddr, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_WAITTYPE_NO);
+        sdio_csm_enable();
+        /* check if some error occurs */
+        status = r1_error_check(SD_CMD_ERASE_WR_BLK_END);
+        if(SD_OK != status) {
+            return status;
+        }
+    }
+
+    /* send CMD38(ERASE) to set the address of the first write block to be erased */
+    sdio_command_response_config(SD_CMD_ERASE, (uint32_t)0x0, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_ERASE);
+    if(SD_OK != status) {
+        return status;
+    }
+    /* loop until the counter is reach to the calculated time */
+    for(count = 0; count < delay; count++) {
+    }
+    /* get the card state and wait the card is out of programming and receiving state */
+    status = sd_card_state_get(&cardstate);
+    while((SD_OK == status) && ((SD_CARDSTATE_PROGRAMMING == cardstate) || (SD_CARDSTATE_RECEIVING == cardstate))) {
+        status = sd_card_state_get(&cardstate);
+    }
+    return status;
+}
+
+/*!
+    \brief      send CMD6(SWITCH_FUNC) and read the 512 bit switch status
+    \param[in]  argument: mode and function of each group
+    \param[out] pstatus: 16 words of switch status in bus order, byte 0 holds the bits [511:504]
+    \retval     sd_error_enum
+*/
+static sd_error_enum sd_switch_function(uint32_t argument, uint32_t *pstatus)
+{
+    sd_error_enum status = SD_OK;
+    uint32_t count = 0, idx = 0;
+
+    /* send CMD16(SET_BLOCKLEN) to set the block length */
+    sdio_command_response_config(SD_CMD_SET_BLOCKLEN, (uint32_t)64, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_SET_BLOCKLEN);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* configure the SDIO data transmission */
+    sdio_data_config(SD_DATATIMEOUT, (uint32_t)64, SDIO_DATABLOCKSIZE_64BYTES);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOSDIO);
+    sdio_dsm_enable();
+
+    /* send CMD6(SWITCH_FUNC) to check or switch the card functions */
+    sdio_command_response_config(SD_CMD_SWITCH_FUNC, argument, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_SWITCH_FUNC);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    while(!sdio_flag_get(SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTBLKEND | SDIO_FLAG_STBITE)) {
+        if(RESET != sdio_flag_get(SDIO_FLAG_RFH)) {
+            for(count = 0; (count < SD_FIFOHALF_WORDS) && (idx < 16U); count++) {
+                pstatus[idx++] = sdio_data_read();
+            }
+        }
+    }
+
+    /* whether some error occurs and return it */
+    if(RESET != sdio_flag_get(SDIO_FLAG_DTCRCERR)) {
+        status = SD_DATA_CRC_ERROR;
+        sdio_flag_clear(SDIO_FLAG_DTCRCERR);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_DTTMOUT)) {
+        status = SD_DATA_TIMEOUT;
+        sdio_flag_clear(SDIO_FLAG_DTTMOUT);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_RXORE)) {
+        status = SD_RX_OVERRUN_ERROR;
+        sdio_flag_clear(SDIO_FLAG_RXORE);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_STBITE)) {
+        status = SD_START_BIT_ERROR;
+        sdio_flag_clear(SDIO_FLAG_STBITE);
+        return status;
+    }
+    while((RESET != sdio_flag_get(SDIO_FLAG_RXDTVAL)) && (idx < 16U)) {
+        pstatus[idx++] = sdio_data_read();
+    }
+
+    /* clear the SDIO_INTC flags */
+    sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
+    return status;
+}
+
+/*!
+    \brief      get the data block size
+    \param[in]  bytesnumber: the number of bytes
+    \param[out] none
+    \retval     data block size
+      \arg        SDIO_DATABLOCKSIZE_1BYTE: block size = 1 byte
+      \arg        SDIO_DATABLOCKSIZE_2BYTES: block size = 2 bytes
+      \arg        SDIO_DATABLOCKSIZE_4BYTES: block size = 4 bytes
+      \arg        SDIO_DATABLOCKSIZE_8BYTES: block size = 8 bytes
+      \arg        SDIO_DATABLOCKSIZE_16BYTES: block size = 16 bytes
+      \arg        SDIO_DATABLOCKSIZE_32BYTES: block size = 32 bytes
+      \arg        SDIO_DATABLOCKSIZE_64BYTES: block size = 64 bytes
+      \arg        SDIO_DATABLOCKSIZE_128BYTES: block size = 128 bytes
+      \arg        SDIO_DATABLOCKSIZE_256BYTES: block size = 256 bytes
+      \arg        SDIO_DATABLOCKSIZE_512BYTES: block size = 512 bytes
+      \arg        SDIO_DATABLOCKSIZE_1024BYTES: block size = 1024 bytes
+      \arg        SDIO_DATABLOCKSIZE_2048BYTES: block size = 2048 bytes
+      \arg        SDIO_DATABLOCKSIZE_4096BYTES: block size = 4096 bytes
+      \arg        SDIO_DATABLOCKSIZE_8192BYTES: block size = 8192 bytes
+      \arg        SDIO_DATABLOCKSIZE_16384BYTES: block size = 16384 bytes
+*/
+static uint32_t sd_datablocksize_get(uint16_t bytesnumber)
+{
+    uint8_t exp_val = 0;
+    /* calculate the exponent of 2 */
+    while(1 != bytesnumber) {
+        bytesnumber >>= 1;
+        ++exp_val;
+    }
+    return DATACTL_BLKSZ(exp_val);
+}
+
+/*!
+    \brief      set the SDIO clock to a bus clock step
+    \param[in]  step: SD_CLK_STEP_HIGH_SPEED, SD_CLK_STEP_FAST or SD_CLK_STEP_TRANS
+    \param[out] none
+    \retval     none
+*/
+static void sd_clock_step_set(uint8_t step)
+{
+    if(SD_CLK_STEP_HIGH_SPEED == step) {
+        /* only a card in high speed mode latches data reliably at the full SDIOCLK */
+        sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_ENABLE, SDIO_CLOCKPWRSAVE_DISABLE, 0U);
+        speed_stats.clock = SD_SDIOCLK;
+    } else if(SD_CLK_STEP_FAST == step) {
+        sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_DISABLE, SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_FAST);
+        speed_stats.clock = SD_SDIOCLK / (SD_CLK_DIV_FAST + 2U);
+    } else {
+        step = SD_CLK_STEP_TRANS;
+        sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_DISABLE, SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_TRANS);
+        speed_stats.clock = SD_SDIOCLK / (SD_CLK_DIV_TRANS + 2U);
+    }
+    sd_clk_step = step;
+}
+
+/*!
+    \brief      configure the GPIO of SDIO interface
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
 static void gpio_config(void)
 {
     /* configure the SDIO_DAT0(PC8), SDIO_DAT1(PC9), SDIO_DAT2(PC10), SDIO_DAT3(PC11), SDIO_CLK(PC12) and SDIO_CMD(PD2) */
@@ -2380,13 +2670,14 @@ static void rcu_config(void)
 }
 
 /*!
-    \brief      configure the DMA1 channel 3 for transferring data
-    \param[in]  srcbuf: a pointer point to a buffer which will be transferred
-    \param[in]  bufsize: the size of buffer(not used in flow controller is peripheral)
+    \brief      configure the DMA1 channel 3 for a queued SDIO transfer
+    \param[in]  buffer: memory side of the transfer
+    \param[in]  direction: DMA_PERIPH_TO_MEMORY or DMA_MEMORY_TO_PERIPH
+    \param[in]  words: length of the first segment of a merged transfer, 0 lets the SDIO end the transfer
     \param[out] none
     \retval     none
 */
-static void dma_transfer_config(uint32_t *srcbuf, uint32_t bufsize)
+static void dma_config(uint32_t *buffer, uint32_t direction, uint32_t words)
 {
     dma_multi_data_parameter_struct dma_struct;
     /* clear all the interrupt flags */
@@ -2400,9 +2691,9 @@ static void dma_transfer_config(uint32_t *srcbuf, uint32_t bufsize)
 
     /* configure the DMA1 channel 3 */
     dma_struct.periph_addr = (uint32_t)SDIO_FIFO_ADDR;
-    dma_struct.memory0_addr = (uint32_t)srcbuf;
-    dma_struct.direction = DMA_MEMORY_TO_PERIPH;
-    dma_struct.number = 0;
+    dma_struct.memory0_addr = (uint32_t)buffer;
+    dma_struct.direction = direction;
+    dma_struct.number = words;
     dma_struct.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
     dma_struct.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
     dma_struct.periph_width = DMA_PERIPH_WIDTH_32BIT;
@@ -2410,51 +2701,335 @@ static void dma_transfer_config(uint32_t *srcbuf, uint32_t bufsize)
     dma_struct.priority = DMA_PRIORITY_ULTRA_HIGH;
     dma_struct.periph_burst_width = DMA_PERIPH_BURST_4_BEAT;
     dma_struct.memory_burst_width = DMA_MEMORY_BURST_4_BEAT;
-    dma_struct.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
     dma_struct.critical_value = DMA_FIFO_4_WORD;
+    dma_struct.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
     dma_multi_data_mode_init(DMA1, DMA_CH3, &dma_struct);
 
-    dma_flow_controller_config(DMA1, DMA_CH3, DMA_FLOW_CONTROLLER_PERI);
+    if(0U == words) {
+        dma_flow_controller_config(DMA1, DMA_CH3, DMA_FLOW_CONTROLLER_PERI);
+        dma_interrupt_enable(DMA1, DMA_CH3, DMA_INT_TAE);
+    } else {
+        /* the DMA counts each segment itself and interrupts to move on to the next buffer */
+        dma_flow_controller_config(DMA1, DMA_CH3, DMA_FLOW_CONTROLLER_DMA);
+        dma_interrupt_enable(DMA1, DMA_CH3, DMA_INT_TAE);
+        dma_interrupt_enable(DMA1, DMA_CH3, DMA_INT_FTF);
+    }
     dma_channel_subperipheral_select(DMA1, DMA_CH3, DMA_SUBPERI4);
     dma_channel_enable(DMA1, DMA_CH3);
 }
 
 /*!
-    \brief      configure the DMA1 channel 3 for receiving data
-    \param[in]  dstbuf: a pointer point to a buffer which will receive data
-    \param[in]  bufsize: the size of buffer(not used in flow controller is peripheral)
+    \brief      run a blocking transfer through the request queue
+    \param[in]  buffer: data of blocksnumber blocks, word aligned
+    \param[in]  addr: byte address on the card, a multiple of 512
+    \param[in]  blocksize: the data block size, only 512 is supported in DMA mode
+    \param[in]  blocksnumber: number of blocks
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[out] none
+    \retval     sd_error_enum
+*/
+static sd_error_enum sd_queue_transfer(uint32_t *buffer, uint32_t addr, uint16_t blocksize, uint32_t blocksnumber, uint8_t direction)
+{
+    sd_request_struct request;
+    sd_error_enum status;
+
+    /* blocksize is fixed in 512B for SDHC card, the queue uses 512 byte blocks for all cards */
+    if(((512U != blocksize) && (SDIO_HIGH_CAPACITY_SD_CARD != cardtype)) || (0U != (addr & 0x1FFU))) {
+        return SD_PARAMETER_INVALID;
+    }
+
+    request.buffer = buffer;
+    request.block = addr / 512U;
+    request.count = blocksnumber;
+    request.direction = direction;
+    request.callback = NULL;
+    request.arg = NULL;
+
+    status = sd_request_submit(&request);
+    if(SD_OK != status) {
+        return status;
+    }
+    while(0U == request.done) {
+        sd_queue_process();
+    }
+    return request.status;
+}
+
+/*!
+    \brief      start the next transfer of the queue or go idle, the caller owns the engine
+    \param[in]  none
     \param[out] none
     \retval     none
 */
-static void dma_receive_config(uint32_t *dstbuf, uint32_t bufsize)
+static void sd_queue_start(void)
 {
-    dma_multi_data_parameter_struct dma_struct;
-    /* clear all the interrupt flags */
-    dma_flag_clear(DMA1, DMA_CH3, DMA_FLAG_FEE);
-    dma_flag_clear(DMA1, DMA_CH3, DMA_FLAG_SDE);
-    dma_flag_clear(DMA1, DMA_CH3, DMA_FLAG_TAE);
-    dma_flag_clear(DMA1, DMA_CH3, DMA_FLAG_HTF);
-    dma_flag_clear(DMA1, DMA_CH3, DMA_FLAG_FTF);
+    sd_request_struct *last;
+    uint32_t primask;
+    uint32_t blocks;
+    sd_error_enum status;
+
+    while(1) {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        if(NULL == queue_head) {
+            /* in the same critical section as the check, so a concurrent submit starts the engine itself */
+            queue_state = SD_QUEUE_IDLE;
+            __set_PRIMASK(primask);
+            return;
+        }
+
+        /* take the first request and every following one that continues it on the card */
+        queue_batch = queue_head;
+        last = queue_head;
+        blocks = last->count;
+        queue_head = last->next;
+        while((NULL != queue_head) && (queue_head->direction == queue_batch->direction) &&
+                (queue_head->block == last->block + last->count) && (blocks + queue_head->count <= SD_QUEUE_MAX_BLOCKS)) {
+            last = queue_head;
+            blocks += last->count;
+            queue_head = last->next;
+            queue_stats.merged++;
+        }
+        last->next = NULL;
+        if(NULL == queue_head) {
+            queue_tail = NULL;
+        }
+        queue_stats.transfers++;
+        queue_stats.blocks += blocks;
+        __set_PRIMASK(primask);
+
+        queue_batch_retries = 0;
+
+        status = sd_queue_batch_issue();
+        if(SD_OK == status) {
+            /* the SDIO interrupt takes over */
+            return;
+        }
+        sd_queue_batch_complete(status);
+    }
+}
+
+/*!
+    \brief      send the commands of the transfer in queue_batch and start its data phase
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+static sd_error_enum sd_queue_batch_issue(void)
+{
+    sd_request_struct *request;
+    sd_error_enum status = SD_OK;
+    uint32_t blocks = 0, addr = queue_batch->block;
+    uint32_t words;
+    uint8_t cmdindex;
+
+    for(request = queue_batch; NULL != request; request = request->next) {
+        blocks += request->count;
+    }
+    /* a single request lets the SDIO end the DMA, merged ones switch buffers per request */
+    words = (NULL == queue_batch->next) ? 0U : (queue_batch->count * SD_BLOCK_WORDS);
+
+    queue_segment = queue_batch;
+    queue_batch_status = SD_OK;
+    stopcondition = (blocks > 1U) ? 1U : 0U;
+
+    /* clear all DSM configuration */
+    sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOCARD);
+    sdio_dsm_disable();
+    sdio_dma_disable();
+    sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
+
+    if(SDIO_HIGH_CAPACITY_SD_CARD != cardtype) {
+        addr *= 512U;
+        /* send CMD16(SET_BLOCKLEN) to set the block length */
+        sdio_command_response_config(SD_CMD_SET_BLOCKLEN, (uint32_t)512U, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_WAITTYPE_NO);
+        sdio_csm_enable();
+        status = r1_error_check(SD_CMD_SET_BLOCKLEN);
+        if(SD_OK != status) {
+            return status;
+        }
+    }
+
+    if(SD_REQUEST_READ == queue_batch->direction) {
+        /* configure the SDIO data transmission before the command, the card answers with data */
+        sdio_data_config(SD_DATATIMEOUT, blocks * 512U, SDIO_DATABLOCKSIZE_512BYTES);
+        sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOSDIO);
+        sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND | SDIO_INT_STBITE);
+        /* stop the card clock instead of overrunning the FIFO while the DMA moves to the next segment */
+        sdio_hardware_clock_enable();
+        sdio_dma_enable();
+        dma_config(queue_batch->buffer, DMA_PERIPH_TO_MEMORY, words);
+        sdio_dsm_enable();
+
+        /* send CMD17(READ_SINGLE_BLOCK) or CMD18(READ_MULTIPLE_BLOCK) */
+        cmdindex = (blocks > 1U) ? SD_CMD_READ_MULTIPLE_BLOCK : SD_CMD_READ_SINGLE_BLOCK;
+        sdio_command_response_config(cmdindex, addr, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_WAITTYPE_NO);
+        sdio_csm_enable();
+        status = r1_error_check(cmdindex);
+    } else {
+        if((blocks > 1U) && ((SDIO_STD_CAPACITY_SD_CARD_V1_1 == cardtype) || (SDIO_STD_CAPACITY_SD_CARD_V2_0 == cardtype) ||
+                (SDIO_HIGH_CAPACITY_SD_CARD == cardtype))) {
+            /* send CMD55(APP_CMD) to indicate next command is application specific command */
+            sdio_command_response_config(SD_CMD_APP_CMD, (uint32_t)sd_rca << SD_RCA_SHIFT, SDIO_RESPONSETYPE_SHORT);
+            sdio_wait_type_set(SDIO_WAITTYPE_NO);
+            sdio_csm_enable();
+            status = r1_error_check(SD_CMD_APP_CMD);
+            if(SD_OK != status) {
+                return status;
+            }
+
+            /* send ACMD23(SET_WR_BLK_ERASE_COUNT) to set the number of write blocks to be preerased before writing */
+            sdio_command_response_config(SD_APPCMD_SET_WR_BLK_ERASE_COUNT, blocks, SDIO_RESPONSETYPE_SHORT);
+            sdio_wait_type_set(SDIO_WAITTYPE_NO);
+            sdio_csm_enable();
+            status = r1_error_check(SD_APPCMD_SET_WR_BLK_ERASE_COUNT);
+            if(SD_OK != status) {
+                return status;
+            }
+        }
+
+        /* send CMD24(WRITE_BLOCK) or CMD25(WRITE_MULTIPLE_BLOCK) */
+        cmdindex = (blocks > 1U) ? SD_CMD_WRITE_MULTIPLE_BLOCK : SD_CMD_WRITE_BLOCK;
+        sdio_command_response_config(cmdindex, addr, SDIO_RESPONSETYPE_SHORT);
+        sdio_wait_type_set(SDIO_WAITTYPE_NO);
+        sdio_csm_enable();
+        status = r1_error_check(cmdindex);
+        if(SD_OK != status) {
+            return status;
+        }
+
+        /* configure the SDIO data transmission */
+        sdio_data_config(SD_DATATIMEOUT, blocks * 512U, SDIO_DATABLOCKSIZE_512BYTES);
+        sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOCARD);
+        sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_TXURE | SDIO_INT_DTEND | SDIO_INT_STBITE);
+        /* stop the card clock instead of underrunning the FIFO while the DMA moves to the next segment */
+        sdio_hardware_clock_enable();
+        sdio_dma_enable();
+        dma_config(queue_batch->buffer, DMA_MEMORY_TO_PERIPH, words);
+        sdio_dsm_enable();
+    }
+
+    if(SD_OK != status) {
+        /* the card did not accept the read command, undo the data phase setup */
+        sdio_interrupt_disable(SD_INTS_TRANSFER);
+        sdio_dsm_disable();
+        sdio_dma_disable();
+        dma_channel_disable(DMA1, DMA_CH3);
+        sdio_hardware_clock_disable();
+    }
+    return status;
+}
+
+/*!
+    \brief      end the data phase of the running transfer, runs in the SDIO or DMA interrupt
+    \param[in]  status: result of the data phase
+    \param[out] none
+    \retval     none
+*/
+static void sd_queue_transfer_end(sd_error_enum status)
+{
+    sd_error_enum stopstatus;
+    __IO uint32_t timeout = 100000;
+
+    if((SD_OK == status) && (SD_REQUEST_READ == queue_batch->direction)) {
+        /* the last words may still be in the FIFO, the channel disables itself once they are stored */
+        while((DMA_CHCTL(DMA1, DMA_CH3) & DMA_CHXCTL_CHEN) && (timeout > 0)) {
+            --timeout;
+        }
+        if(0 == timeout) {
+            status = SD_ERROR;
+        }
+    }
+
+    dma_interrupt_disable(DMA1, DMA_CH3, DMA_INT_TAE);
+    dma_interrupt_disable(DMA1, DMA_CH3, DMA_INT_FTF);
     dma_channel_disable(DMA1, DMA_CH3);
-    dma_deinit(DMA1, DMA_CH3);
+    sdio_dsm_disable();
+    sdio_dma_disable();
+    sdio_hardware_clock_disable();
+    queue_segment = NULL;
 
-    /* configure the DMA1 channel 3 */
-    dma_struct.periph_addr = (uint32_t)SDIO_FIFO_ADDR;
-    dma_struct.memory0_addr = (uint32_t)dstbuf;
-    dma_struct.direction = DMA_PERIPH_TO_MEMORY;
-    dma_struct.number = 0;
-    dma_struct.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
-    dma_struct.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
-    dma_struct.periph_width = DMA_PERIPH_WIDTH_32BIT;
-    dma_struct.memory_width = DMA_MEMORY_WIDTH_32BIT;
-    dma_struct.priority = DMA_PRIORITY_ULTRA_HIGH;
-    dma_struct.periph_burst_width = DMA_PERIPH_BURST_4_BEAT;
-    dma_struct.memory_burst_width = DMA_MEMORY_BURST_4_BEAT;
-    dma_struct.critical_value = DMA_FIFO_4_WORD;
-    dma_struct.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
-    dma_multi_data_mode_init(DMA1, DMA_CH3, &dma_struct);
+    /* send CMD12 to stop data transfer in multipule blocks operation, also after an error */
+    if(1U == stopcondition) {
+        stopstatus = sd_transfer_stop();
+        if(SD_OK == status) {
+            status = stopstatus;
+        }
+    }
 
-    dma_flow_controller_config(DMA1, DMA_CH3, DMA_FLOW_CONTROLLER_PERI);
-    dma_channel_subperipheral_select(DMA1, DMA_CH3, DMA_SUBPERI4);
-    dma_channel_enable(DMA1, DMA_CH3);
+    if(SD_REQUEST_WRITE == queue_batch->direction) {
+        /* the requests complete or repeat once the card has programmed the data, see sd_queue_process() */
+        queue_batch_status = status;
+        queue_state = SD_QUEUE_PROGRAMMING;
+    } else {
+        if(sd_queue_retry(status)) {
+            status = sd_queue_batch_issue();
+            if(SD_OK == status) {
+                return;
+            }
+        }
+        sd_queue_batch_complete(status);
+        sd_queue_start();
+    }
+}
+
+/*!
+    \brief      complete all requests of the running transfer
+    \param[in]  status: result handed to the requests
+    \param[out] none
+    \retval     none
+*/
+static void sd_queue_batch_complete(sd_error_enum status)
+{
+    sd_request_struct *request = queue_batch;
+    sd_request_struct *next;
+
+    queue_batch = NULL;
+    if(SD_OK != status) {
+        queue_stats.errors++;
+    }
+
+    while(NULL != request) {
+        /* the callback may submit the request again, which reuses its link */
+        next = request->next;
+        request->status = status;
+        request->done = 1;
+        if(NULL != request->callback) {
+            request->callback(request);
+        }
+        request = next;
+    }
+}
+
+/*!
+    \brief      count a failed transfer and decide whether to repeat it at a lower clock
+    \param[in]  status: result of the transfer
+    \param[out] none
+    \retval     1 if the transfer in queue_batch has to be issued again, 0 otherwise
+*/
+static uint8_t sd_queue_retry(sd_error_enum status)
+{
+    if(SD_DATA_CRC_ERROR == status) {
+        speed_stats.crc_errors++;
+    } else if(SD_DATA_TIMEOUT == status) {
+        speed_stats.timeouts++;
+    } else {
+        return 0U;
+    }
+
+    if(queue_batch_retries >= SD_TRANSFER_RETRIES) {
+        return 0U;
+    }
+    queue_batch_retries++;
+    speed_stats.retries++;
+
+    /* signal integrity errors get worse with the clock, repeat the transfer one step slower */
+    if(SD_CLK_STEP_TRANS != sd_clk_step) {
+        sd_clock_step_set(sd_clk_step + 1U);
+        speed_stats.fallbacks++;
+    }
+    return 1U;
 }
@@ -90,6 +90,15 @@ OF SUCH DAMAGE.
 #define SD_DMA_MODE                           ((uint32_t)0x00000000) /* DMA mode */
 #define SD_POLLING_MODE                       ((uint32_t)0x00000001) /* polling mode */
 
+/* direction of a queued request */
+#define SD_REQUEST_READ                       ((uint8_t)0x00)        /* read blocks from the card */
+#define SD_REQUEST_WRITE                      ((uint8_t)0x01)        /* write blocks to the card */
+
+/* most blocks that adjacent requests are merged to in one CMD18/CMD25 transfer */
+#ifndef SD_QUEUE_MAX_BLOCKS
+#define SD_QUEUE_MAX_BLOCKS                   ((uint32_t)128)
+#endif /* SD_QUEUE_MAX_BLOCKS */
+
 /* lock unlock status */
 #define SD_LOCK                               ((uint8_t)0x05)        /* lock the SD card */
 #define SD_UNLOCK                             ((uint8_t)0x02)        /* unlock the SD card */
@@ -197,6 +206,43 @@ typedef enum {
     SD_OK                                 /* no error occurred */
 } sd_error_enum;
 
+struct sd_request;
+
+/* completion callback of a queued request, runs in the SDIO interrupt or in sd_queue_process() */
+typedef void (*sd_request_callback)(struct sd_request *request);
+
+/* queued block transfer, owned by the driver from sd_request_submit() until done is set */
+typedef struct sd_request {
+    uint32_t *buffer;                     /* word aligned data of count * 512 bytes */
+    uint32_t block;                       /* first block in 512 byte units */
+    uint32_t count;                       /* number of blocks */
+    uint8_t direction;                    /* SD_REQUEST_READ or SD_REQUEST_WRITE */
+    sd_request_callback callback;         /* called after done is set, may be NULL */
+    void *arg;                            /* free for the caller */
+    __IO sd_error_enum status;            /* result of the request, valid once done is set */
+    __IO uint8_t done;                    /* the request completed */
+    struct sd_request *next;              /* queue link, used by the driver */
+} sd_request_struct;
+
+/* statistics of the request queue */
+typedef struct {
+    uint32_t requests;                    /* submitted requests */
+    uint32_t transfers;                   /* CMD17/CMD18/CMD24/CMD25 transfers issued */
+    uint32_t merged;                      /* requests that joined the transfer of a previous one */
+    uint32_t blocks;                      /* blocks moved by the transfers */
+    uint32_t errors;                      /* transfers that ended with an error */
+} sd_queue_stats_struct;
+
+/* bus clock and statistics of failed transfers */
+typedef struct {
+    uint32_t clock;                       /* current SDIO_CLK in Hz */
+    uint8_t high_speed;                   /* the card was switched to high speed mode */
+    uint32_t crc_errors;                  /* queued transfers that ended with a data CRC error */
+    uint32_t timeouts;                    /* queued transfers that ended with a data timeout */
+    uint32_t retries;                     /* queued transfers that were issued again */
+    uint32_t fallbacks;                   /* steps the bus clock was lowered */
+} sd_speed_stats_struct;
+
 typedef enum {
     SD_NO_TRANSFER = 0,                     /* no data transfer is acting */
     SD_TRANSFER_IN_PROGRESS                 /* data transfer is in progress */
@@ -218,6 +264,8 @@ sd_error_enum sd_power_off(void);
 sd_error_enum sd_bus_mode_config(uint32_t busmode);
 /* configure the mode of transmission */
 sd_error_enum sd_transfer_mode_config(uint32_t txmode);
+/* switch the card to high speed mode if it supports it and raise the bus clock */
+sd_error_enum sd_high_speed_config(void);
 
 /* read a block data into a buffer from the specified address of a card */
 sd_error_enum sd_block_read(uint32_t *preadbuffer, uint32_t readaddr, uint16_t blocksize);
@@ -229,8 +277,23 @@ sd_error_enum sd_block_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_
 sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_t blocksize, uint32_t blocksnumber);
 /* erase a continuous area of a card */
 sd_error_enum sd_erase(uint32_t startaddr, uint32_t endaddr);
+/* erase a continuous area of a card given in 512 byte blocks */
+sd_error_enum sd_blocks_erase(uint32_t startblock, uint32_t endblock);
 /* process all the interrupts which the corresponding flags are set */
 sd_error_enum sd_interrupts_process(void);
+/* process the DMA interrupt of a queued transfer */
+void sd_dma_interrupts_process(void);
+
+/* queue a block transfer, it runs in the background in DMA mode */
+sd_error_enum sd_request_submit(sd_request_struct *request);
+/* finish a write once the card has programmed the data, call from the main loop */
+void sd_queue_process(void);
+/* check whether the request queue is idle */
+uint8_t sd_queue_idle(void);
+/* get the statistics of the request queue */
+void sd_queue_stats_get(sd_queue_stats_struct *stats);
+/* get the bus clock and the statistics of failed transfers */
+void sd_speed_stats_get(sd_speed_stats_struct *stats);
 
 /* select or deselect a card */
 sd_error_enum sd_card_select_deselect(uint16_t cardrca);
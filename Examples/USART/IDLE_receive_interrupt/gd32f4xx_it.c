@@ -35,8 +35,7 @@ OF SUCH DAMAGE.
 #include "gd32f4xx_it.h"
 #include "gd32f450i_eval.h"
 
-extern uint8_t rx_count;
-extern uint8_t receive_flag;
+extern void usart_rx_dma_update(void);
 
 /*!
     \brief      this function handles NMI exception
@@ -155,15 +154,22 @@ void USART0_IRQHandler(void)
         usart_data_receive(USART0);
         /* toggle the LED2 */
         gd_eval_led_toggle(LED2);
-        
-        /* number of data received */
-        rx_count = 256 - (dma_transfer_number_get(DMA1, DMA_CH2));
-        receive_flag = 1;
-        
-        /* disable DMA and reconfigure */
-        dma_channel_disable(DMA1, DMA_CH2);
-        dma_flag_clear(DMA1, DMA_CH2, DMA_FLAG_FTF);
-        dma_transfer_number_config(DMA1, DMA_CH2, 256);
-        dma_channel_enable(DMA1, DMA_CH2);
+    }
+
+    /* publish the received bytes and restart DMA, also entered by main() after the ring was full */
+    usart_rx_dma_update();
+}
+
+/*!
+    \brief      this function handles DMA1 channel2 exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void DMA1_Channel2_IRQHandler(void)
+{
+    if(RESET != dma_interrupt_flag_get(DMA1, DMA_CH2, DMA_INT_FLAG_FTF)){
+        /* the span up to the ring wrap is full, continue at the start of the ring */
+        usart_rx_dma_update();
     }
 }
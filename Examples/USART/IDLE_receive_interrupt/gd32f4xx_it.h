@@ -58,4 +58,6 @@ void PendSV_Handler(void);
 void SysTick_Handler(void);
 /* USART0 handle function */
 void USART0_IRQHandler(void);
+/* DMA1 channel2 handle function */
+void DMA1_Channel2_IRQHandler(void);
 #endif /* GD32F10X_IT_H */
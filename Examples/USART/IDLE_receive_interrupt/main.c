@@ -35,17 +35,20 @@ OF SUCH DAMAGE.
 #include <stdio.h>
 #include "gd32f4xx.h"
 #include "gd32f450i_eval.h"
+#include "spsc_ring.h"
 
 #define USART0_RDATA_ADDRESS      ((uint32_t)&USART_DATA(USART0))
+#define RX_RING_SIZE              512U
 
-uint8_t rxbuffer[256];
-__IO uint8_t rx_count = 0;
-__IO uint8_t tx_count = 0;
-__IO uint8_t receive_flag = 0;
+static uint8_t rx_storage[RX_RING_SIZE] __attribute__((aligned(4)));
+static spsc_ring_struct rx_ring;
+/* number of bytes the running DMA transfer was started with, 0 while the ring is full */
+static __IO uint32_t rx_armed = 0;
 
 void dma_config(void);
 void usart_config(void);
 void nvic_config(void);
+void usart_rx_dma_update(void);
 
 /*!
     \brief      main function
@@ -55,8 +58,13 @@ void nvic_config(void);
 */
 int main(void)
 {
+    const uint8_t *data;
+    uint32_t count;
+    uint32_t i;
+
     gd_eval_led_init(LED2);
     gd_eval_led_on(LED2);
+    spsc_ring_init(&rx_ring, rx_storage, 1U, RX_RING_SIZE);
     nvic_config();
     
     /* initialize DMA */
@@ -66,17 +74,55 @@ int main(void)
     usart_config();
 
     usart_interrupt_enable(USART0, USART_INT_IDLE);
-    printf("\n\rPlease send data less than 256 bytes:\n\r");
+    printf("\n\rPlease send data:\n\r");
 
-    /* wait the data is received and send to the hyperterminal */
+    /* send the received data back to the hyperterminal straight out of the ring */
     while(1){
-        if(1 == receive_flag){
-            for(tx_count = 0; tx_count < rx_count; tx_count++){
-                while(RESET == usart_flag_get(EVAL_COM0, USART_FLAG_TBE));
-                usart_data_transmit(EVAL_COM0, rxbuffer[tx_count]);
-            }
-            receive_flag = 0;
+        data = spsc_ring_read_span(&rx_ring, &count);
+        if(0U == count){
+            continue;
+        }
+        for(i = 0U; i < count; i++){
+            while(RESET == usart_flag_get(EVAL_COM0, USART_FLAG_TBE));
+            usart_data_transmit(EVAL_COM0, data[i]);
+        }
+        spsc_ring_consume(&rx_ring, count);
+
+        /* the receiver stopped on a full ring, let the USART interrupt restart it */
+        if(0U == rx_armed){
+            NVIC_SetPendingIRQ(USART0_IRQn);
+        }
+    }
+}
+
+/*!
+    \brief      hand the bytes of the running DMA transfer to the ring and restart it on the free space
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usart_rx_dma_update(void)
+{
+    void *span;
+    uint32_t count;
+
+    if(0U != rx_armed){
+        dma_channel_disable(DMA1, DMA_CH2);
+        /* the channel finishes a byte in flight before it stops */
+        while(DMA_CHCTL(DMA1, DMA_CH2) & DMA_CHXCTL_CHEN){
         }
+        spsc_ring_commit(&rx_ring, rx_armed - dma_transfer_number_get(DMA1, DMA_CH2));
+        rx_armed = 0U;
+    }
+    dma_interrupt_flag_clear(DMA1, DMA_CH2, DMA_INT_FLAG_FTF);
+
+    /* the span ends at the ring wrap, a full span completes with a DMA interrupt */
+    span = spsc_ring_write_span(&rx_ring, &count);
+    if(0U != count){
+        dma_memory_address_config(DMA1, DMA_CH2, DMA_MEMORY_0, (uint32_t)span);
+        dma_transfer_number_config(DMA1, DMA_CH2, count);
+        rx_armed = count;
+        dma_channel_enable(DMA1, DMA_CH2);
     }
 }
 
@@ -94,9 +140,9 @@ void dma_config(void)
     
     dma_deinit(DMA1, DMA_CH2);
     dma_init_struct.direction = DMA_PERIPH_TO_MEMORY;
-    dma_init_struct.memory0_addr = (uint32_t)rxbuffer;
+    dma_init_struct.memory0_addr = (uint32_t)rx_storage;
     dma_init_struct.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
-    dma_init_struct.number = 256;
+    dma_init_struct.number = RX_RING_SIZE;
     dma_init_struct.periph_addr = USART0_RDATA_ADDRESS;
     dma_init_struct.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
     dma_init_struct.periph_memory_width = DMA_PERIPH_WIDTH_8BIT;
@@ -106,8 +152,9 @@ void dma_config(void)
     /* configure DMA mode */
     dma_circulation_disable(DMA1, DMA_CH2);
     dma_channel_subperipheral_select(DMA1, DMA_CH2, DMA_SUBPERI4);
-    /* enable DMA1 channel2 */
-    dma_channel_enable(DMA1, DMA_CH2);
+    dma_interrupt_enable(DMA1, DMA_CH2, DMA_CHXCTL_FTFIE);
+    /* point DMA1 channel2 at the ring and enable it */
+    usart_rx_dma_update();
 }
 
 /*!
@@ -155,7 +202,9 @@ void usart_config(void)
 */
 void nvic_config(void)
 {
+    /* same priority, so the two handlers never interrupt each other while updating the ring */
     nvic_irq_enable(USART0_IRQn, 0, 0);
+    nvic_irq_enable(DMA1_Channel2_IRQn, 0, 0);
 }
 
 /* retarget the C library printf function to the USART */
@@ -130,6 +130,8 @@ void codec_i2s_dma_deinit(void);
 void audio_play(uint32_t addr, uint32_t size);
 /* pauses or resumes the audio stream playing from the media */
 void audio_pause_resume(uint32_t cmd, uint32_t addr, uint32_t size);
+/* bytes of the current play transfer the DMA has not read yet */
+uint32_t audio_play_remaining(void);
 /* stops audio stream playing on the used media */
 void audio_stop(void);
 
@@ -77,7 +77,12 @@ OF SUCH DAMAGE.
         #define USB_EMBEDDED_PHY_ENABLED
     #endif
 
-//    #define USB_HS_INTERNAL_DMA_ENABLED
+    /* endpoint buffers of the classes and the application are word aligned (__ALIGN_BEGIN,
+       __ALIGN_END) and in SRAM0..SRAM2, the DMA has no access to the TCMSRAM */
+    #ifdef USE_USB_HS_DMA
+        #define USB_HS_INTERNAL_DMA_ENABLED
+    #endif
+
 //    #define USB_HS_DEDICATED_EP1_ENABLED
 
     #define USBHS_SOF_OUTPUT                        0U
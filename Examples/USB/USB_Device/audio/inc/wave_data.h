@@ -36,7 +36,7 @@ OF SUCH DAMAGE.
 #define WAVE_DATA_H
 
 /* wave data */
-const char wavetestdata[] = {
+__ALIGN_BEGIN const char wavetestdata[] __ALIGN_END = {
 0x52 , 0x49 , 0x46 , 0x46 , 0x64 , 0xDA , 0x00 , 0x00 , 0x57 , 0x41 , 0x56 , 0x45 , 0x66 , 0x6D , 0x74 , 0x20 ,
 0x10 , 0x00 , 0x00 , 0x00 , 0x01 , 0x00 , 0x02 , 0x00 , 0x40 , 0x1F , 0x00 , 0x00 , 0x00 , 0x7D , 0x00 , 0x00 ,
 0x04 , 0x00 , 0x10 , 0x00 , 0x64 , 0x61 , 0x74 , 0x61 , 0x40 , 0xDA , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 , 0x00 ,
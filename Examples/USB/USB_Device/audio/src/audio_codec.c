@@ -318,6 +318,17 @@ void audio_pause_resume(uint32_t cmd, uint32_t addr, uint32_t size)
     }
 }
 
+/*!
+    \brief      bytes of the current play transfer the DMA has not read yet
+    \param[in]  none
+    \param[out] none
+    \retval     bytes
+*/
+uint32_t audio_play_remaining(void)
+{
+    return DMA_CHCNT(AD_DMA, AD_DMA_CHANNEL) * 2U;
+}
+
 /*!
     \brief      stops audio stream playing on the used media
     \param[in]  none
@@ -351,26 +362,15 @@ void audio_stop(void)
 */
 void AD_DMA_IRQHandler(void)
 {
-    uint16_t remain_size = 0U;
+    uint8_t *buf;
+    uint32_t len;
 
     /* transfer complete interrupt */
     if(RESET != dma_flag_get(AD_DMA, AD_DMA_CHANNEL, AD_DMA_FLAG_TC)) {
-        /* increment to the next sub-buffer */
-        audio_handler.isoc_out_rdptr += audio_handler.dam_tx_len;
+        /* next part of the speaker buffer, none if it ran empty */
+        len = usbd_audio_spk_dma_done(&buf);
 
-        if(audio_handler.isoc_out_rdptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
-            /* roll back to the start of buffer */
-            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
-        }
-
-        if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr) {
-            remain_size = audio_handler.isoc_out_wrptr - audio_handler.isoc_out_rdptr;
-        } else {
-            remain_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_buff - audio_handler.isoc_out_rdptr;
-        }
-
-        /* check if the end of file has been reached */
-        if(remain_size > 0U) {
+        if(len > 0U) {
             dma_channel_disable(AD_DMA, AD_DMA_CHANNEL);
 
             /* clear the Interrupt flag */
@@ -379,12 +379,9 @@ void AD_DMA_IRQHandler(void)
             /* clear the Interrupt flag */
             dma_interrupt_flag_clear(AD_DMA, AD_DMA_CHANNEL, AD_DMA_INT_FLAG_TE);
 
-            DMA_CHM0ADDR(AD_DMA, AD_DMA_CHANNEL) = (uint32_t)audio_handler.isoc_out_rdptr;
-
-            DMA_CHCNT(AD_DMA, AD_DMA_CHANNEL) = (uint32_t)(remain_size / 2U);
+            DMA_CHM0ADDR(AD_DMA, AD_DMA_CHANNEL) = (uint32_t)buf;
 
-            /* update the current DMA tx data length */
-            audio_handler.dam_tx_len = (remain_size / 2U) * 2U;
+            DMA_CHCNT(AD_DMA, AD_DMA_CHANNEL) = len / 2U;
 
             dma_channel_enable(AD_DMA, AD_DMA_CHANNEL);
         } else {
@@ -393,10 +390,6 @@ void AD_DMA_IRQHandler(void)
 
             /* clear the Interrupt flag */
             dma_interrupt_flag_clear(AD_DMA, AD_DMA_CHANNEL, DMA_INT_FLAG_FTF);
-
-            /* clear flag */
-            audio_handler.dam_tx_len = 0U;
-            audio_handler.play_flag = 0U;
         }
     }
 }
@@ -37,6 +37,8 @@ OF SUCH DAMAGE.
 
 usb_core_driver cdc_acm;
 
+static uint8_t echo_buf[USB_CDC_STREAM_XFER_SIZE];
+
 /*!
     \brief      main routine will construct a USB CDC device
     \param[in]  none
@@ -63,10 +65,19 @@ int main(void)
     /* main loop */
     while(1) {
         if(USBD_CONFIGURED == cdc_acm.dev.cur_status) {
-            if(0U == cdc_acm_check_ready(&cdc_acm)) {
-                cdc_acm_data_receive(&cdc_acm);
-            } else {
-                cdc_acm_data_send(&cdc_acm);
+            uint32_t len;
+
+            cdc_acm_stream_start(&cdc_acm);
+
+            /* loop back no more than the TX ring takes, the rest waits in the receive buffers */
+            len = cdc_acm_stream_tx_space(&cdc_acm);
+            if(len > sizeof(echo_buf)) {
+                len = sizeof(echo_buf);
+            }
+
+            len = cdc_acm_stream_read(&cdc_acm, echo_buf, len);
+            if(0U != len) {
+                (void)cdc_acm_stream_write(&cdc_acm, echo_buf, len);
             }
         }
     }
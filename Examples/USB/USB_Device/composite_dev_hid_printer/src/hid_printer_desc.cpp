@@ -0,0 +1,89 @@
+#include <cstdint>
+
+#include "usbd_desc.hpp"
+
+extern "C" {
+#include "hid_printer_wrapper.h"
+}
+
+/*
+	Descriptors and class driver of the HID/printer composite device built by usbd_desc.hpp.
+
+	Replaces hid_printer_wrapper.c in the CMake build and gives the same descriptor bytes: the
+	endpoint numbers stay those of usbd_conf.h, since the HID and printer classes open their
+	endpoints from their own descriptors. The wrapper stays for the IDE projects.
+*/
+
+namespace {
+	namespace desc = usbd::desc;
+
+	constexpr std::uint16_t usbd_vid = 0x28E9U;
+	constexpr std::uint16_t usbd_pid = 0x325AU;
+
+#ifdef USE_USB_HS
+	constexpr std::uint8_t core_endpoints = USBHS_MAX_EP_COUNT;
+#else
+	constexpr std::uint8_t core_endpoints = USBFS_MAX_EP_COUNT;
+#endif
+
+	alignas(4) constexpr auto device_desc = desc::device({
+		0x0200U,
+		0x00U,
+		0x00U,
+		0x00U,
+		USB_FS_EP0_MAX_LEN,
+		usbd_vid,
+		usbd_pid,
+		0x0100U,
+		STR_IDX_MFC,
+		STR_IDX_PRODUCT,
+		STR_IDX_SERIAL,
+		USBD_CFG_MAX_NUM,
+	});
+
+	constexpr auto config = desc::configuration(
+		{0x80U, 0x32U, core_endpoints},
+		desc::function(usbd_custom_hid_cb,
+			desc::interface(0x03U, 0x00U, 0x00U,
+				desc::hid{0x0111U, DESC_LEN_REPORT},
+				desc::in(desc::ep_type::interrupt, CUSTOMHID_IN_PACKET, 0x20U, CUSTOMHID_IN_EP & 0x7FU),
+				desc::out(desc::ep_type::interrupt, CUSTOMHID_OUT_PACKET, 0x20U, CUSTOMHID_OUT_EP))),
+		desc::function(usbd_printer_cb,
+			desc::interface(0x07U, 0x01U, 0x02U,
+				desc::in(desc::ep_type::bulk, PRINTER_IN_PACKET, 0x00U, PRINTER_IN_EP & 0x7FU),
+				desc::out(desc::ep_type::bulk, PRINTER_OUT_PACKET, 0x00U, PRINTER_OUT_EP))));
+
+	alignas(4) constexpr auto config_desc = config.bytes();
+	constexpr auto config_dispatch = config.dispatch();
+
+	static_assert(decltype(config)::interface_count == USBD_ITF_MAX_NUM);
+	static_assert(config_dispatch.interface[HID_INTERFACE] == 0);
+	static_assert(config_dispatch.interface[PRINTER_INTERFACE] == 1);
+
+	alignas(4) constexpr auto language_id = desc::language();
+	alignas(4) constexpr auto manufacturer_string = desc::string(u"GigaDevice");
+	alignas(4) constexpr auto product_string = desc::string(u"GD32-HID_PRINTER");
+
+	// filled from the unique ID when the device starts
+	__ALIGN_BEGIN usb_desc_str serial_string __ALIGN_END = {{USB_STRING_LEN(12), USB_DESCTYPE_STR}, {}};
+
+	void* const strings[USB_STRING_COUNT] = {
+		const_cast<std::uint8_t*>(language_id.data()),
+		const_cast<std::uint8_t*>(manufacturer_string.data()),
+		const_cast<std::uint8_t*>(product_string.data()),
+		&serial_string,
+	};
+}  // namespace
+
+usb_desc hid_printer_desc = {
+	const_cast<std::uint8_t*>(device_desc.data()),
+	const_cast<std::uint8_t*>(config_desc.data()),
+	nullptr,
+#if defined(USE_USB_HS) && defined(USE_ULPI_PHY)
+	nullptr,
+	nullptr,
+#endif
+	strings,
+};
+
+usb_class_core usbd_hid_printer_cb = desc::composite<config_dispatch>::core();
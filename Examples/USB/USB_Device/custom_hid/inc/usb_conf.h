@@ -77,7 +77,9 @@ OF SUCH DAMAGE.
     #endif
 
 //    #define USB_HS_INTERNAL_DMA_ENABLED
-//    #define USB_HS_DEDICATED_EP1_ENABLED
+
+    /* the report endpoints take the EP1 interrupts of their own */
+    #define USB_HS_DEDICATED_EP1_ENABLED
 
     #define USBHS_SOF_OUTPUT                        0U
     #define USBHS_LOW_POWER                         0U
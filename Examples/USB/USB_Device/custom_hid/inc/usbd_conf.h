@@ -54,4 +54,7 @@ OF SUCH DAMAGE.
 #define CUSTOMHID_IN_PACKET                 2U
 #define CUSTOMHID_OUT_PACKET                2U
 
+/* the host polls the report endpoints every frame at full speed, every microframe at high speed */
+#define CUSTOMHID_INTERVAL                  0x01U
+
 #endif /* USBD_CONF_H */
@@ -39,6 +39,8 @@ usb_core_driver custom_hid;
 
 extern hid_fop_handler fop_handler;
 
+static void led_report(const uint8_t *report);
+
 /*!
     \brief      main routine will construct a USB custom hid device
     \param[in]  none
@@ -65,5 +67,49 @@ int main(void)
     usb_intr_config();
 
     while(1) {
+        if(USBD_CONFIGURED == custom_hid.dev.cur_status) {
+            uint8_t report[CUSTOMHID_OUT_PACKET];
+
+            /* the keys and the LEDs go through the report queue once the host configured the device */
+            custom_hid_queue_start(&custom_hid);
+
+            while(0U != custom_hid_report_read(&custom_hid, report, NULL)) {
+                led_report(report);
+            }
+        }
+    }
+}
+
+/*!
+    \brief      light the LED selected by an OUT report
+    \param[in]  report: report ID and LED state
+    \param[out] none
+    \retval     none
+*/
+static void led_report(const uint8_t *report)
+{
+    led_typedef_enum led;
+
+    switch(report[0]) {
+    case 0x11U:
+        led = LED1;
+        break;
+
+    case 0x12U:
+        led = LED2;
+        break;
+
+    case 0x13U:
+        led = LED3;
+        break;
+
+    default:
+        return;
+    }
+
+    if(RESET != report[1]) {
+        gd_eval_led_on(led);
+    } else {
+        gd_eval_led_off(led);
     }
 }
@@ -181,7 +181,7 @@ void EXTI0_IRQHandler(void)
                 }
             }
 
-            custom_hid_report_send(&custom_hid, send_buffer1, 2U);
+            custom_hid_report_queue(&custom_hid, send_buffer1, 2U);
         }
 
         /* clear the EXTI line interrupt flag */
@@ -209,7 +209,7 @@ void EXTI10_15_IRQHandler(void)
                 }
             }
 
-            custom_hid_report_send(&custom_hid, send_buffer2, 2U);
+            custom_hid_report_queue(&custom_hid, send_buffer2, 2U);
         }
 
         /* clear the EXTI line interrupt flag */
@@ -0,0 +1,20 @@
+/*!
+    \file    fmc_async.h
+    \brief   FMC erase and program operations that return once the operation is started, the
+             end is seen from the BUSY and END flags or the FMC interrupt
+*/
+
+#ifndef FMC_ASYNC_H
+#define FMC_ASYNC_H
+
+#include "gd32f4xx.h"
+
+/* function declarations */
+/* start the erase of a sector */
+void fmc_sector_erase_start(uint32_t fmc_sector);
+/* start the program of a word */
+void fmc_word_program_start(uint32_t address, uint32_t data);
+/* reset the command bits after the end of an erase or a program */
+void fmc_operation_end(void);
+
+#endif /* FMC_ASYNC_H */
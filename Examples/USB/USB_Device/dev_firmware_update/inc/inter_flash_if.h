@@ -78,10 +78,30 @@ OF SUCH DAMAGE.
 #define ADDR_FMC_SECTOR_26      ((uint32_t)0x08280000U) /*!< base address of sector 26,256 kbytes */
 #define ADDR_FMC_SECTOR_27      ((uint32_t)0x082C0000U) /*!< base address of sector 27,256 kbytes */
 
+#define FLASH_SECTOR_NUM        28U
+
+/* sectors of bank 1 erased ahead of the download while the host erases as it goes, 0 erases
+   only on the request of the host; such a sector past the end of the image loses its contents,
+   and an erase ahead only gains the time the host pauses, the FMC is busier than the bus */
+#ifndef INTER_FLASH_ERASE_AHEAD
+#define INTER_FLASH_ERASE_AHEAD 0U
+#endif /* INTER_FLASH_ERASE_AHEAD */
+
+/* estimates of the poll timeouts until the first erase and program are measured */
+#ifndef INTER_FLASH_ERASE_US_PER_KB
+#define INTER_FLASH_ERASE_US_PER_KB     4000U
+#endif /* INTER_FLASH_ERASE_US_PER_KB */
+
+#ifndef INTER_FLASH_WORD_NS
+#define INTER_FLASH_WORD_NS             16000U
+#endif /* INTER_FLASH_WORD_NS */
+
 extern dfu_mem_prop dfu_inter_flash_cb;
 
 /* function declarations */
 /* write option byte */
 fmc_state_enum option_byte_write(uint32_t Mem_Add, uint8_t *data);
+/* continue the erase or the program of the flash on the FMC interrupt */
+void inter_flash_if_irq(void);
 
 #endif /* INTER_FLASH_IF_H */
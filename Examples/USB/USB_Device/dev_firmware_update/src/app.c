@@ -74,6 +74,11 @@ int main(void)
     usb_rcu_config();
     usb_timer_init();
 
+    /* the flash interface runs the FMC from its interrupt, at the priority of the USB
+       interrupt, the FMC completions and the DFU requests must not interrupt each other */
+    nvic_priority_group_set(NVIC_PRIGROUP_PRE2_SUB2);
+    nvic_irq_enable(FMC_IRQn, 2U, 1U);
+
     /* USB device stack configuration */
     usbd_init(&usb_dfu_dev,
 #ifdef USE_USB_FS
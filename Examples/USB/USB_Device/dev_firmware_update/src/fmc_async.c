@@ -0,0 +1,54 @@
+/*!
+    \file    fmc_async.c
+    \brief   FMC erase and program operations that return once the operation is started
+
+    fmc_sector_erase() and fmc_word_program() of the peripheral library wait for the FMC before
+    and after the operation. The DFU flash interface runs the FMC from its interrupt instead and
+    needs the operations without the waits. The caller makes sure the FMC is not busy.
+*/
+
+#include "fmc_async.h"
+
+/*!
+    \brief      start the erase of a sector
+    \param[in]  fmc_sector: a given sector number
+      \arg        CTL_SECTOR_NUMBER_x (x = 0,..,27)
+    \param[out] none
+    \retval     none
+*/
+void fmc_sector_erase_start(uint32_t fmc_sector)
+{
+    FMC_CTL &= ~(FMC_CTL_SN | FMC_CTL_PG);
+    FMC_CTL |= (FMC_CTL_SER | fmc_sector);
+    FMC_CTL |= FMC_CTL_START;
+}
+
+/*!
+    \brief      start the program of a word, the widest access the FMC programs without an
+                external programming voltage
+    \param[in]  address: word aligned address to program
+    \param[in]  data: word to program
+    \param[out] none
+    \retval     none
+*/
+void fmc_word_program_start(uint32_t address, uint32_t data)
+{
+    /* the program size and PG stay set over the words of a block */
+    if((CTL_PSZ_WORD | FMC_CTL_PG) != (FMC_CTL & (FMC_CTL_PSZ | FMC_CTL_PG | FMC_CTL_SER))) {
+        FMC_CTL &= ~(FMC_CTL_PSZ | FMC_CTL_SER);
+        FMC_CTL |= (CTL_PSZ_WORD | FMC_CTL_PG);
+    }
+
+    REG32(address) = data;
+}
+
+/*!
+    \brief      reset the command bits after the end of an erase or a program
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fmc_operation_end(void)
+{
+    FMC_CTL &= ~(FMC_CTL_PG | FMC_CTL_SER | FMC_CTL_SN);
+}
@@ -34,6 +34,7 @@ OF SUCH DAMAGE.
 
 #include "gd32f4xx_it.h"
 #include "drv_usbd_int.h"
+#include "inter_flash_if.h"
 
 extern usb_core_driver usb_dfu_dev;
 
@@ -157,6 +158,17 @@ void TIMER2_IRQHandler(void)
     usb_timer_irq();
 }
 
+/*!
+    \brief      this function handles FMC interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void FMC_IRQHandler(void)
+{
+    inter_flash_if_irq();
+}
+
 #ifdef USE_USB_FS
 
 /*!
@@ -32,7 +32,39 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 OF SUCH DAMAGE.
 */
 
+#include "dfu_core.h"
 #include "inter_flash_if.h"
+#include "fmc_async.h"
+
+/*
+    The DFU class starts an erase or a write through inter_flash_if_erase_start() and
+    inter_flash_if_write_start() and gets the end through dfu_mem_done(). The operations run
+    on the FMC interrupt, one sector erase or one word program at a time, and the host sends
+    the next block meanwhile. Words of 0xFFFFFFFF are not programmed, an erase of a sector
+    that is already blank ends at once.
+
+    While the host erases as it goes, the FMC erases up to INTER_FLASH_ERASE_AHEAD sectors of
+    bank 1 behind the last written one whenever it has nothing else to do, and the erase the host
+    asks for later finds them blank. The times of the erases and programs are measured with
+    the DWT cycle counter and give the poll timeouts of inter_flash_if_timeout().
+
+    Only bank 1 (from 0x08100000) is erased and programmed while the CPU goes on, an
+    operation in bank 0 stalls the code fetches of the CPU until it ends.
+*/
+
+/* operation of the FMC */
+#define FLASH_OP_NONE                   0U
+#define FLASH_OP_ERASE                  1U
+#define FLASH_OP_PROGRAM                2U
+
+/* command of the DFU class */
+#define FLASH_CMD_NONE                  0U
+#define FLASH_CMD_ERASE                 1U
+#define FLASH_CMD_WRITE                 2U
+
+#define FLASH_NO_SECTOR                 FLASH_SECTOR_NUM
+#define FLASH_SECTOR_BIT(sector)        ((uint32_t)1U << (sector))
+#define FLASH_ERR_FLAGS                 (FMC_FLAG_OPERR | FMC_FLAG_WPERR | FMC_FLAG_PGMERR | FMC_FLAG_PGSERR)
 
 /* local function prototypes ('static') */
 static uint8_t inter_flash_if_init(void);
@@ -41,9 +73,23 @@ static uint8_t inter_flash_if_erase(uint32_t addr);
 static uint8_t inter_flash_if_write(uint8_t *buf, uint32_t addr, uint32_t len);
 static uint8_t *inter_flash_if_read(uint8_t *buf, uint32_t addr, uint32_t len);
 static uint8_t inter_flash_if_checkaddr(uint32_t addr);
+static uint8_t inter_flash_if_erase_start(uint32_t addr);
+static uint8_t inter_flash_if_write_start(uint8_t *buf, uint32_t addr, uint32_t len);
+static void inter_flash_if_flush(void);
+static uint32_t inter_flash_if_timeout(uint32_t addr, uint8_t cmd, uint32_t len);
 static uint32_t fmc_sector_get(uint32_t address);
 static void fmc_erase_sector(uint32_t fmc_sector);
 
+static void flash_process(void);
+static uint8_t flash_step(void);
+static void flash_erase_begin(uint8_t sector, uint8_t cmd);
+static void flash_cmd_end(uint8_t status);
+static uint8_t flash_ahead_sector(void);
+static uint8_t flash_sector_index(uint32_t addr);
+static uint8_t flash_sector_blank(uint8_t sector);
+static uint32_t flash_erase_us(uint8_t sector);
+static uint8_t flash_erase_covered(uint8_t sector);
+
 dfu_mem_prop dfu_inter_flash_cb = {
     (const uint8_t *)INTER_FLASH_IF_STR,
 
@@ -54,9 +100,51 @@ dfu_mem_prop dfu_inter_flash_cb = {
     inter_flash_if_read,
     inter_flash_if_checkaddr,
     60U, /* flash erase timeout in ms */
-    80U  /* flash programming timeout in ms (80us * RAM Buffer size (1024 Bytes) */
+    80U, /* flash programming timeout in ms (80us * RAM Buffer size (1024 Bytes) */
+
+    inter_flash_if_erase_start,
+    inter_flash_if_write_start,
+    inter_flash_if_flush,
+    inter_flash_if_timeout
 };
 
+/* base address of the sectors and the end of the flash */
+static const uint32_t flash_sector_addr[FLASH_SECTOR_NUM + 1U] = {
+    ADDR_FMC_SECTOR_0, ADDR_FMC_SECTOR_1, ADDR_FMC_SECTOR_2, ADDR_FMC_SECTOR_3,
+    ADDR_FMC_SECTOR_4, ADDR_FMC_SECTOR_5, ADDR_FMC_SECTOR_6, ADDR_FMC_SECTOR_7,
+    ADDR_FMC_SECTOR_8, ADDR_FMC_SECTOR_9, ADDR_FMC_SECTOR_10, ADDR_FMC_SECTOR_11,
+    ADDR_FMC_SECTOR_12, ADDR_FMC_SECTOR_13, ADDR_FMC_SECTOR_14, ADDR_FMC_SECTOR_15,
+    ADDR_FMC_SECTOR_16, ADDR_FMC_SECTOR_17, ADDR_FMC_SECTOR_18, ADDR_FMC_SECTOR_19,
+    ADDR_FMC_SECTOR_20, ADDR_FMC_SECTOR_21, ADDR_FMC_SECTOR_22, ADDR_FMC_SECTOR_23,
+    ADDR_FMC_SECTOR_24, ADDR_FMC_SECTOR_25, ADDR_FMC_SECTOR_26, ADDR_FMC_SECTOR_27,
+    FLASH_END_ADDR
+};
+
+static uint8_t flash_op = FLASH_OP_NONE;                /* operation of the FMC */
+static uint8_t flash_op_sector;                         /* its sector */
+static uint8_t flash_op_cmd;                            /* it belongs to the command, 0 for an erase ahead */
+static uint32_t flash_op_start;                         /* DWT cycle count at its start */
+static uint32_t flash_op_us;                            /* its estimated time */
+
+static uint8_t flash_cmd = FLASH_CMD_NONE;              /* command of the class */
+static uint8_t flash_cmd_sector;                        /* sector of an erase */
+static uint8_t *flash_cmd_buf;                          /* data of a write */
+static uint32_t flash_cmd_addr;                         /* address of a write */
+static uint32_t flash_cmd_len;                          /* length of a write */
+static uint32_t flash_cmd_pos;                          /* bytes of the write handled */
+
+static uint32_t flash_erased = 0U;                      /* sectors erased and not programmed since, a bit each */
+static uint32_t flash_written = 0U;                     /* sectors the download writes to */
+static uint32_t flash_host_erased = 0U;                 /* sectors the host had erased */
+static uint8_t flash_last_sector = FLASH_NO_SECTOR;     /* sector of the end of the last write */
+
+static uint32_t flash_erase_us_per_kb = INTER_FLASH_ERASE_US_PER_KB;
+static uint32_t flash_word_ns = INTER_FLASH_WORD_NS;
+static uint8_t flash_erase_measured = 0U;
+static uint8_t flash_word_measured = 0U;
+
+static uint8_t flash_running = 0U;                      /* flash_process() is active */
+
 /*!
     \brief      program option byte
     \param[in]  Mem_Add: target address
@@ -179,6 +267,20 @@ static uint8_t inter_flash_if_init(void)
     /* unlock the internal flash */
     fmc_unlock();
 
+    flash_op = FLASH_OP_NONE;
+    flash_cmd = FLASH_CMD_NONE;
+    flash_erased = 0U;
+    flash_written = 0U;
+    flash_host_erased = 0U;
+    flash_last_sector = FLASH_NO_SECTOR;
+
+    /* start the cycle counter of the DWT for the erase and program times */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    fmc_flag_clear(FMC_FLAG_END | FLASH_ERR_FLAGS);
+    fmc_interrupt_enable(FMC_INT_END | FMC_INT_ERR);
+
     return MEM_OK;
 }
 
@@ -190,6 +292,8 @@ static uint8_t inter_flash_if_init(void)
 */
 static uint8_t inter_flash_if_deinit(void)
 {
+    fmc_interrupt_disable(FMC_INT_END | FMC_INT_ERR);
+
     /* lock the internal flash */
     fmc_lock();
 
@@ -261,7 +365,7 @@ static uint8_t inter_flash_if_write(uint8_t *buf, uint32_t addr, uint32_t len)
 */
 static uint8_t *inter_flash_if_read(uint8_t *buf, uint32_t addr, uint32_t len)
 {
-    return (uint8_t *)(addr);
+    return (uint8_t *)(uintptr_t)(addr);
 }
 
 /*!
@@ -279,6 +383,431 @@ static uint8_t inter_flash_if_checkaddr(uint32_t addr)
     }
 }
 
+/*!
+    \brief      start the erase of the sector of an address, dfu_mem_done() reports the end
+    \param[in]  addr: flash address in the sector to be erased
+    \param[out] none
+    \retval     MEM_OK if the erase was taken, MEM_FAIL else
+*/
+static uint8_t inter_flash_if_erase_start(uint32_t addr)
+{
+    uint8_t sector = flash_sector_index(addr);
+
+    if((FLASH_CMD_NONE != flash_cmd) || (sector >= FLASH_SECTOR_NUM)) {
+        return MEM_FAIL;
+    }
+
+    fmc_unlock();
+
+    flash_cmd = FLASH_CMD_ERASE;
+    flash_cmd_sector = sector;
+
+    flash_process();
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      start a write to the flash, dfu_mem_done() reports the end
+    \param[in]  buf: data buffer pointer, it stays valid until the end
+    \param[in]  addr: word aligned flash address to be written
+    \param[in]  len: length of data to be written (in bytes)
+    \param[out] none
+    \retval     MEM_OK if the write was taken, MEM_FAIL else
+*/
+static uint8_t inter_flash_if_write_start(uint8_t *buf, uint32_t addr, uint32_t len)
+{
+    uint8_t sector, last;
+    uint32_t idx;
+
+    if((FLASH_CMD_NONE != flash_cmd) || (addr & 0x03U) || (addr < FLASH_START_ADDR) || \
+            (len > FLASH_END_ADDR - addr)) {
+        return MEM_FAIL;
+    }
+
+    /* not an aligned data */
+    if(len & 0x03U) {
+        for(idx = len; idx < ((len & 0xFFFCU) + 4U); idx++) {
+            buf[idx] = 0xFFU;
+        }
+    }
+
+    /* no erase ahead may hit the sectors of the write */
+    if(0U != len) {
+        sector = flash_sector_index(addr);
+        last = flash_sector_index(addr + len - 1U);
+
+        for(; sector <= last; sector++) {
+            flash_written |= FLASH_SECTOR_BIT(sector);
+        }
+        flash_last_sector = last;
+    }
+
+    fmc_unlock();
+
+    flash_cmd = FLASH_CMD_WRITE;
+    flash_cmd_buf = buf;
+    flash_cmd_addr = addr;
+    flash_cmd_len = len;
+    flash_cmd_pos = 0U;
+
+    flash_process();
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      wait until the FMC has ended the command and the erases ahead
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void inter_flash_if_flush(void)
+{
+    while((FLASH_OP_NONE != flash_op) || (FLASH_CMD_NONE != flash_cmd)) {
+        (void)fmc_ready_wait(FMC_TIMEOUT_COUNT);
+
+        flash_process();
+    }
+}
+
+/*!
+    \brief      time until the FMC has ended its work and then a given erase or write
+    \param[in]  addr: flash address of the erase or the write
+    \param[in]  cmd: CMD_ERASE or CMD_WRITE
+    \param[in]  len: length of the write, 0 for only the work of the FMC
+    \param[out] none
+    \retval     time in ms, rounded up
+*/
+static uint32_t inter_flash_if_timeout(uint32_t addr, uint8_t cmd, uint32_t len)
+{
+    uint32_t us = 0U;
+    uint32_t elapsed;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+
+    if((FLASH_OP_NONE != flash_op) && (0U != cycles_per_us)) {
+        elapsed = (DWT->CYCCNT - flash_op_start) / cycles_per_us;
+
+        if(flash_op_us > elapsed) {
+            us += flash_op_us - elapsed;
+        } else {
+            /* past its estimate, give it another sixteenth rather than a poll each ms */
+            us += (flash_op_us + 15U) / 16U;
+        }
+    }
+
+    if(FLASH_CMD_ERASE == flash_cmd) {
+        if(0U == flash_erase_covered(flash_cmd_sector)) {
+            us += flash_erase_us(flash_cmd_sector);
+        }
+    } else if(FLASH_CMD_WRITE == flash_cmd) {
+        us += ((flash_cmd_len - flash_cmd_pos + 3U) / 4U) * flash_word_ns / 1000U;
+    } else {
+        /* no command */
+    }
+
+    if(CMD_ERASE == cmd) {
+        if(0U == flash_erase_covered(flash_sector_index(addr))) {
+            us += flash_erase_us(flash_sector_index(addr));
+        }
+    } else {
+        us += ((len + 3U) / 4U) * flash_word_ns / 1000U;
+    }
+
+    return (us + 999U) / 1000U;
+}
+
+/*!
+    \brief      continue the erase or the program of the flash on the FMC interrupt, at the
+                priority of the USB interrupt
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void inter_flash_if_irq(void)
+{
+    flash_process();
+
+    /* an end the engine did not wait for, such as of an option byte write */
+    if(FLASH_OP_NONE == flash_op) {
+        fmc_flag_clear(FMC_FLAG_END | FLASH_ERR_FLAGS);
+    }
+}
+
+/*!
+    \brief      run the engine until it waits for the FMC
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void flash_process(void)
+{
+    /* dfu_mem_done() may start the next command from inside */
+    if(0U != flash_running) {
+        return;
+    }
+
+    flash_running = 1U;
+
+    while(0U != flash_step()) {
+    }
+
+    flash_running = 0U;
+}
+
+/*!
+    \brief      end the operation of the FMC or start the next one
+    \param[in]  none
+    \param[out] none
+    \retval     1 if the engine has to look again, 0 if it waits for the FMC or has nothing to do
+*/
+static uint8_t flash_step(void)
+{
+    uint8_t status = MEM_OK;
+    uint8_t sector;
+    uint32_t cycles, word, measure;
+    uint32_t cycles_per_us = SystemCoreClock / 1000000U;
+
+    if(FLASH_OP_NONE != flash_op) {
+        if(RESET != fmc_flag_get(FMC_FLAG_BUSY)) {
+            return 0U;
+        }
+
+        cycles = DWT->CYCCNT - flash_op_start;
+
+        if((RESET != fmc_flag_get(FMC_FLAG_OPERR)) || (RESET != fmc_flag_get(FMC_FLAG_WPERR)) || \
+                (RESET != fmc_flag_get(FMC_FLAG_PGMERR)) || (RESET != fmc_flag_get(FMC_FLAG_PGSERR))) {
+            status = MEM_FAIL;
+        }
+
+        fmc_flag_clear(FMC_FLAG_END | FLASH_ERR_FLAGS);
+        fmc_operation_end();
+
+        if(FLASH_OP_ERASE == flash_op) {
+            if(MEM_OK == status) {
+                flash_erased |= FLASH_SECTOR_BIT(flash_op_sector);
+
+                /* learn the erase time per KB, the first measure replaces the estimate */
+                if(0U != cycles_per_us) {
+                    measure = cycles / cycles_per_us * 1024U / \
+                              (flash_sector_addr[flash_op_sector + 1U] - flash_sector_addr[flash_op_sector]);
+                    flash_erase_us_per_kb = flash_erase_measured ? (3U * flash_erase_us_per_kb + measure) / 4U : measure;
+                    flash_erase_measured = 1U;
+                }
+            }
+        } else {
+            flash_cmd_pos += 4U;
+
+            if((MEM_OK == status) && (0U != cycles_per_us)) {
+                measure = (cycles / cycles_per_us) * 1000U + (cycles % cycles_per_us) * 1000U / cycles_per_us;
+                flash_word_ns = flash_word_measured ? (7U * flash_word_ns + measure) / 8U : measure;
+                flash_word_measured = 1U;
+            }
+        }
+
+        flash_op = FLASH_OP_NONE;
+
+        if((MEM_OK != status) && (0U != flash_op_cmd)) {
+            flash_cmd_end(MEM_FAIL);
+        }
+
+        return 1U;
+    }
+
+    if(FLASH_CMD_ERASE == flash_cmd) {
+        sector = flash_cmd_sector;
+
+        if((0U == (flash_erased & FLASH_SECTOR_BIT(sector))) && (0U != flash_sector_blank(sector))) {
+            flash_erased |= FLASH_SECTOR_BIT(sector);
+        }
+
+        /* erased ahead, or blank before */
+        if(0U != (flash_erased & FLASH_SECTOR_BIT(sector))) {
+            flash_host_erased |= FLASH_SECTOR_BIT(sector);
+            flash_cmd_end(MEM_OK);
+
+            return 1U;
+        }
+
+        flash_erase_begin(sector, 1U);
+
+        return 0U;
+    }
+
+    if(FLASH_CMD_WRITE == flash_cmd) {
+        /* an erased word needs no program */
+        while((flash_cmd_pos < flash_cmd_len) && (0xFFFFFFFFU == *(uint32_t *)(flash_cmd_buf + flash_cmd_pos))) {
+            flash_cmd_pos += 4U;
+        }
+
+        if(flash_cmd_pos >= flash_cmd_len) {
+            flash_cmd_end(MEM_OK);
+
+            return 1U;
+        }
+
+        word = *(uint32_t *)(flash_cmd_buf + flash_cmd_pos);
+        sector = flash_sector_index(flash_cmd_addr + flash_cmd_pos);
+        flash_erased &= ~FLASH_SECTOR_BIT(sector);
+
+        flash_op = FLASH_OP_PROGRAM;
+        flash_op_sector = sector;
+        flash_op_cmd = 1U;
+        flash_op_us = (flash_word_ns + 999U) / 1000U;
+        flash_op_start = DWT->CYCCNT;
+
+        fmc_word_program_start(flash_cmd_addr + flash_cmd_pos, word);
+
+        return 0U;
+    }
+
+    sector = flash_ahead_sector();
+    if(sector < FLASH_SECTOR_NUM) {
+        flash_erase_begin(sector, 0U);
+    }
+
+    return 0U;
+}
+
+/*!
+    \brief      start the erase of a sector
+    \param[in]  sector: index of the sector
+    \param[in]  cmd: 1 for the erase of the command, 0 for an erase ahead
+    \param[out] none
+    \retval     none
+*/
+static void flash_erase_begin(uint8_t sector, uint8_t cmd)
+{
+    flash_op = FLASH_OP_ERASE;
+    flash_op_sector = sector;
+    flash_op_cmd = cmd;
+    flash_op_us = flash_erase_us(sector);
+    flash_op_start = DWT->CYCCNT;
+
+    fmc_sector_erase_start(fmc_sector_get(flash_sector_addr[sector]));
+}
+
+/*!
+    \brief      end the command of the class
+    \param[in]  status: MEM_OK or MEM_FAIL
+    \param[out] none
+    \retval     none
+*/
+static void flash_cmd_end(uint8_t status)
+{
+    flash_cmd = FLASH_CMD_NONE;
+
+    dfu_mem_done(status);
+}
+
+/*!
+    \brief      find the sector to erase ahead of the download
+    \param[in]  none
+    \param[out] none
+    \retval     index of the sector, FLASH_NO_SECTOR for none
+*/
+static uint8_t flash_ahead_sector(void)
+{
+    uint8_t sector;
+
+    /* only while the host erases the sectors as it reaches them */
+    if((flash_last_sector >= FLASH_SECTOR_NUM) || \
+            (0U == (flash_host_erased & FLASH_SECTOR_BIT(flash_last_sector)))) {
+        return FLASH_NO_SECTOR;
+    }
+
+    for(sector = flash_last_sector + 1U; (sector <= flash_last_sector + INTER_FLASH_ERASE_AHEAD) && \
+            (sector < FLASH_SECTOR_NUM); sector++) {
+        /* an erase in bank 0 stalls the CPU as long as the erase the host asks for later */
+        if((0U != ((flash_erased | flash_written) & FLASH_SECTOR_BIT(sector))) || \
+                (flash_sector_addr[sector] < ADDR_FMC_SECTOR_12) || IS_PROTECTED_AREA(flash_sector_addr[sector])) {
+            continue;
+        }
+
+        if(0U != flash_sector_blank(sector)) {
+            flash_erased |= FLASH_SECTOR_BIT(sector);
+            continue;
+        }
+
+        return sector;
+    }
+
+    return FLASH_NO_SECTOR;
+}
+
+/*!
+    \brief      get the sector of an address
+    \param[in]  addr: flash address
+    \param[out] none
+    \retval     index of the sector, FLASH_NO_SECTOR outside of the flash
+*/
+static uint8_t flash_sector_index(uint32_t addr)
+{
+    uint8_t sector;
+
+    for(sector = 0U; sector < FLASH_SECTOR_NUM; sector++) {
+        if((addr >= flash_sector_addr[sector]) && (addr < flash_sector_addr[sector + 1U])) {
+            break;
+        }
+    }
+
+    return sector;
+}
+
+/*!
+    \brief      check whether a sector is blank
+    \param[in]  sector: index of the sector
+    \param[out] none
+    \retval     1 if all its words read 0xFFFFFFFF, 0 else
+*/
+static uint8_t flash_sector_blank(uint8_t sector)
+{
+    const uint32_t *word = (const uint32_t *)(uintptr_t)flash_sector_addr[sector];
+    const uint32_t *end = (const uint32_t *)(uintptr_t)flash_sector_addr[sector + 1U];
+
+    while(word < end) {
+        if(0xFFFFFFFFU != *word++) {
+            return 0U;
+        }
+    }
+
+    return 1U;
+}
+
+/*!
+    \brief      estimated time of the erase of a sector
+    \param[in]  sector: index of the sector
+    \param[out] none
+    \retval     time in us, 0 outside of the flash
+*/
+static uint32_t flash_erase_us(uint8_t sector)
+{
+    if(sector >= FLASH_SECTOR_NUM) {
+        return 0U;
+    }
+
+    return (flash_sector_addr[sector + 1U] - flash_sector_addr[sector]) / 1024U * flash_erase_us_per_kb;
+}
+
+/*!
+    \brief      check whether a sector is erased, or will be by the operation of the FMC
+    \param[in]  sector: index of the sector
+    \param[out] none
+    \retval     1 if the sector needs no erase of its own, 0 else
+*/
+static uint8_t flash_erase_covered(uint8_t sector)
+{
+    if(sector >= FLASH_SECTOR_NUM) {
+        return 1U;
+    }
+
+    if(0U != (flash_erased & FLASH_SECTOR_BIT(sector))) {
+        return 1U;
+    }
+
+    return ((FLASH_OP_ERASE == flash_op) && (flash_op_sector == sector)) ? 1U : 0U;
+}
+
 /*!
     \brief      erases the sector of a given sector number
     \param[in]  fmc_sector: a given sector number
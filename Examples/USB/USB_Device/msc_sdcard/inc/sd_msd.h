@@ -0,0 +1,76 @@
+/*!
+    \file    sd_msd.h
+    \brief   MSC storage on the SD card, queued DMA transfers with a write-back cache and
+             read-ahead
+*/
+
+#ifndef SD_MSD_H
+#define SD_MSD_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_msc_mem.h"
+#include "sdcard.h"
+
+#define SD_MSD_BLOCK_SIZE               512U
+
+/* write buffers, one is filled while the others are written to the card */
+#ifndef SD_MSD_WRITE_BUFFERS
+#define SD_MSD_WRITE_BUFFERS            2U
+#endif /* SD_MSD_WRITE_BUFFERS */
+
+/* blocks of a write buffer, a full buffer is one CMD25 */
+#ifndef SD_MSD_WRITE_BLOCKS
+#define SD_MSD_WRITE_BLOCKS             64U
+#endif /* SD_MSD_WRITE_BLOCKS */
+
+/* read-ahead windows, sequential reads are served from one while the next is loaded */
+#ifndef SD_MSD_READ_WINDOWS
+#define SD_MSD_READ_WINDOWS             2U
+#endif /* SD_MSD_READ_WINDOWS */
+
+/* blocks of a read-ahead window, one CMD18 */
+#ifndef SD_MSD_READ_BLOCKS
+#define SD_MSD_READ_BLOCKS              64U
+#endif /* SD_MSD_READ_BLOCKS */
+
+/* calls of sd_msd_process() without a write before a partly filled buffer goes to the card,
+   100ms at the 100us timer of the example */
+#ifndef SD_MSD_FLUSH_IDLE_TICKS
+#define SD_MSD_FLUSH_IDLE_TICKS         1000U
+#endif /* SD_MSD_FLUSH_IDLE_TICKS */
+
+/* statistics of the SD card storage */
+typedef struct {
+    uint32_t reads;                                     /*!< mem_read_start calls */
+    uint32_t writes;                                    /*!< mem_write_start calls */
+    uint32_t read_hits;                                 /*!< reads copied from a read-ahead window at once */
+    uint32_t read_waits;                                /*!< reads that waited for a window being loaded */
+    uint32_t read_direct;                               /*!< reads of random blocks straight into the class buffer */
+    uint32_t windows;                                   /*!< read-ahead windows loaded */
+    uint32_t prefetches;                                /*!< of them loaded ahead of the host */
+    uint32_t flushes;                                   /*!< write buffers written to the card */
+    uint32_t idle_flushes;                              /*!< of them partly filled and written after an idle time */
+    uint32_t write_waits;                               /*!< writes that waited for a free write buffer */
+    uint32_t syncs;                                     /*!< SYNCHRONIZE CACHE and START STOP UNIT commands */
+    uint32_t errors;                                    /*!< failed card transfers */
+} sd_msd_stats_struct;
+
+/* storage callbacks of the MSC class */
+extern usbd_mem_cb usbd_sd_storage_fops;
+
+/* function declarations */
+/* bring up the card in 4 bit DMA mode and take over its capacity, before usbd_init() */
+sd_error_enum sd_msd_init(void);
+/* poll the card for finished writes and write back an idle cache, at the USB interrupt priority */
+void sd_msd_process(void);
+/* read the statistics of the SD card storage */
+void sd_msd_stats_get(sd_msd_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SD_MSD_H */
@@ -0,0 +1,129 @@
+/*!
+    \file    app.c
+    \brief   main routine
+
+    \version 2024-12-20, V3.3.1, firmware for GD32F4xx
+*/
+
+/*
+    Copyright (c) 2024, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+
+#include "drv_usb_hw.h"
+#include "usbd_msc_core.h"
+#include "sd_msd.h"
+
+/* period of sd_msd_process() in microseconds */
+#define SD_MSD_PROCESS_US               100U
+
+usb_core_driver msc_sdcard;
+
+/* local function prototypes ('static') */
+static void sd_nvic_config(void);
+static void sd_msd_timer_config(void);
+
+/*!
+    \brief      main routine will construct a USB MSC device on the SD card
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+int main(void)
+{
+    usb_gpio_config();
+    usb_rcu_config();
+    usb_timer_init();
+
+    sd_nvic_config();
+
+    /* without a card the unit stays not ready and the host sees no medium */
+    (void)sd_msd_init();
+
+    sd_msd_timer_config();
+
+#ifdef USB_ISR_CYCLES
+    /* start the cycle counter of the DWT */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif /* USB_ISR_CYCLES */
+
+    usbd_init(&msc_sdcard,
+#ifdef USE_USB_FS
+              USB_CORE_ENUM_FS,
+#elif defined(USE_USB_HS)
+              USB_CORE_ENUM_HS,
+#endif
+              &msc_desc,
+              &msc_class);
+
+    usb_intr_config();
+
+    while(1) {
+    }
+}
+
+/*!
+    \brief      configure the SDIO and DMA interrupts at the priority of the USB interrupt, the
+                storage callbacks and the transfer completions must not interrupt each other
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sd_nvic_config(void)
+{
+    nvic_priority_group_set(NVIC_PRIGROUP_PRE2_SUB2);
+    nvic_irq_enable(SDIO_IRQn, 2U, 1U);
+    nvic_irq_enable(DMA1_Channel3_IRQn, 2U, 1U);
+}
+
+/*!
+    \brief      run sd_msd_process() from TIMER6 every SD_MSD_PROCESS_US, at the priority of the
+                USB interrupt
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_timer_config(void)
+{
+    timer_parameter_struct timer_initpara;
+
+    rcu_periph_clock_enable(RCU_TIMER6);
+
+    timer_deinit(TIMER6);
+    timer_struct_para_init(&timer_initpara);
+
+    /* the timer clock is twice the APB1 clock, count at 1MHz */
+    timer_initpara.prescaler = (rcu_clock_freq_get(CK_APB1) / 1000000U * 2U) - 1U;
+    timer_initpara.period = SD_MSD_PROCESS_US - 1U;
+    timer_init(TIMER6, &timer_initpara);
+
+    timer_interrupt_flag_clear(TIMER6, TIMER_INT_FLAG_UP);
+    timer_interrupt_enable(TIMER6, TIMER_INT_UP);
+    nvic_irq_enable(TIMER6_IRQn, 2U, 2U);
+
+    timer_enable(TIMER6);
+}
@@ -0,0 +1,349 @@
+/*!
+    \file    gd32f4xx_it.c
+    \brief   main interrupt service routines
+
+    \version 2024-12-20, V3.3.1, firmware for GD32F4xx
+*/
+
+/*
+    Copyright (c) 2024, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+
+#include "gd32f4xx_it.h"
+#include "drv_usbd_int.h"
+#include "sd_msd.h"
+
+extern usb_core_driver msc_sdcard;
+
+extern void usb_timer_irq(void);
+
+#ifdef USB_ISR_CYCLES
+/* cycles spent in the USB interrupt and number of its calls */
+__IO uint32_t usb_isr_cycles = 0U;
+__IO uint32_t usb_isr_count = 0U;
+#endif /* USB_ISR_CYCLES */
+
+/* local function prototypes ('static') */
+static void resume_mcu_clk(void);
+
+/*!
+    \brief      this function handles NMI exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void NMI_Handler(void)
+{
+    /* if NMI exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles HardFault exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void HardFault_Handler(void)
+{
+    /* if Hard Fault exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles MemManage exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void MemManage_Handler(void)
+{
+    /* if Memory Manage exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles BusFault exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void BusFault_Handler(void)
+{
+    /* if Bus Fault exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles UsageFault exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void UsageFault_Handler(void)
+{
+    /* if Usage Fault exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles SVC exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void SVC_Handler(void)
+{
+    /* if SVC exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles DebugMon exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void DebugMon_Handler(void)
+{
+    /* if DebugMon exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles PendSV exception
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void PendSV_Handler(void)
+{
+    /* if PendSV exception occurs, go to infinite loop */
+    while(1) {
+    }
+}
+
+/*!
+    \brief      this function handles timer2 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void TIMER2_IRQHandler(void)
+{
+    usb_timer_irq();
+}
+
+/*!
+    \brief      this function handles timer6 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void TIMER6_IRQHandler(void)
+{
+    if(RESET != timer_interrupt_flag_get(TIMER6, TIMER_INT_FLAG_UP)) {
+        timer_interrupt_flag_clear(TIMER6, TIMER_INT_FLAG_UP);
+
+        sd_msd_process();
+    }
+}
+
+/*!
+    \brief      this function handles SDIO interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void SDIO_IRQHandler(void)
+{
+    sd_interrupts_process();
+}
+
+/*!
+    \brief      this function handles DMA1 channel3 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void DMA1_Channel3_IRQHandler(void)
+{
+    sd_dma_interrupts_process();
+}
+
+#ifdef USE_USB_FS
+
+/*!
+    \brief      this function handles USBFS wakeup interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBFS_WKUP_IRQHandler(void)
+{
+    if(msc_sdcard.bp.low_power) {
+        resume_mcu_clk();
+
+        rcu_pll48m_clock_config(RCU_PLL48MSRC_PLLQ);
+        rcu_ck48m_clock_config(RCU_CK48MSRC_PLL48M);
+
+        rcu_periph_clock_enable(RCU_USBFS);
+
+        usb_clock_active(&msc_sdcard);
+    }
+
+    exti_interrupt_flag_clear(EXTI_18);
+}
+
+#elif defined(USE_USB_HS)
+
+/*!
+    \brief      this function handles USBHS wakeup interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBHS_WKUP_IRQHandler(void)
+{
+    if(msc_sdcard.bp.low_power) {
+        resume_mcu_clk();
+
+#ifdef USE_EMBEDDED_PHY
+        rcu_pll48m_clock_config(RCU_PLL48MSRC_PLLQ);
+        rcu_ck48m_clock_config(RCU_CK48MSRC_PLL48M);
+#elif defined(USE_ULPI_PHY)
+        rcu_periph_clock_enable(RCU_USBHSULPI);
+#endif
+
+        rcu_periph_clock_enable(RCU_USBHS);
+
+        usb_clock_active(&msc_sdcard);
+    }
+
+    exti_interrupt_flag_clear(EXTI_20);
+}
+
+#endif /* USE_USBFS */
+
+#ifdef USE_USB_FS
+
+/*!
+    \brief      this function handles USBFS global interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBFS_IRQHandler(void)
+{
+    usbd_isr(&msc_sdcard);
+}
+
+#elif defined(USE_USB_HS)
+
+/*!
+    \brief      this function handles USBHS global interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBHS_IRQHandler(void)
+{
+#ifdef USB_ISR_CYCLES
+    uint32_t start = DWT->CYCCNT;
+#endif /* USB_ISR_CYCLES */
+
+    usbd_isr(&msc_sdcard);
+
+#ifdef USB_ISR_CYCLES
+    usb_isr_cycles += DWT->CYCCNT - start;
+    usb_isr_count++;
+#endif /* USB_ISR_CYCLES */
+}
+
+#endif /* USE_USBFS */
+
+#ifdef USB_HS_DEDICATED_EP1_ENABLED
+
+/*!
+    \brief      this function handles EP1_IN interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBHS_EP1_In_IRQHandler(void)
+{
+    usbd_int_dedicated_ep1in(&msc_sdcard);
+}
+
+/*!
+    \brief      this function handles EP1_OUT interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void USBHS_EP1_Out_IRQHandler(void)
+{
+    usbd_int_dedicated_ep1out(&msc_sdcard);
+}
+
+#endif /* USBHS_DEDICATED_EP1_ENABLED */
+
+/*!
+    \brief      resume MCU clock
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void resume_mcu_clk(void)
+{
+    /* enable HXTAL */
+    rcu_osci_on(RCU_HXTAL);
+
+    /* wait till HXTAL is ready */
+    while(RESET == rcu_flag_get(RCU_FLAG_HXTALSTB)) {
+    }
+
+    /* enable PLL */
+    rcu_osci_on(RCU_PLL_CK);
+
+    /* wait till PLL is ready */
+    while(RESET == rcu_flag_get(RCU_FLAG_PLLSTB)) {
+    }
+
+    /* select PLL as system clock source */
+    rcu_system_clock_source_config(RCU_CKSYSSRC_PLLP);
+
+    /* wait till PLL is used as system clock source */
+    while(RCU_SCSS_PLLP != rcu_system_clock_source_get()) {
+    }
+}
@@ -0,0 +1,872 @@
+/*!
+    \file    sd_msd.c
+    \brief   MSC storage on the SD card, queued DMA transfers with a write-back cache and
+             read-ahead
+
+    The class hands over one media buffer of MSC_MEDIA_PACKET_SIZE at a time. A card needs
+    far longer transfers to get near its bus rate: every CMD25 costs a busy time for
+    programming and every CMD18 an access time before the first block. Writes are therefore
+    copied into a write buffer and acknowledged at once; a buffer goes to the card through the
+    request queue of sdcard.c when it is full, when the host writes somewhere else, on
+    SYNCHRONIZE CACHE and START STOP UNIT, and after an idle time. While one buffer is being
+    programmed the next one fills. Reads that continue the previous one are served from
+    read-ahead windows, each read of a window starts loading the window behind it.
+
+    Everything runs at the priority of the USB interrupt: the class callbacks, the SDIO and
+    DMA interrupts in which reads complete, and sd_msd_process(), in which writes complete.
+    None of them interrupts another, so the state needs no critical sections.
+
+    A failed write-back cannot be reported to the WRITE10 it came from any more, it fails the
+    next WRITE10 or the next SYNCHRONIZE CACHE instead.
+*/
+
+#include <string.h>
+#include "sd_msd.h"
+
+#define SD_MSD_BLOCK_WORDS              (SD_MSD_BLOCK_SIZE / 4U)
+#define SD_MSD_NO_BLOCK                 0xFFFFFFFFU
+
+/* state of a write buffer */
+#define SD_MSD_WBUF_FREE                0U              /* unused */
+#define SD_MSD_WBUF_FILLING             1U              /* takes the writes of the host */
+#define SD_MSD_WBUF_WRITING             2U              /* owned by the request queue */
+
+/* state of a read-ahead window */
+#define SD_MSD_WINDOW_EMPTY             0U              /* unused */
+#define SD_MSD_WINDOW_READING           1U              /* owned by the request queue */
+#define SD_MSD_WINDOW_VALID             2U              /* holds the blocks of the card */
+
+/* operation of the class waiting for the card */
+#define SD_MSD_OP_NONE                  0U
+#define SD_MSD_OP_READ                  1U
+#define SD_MSD_OP_WRITE                 2U
+#define SD_MSD_OP_SYNC                  3U
+
+/* write buffer */
+typedef struct {
+    uint32_t data[SD_MSD_WRITE_BLOCKS * SD_MSD_BLOCK_WORDS];   /*!< blocks to write */
+    sd_request_struct request;                                  /*!< transfer to the card */
+    uint32_t block;                                             /*!< first block */
+    uint32_t count;                                             /*!< blocks in the buffer */
+    uint8_t state;                                              /*!< SD_MSD_WBUF_x */
+} sd_msd_wbuf_struct;
+
+/* read-ahead window */
+typedef struct {
+    uint32_t data[SD_MSD_READ_BLOCKS * SD_MSD_BLOCK_WORDS];    /*!< blocks of the card */
+    sd_request_struct request;                                  /*!< transfer from the card */
+    uint32_t block;                                             /*!< first block */
+    uint32_t count;                                             /*!< blocks in the window */
+    uint32_t used;                                              /*!< stamp of the last read from it */
+    uint8_t state;                                              /*!< SD_MSD_WINDOW_x */
+    uint8_t stale;                                              /*!< a write hit the window while it was loaded */
+} sd_msd_window_struct;
+
+/* USB mass storage standard inquiry data */
+static const int8_t sd_msd_inquiry_data[] = {
+    /* LUN 0 */
+    0x00,
+    0x80,
+    0x00,
+    0x01,
+    (USBD_STD_INQUIRY_LENGTH - 5U),
+    0x00,
+    0x00,
+    0x00,
+    'G', 'D', '3', '2', ' ', ' ', ' ', ' ', /* Manufacturer : 8 bytes */
+    'S', 'D', ' ', 'c', 'a', 'r', 'd', ' ', /* Product      : 16 Bytes */
+    ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
+    '1', '.', '0', '0'                      /* Version      : 4 Bytes */
+};
+
+static sd_msd_wbuf_struct msd_wbuf[SD_MSD_WRITE_BUFFERS];
+static sd_msd_window_struct msd_window[SD_MSD_READ_WINDOWS];
+static sd_request_struct msd_direct;                    /* read of random blocks into the class buffer */
+static uint8_t msd_direct_busy = 0U;
+
+static uint8_t msd_op = SD_MSD_OP_NONE;                 /* operation of the class in progress */
+static uint8_t *msd_buf;                                /* its buffer */
+static uint32_t msd_block;                              /* its first block */
+static uint32_t msd_count;                              /* its number of blocks */
+static uint32_t msd_done;                               /* blocks of it already handled */
+static uint8_t msd_waited;                              /* it was counted as waiting */
+static uint8_t msd_read_failed = 0U;                    /* the card failed a read it waited for */
+static uint8_t msd_write_failed = 0U;                   /* a write-back failed and was not reported yet */
+
+static uint8_t msd_running = 0U;                        /* sd_msd_op_run() is active */
+static uint8_t msd_again = 0U;                          /* a completion came in while it was */
+static uint8_t msd_sync_call = 0U;                      /* inside mem_sync, which reports by its return */
+static int8_t msd_sync_status;                          /* result of a sync finished inside mem_sync */
+
+static uint32_t msd_next_read = SD_MSD_NO_BLOCK;        /* block behind the last read, sequential reads start there */
+static uint32_t msd_stamp = 0U;
+static uint32_t msd_idle_ticks = 0U;
+static sd_msd_stats_struct msd_stats;
+
+/* local function prototypes ('static') */
+static int8_t storage_init(uint8_t lun);
+static int8_t storage_ready(uint8_t lun);
+static int8_t storage_write_protected(uint8_t lun);
+static int8_t storage_max_lun_get(void);
+static int8_t storage_read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t storage_write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t storage_read_start(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t storage_write_start(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len);
+static int8_t storage_sync(uint8_t lun);
+
+static void sd_msd_op_run(void);
+static int8_t sd_msd_read_step(void);
+static int8_t sd_msd_write_step(void);
+static int8_t sd_msd_sync_step(void);
+static void sd_msd_flush(sd_msd_wbuf_struct *wbuf);
+static void sd_msd_flush_overlapping(uint32_t block, uint32_t count);
+static void sd_msd_invalidate(uint32_t block, uint32_t count);
+static sd_msd_window_struct *sd_msd_window_find(uint32_t block, uint8_t state);
+static sd_msd_window_struct *sd_msd_window_load(uint32_t block, const sd_msd_window_struct *keep);
+static void sd_msd_prefetch(const sd_msd_window_struct *window);
+static void sd_msd_write_done(sd_request_struct *request);
+static void sd_msd_window_done(sd_request_struct *request);
+static void sd_msd_direct_done(sd_request_struct *request);
+
+usbd_mem_cb usbd_sd_storage_fops = {
+    .mem_init = storage_init,
+    .mem_ready = storage_ready,
+    .mem_protected = storage_write_protected,
+    .mem_read = storage_read,
+    .mem_write = storage_write,
+    .mem_maxlun = storage_max_lun_get,
+
+    .mem_inquiry_data = {(uint8_t *)sd_msd_inquiry_data},
+
+    .mem_block_size = {SD_MSD_BLOCK_SIZE},
+    .mem_block_len = {0U},
+
+    .mem_read_start = storage_read_start,
+    .mem_write_start = storage_write_start,
+    .mem_sync = storage_sync
+};
+
+usbd_mem_cb *usbd_mem_fops = &usbd_sd_storage_fops;
+
+/*!
+    \brief      bring up the card in 4 bit DMA mode and take over its capacity, call it before
+                usbd_init() and with the SDIO and DMA interrupts enabled
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_msd_init(void)
+{
+    sd_card_info_struct cardinfo;
+    sd_error_enum status;
+
+    usbd_sd_storage_fops.mem_block_len[0] = 0U;
+
+    /* a new card starts with an empty cache */
+    memset(msd_wbuf, 0, sizeof(msd_wbuf));
+    memset(msd_window, 0, sizeof(msd_window));
+    memset(&msd_stats, 0, sizeof(msd_stats));
+    msd_direct_busy = 0U;
+    msd_op = SD_MSD_OP_NONE;
+    msd_read_failed = 0U;
+    msd_write_failed = 0U;
+    msd_next_read = SD_MSD_NO_BLOCK;
+    msd_stamp = 0U;
+    msd_idle_ticks = 0U;
+
+    status = sd_init();
+    if(SD_OK == status) {
+        status = sd_card_information_get(&cardinfo);
+    }
+    if(SD_OK == status) {
+        status = sd_card_select_deselect(cardinfo.card_rca);
+    }
+    if(SD_OK == status) {
+        status = sd_bus_mode_config(SDIO_BUSMODE_4BIT);
+    }
+    if(SD_OK == status) {
+        /* cards without CMD6 stay in default speed */
+        status = sd_high_speed_config();
+        if(SD_FUNCTION_UNSUPPORTED == status) {
+            status = SD_OK;
+        }
+    }
+    if(SD_OK == status) {
+        status = sd_transfer_mode_config(SD_DMA_MODE);
+    }
+    if(SD_OK == status) {
+        /* the capacity is in KB */
+        usbd_sd_storage_fops.mem_block_len[0] = sd_card_capacity_get() * (1024U / SD_MSD_BLOCK_SIZE);
+    }
+
+    return status;
+}
+
+/*!
+    \brief      poll the card for finished writes and write back a cache the host left idle,
+                call it periodically at the priority of the USB interrupt
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sd_msd_process(void)
+{
+    uint32_t i;
+
+    sd_queue_process();
+
+    if(msd_idle_ticks < SD_MSD_FLUSH_IDLE_TICKS) {
+        msd_idle_ticks++;
+        return;
+    }
+
+    for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+        if(SD_MSD_WBUF_FILLING == msd_wbuf[i].state) {
+            msd_stats.idle_flushes++;
+            sd_msd_flush(&msd_wbuf[i]);
+        }
+    }
+}
+
+/*!
+    \brief      read the statistics of the SD card storage
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_msd_stats_get(sd_msd_stats_struct *stats)
+{
+    *stats = msd_stats;
+}
+
+/*!
+    \brief      initialize the storage medium
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_init(uint8_t lun)
+{
+    /* a USB reset drops the command in progress, transfers in flight finish in the background */
+    msd_op = SD_MSD_OP_NONE;
+    msd_next_read = SD_MSD_NO_BLOCK;
+
+    return 0;
+}
+
+/*!
+    \brief      check whether the medium is ready
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_ready(uint8_t lun)
+{
+    return (0U != usbd_sd_storage_fops.mem_block_len[lun]) ? 0 : -1;
+}
+
+/*!
+    \brief      check whether the medium is write-protected
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_write_protected(uint8_t lun)
+{
+    return 0;
+}
+
+/*!
+    \brief      get number of supported logical unit
+    \param[in]  none
+    \param[out] none
+    \retval     number of logical unit
+*/
+static int8_t storage_max_lun_get(void)
+{
+    return (MEM_LUN_NUM - 1U);
+}
+
+/*!
+    \brief      read data from the medium and wait for it, only used without mem_read_start
+    \param[in]  lun: logical unit number
+    \param[in]  buf: pointer to the buffer to save data
+    \param[in]  blk_addr: byte address of 1st block to be read
+    \param[in]  blk_len: number of blocks to be read
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_read(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    if(SD_OK != sd_multiblocks_read((uint32_t *)buf, blk_addr, SD_MSD_BLOCK_SIZE, blk_len)) {
+        msd_stats.errors++;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      write data to the medium and wait for it, only used without mem_write_start
+    \param[in]  lun: logical unit number
+    \param[in]  buf: pointer to the buffer to write
+    \param[in]  blk_addr: byte address of 1st block to be written
+    \param[in]  blk_len: number of blocks to be written
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_write(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    if(SD_OK != sd_multiblocks_write((uint32_t *)buf, blk_addr, SD_MSD_BLOCK_SIZE, blk_len)) {
+        msd_stats.errors++;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      start reading data from the medium, usbd_msc_mem_done() reports the end
+    \param[in]  lun: logical unit number
+    \param[in]  buf: word aligned buffer of the class
+    \param[in]  blk_addr: 1st block to be read
+    \param[in]  blk_len: number of blocks to be read
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_read_start(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    msd_stats.reads++;
+
+    msd_op = SD_MSD_OP_READ;
+    msd_buf = buf;
+    msd_block = blk_addr;
+    msd_count = blk_len;
+    msd_done = 0U;
+    msd_waited = 0U;
+    msd_read_failed = 0U;
+
+    sd_msd_op_run();
+
+    return 0;
+}
+
+/*!
+    \brief      start writing data to the medium, usbd_msc_mem_done() reports the end
+    \param[in]  lun: logical unit number
+    \param[in]  buf: buffer of the class
+    \param[in]  blk_addr: 1st block to be written
+    \param[in]  blk_len: number of blocks to be written
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_write_start(uint8_t lun, uint8_t *buf, uint32_t blk_addr, uint16_t blk_len)
+{
+    msd_stats.writes++;
+    msd_idle_ticks = 0U;
+
+    msd_op = SD_MSD_OP_WRITE;
+    msd_buf = buf;
+    msd_block = blk_addr;
+    msd_count = blk_len;
+    msd_done = 0U;
+    msd_waited = 0U;
+
+    /* the card data in a window is old from now on, a window being loaded is dropped later */
+    sd_msd_invalidate(blk_addr, blk_len);
+
+    sd_msd_op_run();
+
+    return 0;
+}
+
+/*!
+    \brief      write back the cache
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     0 when the card holds all data, 1 when usbd_msc_mem_done() follows, -1 on an error
+*/
+static int8_t storage_sync(uint8_t lun)
+{
+    msd_stats.syncs++;
+
+    msd_op = SD_MSD_OP_SYNC;
+    msd_sync_call = 1U;
+    msd_sync_status = 0;
+
+    sd_msd_op_run();
+
+    msd_sync_call = 0U;
+
+    return (SD_MSD_OP_NONE == msd_op) ? msd_sync_status : 1;
+}
+
+/*!
+    \brief      advance the operation of the class and report its end, completions that come
+                in while it runs make it run once more
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_op_run(void)
+{
+    int8_t status = 1;
+
+    if(0U != msd_running) {
+        msd_again = 1U;
+        return;
+    }
+
+    msd_running = 1U;
+    do {
+        msd_again = 0U;
+
+        switch(msd_op) {
+        case SD_MSD_OP_READ:
+            status = sd_msd_read_step();
+            break;
+
+        case SD_MSD_OP_WRITE:
+            status = sd_msd_write_step();
+            break;
+
+        case SD_MSD_OP_SYNC:
+            status = sd_msd_sync_step();
+            break;
+
+        default:
+            status = 1;
+            break;
+        }
+    } while((status > 0) && (0U != msd_again));
+    msd_running = 0U;
+
+    if(status > 0) {
+        return;
+    }
+
+    msd_op = SD_MSD_OP_NONE;
+
+    if(0U != msd_sync_call) {
+        msd_sync_status = status;
+    } else {
+        usbd_msc_mem_done(status);
+    }
+}
+
+/*!
+    \brief      copy the blocks of the read from the windows and load what is missing
+    \param[in]  none
+    \param[out] none
+    \retval     0 when done, 1 when waiting for the card, -1 on an error
+*/
+static int8_t sd_msd_read_step(void)
+{
+    sd_msd_window_struct *window;
+    uint32_t block, n;
+
+    if(0U != msd_read_failed) {
+        return -1;
+    }
+
+    /* blocks still in a write buffer go to the card first, the queue keeps the order */
+    sd_msd_flush_overlapping(msd_block + msd_done, msd_count - msd_done);
+
+    while(msd_done < msd_count) {
+        block = msd_block + msd_done;
+
+        /* a direct read is in flight or has just finished */
+        if(0U != msd_direct_busy) {
+            return 1;
+        }
+
+        window = sd_msd_window_find(block, SD_MSD_WINDOW_VALID);
+        if(NULL != window) {
+            n = window->block + window->count - block;
+            if(n > msd_count - msd_done) {
+                n = msd_count - msd_done;
+            }
+            memcpy(&msd_buf[msd_done * SD_MSD_BLOCK_SIZE], &window->data[(block - window->block) * SD_MSD_BLOCK_WORDS], \
+                   n * SD_MSD_BLOCK_SIZE);
+            msd_done += n;
+            window->used = ++msd_stamp;
+
+            /* keep the card busy with the blocks the host asks for next */
+            sd_msd_prefetch(window);
+            continue;
+        }
+
+        if(NULL != sd_msd_window_find(block, SD_MSD_WINDOW_READING)) {
+            if(0U == msd_waited) {
+                msd_waited = 1U;
+                msd_stats.read_waits++;
+            }
+            return 1;
+        }
+
+        /* a miss: a sequential read loads a window, a random one reads just its blocks */
+        if((block == msd_next_read) && (NULL != sd_msd_window_load(block, NULL))) {
+            msd_waited = 1U;
+            return 1;
+        }
+
+        msd_direct.buffer = (uint32_t *)&msd_buf[msd_done * SD_MSD_BLOCK_SIZE];
+        msd_direct.block = block;
+        msd_direct.count = msd_count - msd_done;
+        msd_direct.direction = SD_REQUEST_READ;
+        msd_direct.callback = sd_msd_direct_done;
+        msd_direct.arg = NULL;
+        msd_direct_busy = 1U;
+        msd_stats.read_direct++;
+        if(SD_OK != sd_request_submit(&msd_direct)) {
+            msd_direct_busy = 0U;
+            msd_stats.errors++;
+            return -1;
+        }
+        msd_waited = 1U;
+        return 1;
+    }
+
+    if(0U == msd_waited) {
+        msd_stats.read_hits++;
+    }
+    msd_next_read = msd_block + msd_count;
+
+    return 0;
+}
+
+/*!
+    \brief      copy the blocks of the write into the write buffers
+    \param[in]  none
+    \param[out] none
+    \retval     0 when done, 1 when waiting for a free buffer, -1 on an error
+*/
+static int8_t sd_msd_write_step(void)
+{
+    sd_msd_wbuf_struct *wbuf = NULL;
+    uint32_t i, block, n;
+
+    /* the write-back of an earlier WRITE10 failed */
+    if(0U != msd_write_failed) {
+        msd_write_failed = 0U;
+        return -1;
+    }
+
+    while(msd_done < msd_count) {
+        block = msd_block + msd_done;
+
+        /* the filling buffer takes the blocks that continue it */
+        wbuf = NULL;
+        for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+            if(SD_MSD_WBUF_FILLING == msd_wbuf[i].state) {
+                if(msd_wbuf[i].block + msd_wbuf[i].count == block) {
+                    wbuf = &msd_wbuf[i];
+                } else {
+                    sd_msd_flush(&msd_wbuf[i]);
+                }
+            }
+        }
+
+        if(NULL == wbuf) {
+            for(i = 0U; (i < SD_MSD_WRITE_BUFFERS) && (NULL == wbuf); i++) {
+                if(SD_MSD_WBUF_FREE == msd_wbuf[i].state) {
+                    wbuf = &msd_wbuf[i];
+                }
+            }
+            if(NULL == wbuf) {
+                /* all buffers are being programmed, the first one to finish takes the data */
+                if(0U == msd_waited) {
+                    msd_waited = 1U;
+                    msd_stats.write_waits++;
+                }
+                return 1;
+            }
+            wbuf->state = SD_MSD_WBUF_FILLING;
+            wbuf->block = block;
+            wbuf->count = 0U;
+        }
+
+        n = SD_MSD_WRITE_BLOCKS - wbuf->count;
+        if(n > msd_count - msd_done) {
+            n = msd_count - msd_done;
+        }
+        memcpy(&wbuf->data[wbuf->count * SD_MSD_BLOCK_WORDS], &msd_buf[msd_done * SD_MSD_BLOCK_SIZE], n * SD_MSD_BLOCK_SIZE);
+        wbuf->count += n;
+        msd_done += n;
+
+        if(SD_MSD_WRITE_BLOCKS == wbuf->count) {
+            sd_msd_flush(wbuf);
+        }
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      write back the filling buffer and wait for all writes of the card
+    \param[in]  none
+    \param[out] none
+    \retval     0 when done, 1 when waiting for the card, -1 on an error
+*/
+static int8_t sd_msd_sync_step(void)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+        if(SD_MSD_WBUF_FILLING == msd_wbuf[i].state) {
+            sd_msd_flush(&msd_wbuf[i]);
+        }
+    }
+    for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+        if(SD_MSD_WBUF_FREE != msd_wbuf[i].state) {
+            return 1;
+        }
+    }
+
+    if(0U != msd_write_failed) {
+        msd_write_failed = 0U;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      hand a filling write buffer to the request queue
+    \param[in]  wbuf: write buffer
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_flush(sd_msd_wbuf_struct *wbuf)
+{
+    wbuf->state = SD_MSD_WBUF_WRITING;
+    wbuf->request.buffer = wbuf->data;
+    wbuf->request.block = wbuf->block;
+    wbuf->request.count = wbuf->count;
+    wbuf->request.direction = SD_REQUEST_WRITE;
+    wbuf->request.callback = sd_msd_write_done;
+    wbuf->request.arg = wbuf;
+    msd_stats.flushes++;
+
+    if(SD_OK != sd_request_submit(&wbuf->request)) {
+        wbuf->request.status = SD_ERROR;
+        wbuf->request.done = 1U;
+        sd_msd_write_done(&wbuf->request);
+    }
+}
+
+/*!
+    \brief      hand the filling write buffers that hold blocks of a range to the request queue
+    \param[in]  block: first block
+    \param[in]  count: number of blocks
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_flush_overlapping(uint32_t block, uint32_t count)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+        if((SD_MSD_WBUF_FILLING == msd_wbuf[i].state) && \
+                (msd_wbuf[i].block < block + count) && (block < msd_wbuf[i].block + msd_wbuf[i].count)) {
+            sd_msd_flush(&msd_wbuf[i]);
+        }
+    }
+}
+
+/*!
+    \brief      drop the read-ahead windows that hold blocks of a range
+    \param[in]  block: first block
+    \param[in]  count: number of blocks
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_invalidate(uint32_t block, uint32_t count)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SD_MSD_READ_WINDOWS; i++) {
+        if((SD_MSD_WINDOW_EMPTY != msd_window[i].state) && \
+                (msd_window[i].block < block + count) && (block < msd_window[i].block + msd_window[i].count)) {
+            if(SD_MSD_WINDOW_READING == msd_window[i].state) {
+                msd_window[i].stale = 1U;
+            } else {
+                msd_window[i].state = SD_MSD_WINDOW_EMPTY;
+            }
+        }
+    }
+}
+
+/*!
+    \brief      find the window in a state that holds a block
+    \param[in]  block: block
+    \param[in]  state: SD_MSD_WINDOW_READING or SD_MSD_WINDOW_VALID
+    \param[out] none
+    \retval     window or NULL
+*/
+static sd_msd_window_struct *sd_msd_window_find(uint32_t block, uint8_t state)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SD_MSD_READ_WINDOWS; i++) {
+        if((state == msd_window[i].state) && (0U == msd_window[i].stale) && \
+                (msd_window[i].block <= block) && (block < msd_window[i].block + msd_window[i].count)) {
+            return &msd_window[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*!
+    \brief      start loading a window at a block, into the least recently read window that is
+                not being loaded
+    \param[in]  block: first block
+    \param[in]  keep: window that must not be reused, may be NULL
+    \param[out] none
+    \retval     window or NULL if none is free or the blocks are still in a write buffer
+*/
+static sd_msd_window_struct *sd_msd_window_load(uint32_t block, const sd_msd_window_struct *keep)
+{
+    sd_msd_window_struct *window = NULL;
+    uint32_t i, count;
+
+    if(block >= usbd_sd_storage_fops.mem_block_len[0]) {
+        return NULL;
+    }
+    count = usbd_sd_storage_fops.mem_block_len[0] - block;
+    if(count > SD_MSD_READ_BLOCKS) {
+        count = SD_MSD_READ_BLOCKS;
+    }
+
+    /* the card does not have the blocks of a filling buffer yet */
+    for(i = 0U; i < SD_MSD_WRITE_BUFFERS; i++) {
+        if((SD_MSD_WBUF_FILLING == msd_wbuf[i].state) && \
+                (msd_wbuf[i].block < block + count) && (block < msd_wbuf[i].block + msd_wbuf[i].count)) {
+            return NULL;
+        }
+    }
+
+    for(i = 0U; i < SD_MSD_READ_WINDOWS; i++) {
+        if((SD_MSD_WINDOW_READING == msd_window[i].state) || (keep == &msd_window[i])) {
+            continue;
+        }
+        if((NULL == window) || (SD_MSD_WINDOW_EMPTY == msd_window[i].state) || \
+                ((SD_MSD_WINDOW_EMPTY != window->state) && (msd_window[i].used < window->used))) {
+            window = &msd_window[i];
+        }
+    }
+    if(NULL == window) {
+        return NULL;
+    }
+
+    window->state = SD_MSD_WINDOW_READING;
+    window->stale = 0U;
+    window->block = block;
+    window->count = count;
+    window->used = msd_stamp;
+    window->request.buffer = window->data;
+    window->request.block = block;
+    window->request.count = count;
+    window->request.direction = SD_REQUEST_READ;
+    window->request.callback = sd_msd_window_done;
+    window->request.arg = window;
+    msd_stats.windows++;
+
+    if(SD_OK != sd_request_submit(&window->request)) {
+        window->state = SD_MSD_WINDOW_EMPTY;
+        msd_stats.errors++;
+        return NULL;
+    }
+
+    return window;
+}
+
+/*!
+    \brief      load the window behind the one the host reads from
+    \param[in]  window: the window
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_prefetch(const sd_msd_window_struct *window)
+{
+    uint32_t next = window->block + window->count;
+
+    if((NULL != sd_msd_window_find(next, SD_MSD_WINDOW_VALID)) || \
+            (NULL != sd_msd_window_find(next, SD_MSD_WINDOW_READING))) {
+        return;
+    }
+    if(NULL != sd_msd_window_load(next, window)) {
+        msd_stats.prefetches++;
+    }
+}
+
+/*!
+    \brief      a write buffer is on the card, runs in sd_queue_process()
+    \param[in]  request: request of the buffer
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_write_done(sd_request_struct *request)
+{
+    sd_msd_wbuf_struct *wbuf = (sd_msd_wbuf_struct *)request->arg;
+
+    if(SD_OK != request->status) {
+        msd_write_failed = 1U;
+        msd_stats.errors++;
+    }
+    wbuf->state = SD_MSD_WBUF_FREE;
+
+    sd_msd_op_run();
+}
+
+/*!
+    \brief      a window is loaded, runs in the SDIO interrupt
+    \param[in]  request: request of the window
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_window_done(sd_request_struct *request)
+{
+    sd_msd_window_struct *window = (sd_msd_window_struct *)request->arg;
+
+    if(SD_OK != request->status) {
+        msd_stats.errors++;
+
+        /* only a read that waits for the window fails, a prefetch is just dropped */
+        if((SD_MSD_OP_READ == msd_op) && (0U == window->stale) && \
+                (window->block <= msd_block + msd_done) && (msd_block + msd_done < window->block + window->count)) {
+            msd_read_failed = 1U;
+        }
+        window->state = SD_MSD_WINDOW_EMPTY;
+    } else if(0U != window->stale) {
+        window->state = SD_MSD_WINDOW_EMPTY;
+    } else {
+        window->state = SD_MSD_WINDOW_VALID;
+    }
+    window->stale = 0U;
+
+    sd_msd_op_run();
+}
+
+/*!
+    \brief      a direct read is in the class buffer, runs in the SDIO interrupt
+    \param[in]  request: the direct read
+    \param[out] none
+    \retval     none
+*/
+static void sd_msd_direct_done(sd_request_struct *request)
+{
+    msd_direct_busy = 0U;
+
+    if(SD_OK != request->status) {
+        msd_stats.errors++;
+        msd_read_failed = 1U;
+    } else if(SD_MSD_OP_READ == msd_op) {
+        msd_done += request->count;
+    } else {
+        /* the command was dropped by a USB reset */
+    }
+
+    sd_msd_op_run();
+}
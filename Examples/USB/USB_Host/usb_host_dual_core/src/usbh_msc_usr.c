@@ -37,6 +37,7 @@ OF SUCH DAMAGE.
 #include "drv_usb_hw.h"
 #include "usbh_msc_usr.h"
 #include "usbh_msc_core.h"
+#include "usbh_msc_fatfs.h"
 #include "ff.h"
 
 extern usb_core_driver usbhs_core;
@@ -45,6 +46,7 @@ extern usbh_host usb_host_msc;
 FIL file;
 FATFS fatfs;
 FRESULT res;
+char usb_disk_path[4];
 
 __ALIGN_BEGIN char ReadTextBuff[100] __ALIGN_END;
 __ALIGN_BEGIN char WriteTextBuff[] __ALIGN_END = "GD32 USB Host Demo application using FAT_FS   ";
@@ -119,6 +121,9 @@ static void usbh_user_init(void)
         gd_eval_key_init(KEY_WAKEUP, KEY_MODE_GPIO);
 
         printf("> USB MSC host library started\n");
+
+        /* the disk is the only drive of FatFs, 0:/ */
+        FATFS_LinkDriver(&USBH_MSC_Driver, usb_disk_path);
     }
 }
 
@@ -164,6 +169,9 @@ static void usbh_user_unrecovered_error(void)
 static void usbh_user_device_disconnected(void)
 {
     printf("> Device Disconnected.\n");
+
+    /* the sectors the driver holds belong to the removed device */
+    usbh_msc_fatfs_reset();
 }
 
 /*!
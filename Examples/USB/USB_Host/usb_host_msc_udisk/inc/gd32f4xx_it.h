@@ -56,6 +56,8 @@ void DebugMon_Handler(void);
 void PendSV_Handler(void);
 /* this function handles Timer2 interrupt request */
 void TIMER2_IRQHandler(void);
+/* this function handles Timer1 interrupt request */
+void TIMER1_IRQHandler(void);
 #ifdef USE_USB_FS
 /* this function handles USBFS wakeup interrupt request */
 void USBFS_WKUP_IRQHandler(void);
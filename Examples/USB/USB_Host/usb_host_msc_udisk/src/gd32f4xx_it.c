@@ -34,9 +34,12 @@ OF SUCH DAMAGE.
 
 #include "drv_usbh_int.h"
 #include "gd32f4xx_it.h"
+#include "timebase.h"
+#include "scheduler.h"
 
 extern usbh_host usb_host_msc;
 extern usb_core_driver usbh_core;
+extern sched_task_struct usbh_task;
 
 extern void usb_timer_irq(void);
 
@@ -158,6 +161,17 @@ void TIMER2_IRQHandler(void)
     usb_timer_irq();
 }
 
+/*!
+    \brief      this function handles Timer1 interrupt request
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void TIMER1_IRQHandler(void)
+{
+    timebase_irq_handler();
+}
+
 #ifdef USE_USB_FS
 
 /*!
@@ -217,6 +231,7 @@ void USBHS_WKUP_IRQHandler(void)
 void USBFS_IRQHandler(void)
 {
     usbh_isr(&usbh_core);
+    sched_post(&usbh_task);
 }
 
 #elif defined(USE_USB_HS)
@@ -230,6 +245,7 @@ void USBFS_IRQHandler(void)
 void USBHS_IRQHandler(void)
 {
     usbh_isr(&usbh_core);
+    sched_post(&usbh_task);
 }
 
 #endif /* USE_USBFS */
@@ -35,9 +35,28 @@ OF SUCH DAMAGE.
 #include "drv_usb_hw.h"
 #include "usbh_usr.h"
 #include "usbh_msc_core.h"
+#include "timebase.h"
+#include "scheduler.h"
+
+/* the host state machine is also run once per frame for its internal timeouts */
+#define USBH_TASK_PERIOD_US     1000U
 
 usbh_host usb_host_msc;
 usb_core_driver usbh_core;
+sched_task_struct usbh_task;
+
+/*!
+    \brief      host task, posted by the USB interrupt and once per frame
+    \param[in]  arg: host handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_task_handler(void *arg)
+{
+    usbh_core_task((usbh_host *)arg);
+
+    sched_post_in(&usbh_task, USBH_TASK_PERIOD_US);
+}
 
 /*!
     \brief      main routine
@@ -50,6 +69,10 @@ int main(void)
     usb_gpio_config();
     usb_rcu_config();
     usb_timer_init();
+    timebase_config();
+
+    sched_init();
+    sched_task_init(&usbh_task, usbh_task_handler, &usb_host_msc, 0U);
 
     /* configure GPIO pin used for switching VBUS power and charge pump I/O */
     usb_vbus_config();
@@ -70,8 +93,7 @@ int main(void)
     /* enable interrupts */
     usb_intr_config();
 
-    while(1) {
-        /* host task handler */
-        usbh_core_task(&usb_host_msc);
-    }
+    /* host task handler, the core sleeps while the bus is quiet */
+    sched_post(&usbh_task);
+    sched_run();
 }
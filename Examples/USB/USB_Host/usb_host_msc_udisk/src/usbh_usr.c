@@ -35,6 +35,7 @@ OF SUCH DAMAGE.
 #include "usbh_usr.h"
 #include "drv_usb_hw.h"
 #include "usbh_msc_core.h"
+#include "usbh_msc_fatfs.h"
 #include "ff.h"
 
 extern usb_core_driver usbh_core;
@@ -43,6 +44,7 @@ extern usbh_host usb_host_msc;
 FIL file;
 FATFS fatfs;
 FRESULT res;
+char usb_disk_path[4];
 
 __ALIGN_BEGIN char ReadTextBuff[100] __ALIGN_END;
 __ALIGN_BEGIN char WriteTextBuff[] __ALIGN_END = "GD32 USB Host Demo application using FAT_FS   ";
@@ -109,6 +111,9 @@ void usbh_user_init(void)
         LCD_UsrLog("USB host library started\n");
 
         lcd_log_footer_set((uint8_t *)MSG_HOST_FOOTER, 40U);
+
+        /* the disk is the only drive of FatFs, 0:/ */
+        FATFS_LinkDriver(&USBH_MSC_Driver, usb_disk_path);
     }
 }
 
@@ -154,6 +159,9 @@ void usbh_user_unrecovered_error(void)
 void usbh_user_device_disconnected(void)
 {
     LCD_UsrLog("> Device Disconnected.\r\n");
+
+    /* the sectors the driver holds belong to the removed device */
+    usbh_msc_fatfs_reset();
 }
 
 /*!
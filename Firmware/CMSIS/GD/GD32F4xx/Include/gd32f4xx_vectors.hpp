@@ -0,0 +1,359 @@
+#ifndef GD32F4XX_VECTORS_HPP
+#define GD32F4XX_VECTORS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "gd32f4xx.h"
+
+/*
+	Compile-time interrupt binding for the GD32F450.
+
+	The vector table is a constexpr object built from the weak default handlers of the startup
+	code. Bindings replace single entries at compile time, so the CPU jumps straight into the
+	bound function; there is no dispatcher, no function pointer in RAM and no global to route
+	through.
+
+	To use it, define GD32_USER_VECTOR_TABLE for the ${EXEC_NAME}_CMSIS target and emit the table
+	exactly once in the application:
+
+		GD32_VECTOR_TABLE(
+			gd32::vectors::bind<SysTick_IRQn, systick_tick>,
+			gd32::vectors::bind_member<USART0_IRQn, console, &uart::on_irq>
+		);
+
+	Examples/EXTI/Key_external_interrupt_mode binds its tamper key this way and checks the
+	generated table with static_asserts.
+
+	The table can additionally be copied to SRAM and activated through SCB->VTOR, see relocate().
+	Vector fetches then no longer stall while the flash controller is erasing or programming; the
+	bound handlers themselves have to be placed in .RamFunc for the same effect. TCMSRAM is no
+	place for the table: it sits on the D-bus only, and the core fetches vectors over the bus
+	matrix like instructions.
+*/
+
+extern "C" {
+extern unsigned int _estack;
+
+void Reset_Handler();
+void NMI_Handler();
+void HardFault_Handler();
+void MemManage_Handler();
+void BusFault_Handler();
+void UsageFault_Handler();
+void SVC_Handler();
+void DebugMon_Handler();
+void PendSV_Handler();
+void SysTick_Handler();
+
+void WWDGT_IRQHandler();
+void LVD_IRQHandler();
+void TAMPER_STAMP_IRQHandler();
+void RTC_WKUP_IRQHandler();
+void FMC_IRQHandler();
+void RCU_CTC_IRQHandler();
+void EXTI0_IRQHandler();
+void EXTI1_IRQHandler();
+void EXTI2_IRQHandler();
+void EXTI3_IRQHandler();
+void EXTI4_IRQHandler();
+void DMA0_Channel0_IRQHandler();
+void DMA0_Channel1_IRQHandler();
+void DMA0_Channel2_IRQHandler();
+void DMA0_Channel3_IRQHandler();
+void DMA0_Channel4_IRQHandler();
+void DMA0_Channel5_IRQHandler();
+void DMA0_Channel6_IRQHandler();
+void ADC_IRQHandler();
+void CAN0_TX_IRQHandler();
+void CAN0_RX0_IRQHandler();
+void CAN0_RX1_IRQHandler();
+void CAN0_EWMC_IRQHandler();
+void EXTI5_9_IRQHandler();
+void TIMER0_BRK_TIMER8_IRQHandler();
+void TIMER0_UP_TIMER9_IRQHandler();
+void TIMER0_TRG_CMT_TIMER10_IRQHandler();
+void TIMER0_Channel_IRQHandler();
+void TIMER1_IRQHandler();
+void TIMER2_IRQHandler();
+void TIMER3_IRQHandler();
+void I2C0_EV_IRQHandler();
+void I2C0_ER_IRQHandler();
+void I2C1_EV_IRQHandler();
+void I2C1_ER_IRQHandler();
+void SPI0_IRQHandler();
+void SPI1_IRQHandler();
+void USART0_IRQHandler();
+void USART1_IRQHandler();
+void USART2_IRQHandler();
+void EXTI10_15_IRQHandler();
+void RTC_Alarm_IRQHandler();
+void USBFS_WKUP_IRQHandler();
+void TIMER7_BRK_TIMER11_IRQHandler();
+void TIMER7_UP_TIMER12_IRQHandler();
+void TIMER7_TRG_CMT_TIMER13_IRQHandler();
+void TIMER7_Channel_IRQHandler();
+void DMA0_Channel7_IRQHandler();
+void EXMC_IRQHandler();
+void SDIO_IRQHandler();
+void TIMER4_IRQHandler();
+void SPI2_IRQHandler();
+void UART3_IRQHandler();
+void UART4_IRQHandler();
+void TIMER5_DAC_IRQHandler();
+void TIMER6_IRQHandler();
+void DMA1_Channel0_IRQHandler();
+void DMA1_Channel1_IRQHandler();
+void DMA1_Channel2_IRQHandler();
+void DMA1_Channel3_IRQHandler();
+void DMA1_Channel4_IRQHandler();
+void ENET_IRQHandler();
+void ENET_WKUP_IRQHandler();
+void CAN1_TX_IRQHandler();
+void CAN1_RX0_IRQHandler();
+void CAN1_RX1_IRQHandler();
+void CAN1_EWMC_IRQHandler();
+void USBFS_IRQHandler();
+void DMA1_Channel5_IRQHandler();
+void DMA1_Channel6_IRQHandler();
+void DMA1_Channel7_IRQHandler();
+void USART5_IRQHandler();
+void I2C2_EV_IRQHandler();
+void I2C2_ER_IRQHandler();
+void USBHS_EP1_Out_IRQHandler();
+void USBHS_EP1_In_IRQHandler();
+void USBHS_WKUP_IRQHandler();
+void USBHS_IRQHandler();
+void DCI_IRQHandler();
+void TRNG_IRQHandler();
+void FPU_IRQHandler();
+void UART6_IRQHandler();
+void UART7_IRQHandler();
+void SPI3_IRQHandler();
+void SPI4_IRQHandler();
+void SPI5_IRQHandler();
+void TLI_IRQHandler();
+void TLI_ER_IRQHandler();
+void IPA_IRQHandler();
+}
+
+namespace gd32::vectors {
+	using pHandler = void (*)();
+
+	// exception entries following the initial stack pointer (Reset_Handler .. SysTick_Handler)
+	inline constexpr std::size_t core_vector_count = 15;
+	inline constexpr std::size_t irq_vector_count = IPA_IRQn + 1;
+	inline constexpr std::size_t handler_count = core_vector_count + irq_vector_count;
+
+	// layout of the table as fetched by the core; the stack pointer is kept as a pointer so the
+	// whole object stays a constant expression
+	struct vector_table {
+		unsigned int* initial_sp;
+		std::array<pHandler, handler_count> handlers;
+	};
+
+	static_assert(sizeof(vector_table) == (handler_count + 1) * sizeof(std::uint32_t));
+
+	// VTOR requires the table to be aligned to the next power of two of its size
+	inline constexpr std::size_t vector_table_alignment = 512;
+	static_assert(sizeof(vector_table) <= vector_table_alignment);
+
+	// slot of an IRQn inside vector_table::handlers
+	constexpr auto slot(IRQn_Type irqn) -> std::size_t {
+		return static_cast<std::size_t>(static_cast<int>(irqn) + static_cast<int>(core_vector_count));
+	}
+
+	constexpr auto is_reserved(IRQn_Type irqn) -> bool {
+		const auto n = static_cast<int>(irqn);
+		return n < -14 || n == -13 || (n >= -9 && n <= -6) || n == -3 || n == 79 || n == 87 ||
+			   n >= static_cast<int>(irq_vector_count);
+	}
+
+	// bind a free function (or a captureless lambda converted to one) to an interrupt
+	template <IRQn_Type IRQn, pHandler Handler>
+	struct bind {
+		static_assert(!is_reserved(IRQn), "IRQn has no vector on the GD32F450");
+
+		static constexpr IRQn_Type irqn = IRQn;
+		static constexpr pHandler handler = Handler;
+	};
+
+	// bind a member function of a statically allocated driver object to an interrupt; the
+	// trampoline is the vector itself and the member call inside it is resolved at compile time
+	template <IRQn_Type IRQn, auto& Object, auto Member>
+	struct bind_member {
+		static_assert(!is_reserved(IRQn), "IRQn has no vector on the GD32F450");
+
+		__attribute__((flatten)) static auto trampoline() -> void {
+			(Object.*Member)();
+		}
+
+		static constexpr IRQn_Type irqn = IRQn;
+		static constexpr pHandler handler = &trampoline;
+	};
+
+	inline constexpr vector_table default_table = {
+		&_estack,
+		{
+			Reset_Handler,
+			NMI_Handler,
+			HardFault_Handler,
+			MemManage_Handler,
+			BusFault_Handler,
+			UsageFault_Handler,
+			nullptr,
+			nullptr,
+			nullptr,
+			nullptr,
+			SVC_Handler,
+			DebugMon_Handler,
+			nullptr,
+			PendSV_Handler,
+			SysTick_Handler,
+			WWDGT_IRQHandler,
+			LVD_IRQHandler,
+			TAMPER_STAMP_IRQHandler,
+			RTC_WKUP_IRQHandler,
+			FMC_IRQHandler,
+			RCU_CTC_IRQHandler,
+			EXTI0_IRQHandler,
+			EXTI1_IRQHandler,
+			EXTI2_IRQHandler,
+			EXTI3_IRQHandler,
+			EXTI4_IRQHandler,
+			DMA0_Channel0_IRQHandler,
+			DMA0_Channel1_IRQHandler,
+			DMA0_Channel2_IRQHandler,
+			DMA0_Channel3_IRQHandler,
+			DMA0_Channel4_IRQHandler,
+			DMA0_Channel5_IRQHandler,
+			DMA0_Channel6_IRQHandler,
+			ADC_IRQHandler,
+			CAN0_TX_IRQHandler,
+			CAN0_RX0_IRQHandler,
+			CAN0_RX1_IRQHandler,
+			CAN0_EWMC_IRQHandler,
+			EXTI5_9_IRQHandler,
+			TIMER0_BRK_TIMER8_IRQHandler,
+			TIMER0_UP_TIMER9_IRQHandler,
+			TIMER0_TRG_CMT_TIMER10_IRQHandler,
+			TIMER0_Channel_IRQHandler,
+			TIMER1_IRQHandler,
+			TIMER2_IRQHandler,
+			TIMER3_IRQHandler,
+			I2C0_EV_IRQHandler,
+			I2C0_ER_IRQHandler,
+			I2C1_EV_IRQHandler,
+			I2C1_ER_IRQHandler,
+			SPI0_IRQHandler,
+			SPI1_IRQHandler,
+			USART0_IRQHandler,
+			USART1_IRQHandler,
+			USART2_IRQHandler,
+			EXTI10_15_IRQHandler,
+			RTC_Alarm_IRQHandler,
+			USBFS_WKUP_IRQHandler,
+			TIMER7_BRK_TIMER11_IRQHandler,
+			TIMER7_UP_TIMER12_IRQHandler,
+			TIMER7_TRG_CMT_TIMER13_IRQHandler,
+			TIMER7_Channel_IRQHandler,
+			DMA0_Channel7_IRQHandler,
+			EXMC_IRQHandler,
+			SDIO_IRQHandler,
+			TIMER4_IRQHandler,
+			SPI2_IRQHandler,
+			UART3_IRQHandler,
+			UART4_IRQHandler,
+			TIMER5_DAC_IRQHandler,
+			TIMER6_IRQHandler,
+			DMA1_Channel0_IRQHandler,
+			DMA1_Channel1_IRQHandler,
+			DMA1_Channel2_IRQHandler,
+			DMA1_Channel3_IRQHandler,
+			DMA1_Channel4_IRQHandler,
+			ENET_IRQHandler,
+			ENET_WKUP_IRQHandler,
+			CAN1_TX_IRQHandler,
+			CAN1_RX0_IRQHandler,
+			CAN1_RX1_IRQHandler,
+			CAN1_EWMC_IRQHandler,
+			USBFS_IRQHandler,
+			DMA1_Channel5_IRQHandler,
+			DMA1_Channel6_IRQHandler,
+			DMA1_Channel7_IRQHandler,
+			USART5_IRQHandler,
+			I2C2_EV_IRQHandler,
+			I2C2_ER_IRQHandler,
+			USBHS_EP1_Out_IRQHandler,
+			USBHS_EP1_In_IRQHandler,
+			USBHS_WKUP_IRQHandler,
+			USBHS_IRQHandler,
+			DCI_IRQHandler,
+			nullptr,
+			TRNG_IRQHandler,
+			FPU_IRQHandler,
+			UART6_IRQHandler,
+			UART7_IRQHandler,
+			SPI3_IRQHandler,
+			SPI4_IRQHandler,
+			SPI5_IRQHandler,
+			nullptr,
+			TLI_IRQHandler,
+			TLI_ER_IRQHandler,
+			IPA_IRQHandler,
+		},
+	};
+
+	namespace detail {
+		template <typename... Bindings>
+		constexpr auto unique_bindings() -> bool {
+			constexpr std::array<int, sizeof...(Bindings) + 1> irqs = {static_cast<int>(Bindings::irqn)..., 0};
+			for (std::size_t i = 0; i < sizeof...(Bindings); ++i) {
+				for (std::size_t j = i + 1; j < sizeof...(Bindings); ++j) {
+					if (irqs[i] == irqs[j]) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+	}  // namespace detail
+
+	// build the vector table with every binding replacing its default handler
+	template <typename... Bindings>
+	constexpr auto make_table() -> vector_table {
+		static_assert(detail::unique_bindings<Bindings...>(), "IRQn bound more than once");
+
+		auto table = default_table;
+		((table.handlers[slot(Bindings::irqn)] = Bindings::handler), ...);
+		return table;
+	}
+
+	// RAM copy of the vector table, placed by the linker script into .ram_vector
+	extern vector_table sram_table;
+
+	// copy the given table to SRAM and point VTOR at it; the copy is done with interrupts masked
+	// so no exception can be taken from a half written table
+	inline auto relocate(const vector_table& table) -> void {
+		const auto primask = __get_PRIMASK();
+		__disable_irq();
+
+		sram_table = table;
+		__DSB();
+		SCB->VTOR = reinterpret_cast<std::uint32_t>(&sram_table);
+		__DSB();
+		__ISB();
+
+		__set_PRIMASK(primask);
+	}
+}  // namespace gd32::vectors
+
+extern "C" const gd32::vectors::vector_table g_pfnVectors;
+
+// define the flash vector table of the application, only valid with GD32_USER_VECTOR_TABLE set
+#define GD32_VECTOR_TABLE(...)                                                                  \
+	extern "C" __attribute__((section(".isr_vector"), used))                                      \
+	const ::gd32::vectors::vector_table g_pfnVectors = ::gd32::vectors::make_table<__VA_ARGS__>()
+
+#endif /* GD32F4XX_VECTORS_HPP */
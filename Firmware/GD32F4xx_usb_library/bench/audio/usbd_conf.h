@@ -0,0 +1,65 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the audio host bench, the speaker of the audio
+             example at full speed
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+
+/* usb configure exported defines */
+#define USBD_CFG_MAX_NUM                    1U
+#define USBD_ITF_MAX_NUM                    3U
+
+#define USBD_AD_INTERFACE                   0U
+
+#define USB_STR_DESC_MAX_SIZE               255U
+
+/* Audio class layer parameter */
+#define AD_OUT_EP                           EP_OUT(3U)
+#define AD_IN_EP                            EP_IN(1U)
+#define AD_FEEDBACK_IN_EP                   EP_IN(2U)
+
+#define USB_STRING_COUNT                    4U
+
+/* speaker parameter */
+#define USBD_SPEAKER_FREQ                   USBD_AD_FREQ_48K
+#define SPEAKER_OUT_BIT_RESOLUTION          16U
+#define SPEAKER_OUT_CHANNEL_NBR             2U
+#define SPEAKER_OUT_PACKET                  (uint32_t)(((USBD_SPEAKER_FREQ * \
+                                                        (SPEAKER_OUT_BIT_RESOLUTION / 8U) * \
+                                                         SPEAKER_OUT_CHANNEL_NBR) / 1000U))
+
+/* feedback parameter */
+#define FEEDBACK_FREQ_OFFSET                (USBD_SPEAKER_FREQ / 100U)
+#define FEEDBACK_IN_PACKET                  3U
+#define FEEDBACK_IN_INTERVAL                5U
+
+#define SPEAKER_OUT_MAX_PACKET              (SPEAKER_OUT_PACKET + 20U)
+
+/* audio frequency in Hz */
+#define USBD_AD_FREQ_48K                    48000U
+
+#define DEFAULT_VOLUME                      65U
+
+/* audio commands of the codec layer */
+enum {
+    AD_CMD_PLAY = 1U,
+    AD_CMD_PAUSE,
+    AD_CMD_STOP
+};
+
+/*!
+    \brief      get the calculate value of i2s sample frequency, as on the board
+    \param[in]  set_freq: setting sample frequence
+    \param[out] none
+    \retval     i2s sample frequency
+*/
+__STATIC_INLINE uint32_t I2S_ACTUAL_SAM_FREQ(uint32_t set_freq)
+{
+    return (USBD_AD_FREQ_48K == set_freq) ? 47990U : set_freq;
+}
+
+#endif /* USBD_CONF_H */
@@ -0,0 +1,436 @@
+/*!
+    \file    audio_bench.c
+    \brief   depth, latency and rate estimation of the speaker buffer of the audio class under
+             clock drift between host and device
+
+    The audio class driver runs unchanged against a frame model of the bus instead of
+    usb_sim.c, since the speaker depends on clocks rather than on transfer times. The host
+    starts a SOF every millisecond of its own clock, which runs off by host_ppm, and sends one
+    isochronous OUT packet per frame at a random time inside the frame. The packet holds as many
+    samples as the asynchronous feedback asks for: the host adds the last 10.14 value it read
+    to an accumulator every frame and sends its integer part. It reads the feedback endpoint
+    every 2^FEEDBACK_IN_INTERVAL frames, as bRefresh tells it, and gets the value the device
+    armed when the previous read finished.
+
+    The I2S DMA plays the parts of the buffer that usbd_audio_spk_dma_done() hands out at the
+    rate of the board, I2S_ACTUAL_SAM_FREQ() off by dev_ppm, and tells its position through
+    audio_remaining. Every sample carries its number in the stream, so a dropped or repeated
+    sample shows up at the DMA.
+
+    The checks run the drifts of the table and expect, once the feedback has settled, no
+    underruns, overruns or lost samples, a latency close to OUT_TARGET_PACKETS frames and a
+    rate estimate within 100 ppm of the real rate of the I2S in host frames.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "audio_core.h"
+#include "audio_out_itf.h"
+
+#define BENCH_FRAMES                    30000U
+#define SETTLE_FRAMES                   5000U
+#define START_FRAMES                    (OUT_TARGET_PACKETS + 2U)
+#define FEEDBACK_POLL_FRAMES            (1U << FEEDBACK_IN_INTERVAL)
+#define LATENCY_LIMIT_US                ((OUT_TARGET_PACKETS + 2U) * 1000U)
+#define RATE_LIMIT_PPM                  100.0
+
+/* clocks of a run */
+typedef struct {
+    double host_ppm;                                    /*!< error of the SOF period */
+    double dev_ppm;                                     /*!< error of the I2S rate */
+    uint32_t jitter_us;                                 /*!< OUT packets arrive up to this late in the frame */
+} drift_struct;
+
+static const drift_struct drifts[] = {
+    {0.0, 0.0, 900U},
+    {0.0, 200.0, 900U},
+    {0.0, -200.0, 900U},
+    {100.0, -100.0, 900U},
+    {0.0, 1000.0, 900U},
+    {0.0, -1000.0, 900U},
+    {-500.0, 500.0, 0U},
+};
+
+static usb_core_driver udev;
+static uint8_t *out_buf;
+static uint8_t fb_sent[FEEDBACK_IN_PACKET];
+static uint8_t fb_armed;
+
+static double now;
+static double dev_rate;
+static uint32_t rng;
+
+static uint8_t dma_running;
+static const uint8_t *dma_buf;
+static uint32_t dma_len;
+static double dma_start;
+static uint32_t dma_expect;
+static uint32_t dma_lost;
+static uint32_t dma_samples;
+
+static uint32_t host_sample;
+static uint32_t host_acc;
+static uint32_t host_feedback;
+static int failures;
+
+/*!
+    \brief      pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     number
+*/
+static uint32_t rand_next(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return rng >> 8;
+}
+
+/*!
+    \brief      configure an endpoint, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_desc: endpoint descriptor
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_setup(usb_core_driver *udev, const usb_desc_ep *ep_desc)
+{
+    return 0U;
+}
+
+/*!
+    \brief      clear an endpoint, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_clear(usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+/*!
+    \brief      flush an endpoint FIFO, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_fifo_flush(usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+/*!
+    \brief      flush a TX FIFO, nothing to do on the host
+    \param[in]  usb_regs: pointer to USB core registers
+    \param[in]  fifo_num: FIFO number
+    \param[out] none
+    \retval     operation status
+*/
+usb_status usb_txfifo_flush(usb_core_regs *usb_regs, uint8_t fifo_num)
+{
+    return USB_OK;
+}
+
+/*!
+    \brief      arm an IN endpoint, the FIFO of the feedback endpoint takes the value now
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: data to send
+    \param[in]  len: length of the data
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_send(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    if((AD_FEEDBACK_IN_EP == ep_addr) && (FEEDBACK_IN_PACKET == len)) {
+        memcpy(fb_sent, pbuf, FEEDBACK_IN_PACKET);
+        fb_armed = 1U;
+    }
+    return 0U;
+}
+
+/*!
+    \brief      arm an OUT endpoint
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: receive buffer
+    \param[in]  len: size of the buffer
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_recev(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    if(AD_OUT_EP == ep_addr) {
+        out_buf = pbuf;
+    }
+    return 0U;
+}
+
+/*!
+    \brief      initialize the codec, nothing to do on the host
+    \param[in]  audio_freq: sample rate
+    \param[in]  volume: volume
+    \param[out] none
+    \retval     USBD_OK
+*/
+static uint8_t codec_init(uint32_t audio_freq, uint32_t volume)
+{
+    return USBD_OK;
+}
+
+/*!
+    \brief      deinitialize the codec, nothing to do on the host
+    \param[in]  none
+    \param[out] none
+    \retval     USBD_OK
+*/
+static uint8_t codec_deinit(void)
+{
+    return USBD_OK;
+}
+
+/*!
+    \brief      start a DMA transfer of the I2S
+    \param[in]  pbuf: data to play
+    \param[in]  size: length in half words
+    \param[in]  cmd: AD_CMD_PLAY, the others only stop the DMA
+    \param[out] none
+    \retval     USBD_OK
+*/
+static uint8_t codec_cmd(uint8_t *pbuf, uint32_t size, uint8_t cmd)
+{
+    dma_running = 0U;
+    if((AD_CMD_PLAY == cmd) && (0U != size)) {
+        dma_buf = pbuf;
+        dma_len = 2U * size;
+        dma_start = now;
+        dma_running = 1U;
+    }
+    return USBD_OK;
+}
+
+/*!
+    \brief      bytes of the current DMA transfer the I2S has not taken yet
+    \param[in]  none
+    \param[out] none
+    \retval     bytes
+*/
+static uint32_t codec_remaining(void)
+{
+    uint32_t taken;
+
+    if(!dma_running) {
+        return 0U;
+    }
+    taken = 2U * (uint32_t)floor((now - dma_start) * dev_rate * 2.0);
+    return (taken < dma_len) ? (dma_len - taken) : 0U;
+}
+
+audio_fops_struct audio_out_fops = {
+    .audio_init      = codec_init,
+    .audio_deinit    = codec_deinit,
+    .audio_cmd       = codec_cmd,
+    .audio_remaining = codec_remaining
+};
+
+/*!
+    \brief      play the DMA transfers that end before a time, as the DMA interrupt would
+    \param[in]  t: time in s
+    \param[out] none
+    \retval     none
+*/
+static void dma_run_until(double t)
+{
+    uint8_t *next;
+    uint32_t i, sample;
+    double end;
+
+    while(dma_running) {
+        end = dma_start + (double)(dma_len / SPEAKER_OUT_FRAME_SIZE) / dev_rate;
+        if(end > t) {
+            break;
+        }
+
+        for(i = 0U; i < dma_len; i += SPEAKER_OUT_FRAME_SIZE) {
+            memcpy(&sample, &dma_buf[i], sizeof(sample));
+            if(sample != dma_expect) {
+                dma_lost++;
+            }
+            dma_expect = sample + 1U;
+        }
+        dma_samples += dma_len / SPEAKER_OUT_FRAME_SIZE;
+
+        now = end;
+        dma_len = usbd_audio_spk_dma_done(&next);
+        dma_buf = next;
+        dma_start = end;
+        dma_running = (0U != dma_len) ? 1U : 0U;
+    }
+}
+
+/*!
+    \brief      the host sends the OUT packet of a frame
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void host_out(void)
+{
+    uint32_t samples, i;
+
+    host_acc += host_feedback;
+    samples = host_acc >> 14;
+    host_acc &= 0x3FFFU;
+    if(samples * SPEAKER_OUT_FRAME_SIZE > SPEAKER_OUT_MAX_PACKET) {
+        samples = SPEAKER_OUT_MAX_PACKET / SPEAKER_OUT_FRAME_SIZE;
+    }
+
+    for(i = 0U; i < samples; i++) {
+        memcpy(&out_buf[i * SPEAKER_OUT_FRAME_SIZE], &host_sample, sizeof(host_sample));
+        host_sample++;
+    }
+    udev.dev.transc_out[EP_ID(AD_OUT_EP)].xfer_count = samples * SPEAKER_OUT_FRAME_SIZE;
+    usbd_audio_cb.data_out(&udev, EP_ID(AD_OUT_EP));
+}
+
+/*!
+    \brief      the host reads the feedback endpoint, the device arms the next value
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void host_feedback_read(void)
+{
+    if(!fb_armed) {
+        return;
+    }
+    host_feedback = (uint32_t)fb_sent[0] | ((uint32_t)fb_sent[1] << 8) | ((uint32_t)fb_sent[2] << 16);
+    fb_armed = 0U;
+    usbd_audio_cb.data_in(&udev, EP_ID(AD_FEEDBACK_IN_EP));
+}
+
+/*!
+    \brief      stream through the speaker under a drift and print a line of the table
+    \param[in]  drift: clocks of the run
+    \param[out] none
+    \retval     none
+*/
+static void drift_run(const drift_struct *drift)
+{
+    const double frame = 0.001 * (1.0 + drift->host_ppm * 1e-6);
+    usbd_audio_spk_stats stats;
+    usb_req req;
+    uint32_t k, underruns = 0U, overruns = 0U, lost = 0U, started = 0U;
+    uint32_t lat_min = 0xFFFFFFFFU, lat_max = 0U;
+    double lat_sum = 0.0, true_rate, rate_err;
+
+    memset(&udev, 0, sizeof(udev));
+    udev.dev.class_core = &usbd_audio_cb;
+    now = 0.0;
+    dev_rate = (double)I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) * (1.0 + drift->dev_ppm * 1e-6);
+    rng = 1U;
+    dma_running = 0U;
+    dma_expect = 0U;
+    dma_lost = 0U;
+    dma_samples = 0U;
+    host_sample = 0U;
+    host_acc = 0U;
+    host_feedback = (USBD_SPEAKER_FREQ << 14) / 1000U;
+    fb_armed = 0U;
+
+    usbd_audio_cb.init(&udev, 0U);
+
+    /* the host selects the operational alternate setting of the speaker */
+    memset(&req, 0, sizeof(req));
+    req.bmRequestType = USB_RECPTYPE_ITF;
+    req.bRequest = USB_SET_INTERFACE;
+    req.wValue = 1U;
+    req.wIndex = USBD_AD_INTERFACE + 1U;
+    usbd_audio_cb.set_intf(&udev, &req);
+
+    for(k = 0U; k < BENCH_FRAMES; k++) {
+        dma_run_until(k * frame);
+        now = k * frame;
+        usbd_audio_cb.SOF(&udev);
+
+        if(0U == k % FEEDBACK_POLL_FRAMES) {
+            host_feedback_read();
+        }
+
+        now = k * frame + (double)(rand_next() % (drift->jitter_us + 1U)) * 1e-6;
+        dma_run_until(now);
+        host_out();
+
+        if(!started && audio_handler.play_flag) {
+            started = k + 1U;
+        }
+
+        usbd_audio_spk_stats_get(&stats);
+        if(SETTLE_FRAMES == k) {
+            underruns = stats.underruns;
+            overruns = stats.overruns;
+            lost = dma_lost;
+        } else if(k > SETTLE_FRAMES) {
+            lat_sum += stats.latency_us;
+            if(stats.latency_us < lat_min) {
+                lat_min = stats.latency_us;
+            }
+            if(stats.latency_us > lat_max) {
+                lat_max = stats.latency_us;
+            }
+        }
+    }
+
+    usbd_audio_spk_stats_get(&stats);
+    underruns = stats.underruns - underruns;
+    overruns = stats.overruns - overruns;
+    lost = dma_lost - lost;
+    true_rate = dev_rate * frame * 16384.0;
+    rate_err = ((double)stats.rate - true_rate) / true_rate * 1e6;
+
+    printf("%6.0f  %6.0f  %6u  %5u  %6.0f  %5u  %6u  %6u  %5u  %7.1f  %9.5f\n",
+           drift->host_ppm, drift->dev_ppm, (unsigned)drift->jitter_us, (unsigned)started,
+           lat_sum / (double)(BENCH_FRAMES - SETTLE_FRAMES - 1U), (unsigned)lat_min, (unsigned)lat_max,
+           (unsigned)underruns, (unsigned)(overruns + lost), rate_err, (double)stats.feedback / 16384.0);
+
+    if((0U == started) || (started > START_FRAMES) || underruns || overruns || lost || \
+            (lat_max > LATENCY_LIMIT_US) || (fabs(rate_err) > RATE_LIMIT_PPM)) {
+        printf("  drift of %.0f/%.0f ppm failed\n", drift->host_ppm, drift->dev_ppm);
+        failures++;
+    }
+}
+
+/*!
+    \brief      run the drifts of the table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    const uint32_t rate = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
+    uint32_t i;
+
+    printf("OUT_PACKET_NUM %u, OUT_TARGET_PACKETS %u, FEEDBACK_RATE_FRAMES %u, FEEDBACK_DEPTH_FRAMES %u\n",
+           (unsigned)OUT_PACKET_NUM, (unsigned)OUT_TARGET_PACKETS, (unsigned)FEEDBACK_RATE_FRAMES,
+           (unsigned)FEEDBACK_DEPTH_FRAMES);
+    printf("feedback of %u Hz: 10.14 %.5f, former encoding %.5f samples per frame\n\n", (unsigned)rate,
+           (double)(((uint64_t)rate << 14) / 1000U) / 16384.0,
+           (double)(((rate / 1000U) << 14) | ((rate % 1000U) << 4)) / 16384.0);
+
+    printf("host    dev     jitter  start  latency (us)           under   lost   rate     feedback\n");
+    printf("ppm     ppm     us      frame  mean    min    max     runs    smp    ppm      smp/frame\n");
+    for(i = 0U; i < sizeof(drifts) / sizeof(drifts[0]); i++) {
+        drift_run(&drifts[i]);
+    }
+
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
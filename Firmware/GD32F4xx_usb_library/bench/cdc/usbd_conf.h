@@ -0,0 +1,28 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the CDC ACM host bench, as in cdc_acm with an
+             ULPI PHY
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+
+/* USB configure exported defines */
+#define USBD_CFG_MAX_NUM                1U
+#define USBD_ITF_MAX_NUM                1U
+#define USB_STR_DESC_MAX_SIZE           255U
+
+#define CDC_COM_INTERFACE               0U
+
+#define CDC_DATA_IN_EP                  EP1_IN
+#define CDC_DATA_OUT_EP                 EP3_OUT
+#define CDC_CMD_EP                      EP2_IN
+
+#define USB_STRING_COUNT                4U
+
+#define USB_CDC_CMD_PACKET_SIZE         8U
+#define USB_CDC_DATA_PACKET_SIZE        512U
+
+#endif /* USBD_CONF_H */
@@ -0,0 +1,482 @@
+/*!
+    \file    cdc_bench.c
+    \brief   throughput of the CDC ACM data endpoints in the one packet and the streaming mode
+
+    The CDC ACM class driver runs unchanged on the USB core stand-in of usb_sim.c. The host
+    writes a byte pattern to the OUT endpoint in chunks of a given size and checks every byte
+    it reads from the IN endpoint, in order. It also follows the end of its reads: an IN
+    transfer of whole packets leaves the read open, a short packet or a ZLP ends it. The read
+    must not stay open once the device has nothing more to send, and a ZLP must not arrive
+    when no read is open.
+
+    The application is a main loop that runs every APP_POLL_NS and takes APP_COPY_BYTES_PER_US
+    for the bytes it copies. It loops the data back with cdc_acm_data_receive() and
+    cdc_acm_data_send() as the cdc_acm example used to, loops it back through the streaming
+    mode as the example does now, or only sends or only receives through the streaming mode.
+
+    The checks before the table run the streaming mode with odd chunk and write sizes, total
+    lengths on and off packet boundaries, and a slow application that lets the TX ring run
+    dry and the receive buffers fill up. With the internal DMA no transfer may start off a word
+    boundary. The table moves 4MB per line, with 64KB host chunks,
+    and prints the MB/s of the data, the mean length of the IN transfers, the ZLPs and the
+    cycles the interrupt of the USB core spends per KB moved.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "usb_sim.h"
+#include "cdc_acm_core.h"
+
+#define BENCH_BYTES                     (4U * 1048576U)
+#define BENCH_CHUNK                     65536U
+#define APP_POLL_NS                     1000U
+#define APP_SLOW_POLL_NS                200000U
+#define APP_COPY_BYTES_PER_US           400U
+#define APP_BUF_SIZE                    65536U
+#define TIME_LIMIT_NS                   10000000000ULL
+
+/* core clock of the ISR cycles column */
+#define CPU_MHZ                         200U
+
+/* what the main loop does */
+enum {
+    APP_LEGACY_ECHO = 0,                                /*!< loop back with the one packet API */
+    APP_STREAM_ECHO,                                    /*!< loop back through the streaming mode */
+    APP_STREAM_TX,                                      /*!< send the pattern through the streaming mode */
+    APP_STREAM_RX                                       /*!< receive the pattern through the streaming mode */
+};
+
+static const char *const app_names[] = {"echo 1pkt", "echo stream", "tx stream", "rx stream"};
+
+/* the FIFO mode takes an interrupt of about 100 cycles per packet and copies a word in about
+   5 cycles, the DMA mode only interrupts at the end of a transfer */
+static const usb_sim_bus_struct bus_dma = {"dma", 40U, 10000U, 1000U, 0U, 0U, 1U};
+static const usb_sim_bus_struct bus_fifo = {"fifo", 40U, 10000U, 1000U, 500U, 25U, 0U};
+
+static const uint32_t sizes_bench[] = {USB_CDC_STREAM_XFER_SIZE};
+static const uint32_t sizes_chunk[] = {BENCH_CHUNK};
+static const uint32_t sizes_odd[] = {1U, 63U, 512U, 1000U, 4096U, 5000U, 16384U, 511U};
+static const uint32_t sizes_small[] = {7U, 300U, 1U, 2048U};
+
+static usb_core_driver udev;
+static uint32_t app_mode;
+static uint32_t app_poll_ns;
+static const uint32_t *app_sizes;
+static uint32_t app_size_count;
+static uint32_t app_size_index;
+static uint32_t app_done;
+static uint8_t app_buf[APP_BUF_SIZE];
+
+static uint32_t total;
+static uint32_t host_out_total;
+static const uint32_t *host_chunks;
+static uint32_t host_chunk_count;
+static uint32_t host_chunk_index;
+static uint32_t host_chunk_left;
+static uint32_t host_sent;
+static uint32_t host_received;
+static uint32_t host_in_transfers;
+static uint32_t host_zlps;
+static uint8_t host_open;
+static int run_errors;
+static int failures;
+
+/*!
+    \brief      byte of the pattern
+    \param[in]  pos: position in the stream
+    \param[out] none
+    \retval     byte
+*/
+static uint8_t pattern_byte(uint32_t pos)
+{
+    return (uint8_t)((pos * 7U) ^ (pos >> 9));
+}
+
+/*!
+    \brief      report an error of the current run, only the first few are printed
+    \param[in]  what: description
+    \param[in]  pos: position in the stream
+    \param[out] none
+    \retval     none
+*/
+static void run_error(const char *what, uint32_t pos)
+{
+    if(run_errors < 3) {
+        printf("  %s at %u\n", what, (unsigned)pos);
+    }
+    run_errors++;
+}
+
+/*!
+    \brief      the CDC handler of the device
+    \param[in]  none
+    \param[out] none
+    \retval     handler
+*/
+static usb_cdc_handler *cdc_handler(void)
+{
+    return (usb_cdc_handler *)udev.dev.class_data[CDC_COM_INTERFACE];
+}
+
+/*!
+    \brief      an IN transfer reached the host
+    \param[in]  ep_num: endpoint number
+    \param[in]  data: data of the transfer
+    \param[in]  len: length of the transfer
+    \param[out] none
+    \retval     none
+*/
+static void host_in_done(uint8_t ep_num, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    if(EP_ID(CDC_DATA_IN_EP) != ep_num) {
+        run_error("IN transfer on the command endpoint", host_received);
+        return;
+    }
+
+    if(0U == len) {
+        if(!host_open) {
+            run_error("ZLP without an open read", host_received);
+        }
+        host_zlps++;
+        host_open = 0U;
+        return;
+    }
+
+    for(i = 0U; i < len; i++) {
+        if(data[i] != pattern_byte(host_received + i)) {
+            run_error("wrong byte from the device", host_received + i);
+            break;
+        }
+    }
+    host_received += len;
+    host_in_transfers++;
+    host_open = (0U == len % USB_CDC_DATA_PACKET_SIZE) ? 1U : 0U;
+}
+
+/*!
+    \brief      bytes the host has for an OUT endpoint, up to the end of its current chunk
+    \param[in]  ep_num: endpoint number
+    \param[out] none
+    \retval     bytes
+*/
+static uint32_t host_out_avail(uint8_t ep_num)
+{
+    uint32_t left = host_out_total - host_sent;
+
+    if((EP_ID(CDC_DATA_OUT_EP) != ep_num) || (0U == left)) {
+        return 0U;
+    }
+    if(0U == host_chunk_left) {
+        host_chunk_left = host_chunks[host_chunk_index++ % host_chunk_count];
+    }
+    return (host_chunk_left < left) ? host_chunk_left : left;
+}
+
+/*!
+    \brief      the host sends up to len bytes of the pattern
+    \param[in]  ep_num: endpoint number
+    \param[in]  len: size of the receive buffer
+    \param[out] buf: receive buffer
+    \retval     bytes sent
+*/
+static uint32_t host_out_fill(uint8_t ep_num, uint8_t *buf, uint32_t len)
+{
+    uint32_t avail = host_out_avail(ep_num);
+    uint32_t i;
+
+    if(len > avail) {
+        len = avail;
+    }
+    for(i = 0U; i < len; i++) {
+        buf[i] = pattern_byte(host_sent + i);
+    }
+    host_sent += len;
+    host_chunk_left -= len;
+    return len;
+}
+
+/*!
+    \brief      the device stalled an endpoint, CDC ACM never does
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     none
+*/
+static void host_stall(uint8_t ep_addr)
+{
+    run_error("endpoint stalled", ep_addr);
+}
+
+static const usb_sim_host_struct host = {host_in_done, host_out_avail, host_out_fill, host_stall};
+
+/*!
+    \brief      next read or write size of the application
+    \param[in]  none
+    \param[out] none
+    \retval     bytes
+*/
+static uint32_t app_size(void)
+{
+    return app_sizes[app_size_index++ % app_size_count];
+}
+
+/*!
+    \brief      one round of the main loop
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void app_poll(void *arg)
+{
+    uint32_t len, moved = 0U, i;
+
+    switch(app_mode) {
+    case APP_LEGACY_ECHO:
+        if(0U == cdc_acm_check_ready(&udev)) {
+            cdc_acm_data_receive(&udev);
+        } else {
+            moved = cdc_handler()->receive_length;
+            cdc_acm_data_send(&udev);
+        }
+        break;
+
+    case APP_STREAM_ECHO:
+        cdc_acm_stream_start(&udev);
+        len = app_size();
+        if(len > cdc_acm_stream_tx_space(&udev)) {
+            len = cdc_acm_stream_tx_space(&udev);
+        }
+        moved = cdc_acm_stream_read(&udev, app_buf, len);
+        if(moved && (moved != cdc_acm_stream_write(&udev, app_buf, moved))) {
+            run_error("TX ring took less than its free space", app_done);
+        }
+        app_done += moved;
+        break;
+
+    case APP_STREAM_TX:
+        cdc_acm_stream_start(&udev);
+        len = app_size();
+        if(len > total - app_done) {
+            len = total - app_done;
+        }
+        for(i = 0U; i < len; i++) {
+            app_buf[i] = pattern_byte(app_done + i);
+        }
+        moved = cdc_acm_stream_write(&udev, app_buf, len);
+        app_done += moved;
+        break;
+
+    default:
+        cdc_acm_stream_start(&udev);
+        moved = cdc_acm_stream_read(&udev, app_buf, app_size());
+        for(i = 0U; i < moved; i++) {
+            if(app_buf[i] != pattern_byte(app_done + i)) {
+                run_error("wrong byte from the host", app_done + i);
+                break;
+            }
+        }
+        app_done += moved;
+        break;
+    }
+
+    usb_sim_at(usb_sim_now() + app_poll_ns + (uint64_t)moved * 1000U / APP_COPY_BYTES_PER_US, app_poll, NULL);
+}
+
+/*!
+    \brief      end condition of a run: all data moved and no IN transfer left in flight
+    \param[in]  none
+    \param[out] none
+    \retval     1 when done
+*/
+static int run_done(void)
+{
+    if(usb_sim_now() > TIME_LIMIT_NS) {
+        return 1;
+    }
+
+    switch(app_mode) {
+    case APP_LEGACY_ECHO:
+        return (total == host_received) && cdc_handler()->packet_sent;
+    case APP_STREAM_RX:
+        return total == app_done;
+    default:
+        return (total == host_received) && !cdc_handler()->tx_busy;
+    }
+}
+
+/*!
+    \brief      move the data of a run
+    \param[in]  bus: bus model
+    \param[in]  mode: what the main loop does
+    \param[in]  bytes: bytes to move
+    \param[in]  chunks: host write sizes, used in turn
+    \param[in]  chunk_count: number of host write sizes
+    \param[in]  sizes: read or write sizes of the application, used in turn
+    \param[in]  size_count: number of application sizes
+    \param[in]  poll_ns: time of a main loop round without data
+    \param[out] none
+    \retval     none
+*/
+static void run(const usb_sim_bus_struct *bus, uint32_t mode, uint32_t bytes,
+                const uint32_t *chunks, uint32_t chunk_count,
+                const uint32_t *sizes, uint32_t size_count, uint32_t poll_ns)
+{
+    usb_sim_stats_struct stats;
+
+    memset(&udev, 0, sizeof(udev));
+    udev.dev.class_core = &cdc_class;
+    usb_sim_init(&udev, bus, &host);
+    cdc_class.init(&udev, 0U);
+
+    app_mode = mode;
+    app_poll_ns = poll_ns;
+    app_sizes = sizes;
+    app_size_count = size_count;
+    app_size_index = 0U;
+    app_done = 0U;
+
+    total = bytes;
+    host_out_total = (APP_STREAM_TX == mode) ? 0U : bytes;
+    host_chunks = chunks;
+    host_chunk_count = chunk_count;
+    host_chunk_index = 0U;
+    host_chunk_left = 0U;
+    host_sent = 0U;
+    host_received = 0U;
+    host_in_transfers = 0U;
+    host_zlps = 0U;
+    host_open = 0U;
+    run_errors = 0;
+
+    usb_sim_at(0U, app_poll, NULL);
+    if(!usb_sim_run(run_done) || (usb_sim_now() > TIME_LIMIT_NS)) {
+        run_error("data stopped", (APP_STREAM_RX == mode) ? app_done : host_received);
+    }
+    if((APP_LEGACY_ECHO != mode) && host_open) {
+        run_error("host read left open", host_received);
+    }
+    usb_sim_stats_get(&stats);
+    if(0U != stats.dma_unaligned) {
+        run_error("DMA transfers off a word boundary", stats.dma_unaligned);
+    }
+}
+
+/*!
+    \brief      check a streaming run against the counters of the driver
+    \param[in]  what: name of the check
+    \param[in]  expect_full: 1 if the receive buffers have to fill up
+    \param[out] none
+    \retval     none
+*/
+static void run_check(const char *what, uint8_t expect_full)
+{
+    usb_cdc_stream_stats stats;
+
+    cdc_acm_stream_stats_get(&udev, &stats);
+    if((APP_STREAM_RX != app_mode) && ((stats.tx_bytes != total) || (stats.tx_zlps != host_zlps) || \
+                                       (stats.tx_transfers != host_in_transfers))) {
+        run_error("TX counters differ from the host", stats.tx_bytes);
+    }
+    if((APP_STREAM_TX != app_mode) && (stats.rx_bytes != total)) {
+        run_error("RX counters differ from the host", stats.rx_bytes);
+    }
+    if(expect_full && (0U == stats.rx_full)) {
+        run_error("receive buffers never filled up", 0U);
+    }
+    if(run_errors) {
+        printf("  %s failed\n", what);
+        failures++;
+    }
+}
+
+/*!
+    \brief      check the streaming mode on a bus
+    \param[in]  bus: bus model
+    \param[out] none
+    \retval     none
+*/
+static void check_run(const usb_sim_bus_struct *bus)
+{
+    static const uint32_t tx_totals[] = {512U, 4096U, 8704U, 1000U, 70000U, 65536U};
+    uint32_t i;
+
+    run(bus, APP_STREAM_ECHO, 300000U, sizes_odd, 8U, sizes_bench, 1U, APP_POLL_NS);
+    run_check("echo of odd chunks", 0U);
+    run(bus, APP_STREAM_ECHO, 300000U, sizes_odd, 8U, sizes_small, 4U, APP_POLL_NS);
+    run_check("echo of odd chunks and odd reads", 0U);
+
+    for(i = 0U; i < sizeof(tx_totals) / sizeof(tx_totals[0]); i++) {
+        run(bus, APP_STREAM_TX, tx_totals[i], sizes_chunk, 1U, sizes_chunk, 1U, APP_POLL_NS);
+        run_check("tx of whole writes", 0U);
+        run(bus, APP_STREAM_TX, tx_totals[i], sizes_chunk, 1U, sizes_small, 4U, APP_POLL_NS);
+        run_check("tx of odd writes", 0U);
+        run(bus, APP_STREAM_TX, tx_totals[i], sizes_chunk, 1U, sizes_odd, 8U, APP_SLOW_POLL_NS);
+        run_check("tx of a slow application", 0U);
+    }
+
+    run(bus, APP_STREAM_RX, 300000U, sizes_odd, 8U, sizes_small, 4U, APP_POLL_NS);
+    run_check("rx of odd chunks and odd reads", 0U);
+    run(bus, APP_STREAM_RX, 300000U, sizes_chunk, 1U, sizes_odd, 8U, APP_SLOW_POLL_NS);
+    run_check("rx of a slow application", 1U);
+
+    printf("check %s: %s\n", bus->name, failures ? "FAILED" : "ok");
+}
+
+/*!
+    \brief      move BENCH_BYTES and print a line of the table
+    \param[in]  bus: bus model
+    \param[in]  mode: what the main loop does
+    \param[out] none
+    \retval     none
+*/
+static void bench_run(const usb_sim_bus_struct *bus, uint32_t mode)
+{
+    usb_sim_stats_struct stats;
+
+    run(bus, mode, BENCH_BYTES, sizes_chunk, 1U, sizes_bench, 1U, APP_POLL_NS);
+    if(run_errors) {
+        printf("  %s on %s failed\n", app_names[mode], bus->name);
+        failures++;
+    }
+    usb_sim_stats_get(&stats);
+
+    printf("%-11s  %-4s  %6.2f  %7.0f  %6u  %6.0f\n", app_names[mode], bus->name,
+           (double)BENCH_BYTES / 1048576.0 / ((double)usb_sim_now() / 1e9),
+           host_in_transfers ? (double)host_received / (double)host_in_transfers : 0.0,
+           (unsigned)host_zlps,
+           (double)stats.isr_ns * CPU_MHZ / 1000.0 / ((double)(stats.in_bytes + stats.out_bytes) / 1024.0));
+}
+
+/*!
+    \brief      run the checks and the benchmark table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    printf("USB_CDC_STREAM_XFER_SIZE %u, USB_CDC_STREAM_TX_SIZE %u, USB_CDC_STREAM_RX_BUFS %u\n\n",
+           (unsigned)USB_CDC_STREAM_XFER_SIZE, (unsigned)USB_CDC_STREAM_TX_SIZE,
+           (unsigned)USB_CDC_STREAM_RX_BUFS);
+
+    check_run(&bus_dma);
+    check_run(&bus_fifo);
+
+    printf("\nmode         bus     MB/s   IN len    ZLPs     isr   (MB/s each way, mean IN transfer, ISR cycles per KB)\n");
+    bench_run(&bus_dma, APP_LEGACY_ECHO);
+    bench_run(&bus_dma, APP_STREAM_ECHO);
+    bench_run(&bus_fifo, APP_LEGACY_ECHO);
+    bench_run(&bus_fifo, APP_STREAM_ECHO);
+    bench_run(&bus_dma, APP_STREAM_TX);
+    bench_run(&bus_dma, APP_STREAM_RX);
+    bench_run(&bus_fifo, APP_STREAM_TX);
+    bench_run(&bus_fifo, APP_STREAM_RX);
+
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the descriptor host bench, as in
+             composite_dev_hid_printer
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+
+/* USB configure exported defines */
+#define USBD_CFG_MAX_NUM                    1U
+#define USBD_ITF_MAX_NUM                    2U
+
+#define USB_STR_DESC_MAX_SIZE               255U
+
+/* endpoint used by the custom HID device */
+#define CUSTOMHID_IN_EP                     EP_IN(1U)
+#define CUSTOMHID_OUT_EP                    EP_OUT(1U)
+
+/* endpoint used by the USB printer device */
+#define PRINTER_IN_EP                       EP_IN(2U)
+#define PRINTER_OUT_EP                      EP_OUT(2U)
+
+#define USB_STRING_COUNT                    4U
+
+#define CUSTOMHID_OUT_PACKET                2U
+#define CUSTOMHID_IN_PACKET                 2U
+
+#define PRINTER_IN_PACKET                   64U
+#define PRINTER_OUT_PACKET                  64U
+
+#endif /* USBD_CONF_H */
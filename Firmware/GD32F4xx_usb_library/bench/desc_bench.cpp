@@ -0,0 +1,278 @@
+/*!
+    \file    desc_bench.cpp
+    \brief   descriptors and routing of usbd_desc.hpp against the hand-written ones
+
+    hid_printer_desc.cpp of composite_dev_hid_printer is built next to the C wrapper it replaces,
+    whose symbols get a c_ prefix, with stand-ins of the HID and printer class drivers that log
+    every call. The bench compares the device, configuration and string descriptors byte for
+    byte and sends the same requests and endpoint events through both class drivers.
+
+    A CDC ACM configuration built with the endpoints of cdc/usbd_conf.h must give the bytes of
+    cdc_config_desc in cdc_acm_core.c. A printer and CDC ACM composite checks the interface
+    association descriptor, the CDC interface numbers shifted behind the printer and the
+    endpoint numbers given by the builder.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "usbd_desc.hpp"
+
+extern "C" {
+#include "hid_printer_wrapper.h"
+
+extern usb_desc c_hid_printer_desc;
+extern usb_class_core c_hid_printer_cb;
+extern usb_desc cdc_desc;
+}
+
+namespace {
+	namespace desc = usbd::desc;
+
+	int failures = 0;
+
+	auto check(bool ok, const char* what) -> void {
+		if (!ok) {
+			std::printf("FAIL: %s\n", what);
+			++failures;
+		}
+	}
+
+	// calls of the class driver stand-ins, as "<driver> <handler> <argument>"
+	std::vector<std::string> calls;
+
+	auto log(const char* driver, const char* handler, unsigned arg) -> std::uint8_t {
+		calls.push_back(std::string(driver) + " " + handler + " " + std::to_string(arg));
+		return USBD_OK;
+	}
+
+	template <const char* Name>
+	struct stand_in {
+		static auto init(usb_dev*, std::uint8_t config_index) -> std::uint8_t { return log(Name, "init", config_index); }
+		static auto deinit(usb_dev*, std::uint8_t config_index) -> std::uint8_t { return log(Name, "deinit", config_index); }
+		static auto req_proc(usb_dev*, usb_req* req) -> std::uint8_t {
+			log(Name, "req", req->wIndex);
+			return REQ_SUPP;
+		}
+		static auto ctlx_out(usb_dev*) -> std::uint8_t { return log(Name, "ctlx_out", 0U); }
+		static auto data_in(usb_dev*, std::uint8_t ep_num) -> std::uint8_t { return log(Name, "in", ep_num); }
+		static auto data_out(usb_dev*, std::uint8_t ep_num) -> std::uint8_t { return log(Name, "out", ep_num); }
+		static auto sof(usb_dev*) -> std::uint8_t { return log(Name, "sof", 0U); }
+
+		static constexpr auto core(bool with_sof) -> usb_class_core {
+			return {0U, 0U, init, deinit, req_proc, nullptr, nullptr, ctlx_out, data_in, data_out,
+					with_sof ? sof : nullptr, nullptr, nullptr};
+		}
+	};
+
+	constexpr char hid_name[] = "hid";
+	constexpr char printer_name[] = "printer";
+	constexpr char cdc_name[] = "cdc";
+}  // namespace
+
+extern "C" {
+usb_class_core usbd_custom_hid_cb = stand_in<hid_name>::core(false);
+usb_class_core usbd_printer_cb = stand_in<printer_name>::core(true);
+}
+
+namespace {
+	usb_class_core cdc_cb = stand_in<cdc_name>::core(false);
+
+	usb_dev udev;
+
+	auto config_length(const std::uint8_t* config) -> unsigned {
+		return config[2] | (config[3] << 8);
+	}
+
+	auto same(const void* a, const void* b, std::size_t len) -> bool {
+		return std::memcmp(a, b, len) == 0;
+	}
+
+	auto print_bytes(const char* name, const std::uint8_t* data, std::size_t len) -> void {
+		std::printf("    %-14s", name);
+		for (std::size_t i = 0; i < len; ++i) {
+			std::printf("%s%02X", (i != 0 && i % 24 == 0) ? "\n                  " : " ", data[i]);
+		}
+		std::printf("\n");
+	}
+
+	auto compare_descriptors() -> void {
+		const auto* dev = c_hid_printer_desc.dev_desc;
+		const auto* config = c_hid_printer_desc.config_desc;
+		const auto length = config_length(config);
+
+		std::printf("composite_dev_hid_printer descriptors:\n");
+		std::printf("    device         %s\n", same(hid_printer_desc.dev_desc, dev, USB_DEV_DESC_LEN) ? "same" : "differs");
+		std::printf("    configuration  %u bytes, %s\n", length,
+					config_length(hid_printer_desc.config_desc) == length && same(hid_printer_desc.config_desc, config, length) ? "same" : "differs");
+
+		check(same(hid_printer_desc.dev_desc, dev, USB_DEV_DESC_LEN), "device descriptor of the HID/printer composite");
+		check(config_length(hid_printer_desc.config_desc) == length, "wTotalLength of the HID/printer composite");
+		check(same(hid_printer_desc.config_desc, config, length), "configuration descriptor of the HID/printer composite");
+
+		bool strings_same = true;
+		for (unsigned i = 0; i < USB_STRING_COUNT; ++i) {
+			const auto* a = static_cast<const std::uint8_t*>(hid_printer_desc.strings[i]);
+			const auto* b = static_cast<const std::uint8_t*>(c_hid_printer_desc.strings[i]);
+			// the serial number is filled in at run time, only its header is set
+			const std::size_t len = (i == STR_IDX_SERIAL) ? 2U : b[0];
+
+			strings_same = strings_same && a[0] == b[0] && same(a, b, len);
+		}
+		std::printf("    strings        %s\n", strings_same ? "same" : "differ");
+		check(strings_same, "string descriptors of the HID/printer composite");
+	}
+
+	// send an event through both class drivers and compare the calls it leads to
+	template <typename F>
+	auto route(const char* what, F&& event) -> void {
+		calls.clear();
+		event(c_hid_printer_cb);
+		const auto wrapper = calls;
+
+		calls.clear();
+		event(usbd_hid_printer_cb);
+		check(calls == wrapper, what);
+	}
+
+	auto request(std::uint8_t type, std::uint8_t request, std::uint16_t index) -> usb_req {
+		usb_req req{};
+
+		req.bmRequestType = type;
+		req.bRequest = request;
+		req.wIndex = index;
+
+		return req;
+	}
+
+	auto compare_routing() -> void {
+		const int routed_failures = failures;
+
+		route("init of the HID/printer composite", [](usb_class_core& cb) { cb.init(&udev, 0U); });
+		route("deinit of the HID/printer composite", [](usb_class_core& cb) { cb.deinit(&udev, 0U); });
+
+		for (std::uint16_t itf : {HID_INTERFACE, PRINTER_INTERFACE}) {
+			// class request and GET_DESCRIPTOR of the HID report descriptor
+			for (std::uint8_t type : {0x21U, 0xA1U, 0x81U}) {
+				auto req = request(type, 0x06U, itf);
+				route("interface request of the HID/printer composite", [&](usb_class_core& cb) { cb.req_proc(&udev, &req); });
+			}
+		}
+
+		for (std::uint8_t ep : {1U, 2U}) {
+			route("data IN of the HID/printer composite", [&](usb_class_core& cb) { cb.data_in(&udev, ep); });
+			route("data OUT of the HID/printer composite", [&](usb_class_core& cb) { cb.data_out(&udev, ep); });
+		}
+
+		// the wrapper sent every request not for interface 0 to the printer, CLEAR_FEATURE of
+		// the HID endpoints included, and dropped the data stages of the control endpoint
+		auto clear_hid_in = request(0x02U, 0x01U, CUSTOMHID_IN_EP);
+		auto clear_printer_out = request(0x02U, 0x01U, PRINTER_OUT_EP);
+		auto set_report = request(0x21U, 0x09U, HID_INTERFACE);
+		auto unknown = request(0x21U, 0x01U, 5U);
+
+		calls.clear();
+		usbd_hid_printer_cb.req_proc(&udev, &clear_hid_in);
+		usbd_hid_printer_cb.req_proc(&udev, &clear_printer_out);
+		usbd_hid_printer_cb.req_proc(&udev, &set_report);
+		usbd_hid_printer_cb.ctlx_out(&udev);
+		const auto status = usbd_hid_printer_cb.req_proc(&udev, &unknown);
+		usbd_hid_printer_cb.ctlx_out(&udev);
+		usbd_hid_printer_cb.SOF(&udev);
+
+		const std::vector<std::string> expected = {
+			"hid req 129", "printer req 2", "hid req 0", "hid ctlx_out 0", "printer sof 0",
+		};
+		check(calls == expected, "endpoint requests, control data stage and SOF of the composite class");
+		check(status == REQ_NOTSUPP, "request for an interface of no function");
+
+		std::printf("    routing        %s\n", failures == routed_failures ? "as the wrapper, endpoint requests to their endpoint" : "differs");
+	}
+
+	// cdc_acm_core.c as built with cdc/usbd_conf.h: data IN EP1, data OUT EP3, command EP2
+	constexpr std::uint8_t cdc_class = 0x02U;
+	constexpr std::uint8_t cdc_acm_subclass = 0x02U;
+	constexpr std::uint8_t cdc_at_protocol = 0x01U;
+	constexpr std::uint8_t cdc_data_class = 0x0AU;
+
+	constexpr auto cdc_acm_function(std::uint8_t cmd_ep, std::uint8_t out_ep, std::uint8_t in_ep) {
+		return desc::function(cdc_cb,
+			desc::interface(cdc_class, cdc_acm_subclass, cdc_at_protocol,
+				desc::cdc::header{0x0110U},
+				desc::cdc::call_management{0x00U},
+				desc::cdc::acm{0x02U},
+				desc::cdc::union_{},
+				desc::in(desc::ep_type::interrupt, 8U, 0x0AU, cmd_ep)),
+			desc::interface(cdc_data_class, 0x00U, 0x00U,
+				desc::out(desc::ep_type::bulk, 512U, 0x00U, out_ep),
+				desc::in(desc::ep_type::bulk, 512U, 0x00U, in_ep)));
+	}
+
+	constexpr auto cdc_config = desc::configuration({0x80U, 0x32U, USBHS_MAX_EP_COUNT}, cdc_acm_function(2U, 3U, 1U));
+	constexpr auto cdc_config_bytes = cdc_config.bytes();
+
+	auto compare_cdc() -> void {
+		const auto* config = cdc_desc.config_desc;
+		const auto length = config_length(config);
+		const bool ok = cdc_config_bytes.size() == length && same(cdc_config_bytes.data(), config, length);
+
+		std::printf("cdc_acm configuration:\n");
+		std::printf("    builder        %u bytes, %s\n", static_cast<unsigned>(cdc_config_bytes.size()), ok ? "same" : "differs");
+		check(ok, "configuration descriptor of CDC ACM");
+	}
+
+	// printer first, the CDC ACM function behind it with endpoints numbered by the builder
+	constexpr auto printer_cdc = desc::configuration(
+		{0x80U, 0x32U, USBHS_MAX_EP_COUNT},
+		desc::function(usbd_printer_cb,
+			desc::interface(0x07U, 0x01U, 0x02U,
+				desc::in(desc::ep_type::bulk, 512U),
+				desc::out(desc::ep_type::bulk, 512U))),
+		cdc_acm_function(desc::auto_number, desc::auto_number, desc::auto_number));
+	constexpr auto printer_cdc_bytes = printer_cdc.bytes();
+	constexpr auto printer_cdc_dispatch = printer_cdc.dispatch();
+
+	constexpr std::uint8_t printer_cdc_expected[] = {
+		0x09, 0x02, 0x62, 0x00, 0x03, 0x01, 0x00, 0x80, 0x32,
+		0x09, 0x04, 0x00, 0x00, 0x02, 0x07, 0x01, 0x02, 0x00,
+		0x07, 0x05, 0x81, 0x02, 0x00, 0x02, 0x00,
+		0x07, 0x05, 0x01, 0x02, 0x00, 0x02, 0x00,
+		0x08, 0x0B, 0x01, 0x02, 0x02, 0x02, 0x01, 0x00,
+		0x09, 0x04, 0x01, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00,
+		0x05, 0x24, 0x00, 0x10, 0x01,
+		0x05, 0x24, 0x01, 0x00, 0x02,
+		0x04, 0x24, 0x02, 0x02,
+		0x05, 0x24, 0x06, 0x01, 0x02,
+		0x07, 0x05, 0x82, 0x03, 0x08, 0x00, 0x0A,
+		0x09, 0x04, 0x02, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00,
+		0x07, 0x05, 0x02, 0x02, 0x00, 0x02, 0x00,
+		0x07, 0x05, 0x83, 0x02, 0x00, 0x02, 0x00,
+	};
+
+	static_assert(printer_cdc_bytes.size() == sizeof(printer_cdc_expected));
+	static_assert(printer_cdc_dispatch.interface[0] == 0 && printer_cdc_dispatch.interface[1] == 1 &&
+				  printer_cdc_dispatch.interface[2] == 1 && printer_cdc_dispatch.interface[3] == desc::none);
+	static_assert(printer_cdc_dispatch.in[1] == 0 && printer_cdc_dispatch.in[2] == 1 && printer_cdc_dispatch.in[3] == 1);
+	static_assert(printer_cdc_dispatch.out[1] == 0 && printer_cdc_dispatch.out[2] == 1 && printer_cdc_dispatch.out[3] == desc::none);
+
+	auto check_printer_cdc() -> void {
+		const bool ok = same(printer_cdc_bytes.data(), printer_cdc_expected, sizeof(printer_cdc_expected));
+
+		std::printf("printer + cdc_acm composite:\n");
+		print_bytes("configuration", printer_cdc_bytes.data(), printer_cdc_bytes.size());
+		check(ok, "configuration descriptor of the printer and CDC ACM composite");
+	}
+}  // namespace
+
+auto main() -> int {
+	compare_descriptors();
+	compare_routing();
+	compare_cdc();
+	check_printer_cdc();
+
+	std::printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+
+	return failures == 0 ? 0 : 1;
+}
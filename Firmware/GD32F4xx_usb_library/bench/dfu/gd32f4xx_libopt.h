@@ -0,0 +1,25 @@
+/*!
+    \file    gd32f4xx_libopt.h
+    \brief   peripheral headers of the DFU host bench, the cycle counter of the DWT is a
+             variable of the bench that follows the time of the FMC model, and the bench
+             never leaves DFU mode, so a reset of the core ends it
+*/
+
+#ifndef GD32F4XX_LIBOPT_H
+#define GD32F4XX_LIBOPT_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include "gd32f4xx_fmc.h"
+
+extern DWT_Type fmc_model_dwt;
+extern CoreDebug_Type fmc_model_core_debug;
+
+#undef DWT
+#define DWT                           (&fmc_model_dwt)
+#undef CoreDebug
+#define CoreDebug                     (&fmc_model_core_debug)
+
+#define NVIC_SystemReset()            abort()
+
+#endif /* GD32F4XX_LIBOPT_H */
@@ -0,0 +1,44 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the DFU host bench, as in dev_firmware_update
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+
+#include "dfu_mem.h"
+#include "nor_flash_if.h"
+#include "nand_flash_if.h"
+#include "inter_flash_if.h"
+
+#define USBD_CFG_MAX_NUM              1U
+#define USBD_ITF_MAX_NUM              1U
+#define USB_STR_DESC_MAX_SIZE         64U
+
+#define DFU_MAX_ALT_ITF_NUM           3U
+#define STR_IDX_ALT_ITF0              5U
+#define STR_IDX_ALT_ITF1              6U
+#define STR_IDX_ALT_ITF2              7U
+
+#define USBD_DFU_INTERFACE            0U
+
+/* Maximum number of supported media (Flash) */
+#define MAX_USED_MEMORY_MEDIA         3U
+
+#define USB_STRING_COUNT              6U
+
+/* DFU maximum data packet size */
+#define TRANSFER_SIZE                 2048U
+
+/* memory address from where user application will be loaded */
+#define APP_LOADED_ADDR               0x08008000U
+
+#define IS_PROTECTED_AREA(addr)       (uint8_t)(((addr >= 0x08000000U) && (addr < (APP_LOADED_ADDR)))? 1U : 0U)
+
+/* DFU endpoint define */
+#define DFU_IN_EP                     EP0_IN
+#define DFU_OUT_EP                    EP0_OUT
+
+#endif /* USBD_CONF_H */
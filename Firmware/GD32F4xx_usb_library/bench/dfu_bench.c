@@ -0,0 +1,512 @@
+/*!
+    \file    dfu_bench.c
+    \brief   update time of the DFU class with the internal flash interface of
+             dev_firmware_update on a model of the FMC
+
+    The DFU class (dfu_core.c, dfu_mem.c) and the flash interface (inter_flash_if.c) run
+    unchanged on fmc_model.c, which maps the flash at 0x08000000 and runs the FMC on a clock
+    of its own. The host behaves like dfu-util with a DfuSe image: an ERASE of every sector
+    before the first chunk in it ("as you go"), or of all sectors of the image first as the
+    GD tools do ("erase first"), then a SET_ADDRESS and one block of TRANSFER_SIZE per chunk.
+    After every request it sends GETSTATUS and sleeps the poll timeout for as long as the
+    device reports dfuDNBUSY. A special command has to report dfuDNBUSY at least once, which
+    dfu-util checks. A control transfer costs CTRL_US plus BYTE_NS per byte on the bus, and
+    waits for an operation of the FMC in bank 0, during which the CPU cannot run.
+
+    The interface runs blocking with the fixed poll timeouts of 60ms and 80ms ("blocking",
+    without its start callbacks) and in the background ("background"). Each run checks the
+    flash against the image after dfu_class.deinit() and counts the GETSTATUS requests, the
+    polls that found the device still busy, the time the host slept while the FMC was idle,
+    and the sectors erased outside of the image. The checks before the table cover a failing
+    program, an erase in the protected area and the misuse counters of the model.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfu_core.h"
+#include "dfu_mem.h"
+#include "fmc_model.h"
+
+#define CTRL_US                         1000U
+#define BYTE_NS                         1000U
+#define IMAGE_MAX                       (512U * 1024U)
+
+/* flash interface of a run */
+#define MODE_BLOCKING                   0U
+#define MODE_BACKGROUND                 1U
+
+/* host of a run */
+#define HOST_AS_YOU_GO                  0U
+#define HOST_ERASE_FIRST                1U
+
+/* image of a run */
+typedef struct {
+    uint32_t addr;                                      /*!< where it goes */
+    uint32_t len;                                       /*!< its length */
+} image_struct;
+
+static const image_struct images[] = {
+    {0x08008000U, 256U * 1024U},
+    {0x08100000U, 512U * 1024U},
+};
+
+static const char *const mode_names[] = {"blocking", "background"};
+static const char *const host_names[] = {"as you go", "erase first"};
+
+static const fmc_model_struct flash_timing = {5000U, 20000U, 10U};
+
+static const uint32_t sector_addr[] = {
+    ADDR_FMC_SECTOR_0, ADDR_FMC_SECTOR_1, ADDR_FMC_SECTOR_2, ADDR_FMC_SECTOR_3,
+    ADDR_FMC_SECTOR_4, ADDR_FMC_SECTOR_5, ADDR_FMC_SECTOR_6, ADDR_FMC_SECTOR_7,
+    ADDR_FMC_SECTOR_8, ADDR_FMC_SECTOR_9, ADDR_FMC_SECTOR_10, ADDR_FMC_SECTOR_11,
+    ADDR_FMC_SECTOR_12, ADDR_FMC_SECTOR_13, ADDR_FMC_SECTOR_14, ADDR_FMC_SECTOR_15,
+    ADDR_FMC_SECTOR_16, ADDR_FMC_SECTOR_17, ADDR_FMC_SECTOR_18, ADDR_FMC_SECTOR_19,
+    ADDR_FMC_SECTOR_20, ADDR_FMC_SECTOR_21, ADDR_FMC_SECTOR_22, ADDR_FMC_SECTOR_23,
+    ADDR_FMC_SECTOR_24, ADDR_FMC_SECTOR_25, ADDR_FMC_SECTOR_26, ADDR_FMC_SECTOR_27,
+    FLASH_END_ADDR
+};
+
+static usb_core_driver udev;
+static uint8_t image[IMAGE_MAX];
+static uint8_t dev_status[6];
+static uint32_t rng = 1U;
+static int failures;
+
+/* counters of a run */
+static uint32_t getstatus_count;
+static uint32_t repoll_count;
+static uint64_t idle_ns;
+
+/* the other memories of the example, not part of the bench */
+static uint8_t no_mem_checkaddr(uint32_t addr)
+{
+    return MEM_FAIL;
+}
+
+dfu_mem_prop dfu_nor_flash_cb = {(const uint8_t *)NOR_FLASH_IF_STR, NULL, NULL, NULL, NULL, NULL, no_mem_checkaddr, 0U, 0U, NULL, NULL, NULL, NULL};
+dfu_mem_prop dfu_nand_flash_cb = {(const uint8_t *)NAND_FLASH_IF_STR, NULL, NULL, NULL, NULL, NULL, no_mem_checkaddr, 0U, 0U, NULL, NULL, NULL, NULL};
+
+/* the callbacks of the flash interface in the background */
+static uint8_t (*flash_erase_start)(uint32_t addr);
+static uint8_t (*flash_write_start)(uint8_t *buf, uint32_t addr, uint32_t len);
+static void (*flash_flush)(void);
+static uint32_t (*flash_timeout)(uint32_t addr, uint8_t cmd, uint32_t len);
+
+/*!
+    \brief      connect the device, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+void usbd_connect(usb_core_driver *udev)
+{
+}
+
+/*!
+    \brief      disconnect the device, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+void usbd_disconnect(usb_core_driver *udev)
+{
+}
+
+/*!
+    \brief      delay in ms
+    \param[in]  msec: time in ms
+    \param[out] none
+    \retval     none
+*/
+void usb_mdelay(const uint32_t msec)
+{
+    fmc_model_advance((uint64_t)msec * 1000000U);
+}
+
+/*!
+    \brief      pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     number
+*/
+static uint32_t rand_next(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return rng >> 8;
+}
+
+/*!
+    \brief      a control transfer to the DFU interface
+    \param[in]  request: DFU request
+    \param[in]  value: wValue
+    \param[in]  data: data of the OUT stage, NULL for an IN stage
+    \param[in]  len: length of the data stage
+    \param[out] none
+    \retval     none
+*/
+static void control(uint8_t request, uint16_t value, const uint8_t *data, uint16_t len)
+{
+    usb_req req = {0x21U, request, value, USBD_DFU_INTERFACE, len};
+    usb_transc *transc;
+
+    if(NULL == data) {
+        req.bmRequestType = 0xA1U;
+    }
+
+    fmc_model_advance((uint64_t)CTRL_US * 1000U + (uint64_t)len * BYTE_NS);
+
+    /* the CPU serves the USB once an operation in bank 0 has ended */
+    fmc_model_cpu();
+
+    dfu_class.req_proc(&udev, &req);
+
+    if(NULL != data) {
+        transc = &udev.dev.transc_out[0];
+        if((0U != len) && ((transc->remain_len != len) || (NULL == transc->xfer_buf))) {
+            printf("  DNLOAD of %u bytes not taken\n", (unsigned)len);
+            failures++;
+            return;
+        }
+        if(0U != len) {
+            memcpy(transc->xfer_buf, data, len);
+        }
+    } else {
+        transc = &udev.dev.transc_in[0];
+        if(DFU_GETSTATUS == request) {
+            memcpy(dev_status, transc->xfer_buf, sizeof(dev_status));
+        }
+        dfu_class.ctlx_in(&udev);
+    }
+}
+
+/*!
+    \brief      send GETSTATUS until the device is no longer busy
+    \param[in]  special: 1 after a special command, which reports busy first
+    \param[out] none
+    \retval     0 if the device ended in dfuDNLOAD-IDLE without error
+*/
+static int status_wait(int special)
+{
+    uint32_t poll;
+    uint64_t busy;
+    fmc_model_stats_struct stats;
+    int first = 1;
+
+    do {
+        control(DFU_GETSTATUS, 0U, NULL, 6U);
+        getstatus_count++;
+
+        if(first && special && (STATE_DFU_DNBUSY != dev_status[4])) {
+            printf("  special command did not report dfuDNBUSY but state %u\n", (unsigned)dev_status[4]);
+            failures++;
+        }
+        if(!first && (STATE_DFU_DNBUSY == dev_status[4])) {
+            repoll_count++;
+        }
+        first = 0;
+
+        if(STATE_DFU_DNBUSY == dev_status[4]) {
+            poll = dev_status[1] | ((uint32_t)dev_status[2] << 8) | ((uint32_t)dev_status[3] << 16);
+
+            /* the part of the sleep the FMC had nothing to do */
+            fmc_model_stats_get(&stats);
+            busy = stats.busy_ns;
+            fmc_model_advance((uint64_t)poll * 1000000U);
+            fmc_model_stats_get(&stats);
+            if((uint64_t)poll * 1000000U > stats.busy_ns - busy) {
+                idle_ns += (uint64_t)poll * 1000000U - (stats.busy_ns - busy);
+            }
+        }
+    } while(STATE_DFU_DNBUSY == dev_status[4]);
+
+    return ((STATUS_OK == dev_status[0]) && (STATE_DFU_DNLOAD_IDLE == dev_status[4])) ? 0 : -1;
+}
+
+/*!
+    \brief      a DfuSe special command
+    \param[in]  cmd: SET_ADDRESS_POINTER or ERASE
+    \param[in]  addr: its address
+    \param[out] none
+    \retval     0 if it was executed
+*/
+static int special(uint8_t cmd, uint32_t addr)
+{
+    uint8_t data[5] = {cmd, (uint8_t)addr, (uint8_t)(addr >> 8), (uint8_t)(addr >> 16), (uint8_t)(addr >> 24)};
+
+    control(DFU_DNLOAD, 0U, data, sizeof(data));
+
+    return status_wait(1);
+}
+
+/*!
+    \brief      index of the sector of an address
+    \param[in]  addr: flash address
+    \param[out] none
+    \retval     index
+*/
+static uint32_t sector_of(uint32_t addr)
+{
+    uint32_t i = 0U;
+
+    while(addr >= sector_addr[i + 1U]) {
+        i++;
+    }
+
+    return i;
+}
+
+/*!
+    \brief      download an image the way dfu-util does
+    \param[in]  img: image
+    \param[in]  host: HOST_AS_YOU_GO or HOST_ERASE_FIRST
+    \param[out] none
+    \retval     0 if every request succeeded
+*/
+static int download(const image_struct *img, uint8_t host)
+{
+    uint32_t off, len, sector;
+    uint32_t erased_to = 0U;
+
+    if(HOST_ERASE_FIRST == host) {
+        for(sector = sector_of(img->addr); sector <= sector_of(img->addr + img->len - 1U); sector++) {
+            if(0 != special(ERASE, sector_addr[sector])) {
+                return -1;
+            }
+        }
+        erased_to = sector_of(img->addr + img->len - 1U) + 1U;
+    }
+
+    for(off = 0U; off < img->len; off += TRANSFER_SIZE) {
+        len = (img->len - off < TRANSFER_SIZE) ? img->len - off : TRANSFER_SIZE;
+
+        /* erase the sectors of the chunk the host has not erased yet */
+        for(sector = sector_of(img->addr + off); sector <= sector_of(img->addr + off + len - 1U); sector++) {
+            if(sector >= erased_to) {
+                if(0 != special(ERASE, sector_addr[sector])) {
+                    return -1;
+                }
+                erased_to = sector + 1U;
+            }
+        }
+
+        if(0 != special(SET_ADDRESS_POINTER, img->addr + off)) {
+            return -1;
+        }
+
+        control(DFU_DNLOAD, 2U, &image[off], (uint16_t)len);
+        if(0 != status_wait(0)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      start the device with the flash interface blocking or in the background
+    \param[in]  mode: MODE_BLOCKING or MODE_BACKGROUND
+    \param[in]  seed: seed of the flash model
+    \param[out] none
+    \retval     none
+*/
+static void device_start(uint8_t mode, uint32_t seed)
+{
+    fmc_model_init(&flash_timing, seed);
+
+    dfu_inter_flash_cb.mem_erase_start = (MODE_BACKGROUND == mode) ? flash_erase_start : NULL;
+    dfu_inter_flash_cb.mem_write_start = (MODE_BACKGROUND == mode) ? flash_write_start : NULL;
+    dfu_inter_flash_cb.mem_flush = (MODE_BACKGROUND == mode) ? flash_flush : NULL;
+    dfu_inter_flash_cb.mem_timeout = (MODE_BACKGROUND == mode) ? flash_timeout : NULL;
+
+    memset(&udev, 0, sizeof(udev));
+    udev.dev.desc = &dfu_desc;
+    dfu_class.init(&udev, 0U);
+
+    getstatus_count = 0U;
+    repoll_count = 0U;
+    idle_ns = 0U;
+}
+
+/*!
+    \brief      fill the image, with some blank blocks as in the gaps of a real one
+    \param[in]  len: length
+    \param[out] none
+    \retval     none
+*/
+static void image_fill(uint32_t len)
+{
+    uint32_t i;
+
+    for(i = 0U; i < len; i += 4U) {
+        *(uint32_t *)&image[i] = ((i / TRANSFER_SIZE) % 16U == 7U) ? 0xFFFFFFFFU : (rand_next() ^ (rand_next() << 9));
+    }
+}
+
+/*!
+    \brief      compare the flash with the image
+    \param[in]  img: image
+    \param[out] none
+    \retval     0 if equal
+*/
+static int verify(const image_struct *img)
+{
+    if(0 != memcmp((const void *)(uintptr_t)img->addr, image, img->len)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      number of sectors erased outside of an image
+    \param[in]  img: image
+    \param[out] none
+    \retval     number
+*/
+static uint32_t erased_outside(const image_struct *img)
+{
+    fmc_model_stats_struct stats;
+    uint32_t sector, count = 0U;
+
+    fmc_model_stats_get(&stats);
+    for(sector = 0U; sector < FLASH_SECTOR_NUM; sector++) {
+        if((stats.erased & (1U << sector)) && ((sector < sector_of(img->addr)) ||
+                                                (sector > sector_of(img->addr + img->len - 1U)))) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*!
+    \brief      check the error paths and the use of the FMC
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_run(void)
+{
+    static const image_struct small = {0x08100000U, 64U * 1024U};
+    fmc_model_stats_struct stats;
+    uint8_t mode;
+
+    /* a failing program ends the download with errPROG, the blocking interface ignores it */
+    image_fill(small.len);
+    device_start(MODE_BACKGROUND, 7U);
+    fmc_model_fail(small.addr + 20U * 1024U + 8U);
+    if((0 == download(&small, HOST_AS_YOU_GO)) || (STATUS_ERR_PROG != dev_status[0]) ||
+            (STATE_DFU_ERROR != dev_status[4])) {
+        printf("  failing program gave status %u state %u\n", (unsigned)dev_status[0], (unsigned)dev_status[4]);
+        failures++;
+    }
+
+    /* the host clears the error and downloads again */
+    fmc_model_fail(FMC_MODEL_NO_FAIL);
+    control(DFU_CLRSTATUS, 0U, (const uint8_t *)"", 0U);
+    if(0 != download(&small, HOST_AS_YOU_GO)) {
+        printf("  download after CLRSTATUS failed\n");
+        failures++;
+    }
+    dfu_class.deinit(&udev, 0U);
+    if(0 != verify(&small)) {
+        printf("  flash differs from the image after CLRSTATUS\n");
+        failures++;
+    }
+    fmc_model_stats_get(&stats);
+    if((1U != stats.errors) || (0U != stats.violations)) {
+        printf("  %u failed programs and %u violations of the FMC\n", (unsigned)stats.errors,
+               (unsigned)stats.violations);
+        failures++;
+    }
+
+    for(mode = MODE_BLOCKING; mode <= MODE_BACKGROUND; mode++) {
+        /* an erase in the protected area fails */
+        device_start(mode, 8U);
+        if((0 == special(ERASE, 0x08004000U)) || (STATE_DFU_ERROR != dev_status[4])) {
+            printf("  %s: erase of the protected area was not refused\n", mode_names[mode]);
+            failures++;
+        }
+
+        fmc_model_stats_get(&stats);
+        if(0U != stats.violations) {
+            printf("  %s: %u violations of the FMC\n", mode_names[mode], (unsigned)stats.violations);
+            failures++;
+        }
+    }
+
+    printf("check INTER_FLASH_ERASE_AHEAD %u: %s\n", (unsigned)INTER_FLASH_ERASE_AHEAD, failures ? "FAILED" : "ok");
+}
+
+/*!
+    \brief      download the images with every host and flash interface
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void table_run(void)
+{
+    fmc_model_stats_struct stats;
+    uint32_t i;
+    uint8_t host, mode;
+    double s;
+
+    printf("\nimage        host         flash          s     KB/s  GETSTATUS  repolls  idle ms  erased  stalled ms\n");
+    for(i = 0U; i < sizeof(images) / sizeof(images[0]); i++) {
+        image_fill(images[i].len);
+
+        for(host = HOST_AS_YOU_GO; host <= HOST_ERASE_FIRST; host++) {
+            for(mode = MODE_BLOCKING; mode <= MODE_BACKGROUND; mode++) {
+                device_start(mode, 100U + i);
+
+                if(0 != download(&images[i], host)) {
+                    printf("  download failed with status %u state %u\n", (unsigned)dev_status[0], (unsigned)dev_status[4]);
+                    failures++;
+                }
+
+                /* the last block is written in the background */
+                dfu_class.deinit(&udev, 0U);
+                s = (double)fmc_model_now() / 1e9;
+
+                if(0 != verify(&images[i])) {
+                    printf("  flash differs from the image\n");
+                    failures++;
+                }
+
+                fmc_model_stats_get(&stats);
+                if(0U != stats.violations) {
+                    printf("  %u violations of the FMC\n", (unsigned)stats.violations);
+                    failures++;
+                }
+
+                printf("%3uKB@%08X  %-11s  %-10s  %6.2f  %7.1f  %9u  %7u  %7.0f  %6u  %10.0f\n",
+                       (unsigned)(images[i].len / 1024U), (unsigned)images[i].addr, host_names[host],
+                       mode_names[mode], s, (double)images[i].len / 1024.0 / s, (unsigned)getstatus_count,
+                       (unsigned)repoll_count, (double)idle_ns / 1e6, (unsigned)erased_outside(&images[i]),
+                       (double)stats.stalled_ns / 1e6);
+            }
+        }
+    }
+}
+
+/*!
+    \brief      run the checks and the table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    /* the callbacks the blocking runs leave out */
+    flash_erase_start = dfu_inter_flash_cb.mem_erase_start;
+    flash_write_start = dfu_inter_flash_cb.mem_write_start;
+    flash_flush = dfu_inter_flash_cb.mem_flush;
+    flash_timeout = dfu_inter_flash_cb.mem_timeout;
+
+    check_run();
+    table_run();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,283 @@
+/*!
+    \file    fifo_bench.c
+    \brief   correctness and cycle estimate of the FIFO copy kernels of drv_usb_fifo.h
+
+    The kernels run against a model of the FIFO register that logs the words written and
+    hands out the words to read. Every length from 0 to FIFO_MAX_LEN at every offset of the
+    buffer to a word boundary is checked in both directions: the FIFO gets the packet bytes in
+    order in exactly (length + 3) / 4 words, a read fills exactly the packet bytes and none of
+    the guard bytes around them. The aligned kernels are also checked on their own, without
+    the address check in front.
+
+    The cycle table is an estimate from the Cortex-M4 instruction timing, not a measurement:
+    a load takes 2 cycles and 1 more for every further register of an LDM, an unaligned word
+    load 2 cycles more and it does not pipeline, a store to the FIFO 2 cycles, a data
+    processing instruction 1 and a taken branch 3. It compares the previous loop of one
+    __packed word access per FIFO word with the kernels, per packet of the given length.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+static uint32_t fifo_words[512];
+static uint32_t fifo_count;
+static uint32_t fifo_pos;
+
+/*!
+    \brief      the model of the FIFO takes a word
+    \param[in]  word: word
+    \param[out] none
+    \retval     none
+*/
+static void fifo_put(uint32_t word)
+{
+    if(fifo_count < sizeof(fifo_words) / sizeof(fifo_words[0])) {
+        fifo_words[fifo_count] = word;
+    }
+    fifo_count++;
+}
+
+/*!
+    \brief      the model of the FIFO hands out a word
+    \param[in]  none
+    \param[out] none
+    \retval     word
+*/
+static uint32_t fifo_get(void)
+{
+    uint32_t word = 0U;
+
+    if(fifo_pos < sizeof(fifo_words) / sizeof(fifo_words[0])) {
+        word = fifo_words[fifo_pos];
+    }
+    fifo_pos++;
+    return word;
+}
+
+#define USB_FIFO_PUT(fifo, word)        ((void)(fifo), fifo_put(word))
+#define USB_FIFO_GET(fifo)              ((void)(fifo), fifo_get())
+
+#include "drv_usb_fifo.h"
+
+#define FIFO_MAX_LEN                    1100U
+#define FIFO_GUARD                      8U
+#define FIFO_GUARD_BYTE                 0xA5U
+
+/* Cortex-M4 cycles of the estimate */
+#define CYC_LDR                         2U
+#define CYC_LDR_UNALIGNED               4U
+#define CYC_LDRB                        2U
+#define CYC_STR_FIFO                    2U
+#define CYC_ALU                         1U
+#define CYC_BRANCH                      3U
+
+/* loop counter, pointer update and branch back */
+#define CYC_LOOP                        (2U * CYC_ALU + CYC_BRANCH)
+
+static uint8_t src_buf[FIFO_MAX_LEN + 2U * FIFO_GUARD] __attribute__((aligned(4)));
+static uint8_t dst_buf[FIFO_MAX_LEN + 2U * FIFO_GUARD] __attribute__((aligned(4)));
+static __IO uint32_t fifo_reg;
+static int failures;
+
+/*!
+    \brief      check the words the FIFO got for a packet
+    \param[in]  data: packet
+    \param[in]  len: packet length
+    \param[in]  what: name of the case
+    \param[out] none
+    \retval     none
+*/
+static void write_check(const uint8_t *data, uint32_t len, const char *what)
+{
+    uint32_t i;
+
+    if(fifo_count != (len + 3U) / 4U) {
+        printf("  %s of %u bytes wrote %u words\n", what, (unsigned)len, (unsigned)fifo_count);
+        failures++;
+        return;
+    }
+    for(i = 0U; i < len; i++) {
+        if((uint8_t)(fifo_words[i / 4U] >> (8U * (i % 4U))) != data[i]) {
+            printf("  %s of %u bytes has a wrong byte %u\n", what, (unsigned)len, (unsigned)i);
+            failures++;
+            return;
+        }
+    }
+}
+
+/*!
+    \brief      check a packet read from the FIFO and the guard bytes around it
+    \param[in]  off: offset of the packet in dst_buf
+    \param[in]  len: packet length
+    \param[in]  what: name of the case
+    \param[out] none
+    \retval     none
+*/
+static void read_check(uint32_t off, uint32_t len, const char *what)
+{
+    uint32_t i;
+
+    if(fifo_pos != (len + 3U) / 4U) {
+        printf("  %s of %u bytes read %u words\n", what, (unsigned)len, (unsigned)fifo_pos);
+        failures++;
+        return;
+    }
+    for(i = 0U; i < sizeof(dst_buf); i++) {
+        uint8_t expect = ((i >= off) && (i < off + len)) ? src_buf[i - off] : FIFO_GUARD_BYTE;
+
+        if(dst_buf[i] != expect) {
+            printf("  %s of %u bytes at offset %u has a wrong byte %u\n", what, (unsigned)len,
+                   (unsigned)off, (unsigned)i);
+            failures++;
+            return;
+        }
+    }
+}
+
+/*!
+    \brief      check every length at every offset in both directions
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_run(void)
+{
+    uint32_t off, len, i;
+
+    for(i = 0U; i < sizeof(src_buf); i++) {
+        src_buf[i] = (uint8_t)(i * 7U + 1U);
+    }
+
+    for(off = 0U; off < 4U; off++) {
+        for(len = 0U; len <= FIFO_MAX_LEN; len++) {
+            /* memory to FIFO, the address selects the kernel */
+            fifo_count = 0U;
+            usb_fifo_write(&fifo_reg, &src_buf[FIFO_GUARD + off], len);
+            write_check(&src_buf[FIFO_GUARD + off], len, "write");
+
+            /* FIFO to memory, the FIFO holds the packet of src_buf */
+            memset(dst_buf, FIFO_GUARD_BYTE, sizeof(dst_buf));
+            for(i = 0U; i < (len + 3U) / 4U; i++) {
+                fifo_words[i] = usb_fifo_bytes_load(&src_buf[4U * i], 4U);
+            }
+            fifo_pos = 0U;
+            usb_fifo_read(&fifo_reg, &dst_buf[FIFO_GUARD + off], len);
+            read_check(FIFO_GUARD + off, len, "read");
+        }
+    }
+
+    /* the aligned kernels called directly */
+    for(len = 0U; len <= FIFO_MAX_LEN; len++) {
+        fifo_count = 0U;
+        usb_fifo_write_aligned(&fifo_reg, (const uint32_t *)&src_buf[FIFO_GUARD], len);
+        write_check(&src_buf[FIFO_GUARD], len, "word write");
+
+        memset(dst_buf, FIFO_GUARD_BYTE, sizeof(dst_buf));
+        for(i = 0U; i < (len + 3U) / 4U; i++) {
+            fifo_words[i] = usb_fifo_bytes_load(&src_buf[4U * i], 4U);
+        }
+        fifo_pos = 0U;
+        usb_fifo_read_aligned(&fifo_reg, (uint32_t *)&dst_buf[FIFO_GUARD], len);
+        read_check(FIFO_GUARD, len, "word read");
+    }
+
+    printf("check USB_FIFO_UNROLL %u: %s\n", (unsigned)USB_FIFO_UNROLL, failures ? "FAILED" : "ok");
+}
+
+/*!
+    \brief      estimated cycles of up to 3 bytes gathered into a word, a jump into the byte loads
+    \param[in]  n: number of bytes
+    \param[out] none
+    \retval     cycles
+*/
+static uint32_t cycles_bytes(uint32_t n)
+{
+    return CYC_BRANCH + n * (CYC_LDRB + CYC_ALU);
+}
+
+/*!
+    \brief      estimated cycles of the __packed word loop
+    \param[in]  len: packet length
+    \param[in]  off: offset of the buffer to a word boundary
+    \param[out] none
+    \retval     cycles
+*/
+static uint32_t cycles_packed(uint32_t len, uint32_t off)
+{
+    uint32_t words = (len + 3U) / 4U;
+
+    return words * ((off ? CYC_LDR_UNALIGNED : CYC_LDR) + CYC_STR_FIFO + CYC_LOOP);
+}
+
+/*!
+    \brief      estimated cycles of the kernels
+    \param[in]  len: packet length
+    \param[in]  off: offset of the buffer to a word boundary
+    \param[out] none
+    \retval     cycles
+*/
+static uint32_t cycles_kernel(uint32_t len, uint32_t off)
+{
+    uint32_t cycles = 4U * CYC_ALU;
+    uint32_t words;
+
+    if(0U == off) {
+        words = len / 4U;
+        if(USB_FIFO_UNROLL >= 8U) {
+            cycles += (words / 8U) * (CYC_LDR + 7U + 8U * CYC_STR_FIFO + CYC_LOOP);
+            words %= 8U;
+        }
+        cycles += (words / 4U) * (CYC_LDR + 3U + 4U * CYC_STR_FIFO + CYC_LOOP);
+        cycles += (words % 4U) * (CYC_LDR + CYC_STR_FIFO + CYC_LOOP);
+        if(len & 3U) {
+            cycles += cycles_bytes(len & 3U) + CYC_STR_FIFO;
+        }
+        return cycles;
+    }
+
+    /* head, merged words by 4 and singly, then the carry with the tail */
+    cycles += cycles_bytes(4U - off) + 2U * CYC_ALU;
+    if(len < 4U) {
+        return cycles;
+    }
+    words = (len - (4U - off)) / 4U;
+    cycles += (words / 4U) * (CYC_LDR + 3U + 4U * (3U * CYC_ALU + CYC_STR_FIFO) + CYC_LOOP);
+    cycles += (words % 4U) * (CYC_LDR + 3U * CYC_ALU + CYC_STR_FIFO + CYC_LOOP);
+    cycles += cycles_bytes(3U) + 2U * CYC_ALU + 2U * CYC_STR_FIFO;
+    return cycles;
+}
+
+/*!
+    \brief      print the cycle estimate
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void cycles_run(void)
+{
+    static const uint32_t lengths[] = {8U, 64U, 512U};
+    uint32_t i, off;
+
+    printf("\nlength  offset  packed  kernel  (estimated Cortex-M4 cycles per packet)\n");
+    for(i = 0U; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        for(off = 0U; off < 4U; off += (0U == off) ? 1U : 2U) {
+            printf("%6u  %6u  %6u  %6u\n", (unsigned)lengths[i], (unsigned)off,
+                   (unsigned)cycles_packed(lengths[i], off), (unsigned)cycles_kernel(lengths[i], off));
+        }
+    }
+}
+
+/*!
+    \brief      run the checks and the cycle estimate
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    check_run();
+    cycles_run();
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,486 @@
+/*!
+    \file    fmc_model.c
+    \brief   FMC and internal flash model behind the functions of gd32f4xx_fmc.h and
+             fmc_async.h of dev_firmware_update, for the DFU host bench
+
+    The 3MB of flash are mapped read-only at 0x08000000, so that the code under test reads
+    them where the board has them and any write that does not go through the FMC faults. An
+    erase sets a sector to 0xFF and a program ANDs the word in, at the end of the operation.
+    The operations take the time of fmc_model_struct with some random spread and raise the
+    FMC interrupt at their end if it is enabled; the interrupt runs inter_flash_if_irq() the
+    next time fmc_model_advance() lets time pass. The blocking functions of the library wait
+    for the end by letting the time pass in the caller.
+
+    The CPU fetches its code from bank 0: while an operation runs there, the CPU waits for
+    its end before it can serve the USB (fmc_model_cpu()).
+
+    Misuse of the FMC is counted as a violation: an operation started while another one runs
+    or while the FMC is locked, a program of an unaligned word or outside the flash, a
+    program that would turn a 0 bit into a 1 and a reset of the command bits while busy.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fmc_model.h"
+#include "fmc_async.h"
+#include "inter_flash_if.h"
+
+#define FMC_MODEL_SIZE                  (FLASH_END_ADDR - FLASH_START_ADDR)
+#define FMC_MODEL_BANK1                 0x08100000U
+#define FMC_MODEL_NS_PER_CYCLE          5U
+#define FMC_MODEL_BLANK_SECTOR          20U
+#define FMC_MODEL_ERR_FLAGS             (FMC_FLAG_OPERR | FMC_FLAG_WPERR | FMC_FLAG_PGMERR | FMC_FLAG_PGSERR)
+
+/* operation of the FMC */
+#define FMC_MODEL_IDLE                  0U
+#define FMC_MODEL_ERASE                 1U
+#define FMC_MODEL_PROGRAM               2U
+
+uint32_t SystemCoreClock = 1000U * 1000U * 1000U / FMC_MODEL_NS_PER_CYCLE;
+DWT_Type fmc_model_dwt;
+CoreDebug_Type fmc_model_core_debug;
+
+static const uint32_t model_sector_addr[FLASH_SECTOR_NUM + 1U] = {
+    ADDR_FMC_SECTOR_0, ADDR_FMC_SECTOR_1, ADDR_FMC_SECTOR_2, ADDR_FMC_SECTOR_3,
+    ADDR_FMC_SECTOR_4, ADDR_FMC_SECTOR_5, ADDR_FMC_SECTOR_6, ADDR_FMC_SECTOR_7,
+    ADDR_FMC_SECTOR_8, ADDR_FMC_SECTOR_9, ADDR_FMC_SECTOR_10, ADDR_FMC_SECTOR_11,
+    ADDR_FMC_SECTOR_12, ADDR_FMC_SECTOR_13, ADDR_FMC_SECTOR_14, ADDR_FMC_SECTOR_15,
+    ADDR_FMC_SECTOR_16, ADDR_FMC_SECTOR_17, ADDR_FMC_SECTOR_18, ADDR_FMC_SECTOR_19,
+    ADDR_FMC_SECTOR_20, ADDR_FMC_SECTOR_21, ADDR_FMC_SECTOR_22, ADDR_FMC_SECTOR_23,
+    ADDR_FMC_SECTOR_24, ADDR_FMC_SECTOR_25, ADDR_FMC_SECTOR_26, ADDR_FMC_SECTOR_27,
+    FLASH_END_ADDR
+};
+
+static const fmc_model_struct *timing;
+static uint8_t *flash_rw;
+static uint64_t now;
+static uint32_t rng;
+static uint32_t fail_addr = FMC_MODEL_NO_FAIL;
+static fmc_model_stats_struct stats;
+
+static uint8_t op = FMC_MODEL_IDLE;
+static uint32_t op_addr;
+static uint32_t op_data;
+static uint8_t op_sector;
+static uint8_t op_fail;
+static uint64_t op_start;
+static uint64_t op_end;
+static uint32_t stat;
+static uint32_t int_enabled;
+static uint8_t irq_pending;
+static uint8_t locked;
+
+/*!
+    \brief      pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     number
+*/
+static uint32_t rand_next(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return rng >> 8;
+}
+
+/*!
+    \brief      set the time and the cycle counter of the DWT
+    \param[in]  t: time in ns
+    \param[out] none
+    \retval     none
+*/
+static void time_set(uint64_t t)
+{
+    now = t;
+    fmc_model_dwt.CYCCNT = (uint32_t)(t / FMC_MODEL_NS_PER_CYCLE);
+}
+
+/*!
+    \brief      a time with the random spread of the model
+    \param[in]  ns: nominal time
+    \param[out] none
+    \retval     time in ns
+*/
+static uint64_t spread(uint64_t ns)
+{
+    int64_t pct = (int64_t)(rand_next() % (2U * timing->noise_pct + 1U)) - (int64_t)timing->noise_pct;
+
+    return (uint64_t)((int64_t)ns + (int64_t)ns * pct / 100);
+}
+
+/*!
+    \brief      start an operation
+    \param[in]  kind: FMC_MODEL_ERASE or FMC_MODEL_PROGRAM
+    \param[in]  ns: its time
+    \param[out] none
+    \retval     none
+*/
+static void op_begin(uint8_t kind, uint64_t ns)
+{
+    op = kind;
+    op_start = now;
+    op_end = now + ns;
+}
+
+/*!
+    \brief      end the operation at its time
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void op_complete(void)
+{
+    uint32_t off;
+
+    if(op_fail) {
+        stat |= FMC_FLAG_OPERR;
+        stats.errors++;
+    } else if(FMC_MODEL_ERASE == op) {
+        off = model_sector_addr[op_sector] - FLASH_START_ADDR;
+        memset(flash_rw + off, 0xFF, model_sector_addr[op_sector + 1U] - model_sector_addr[op_sector]);
+        stats.erased |= 1U << op_sector;
+    } else {
+        off = op_addr - FLASH_START_ADDR;
+        *(uint32_t *)(flash_rw + off) &= op_data;
+    }
+
+    op = FMC_MODEL_IDLE;
+    stat |= FMC_FLAG_END;
+    stats.busy_ns += op_end - op_start;
+
+    if((int_enabled & FMC_INT_END) || (op_fail && (int_enabled & FMC_INT_ERR))) {
+        irq_pending = 1U;
+    }
+}
+
+/*!
+    \brief      map the flash at its address, fill it and reset the FMC and the time
+    \param[in]  model: timing of the flash
+    \param[in]  seed: seed of the contents and the spread
+    \param[out] none
+    \retval     none
+*/
+void fmc_model_init(const fmc_model_struct *model, uint32_t seed)
+{
+    static int fd = -1;
+    uint32_t i;
+
+    if(fd < 0) {
+        fd = memfd_create("flash", 0);
+        if((fd < 0) || (0 != ftruncate(fd, FMC_MODEL_SIZE))) {
+            perror("flash");
+            exit(2);
+        }
+        if(MAP_FAILED == mmap((void *)(uintptr_t)FLASH_START_ADDR, FMC_MODEL_SIZE, PROT_READ,
+                              MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0)) {
+            perror("flash at 0x08000000");
+            exit(2);
+        }
+        flash_rw = mmap(NULL, FMC_MODEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(MAP_FAILED == flash_rw) {
+            perror("flash");
+            exit(2);
+        }
+    }
+
+    timing = model;
+    rng = seed;
+
+    /* old code and data below sector 20, blank above */
+    for(i = 0U; i < FMC_MODEL_SIZE; i += 4U) {
+        *(uint32_t *)(flash_rw + i) = (i < model_sector_addr[FMC_MODEL_BLANK_SECTOR] - FLASH_START_ADDR) ?
+                                      (rand_next() ^ (rand_next() << 8)) : 0xFFFFFFFFU;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    fail_addr = FMC_MODEL_NO_FAIL;
+    op = FMC_MODEL_IDLE;
+    stat = 0U;
+    int_enabled = 0U;
+    irq_pending = 0U;
+    locked = 1U;
+    time_set(0U);
+}
+
+/*!
+    \brief      fail the program of the word at an address
+    \param[in]  addr: flash address, FMC_MODEL_NO_FAIL for none
+    \param[out] none
+    \retval     none
+*/
+void fmc_model_fail(uint32_t addr)
+{
+    fail_addr = addr;
+}
+
+/*!
+    \brief      current time
+    \param[in]  none
+    \param[out] none
+    \retval     time in ns
+*/
+uint64_t fmc_model_now(void)
+{
+    return now;
+}
+
+/*!
+    \brief      let the time pass, the FMC interrupt runs at the end of operations
+    \param[in]  ns: time to pass
+    \param[out] none
+    \retval     none
+*/
+void fmc_model_advance(uint64_t ns)
+{
+    uint64_t target = now + ns;
+
+    while(1) {
+        if(irq_pending) {
+            irq_pending = 0U;
+            inter_flash_if_irq();
+        } else if((FMC_MODEL_IDLE != op) && (op_end <= target)) {
+            time_set(op_end);
+            op_complete();
+        } else {
+            break;
+        }
+    }
+
+    time_set(target);
+}
+
+/*!
+    \brief      the CPU needs to run, it waits for an operation in bank 0
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fmc_model_cpu(void)
+{
+    if((FMC_MODEL_IDLE != op) && (op_addr < FMC_MODEL_BANK1)) {
+        stats.stalled_ns += op_end - now;
+        time_set(op_end);
+        op_complete();
+    }
+}
+
+/*!
+    \brief      read the statistics since fmc_model_init()
+    \param[in]  none
+    \param[out] stats_out: statistics
+    \retval     none
+*/
+void fmc_model_stats_get(fmc_model_stats_struct *stats_out)
+{
+    *stats_out = stats;
+
+    /* the part of the running operation until now */
+    if(FMC_MODEL_IDLE != op) {
+        stats_out->busy_ns += now - op_start;
+    }
+}
+
+/*!
+    \brief      start the erase of a sector
+    \param[in]  fmc_sector: CTL_SECTOR_NUMBER_x
+    \param[out] none
+    \retval     none
+*/
+void fmc_sector_erase_start(uint32_t fmc_sector)
+{
+    uint32_t sn = (fmc_sector & FMC_CTL_SN) >> 3;
+    uint8_t sector = (uint8_t)((sn < 12U) ? sn : ((sn < 16U) ? (sn + 12U) : (sn - 4U)));
+    uint32_t kb = (model_sector_addr[sector + 1U] - model_sector_addr[sector]) / 1024U;
+
+    if((FMC_MODEL_IDLE != op) || locked) {
+        stats.violations++;
+        return;
+    }
+
+    op_sector = sector;
+    op_addr = model_sector_addr[sector];
+    op_fail = 0U;
+    stats.erases++;
+    op_begin(FMC_MODEL_ERASE, spread((uint64_t)kb * timing->erase_us_per_kb * 1000U));
+}
+
+/*!
+    \brief      start the program of a word
+    \param[in]  address: word aligned address to program
+    \param[in]  data: word to program
+    \param[out] none
+    \retval     none
+*/
+void fmc_word_program_start(uint32_t address, uint32_t data)
+{
+    uint32_t old;
+
+    if((FMC_MODEL_IDLE != op) || locked || (address & 3U) || (address < FLASH_START_ADDR) ||
+            (address >= FLASH_END_ADDR)) {
+        stats.violations++;
+        return;
+    }
+
+    old = *(const uint32_t *)(flash_rw + (address - FLASH_START_ADDR));
+    if(0U != (~old & data)) {
+        stats.violations++;
+    }
+
+    op_addr = address;
+    op_data = data;
+    op_fail = (fail_addr >= address) && (fail_addr < address + 4U);
+    stats.words++;
+    op_begin(FMC_MODEL_PROGRAM, spread(timing->word_ns));
+}
+
+/*!
+    \brief      reset the command bits after the end of an erase or a program
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fmc_operation_end(void)
+{
+    if(FMC_MODEL_IDLE != op) {
+        stats.violations++;
+    }
+}
+
+/*!
+    \brief      unlock the main FMC operation
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fmc_unlock(void)
+{
+    locked = 0U;
+}
+
+/*!
+    \brief      lock the main FMC operation
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void fmc_lock(void)
+{
+    locked = 1U;
+}
+
+/*!
+    \brief      get a flag of the FMC
+    \param[in]  fmc_flag: FMC_FLAG_x
+    \param[out] none
+    \retval     SET or RESET
+*/
+FlagStatus fmc_flag_get(uint32_t fmc_flag)
+{
+    if(FMC_FLAG_BUSY == fmc_flag) {
+        return (FMC_MODEL_IDLE != op) ? SET : RESET;
+    }
+
+    return (stat & fmc_flag) ? SET : RESET;
+}
+
+/*!
+    \brief      clear flags of the FMC
+    \param[in]  fmc_flag: FMC_FLAG_x
+    \param[out] none
+    \retval     none
+*/
+void fmc_flag_clear(uint32_t fmc_flag)
+{
+    stat &= ~fmc_flag;
+}
+
+/*!
+    \brief      enable interrupts of the FMC
+    \param[in]  fmc_int: FMC_INT_END, FMC_INT_ERR
+    \param[out] none
+    \retval     none
+*/
+void fmc_interrupt_enable(uint32_t fmc_int)
+{
+    int_enabled |= fmc_int;
+}
+
+/*!
+    \brief      disable interrupts of the FMC
+    \param[in]  fmc_int: FMC_INT_END, FMC_INT_ERR
+    \param[out] none
+    \retval     none
+*/
+void fmc_interrupt_disable(uint32_t fmc_int)
+{
+    int_enabled &= ~fmc_int;
+}
+
+/*!
+    \brief      wait for the FMC, the time passes in the caller
+    \param[in]  timeout: not used
+    \param[out] none
+    \retval     state of the FMC
+*/
+fmc_state_enum fmc_ready_wait(uint32_t timeout)
+{
+    if(FMC_MODEL_IDLE != op) {
+        if(op_addr < FMC_MODEL_BANK1) {
+            stats.stalled_ns += op_end - now;
+        }
+        time_set(op_end);
+        op_complete();
+    }
+
+    return (stat & FMC_MODEL_ERR_FLAGS) ? FMC_OPERR : FMC_READY;
+}
+
+/*!
+    \brief      erase a sector and wait for the end
+    \param[in]  fmc_sector: CTL_SECTOR_NUMBER_x
+    \param[out] none
+    \retval     state of the FMC
+*/
+fmc_state_enum fmc_sector_erase(uint32_t fmc_sector)
+{
+    fmc_state_enum state = fmc_ready_wait(FMC_TIMEOUT_COUNT);
+
+    if(FMC_READY == state) {
+        fmc_sector_erase_start(fmc_sector);
+        state = fmc_ready_wait(FMC_TIMEOUT_COUNT);
+    }
+
+    return state;
+}
+
+/*!
+    \brief      program a word and wait for the end
+    \param[in]  address: word aligned address to program
+    \param[in]  data: word to program
+    \param[out] none
+    \retval     state of the FMC
+*/
+fmc_state_enum fmc_word_program(uint32_t address, uint32_t data)
+{
+    fmc_state_enum state = fmc_ready_wait(FMC_TIMEOUT_COUNT);
+
+    if(FMC_READY == state) {
+        fmc_word_program_start(address, data);
+        state = fmc_ready_wait(FMC_TIMEOUT_COUNT);
+    }
+
+    return state;
+}
+
+/* the option bytes are not part of the bench */
+void ob_unlock(void) {}
+void ob_erase(void) {}
+void ob_start(void) {}
+void ob_user_write(uint32_t ob_fwdgt, uint32_t ob_deepsleep, uint32_t ob_stdby) {}
+void ob_security_protection_config(uint8_t ob_spc) {}
+void ob_user_bor_threshold(uint32_t ob_bor_th) {}
+void ob_boot_mode_config(uint32_t boot_mode) {}
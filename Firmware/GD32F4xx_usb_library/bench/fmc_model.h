@@ -0,0 +1,54 @@
+/*!
+    \file    fmc_model.h
+    \brief   FMC and internal flash model behind the functions of gd32f4xx_fmc.h and
+             fmc_async.h of dev_firmware_update, for the DFU host bench
+*/
+
+#ifndef FMC_MODEL_H
+#define FMC_MODEL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+
+#define FMC_MODEL_NO_FAIL               0xFFFFFFFFU
+
+/* timing of the flash */
+typedef struct {
+    uint32_t erase_us_per_kb;                           /*!< sector erase time per KB */
+    uint32_t word_ns;                                   /*!< word program time */
+    uint32_t noise_pct;                                 /*!< random spread of both, in percent */
+} fmc_model_struct;
+
+/* operations and time of the FMC */
+typedef struct {
+    uint32_t erases;                                    /*!< sector erases */
+    uint32_t erased;                                    /*!< sectors erased, a bit each */
+    uint32_t words;                                     /*!< word programs */
+    uint32_t errors;                                    /*!< programs failed by fmc_model_fail() */
+    uint32_t violations;                                /*!< misuse of the FMC, see fmc_model.c */
+    uint64_t busy_ns;                                   /*!< time the FMC erased or programmed */
+    uint64_t stalled_ns;                                /*!< time the CPU waited for an operation in bank 0 */
+} fmc_model_stats_struct;
+
+/* function declarations */
+/* map the flash at its address, fill it and reset the FMC and the time */
+void fmc_model_init(const fmc_model_struct *model, uint32_t seed);
+/* fail the program of the word at an address, FMC_MODEL_NO_FAIL for none */
+void fmc_model_fail(uint32_t addr);
+/* current time in ns */
+uint64_t fmc_model_now(void);
+/* let the time pass, the FMC interrupt runs inter_flash_if_irq() at the end of operations */
+void fmc_model_advance(uint64_t ns);
+/* the CPU needs to run, it waits for an operation in bank 0 */
+void fmc_model_cpu(void);
+/* read the statistics since fmc_model_init() */
+void fmc_model_stats_get(fmc_model_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FMC_MODEL_H */
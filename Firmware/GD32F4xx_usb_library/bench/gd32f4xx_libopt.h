@@ -0,0 +1,13 @@
+/*!
+    \file    gd32f4xx_libopt.h
+    \brief   library configuration of the host benches, no peripheral driver is linked, the
+             SDIO header only gives sd_msd.c its definitions
+*/
+
+#ifndef GD32F4XX_LIBOPT_H
+#define GD32F4XX_LIBOPT_H
+
+#include <stddef.h>
+#include "gd32f4xx_sdio.h"
+
+#endif /* GD32F4XX_LIBOPT_H */
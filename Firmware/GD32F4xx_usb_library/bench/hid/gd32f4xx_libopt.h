@@ -0,0 +1,23 @@
+/*!
+    \file    gd32f4xx_libopt.h
+    \brief   peripheral headers of the custom HID host bench, the cycle counter of the DWT is a
+             variable of the bench that follows the time of the bus model, and the barrier of
+             the report queue is the one of the host compiler
+*/
+
+#ifndef GD32F4XX_LIBOPT_H
+#define GD32F4XX_LIBOPT_H
+
+#include <stddef.h>
+
+extern DWT_Type hid_model_dwt;
+extern CoreDebug_Type hid_model_core_debug;
+
+#undef DWT
+#define DWT                           (&hid_model_dwt)
+#undef CoreDebug
+#define CoreDebug                     (&hid_model_core_debug)
+
+#define __DMB()                       __sync_synchronize()
+
+#endif /* GD32F4XX_LIBOPT_H */
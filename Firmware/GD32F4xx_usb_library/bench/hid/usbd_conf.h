@@ -0,0 +1,31 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the custom HID host bench, as in custom_hid
+             with reports of 8 bytes
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+#include "gd32f450i_eval.h"
+
+#define USBD_CFG_MAX_NUM                    1U
+#define USBD_ITF_MAX_NUM                    1U
+
+#define CUSTOM_HID_INTERFACE                0U
+
+#define USB_STR_DESC_MAX_SIZE               64U
+
+#define USB_STRING_COUNT                    4U
+
+#define CUSTOMHID_IN_EP                     EP1_IN
+#define CUSTOMHID_OUT_EP                    EP1_OUT
+
+/* a sequence number and a time stamp of the host or the application */
+#define CUSTOMHID_IN_PACKET                 8U
+#define CUSTOMHID_OUT_PACKET                8U
+
+#define CUSTOMHID_INTERVAL                  0x01U
+
+#endif /* USBD_CONF_H */
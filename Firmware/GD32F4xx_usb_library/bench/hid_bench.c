@@ -0,0 +1,427 @@
+/*!
+    \file    hid_bench.c
+    \brief   latency and jitter of the report queue of the custom HID class against the
+             former one report API
+
+    The custom HID class driver runs unchanged against a model of the interrupt endpoints in
+    steps of 1us instead of usb_sim.c, since the reports depend on the polls of the host rather
+    than on transfer times. The host polls EP1 IN and EP1 OUT every poll_us, 1000us at full
+    speed and 125us at high speed with CUSTOMHID_INTERVAL 1, and moves a report when the
+    endpoint is armed. The transfer ends 1us after the poll, and the class sees the end when
+    the interrupt gets to it: at once through the dedicated EP1 interrupt of the HS core, up
+    to shared_busy_us later through the shared interrupt when it is busy with another
+    endpoint. Polls in between find the endpoint unarmed and get a NAK.
+
+    The application queues an IN report every produce_us, 10% early or late at random, and
+    its main loop reads the OUT reports every main_us. The host sends an OUT report every
+    host_us, as randomly. Every report carries its sequence number, so a lost, repeated or
+    reordered report shows up at the other end. The DWT cycle counter runs at CPU_MHZ.
+
+    The "send" run is the class as it was: custom_hid_report_send() arms the endpoint with each
+    report whether or not the host has read the previous one, and the host polls every 32
+    frames, the former bInterval. The checks expect of the queue runs no lost or reordered
+    report in either direction, no IN endpoint armed twice, the counters of the class to match
+    the host and the latency of every report within the limit of its run.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "custom_hid_core.h"
+
+#define CPU_MHZ                         200U
+#define RUN_US                          2000000U
+#define SEQ_HISTORY                     4096U
+#define NEVER                           0xFFFFFFFFU
+
+/* a run of the table */
+typedef struct {
+    const char *name;
+    uint8_t queue;                                      /*!< report queue or custom_hid_report_send() */
+    const char *bus;
+    uint32_t poll_us;                                   /*!< polling interval of the host */
+    uint32_t produce_us;                                /*!< mean interval of the IN reports */
+    uint32_t host_us;                                   /*!< mean interval of the OUT reports, 0 for none */
+    uint32_t main_us;                                   /*!< interval of the main loop */
+    uint32_t shared_busy_us;                            /*!< the shared interrupt ends a transfer up to this late */
+    uint8_t dedicated;                                  /*!< EP1 has the dedicated interrupts */
+    uint32_t in_limit_us;                               /*!< latency limits of the reports */
+    uint32_t out_limit_us;
+} run_struct;
+
+/* a queue of reports waits for up to a poll each, the shared interrupt adds its delay to the
+   poll it makes the endpoint miss */
+#define QUEUE_LIMIT_US(len, poll)       (((len) + 1U) * (poll) + 10U)
+
+static const run_struct runs[] = {
+    {"send",  0U, "FS", 32000U, 1000U,    0U,   50U,   0U, 0U, 0U, 0U},
+    {"queue", 1U, "FS",  1000U, 1000U, 1000U,   50U,   0U, 0U,
+     QUEUE_LIMIT_US(CUSTOM_HID_IN_QUEUE_LEN, 1000U), QUEUE_LIMIT_US(CUSTOM_HID_OUT_QUEUE_LEN, 1000U)},
+    {"queue", 1U, "HS",   125U,  250U,  250U,   50U, 200U, 0U, 2U * 125U + 210U, 2U * 125U + 260U},
+    {"queue", 1U, "HS",   125U,  250U,  250U,   50U,   0U, 1U, 125U + 5U, 125U + 55U},
+    {"queue", 1U, "HS",   125U,  100U,  250U, 1900U,   0U, 1U,
+     QUEUE_LIMIT_US(CUSTOM_HID_IN_QUEUE_LEN, 125U), 4U * 1900U},
+};
+
+/* latencies of one direction as the host or the application sees them */
+typedef struct {
+    uint32_t reports;
+    uint32_t lost;
+    uint32_t bad;                                       /*!< repeated or reordered reports */
+    uint32_t min;
+    uint32_t max;
+    double sum;
+    double sum2;
+} latency_struct;
+
+DWT_Type hid_model_dwt;
+CoreDebug_Type hid_model_core_debug;
+
+static usb_core_driver udev;
+static uint32_t now;
+static uint32_t rng;
+
+static uint8_t *in_buf;
+static uint32_t in_len;
+static uint8_t in_armed;
+static uint32_t in_done;
+static uint32_t in_twice;
+
+static uint8_t *out_buf;
+static uint32_t out_len;
+static uint32_t out_done;
+
+static uint32_t in_time[SEQ_HISTORY];
+static uint32_t out_time[SEQ_HISTORY];
+static int failures;
+
+/*!
+    \brief      pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     number
+*/
+static uint32_t rand_next(void)
+{
+    rng = rng * 1664525U + 1013904223U;
+    return rng >> 8;
+}
+
+/*!
+    \brief      set the cycle counter of the DWT to the time of the model
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void dwt_update(void)
+{
+    hid_model_dwt.CYCCNT = now * CPU_MHZ;
+}
+
+/*!
+    \brief      configure an endpoint, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_desc: endpoint descriptor
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_setup(usb_core_driver *udev, const usb_desc_ep *ep_desc)
+{
+    return 0U;
+}
+
+/*!
+    \brief      clear an endpoint, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_clear(usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+/*!
+    \brief      arm the IN endpoint, a report not read yet is replaced
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: data to send
+    \param[in]  len: length of the data
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_send(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    if(in_armed || (NEVER != in_done)) {
+        in_twice++;
+    }
+    in_buf = pbuf;
+    in_len = len;
+    in_armed = 1U;
+    return 0U;
+}
+
+/*!
+    \brief      arm the OUT endpoint
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: receive buffer
+    \param[in]  len: size of the buffer
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_recev(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    out_buf = pbuf;
+    out_len = len;
+    return 0U;
+}
+
+/*!
+    \brief      switch on a LED, nothing to do on the host
+    \param[in]  lednum: LED
+    \param[out] none
+    \retval     none
+*/
+void gd_eval_led_on(led_typedef_enum lednum)
+{
+}
+
+/*!
+    \brief      switch off a LED, nothing to do on the host
+    \param[in]  lednum: LED
+    \param[out] none
+    \retval     none
+*/
+void gd_eval_led_off(led_typedef_enum lednum)
+{
+}
+
+/*!
+    \brief      account a report that reached the other end
+    \param[in]  lat: latencies of the direction
+    \param[in]  seq: sequence number of the report
+    \param[in]  expect: next sequence number the other end waits for
+    \param[in]  sent: time the report was queued
+    \param[out] none
+    \retval     next sequence number to wait for
+*/
+static uint32_t latency_add(latency_struct *lat, uint32_t seq, uint32_t expect, uint32_t sent)
+{
+    uint32_t latency = now - sent;
+
+    if(seq < expect) {
+        lat->bad++;
+        return expect;
+    }
+    lat->lost += seq - expect;
+    lat->reports++;
+    lat->sum += latency;
+    lat->sum2 += (double)latency * latency;
+    if(latency < lat->min) {
+        lat->min = latency;
+    }
+    if(latency > lat->max) {
+        lat->max = latency;
+    }
+    return seq + 1U;
+}
+
+/*!
+    \brief      time the class sees the end of a transfer
+    \param[in]  run: run of the table
+    \param[out] none
+    \retval     time in us
+*/
+static uint32_t transfer_end(const run_struct *run)
+{
+    uint32_t end = now + 1U;
+
+    if(!run->dedicated && run->shared_busy_us) {
+        end += rand_next() % (run->shared_busy_us + 1U);
+    }
+    return end;
+}
+
+/*!
+    \brief      next time of a report of the application or the host, 10% early or late
+    \param[in]  period: mean interval in us
+    \param[out] none
+    \retval     time in us
+*/
+static uint32_t produce_next(uint32_t period)
+{
+    return now + period - period / 10U + rand_next() % (period / 5U + 1U);
+}
+
+/*!
+    \brief      run the reports of a line of the table and print it
+    \param[in]  run: run of the table
+    \param[out] none
+    \retval     none
+*/
+static void report_run(const run_struct *run)
+{
+    custom_hid_queue_stats stats;
+    latency_struct in_lat, out_lat;
+    uint8_t report[CUSTOMHID_IN_PACKET];
+    uint32_t in_seq = 0U, in_expect = 0U, in_full = 0U, in_next;
+    uint32_t out_seq = 0U, out_sent = 0U, out_expect = 0U, out_next, seq;
+    double in_mean, in_jitter, out_mean = 0.0, out_jitter = 0.0;
+
+    memset(&udev, 0, sizeof(udev));
+    memset(&in_lat, 0, sizeof(in_lat));
+    memset(&out_lat, 0, sizeof(out_lat));
+    memset(&hid_model_dwt, 0, sizeof(hid_model_dwt));
+    in_lat.min = out_lat.min = NEVER;
+    now = 0U;
+    rng = 1U;
+    in_armed = 0U;
+    in_done = NEVER;
+    in_twice = 0U;
+    out_buf = NULL;
+    out_done = NEVER;
+
+    dwt_update();
+    usbd_custom_hid_cb.init(&udev, 0U);
+    udev.dev.cur_status = USBD_CONFIGURED;
+    if(run->queue) {
+        custom_hid_queue_start(&udev);
+    }
+
+    in_next = produce_next(run->produce_us);
+    out_next = (run->queue && run->host_us) ? produce_next(run->host_us) : NEVER;
+
+    for(now = 0U; now < RUN_US; now++) {
+        dwt_update();
+
+        /* the interrupt of the ends of the transfers */
+        if(now == in_done) {
+            in_done = NEVER;
+            usbd_custom_hid_cb.data_in(&udev, EP_ID(CUSTOMHID_IN_EP));
+        }
+        if(now == out_done) {
+            out_done = NEVER;
+            usbd_custom_hid_cb.data_out(&udev, EP_ID(CUSTOMHID_OUT_EP));
+        }
+
+        /* the polls of the host */
+        if(0U == now % run->poll_us) {
+            if(in_armed) {
+                in_armed = 0U;
+                memcpy(&seq, in_buf, sizeof(seq));
+                in_expect = latency_add(&in_lat, seq, in_expect, in_time[seq % SEQ_HISTORY]);
+                in_done = transfer_end(run);
+            }
+            if((out_sent != out_seq) && (NULL != out_buf) && (CUSTOMHID_OUT_PACKET <= out_len)) {
+                memset(out_buf, 0, CUSTOMHID_OUT_PACKET);
+                memcpy(out_buf, &out_sent, sizeof(out_sent));
+                out_buf = NULL;
+                out_sent++;
+                udev.dev.transc_out[EP_ID(CUSTOMHID_OUT_EP)].xfer_count = CUSTOMHID_OUT_PACKET;
+                out_done = transfer_end(run);
+            }
+        }
+
+        /* the reports of the application and of the host */
+        if(now == in_next) {
+            memset(report, 0, sizeof(report));
+            memcpy(report, &in_seq, sizeof(in_seq));
+            in_time[in_seq % SEQ_HISTORY] = now;
+            if(run->queue) {
+                if(USBD_OK == custom_hid_report_queue(&udev, report, CUSTOMHID_IN_PACKET)) {
+                    in_seq++;
+                } else {
+                    in_full++;
+                }
+            } else {
+                /* the endpoint sends from the buffer of the application */
+                static uint8_t send_buf[CUSTOMHID_IN_PACKET];
+
+                memcpy(send_buf, report, sizeof(send_buf));
+                custom_hid_report_send(&udev, send_buf, CUSTOMHID_IN_PACKET);
+                in_seq++;
+            }
+            in_next = produce_next(run->produce_us);
+        }
+        if(now == out_next) {
+            out_time[out_seq % SEQ_HISTORY] = now;
+            out_seq++;
+            out_next = produce_next(run->host_us);
+        }
+
+        /* the main loop */
+        if(run->queue && (0U == now % run->main_us)) {
+            while(0U != custom_hid_report_read(&udev, report, NULL)) {
+                memcpy(&seq, report, sizeof(seq));
+                out_expect = latency_add(&out_lat, seq, out_expect, out_time[seq % SEQ_HISTORY]);
+            }
+        }
+    }
+
+    in_mean = in_lat.reports ? in_lat.sum / in_lat.reports : 0.0;
+    in_jitter = in_lat.reports ? sqrt(fmax(in_lat.sum2 / in_lat.reports - in_mean * in_mean, 0.0)) : 0.0;
+    if(out_lat.reports) {
+        out_mean = out_lat.sum / out_lat.reports;
+        out_jitter = sqrt(fmax(out_lat.sum2 / out_lat.reports - out_mean * out_mean, 0.0));
+    }
+
+    printf("%-5s  %s  %5u  %5u  %4s  %7u  %5u  %4u  %7.1f  %6u  %6.1f", run->name, run->bus,
+           (unsigned)run->poll_us, (unsigned)run->produce_us,
+           run->dedicated ? "ep1" : (run->shared_busy_us ? "busy" : "-"),
+           (unsigned)in_lat.reports, (unsigned)in_lat.lost, (unsigned)in_full, in_mean,
+           (unsigned)in_lat.max, in_jitter);
+    if(run->queue) {
+        custom_hid_queue_stats_get(&udev, &stats);
+        printf("  %7u  %4u  %7.1f  %6u  %6.1f\n", (unsigned)out_lat.reports, (unsigned)stats.out_full, out_mean,
+               (unsigned)out_lat.max, out_jitter);
+    } else {
+        printf("        -     -        -       -       -\n");
+    }
+
+    if(!run->queue) {
+        return;
+    }
+
+    if(in_lat.lost || in_lat.bad || out_lat.lost || out_lat.bad || in_twice || \
+            (out_sent - out_lat.reports > CUSTOM_HID_OUT_QUEUE_LEN + 1U) || \
+            (stats.in_reports + 1U < in_lat.reports) || (stats.in_reports > in_lat.reports) || \
+            (stats.in_full != in_full) || (stats.out_reports < out_lat.reports) || \
+            (in_lat.max > run->in_limit_us) || (out_lat.max > run->out_limit_us) || \
+            (stats.in_latency_max / CPU_MHZ > run->in_limit_us + run->shared_busy_us + 1U)) {
+        printf("  run %s %s %u/%u failed: lost %u/%u, bad %u/%u, armed twice %u, class %u/%u reports\n",
+               run->name, run->bus, (unsigned)run->poll_us, (unsigned)run->produce_us,
+               (unsigned)in_lat.lost, (unsigned)out_lat.lost, (unsigned)in_lat.bad, (unsigned)out_lat.bad,
+               (unsigned)in_twice, (unsigned)stats.in_reports, (unsigned)stats.out_reports);
+        failures++;
+    }
+}
+
+/*!
+    \brief      run the lines of the table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    uint32_t i;
+
+    printf("CUSTOM_HID_IN_QUEUE_LEN %u, CUSTOM_HID_OUT_QUEUE_LEN %u, %us per run\n\n",
+           (unsigned)CUSTOM_HID_IN_QUEUE_LEN, (unsigned)CUSTOM_HID_OUT_QUEUE_LEN, (unsigned)(RUN_US / 1000000U));
+
+    printf("                                IN                                             OUT\n");
+    printf("mode   bus   poll  every   isr  reports   lost  full     mean     max  jitter  reports  full     mean     max  jitter\n");
+    printf("               us     us                                   us      us      us                      us      us      us\n");
+    for(i = 0U; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        report_run(&runs[i]);
+    }
+
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
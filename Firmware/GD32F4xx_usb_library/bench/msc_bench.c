@@ -0,0 +1,529 @@
+/*!
+    \file    msc_bench.c
+    \brief   throughput of the MSC READ10 and WRITE10 data path over a modelled bus and storage
+
+    The MSC class driver runs unchanged on the USB core stand-in of usb_sim.c, the host side
+    is a Bulk-Only Transport initiator that sends 64KB READ10 and WRITE10 commands over a
+    16MB disk and checks the tag, status and residue of every CSW. The storage behind
+    usbd_mem_fops is a memory disk with the timing of an SD card or of the internal SRAM disk
+    of msc_udisk, reached either through the blocking mem_read and mem_write callbacks or
+    through mem_read_start and mem_write_start, which finish later with usbd_msc_mem_done().
+
+    Each line of the table is one combination of bus (internal DMA or FIFO mode) and storage
+    callbacks, with the MB/s of writing and reading the disk and the cycles the interrupt of
+    the USB core spends per KB moved, without the class driver and the storage. The number of media buffers is
+    a build option, msc_bench_1 has the single buffer of the serial data path. Before the
+    table the data path is checked: odd transfer lengths, zero length commands, storage
+    callbacks that finish inside the start call and failing reads and writes, which have to
+    end with a failed CSW, the sense data of the error and a working next command.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msc_host.h"
+#include "usbd_msc_mem.h"
+
+#define DISK_BLOCK_SIZE                 MSC_HOST_BLOCK_SIZE
+#define DISK_BLOCKS                     32768U
+#define DISK_SIZE                       (DISK_BLOCK_SIZE * DISK_BLOCKS)
+#define BENCH_TRANSFER                  65536U
+#define NO_FAIL                         0xFFFFFFFFU
+
+/* how the class driver reaches the storage */
+enum {
+    STORAGE_SYNC = 0,                                   /*!< mem_read and mem_write */
+    STORAGE_ASYNC,                                      /*!< mem_read_start and mem_write_start, finished by a timer */
+    STORAGE_INLINE                                      /*!< mem_read_start and mem_write_start, finished inside the call */
+};
+
+/* timing of a storage device */
+typedef struct {
+    const char *name;
+    uint32_t read_command_ns;                           /*!< fixed cost of a read */
+    uint32_t read_bytes_per_us;                         /*!< read rate */
+    uint32_t write_command_ns;                          /*!< fixed cost of a write */
+    uint32_t write_bytes_per_us;                        /*!< write rate */
+    uint32_t busy_every;                                /*!< every n-th write waits for the card, 0 for never */
+    uint32_t busy_ns;                                   /*!< length of that wait */
+} storage_model_struct;
+
+/* a storage transfer in flight */
+typedef struct {
+    uint8_t write;                                      /*!< 1 for a write */
+    uint8_t *buf;                                       /*!< buffer of the class driver */
+    uint32_t addr;                                      /*!< byte address */
+    uint32_t len;                                       /*!< length in bytes */
+} storage_transfer_struct;
+
+/* core clock of the ISR cycles column */
+#define CPU_MHZ                         200U
+
+/* the FIFO mode takes an interrupt of about 100 cycles per packet and copies a word in about
+   5 cycles, the DMA mode only interrupts at the end of a transfer */
+static const usb_sim_bus_struct bus_dma = {"dma", 40U, 10000U, 1000U, 0U, 0U, 1U};
+static const usb_sim_bus_struct bus_fifo = {"fifo", 40U, 10000U, 1000U, 500U, 25U, 0U};
+
+static const storage_model_struct model_sd = {"sd", 120000U, 22U, 250000U, 15U, 64U, 3000000U};
+static const storage_model_struct model_sram = {"sram", 2000U, 100U, 2000U, 100U, 0U, 0U};
+
+static usb_core_driver udev;
+static uint8_t *disk;
+static uint8_t *host_buf;
+static const storage_model_struct *model;
+static uint32_t storage_mode;
+static uint32_t fail_block = NO_FAIL;
+static uint32_t writes;
+static uint64_t media_free;
+static storage_transfer_struct transfer;
+static int failures;
+
+static const int8_t inquiry_data[USBD_STD_INQUIRY_LENGTH] = {
+    0x00, 0x80, 0x00, 0x01, (USBD_STD_INQUIRY_LENGTH - 5U), 0x00, 0x00, 0x00,
+    'G', 'D', '3', '2', ' ', ' ', ' ', ' ',
+    'B', 'e', 'n', 'c', 'h', ' ', 'd', 'i', 's', 'k', ' ', ' ', ' ', ' ', ' ', ' ',
+    '1', '.', '0', '0'
+};
+
+/*!
+    \brief      device time of a storage transfer
+    \param[in]  write: 1 for a write
+    \param[in]  len: length in bytes
+    \param[out] none
+    \retval     time in ns
+*/
+static uint64_t storage_time(uint8_t write, uint32_t len)
+{
+    uint64_t ns;
+
+    if(write) {
+        ns = model->write_command_ns + (uint64_t)len * 1000U / model->write_bytes_per_us;
+        if(model->busy_every && (0U == (++writes % model->busy_every))) {
+            ns += model->busy_ns;
+        }
+    } else {
+        ns = model->read_command_ns + (uint64_t)len * 1000U / model->read_bytes_per_us;
+    }
+    return ns;
+}
+
+/*!
+    \brief      move the data of a storage transfer
+    \param[in]  t: transfer
+    \param[out] none
+    \retval     0 or -1 if the transfer covers the failing block
+*/
+static int8_t storage_move(const storage_transfer_struct *t)
+{
+    if((fail_block != NO_FAIL) && (t->addr <= fail_block * DISK_BLOCK_SIZE) && \
+            (fail_block * DISK_BLOCK_SIZE < t->addr + t->len)) {
+        return -1;
+    }
+    if(t->write) {
+        memcpy(&disk[t->addr], t->buf, t->len);
+    } else {
+        memcpy(t->buf, &disk[t->addr], t->len);
+    }
+    return 0;
+}
+
+/*!
+    \brief      blocking storage transfer, the CPU waits in the USB interrupt
+    \param[in]  write: 1 for a write
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: byte address
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_sync(uint8_t write, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    storage_transfer_struct t = {write, buf, block_addr, (uint32_t)block_len * DISK_BLOCK_SIZE};
+
+    usb_sim_cpu(storage_time(write, t.len));
+    return storage_move(&t);
+}
+
+/*!
+    \brief      end of a storage transfer started by storage_start()
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void storage_done(void *arg)
+{
+    usbd_msc_mem_done(storage_move(&transfer));
+}
+
+/*!
+    \brief      start a storage transfer that ends with usbd_msc_mem_done()
+    \param[in]  write: 1 for a write
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: first block
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_start(uint8_t write, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    uint64_t start = (media_free > usb_sim_now()) ? media_free : usb_sim_now();
+
+    transfer.write = write;
+    transfer.buf = buf;
+    transfer.addr = block_addr * DISK_BLOCK_SIZE;
+    transfer.len = (uint32_t)block_len * DISK_BLOCK_SIZE;
+
+    if(STORAGE_INLINE == storage_mode) {
+        usb_sim_cpu(storage_time(write, transfer.len));
+        usbd_msc_mem_done(storage_move(&transfer));
+        return 0;
+    }
+    media_free = start + storage_time(write, transfer.len);
+    usb_sim_at(media_free, storage_done, NULL);
+    return 0;
+}
+
+/*!
+    \brief      initialize the storage medium
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_init(uint8_t lun)
+{
+    return 0;
+}
+
+/*!
+    \brief      check whether the medium is ready
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_ready(uint8_t lun)
+{
+    return 0;
+}
+
+/*!
+    \brief      check whether the medium is write-protected
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_protected(uint8_t lun)
+{
+    return 0;
+}
+
+/*!
+    \brief      get the number of the last logical unit
+    \param[in]  none
+    \param[out] none
+    \retval     lun
+*/
+static int8_t storage_maxlun(void)
+{
+    return MEM_LUN_NUM - 1U;
+}
+
+/*!
+    \brief      read data from the medium, blocking
+    \param[in]  lun: logical unit number
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: byte address
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_read(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    return storage_sync(0U, buf, block_addr, block_len);
+}
+
+/*!
+    \brief      write data to the medium, blocking
+    \param[in]  lun: logical unit number
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: byte address
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_write(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    return storage_sync(1U, buf, block_addr, block_len);
+}
+
+/*!
+    \brief      start reading data from the medium
+    \param[in]  lun: logical unit number
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: first block
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_read_start(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    return storage_start(0U, buf, block_addr, block_len);
+}
+
+/*!
+    \brief      start writing data to the medium
+    \param[in]  lun: logical unit number
+    \param[in]  buf: buffer of the class driver
+    \param[in]  block_addr: first block
+    \param[in]  block_len: number of blocks
+    \param[out] none
+    \retval     status
+*/
+static int8_t storage_write_start(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len)
+{
+    return storage_start(1U, buf, block_addr, block_len);
+}
+
+static usbd_mem_cb bench_storage_fops = {
+    .mem_init = storage_init,
+    .mem_ready = storage_ready,
+    .mem_protected = storage_protected,
+    .mem_read = storage_read,
+    .mem_write = storage_write,
+    .mem_maxlun = storage_maxlun,
+
+    .mem_inquiry_data = {(uint8_t *)inquiry_data},
+
+    .mem_block_size = {DISK_BLOCK_SIZE},
+    .mem_block_len = {DISK_BLOCKS}
+};
+
+usbd_mem_cb *usbd_mem_fops = &bench_storage_fops;
+
+/*!
+    \brief      start the class driver on a bus with a storage mode
+    \param[in]  bus: bus model
+    \param[in]  storage: storage model
+    \param[in]  mode: STORAGE_SYNC, STORAGE_ASYNC or STORAGE_INLINE
+    \param[out] none
+    \retval     none
+*/
+static void device_start(const usb_sim_bus_struct *bus, const storage_model_struct *storage, uint32_t mode)
+{
+    uint32_t blocks;
+
+    model = storage;
+    storage_mode = mode;
+    fail_block = NO_FAIL;
+    writes = 0U;
+    media_free = 0U;
+    bench_storage_fops.mem_read_start = (STORAGE_SYNC == mode) ? NULL : storage_read_start;
+    bench_storage_fops.mem_write_start = (STORAGE_SYNC == mode) ? NULL : storage_write_start;
+
+    msc_host_start(&udev, bus);
+
+    /* the block size and count of the lun are taken over here */
+    if((0 != msc_host_capacity(&blocks)) || (DISK_BLOCKS != blocks)) {
+        printf("  READ CAPACITY failed\n");
+        failures++;
+    }
+}
+
+/*!
+    \brief      fill a buffer with a pattern of the block numbers and a seed
+    \param[in]  buf: buffer
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     none
+*/
+static void pattern_fill(uint8_t *buf, uint32_t block, uint32_t blocks, uint32_t seed)
+{
+    uint32_t i, *word = (uint32_t *)buf;
+
+    for(i = 0U; i < blocks * DISK_BLOCK_SIZE / 4U; i++) {
+        word[i] = (seed * 0x9E3779B9U) ^ ((block + i / (DISK_BLOCK_SIZE / 4U)) << 8) ^ (i % (DISK_BLOCK_SIZE / 4U));
+    }
+}
+
+/*!
+    \brief      check a buffer against the pattern
+    \param[in]  buf: buffer
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     1 if it matches
+*/
+static int pattern_check(const uint8_t *buf, uint32_t block, uint32_t blocks, uint32_t seed)
+{
+    static uint8_t expected[BENCH_TRANSFER];
+
+    pattern_fill(expected, block, blocks, seed);
+    return 0 == memcmp(buf, expected, blocks * DISK_BLOCK_SIZE);
+}
+
+/*!
+    \brief      check the data path with odd lengths, zero length commands and errors
+    \param[in]  bus: bus model
+    \param[in]  mode: storage mode
+    \param[out] none
+    \retval     none
+*/
+static void check_run(const usb_sim_bus_struct *bus, uint32_t mode)
+{
+    static const uint32_t lengths[] = {1U, 7U, 8U, 9U, 16U, 17U, 25U, 128U};
+    static const char *const mode_names[] = {"sync", "async", "inline"};
+    uint32_t i, block = 100U;
+    uint8_t key, asc;
+    int before = failures + msc_host_errors();
+
+    device_start(bus, &model_sd, mode);
+
+    for(i = 0U; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        pattern_fill(host_buf, block, lengths[i], i + 1U);
+        if(0 != msc_host_rw10(SCSI_WRITE10, block, lengths[i], host_buf)) {
+            printf("  WRITE10 of %u blocks failed\n", (unsigned)lengths[i]);
+            failures++;
+        }
+        memset(host_buf, 0, lengths[i] * DISK_BLOCK_SIZE);
+        if((0 != msc_host_rw10(SCSI_READ10, block, lengths[i], host_buf)) || !pattern_check(host_buf, block, lengths[i], i + 1U)) {
+            printf("  READ10 of %u blocks returned wrong data\n", (unsigned)lengths[i]);
+            failures++;
+        }
+        block += lengths[i];
+    }
+
+    if((0 != msc_host_rw10(SCSI_READ10, 0U, 0U, host_buf)) || (0 != msc_host_rw10(SCSI_WRITE10, 0U, 0U, host_buf))) {
+        printf("  zero length commands failed\n");
+        failures++;
+    }
+
+    /* a read error in the middle of a transfer, the data before it reaches the host */
+    fail_block = 1000U + 40U;
+    if((CSW_CMD_FAILED != msc_host_rw10(SCSI_READ10, 1000U, 128U, host_buf)) || (0U == msc_host_last()->stalls) || \
+            (msc_host_last()->csw.dCSWDataResidue != 128U * DISK_BLOCK_SIZE - msc_host_last()->data_done)) {
+        printf("  failed READ10 not reported\n");
+        failures++;
+    }
+    if((0 != msc_host_sense(&key, &asc)) || (HARDWARE_ERROR != key) || (UNRECOVERED_READ_ERROR != asc)) {
+        printf("  sense after a failed READ10 is %u/0x%02x\n", key, asc);
+        failures++;
+    }
+
+    /* a write error, the rest of the data is taken and dropped */
+    pattern_fill(host_buf, 1000U, 128U, 99U);
+    if((CSW_CMD_FAILED != msc_host_rw10(SCSI_WRITE10, 1000U, 128U, host_buf)) || (msc_host_last()->data_done != 128U * DISK_BLOCK_SIZE) || \
+            (msc_host_last()->csw.dCSWDataResidue < (128U - 40U) * DISK_BLOCK_SIZE)) {
+        printf("  failed WRITE10 not reported\n");
+        failures++;
+    }
+    if((0 != msc_host_sense(&key, &asc)) || (HARDWARE_ERROR != key) || (WRITE_FAULT != asc)) {
+        printf("  sense after a failed WRITE10 is %u/0x%02x\n", key, asc);
+        failures++;
+    }
+
+    /* the next commands work again */
+    fail_block = NO_FAIL;
+    pattern_fill(host_buf, 2000U, 64U, 7U);
+    if(0 != msc_host_rw10(SCSI_WRITE10, 2000U, 64U, host_buf)) {
+        failures++;
+    }
+    memset(host_buf, 0, 64U * DISK_BLOCK_SIZE);
+    if((0 != msc_host_rw10(SCSI_READ10, 2000U, 64U, host_buf)) || !pattern_check(host_buf, 2000U, 64U, 7U)) {
+        printf("  commands after the errors failed\n");
+        failures++;
+    }
+
+    printf("check %-4s %-6s %s\n", bus->name, mode_names[mode], (failures + msc_host_errors() == before) ? "ok" : "FAILED");
+}
+
+/*!
+    \brief      write and read the whole disk in 64KB commands
+    \param[in]  bus: bus model
+    \param[in]  storage: storage model
+    \param[in]  mode: storage mode
+    \param[out] none
+    \retval     none
+*/
+static void bench_run(const usb_sim_bus_struct *bus, const storage_model_struct *storage, uint32_t mode)
+{
+    const uint32_t blocks = BENCH_TRANSFER / DISK_BLOCK_SIZE;
+    usb_sim_stats_struct stats;
+    uint64_t t0, t1, t2;
+    uint32_t block;
+
+    device_start(bus, storage, mode);
+
+    t0 = usb_sim_now();
+    for(block = 0U; block < DISK_BLOCKS; block += blocks) {
+        pattern_fill(host_buf, block, blocks, 3U);
+        if(0 != msc_host_rw10(SCSI_WRITE10, block, blocks, host_buf)) {
+            printf("  WRITE10 at %u failed\n", (unsigned)block);
+            failures++;
+        }
+    }
+    t1 = usb_sim_now();
+    for(block = 0U; block < DISK_BLOCKS; block += blocks) {
+        if((0 != msc_host_rw10(SCSI_READ10, block, blocks, host_buf)) || !pattern_check(host_buf, block, blocks, 3U)) {
+            printf("  READ10 at %u returned wrong data\n", (unsigned)block);
+            failures++;
+        }
+    }
+    t2 = usb_sim_now();
+    usb_sim_stats_get(&stats);
+    if(0U != stats.dma_unaligned) {
+        printf("  %u DMA transfers off a word boundary\n", (unsigned)stats.dma_unaligned);
+        failures++;
+    }
+
+    printf("%-4s  %-4s  %-5s  %6.2f  %6.2f  %5.1f%%  %5.1f%%  %6.0f\n", bus->name, storage->name,
+           (STORAGE_SYNC == mode) ? "sync" : "async",
+           (double)DISK_SIZE / 1048576.0 / ((double)(t1 - t0) / 1e9),
+           (double)DISK_SIZE / 1048576.0 / ((double)(t2 - t1) / 1e9),
+           100.0 * (double)stats.bus_busy_ns / (double)t2,
+           100.0 * (double)stats.cpu_busy_ns / (double)t2,
+           (double)stats.isr_ns * CPU_MHZ / 1000.0 / ((double)(stats.in_bytes + stats.out_bytes) / 1024.0));
+}
+
+/*!
+    \brief      run the checks and the benchmark table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    disk = calloc(1U, DISK_SIZE);
+    host_buf = malloc(BENCH_TRANSFER);
+    if((NULL == disk) || (NULL == host_buf)) {
+        return 1;
+    }
+
+    printf("MSC_MEDIA_BUFFERS %u of %u bytes\n\n", (unsigned)MSC_MEDIA_BUFFERS, (unsigned)MSC_MEDIA_PACKET_SIZE);
+
+    check_run(&bus_dma, STORAGE_SYNC);
+    check_run(&bus_dma, STORAGE_ASYNC);
+    check_run(&bus_dma, STORAGE_INLINE);
+    check_run(&bus_fifo, STORAGE_SYNC);
+    check_run(&bus_fifo, STORAGE_ASYNC);
+
+    printf("\nbus   disk  calls   write    read    bus    cpu    isr   (MB/s, busy time, ISR cycles per KB)\n");
+    bench_run(&bus_dma, &model_sd, STORAGE_SYNC);
+    bench_run(&bus_dma, &model_sd, STORAGE_ASYNC);
+    bench_run(&bus_fifo, &model_sd, STORAGE_SYNC);
+    bench_run(&bus_fifo, &model_sd, STORAGE_ASYNC);
+    bench_run(&bus_dma, &model_sram, STORAGE_SYNC);
+    bench_run(&bus_fifo, &model_sram, STORAGE_SYNC);
+
+    free(disk);
+    free(host_buf);
+
+    failures += msc_host_errors();
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*!
+    \file    msc_host.c
+    \brief   Bulk-Only Transport host of the MSC benches, on the bus of usb_sim.c
+
+    The host sends a CBW after a turnaround time, moves the data phase and waits for the CSW,
+    whose signature, tag and residue it checks. A stalled IN endpoint is cleared with a
+    CLEAR_FEATURE request to the class driver, after which the device sends the CSW. Commands
+    that do not finish or break the protocol are printed and counted.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "msc_host.h"
+#include "usbd_msc_core.h"
+#include "msc_scsi.h"
+
+static usb_core_driver *host_udev;
+static msc_host_cmd_struct cmd;
+static uint32_t tag;
+static int errors;
+
+/*!
+    \brief      an IN transfer reached the host, data of the data phase or the CSW
+    \param[in]  ep_num: endpoint number
+    \param[in]  data: data of the transfer
+    \param[in]  len: length of the transfer
+    \param[out] none
+    \retval     none
+*/
+static void host_in_done(uint8_t ep_num, const uint8_t *data, uint32_t len)
+{
+    uint32_t n;
+
+    /* a CSW ends the data phase early, a real host sees it as a short packet */
+    if((BBB_CSW_LENGTH == len) && (0 == memcmp(data, "USBS", 4U))) {
+        memcpy(&cmd.csw, data, BBB_CSW_LENGTH);
+        cmd.done = 1U;
+        return;
+    }
+    n = cmd.data_len - cmd.data_done;
+    if(len > n) {
+        printf("  IN transfer of %u bytes, %u expected\n", (unsigned)len, (unsigned)n);
+        errors++;
+        len = n;
+    }
+    memcpy(&cmd.data[cmd.data_done], data, len);
+    cmd.data_done += len;
+}
+
+/*!
+    \brief      bytes the host has for the OUT endpoint
+    \param[in]  ep_num: endpoint number
+    \param[out] none
+    \retval     bytes
+*/
+static uint32_t host_out_avail(uint8_t ep_num)
+{
+    if(cmd.cbw_pending) {
+        return BBB_CBW_LENGTH;
+    }
+    if((0U == (cmd.cbw.bmCBWFlags & 0x80U)) && !cmd.done) {
+        return cmd.data_len - cmd.data_done;
+    }
+    return 0U;
+}
+
+/*!
+    \brief      the host sends the CBW or data of the data phase
+    \param[in]  ep_num: endpoint number
+    \param[in]  buf: receive buffer of the device
+    \param[in]  len: size of the buffer
+    \param[out] none
+    \retval     bytes sent
+*/
+static uint32_t host_out_fill(uint8_t ep_num, uint8_t *buf, uint32_t len)
+{
+    uint32_t n;
+
+    if(cmd.cbw_pending) {
+        cmd.cbw_pending = 0U;
+        memcpy(buf, &cmd.cbw, BBB_CBW_LENGTH);
+        return BBB_CBW_LENGTH;
+    }
+    n = USB_MIN(len, cmd.data_len - cmd.data_done);
+    memcpy(buf, &cmd.data[cmd.data_done], n);
+    cmd.data_done += n;
+    return n;
+}
+
+/*!
+    \brief      clear the stalled IN endpoint, the device sends the CSW then
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void host_clear_stall(void *arg)
+{
+    usb_req req;
+
+    memset(&req, 0, sizeof(req));
+    req.bmRequestType = 0x02U;
+    req.bRequest = USB_CLEAR_FEATURE;
+    req.wIndex = MSC_IN_EP;
+    usb_sim_clear_stall(MSC_IN_EP);
+    host_udev->dev.class_core->req_proc(host_udev, &req);
+}
+
+/*!
+    \brief      the device stalled an endpoint
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     none
+*/
+static void host_stall(uint8_t ep_addr)
+{
+    cmd.stalls++;
+    if(ep_addr & 0x80U) {
+        usb_sim_at(usb_sim_now() + MSC_HOST_CLEAR_STALL_NS, host_clear_stall, NULL);
+    } else {
+        /* the data phase ends here */
+        cmd.data_len = cmd.data_done;
+        usb_sim_clear_stall(ep_addr);
+    }
+}
+
+static const usb_sim_host_struct host = {host_in_done, host_out_avail, host_out_fill, host_stall};
+
+/*!
+    \brief      the CBW is ready after the turnaround of the host
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void host_cbw_ready(void *arg)
+{
+    cmd.cbw_pending = 1U;
+    usb_sim_out_ready(MSC_OUT_EP & 0x7FU);
+}
+
+/*!
+    \brief      the host got the CSW of the command
+    \param[in]  none
+    \param[out] none
+    \retval     1 if it did
+*/
+static int host_cmd_done(void)
+{
+    return cmd.done;
+}
+
+/*!
+    \brief      start the MSC class driver of udev on a bus, the host talks to it from now on
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  bus: bus model
+    \param[out] none
+    \retval     none
+*/
+void msc_host_start(usb_core_driver *udev, const usb_sim_bus_struct *bus)
+{
+    host_udev = udev;
+
+    memset(udev, 0, sizeof(*udev));
+    udev->dev.class_core = &msc_class;
+    usb_sim_init(udev, bus, &host);
+    msc_class.init(udev, 0U);
+}
+
+/*!
+    \brief      run one command and check its CSW
+    \param[in]  cb: command block, 10 bytes
+    \param[in]  dir_in: 1 for data to the host
+    \param[in]  data: buffer of the data phase
+    \param[in]  len: length of the data phase
+    \param[out] none
+    \retval     CSW status, -1 if the command did not finish
+*/
+int msc_host_cmd(const uint8_t *cb, uint8_t dir_in, uint8_t *data, uint32_t len)
+{
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cbw.dCBWSignature = BBB_CBW_SIGNATURE;
+    cmd.cbw.dCBWTag = ++tag;
+    cmd.cbw.dCBWDataTransferLength = len;
+    cmd.cbw.bmCBWFlags = dir_in ? 0x80U : 0x00U;
+    cmd.cbw.bCBWCBLength = 10U;
+    memcpy(cmd.cbw.CBWCB, cb, 10U);
+    cmd.data = data;
+    cmd.data_len = len;
+
+    usb_sim_at(usb_sim_now() + MSC_HOST_TURNAROUND_NS, host_cbw_ready, NULL);
+    if(!usb_sim_run(host_cmd_done)) {
+        printf("  command 0x%02x stopped\n", cb[0]);
+        errors++;
+        return -1;
+    }
+    if((BBB_CSW_SIGNATURE != cmd.csw.dCSWSignature) || (tag != cmd.csw.dCSWTag)) {
+        printf("  command 0x%02x has a bad CSW\n", cb[0]);
+        errors++;
+        return -1;
+    }
+    if((CSW_CMD_PASSED == cmd.csw.bCSWStatus) && (0U != cmd.csw.dCSWDataResidue)) {
+        printf("  command 0x%02x passed with residue %u\n", cb[0], (unsigned)cmd.csw.dCSWDataResidue);
+        errors++;
+    }
+    return cmd.csw.bCSWStatus;
+}
+
+/*!
+    \brief      READ10 or WRITE10
+    \param[in]  opcode: SCSI_READ10 or SCSI_WRITE10
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  data: buffer
+    \param[out] none
+    \retval     CSW status
+*/
+int msc_host_rw10(uint8_t opcode, uint32_t block, uint32_t blocks, uint8_t *data)
+{
+    uint8_t cb[10] = {0};
+
+    cb[0] = opcode;
+    cb[2] = (uint8_t)(block >> 24);
+    cb[3] = (uint8_t)(block >> 16);
+    cb[4] = (uint8_t)(block >> 8);
+    cb[5] = (uint8_t)block;
+    cb[7] = (uint8_t)(blocks >> 8);
+    cb[8] = (uint8_t)blocks;
+    return msc_host_cmd(cb, (SCSI_READ10 == opcode) ? 1U : 0U, data, blocks * MSC_HOST_BLOCK_SIZE);
+}
+
+/*!
+    \brief      REQUEST SENSE
+    \param[out] key: sense key
+    \param[out] asc: additional sense code
+    \retval     CSW status
+*/
+int msc_host_sense(uint8_t *key, uint8_t *asc)
+{
+    uint8_t cb[10] = {SCSI_REQUEST_SENSE, 0U, 0U, 0U, REQUEST_SENSE_DATA_LEN};
+    uint8_t sense[REQUEST_SENSE_DATA_LEN];
+    int status;
+
+    memset(sense, 0, sizeof(sense));
+    status = msc_host_cmd(cb, 1U, sense, REQUEST_SENSE_DATA_LEN);
+    *key = sense[2] & 0x0FU;
+    *asc = sense[12];
+    return status;
+}
+
+/*!
+    \brief      READ CAPACITY(10)
+    \param[in]  none
+    \param[out] blocks: number of blocks
+    \retval     CSW status
+*/
+int msc_host_capacity(uint32_t *blocks)
+{
+    uint8_t cb[10] = {SCSI_READ_CAPACITY10};
+    uint8_t capacity[8];
+    int status;
+
+    memset(capacity, 0, sizeof(capacity));
+    status = msc_host_cmd(cb, 1U, capacity, sizeof(capacity));
+    *blocks = ((uint32_t)capacity[0] << 24) | ((uint32_t)capacity[1] << 16) | ((uint32_t)capacity[2] << 8) | capacity[3];
+    *blocks += 1U;
+    return status;
+}
+
+/*!
+    \brief      the last command
+    \param[in]  none
+    \param[out] none
+    \retval     its CSW, data phase and stalls
+*/
+const msc_host_cmd_struct *msc_host_last(void)
+{
+    return &cmd;
+}
+
+/*!
+    \brief      commands that stopped or broke the protocol since the program started
+    \param[in]  none
+    \param[out] none
+    \retval     number of them
+*/
+int msc_host_errors(void)
+{
+    return errors;
+}
@@ -0,0 +1,52 @@
+/*!
+    \file    msc_host.h
+    \brief   Bulk-Only Transport host of the MSC benches, on the bus of usb_sim.c
+*/
+
+#ifndef MSC_HOST_H
+#define MSC_HOST_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usb_sim.h"
+#include "usbd_msc_bbb.h"
+
+#define MSC_HOST_BLOCK_SIZE             512U
+#define MSC_HOST_TURNAROUND_NS          20000U
+#define MSC_HOST_CLEAR_STALL_NS         100000U
+
+/* state of the command the host runs */
+typedef struct {
+    msc_bbb_cbw cbw;                                    /*!< command block wrapper */
+    uint8_t cbw_pending;                                /*!< the CBW is not sent yet */
+    uint8_t *data;                                      /*!< data of the data phase */
+    uint32_t data_len;                                  /*!< length of the data phase */
+    uint32_t data_done;                                 /*!< bytes moved so far */
+    msc_bbb_csw csw;                                    /*!< command status wrapper */
+    uint8_t done;                                       /*!< the CSW arrived */
+    uint32_t stalls;                                    /*!< endpoint stalls seen */
+} msc_host_cmd_struct;
+
+/* function declarations */
+/* start the MSC class driver of udev on a bus, the host talks to it from now on */
+void msc_host_start(usb_core_driver *udev, const usb_sim_bus_struct *bus);
+/* run one command and check its CSW */
+int msc_host_cmd(const uint8_t *cb, uint8_t dir_in, uint8_t *data, uint32_t len);
+/* READ10 or WRITE10 of blocks of MSC_HOST_BLOCK_SIZE */
+int msc_host_rw10(uint8_t opcode, uint32_t block, uint32_t blocks, uint8_t *data);
+/* REQUEST SENSE */
+int msc_host_sense(uint8_t *key, uint8_t *asc);
+/* READ CAPACITY(10), the number of blocks */
+int msc_host_capacity(uint32_t *blocks);
+/* the last command, its CSW, data phase and stalls */
+const msc_host_cmd_struct *msc_host_last(void);
+/* commands that stopped or broke the protocol since the program started */
+int msc_host_errors(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MSC_HOST_H */
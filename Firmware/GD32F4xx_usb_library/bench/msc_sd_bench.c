@@ -0,0 +1,523 @@
+/*!
+    \file    msc_sd_bench.c
+    \brief   the SD card storage of msc_sdcard behind the MSC class, on a model of the card
+
+    sd_msd.c of Examples/USB/USB_Device/msc_sdcard runs unchanged on the request queue API of
+    sdcard.h, which sd_model.c implements with the timing of a card: commands the CPU waits
+    for, an access time before reads and a busy time after writes. The bus and the host are
+    the ones of msc_bench, a timer calls sd_msd_process() every 100us like TIMER6 of the
+    example.
+
+    The checks come first: odd lengths read back through the cache, data that reaches the
+    card only with SYNCHRONIZE CACHE, START STOP UNIT or after the idle time, read-ahead hits
+    on sequential reads, windows dropped by overlapping writes, a failing read and a failing
+    write-back with their sense data, and no misuse of the request queue. The table then
+    compares the blocking mem_read and mem_write callbacks, which wait for every transfer of
+    MSC_MEDIA_PACKET_SIZE, with the cached callbacks, in 64KB and 4KB commands.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msc_host.h"
+#include "msc_scsi.h"
+#include "sd_model.h"
+#include "sd_msd.h"
+
+#define DISK_BLOCK_SIZE                 MSC_HOST_BLOCK_SIZE
+#define DISK_BLOCKS                     32768U
+#define DISK_SIZE                       (DISK_BLOCK_SIZE * DISK_BLOCKS)
+#define BENCH_TRANSFER                  65536U
+#define BENCH_SMALL_BYTES               (4U * 1024U * 1024U)
+#define TICK_NS                         100000U
+#define TICK_SPAN_NS                    2000000000U
+
+/* how the class driver reaches the card */
+enum {
+    STORAGE_BLOCKING = 0,                               /*!< mem_read and mem_write, one card transfer per media buffer */
+    STORAGE_CACHED                                      /*!< mem_read_start, mem_write_start and mem_sync of sd_msd.c */
+};
+
+static const usb_sim_bus_struct bus_dma = {"dma", 40U, 10000U, 1000U, 0U, 0U, 1U};
+
+/* a class 10 card in high speed mode */
+static const sd_model_struct model_card = {"sd", 23U, 3000U, 150000U, 1500000U, 10000U, 2000000U};
+
+static usb_core_driver udev;
+static uint8_t *disk;
+static uint8_t *host_buf;
+static uint64_t tick_until;
+static uint8_t tick_pending;
+static usbd_mem_cb storage_cached;                      /* the callbacks of sd_msd.c, kept while the blocking ones run */
+static int failures;
+
+/*!
+    \brief      the timer of the example, calls sd_msd_process() until tick_until
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void tick(void *arg)
+{
+    sd_msd_process();
+
+    if(usb_sim_now() + TICK_NS <= tick_until) {
+        usb_sim_at(usb_sim_now() + TICK_NS, tick, NULL);
+    } else {
+        tick_pending = 0U;
+    }
+}
+
+/*!
+    \brief      keep the timer running for a time, a command that hangs ends the run after it
+    \param[in]  ns: time
+    \param[out] none
+    \retval     none
+*/
+static void tick_arm(uint64_t ns)
+{
+    tick_until = usb_sim_now() + ns;
+    if(0U == tick_pending) {
+        tick_pending = 1U;
+        usb_sim_at(usb_sim_now() + TICK_NS, tick, NULL);
+    }
+}
+
+/*!
+    \brief      never done, runs the events until they run out
+    \param[in]  none
+    \param[out] none
+    \retval     0
+*/
+static int never_done(void)
+{
+    return 0;
+}
+
+/*!
+    \brief      let the host stay idle for a time
+    \param[in]  ns: time
+    \param[out] none
+    \retval     none
+*/
+static void idle_wait(uint64_t ns)
+{
+    tick_arm(ns);
+    (void)usb_sim_run(never_done);
+}
+
+/*!
+    \brief      READ10 or WRITE10 with the timer running
+    \param[in]  opcode: SCSI_READ10 or SCSI_WRITE10
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  data: buffer
+    \param[out] none
+    \retval     CSW status
+*/
+static int sd_rw10(uint8_t opcode, uint32_t block, uint32_t blocks, uint8_t *data)
+{
+    tick_arm(TICK_SPAN_NS);
+    return msc_host_rw10(opcode, block, blocks, data);
+}
+
+/*!
+    \brief      SYNCHRONIZE CACHE(10) or START STOP UNIT with the timer running
+    \param[in]  opcode: SCSI_SYNCHRONIZE_CACHE10 or SCSI_START_STOP_UNIT
+    \param[out] none
+    \retval     CSW status
+*/
+static int sd_sync(uint8_t opcode)
+{
+    uint8_t cb[10] = {0};
+
+    cb[0] = opcode;
+    tick_arm(TICK_SPAN_NS);
+    return msc_host_cmd(cb, 0U, NULL, 0U);
+}
+
+/*!
+    \brief      insert the card and start the class driver with a storage mode
+    \param[in]  mode: STORAGE_BLOCKING or STORAGE_CACHED
+    \param[out] none
+    \retval     none
+*/
+static void device_start(uint32_t mode)
+{
+    uint32_t blocks;
+
+    usbd_sd_storage_fops.mem_read_start = (STORAGE_CACHED == mode) ? storage_cached.mem_read_start : NULL;
+    usbd_sd_storage_fops.mem_write_start = (STORAGE_CACHED == mode) ? storage_cached.mem_write_start : NULL;
+    usbd_sd_storage_fops.mem_sync = (STORAGE_CACHED == mode) ? storage_cached.mem_sync : NULL;
+
+    memset(disk, 0, DISK_SIZE);
+    sd_model_init(&model_card, disk, DISK_BLOCKS);
+    if(SD_OK != sd_msd_init()) {
+        printf("  sd_msd_init failed\n");
+        failures++;
+    }
+
+    msc_host_start(&udev, &bus_dma);
+    tick_pending = 0U;
+
+    if((0 != msc_host_capacity(&blocks)) || (DISK_BLOCKS != blocks)) {
+        printf("  READ CAPACITY failed\n");
+        failures++;
+    }
+}
+
+/*!
+    \brief      fill a buffer with a pattern of the block numbers and a seed
+    \param[in]  buf: buffer
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     none
+*/
+static void pattern_fill(uint8_t *buf, uint32_t block, uint32_t blocks, uint32_t seed)
+{
+    uint32_t i, *word = (uint32_t *)buf;
+
+    for(i = 0U; i < blocks * DISK_BLOCK_SIZE / 4U; i++) {
+        word[i] = (seed * 0x9E3779B9U) ^ ((block + i / (DISK_BLOCK_SIZE / 4U)) << 8) ^ (i % (DISK_BLOCK_SIZE / 4U));
+    }
+}
+
+/*!
+    \brief      check a buffer against the pattern
+    \param[in]  buf: buffer
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     1 if it matches
+*/
+static int pattern_check(const uint8_t *buf, uint32_t block, uint32_t blocks, uint32_t seed)
+{
+    static uint8_t expected[BENCH_TRANSFER];
+
+    pattern_fill(expected, block, blocks, seed);
+    return 0 == memcmp(buf, expected, blocks * DISK_BLOCK_SIZE);
+}
+
+/*!
+    \brief      check whether the card holds the pattern
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     1 if it does
+*/
+static int card_check(uint32_t block, uint32_t blocks, uint32_t seed)
+{
+    return pattern_check(&disk[block * DISK_BLOCK_SIZE], block, blocks, seed);
+}
+
+/*!
+    \brief      write and read back with odd lengths, sizes around the buffers of sd_msd.c
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_lengths(void)
+{
+    static const uint32_t lengths[] = {1U, 7U, 8U, 9U, 16U, 17U, 25U, 63U, 64U, 65U, 128U};
+    uint32_t i, block = 100U;
+
+    for(i = 0U; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        pattern_fill(host_buf, block, lengths[i], i + 1U);
+        if(0 != sd_rw10(SCSI_WRITE10, block, lengths[i], host_buf)) {
+            printf("  WRITE10 of %u blocks failed\n", (unsigned)lengths[i]);
+            failures++;
+        }
+        memset(host_buf, 0, lengths[i] * DISK_BLOCK_SIZE);
+        if((0 != sd_rw10(SCSI_READ10, block, lengths[i], host_buf)) || !pattern_check(host_buf, block, lengths[i], i + 1U)) {
+            printf("  READ10 of %u blocks returned wrong data\n", (unsigned)lengths[i]);
+            failures++;
+        }
+        block += lengths[i];
+    }
+
+    /* the same blocks once more, read before they are written back */
+    block = 100U;
+    for(i = 0U; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        pattern_fill(host_buf, block + 1U, lengths[i], i + 50U);
+        if(0 != sd_rw10(SCSI_WRITE10, block + 1U, lengths[i], host_buf)) {
+            failures++;
+        }
+        memset(host_buf, 0, lengths[i] * DISK_BLOCK_SIZE);
+        if((0 != sd_rw10(SCSI_READ10, block + 1U, lengths[i], host_buf)) || !pattern_check(host_buf, block + 1U, lengths[i], i + 50U)) {
+            printf("  READ10 of %u rewritten blocks returned wrong data\n", (unsigned)lengths[i]);
+            failures++;
+        }
+        block += lengths[i];
+    }
+}
+
+/*!
+    \brief      the card gets the cached data with SYNCHRONIZE CACHE, START STOP UNIT and after
+                the idle time
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_write_back(void)
+{
+    sd_msd_stats_struct stats;
+    uint32_t seed;
+
+    for(seed = 1U; seed <= 2U; seed++) {
+        pattern_fill(host_buf, 5000U, 20U, seed);
+        if(0 != sd_rw10(SCSI_WRITE10, 5000U, 20U, host_buf)) {
+            failures++;
+        }
+        if(card_check(5000U, 20U, seed)) {
+            printf("  a partly filled buffer was written at once\n");
+            failures++;
+        }
+        if((0 != sd_sync((1U == seed) ? SCSI_SYNCHRONIZE_CACHE10 : SCSI_START_STOP_UNIT)) || !card_check(5000U, 20U, seed)) {
+            printf("  %s did not write back the cache\n", (1U == seed) ? "SYNCHRONIZE CACHE" : "START STOP UNIT");
+            failures++;
+        }
+    }
+
+    pattern_fill(host_buf, 6000U, 10U, 3U);
+    if(0 != sd_rw10(SCSI_WRITE10, 6000U, 10U, host_buf)) {
+        failures++;
+    }
+    idle_wait(150000000U);
+    sd_msd_stats_get(&stats);
+    if(!card_check(6000U, 10U, 3U) || (0U == stats.idle_flushes)) {
+        printf("  an idle cache was not written back\n");
+        failures++;
+    }
+
+    /* nothing left to write, the sync finishes inside the command */
+    if(0 != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        printf("  SYNCHRONIZE CACHE of a clean cache failed\n");
+        failures++;
+    }
+}
+
+/*!
+    \brief      sequential reads hit the read-ahead windows, writes drop the windows they overlap
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_read_ahead(void)
+{
+    const uint32_t blocks = BENCH_TRANSFER / DISK_BLOCK_SIZE;
+    sd_msd_stats_struct before, after;
+    uint32_t block;
+
+    for(block = 8192U; block < 8192U + 8U * blocks; block += blocks) {
+        pattern_fill(host_buf, block, blocks, 4U);
+        if(0 != sd_rw10(SCSI_WRITE10, block, blocks, host_buf)) {
+            failures++;
+        }
+    }
+    if(0 != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        failures++;
+    }
+
+    sd_msd_stats_get(&before);
+    for(block = 8192U; block < 8192U + 8U * blocks; block += blocks) {
+        if((0 != sd_rw10(SCSI_READ10, block, blocks, host_buf)) || !pattern_check(host_buf, block, blocks, 4U)) {
+            printf("  sequential READ10 at %u returned wrong data\n", (unsigned)block);
+            failures++;
+        }
+    }
+    sd_msd_stats_get(&after);
+    /* only the first read misses, small windows may still be loading when the host gets there */
+    if((after.read_direct - before.read_direct > 1U) || (after.prefetches == before.prefetches)) {
+        printf("  %u of %u sequential reads missed the read-ahead\n", (unsigned)(after.read_direct - before.read_direct),
+               (unsigned)(after.reads - before.reads));
+        failures++;
+    }
+
+    /* the windows hold the blocks behind the last read now, overwrite some of them */
+    block = 8192U + 8U * blocks;
+    pattern_fill(host_buf, block, blocks, 5U);
+    if(0 != sd_rw10(SCSI_WRITE10, block, blocks, host_buf)) {
+        failures++;
+    }
+    if((0 != sd_rw10(SCSI_READ10, block - 8U, 16U, host_buf)) || !pattern_check(&host_buf[8U * DISK_BLOCK_SIZE], block, 8U, 5U)) {
+        printf("  READ10 after an overlapping write returned old data\n");
+        failures++;
+    }
+}
+
+/*!
+    \brief      a failing read and a failing write-back
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_errors(void)
+{
+    uint8_t key, asc;
+
+    sd_model_fail(12000U + 40U);
+    if((CSW_CMD_FAILED != sd_rw10(SCSI_READ10, 12000U, 128U, host_buf)) || (0U == msc_host_last()->stalls)) {
+        printf("  failed READ10 not reported\n");
+        failures++;
+    }
+    if((0 != msc_host_sense(&key, &asc)) || (HARDWARE_ERROR != key) || (UNRECOVERED_READ_ERROR != asc)) {
+        printf("  sense after a failed READ10 is %u/0x%02x\n", key, asc);
+        failures++;
+    }
+
+    /* the write is cached and passes, the write-back fails the next sync */
+    pattern_fill(host_buf, 12000U, 64U, 6U);
+    if(0 != sd_rw10(SCSI_WRITE10, 12000U + 16U, 32U, host_buf)) {
+        printf("  cached WRITE10 failed\n");
+        failures++;
+    }
+    if(CSW_CMD_FAILED != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        printf("  failed write-back not reported\n");
+        failures++;
+    }
+    if((0 != msc_host_sense(&key, &asc)) || (HARDWARE_ERROR != key) || (WRITE_FAULT != asc)) {
+        printf("  sense after a failed write-back is %u/0x%02x\n", key, asc);
+        failures++;
+    }
+
+    /* the error is reported once, the card works again */
+    sd_model_fail(SD_MODEL_NO_FAIL);
+    if(0 != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        printf("  SYNCHRONIZE CACHE after the error failed\n");
+        failures++;
+    }
+    pattern_fill(host_buf, 12000U, 128U, 7U);
+    if(0 != sd_rw10(SCSI_WRITE10, 12000U, 128U, host_buf)) {
+        failures++;
+    }
+    memset(host_buf, 0, 128U * DISK_BLOCK_SIZE);
+    if((0 != sd_rw10(SCSI_READ10, 12000U, 128U, host_buf)) || !pattern_check(host_buf, 12000U, 128U, 7U)) {
+        printf("  commands after the errors failed\n");
+        failures++;
+    }
+}
+
+/*!
+    \brief      run the checks on the cached storage, or the ones that apply to the blocking one
+    \param[in]  mode: STORAGE_BLOCKING or STORAGE_CACHED
+    \param[out] none
+    \retval     none
+*/
+static void check_run(uint32_t mode)
+{
+    sd_model_stats_struct card;
+    int before = failures + msc_host_errors();
+
+    device_start(mode);
+
+    check_lengths();
+    if(STORAGE_CACHED == mode) {
+        check_write_back();
+        check_read_ahead();
+        check_errors();
+    } else if(0 != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        /* without mem_sync there is nothing to write back */
+        printf("  SYNCHRONIZE CACHE failed\n");
+        failures++;
+    }
+
+    idle_wait(TICK_NS * 2U);
+    sd_model_stats_get(&card);
+    if((0U != card.violations) || (0U == sd_queue_idle())) {
+        printf("  %u violations of the request queue, queue %s\n", (unsigned)card.violations, sd_queue_idle() ? "idle" : "busy");
+        failures++;
+    }
+
+    printf("check %-8s %s\n", (STORAGE_CACHED == mode) ? "cached" : "blocking", (failures + msc_host_errors() == before) ? "ok" : "FAILED");
+}
+
+/*!
+    \brief      write with a sync at the end and read a range in commands of a size
+    \param[in]  mode: STORAGE_BLOCKING or STORAGE_CACHED
+    \param[in]  transfer: bytes per command
+    \param[in]  bytes: bytes of the range
+    \param[out] none
+    \retval     none
+*/
+static void bench_run(uint32_t mode, uint32_t transfer, uint32_t bytes)
+{
+    const uint32_t blocks = transfer / DISK_BLOCK_SIZE;
+    sd_model_stats_struct w, r;
+    uint64_t t0, t1, t2;
+    uint32_t block;
+
+    device_start(mode);
+
+    t0 = usb_sim_now();
+    for(block = 0U; block < bytes / DISK_BLOCK_SIZE; block += blocks) {
+        pattern_fill(host_buf, block, blocks, 3U);
+        if(0 != sd_rw10(SCSI_WRITE10, block, blocks, host_buf)) {
+            printf("  WRITE10 at %u failed\n", (unsigned)block);
+            failures++;
+        }
+    }
+    if(0 != sd_sync(SCSI_SYNCHRONIZE_CACHE10)) {
+        failures++;
+    }
+    t1 = usb_sim_now();
+    sd_model_stats_get(&w);
+    for(block = 0U; block < bytes / DISK_BLOCK_SIZE; block += blocks) {
+        if((0 != sd_rw10(SCSI_READ10, block, blocks, host_buf)) || !pattern_check(host_buf, block, blocks, 3U)) {
+            printf("  READ10 at %u returned wrong data\n", (unsigned)block);
+            failures++;
+        }
+    }
+    t2 = usb_sim_now();
+    sd_model_stats_get(&r);
+
+    printf("%-8s  %5uK  %6.2f  %6.2f  %6u  %6u  %6u  %6u\n", (STORAGE_CACHED == mode) ? "cached" : "blocking",
+           (unsigned)(transfer / 1024U),
+           (double)bytes / 1048576.0 / ((double)(t1 - t0) / 1e9),
+           (double)bytes / 1048576.0 / ((double)(t2 - t1) / 1e9),
+           (unsigned)(w.cmd24 + w.cmd25), (unsigned)w.cmd13,
+           (unsigned)(r.cmd17 + r.cmd18 - w.cmd17 - w.cmd18), (unsigned)r.violations);
+}
+
+/*!
+    \brief      run the checks and the benchmark table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if every check passed
+*/
+int main(void)
+{
+    disk = malloc(DISK_SIZE);
+    host_buf = malloc(BENCH_TRANSFER);
+    if((NULL == disk) || (NULL == host_buf)) {
+        return 1;
+    }
+    storage_cached = usbd_sd_storage_fops;
+
+    printf("MSC_MEDIA_BUFFERS %u of %u bytes, %u write buffers of %u blocks, %u read windows of %u blocks\n\n",
+           (unsigned)MSC_MEDIA_BUFFERS, (unsigned)MSC_MEDIA_PACKET_SIZE, (unsigned)SD_MSD_WRITE_BUFFERS,
+           (unsigned)SD_MSD_WRITE_BLOCKS, (unsigned)SD_MSD_READ_WINDOWS, (unsigned)SD_MSD_READ_BLOCKS);
+
+    check_run(STORAGE_BLOCKING);
+    check_run(STORAGE_CACHED);
+
+    printf("\nstorage   command   write    read  writes   CMD13   reads  misuse   (MB/s, card commands)\n");
+    bench_run(STORAGE_BLOCKING, BENCH_TRANSFER, DISK_SIZE);
+    bench_run(STORAGE_CACHED, BENCH_TRANSFER, DISK_SIZE);
+    bench_run(STORAGE_BLOCKING, 4096U, BENCH_SMALL_BYTES);
+    bench_run(STORAGE_CACHED, 4096U, BENCH_SMALL_BYTES);
+
+    free(disk);
+    free(host_buf);
+
+    failures += msc_host_errors();
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
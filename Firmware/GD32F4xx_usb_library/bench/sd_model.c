@@ -0,0 +1,595 @@
+/*!
+    \file    sd_model.c
+    \brief   SD card model behind the API of Examples/SDIO/Read_write/sdcard.h, on the time
+             of usb_sim.c
+
+    The request queue behaves like the one of sdcard.c: requests run in the order they were
+    submitted, adjacent ones of the same direction are merged into one transfer of up to
+    SD_QUEUE_MAX_BLOCKS blocks, reads complete at the end of their data phase as in the SDIO
+    interrupt, writes complete in sd_queue_process() once a CMD13 finds the card done with
+    programming. The commands of a transfer (CMD55 and ACMD23 before CMD25, CMD12 after a
+    multiple block transfer, the CMD13 polls) are sent by the CPU and cost it cmd_ns each,
+    the data phase and the programming run in the background.
+
+    The card costs what makes large transfers pay off: an access time before the first block
+    of a read, a busy time at the end of every write and an extra one for a write that does
+    not continue the previous one. The blocking sd_multiblocks_read() and
+    sd_multiblocks_write() keep the CPU for the whole transfer, programming included.
+
+    Misuse of the queue is counted as a violation: invalid parameters, submitting a request
+    the driver still owns, changing the data of a write before it was sent, blocking
+    transfers while the queue runs and transfers beyond the end of the card.
+*/
+
+#include <string.h>
+
+#include "sd_model.h"
+#include "usb_sim.h"
+
+#define SD_MODEL_BLOCK_SIZE             512U
+#define SD_MODEL_OWNED                  16U
+
+/* state of the transfer engine */
+#define SD_MODEL_IDLE                   0U
+#define SD_MODEL_TRANSFER               1U
+#define SD_MODEL_PROGRAMMING            2U
+
+/* a request the driver owns, with the checksum of the data of a write */
+typedef struct {
+    sd_request_struct *request;
+    uint32_t sum;
+} sd_model_owned_struct;
+
+static const sd_model_struct *card;
+static uint8_t *card_disk;
+static uint32_t card_blocks;
+static uint32_t card_fail = SD_MODEL_NO_FAIL;
+static uint32_t card_transmode = SD_POLLING_MODE;
+static uint32_t card_write_end;
+static sd_model_stats_struct card_stats;
+
+static sd_request_struct *queue_head;
+static sd_request_struct *queue_tail;
+static sd_request_struct *queue_batch;
+static sd_error_enum queue_batch_status;
+static uint8_t queue_state = SD_MODEL_IDLE;
+static uint64_t queue_program_end;
+static sd_queue_stats_struct queue_stats;
+static sd_model_owned_struct queue_owned[SD_MODEL_OWNED];
+
+static void sd_model_start(void);
+
+/*!
+    \brief      checksum of a buffer
+    \param[in]  data: buffer
+    \param[in]  len: length in bytes
+    \param[out] none
+    \retval     checksum
+*/
+static uint32_t sd_model_sum(const uint32_t *data, uint32_t len)
+{
+    uint32_t i, sum = 2166136261U;
+
+    for(i = 0U; i < len / 4U; i++) {
+        sum = (sum ^ data[i]) * 16777619U;
+    }
+    return sum;
+}
+
+/*!
+    \brief      find the entry of an owned request
+    \param[in]  request: the request, NULL for a free entry
+    \param[out] none
+    \retval     entry or NULL
+*/
+static sd_model_owned_struct *sd_model_owned(const sd_request_struct *request)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SD_MODEL_OWNED; i++) {
+        if(request == queue_owned[i].request) {
+            return &queue_owned[i];
+        }
+    }
+    return NULL;
+}
+
+/*!
+    \brief      check whether a range of blocks fails
+    \param[in]  block: first block
+    \param[in]  count: number of blocks
+    \param[out] none
+    \retval     SD_OK or the error of the card
+*/
+static sd_error_enum sd_model_check(uint32_t block, uint32_t count)
+{
+    if((block >= card_blocks) || (count > card_blocks - block)) {
+        card_stats.violations++;
+        return SD_OUT_OF_RANGE;
+    }
+    if((SD_MODEL_NO_FAIL != card_fail) && (block <= card_fail) && (card_fail < block + count)) {
+        card_stats.errors++;
+        return SD_DATA_CRC_ERROR;
+    }
+    return SD_OK;
+}
+
+/*!
+    \brief      busy time of the card after a write
+    \param[in]  block: first block
+    \param[in]  count: number of blocks
+    \param[out] none
+    \retval     time in ns
+*/
+static uint64_t sd_model_program_time(uint32_t block, uint32_t count)
+{
+    uint64_t ns = card->program_ns + (uint64_t)count * card->program_block_ns;
+
+    if(block != card_write_end) {
+        ns += card->random_ns;
+    }
+    card_write_end = block + count;
+    return ns;
+}
+
+/*!
+    \brief      time of the data phase on the bus
+    \param[in]  count: number of blocks
+    \param[out] none
+    \retval     time in ns
+*/
+static uint64_t sd_model_bus_time(uint32_t count)
+{
+    return (uint64_t)count * SD_MODEL_BLOCK_SIZE * 1000U / card->bytes_per_us;
+}
+
+/*!
+    \brief      complete all requests of the running transfer
+    \param[in]  status: result handed to the requests
+    \param[out] none
+    \retval     none
+*/
+static void sd_model_batch_complete(sd_error_enum status)
+{
+    sd_request_struct *request = queue_batch;
+    sd_request_struct *next;
+    sd_model_owned_struct *owned;
+
+    queue_batch = NULL;
+    if(SD_OK != status) {
+        queue_stats.errors++;
+    }
+
+    while(NULL != request) {
+        next = request->next;
+        owned = sd_model_owned(request);
+        if(NULL != owned) {
+            owned->request = NULL;
+        }
+        request->status = status;
+        request->done = 1U;
+        if(NULL != request->callback) {
+            request->callback(request);
+        }
+        request = next;
+    }
+}
+
+/*!
+    \brief      end of the data phase of the running transfer, as in the SDIO interrupt
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void sd_model_data_end(void *arg)
+{
+    sd_request_struct *request;
+    sd_model_owned_struct *owned;
+    uint32_t blocks = 0U;
+    uint64_t ns;
+    sd_error_enum status;
+
+    for(request = queue_batch; NULL != request; request = request->next) {
+        blocks += request->count;
+    }
+    status = sd_model_check(queue_batch->block, blocks);
+
+    if(blocks > 1U) {
+        card_stats.cmd12++;
+        usb_sim_cpu(card->cmd_ns);
+    }
+
+    for(request = queue_batch; (SD_OK == status) && (NULL != request); request = request->next) {
+        if(SD_REQUEST_READ == request->direction) {
+            memcpy(request->buffer, &card_disk[(uint64_t)request->block * SD_MODEL_BLOCK_SIZE], request->count * SD_MODEL_BLOCK_SIZE);
+            card_stats.blocks_read += request->count;
+        } else {
+            owned = sd_model_owned(request);
+            if((NULL != owned) && (owned->sum != sd_model_sum(request->buffer, request->count * SD_MODEL_BLOCK_SIZE))) {
+                card_stats.violations++;
+            }
+            memcpy(&card_disk[(uint64_t)request->block * SD_MODEL_BLOCK_SIZE], request->buffer, request->count * SD_MODEL_BLOCK_SIZE);
+            card_stats.blocks_written += request->count;
+        }
+    }
+
+    if(SD_REQUEST_WRITE == queue_batch->direction) {
+        /* the requests complete once a CMD13 of sd_queue_process() finds the card ready */
+        ns = sd_model_program_time(queue_batch->block, blocks);
+        card_stats.busy_ns += ns;
+        queue_program_end = usb_sim_now() + ns;
+        queue_batch_status = status;
+        queue_state = SD_MODEL_PROGRAMMING;
+    } else {
+        sd_model_batch_complete(status);
+        sd_model_start();
+    }
+}
+
+/*!
+    \brief      start the next transfer of the queue or go idle
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sd_model_start(void)
+{
+    sd_request_struct *last;
+    uint32_t blocks;
+    uint64_t ns;
+
+    if(NULL == queue_head) {
+        queue_state = SD_MODEL_IDLE;
+        return;
+    }
+    queue_state = SD_MODEL_TRANSFER;
+
+    /* take the first request and every following one that continues it on the card */
+    queue_batch = queue_head;
+    last = queue_head;
+    blocks = last->count;
+    queue_head = last->next;
+    while((NULL != queue_head) && (queue_head->direction == queue_batch->direction) &&
+            (queue_head->block == last->block + last->count) && (blocks + queue_head->count <= SD_QUEUE_MAX_BLOCKS)) {
+        last = queue_head;
+        blocks += last->count;
+        queue_head = last->next;
+        queue_stats.merged++;
+    }
+    last->next = NULL;
+    if(NULL == queue_head) {
+        queue_tail = NULL;
+    }
+    queue_stats.transfers++;
+    queue_stats.blocks += blocks;
+
+    ns = sd_model_bus_time(blocks);
+    if(SD_REQUEST_READ == queue_batch->direction) {
+        if(blocks > 1U) {
+            card_stats.cmd18++;
+        } else {
+            card_stats.cmd17++;
+        }
+        usb_sim_cpu(card->cmd_ns);
+        ns += card->access_ns;
+    } else if(blocks > 1U) {
+        /* CMD55, ACMD23 and CMD25 */
+        card_stats.acmd23++;
+        card_stats.cmd25++;
+        usb_sim_cpu(3U * (uint64_t)card->cmd_ns);
+    } else {
+        card_stats.cmd24++;
+        usb_sim_cpu(card->cmd_ns);
+    }
+    card_stats.busy_ns += ns;
+    usb_sim_at(usb_sim_now() + ns, sd_model_data_end, NULL);
+}
+
+/*!
+    \brief      insert a card with a timing over a disk image of a number of blocks
+    \param[in]  model: timing of the card
+    \param[in]  disk: disk image of blocks * 512 bytes
+    \param[in]  blocks: number of blocks
+    \param[out] none
+    \retval     none
+*/
+void sd_model_init(const sd_model_struct *model, uint8_t *disk, uint32_t blocks)
+{
+    card = model;
+    card_disk = disk;
+    card_blocks = blocks;
+    card_fail = SD_MODEL_NO_FAIL;
+    card_transmode = SD_POLLING_MODE;
+    card_write_end = 0U;
+    memset(&card_stats, 0, sizeof(card_stats));
+
+    queue_head = NULL;
+    queue_tail = NULL;
+    queue_batch = NULL;
+    queue_state = SD_MODEL_IDLE;
+    memset(&queue_stats, 0, sizeof(queue_stats));
+    memset(queue_owned, 0, sizeof(queue_owned));
+}
+
+/*!
+    \brief      fail every transfer that covers a block
+    \param[in]  block: the block, SD_MODEL_NO_FAIL for none
+    \param[out] none
+    \retval     none
+*/
+void sd_model_fail(uint32_t block)
+{
+    card_fail = block;
+}
+
+/*!
+    \brief      read the statistics since sd_model_init()
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_model_stats_get(sd_model_stats_struct *stats)
+{
+    *stats = card_stats;
+}
+
+/*!
+    \brief      initialize the SD card, nothing to do for the model
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_init(void)
+{
+    return SD_OK;
+}
+
+/*!
+    \brief      get the information of the card
+    \param[in]  none
+    \param[out] pcardinfo: the capacity and block size, the rest is zero
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_card_information_get(sd_card_info_struct *pcardinfo)
+{
+    memset(pcardinfo, 0, sizeof(*pcardinfo));
+    pcardinfo->card_type = SDIO_HIGH_CAPACITY_SD_CARD;
+    pcardinfo->card_capacity = card_blocks / 2U;
+    pcardinfo->card_blocksize = SD_MODEL_BLOCK_SIZE;
+    pcardinfo->card_rca = 1U;
+    return SD_OK;
+}
+
+/*!
+    \brief      select the card, nothing to do for the model
+    \param[in]  cardrca: the RCA of the card
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_card_select_deselect(uint16_t cardrca)
+{
+    return SD_OK;
+}
+
+/*!
+    \brief      configure the bus mode, the model always has 4 bits
+    \param[in]  busmode: the bus mode
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_bus_mode_config(uint32_t busmode)
+{
+    return SD_OK;
+}
+
+/*!
+    \brief      switch to high speed, the timing of the model already is
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_high_speed_config(void)
+{
+    return SD_OK;
+}
+
+/*!
+    \brief      configure the transfer mode
+    \param[in]  txmode: SD_DMA_MODE or SD_POLLING_MODE
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_transfer_mode_config(uint32_t txmode)
+{
+    card_transmode = txmode;
+    return SD_OK;
+}
+
+/*!
+    \brief      get the card capacity
+    \param[in]  none
+    \param[out] none
+    \retval     capacity in KB
+*/
+uint32_t sd_card_capacity_get(void)
+{
+    return card_blocks / 2U;
+}
+
+/*!
+    \brief      read blocks and wait for them, the CPU is busy for the whole transfer
+    \param[in]  preadbuffer: word aligned buffer
+    \param[in]  readaddr: byte address
+    \param[in]  blocksize: 512
+    \param[in]  blocksnumber: number of blocks
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_multiblocks_read(uint32_t *preadbuffer, uint32_t readaddr, uint16_t blocksize, uint32_t blocksnumber)
+{
+    uint32_t block = readaddr / SD_MODEL_BLOCK_SIZE;
+    uint64_t ns = card->cmd_ns + card->access_ns + sd_model_bus_time(blocksnumber);
+    sd_error_enum status;
+
+    if((SD_MODEL_IDLE != queue_state) || (SD_MODEL_BLOCK_SIZE != blocksize) || (0U == blocksnumber)) {
+        card_stats.violations++;
+        return SD_OPERATION_IMPROPER;
+    }
+    if(blocksnumber > 1U) {
+        card_stats.cmd18++;
+        card_stats.cmd12++;
+        ns += card->cmd_ns;
+    } else {
+        card_stats.cmd17++;
+    }
+    card_stats.busy_ns += ns;
+    usb_sim_cpu(ns);
+
+    status = sd_model_check(block, blocksnumber);
+    if(SD_OK == status) {
+        memcpy(preadbuffer, &card_disk[(uint64_t)block * SD_MODEL_BLOCK_SIZE], blocksnumber * SD_MODEL_BLOCK_SIZE);
+        card_stats.blocks_read += blocksnumber;
+    }
+    return status;
+}
+
+/*!
+    \brief      write blocks and wait until the card has programmed them, the CPU is busy for
+                the whole transfer
+    \param[in]  pwritebuffer: word aligned buffer
+    \param[in]  writeaddr: byte address
+    \param[in]  blocksize: 512
+    \param[in]  blocksnumber: number of blocks
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_t blocksize, uint32_t blocksnumber)
+{
+    uint32_t block = writeaddr / SD_MODEL_BLOCK_SIZE;
+    uint64_t ns, program;
+    sd_error_enum status;
+
+    if((SD_MODEL_IDLE != queue_state) || (SD_MODEL_BLOCK_SIZE != blocksize) || (0U == blocksnumber)) {
+        card_stats.violations++;
+        return SD_OPERATION_IMPROPER;
+    }
+    ns = sd_model_bus_time(blocksnumber);
+    if(blocksnumber > 1U) {
+        card_stats.acmd23++;
+        card_stats.cmd25++;
+        card_stats.cmd12++;
+        ns += 4U * (uint64_t)card->cmd_ns;
+    } else {
+        card_stats.cmd24++;
+        ns += card->cmd_ns;
+    }
+
+    status = sd_model_check(block, blocksnumber);
+    if(SD_OK == status) {
+        memcpy(&card_disk[(uint64_t)block * SD_MODEL_BLOCK_SIZE], pwritebuffer, blocksnumber * SD_MODEL_BLOCK_SIZE);
+        card_stats.blocks_written += blocksnumber;
+    }
+
+    /* the driver polls CMD13 until the card leaves the programming state */
+    program = sd_model_program_time(block, blocksnumber);
+    card_stats.cmd13 += (uint32_t)(program / card->cmd_ns) + 1U;
+    ns += program + card->cmd_ns;
+    card_stats.busy_ns += ns;
+    usb_sim_cpu(ns);
+
+    return status;
+}
+
+/*!
+    \brief      queue a block transfer, it runs in the background
+    \param[in]  request: the transfer, buffer, block, count, direction and callback have to be set
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_request_submit(sd_request_struct *request)
+{
+    sd_model_owned_struct *owned;
+
+    if((NULL == request) || (NULL == request->buffer) || (0U != ((uintptr_t)request->buffer & 0x3U)) ||
+            (0U == request->count) || ((SD_REQUEST_READ != request->direction) && (SD_REQUEST_WRITE != request->direction))) {
+        card_stats.violations++;
+        return SD_PARAMETER_INVALID;
+    }
+    if(SD_DMA_MODE != card_transmode) {
+        card_stats.violations++;
+        return SD_OPERATION_IMPROPER;
+    }
+    if(NULL != sd_model_owned(request)) {
+        /* the request is still queued or running */
+        card_stats.violations++;
+        return SD_OPERATION_IMPROPER;
+    }
+    owned = sd_model_owned(NULL);
+    if(NULL != owned) {
+        owned->request = request;
+        owned->sum = (SD_REQUEST_WRITE == request->direction) ? \
+                     sd_model_sum(request->buffer, request->count * SD_MODEL_BLOCK_SIZE) : 0U;
+    }
+
+    request->status = SD_OK;
+    request->done = 0U;
+    request->next = NULL;
+
+    if(NULL == queue_tail) {
+        queue_head = request;
+    } else {
+        queue_tail->next = request;
+    }
+    queue_tail = request;
+    queue_stats.requests++;
+
+    if(SD_MODEL_IDLE == queue_state) {
+        sd_model_start();
+    }
+    return SD_OK;
+}
+
+/*!
+    \brief      finish a write once the card has programmed the data, one CMD13 per call
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sd_queue_process(void)
+{
+    if(SD_MODEL_PROGRAMMING != queue_state) {
+        return;
+    }
+
+    card_stats.cmd13++;
+    usb_sim_cpu(card->cmd_ns);
+    if(usb_sim_now() < queue_program_end) {
+        return;
+    }
+
+    queue_state = SD_MODEL_TRANSFER;
+    sd_model_batch_complete(queue_batch_status);
+    sd_model_start();
+}
+
+/*!
+    \brief      check whether the request queue is idle
+    \param[in]  none
+    \param[out] none
+    \retval     1 if no request is pending or running, 0 otherwise
+*/
+uint8_t sd_queue_idle(void)
+{
+    return (SD_MODEL_IDLE == queue_state) ? 1U : 0U;
+}
+
+/*!
+    \brief      get the statistics of the request queue
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_queue_stats_get(sd_queue_stats_struct *stats)
+{
+    *stats = queue_stats;
+}
@@ -0,0 +1,57 @@
+/*!
+    \file    sd_model.h
+    \brief   SD card model behind the API of Examples/SDIO/Read_write/sdcard.h, on the time
+             of usb_sim.c
+*/
+
+#ifndef SD_MODEL_H
+#define SD_MODEL_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "sdcard.h"
+
+#define SD_MODEL_NO_FAIL                0xFFFFFFFFU
+
+/* timing of a card on a 4 bit bus */
+typedef struct {
+    const char *name;
+    uint32_t bytes_per_us;                              /*!< data rate of the bus */
+    uint32_t cmd_ns;                                    /*!< a command and its response, the CPU waits for it */
+    uint32_t access_ns;                                 /*!< from CMD17/CMD18 to the first block */
+    uint32_t program_ns;                                /*!< busy time at the end of every write */
+    uint32_t program_block_ns;                          /*!< busy time per block written */
+    uint32_t random_ns;                                 /*!< extra busy time of a write that does not continue the last one */
+} sd_model_struct;
+
+/* commands and time of the card */
+typedef struct {
+    uint32_t cmd17;                                     /*!< single block reads */
+    uint32_t cmd18;                                     /*!< multiple block reads */
+    uint32_t cmd24;                                     /*!< single block writes */
+    uint32_t cmd25;                                     /*!< multiple block writes */
+    uint32_t acmd23;                                    /*!< pre-erase counts before CMD25 */
+    uint32_t cmd12;                                     /*!< stop transmissions */
+    uint32_t cmd13;                                     /*!< status polls */
+    uint32_t blocks_read;                               /*!< blocks moved from the card */
+    uint32_t blocks_written;                            /*!< blocks moved to the card */
+    uint32_t errors;                                    /*!< transfers failed by sd_model_fail() */
+    uint32_t violations;                                /*!< misuse of the queue, see sd_model.c */
+    uint64_t busy_ns;                                   /*!< time the card transferred or programmed */
+} sd_model_stats_struct;
+
+/* function declarations */
+/* insert a card with a timing over a disk image of a number of blocks */
+void sd_model_init(const sd_model_struct *model, uint8_t *disk, uint32_t blocks);
+/* fail every transfer that covers a block, SD_MODEL_NO_FAIL for none */
+void sd_model_fail(uint32_t block);
+/* read the statistics since sd_model_init() */
+void sd_model_stats_get(sd_model_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SD_MODEL_H */
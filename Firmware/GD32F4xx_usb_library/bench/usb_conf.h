@@ -0,0 +1,27 @@
+/*!
+    \file    usb_conf.h
+    \brief   USB core configuration of the host benches, a HS core with internal DMA
+*/
+
+#ifndef USB_CONF_H
+#define USB_CONF_H
+
+#include "gd32f4xx.h"
+
+#define USB_HS_CORE
+#define USE_USB_HS
+#define USE_DEVICE_MODE
+#define USB_HS_INTERNAL_DMA_ENABLED
+
+#define RX_FIFO_HS_SIZE                 512U
+#define TX0_FIFO_HS_SIZE                128U
+#define TX1_FIFO_HS_SIZE                384U
+#define TX2_FIFO_HS_SIZE                0U
+#define TX3_FIFO_HS_SIZE                0U
+#define TX4_FIFO_HS_SIZE                0U
+#define TX5_FIFO_HS_SIZE                0U
+
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+
+#endif /* USB_CONF_H */
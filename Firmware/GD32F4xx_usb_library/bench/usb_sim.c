@@ -0,0 +1,452 @@
+/*!
+    \file    usb_sim.c
+    \brief   stand-in for the USB device core transfer functions, for running class drivers
+             on the host
+
+    usbd_ep_send(), usbd_ep_recev() and usbd_ep_stall() of usbd_core.c are replaced by a
+    discrete event model with a time in ns. A transfer occupies the bus for its length at the
+    bus rate plus a fixed cost, the bus carries one transfer at a time in either direction. An
+    IN transfer hands its data to the host when it ends, an OUT transfer starts once the host
+    has data for the armed endpoint and copies it into the buffer when it ends, so a class
+    driver that reuses a buffer of a transfer in flight sends or receives the wrong data.
+
+    Finished transfers call data_in and data_out of the class driver one after the other, like
+    the interrupt handler of the core. Storage backends spend CPU time in these handlers with
+    usb_sim_cpu(): with the internal DMA the transfers in flight go on meanwhile, in FIFO mode
+    the core feeds the FIFOs from the same interrupt and they wait for the CPU. The core
+    interrupt itself costs a fixed time per transfer and in FIFO mode also an interrupt per
+    packet and the word copies of usb_txfifo_write() and usb_rxfifo_read(), counted apart in
+    isr_ns of the statistics.
+
+    The internal DMA only moves words from and to word addresses, the core ignores the low bits
+    of DIEPDMAADDR and DOEPDMAADDR. A transfer of a data endpoint on a buffer off a word boundary
+    is counted in dma_unaligned, an IN transfer then hands the host the bytes from the word
+    address below, as the DMA would. usbd_ep_send() of the core copies such buffers of endpoint 0
+    itself, so endpoint 0 is not checked.
+*/
+
+#include "usb_sim.h"
+#include <string.h>
+
+/* kinds of events */
+#define USB_SIM_EVENT_IN                1U
+#define USB_SIM_EVENT_OUT               2U
+#define USB_SIM_EVENT_TIMER             3U
+
+/* a pending event */
+typedef struct {
+    uint8_t kind;                                       /*!< 0 for a free entry */
+    uint8_t ep_num;                                     /*!< endpoint of a transfer */
+    uint64_t t;                                         /*!< time of the event */
+    uint8_t *buf;                                       /*!< buffer of a transfer */
+    uint32_t len;                                       /*!< length of a transfer */
+    void (*fn)(void *arg);                              /*!< function of a timer */
+    void *arg;                                          /*!< argument of the function */
+} usb_sim_event_struct;
+
+/* an armed OUT endpoint */
+typedef struct {
+    uint8_t *buf;                                       /*!< receive buffer, NULL if not armed */
+    uint32_t len;                                       /*!< size of the buffer */
+    uint8_t started;                                    /*!< the transfer is on the bus */
+} usb_sim_out_struct;
+
+static usb_core_driver *sim_udev;
+static const usb_sim_bus_struct *sim_bus;
+static const usb_sim_host_struct *sim_host;
+static uint64_t sim_now;
+static uint64_t sim_bus_free;
+static usb_sim_event_struct sim_events[USB_SIM_EVENTS];
+static usb_sim_out_struct sim_out[USB_SIM_EVENTS];
+static uint8_t sim_stalled[2][USB_SIM_EVENTS];
+static usb_sim_stats_struct sim_stats;
+
+/*!
+    \brief      add a pending event
+    \param[in]  event: event to add
+    \param[out] none
+    \retval     none
+*/
+static void usb_sim_event_add(const usb_sim_event_struct *event)
+{
+    uint32_t i;
+
+    for(i = 0U; i < USB_SIM_EVENTS; i++) {
+        if(0U == sim_events[i].kind) {
+            sim_events[i] = *event;
+            return;
+        }
+    }
+}
+
+/*!
+    \brief      reserve the bus for a transfer
+    \param[in]  len: length of the transfer
+    \param[out] none
+    \retval     time the transfer ends
+*/
+static uint64_t usb_sim_bus_transfer(uint32_t len)
+{
+    uint64_t start = (sim_bus_free > sim_now) ? sim_bus_free : sim_now;
+    uint64_t duration = sim_bus->transfer_ns + (uint64_t)len * 1000U / sim_bus->bytes_per_us;
+
+    sim_bus_free = start + duration;
+    sim_stats.bus_busy_ns += duration;
+    return sim_bus_free;
+}
+
+/*!
+    \brief      the core interrupt of a finished transfer
+    \param[in]  len: length of the transfer
+    \param[out] none
+    \retval     none
+*/
+static void usb_sim_isr(uint32_t len)
+{
+    uint64_t ns = sim_bus->isr_ns;
+    uint32_t packets = (len + USB_SIM_PACKET_SIZE - 1U) / USB_SIM_PACKET_SIZE;
+
+    if(0U == packets) {
+        packets = 1U;
+    }
+    ns += (uint64_t)packets * sim_bus->packet_isr_ns;
+    ns += (uint64_t)((len + 3U) / 4U) * sim_bus->word_ns;
+
+    sim_stats.isr_ns += ns;
+    usb_sim_cpu(ns);
+}
+
+/*!
+    \brief      start the OUT transfer of an armed endpoint if the host has data
+    \param[in]  ep_num: endpoint number
+    \param[out] none
+    \retval     none
+*/
+static void usb_sim_out_start(uint8_t ep_num)
+{
+    usb_sim_out_struct *out = &sim_out[ep_num];
+    usb_sim_event_struct event;
+    uint32_t avail;
+
+    if((NULL == out->buf) || out->started || sim_stalled[0][ep_num]) {
+        return;
+    }
+    avail = sim_host->out_avail(ep_num);
+    if(0U == avail) {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.kind = USB_SIM_EVENT_OUT;
+    event.ep_num = ep_num;
+    event.buf = out->buf;
+    event.len = out->len;
+    event.t = usb_sim_bus_transfer((avail < out->len) ? avail : out->len);
+    usb_sim_event_add(&event);
+    out->started = 1U;
+}
+
+/*!
+    \brief      set up the stand-in, the class driver of udev is called on finished transfers
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  bus: timing of the bus and the core
+    \param[in]  host: host side of the bus
+    \param[out] none
+    \retval     none
+*/
+void usb_sim_init(usb_core_driver *udev, const usb_sim_bus_struct *bus, const usb_sim_host_struct *host)
+{
+    sim_udev = udev;
+    sim_bus = bus;
+    udev->bp.transfer_mode = bus->dma ? (uint8_t)USB_USE_DMA : (uint8_t)USB_USE_FIFO;
+    sim_host = host;
+    sim_now = 0U;
+    sim_bus_free = 0U;
+    memset(sim_events, 0, sizeof(sim_events));
+    memset(sim_out, 0, sizeof(sim_out));
+    memset(sim_stalled, 0, sizeof(sim_stalled));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+/*!
+    \brief      current time in ns
+    \param[in]  none
+    \param[out] none
+    \retval     time
+*/
+uint64_t usb_sim_now(void)
+{
+    return sim_now;
+}
+
+/*!
+    \brief      the CPU is busy in an interrupt, in FIFO mode the transfers in flight wait for it
+    \param[in]  ns: busy time
+    \param[out] none
+    \retval     none
+*/
+void usb_sim_cpu(uint64_t ns)
+{
+    uint32_t i;
+    uint8_t delayed = 0U;
+
+    if(!sim_bus->dma) {
+        for(i = 0U; i < USB_SIM_EVENTS; i++) {
+            if(((USB_SIM_EVENT_IN == sim_events[i].kind) || (USB_SIM_EVENT_OUT == sim_events[i].kind)) && \
+                    (sim_events[i].t > sim_now)) {
+                sim_events[i].t += ns;
+                delayed = 1U;
+            }
+        }
+        if(sim_bus_free > sim_now) {
+            sim_bus_free += ns;
+        }
+        if(delayed) {
+            sim_stats.stalled_ns += ns;
+        }
+    }
+    sim_stats.cpu_busy_ns += ns;
+    sim_now += ns;
+}
+
+/*!
+    \brief      call a function at a time, as an interrupt of the USB priority
+    \param[in]  t: time in ns
+    \param[in]  fn: function
+    \param[in]  arg: argument of the function
+    \param[out] none
+    \retval     none
+*/
+void usb_sim_at(uint64_t t, void (*fn)(void *arg), void *arg)
+{
+    usb_sim_event_struct event;
+
+    memset(&event, 0, sizeof(event));
+    event.kind = USB_SIM_EVENT_TIMER;
+    event.t = t;
+    event.fn = fn;
+    event.arg = arg;
+    usb_sim_event_add(&event);
+}
+
+/*!
+    \brief      the host has data for an armed OUT endpoint
+    \param[in]  ep_num: endpoint number
+    \param[out] none
+    \retval     none
+*/
+void usb_sim_out_ready(uint8_t ep_num)
+{
+    usb_sim_out_start(ep_num);
+}
+
+/*!
+    \brief      the host cleared the stall of an endpoint
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     none
+*/
+void usb_sim_clear_stall(uint8_t ep_addr)
+{
+    uint8_t ep_num = ep_addr & 0x7FU;
+
+    sim_stalled[(ep_addr & 0x80U) ? 1U : 0U][ep_num] = 0U;
+    if(0U == (ep_addr & 0x80U)) {
+        usb_sim_out_start(ep_num);
+    }
+}
+
+/*!
+    \brief      process events until done() returns 1
+    \param[in]  done: end condition
+    \param[out] none
+    \retval     1 if done() returned 1, 0 if the events ran out before
+*/
+int usb_sim_run(int (*done)(void))
+{
+    usb_sim_event_struct event;
+    uint32_t i, next;
+    uint32_t len;
+
+    while(!done()) {
+        next = USB_SIM_EVENTS;
+        for(i = 0U; i < USB_SIM_EVENTS; i++) {
+            if(sim_events[i].kind && ((USB_SIM_EVENTS == next) || (sim_events[i].t < sim_events[next].t))) {
+                next = i;
+            }
+        }
+        if(USB_SIM_EVENTS == next) {
+            return 0;
+        }
+
+        event = sim_events[next];
+        sim_events[next].kind = 0U;
+        if(event.t > sim_now) {
+            sim_now = event.t;
+        }
+
+        switch(event.kind) {
+        case USB_SIM_EVENT_IN:
+            sim_stats.in_transfers++;
+            sim_stats.in_bytes += event.len;
+            sim_host->in_done(event.ep_num, event.buf, event.len);
+            usb_sim_isr(event.len);
+            sim_udev->dev.class_core->data_in(sim_udev, event.ep_num);
+            break;
+
+        case USB_SIM_EVENT_OUT:
+            sim_out[event.ep_num].buf = NULL;
+            sim_out[event.ep_num].started = 0U;
+            len = sim_host->out_fill(event.ep_num, event.buf, event.len);
+            sim_udev->dev.transc_out[event.ep_num].xfer_count = len;
+            sim_stats.out_transfers++;
+            sim_stats.out_bytes += len;
+            usb_sim_isr(len);
+            sim_udev->dev.class_core->data_out(sim_udev, event.ep_num);
+            break;
+
+        default:
+            event.fn(event.arg);
+            break;
+        }
+    }
+    return 1;
+}
+
+/*!
+    \brief      read the statistics since usb_sim_init()
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void usb_sim_stats_get(usb_sim_stats_struct *stats)
+{
+    *stats = sim_stats;
+}
+
+/*!
+    \brief      configure an endpoint, only its packet size is kept on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_desc: endpoint descriptor
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_setup(usb_core_driver *udev, const usb_desc_ep *ep_desc)
+{
+    uint8_t ep_addr = ep_desc->bEndpointAddress;
+    uint16_t max_len = ep_desc->wMaxPacketSize & EP_MAX_PACKET_SIZE_MASK;
+
+    if(EP_DIR(ep_addr)) {
+        udev->dev.transc_in[EP_ID(ep_addr)].max_len = max_len;
+    } else {
+        udev->dev.transc_out[EP_ID(ep_addr)].max_len = max_len;
+    }
+    return 0U;
+}
+
+/*!
+    \brief      clear an endpoint, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_clear(usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+/*!
+    \brief      flush an endpoint FIFO, nothing to do on the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_fifo_flush(usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+/*!
+    \brief      check the buffer of a DMA transfer on a data endpoint
+    \param[in]  ep_num: endpoint number
+    \param[in]  pbuf: buffer of the transfer
+    \param[out] none
+    \retval     1 if the DMA cannot use the address as it is
+*/
+static uint8_t usb_sim_dma_unaligned(uint8_t ep_num, const uint8_t *pbuf)
+{
+    if(sim_bus->dma && (0U != ep_num) && (0U != ((uintptr_t)pbuf & 3U))) {
+        sim_stats.dma_unaligned++;
+        return 1U;
+    }
+    return 0U;
+}
+
+/*!
+    \brief      start an IN transfer, the host gets the data when it ends
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: data to send
+    \param[in]  len: length of the data
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_send(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    usb_sim_event_struct event;
+
+    udev->dev.transc_in[EP_ID(ep_addr)].xfer_buf = pbuf;
+    udev->dev.transc_in[EP_ID(ep_addr)].xfer_len = len;
+
+    memset(&event, 0, sizeof(event));
+    event.kind = USB_SIM_EVENT_IN;
+    event.ep_num = ep_addr & 0x7FU;
+    event.buf = pbuf;
+    if(usb_sim_dma_unaligned(event.ep_num, pbuf)) {
+        event.buf = (uint8_t *)((uintptr_t)pbuf & ~(uintptr_t)3U);
+    }
+    event.len = len;
+    event.t = usb_sim_bus_transfer(len);
+    usb_sim_event_add(&event);
+    return 0U;
+}
+
+/*!
+    \brief      arm an OUT endpoint, the transfer starts when the host has data
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pbuf: receive buffer
+    \param[in]  len: size of the buffer
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_recev(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    uint8_t ep_num = ep_addr & 0x7FU;
+
+    udev->dev.transc_out[ep_num].xfer_buf = pbuf;
+    udev->dev.transc_out[ep_num].xfer_len = len;
+    (void)usb_sim_dma_unaligned(ep_num, pbuf);
+
+    sim_out[ep_num].buf = pbuf;
+    sim_out[ep_num].len = len;
+    sim_out[ep_num].started = 0U;
+    usb_sim_out_start(ep_num);
+    return 0U;
+}
+
+/*!
+    \brief      stall an endpoint and tell the host
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     0
+*/
+uint32_t usbd_ep_stall(usb_core_driver *udev, uint8_t ep_addr)
+{
+    sim_stalled[(ep_addr & 0x80U) ? 1U : 0U][ep_addr & 0x7FU] = 1U;
+    sim_host->stall(ep_addr);
+    return 0U;
+}
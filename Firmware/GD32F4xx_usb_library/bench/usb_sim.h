@@ -0,0 +1,76 @@
+/*!
+    \file    usb_sim.h
+    \brief   stand-in for the USB device core transfer functions, for running class drivers
+             on the host
+*/
+
+#ifndef USB_SIM_H
+#define USB_SIM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbd_core.h"
+
+/* pending events, endpoint transfers and timers */
+#define USB_SIM_EVENTS                  16U
+
+/* packet size of the bulk endpoints, the FIFO mode takes an interrupt per packet */
+#define USB_SIM_PACKET_SIZE             512U
+
+/* timing of the bus and the core */
+typedef struct {
+    const char *name;
+    uint32_t bytes_per_us;                              /*!< payload rate of the bus */
+    uint32_t transfer_ns;                               /*!< fixed cost of a transfer */
+    uint32_t isr_ns;                                    /*!< interrupt handling of a finished transfer */
+    uint32_t packet_isr_ns;                             /*!< interrupt of every packet, FIFO mode only */
+    uint32_t word_ns;                                   /*!< CPU copy of a word to or from a FIFO, FIFO mode only */
+    uint8_t dma;                                        /*!< 1: the internal DMA moves the data, 0: the CPU fills the FIFOs in the interrupt */
+} usb_sim_bus_struct;
+
+/* host side of the bus */
+typedef struct {
+    void (*in_done)(uint8_t ep_num, const uint8_t *data, uint32_t len);    /*!< an IN transfer reached the host */
+    uint32_t (*out_avail)(uint8_t ep_num);                                  /*!< bytes the host has for an OUT endpoint */
+    uint32_t (*out_fill)(uint8_t ep_num, uint8_t *buf, uint32_t len);       /*!< the host sends up to len bytes */
+    void (*stall)(uint8_t ep_addr);                                         /*!< the device stalled an endpoint */
+} usb_sim_host_struct;
+
+/* transfers and time of a run */
+typedef struct {
+    uint32_t in_transfers;                              /*!< IN transfers */
+    uint32_t out_transfers;                             /*!< OUT transfers */
+    uint64_t in_bytes;                                  /*!< bytes sent to the host */
+    uint64_t out_bytes;                                 /*!< bytes received from the host */
+    uint64_t bus_busy_ns;                               /*!< time the bus carried data */
+    uint64_t cpu_busy_ns;                               /*!< time the CPU spent in interrupts */
+    uint64_t isr_ns;                                    /*!< part of it in the interrupt of the USB core, without the class driver */
+    uint64_t stalled_ns;                                /*!< transfers delayed by the CPU, FIFO mode only */
+    uint32_t dma_unaligned;                             /*!< data endpoint transfers of the DMA on a buffer off a word boundary */
+} usb_sim_stats_struct;
+
+/* function declarations */
+/* set up the stand-in, the class driver of udev is called on finished transfers */
+void usb_sim_init(usb_core_driver *udev, const usb_sim_bus_struct *bus, const usb_sim_host_struct *host);
+/* current time in ns */
+uint64_t usb_sim_now(void);
+/* the CPU is busy in an interrupt, in FIFO mode the transfers in flight wait for it */
+void usb_sim_cpu(uint64_t ns);
+/* call a function at a time, as an interrupt of the USB priority */
+void usb_sim_at(uint64_t t, void (*fn)(void *arg), void *arg);
+/* the host has data for an armed OUT endpoint */
+void usb_sim_out_ready(uint8_t ep_num);
+/* the host cleared the stall of an endpoint */
+void usb_sim_clear_stall(uint8_t ep_addr);
+/* process events until done() returns 1, 0 if the events ran out before */
+int usb_sim_run(int (*done)(void));
+/* read the statistics since usb_sim_init() */
+void usb_sim_stats_get(usb_sim_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_SIM_H */
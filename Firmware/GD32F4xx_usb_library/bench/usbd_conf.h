@@ -0,0 +1,31 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device class configuration of the host benches, as in msc_udisk with an
+             ULPI PHY
+*/
+
+#ifndef USBD_CONF_H
+#define USBD_CONF_H
+
+#include "usb_conf.h"
+
+/* USB configure exported defines */
+#define USBD_CFG_MAX_NUM                1U
+#define USBD_ITF_MAX_NUM                1U
+#define USB_STR_DESC_MAX_SIZE           64U
+
+#define USBD_MSC_INTERFACE              0U
+
+/* class layer parameter */
+#define MSC_IN_EP                       EP1_IN
+#define MSC_OUT_EP                      EP1_OUT
+
+#define MSC_DATA_PACKET_SIZE            512U
+
+#define MSC_MEDIA_PACKET_SIZE           4096U
+
+#define MEM_LUN_NUM                     1U
+
+#define USB_STRING_COUNT                4U
+
+#endif /* USBD_CONF_H */
@@ -0,0 +1,24 @@
+/*!
+    \file    usb_conf.h
+    \brief   USB core configuration of the host MSC bench, the HS core in host mode as in
+             usb_host_msc_udisk
+*/
+
+#ifndef USB_CONF_H
+#define USB_CONF_H
+
+#include "gd32f4xx.h"
+#include <string.h>
+
+#define USB_HS_CORE
+#define USE_USB_HS
+#define USE_HOST_MODE
+
+#define USB_RX_FIFO_HS_SIZE             512U
+#define USB_HTX_NPFIFO_HS_SIZE          256U
+#define USB_HTX_PFIFO_HS_SIZE           256U
+
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+
+#endif /* USB_CONF_H */
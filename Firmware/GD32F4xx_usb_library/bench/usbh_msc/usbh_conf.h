@@ -0,0 +1,17 @@
+/*!
+    \file    usbh_conf.h
+    \brief   USB host configuration of the host MSC bench, as in usb_host_msc_udisk
+*/
+
+#ifndef USBH_CONF_H
+#define USBH_CONF_H
+
+#define USBH_MAX_EP_NUM                 2U
+#define USBH_MAX_INTERFACES_NUM         2U
+#define USBH_MAX_ALT_SETTING            2U
+#define USBH_MAX_SUPPORTED_CLASS        2U
+
+#define USBH_DATA_BUF_MAX_LEN           0x200U
+#define USBH_CFGSET_MAX_LEN             0x200U
+
+#endif /* USBH_CONF_H */
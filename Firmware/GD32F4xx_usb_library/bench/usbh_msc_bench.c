@@ -0,0 +1,458 @@
+/*!
+    \file    usbh_msc_bench.c
+    \brief   file copy on a USB stick through the host MSC class and the FatFs driver of
+             usbh_msc_fatfs.c, on a stand-in of the host core and of a Bulk-Only Transport stick
+
+    usbh_sim.c carries out the URBs of usbh_msc_bbb.c against a stick that answers from an
+    image disk of 64MB, with the timing of the bus, of a URB on the host and of the flash of
+    the stick. FatFs runs unchanged on top of USBH_MSC_Driver, the copies between FatFs and
+    the buffers of the driver are charged as CPU time.
+
+    The checks come first: sectors read back while they wait in the write buffer, the write
+    buffer reaching the stick only with CTRL_SYNC, the read-ahead window following a write, a
+    stick that rejects commands of more than 32 blocks, and the replug of a stick. The table
+    then formats the stick, writes a file of 4MB, reads it back and copies it to a second file,
+    in calls of 512 bytes, 4KB and 32KB, on a high speed and a full speed stick.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "image_disk.h"
+#include "usbh_msc_fatfs.h"
+#include "usbh_sim.h"
+
+/* 64MB stick on image disk 0 */
+#define STICK_LUN                       0U
+#define STICK_SECTORS                   131072U
+#define SECTOR_SIZE                     512U
+#define FILE_BYTES                      (4U * 1024U * 1024U)
+#define CHUNK_MAX                       32768U
+/* clusters of the factory format of sticks, a copy switches between the FAT entries of the
+   two files once per cluster */
+#define CLUSTER_SIZE                    32768U
+/* memcpy of a sector by the CPU */
+#define COPY_NS_PER_SECTOR              3000U
+
+/* the controller of a stick: command overhead, read and program rate, erase blocks of 128KB */
+static const image_disk_model_struct model_stick = {"stick", 150U, 250U, 25000U, 8000U, 0U, 256U, 2000U, 4U};
+
+/* buses: packet size, payload rate, URB cost on the host, CBW decoding, longest command */
+static const usbh_sim_bus_struct bus_hs = {"hs", 512U, 40U, 8000U, 20000U, 0U};
+static const usbh_sim_bus_struct bus_fs = {"fs", 64U, 1U, 5000U, 20000U, 0U};
+static const usbh_sim_bus_struct bus_hs_short = {"hs", 512U, 40U, 8000U, 20000U, 32U};
+
+/* the host of the examples, usbh_msc_fatfs.c works on it */
+usbh_host usb_host_msc;
+
+static usb_core_driver usbh_core;
+static FATFS fs;
+static FIL src, dst;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static BYTE chunk_buf[CHUNK_MAX];
+static BYTE sector_buf[64U * SECTOR_SIZE];
+static BYTE image_buf[64U * SECTOR_SIZE];
+static uint32_t copied;                                 /* sectors_copied already charged */
+static int failures;
+
+/*!
+    \brief      plug a stick into the host and run the class up to MSC_IDLE
+    \param[in]  bus: timing of the bus and the stick
+    \param[out] none
+    \retval     0 on success
+*/
+static int stick_attach(const usbh_sim_bus_struct *bus)
+{
+    usbh_msc_fatfs_stats_struct stats;
+
+    usbh_msc_fatfs_reset();
+    if(0 != usbh_sim_attach(&usb_host_msc, &usbh_core, bus, STICK_LUN)) {
+        printf("  the stick did not reach MSC_IDLE\n");
+        failures++;
+        return -1;
+    }
+
+    usbh_msc_fatfs_stats_get(&stats);
+    copied = stats.sectors_copied;
+
+    return 0;
+}
+
+/*!
+    \brief      charge the copies of the driver since the last call as CPU time
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void copies_charge(void)
+{
+    usbh_msc_fatfs_stats_struct stats;
+
+    usbh_msc_fatfs_stats_get(&stats);
+    usbh_sim_cpu((uint64_t)(stats.sectors_copied - copied) * COPY_NS_PER_SECTOR);
+    copied = stats.sectors_copied;
+}
+
+/*!
+    \brief      fill sectors with a pattern of their number and a seed
+    \param[in]  buf: data of the sectors
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     none
+*/
+static void pattern_fill(BYTE *buf, DWORD sector, UINT count, uint32_t seed)
+{
+    uint32_t i;
+
+    for(i = 0U; i < count * SECTOR_SIZE; i++) {
+        buf[i] = (BYTE)((sector + i / SECTOR_SIZE) * 7U + i + seed * 13U);
+    }
+}
+
+/*!
+    \brief      check sectors against the pattern
+    \param[in]  buf: data of the sectors
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     0 if they match
+*/
+static int pattern_check(const BYTE *buf, DWORD sector, UINT count, uint32_t seed)
+{
+    uint32_t i;
+
+    for(i = 0U; i < count * SECTOR_SIZE; i++) {
+        if(buf[i] != (BYTE)((sector + i / SECTOR_SIZE) * 7U + i + seed * 13U)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      check the sectors on the flash of the stick, past the buffers of the driver
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     0 if they match
+*/
+static int stick_check(DWORD sector, UINT count, uint32_t seed)
+{
+    if(RES_OK != image_disk_driver.disk_read(STICK_LUN, image_buf, sector, count)) {
+        return -1;
+    }
+
+    return pattern_check(image_buf, sector, count, seed);
+}
+
+/*!
+    \brief      write sectors with the pattern through the driver
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     0 on success
+*/
+static int disk_put(DWORD sector, UINT count, uint32_t seed)
+{
+    pattern_fill(sector_buf, sector, count, seed);
+
+    return (RES_OK == USBH_MSC_Driver.disk_write(0U, sector_buf, sector, count)) ? 0 : -1;
+}
+
+/*!
+    \brief      read sectors through the driver and check the pattern
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     0 if they match
+*/
+static int disk_get(DWORD sector, UINT count, uint32_t seed)
+{
+    memset(sector_buf, 0, count * SECTOR_SIZE);
+    if(RES_OK != USBH_MSC_Driver.disk_read(0U, sector_buf, sector, count)) {
+        return -1;
+    }
+
+    return pattern_check(sector_buf, sector, count, seed);
+}
+
+/*!
+    \brief      read back, write buffer and read-ahead window on a stick that takes any length
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_buffers(void)
+{
+    usbh_msc_fatfs_stats_struct before, after;
+    int start = failures;
+    DWORD sector;
+
+    if((0 != stick_attach(&bus_hs)) || (0U != USBH_MSC_Driver.disk_initialize(0U))) {
+        printf("  the stick did not initialize\n");
+        failures++;
+        return;
+    }
+
+    /* sectors still in the write buffer */
+    if((0 != disk_put(100U, 3U, 1U)) || (0 != disk_get(100U, 3U, 1U)) || (0 != disk_get(101U, 1U, 1U))) {
+        printf("  read back of buffered writes returned wrong data\n");
+        failures++;
+    }
+
+    /* the write buffer reaches the stick with CTRL_SYNC */
+    if(0 != disk_put(200U, 2U, 2U)) {
+        printf("  write failed\n");
+        failures++;
+    }
+    if((USBH_MSC_FATFS_WRITE_SECTORS > 0U) && (0 == stick_check(200U, 2U, 2U))) {
+        printf("  a partly filled write buffer was written at once\n");
+        failures++;
+    }
+    if((RES_OK != USBH_MSC_Driver.disk_ioctl(0U, CTRL_SYNC, NULL)) || (0 != stick_check(200U, 2U, 2U))) {
+        printf("  CTRL_SYNC did not write the buffer to the stick\n");
+        failures++;
+    }
+
+    /* the window follows writes into it */
+    if((0 != disk_put(299U, 33U, 3U)) || (RES_OK != USBH_MSC_Driver.disk_ioctl(0U, CTRL_SYNC, NULL)) || \
+       (0 != disk_get(299U, 1U, 3U)) || (0 != disk_get(300U, 1U, 3U)) || (0 != disk_put(305U, 1U, 4U)) || \
+       (0 != disk_get(305U, 1U, 4U)) || (0 != disk_get(306U, 1U, 3U))) {
+        printf("  read after a write into the read-ahead window returned wrong data\n");
+        failures++;
+    }
+
+    /* sequential single sector reads */
+    if((0 != disk_put(1000U, 64U, 5U)) || (RES_OK != USBH_MSC_Driver.disk_ioctl(0U, CTRL_SYNC, NULL))) {
+        printf("  write failed\n");
+        failures++;
+    }
+    usbh_msc_fatfs_stats_get(&before);
+    for(sector = 1000U; sector < 1064U; sector++) {
+        if(0 != disk_get(sector, 1U, 5U)) {
+            printf("  sequential read at %u returned wrong data\n", (unsigned)sector);
+            failures++;
+            break;
+        }
+    }
+    usbh_msc_fatfs_stats_get(&after);
+    if((USBH_MSC_FATFS_READ_SECTORS > 0U) && \
+       (after.read_commands - before.read_commands > 64U / USBH_MSC_FATFS_READ_SECTORS + 1U)) {
+        printf("  64 sequential reads took %u READ(10)\n", (unsigned)(after.read_commands - before.read_commands));
+        failures++;
+    }
+
+    if(0U != after.errors) {
+        printf("  %u failed commands\n", (unsigned)after.errors);
+        failures++;
+    }
+
+    printf("check %-8s %s\n", "buffers", (failures == start) ? "ok" : "FAILED");
+}
+
+/*!
+    \brief      a stick that rejects commands of more than 32 blocks
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_rejects(void)
+{
+    usbh_msc_fatfs_stats_struct stats;
+    usbh_sim_stats_struct sim;
+    int start = failures;
+
+    if((0 != stick_attach(&bus_hs_short)) || (0U != USBH_MSC_Driver.disk_initialize(0U))) {
+        printf("  the stick did not initialize\n");
+        failures++;
+        return;
+    }
+
+    if((0 != disk_put(2000U, 64U, 6U)) || (0 != disk_get(2000U, 64U, 6U)) || (0 != stick_check(2000U, 64U, 6U))) {
+        printf("  64 sectors in commands of 32 blocks returned wrong data\n");
+        failures++;
+    }
+
+    usbh_msc_fatfs_stats_get(&stats);
+    usbh_sim_stats_get(&sim);
+    if((32U != stats.max_sectors) || (0U == stats.rejects) || (stats.rejects != sim.rejects)) {
+        printf("  %u sectors per command after %u rejects, the stick rejected %u\n", (unsigned)stats.max_sectors,
+               (unsigned)stats.rejects, (unsigned)sim.rejects);
+        failures++;
+    }
+    if(0U != stats.errors) {
+        printf("  %u failed commands\n", (unsigned)stats.errors);
+        failures++;
+    }
+
+    printf("check %-8s %s\n", "rejects", (failures == start) ? "ok" : "FAILED");
+}
+
+/*!
+    \brief      unplug the stick and plug it again without disk_initialize
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void check_replug(void)
+{
+    int start = failures;
+
+    if((0 != stick_attach(&bus_hs)) || (0 != disk_put(3000U, 2U, 7U))) {
+        printf("  write failed\n");
+        failures++;
+        return;
+    }
+
+    usbh_core.host.connect_status = 0U;
+    if(0U == (STA_NOINIT & USBH_MSC_Driver.disk_status(0U))) {
+        printf("  a removed stick is still ready\n");
+        failures++;
+    }
+    if(RES_OK == USBH_MSC_Driver.disk_read(0U, sector_buf, 3000U, 1U)) {
+        printf("  a removed stick returned data\n");
+        failures++;
+    }
+
+    /* FatFs initializes its drive only once, the driver sets the unit up again by itself */
+    if((0 != stick_attach(&bus_hs)) || (0U != USBH_MSC_Driver.disk_status(0U)) || (0 != disk_get(2000U, 64U, 6U))) {
+        printf("  the replugged stick did not come back\n");
+        failures++;
+    }
+
+    printf("check %-8s %s\n", "replug", (failures == start) ? "ok" : "FAILED");
+}
+
+/*!
+    \brief      write, read back and copy a file in calls of chunk bytes
+    \param[in]  bus: timing of the bus and the stick
+    \param[in]  chunk: bytes per f_read and f_write
+    \param[out] none
+    \retval     none
+*/
+static void bench_run(const usbh_sim_bus_struct *bus, UINT chunk)
+{
+    usbh_sim_stats_struct before, after;
+    uint64_t start, write_ns, read_ns, copy_ns;
+    uint32_t pos, commands;
+    UINT n;
+    int ok = 1;
+
+    if(0 != stick_attach(bus)) {
+        return;
+    }
+    if((FR_OK != f_mkfs(path, FM_ANY, CLUSTER_SIZE, work, sizeof(work))) || (FR_OK != f_mount(&fs, path, 1U))) {
+        printf("  formatting the stick failed\n");
+        failures++;
+        return;
+    }
+
+    /* write the source file */
+    start = usbh_sim_now();
+    ok &= (FR_OK == f_open(&src, "0:/src.bin", FA_CREATE_ALWAYS | FA_WRITE));
+    for(pos = 0U; ok && (pos < FILE_BYTES); pos += chunk) {
+        pattern_fill(chunk_buf, pos / SECTOR_SIZE, chunk / SECTOR_SIZE, 8U);
+        ok &= (FR_OK == f_write(&src, chunk_buf, chunk, &n)) && (n == chunk);
+        copies_charge();
+    }
+    ok &= (FR_OK == f_close(&src));
+    copies_charge();
+    write_ns = usbh_sim_now() - start;
+
+    /* read it back */
+    start = usbh_sim_now();
+    ok &= (FR_OK == f_open(&src, "0:/src.bin", FA_READ));
+    for(pos = 0U; ok && (pos < FILE_BYTES); pos += chunk) {
+        ok &= (FR_OK == f_read(&src, chunk_buf, chunk, &n)) && (n == chunk);
+        copies_charge();
+        ok &= (0 == pattern_check(chunk_buf, pos / SECTOR_SIZE, chunk / SECTOR_SIZE, 8U));
+    }
+    ok &= (FR_OK == f_close(&src));
+    read_ns = usbh_sim_now() - start;
+    if(!ok) {
+        printf("  writing and reading back the source failed\n");
+        failures++;
+        return;
+    }
+
+    /* copy it */
+    usbh_sim_stats_get(&before);
+    start = usbh_sim_now();
+    ok &= (FR_OK == f_open(&src, "0:/src.bin", FA_READ));
+    ok &= (FR_OK == f_open(&dst, "0:/dst.bin", FA_CREATE_ALWAYS | FA_WRITE));
+    for(pos = 0U; ok && (pos < FILE_BYTES); pos += chunk) {
+        ok &= (FR_OK == f_read(&src, chunk_buf, chunk, &n)) && (n == chunk);
+        copies_charge();
+        ok &= (FR_OK == f_write(&dst, chunk_buf, chunk, &n)) && (n == chunk);
+        copies_charge();
+    }
+    ok &= (FR_OK == f_close(&src));
+    ok &= (FR_OK == f_close(&dst));
+    copies_charge();
+    copy_ns = usbh_sim_now() - start;
+    usbh_sim_stats_get(&after);
+
+    /* check the copy */
+    ok &= (FR_OK == f_open(&dst, "0:/dst.bin", FA_READ));
+    for(pos = 0U; ok && (pos < FILE_BYTES); pos += chunk) {
+        ok &= (FR_OK == f_read(&dst, chunk_buf, chunk, &n)) && (n == chunk);
+        ok &= (0 == pattern_check(chunk_buf, pos / SECTOR_SIZE, chunk / SECTOR_SIZE, 8U));
+    }
+    ok &= (FR_OK == f_close(&dst));
+    if(!ok) {
+        printf("  the copy returned wrong data\n");
+        failures++;
+    }
+    f_mount(NULL, path, 0U);
+
+    commands = (after.read10 - before.read10) + (after.write10 - before.write10);
+    printf("%-3s  %5u  %6.2f  %6.2f  %6.2f  %6u  %6u  %6.1f\n", bus->name, (unsigned)chunk,
+           (double)FILE_BYTES * 1000.0 / (double)write_ns, (double)FILE_BYTES * 1000.0 / (double)read_ns,
+           (double)FILE_BYTES * 1000.0 / (double)copy_ns, (unsigned)(after.read10 - before.read10),
+           (unsigned)(after.write10 - before.write10),
+           commands ? (double)(after.bytes - before.bytes) / SECTOR_SIZE / commands : 0.0);
+}
+
+int main(void)
+{
+    if((0 != image_disk_open(STICK_LUN, NULL, STICK_SECTORS, &model_stick)) || \
+       (0U != FATFS_LinkDriver(&USBH_MSC_Driver, path))) {
+        return 1;
+    }
+
+    printf("USBH_MSC_FATFS_MAX_SECTORS %u, read-ahead window of %u sectors, write buffer of %u sectors\n\n",
+           (unsigned)USBH_MSC_FATFS_MAX_SECTORS, (unsigned)USBH_MSC_FATFS_READ_SECTORS,
+           (unsigned)USBH_MSC_FATFS_WRITE_SECTORS);
+
+    check_buffers();
+    check_rejects();
+    check_replug();
+
+    printf("\nbus  chunk   write    read    copy  READ10 WRITE10  blocks   (MB/s, commands and blocks per command of the copy)\n");
+    bench_run(&bus_hs, 512U);
+    bench_run(&bus_hs, 4096U);
+    bench_run(&bus_hs, 32768U);
+    bench_run(&bus_fs, 512U);
+    bench_run(&bus_fs, 4096U);
+    bench_run(&bus_fs, 32768U);
+
+    image_disk_close(STICK_LUN);
+
+    failures += usbh_sim_errors();
+    if(failures) {
+        printf("\n%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,733 @@
+/*!
+    \file    usbh_sim.c
+    \brief   stand-in for the USB host core transfer functions with a Bulk-Only Transport
+             stick on the other end, for running the host MSC class driver on the host
+
+    usbh_data_send() and usbh_data_recev() carry out a URB at once: they advance the time by
+    the cost of the URB and its packet on the bus, hand the packet to the stick and leave the
+    URB state and the transfer count for usbh_urbstate_get() and usbh_xfercount_get(). The
+    stick decodes the CBWs of the class driver and answers them from an image disk, whose
+    device model gives the time the flash takes. READ(10) and WRITE(10) longer than
+    max_blocks fail with ILLEGAL REQUEST, the stick stalls the data IN phase or takes and
+    drops the OUT data, like sticks with a limit on the transfer length.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "usbh_sim.h"
+#include "usbh_pipe.h"
+#include "usbh_transc.h"
+#include "usbh_enum.h"
+#include "usbh_msc_core.h"
+#include "image_disk.h"
+
+#define USBH_SIM_BLOCK_SIZE             512U
+#define USBH_SIM_EP_IN                  0x81U
+#define USBH_SIM_EP_OUT                 0x01U
+/* pipes 0 and 1 are the control pipes */
+#define USBH_SIM_FIRST_PIPE             2U
+/* SETUP, data and status stage of a control transfer */
+#define USBH_SIM_CONTROL_URBS           3U
+/* class state machine steps until the logical units are set up */
+#define USBH_SIM_ATTACH_STEPS           1000U
+
+/* phase of the BOT the stick is in */
+typedef enum {
+    SIM_CBW = 0,                                        /*!< waiting for a CBW */
+    SIM_DATA_IN,                                        /*!< sending the data of a command */
+    SIM_DATA_OUT,                                       /*!< receiving the data of a command */
+    SIM_CSW                                             /*!< sending the CSW */
+} usbh_sim_phase_enum;
+
+static const usbh_sim_bus_struct *sim_bus;
+static usbh_host *sim_host;
+static uint8_t sim_image;
+static DWORD sim_blocks;
+static uint8_t sim_next_pipe;
+static uint64_t sim_now;
+static usbh_sim_stats_struct sim_stats;
+static int sim_errors;
+
+/* state of the stick */
+static usbh_sim_phase_enum sim_phase;
+static uint8_t sim_stalled;                             /* the IN endpoint is halted */
+static uint32_t sim_tag;
+static uint32_t sim_expected;                           /* dCBWDataTransferLength */
+static uint8_t *sim_data;
+static uint32_t sim_data_size;
+static uint32_t sim_data_len;                           /* bytes of the data phase the stick has or takes */
+static uint32_t sim_data_done;
+static uint8_t sim_status;
+static uint8_t sim_discard;                             /* the OUT data of a failed command is dropped */
+static uint8_t sim_write_pending;
+static DWORD sim_write_block;
+static UINT sim_write_blocks;
+static uint8_t sim_sense_key;
+static uint8_t sim_sense_asc;
+
+static int usbh_sim_user_app(void);
+static void usbh_sim_not_supported(void);
+
+static usbh_user_cb sim_user_cb = {
+    .dev_user_app = usbh_sim_user_app,
+    .dev_not_supported = usbh_sim_not_supported
+};
+
+/*!
+    \brief      application of the user callbacks, FatFs runs from the bench instead
+    \param[in]  none
+    \param[out] none
+    \retval     0
+*/
+static int usbh_sim_user_app(void)
+{
+    return 0;
+}
+
+/*!
+    \brief      the class driver did not find its interface
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_not_supported(void)
+{
+    sim_errors++;
+}
+
+/*!
+    \brief      advance the time, the timer of the host counts milliseconds as the SOFs do
+    \param[in]  ns: time in ns
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_time(uint64_t ns)
+{
+    sim_now += ns;
+    sim_host->control.timer = (uint32_t)(sim_now / 1000000U);
+}
+
+/*!
+    \brief      account a URB and its packet on the bus
+    \param[in]  len: bytes of the packet
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_urb(uint32_t len)
+{
+    sim_stats.urbs++;
+    usbh_sim_time(sim_bus->urb_ns + (uint64_t)len * 1000U / sim_bus->bytes_per_us);
+}
+
+/*!
+    \brief      read a big endian 32-bit field of a CDB
+    \param[in]  p: first byte
+    \param[out] none
+    \retval     value
+*/
+static uint32_t usbh_sim_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*!
+    \brief      read a little endian 32-bit field of a CBW
+    \param[in]  p: first byte
+    \param[out] none
+    \retval     value
+*/
+static uint32_t usbh_sim_le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+/*!
+    \brief      make room for the data phase of a command
+    \param[in]  len: bytes of the data phase
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_data_alloc(uint32_t len)
+{
+    if(len > sim_data_size) {
+        sim_data = realloc(sim_data, len);
+        sim_data_size = len;
+    }
+}
+
+/*!
+    \brief      let the flash of the stick move blocks, the device model gives the time
+    \param[in]  write: 1 to program, 0 to read
+    \param[in]  block: first block
+    \param[in]  blocks: number of blocks
+    \param[out] none
+    \retval     0 on success
+*/
+static int usbh_sim_media(uint8_t write, DWORD block, UINT blocks)
+{
+    image_disk_stats_struct before, after;
+    DRESULT res;
+    uint64_t ns;
+
+    image_disk_stats_get(sim_image, &before);
+    if(write) {
+        res = image_disk_driver.disk_write(sim_image, sim_data, block, blocks);
+    } else {
+        res = image_disk_driver.disk_read(sim_image, sim_data, block, blocks);
+    }
+    image_disk_stats_get(sim_image, &after);
+
+    ns = (after.busy_us - before.busy_us) * 1000U;
+    sim_stats.media_ns += ns;
+    usbh_sim_time(ns);
+
+    return (RES_OK == res) ? 0 : -1;
+}
+
+/*!
+    \brief      fail the command with sense data
+    \param[in]  key: sense key
+    \param[in]  asc: additional sense code
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_fail(uint8_t key, uint8_t asc)
+{
+    sim_status = CSW_CMD_FAILED;
+    sim_sense_key = key;
+    sim_sense_asc = asc;
+    sim_data_len = 0U;
+}
+
+/*!
+    \brief      decode a READ(10) or WRITE(10) and get the data of a read from the flash
+    \param[in]  cb: command block
+    \param[in]  write: 1 for WRITE(10)
+    \param[out] none
+    \retval     none
+*/
+static void usbh_sim_rw10(const uint8_t *cb, uint8_t write)
+{
+    DWORD block = usbh_sim_be32(&cb[2]);
+    UINT blocks = ((UINT)cb[7] << 8) | cb[8];
+
+    if(write) {
+        sim_stats.write10++;
+    } else {
+        sim_stats.read10++;
+    }
+
+    if((block >= sim_blocks) || (blocks > sim_blocks - block)) {
+        usbh_sim_fail(ILLEGAL_REQUEST, ADDRESS_OUT_OF_RANGE);
+    } else if((0U != sim_bus->max_blocks) && (blocks > sim_bus->max_blocks)) {
+        sim_stats.rejects++;
+        usbh_sim_fail(ILLEGAL_REQUEST, INVALID_FIELD_IN_COMMAND);
+    } else {
+        sim_data_len = blocks * USBH_SIM_BLOCK_SIZE;
+        usbh_sim_data_alloc(sim_data_len);
+        if(write) {
+            sim_write_pending = 1U;
+            sim_write_block = block;
+            sim_write_blocks = blocks;
+        } else if(0 != usbh_sim_media(0U, block, blocks)) {
+            usbh_sim_fail(MEDIUM_ERROR, UNRECOVERED_READ_ERROR);
+        }
+    }
+}
+
+/*!
+    \brief      decode a CBW and set up the data phase
+    \param[in]  buf: the packet of the CBW
+    \param[in]  len: bytes of the packet
+    \param[out] none
+    \retval     URB state of the packet
+*/
+static usb_urb_state usbh_sim_cbw(const uint8_t *buf, uint16_t len)
+{
+    const uint8_t *cb = &buf[15];
+    uint8_t data_in = buf[12] & 0x80U;
+    uint8_t *p;
+
+    if((BBB_CBW_LENGTH != len) || (BBB_CBW_SIGNATURE != usbh_sim_le32(buf))) {
+        sim_errors++;
+        return URB_STALL;
+    }
+
+    sim_stats.commands++;
+    usbh_sim_time(sim_bus->command_ns);
+
+    sim_tag = usbh_sim_le32(&buf[4]);
+    sim_expected = usbh_sim_le32(&buf[8]);
+    sim_status = CSW_CMD_PASSED;
+    sim_data_len = 0U;
+    sim_data_done = 0U;
+    sim_discard = 0U;
+    sim_write_pending = 0U;
+
+    switch(cb[0]) {
+    case SCSI_TEST_UNIT_READY:
+        break;
+
+    case SCSI_INQUIRY:
+        sim_data_len = STANDARD_INQUIRY_DATA_LEN;
+        usbh_sim_data_alloc(sim_data_len);
+        memset(sim_data, 0, sim_data_len);
+        sim_data[1] = 0x80U;
+        sim_data[2] = 0x02U;
+        sim_data[3] = 0x02U;
+        sim_data[4] = STANDARD_INQUIRY_DATA_LEN - 5U;
+        memcpy(&sim_data[8], "GD32    USBH SIM STICK  1.0 ", 28U);
+        break;
+
+    case SCSI_READ_CAPACITY10:
+        sim_data_len = READ_CAPACITY10_DATA_LEN;
+        usbh_sim_data_alloc(sim_data_len);
+        p = sim_data;
+        p[0] = (uint8_t)((sim_blocks - 1U) >> 24);
+        p[1] = (uint8_t)((sim_blocks - 1U) >> 16);
+        p[2] = (uint8_t)((sim_blocks - 1U) >> 8);
+        p[3] = (uint8_t)(sim_blocks - 1U);
+        p[4] = 0U;
+        p[5] = 0U;
+        p[6] = (uint8_t)(USBH_SIM_BLOCK_SIZE >> 8);
+        p[7] = (uint8_t)USBH_SIM_BLOCK_SIZE;
+        break;
+
+    case SCSI_REQUEST_SENSE:
+        sim_data_len = REQUEST_SENSE_DATA_LEN;
+        usbh_sim_data_alloc(sim_data_len);
+        memset(sim_data, 0, sim_data_len);
+        sim_data[0] = 0x70U;
+        sim_data[2] = sim_sense_key;
+        sim_data[7] = REQUEST_SENSE_DATA_LEN - 8U;
+        sim_data[12] = sim_sense_asc;
+        sim_sense_key = NO_SENSE;
+        sim_sense_asc = 0U;
+        break;
+
+    case SCSI_MODE_SENSE6:
+        sim_data_len = MODE_SENSE6_DATA_LEN;
+        usbh_sim_data_alloc(sim_data_len);
+        memset(sim_data, 0, sim_data_len);
+        sim_data[0] = MODE_SENSE6_DATA_LEN - 1U;
+        break;
+
+    case SCSI_READ10:
+        usbh_sim_rw10(cb, 0U);
+        break;
+
+    case SCSI_WRITE10:
+        usbh_sim_rw10(cb, 1U);
+        break;
+
+    default:
+        usbh_sim_fail(ILLEGAL_REQUEST, INVALID_CDB);
+        break;
+    }
+
+    if(sim_data_len > sim_expected) {
+        sim_data_len = sim_expected;
+    }
+
+    if(0U == sim_expected) {
+        sim_phase = SIM_CSW;
+    } else if(data_in) {
+        /* a failed command has no data, the host learns it from the stalled data phase */
+        if(CSW_CMD_FAILED == sim_status) {
+            sim_stalled = 1U;
+            sim_phase = SIM_CSW;
+        } else {
+            sim_phase = SIM_DATA_IN;
+        }
+    } else {
+        sim_discard = (CSW_CMD_FAILED == sim_status);
+        sim_data_len = sim_expected;
+        sim_phase = SIM_DATA_OUT;
+    }
+
+    return URB_DONE;
+}
+
+/*!
+    \brief      the host sends a packet on the bulk OUT endpoint
+    \param[in]  buf: data of the packet
+    \param[in]  len: bytes of the packet
+    \param[out] none
+    \retval     URB state of the packet
+*/
+static usb_urb_state usbh_sim_out(const uint8_t *buf, uint16_t len)
+{
+    if(SIM_CBW == sim_phase) {
+        return usbh_sim_cbw(buf, len);
+    }
+
+    if((SIM_DATA_OUT != sim_phase) || (len > sim_data_len - sim_data_done)) {
+        sim_errors++;
+        return URB_STALL;
+    }
+
+    sim_stats.bytes += len;
+    if(!sim_discard) {
+        memcpy(&sim_data[sim_data_done], buf, len);
+    }
+    sim_data_done += len;
+
+    if(sim_data_done == sim_data_len) {
+        if(sim_write_pending && (0 != usbh_sim_media(1U, sim_write_block, sim_write_blocks))) {
+            usbh_sim_fail(MEDIUM_ERROR, WRITE_FAULT);
+        }
+        sim_write_pending = 0U;
+        sim_phase = SIM_CSW;
+    }
+
+    return URB_DONE;
+}
+
+/*!
+    \brief      the host polls the bulk IN endpoint
+    \param[in]  buf: buffer of the packet
+    \param[in]  len: bytes the host takes
+    \param[out] count: bytes of the packet
+    \retval     URB state of the packet
+*/
+static usb_urb_state usbh_sim_in(uint8_t *buf, uint16_t len, uint32_t *count)
+{
+    uint32_t n;
+
+    *count = 0U;
+
+    if(sim_stalled) {
+        return URB_STALL;
+    }
+
+    if(SIM_DATA_IN == sim_phase) {
+        n = sim_data_len - sim_data_done;
+        if(n > len) {
+            n = len;
+        }
+        memcpy(buf, &sim_data[sim_data_done], n);
+        sim_data_done += n;
+        sim_stats.bytes += n;
+        *count = n;
+        /* a short packet ends the data phase */
+        if((sim_data_done == sim_data_len) || (n < len)) {
+            sim_phase = SIM_CSW;
+        }
+        return URB_DONE;
+    }
+
+    if((SIM_CSW == sim_phase) && (len >= BBB_CSW_LENGTH)) {
+        /* the data of a failed command does not count */
+        uint32_t residue = (CSW_CMD_FAILED == sim_status) ? sim_expected : (sim_expected - sim_data_done);
+        uint32_t fields[3] = {BBB_CSW_SIGNATURE, sim_tag, residue};
+
+        memcpy(buf, fields, sizeof(fields));
+        buf[12] = sim_status;
+        *count = BBB_CSW_LENGTH;
+        sim_phase = SIM_CBW;
+        return URB_DONE;
+    }
+
+    sim_errors++;
+    return URB_STALL;
+}
+
+/*!
+    \brief      send data on a pipe, the URB finishes at once
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  buf: data buffer
+    \param[in]  pp_num: pipe number
+    \param[in]  len: data length
+    \param[out] none
+    \retval     USBH_OK
+*/
+usbh_status usbh_data_send(usb_core_driver *udev, uint8_t *buf, uint8_t pp_num, uint16_t len)
+{
+    usbh_sim_urb(len);
+    udev->host.pipe[pp_num].urb_state = usbh_sim_out(buf, len);
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      receive data on a pipe, the URB finishes at once
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  buf: data buffer
+    \param[in]  pp_num: pipe number
+    \param[in]  len: data length
+    \param[out] none
+    \retval     USBH_OK
+*/
+usbh_status usbh_data_recev(usb_core_driver *udev, uint8_t *buf, uint8_t pp_num, uint16_t len)
+{
+    uint32_t count;
+
+    udev->host.pipe[pp_num].urb_state = usbh_sim_in(buf, len, &count);
+    udev->host.backup_xfercount[pp_num] = count;
+    usbh_sim_urb(count);
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      prepare a control transfer
+    \param[in]  uhost: pointer to USB host
+    \param[in]  buf: data buffer of the transfer
+    \param[in]  len: data length
+    \param[out] none
+    \retval     none
+*/
+void usbh_ctlstate_config(usbh_host *uhost, uint8_t *buf, uint16_t len)
+{
+    uhost->control.buf = buf;
+    uhost->control.ctl_len = len;
+    uhost->control.ctl_state = CTL_SETUP;
+}
+
+/*!
+    \brief      carry out the control transfer of the class driver, GET MAX LUN or the BOT reset
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     USBH_OK
+*/
+usbh_status usbh_ctl_handler(usbh_host *uhost)
+{
+    uint32_t i;
+
+    for(i = 0U; i < USBH_SIM_CONTROL_URBS; i++) {
+        usbh_sim_urb((1U == i) ? uhost->control.ctl_len : 0U);
+    }
+
+    if(BBB_GET_MAX_LUN == uhost->control.setup.req.bRequest) {
+        uhost->control.buf[0] = 0U;
+    } else if(BBB_RESET == uhost->control.setup.req.bRequest) {
+        sim_phase = SIM_CBW;
+        sim_stalled = 0U;
+    } else {
+        sim_errors++;
+    }
+    uhost->control.ctl_state = CTL_IDLE;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      clear the halt of an endpoint of the stick
+    \param[in]  uhost: pointer to USB host
+    \param[in]  ep_addr: endpoint address
+    \param[in]  pp_num: pipe number
+    \param[out] none
+    \retval     USBH_OK
+*/
+usbh_status usbh_clrfeature(usbh_host *uhost, uint8_t ep_addr, uint8_t pp_num)
+{
+    uint32_t i;
+
+    for(i = 0U; i < USBH_SIM_CONTROL_URBS; i++) {
+        usbh_sim_urb(0U);
+    }
+    if(USBH_SIM_EP_IN == ep_addr) {
+        sim_stalled = 0U;
+    }
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      find the interface of the stick, the only one
+    \param[in]  udev: pointer to USB device property
+    \param[in]  main_class: class code
+    \param[in]  sub_class: subclass code
+    \param[in]  protocol: protocol code
+    \param[out] none
+    \retval     interface index
+*/
+uint8_t usbh_interface_find(usb_dev_prop *udev, uint8_t main_class, uint8_t sub_class, uint8_t protocol)
+{
+    return ((MSC_CLASS == main_class) && (MSC_PROTOCOL == protocol)) ? 0U : 0xFFU;
+}
+
+/*!
+    \brief      select an interface
+    \param[in]  udev: pointer to USB device property
+    \param[in]  interface: interface index
+    \param[out] none
+    \retval     USBH_OK
+*/
+usbh_status usbh_interface_select(usb_dev_prop *udev, uint8_t interface)
+{
+    udev->cur_itf = interface;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      allocate a pipe for an endpoint
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  ep_addr: endpoint address
+    \param[out] none
+    \retval     pipe number
+*/
+uint8_t usbh_pipe_allocate(usb_core_driver *udev, uint8_t ep_addr)
+{
+    uint8_t pp_num = sim_next_pipe++;
+
+    udev->host.pipe[pp_num].in_used = 1U;
+    udev->host.pipe[pp_num].ep.num = ep_addr & 0x7FU;
+    udev->host.pipe[pp_num].ep.dir = (ep_addr & 0x80U) ? 1U : 0U;
+
+    return pp_num;
+}
+
+/*!
+    \brief      create a pipe
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  dev: USB device property
+    \param[in]  pp_num: pipe number
+    \param[in]  ep_type: endpoint type
+    \param[in]  ep_mpl: max packet length
+    \param[out] none
+    \retval     USBH_OK
+*/
+uint8_t usbh_pipe_create(usb_core_driver *udev, usb_dev_prop *dev, uint8_t pp_num, uint8_t ep_type, uint16_t ep_mpl)
+{
+    udev->host.pipe[pp_num].ep.type = ep_type;
+    udev->host.pipe[pp_num].ep.mps = ep_mpl;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      free a pipe
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  pp_num: pipe number
+    \param[out] none
+    \retval     USBH_OK
+*/
+uint8_t usbh_pipe_free(usb_core_driver *udev, uint8_t pp_num)
+{
+    udev->host.pipe[pp_num].in_used = 0U;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      halt a pipe
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  pipe_num: pipe number
+    \param[out] none
+    \retval     USB_OK
+*/
+usb_status usb_pipe_halt(usb_core_driver *udev, uint8_t pipe_num)
+{
+    return USB_OK;
+}
+
+/*!
+    \brief      attach the stick, the sectors of an image disk, and run the MSC class up to
+                MSC_IDLE
+    \param[in]  uhost: USB host of the class driver
+    \param[in]  udev: USB core of the host
+    \param[in]  bus: timing of the bus and the stick
+    \param[in]  image_lun: image disk with the sectors of the stick
+    \param[out] none
+    \retval     0 on success
+*/
+int usbh_sim_attach(usbh_host *uhost, usb_core_driver *udev, const usbh_sim_bus_struct *bus, uint8_t image_lun)
+{
+    usb_desc_ep *ep;
+    int errors = sim_errors;
+    uint32_t i;
+
+    memset(uhost, 0, sizeof(usbh_host));
+    memset(udev, 0, sizeof(usb_core_driver));
+    memset(&sim_stats, 0, sizeof(sim_stats));
+
+    sim_bus = bus;
+    sim_host = uhost;
+    sim_image = image_lun;
+    sim_next_pipe = USBH_SIM_FIRST_PIPE;
+    sim_now = 0U;
+    sim_phase = SIM_CBW;
+    sim_stalled = 0U;
+    sim_sense_key = NO_SENSE;
+    sim_sense_asc = 0U;
+    if(RES_OK != image_disk_driver.disk_ioctl(image_lun, GET_SECTOR_COUNT, &sim_blocks)) {
+        return -1;
+    }
+
+    uhost->data = udev;
+    uhost->usr_cb = &sim_user_cb;
+    uhost->uclass[0] = &usbh_msc;
+    uhost->class_num = 1U;
+    uhost->active_class = &usbh_msc;
+
+    ep = uhost->dev_prop.cfg_desc_set.itf_desc_set[0][0].ep_desc;
+    ep[0].bEndpointAddress = USBH_SIM_EP_IN;
+    ep[0].bmAttributes = USB_EPTYPE_BULK;
+    ep[0].wMaxPacketSize = bus->packet;
+    ep[1].bEndpointAddress = USBH_SIM_EP_OUT;
+    ep[1].bmAttributes = USB_EPTYPE_BULK;
+    ep[1].wMaxPacketSize = bus->packet;
+
+    udev->host.connect_status = 1U;
+    udev->host.port_enabled = 1U;
+
+    uhost->cur_state = HOST_CLASS_ENUM;
+    if(USBH_OK != usbh_msc.class_init(uhost)) {
+        return -1;
+    }
+    for(i = 0U; (i < USBH_SIM_ATTACH_STEPS) && (USBH_OK != usbh_msc.class_requests(uhost)); i++) {
+    }
+
+    uhost->cur_state = HOST_CLASS_HANDLER;
+    for(i = 0U; (i < USBH_SIM_ATTACH_STEPS) && (USBH_OK != usbh_msc.class_machine(uhost)); i++) {
+    }
+
+    return ((i < USBH_SIM_ATTACH_STEPS) && (errors == sim_errors)) ? 0 : -1;
+}
+
+/*!
+    \brief      current time
+    \param[in]  none
+    \param[out] none
+    \retval     time in ns since usbh_sim_attach()
+*/
+uint64_t usbh_sim_now(void)
+{
+    return sim_now;
+}
+
+/*!
+    \brief      the CPU is busy outside of the USB transfers
+    \param[in]  ns: time in ns
+    \param[out] none
+    \retval     none
+*/
+void usbh_sim_cpu(uint64_t ns)
+{
+    usbh_sim_time(ns);
+}
+
+/*!
+    \brief      read the statistics since usbh_sim_attach()
+    \param[in]  none
+    \param[out] stats: commands and bus time
+    \retval     none
+*/
+void usbh_sim_stats_get(usbh_sim_stats_struct *stats)
+{
+    memcpy(stats, &sim_stats, sizeof(usbh_sim_stats_struct));
+}
+
+/*!
+    \brief      BOT errors of all attached sticks
+    \param[in]  none
+    \param[out] none
+    \retval     commands the stick could not decode or transfers against the protocol
+*/
+int usbh_sim_errors(void)
+{
+    return sim_errors;
+}
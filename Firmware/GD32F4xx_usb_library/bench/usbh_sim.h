@@ -0,0 +1,53 @@
+/*!
+    \file    usbh_sim.h
+    \brief   stand-in for the USB host core transfer functions with a Bulk-Only Transport
+             stick on the other end, for running the host MSC class driver on the host
+*/
+
+#ifndef USBH_SIM_H
+#define USBH_SIM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "usbh_core.h"
+
+/* timing of the bus, the host core and the controller of the stick */
+typedef struct {
+    const char *name;
+    uint16_t packet;                                    /*!< max packet size of the bulk endpoints */
+    uint32_t bytes_per_us;                              /*!< payload rate of the bus */
+    uint32_t urb_ns;                                    /*!< host cost of a URB: start, interrupt and the class state machine */
+    uint32_t command_ns;                                /*!< the stick decodes a CBW */
+    uint32_t max_blocks;                                /*!< longest READ(10) and WRITE(10) the stick takes, 0 for any */
+} usbh_sim_bus_struct;
+
+/* commands and bus time of a run */
+typedef struct {
+    uint32_t commands;                                  /*!< CBWs */
+    uint32_t read10;                                    /*!< READ(10) commands */
+    uint32_t write10;                                   /*!< WRITE(10) commands */
+    uint32_t rejects;                                   /*!< commands failed as too long */
+    uint32_t urbs;                                      /*!< URBs of all three phases */
+    uint64_t bytes;                                     /*!< bytes of the data phases */
+    uint64_t media_ns;                                  /*!< time the stick spent on its flash */
+} usbh_sim_stats_struct;
+
+/* function declarations */
+/* attach the stick, the sectors of an image disk, and run the MSC class up to MSC_IDLE */
+int usbh_sim_attach(usbh_host *uhost, usb_core_driver *udev, const usbh_sim_bus_struct *bus, uint8_t image_lun);
+/* current time in ns */
+uint64_t usbh_sim_now(void);
+/* the CPU is busy outside of the USB transfers */
+void usbh_sim_cpu(uint64_t ns);
+/* read the statistics since usbh_sim_attach() */
+void usbh_sim_stats_get(usbh_sim_stats_struct *stats);
+/* BOT errors of all attached sticks, commands the stick could not decode or transfers against the protocol */
+int usbh_sim_errors(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USBH_SIM_H */
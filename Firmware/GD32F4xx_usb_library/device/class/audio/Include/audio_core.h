@@ -41,12 +41,33 @@ OF SUCH DAMAGE.
 
 /* number of sub-packets in the audio transfer buffer. you can modify this value but always make sure
    that it is an even number and higher than 3 */
-#define OUT_PACKET_NUM                            200U
+#ifndef OUT_PACKET_NUM
+#define OUT_PACKET_NUM                            16U
+#endif /* OUT_PACKET_NUM */
+
+/* playback starts with this many packets in the buffer and the feedback holds the buffer at this
+   depth, which is the playback latency in frames */
+#ifndef OUT_TARGET_PACKETS
+#define OUT_TARGET_PACKETS                        4U
+#endif /* OUT_TARGET_PACKETS */
+
+/* SOF frames of one measurement of the I2S rate, a power of two */
+#ifndef FEEDBACK_RATE_FRAMES
+#define FEEDBACK_RATE_FRAMES                      128U
+#endif /* FEEDBACK_RATE_FRAMES */
+
+/* frames the feedback takes to correct a deviation of the buffer from its target depth */
+#ifndef FEEDBACK_DEPTH_FRAMES
+#define FEEDBACK_DEPTH_FRAMES                     128U
+#endif /* FEEDBACK_DEPTH_FRAMES */
 
 /* total size of the audio transfer buffer */
 #define OUT_BUF_MARGIN                            0U
 #define TOTAL_OUT_BUF_SIZE                        ((uint32_t)((SPEAKER_OUT_PACKET + OUT_BUF_MARGIN) * OUT_PACKET_NUM))
 
+/* bytes of one sample of all channels of the speaker */
+#define SPEAKER_OUT_FRAME_SIZE                    ((SPEAKER_OUT_BIT_RESOLUTION / 8U) * SPEAKER_OUT_CHANNEL_NBR)
+
 /* audio configuration descriptor length and interface descriptor size */
 #define AD_CONFIG_DESC_SET_LEN                    (sizeof(usb_desc_config_set))
 #define AD_INTERFACE_DESC_SIZE                    9U
@@ -287,24 +308,44 @@ typedef struct {
 #endif /* USE_USB_AD_SPEAKER */
 } usb_desc_config_set;
 
+/* speaker buffer and rate statistics */
+typedef struct {
+    uint32_t underruns;                                         /*!< times the I2S DMA ran out of data */
+    uint32_t overruns;                                          /*!< OUT packets dropped on a full buffer */
+    uint32_t latency_us;                                        /*!< buffer depth at the last SOF */
+    uint32_t latency_min_us;                                    /*!< least depth at a SOF since playback started */
+    uint32_t latency_max_us;                                    /*!< largest depth at a SOF since playback started */
+    uint32_t rate;                                              /*!< estimated I2S rate, samples per frame in 10.14 */
+    uint32_t feedback;                                          /*!< feedback of the last SOF, samples per frame in 10.14 */
+} usbd_audio_spk_stats;
+
 typedef struct {
     /* main buffer for audio data OUT transfers and its relative pointers */
     uint8_t  isoc_out_buff[TOTAL_OUT_BUF_SIZE];                 /*!< audio isochronous OUT data buff */
     uint8_t* isoc_out_wrptr;                                    /*!< audio isochronous OUT data write pointer */
     uint8_t* isoc_out_rdptr;                                    /*!< audio isochronous OUT data read pointer */
-    uint16_t buf_free_size;                                     /*!< audio data buff free size */
     uint16_t dam_tx_len;                                        /*!< audio amplifier transmit length */
 
-    __IO uint32_t actual_freq;                                  /*!< audio actual frequency */
-    __IO uint8_t play_flag;                                     /*!< audio play flag */
-    uint8_t feedback_freq[3];                                   /*!< audio feedback frequency */
+    /* byte counts of the buffer, their difference is the depth */
+    __IO uint32_t written;                                      /*!< bytes received since the stream started */
+    __IO uint32_t played;                                       /*!< bytes of the finished DMA transfers */
+    uint32_t rate_frames;                                       /*!< SOF frames of the current rate measurement */
+    uint32_t rate_start;                                        /*!< play position at its start */
+    usbd_audio_spk_stats stats;                                 /*!< buffer and rate statistics */
+
+    __IO uint32_t actual_freq;                                  /*!< audio feedback rate, samples per frame in 10.14 */
     uint32_t cur_sam_freq;                                      /*!< audio current sampling frequency */
 
-    /* USB receive buffer */
-    uint8_t usb_rx_buffer[SPEAKER_OUT_MAX_PACKET];
+    /* the buffers the USB transfers use start on word boundaries for the internal DMA */
+    uint8_t feedback_freq[4];                                   /*!< audio feedback frequency */
 
     /* main buffer for audio control requests transfers and its relative variables */
     uint8_t  audioctl[64];                                      /*!< audio control requests transfers buff */
+
+    /* USB receive buffer, the DMA stores whole words */
+    uint8_t usb_rx_buffer[(SPEAKER_OUT_MAX_PACKET + 3U) & ~3U];
+
+    __IO uint8_t play_flag;                                     /*!< audio play flag */
     uint8_t  audioctl_unit;                                     /*!< audio control requests unit */
     uint32_t audioctl_len;                                      /*!< audio control requests length */
 } usbd_audio_handler;
@@ -313,4 +354,10 @@ extern usb_desc audio_desc;
 extern usb_class_core usbd_audio_cb;
 extern usbd_audio_handler audio_handler;
 
+/* function declarations */
+/* the I2S DMA finished a transfer, get the next part of the speaker buffer */
+uint32_t usbd_audio_spk_dma_done(uint8_t **pbuf);
+/* read the speaker buffer and rate statistics */
+void usbd_audio_spk_stats_get(usbd_audio_spk_stats *stats);
+
 #endif /* AUDIO_CORE_H */
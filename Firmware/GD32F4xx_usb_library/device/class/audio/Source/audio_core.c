@@ -65,6 +65,8 @@ static uint8_t audio_iso_in_incomplete(usb_dev *udev);
 static uint8_t audio_iso_out_incomplete(usb_dev *udev);
 static uint32_t usbd_audio_spk_get_feedback(usb_dev *udev);
 static void get_feedback_fs_rate(uint32_t rate, uint8_t *buf);
+static uint16_t audio_spk_chunk(void);
+static uint32_t audio_spk_position(void);
 
 usb_class_core usbd_audio_cb = {
     .init      = audio_init,
@@ -697,8 +699,12 @@ static uint8_t audio_set_intf(usb_dev *udev, usb_req *req)
             audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
             audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
 
+            /* the rate estimation starts from the nominal I2S rate */
+            audio_handler.stats.rate = (uint32_t)(((uint64_t)I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) << 14) / 1000U);
+            audio_handler.stats.feedback = audio_handler.stats.rate;
+
             /* feedback calculate sample frequency */
-            audio_handler.actual_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
+            audio_handler.actual_freq = audio_handler.stats.feedback;
             get_feedback_fs_rate(audio_handler.actual_freq, audio_handler.feedback_freq);
 
             /* send feedback data of estimated frequency */
@@ -710,6 +716,9 @@ static uint8_t audio_set_intf(usb_dev *udev, usb_req *req)
             audio_handler.play_flag = 0U;
             audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
             audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+            audio_handler.dam_tx_len = 0U;
+            audio_handler.written = 0U;
+            audio_handler.played = 0U;
 
             usbd_fifo_flush(udev, AD_IN_EP);
             usbd_fifo_flush(udev, AD_FEEDBACK_IN_EP);
@@ -798,43 +807,29 @@ static uint8_t audio_data_out(usb_dev *udev, uint8_t ep_num)
     /* get receive length */
     usb_rx_length = ((usb_core_driver *)udev)->dev.transc_out[ep_num].xfer_count;
 
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr) {
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    } else {
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }
-
     /* free buffer enough to save RX data */
-    if(audio_handler.buf_free_size > usb_rx_length) {
-        if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr) {
-            tail_len = audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE - audio_handler.isoc_out_wrptr;
-
-            if(tail_len >= usb_rx_length) {
-                memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, usb_rx_length);
-
-                /* increment the buffer pointer */
-                audio_handler.isoc_out_wrptr += usb_rx_length;
-
-                /* increment the Buffer pointer or roll it back when all buffers are full */
-                if(audio_handler.isoc_out_wrptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
-                    /* all buffers are full: roll back */
-                    audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
-                }
-            } else {
-                memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, tail_len);
-                /* adjust write pointer */
-                audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
-
-                memcpy(audio_handler.isoc_out_wrptr, &audio_handler.usb_rx_buffer[tail_len], usb_rx_length - tail_len);
-                /* adjust write pointer */
-                audio_handler.isoc_out_wrptr += usb_rx_length - tail_len;
-            }
-        } else {
+    if(TOTAL_OUT_BUF_SIZE - (audio_handler.written - audio_handler.played) >= usb_rx_length) {
+        tail_len = audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE - audio_handler.isoc_out_wrptr;
+
+        if(tail_len > usb_rx_length) {
             memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, usb_rx_length);
 
             /* increment the buffer pointer */
             audio_handler.isoc_out_wrptr += usb_rx_length;
+        } else {
+            memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, tail_len);
+            /* adjust write pointer */
+            audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+
+            memcpy(audio_handler.isoc_out_wrptr, &audio_handler.usb_rx_buffer[tail_len], usb_rx_length - tail_len);
+            /* adjust write pointer */
+            audio_handler.isoc_out_wrptr += usb_rx_length - tail_len;
         }
+
+        /* the DMA sees the data once it is counted */
+        audio_handler.written += usb_rx_length;
+    } else {
+        audio_handler.stats.overruns++;
     }
 
     /* toggle the frame index */
@@ -843,22 +838,22 @@ static uint8_t audio_data_out(usb_dev *udev, uint8_t ep_num)
     /* prepare OUT endpoint to receive next audio packet */
     usbd_ep_recev(udev, AD_OUT_EP, audio_handler.usb_rx_buffer, SPEAKER_OUT_MAX_PACKET);
 
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr) {
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    } else {
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }
-
-    if((0U == audio_handler.play_flag) && (audio_handler.buf_free_size < TOTAL_OUT_BUF_SIZE / 2U)) {
+    /* playback starts, and after an underrun restarts, at the target depth */
+    if((0U == audio_handler.play_flag) && \
+            (audio_handler.written - audio_handler.played >= OUT_TARGET_PACKETS * SPEAKER_OUT_PACKET)) {
         /* enable start of streaming */
         audio_handler.play_flag = 1U;
+        audio_handler.dam_tx_len = audio_spk_chunk();
+
+        /* the rate measurement and the latency range start over */
+        audio_handler.rate_frames = 0U;
+        audio_handler.stats.latency_min_us = 0xFFFFFFFFU;
+        audio_handler.stats.latency_max_us = 0U;
 
         /* initialize the audio output hardware layer */
-        if(USBD_OK != audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, SPEAKER_OUT_MAX_PACKET / 2U, AD_CMD_PLAY)) {
+        if(USBD_OK != audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, audio_handler.dam_tx_len / 2U, AD_CMD_PLAY)) {
             return USBD_FAIL;
         }
-
-        audio_handler.dam_tx_len = SPEAKER_OUT_MAX_PACKET;
     }
 
     return USBD_OK;
@@ -872,6 +867,50 @@ static uint8_t audio_data_out(usb_dev *udev, uint8_t ep_num)
 */
 static uint8_t audio_sof(usb_dev *udev)
 {
+#ifdef USE_USB_AD_SPEAKER
+    uint32_t position, depth, measured;
+    int32_t correction;
+    const int32_t max_correction = (int32_t)(((uint32_t)FEEDBACK_FREQ_OFFSET << 14) / 1000U);
+
+    if(0U == audio_handler.play_flag) {
+        return USBD_OK;
+    }
+
+    position = audio_spk_position();
+    depth = audio_handler.written - position;
+
+    /* samples the I2S DMA took in FEEDBACK_RATE_FRAMES frames give its rate against the SOF */
+    if((FEEDBACK_RATE_FRAMES + 1U) == ++audio_handler.rate_frames) {
+        measured = (uint32_t)(((uint64_t)(position - audio_handler.rate_start) << 14) / \
+                              (SPEAKER_OUT_FRAME_SIZE * FEEDBACK_RATE_FRAMES));
+
+        audio_handler.stats.rate = (uint32_t)((int32_t)audio_handler.stats.rate + \
+                                              ((int32_t)(measured - audio_handler.stats.rate) / 8));
+        audio_handler.rate_frames = 1U;
+    }
+    if(1U == audio_handler.rate_frames) {
+        audio_handler.rate_start = position;
+    }
+
+    /* the feedback is the rate, corrected to pull the depth back to the target */
+    correction = (((int32_t)(OUT_TARGET_PACKETS * SPEAKER_OUT_PACKET) - (int32_t)depth) * 16384) / \
+                 (int32_t)(SPEAKER_OUT_FRAME_SIZE * FEEDBACK_DEPTH_FRAMES);
+    if(correction > max_correction) {
+        correction = max_correction;
+    } else if(correction < -max_correction) {
+        correction = -max_correction;
+    }
+    audio_handler.stats.feedback = (uint32_t)((int32_t)audio_handler.stats.rate + correction);
+
+    audio_handler.stats.latency_us = depth * 1000U / (SPEAKER_OUT_FRAME_SIZE * USBD_SPEAKER_FREQ / 1000U);
+    if(audio_handler.stats.latency_us < audio_handler.stats.latency_min_us) {
+        audio_handler.stats.latency_min_us = audio_handler.stats.latency_us;
+    }
+    if(audio_handler.stats.latency_us > audio_handler.stats.latency_max_us) {
+        audio_handler.stats.latency_max_us = audio_handler.stats.latency_us;
+    }
+#endif /* USE_USB_AD_SPEAKER */
+
     return USBD_OK;
 }
 
@@ -909,43 +948,111 @@ static uint8_t audio_iso_out_incomplete(usb_dev *udev)
     \brief      calculate feedback sample frequency
     \param[in]  udev: pointer to USB device instance
     \param[out] none
-    \retval     feedback frequency value
+    \retval     feedback of the last SOF, samples per frame in 10.14
 */
 static uint32_t usbd_audio_spk_get_feedback(usb_dev *udev)
 {
-    static uint32_t fb_freq;
-
-    /* calculate buffer free size */
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr) {
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    } else {
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }
-
-    /* calculate feedback frequency */
-    if(audio_handler.buf_free_size <= (TOTAL_OUT_BUF_SIZE / 4U)) {
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) - FEEDBACK_FREQ_OFFSET;
-    } else if(audio_handler.buf_free_size >= (TOTAL_OUT_BUF_SIZE * 3U / 4U)) {
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) + FEEDBACK_FREQ_OFFSET;
-    } else {
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
-    }
-
-    return fb_freq;
+    return audio_handler.stats.feedback;
 }
 
 /*!
     \brief      get feedback value from rate in USB full speed
-    \param[in]  rate: sample frequency
+    \param[in]  rate: samples per frame in 10.14
     \param[in]  buf: pointer to result buffer
     \param[out] none
     \retval     none
 */
 static void get_feedback_fs_rate(uint32_t rate, uint8_t *buf)
 {
-    rate = ((rate / 1000U) << 14) | ((rate % 1000U) << 4);
+    buf[0] = (uint8_t)rate;
+    buf[1] = (uint8_t)(rate >> 8);
+    buf[2] = (uint8_t)(rate >> 16);
+}
 
-    buf[0] = rate;
-    buf[1] = rate >> 8;
-    buf[2] = rate >> 16;
+/*!
+    \brief      next part of the speaker buffer for the I2S DMA, at most one packet
+    \param[in]  none
+    \param[out] none
+    \retval     length in bytes, 0 if the buffer is empty
+*/
+static uint16_t audio_spk_chunk(void)
+{
+    uint32_t len = audio_handler.written - audio_handler.played;
+    uint32_t tail_len = (uint32_t)(audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE - audio_handler.isoc_out_rdptr);
+
+    if(len > tail_len) {
+        len = tail_len;
+    }
+    if(len > SPEAKER_OUT_PACKET) {
+        len = SPEAKER_OUT_PACKET;
+    }
+
+    return (uint16_t)(len - len % SPEAKER_OUT_FRAME_SIZE);
+}
+
+/*!
+    \brief      bytes the I2S DMA has played since the stream started
+    \param[in]  none
+    \param[out] none
+    \retval     play position
+*/
+static uint32_t audio_spk_position(void)
+{
+    uint32_t played, len, remaining;
+
+    /* the DMA interrupt preempts the USB interrupt, read again if it moved on meanwhile */
+    do {
+        played = audio_handler.played;
+        len = audio_handler.dam_tx_len;
+        remaining = (NULL != audio_out_fops.audio_remaining) ? audio_out_fops.audio_remaining() : len;
+    } while(played != audio_handler.played);
+
+    if(remaining > len) {
+        remaining = len;
+    }
+
+    return played + len - remaining;
+}
+
+/*!
+    \brief      the I2S DMA finished a transfer, get the next part of the speaker buffer
+    \param[in]  none
+    \param[out] pbuf: start of the next part
+    \retval     length of the next part in bytes, 0 if the buffer ran empty and playback stops
+*/
+uint32_t usbd_audio_spk_dma_done(uint8_t **pbuf)
+{
+    /* increment to the next sub-buffer */
+    audio_handler.isoc_out_rdptr += audio_handler.dam_tx_len;
+
+    if(audio_handler.isoc_out_rdptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
+        /* roll back to the start of buffer */
+        audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
+    }
+
+    audio_handler.played += audio_handler.dam_tx_len;
+
+    /* update the current DMA tx data length */
+    audio_handler.dam_tx_len = audio_spk_chunk();
+
+    if(0U == audio_handler.dam_tx_len) {
+        /* audio_data_out() restarts playback at the target depth */
+        audio_handler.play_flag = 0U;
+        audio_handler.stats.underruns++;
+    }
+
+    *pbuf = audio_handler.isoc_out_rdptr;
+
+    return audio_handler.dam_tx_len;
+}
+
+/*!
+    \brief      read the speaker buffer and rate statistics
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void usbd_audio_spk_stats_get(usbd_audio_spk_stats *stats)
+{
+    *stats = audio_handler.stats;
 }
@@ -44,9 +44,10 @@ static uint8_t audio_cmd(uint8_t *pbuf, uint32_t size, uint8_t cmd);
 static uint8_t audio_state = AD_STATE_INACTIVE;
 
 audio_fops_struct audio_out_fops = {
-    .audio_init   = init,
-    .audio_deinit = deinit,
-    .audio_cmd    = audio_cmd
+    .audio_init      = init,
+    .audio_deinit    = deinit,
+    .audio_cmd       = audio_cmd,
+    .audio_remaining = audio_play_remaining
 };
 
 /*!
@@ -40,14 +40,58 @@ OF SUCH DAMAGE.
 
 #define USB_CDC_RX_LEN      USB_CDC_DATA_PACKET_SIZE                         /*< CDC data packet size */
 
+/* streaming mode: longest transfer on the data endpoints, a multiple of USB_CDC_DATA_PACKET_SIZE */
+#ifndef USB_CDC_STREAM_XFER_SIZE
+#define USB_CDC_STREAM_XFER_SIZE            (8U * USB_CDC_DATA_PACKET_SIZE)
+#endif /* USB_CDC_STREAM_XFER_SIZE */
+
+/* streaming mode: size of the TX ring, a power of two and a multiple of USB_CDC_DATA_PACKET_SIZE */
+#ifndef USB_CDC_STREAM_TX_SIZE
+#define USB_CDC_STREAM_TX_SIZE              (2U * USB_CDC_STREAM_XFER_SIZE)
+#endif /* USB_CDC_STREAM_TX_SIZE */
+
+/* streaming mode: receive buffers of USB_CDC_STREAM_XFER_SIZE, a power of two, the application
+   drains one while the next OUT transfer goes into another */
+#ifndef USB_CDC_STREAM_RX_BUFS
+#define USB_CDC_STREAM_RX_BUFS              2U
+#endif /* USB_CDC_STREAM_RX_BUFS */
+
+/* streaming mode counters */
+typedef struct {
+    uint32_t tx_bytes;                                                       /*< bytes sent to the host */
+    uint32_t tx_transfers;                                                   /*< IN transfers with data */
+    uint32_t tx_zlps;                                                        /*< zero length packets that ended an IN transfer */
+    uint32_t rx_bytes;                                                       /*< bytes received from the host */
+    uint32_t rx_transfers;                                                   /*< OUT transfers with data */
+    uint32_t rx_full;                                                        /*< OUT transfers that waited for a free receive buffer */
+} usb_cdc_stream_stats;
+
 typedef struct {
     uint8_t data[USB_CDC_RX_LEN];                                            /*< CDC data transfer buff */
     uint8_t cmd[USB_CDC_CMD_PACKET_SIZE];                                    /*< CDC cmd packet buff */
 
+    uint8_t tx_ring[USB_CDC_STREAM_TX_SIZE];                                 /*< streaming mode TX ring */
+    uint8_t rx_buf[USB_CDC_STREAM_RX_BUFS][USB_CDC_STREAM_XFER_SIZE];        /*< streaming mode receive buffers */
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+    uint32_t tx_stage[USB_CDC_STREAM_XFER_SIZE / 4U];                        /*< streaming mode IN transfer that starts off a word boundary of the TX ring */
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
+
     uint8_t packet_sent;                                                     /*< CDC data packet start send flag */
     uint8_t packet_receive;                                                  /*< CDC data packet start receive flag */
     uint32_t receive_length;                                                 /*< CDC data receive length */
 
+    uint8_t stream;                                                          /*< streaming mode started */
+    __IO uint8_t tx_busy;                                                    /*< an IN transfer or its ZLP is in flight */
+    __IO uint8_t rx_armed;                                                   /*< the OUT endpoint is armed */
+    __IO uint32_t tx_head;                                                   /*< bytes written to the TX ring */
+    __IO uint32_t tx_tail;                                                   /*< bytes of the TX ring sent */
+    uint32_t tx_xfer;                                                        /*< length of the IN transfer in flight */
+    __IO uint32_t rx_head;                                                   /*< receive buffers filled */
+    __IO uint32_t rx_tail;                                                   /*< receive buffers drained */
+    uint32_t rx_pos;                                                         /*< bytes read from the buffer at rx_tail */
+    uint32_t rx_len[USB_CDC_STREAM_RX_BUFS];                                 /*< bytes in each receive buffer */
+    usb_cdc_stream_stats stats;                                              /*< streaming mode counters */
+
     acm_line line_coding;                                                    /*< CDC line coding structure */
 } usb_cdc_handler;
 
@@ -61,5 +105,17 @@ uint8_t cdc_acm_check_ready(usb_dev *udev);
 void cdc_acm_data_send(usb_dev *udev);
 /* receive CDC ACM data */
 void cdc_acm_data_receive(usb_dev *udev);
+/* start the streaming mode, no effect if it runs already */
+void cdc_acm_stream_start(usb_dev *udev);
+/* queue data for the host in the streaming mode */
+uint32_t cdc_acm_stream_write(usb_dev *udev, const uint8_t *data, uint32_t len);
+/* take data of the host in the streaming mode */
+uint32_t cdc_acm_stream_read(usb_dev *udev, uint8_t *data, uint32_t len);
+/* free space of the TX ring in the streaming mode */
+uint32_t cdc_acm_stream_tx_space(usb_dev *udev);
+/* received bytes not read yet in the streaming mode */
+uint32_t cdc_acm_stream_rx_count(usb_dev *udev);
+/* read the streaming mode counters */
+void cdc_acm_stream_stats_get(usb_dev *udev, usb_cdc_stream_stats *stats);
 
 #endif /* CDC_ACM_CORE_H */
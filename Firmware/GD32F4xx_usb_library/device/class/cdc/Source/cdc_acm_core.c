@@ -33,6 +33,7 @@ OF SUCH DAMAGE.
 */
 
 #include "cdc_acm_core.h"
+#include <string.h>
 
 #define USBD_VID                          0x28E9U
 #define USBD_PID                          0x018AU
@@ -254,6 +255,8 @@ static uint8_t cdc_acm_req(usb_dev *udev, usb_req *req);
 static uint8_t cdc_acm_ctlx_out(usb_dev *udev);
 static uint8_t cdc_acm_in(usb_dev *udev, uint8_t ep_num);
 static uint8_t cdc_acm_out(usb_dev *udev, uint8_t ep_num);
+static void cdc_acm_stream_tx_next(usb_dev *udev, usb_cdc_handler *cdc);
+static void cdc_acm_stream_rx_arm(usb_dev *udev, usb_cdc_handler *cdc);
 
 /* USB CDC device class callbacks structure */
 usb_class_core cdc_class = {
@@ -322,6 +325,164 @@ void cdc_acm_data_receive(usb_dev *udev)
     usbd_ep_recev(udev, CDC_DATA_OUT_EP, (uint8_t *)(cdc->data), USB_CDC_DATA_PACKET_SIZE);
 }
 
+/*!
+    \brief      start the streaming mode, no effect if it runs already
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+void cdc_acm_stream_start(usb_dev *udev)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+
+    if((NULL == cdc) || (0U != cdc->stream)) {
+        return;
+    }
+
+    cdc->stream = 1U;
+
+    /* the OUT endpoint stays armed from now on, the callbacks re-arm it */
+    cdc_acm_stream_rx_arm(udev, cdc);
+}
+
+/*!
+    \brief      queue data for the host in the streaming mode
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  data: data to send
+    \param[in]  len: length of the data
+    \param[out] none
+    \retval     bytes queued, less than len if the TX ring is full
+*/
+uint32_t cdc_acm_stream_write(usb_dev *udev, const uint8_t *data, uint32_t len)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+    uint32_t space, offset, part;
+
+    if((NULL == cdc) || (0U == cdc->stream)) {
+        return 0U;
+    }
+
+    space = USB_CDC_STREAM_TX_SIZE - (cdc->tx_head - cdc->tx_tail);
+    if(len > space) {
+        len = space;
+    }
+
+    offset = cdc->tx_head & (USB_CDC_STREAM_TX_SIZE - 1U);
+    part = USB_CDC_STREAM_TX_SIZE - offset;
+    if(part > len) {
+        part = len;
+    }
+    memcpy(&cdc->tx_ring[offset], data, part);
+    memcpy(cdc->tx_ring, &data[part], len - part);
+
+    /* publish the data only after it is in the ring */
+    cdc->tx_head += len;
+
+    /* with no IN transfer in flight no callback can start one, so start it here */
+    if(0U == cdc->tx_busy) {
+        cdc_acm_stream_tx_next(udev, cdc);
+    }
+
+    return len;
+}
+
+/*!
+    \brief      take data of the host in the streaming mode
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  len: size of the buffer
+    \param[out] data: buffer for the data
+    \retval     bytes read
+*/
+uint32_t cdc_acm_stream_read(usb_dev *udev, uint8_t *data, uint32_t len)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+    uint32_t count = 0U, index, part;
+
+    if((NULL == cdc) || (0U == cdc->stream)) {
+        return 0U;
+    }
+
+    while((count < len) && (cdc->rx_tail != cdc->rx_head)) {
+        index = cdc->rx_tail & (USB_CDC_STREAM_RX_BUFS - 1U);
+
+        part = cdc->rx_len[index] - cdc->rx_pos;
+        if(part > len - count) {
+            part = len - count;
+        }
+        memcpy(&data[count], &cdc->rx_buf[index][cdc->rx_pos], part);
+        count += part;
+        cdc->rx_pos += part;
+
+        if(cdc->rx_pos == cdc->rx_len[index]) {
+            cdc->rx_pos = 0U;
+            cdc->rx_tail++;
+
+            /* the OUT endpoint waited for this buffer */
+            if(0U == cdc->rx_armed) {
+                cdc_acm_stream_rx_arm(udev, cdc);
+            }
+        }
+    }
+
+    return count;
+}
+
+/*!
+    \brief      free space of the TX ring in the streaming mode
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     bytes cdc_acm_stream_write() takes at least
+*/
+uint32_t cdc_acm_stream_tx_space(usb_dev *udev)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+
+    if((NULL == cdc) || (0U == cdc->stream)) {
+        return 0U;
+    }
+
+    return USB_CDC_STREAM_TX_SIZE - (cdc->tx_head - cdc->tx_tail);
+}
+
+/*!
+    \brief      received bytes not read yet in the streaming mode
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     bytes cdc_acm_stream_read() returns at least
+*/
+uint32_t cdc_acm_stream_rx_count(usb_dev *udev)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+    uint32_t count = 0U, buf;
+
+    if((NULL == cdc) || (0U == cdc->stream)) {
+        return 0U;
+    }
+
+    for(buf = cdc->rx_tail; buf != cdc->rx_head; buf++) {
+        count += cdc->rx_len[buf & (USB_CDC_STREAM_RX_BUFS - 1U)];
+    }
+
+    return count - cdc->rx_pos;
+}
+
+/*!
+    \brief      read the streaming mode counters
+    \param[in]  udev: pointer to USB device instance
+    \param[out] stats: copy of the counters
+    \retval     none
+*/
+void cdc_acm_stream_stats_get(usb_dev *udev, usb_cdc_stream_stats *stats)
+{
+    usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+
+    if(NULL == cdc) {
+        memset(stats, 0, sizeof(*stats));
+    } else {
+        *stats = cdc->stats;
+    }
+}
+
 /*!
     \brief      initialize the CDC ACM device
     \param[in]  udev: pointer to USB device instance
@@ -347,6 +508,18 @@ static uint8_t cdc_acm_init(usb_dev *udev, uint8_t config_index)
     cdc_handler.packet_sent = 1U;
     cdc_handler.receive_length = 0U;
 
+    /* the streaming mode starts with cdc_acm_stream_start() of every new configuration */
+    cdc_handler.stream = 0U;
+    cdc_handler.tx_busy = 0U;
+    cdc_handler.rx_armed = 0U;
+    cdc_handler.tx_head = 0U;
+    cdc_handler.tx_tail = 0U;
+    cdc_handler.tx_xfer = 0U;
+    cdc_handler.rx_head = 0U;
+    cdc_handler.rx_tail = 0U;
+    cdc_handler.rx_pos = 0U;
+    memset(&cdc_handler.stats, 0, sizeof(cdc_handler.stats));
+
     cdc_handler.line_coding = (acm_line) {
         .dwDTERate   = 115200U,
         .bCharFormat = 0U,
@@ -493,7 +666,24 @@ static uint8_t cdc_acm_in(usb_dev *udev, uint8_t ep_num)
 
     usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
 
-    if((0U == transc->xfer_len % transc->max_len) && (0U != transc->xfer_len)) {
+    if(0U != cdc->stream) {
+        if(0U != cdc->tx_xfer) {
+            cdc->tx_tail += cdc->tx_xfer;
+            cdc->stats.tx_bytes += cdc->tx_xfer;
+            cdc->stats.tx_transfers++;
+
+            /* a transfer of whole packets ends only with a ZLP, unless more data follows at once */
+            if((0U == cdc->tx_xfer % transc->max_len) && (cdc->tx_head == cdc->tx_tail)) {
+                cdc->tx_xfer = 0U;
+                cdc->stats.tx_zlps++;
+                usbd_ep_send(udev, ep_num, NULL, 0U);
+
+                return USBD_OK;
+            }
+        }
+
+        cdc_acm_stream_tx_next(udev, cdc);
+    } else if((0U == transc->xfer_len % transc->max_len) && (0U != transc->xfer_len)) {
         usbd_ep_send(udev, ep_num, NULL, 0U);
     } else {
         cdc->packet_sent = 1U;
@@ -512,9 +702,101 @@ static uint8_t cdc_acm_in(usb_dev *udev, uint8_t ep_num)
 static uint8_t cdc_acm_out(usb_dev *udev, uint8_t ep_num)
 {
     usb_cdc_handler *cdc = (usb_cdc_handler *)udev->dev.class_data[CDC_COM_INTERFACE];
+    uint32_t count = ((usb_core_driver *)udev)->dev.transc_out[ep_num].xfer_count;
 
-    cdc->packet_receive = 1U;
-    cdc->receive_length = ((usb_core_driver *)udev)->dev.transc_out[ep_num].xfer_count;
+    if(0U != cdc->stream) {
+        cdc->rx_armed = 0U;
+
+        /* a ZLP leaves the buffer to the next transfer */
+        if(0U != count) {
+            cdc->rx_len[cdc->rx_head & (USB_CDC_STREAM_RX_BUFS - 1U)] = count;
+            cdc->rx_head++;
+            cdc->stats.rx_bytes += count;
+            cdc->stats.rx_transfers++;
+        }
+
+        cdc_acm_stream_rx_arm(udev, cdc);
+    } else {
+        cdc->packet_receive = 1U;
+        cdc->receive_length = count;
+    }
 
     return USBD_OK;
 }
+
+/*!
+    \brief      start the next IN transfer of the streaming mode from the TX ring
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  cdc: CDC handler
+    \param[out] none
+    \retval     none
+*/
+static void cdc_acm_stream_tx_next(usb_dev *udev, usb_cdc_handler *cdc)
+{
+    uint32_t queued = cdc->tx_head - cdc->tx_tail;
+    uint32_t offset = cdc->tx_tail & (USB_CDC_STREAM_TX_SIZE - 1U);
+    uint32_t len = USB_CDC_STREAM_TX_SIZE - offset;
+    uint8_t *buf = &cdc->tx_ring[offset];
+
+    if(0U == queued) {
+        cdc->tx_busy = 0U;
+        return;
+    }
+
+    if(len > queued) {
+        len = queued;
+    }
+    if(len > USB_CDC_STREAM_XFER_SIZE) {
+        len = USB_CDC_STREAM_XFER_SIZE;
+    }
+
+    /* a short packet in the middle of the data would end the read of the host early */
+    if((len < queued) && (len >= USB_CDC_DATA_PACKET_SIZE)) {
+        len -= len % USB_CDC_DATA_PACKET_SIZE;
+    }
+
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+    /* the DMA only reads from word addresses: after a transfer of an odd length the data goes
+       through the staging buffer, and ends on a word boundary so that the next transfer starts
+       from the ring again, at the cost of one short packet */
+    if(((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) && (0U != (offset & 3U))) {
+        uint32_t part;
+
+        len = USB_MIN(queued, USB_CDC_STREAM_XFER_SIZE);
+        if(len < queued) {
+            len -= (offset + len) & 3U;
+        }
+
+        part = USB_MIN(len, USB_CDC_STREAM_TX_SIZE - offset);
+        buf = (uint8_t *)cdc->tx_stage;
+        memcpy(buf, &cdc->tx_ring[offset], part);
+        memcpy(&buf[part], cdc->tx_ring, len - part);
+    }
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
+
+    cdc->tx_busy = 1U;
+    cdc->tx_xfer = len;
+
+    usbd_ep_send(udev, CDC_DATA_IN_EP, buf, len);
+}
+
+/*!
+    \brief      arm the OUT endpoint of the streaming mode with the next free receive buffer
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  cdc: CDC handler
+    \param[out] none
+    \retval     none
+*/
+static void cdc_acm_stream_rx_arm(usb_dev *udev, usb_cdc_handler *cdc)
+{
+    if(USB_CDC_STREAM_RX_BUFS == cdc->rx_head - cdc->rx_tail) {
+        /* the host gets NAKs until cdc_acm_stream_read() frees a buffer */
+        cdc->stats.rx_full++;
+        return;
+    }
+
+    cdc->rx_armed = 1U;
+
+    usbd_ep_recev(udev, CDC_DATA_OUT_EP, cdc->rx_buf[cdc->rx_head & (USB_CDC_STREAM_RX_BUFS - 1U)], \
+                  USB_CDC_STREAM_XFER_SIZE);
+}
@@ -73,6 +73,11 @@ OF SUCH DAMAGE.
 #define FLASH_ERASE_TIMEOUT           60U                       /*!< erase flash timeout */
 #define FLASH_WRITE_TIMEOUT           80U                       /*!< write flash timeout */
 
+/* download command waiting in the receive block */
+#define DFU_CMD_NONE                  0U                        /*!< no command */
+#define DFU_CMD_RECEIVED              1U                        /*!< acknowledged by GETSTATUS, runs after its status stage */
+#define DFU_CMD_WAIT                  2U                        /*!< waits for the memory to end the previous command */
+
 /* bit detach capable = bit 3 in bmAttributes field */
 #define DFU_DETACH_MASK               (uint8_t)(0x10U)
 
@@ -158,11 +163,15 @@ typedef struct {
     uint8_t iString;                     /*!< DFU device string */
 
     uint8_t manifest_state;              /*!< DFU device current manifest state */
+    uint8_t pending;                     /*!< download command in buf, DFU_CMD_NONE, DFU_CMD_RECEIVED or DFU_CMD_WAIT */
+    uint8_t mem_busy;                    /*!< the memory runs a command, until dfu_mem_done() */
+    uint8_t mem_cmd;                     /*!< CMD_ERASE or CMD_WRITE the memory runs */
     uint32_t data_len;                   /*!< DFU device data transfer length */
     uint16_t block_num;                  /*!< memory block number */
     uint32_t base_addr;                  /*!< memory base address */
 
-    uint8_t buf[TRANSFER_SIZE];          /*!< data transfer buff */
+    uint8_t *buf;                        /*!< data transfer buff, the block the host downloads to */
+    uint8_t block[2][TRANSFER_SIZE];     /*!< one block is received while the memory writes the other */
 } usbd_dfu_handler;
 
 typedef void (*app_func)(void);
@@ -58,6 +58,18 @@ typedef struct _dfu_mem_prop {
 
     const uint32_t erase_timeout; /*!< erase memory timeout */
     const uint32_t write_timeout; /*!< write memory timeout */
+
+    /* optional, start an erase or a write and return at once, the memory reports the end through
+       dfu_mem_done(); it takes one command while it is still busy with work of its own, such
+       as an erase ahead of the writes; mem_erase/mem_write are used for NULL */
+    uint8_t (*mem_erase_start)(uint32_t addr);
+    uint8_t (*mem_write_start)(uint8_t *buf, uint32_t addr, uint32_t len);
+    /* optional, wait until the memory has ended all its work, dfu_mem_done() is called from inside */
+    void (*mem_flush)(void);
+    /* optional, milliseconds until the memory has ended its work and then an erase of the sector
+       at addr (CMD_ERASE) or a write of len bytes (CMD_WRITE), a write of 0 bytes only counts
+       the work; the fixed timeouts above are used for NULL */
+    uint32_t (*mem_timeout)(uint32_t addr, uint8_t cmd, uint32_t len);
 } dfu_mem_prop;
 
 typedef enum {
@@ -77,6 +89,14 @@ uint8_t dfu_mem_write(uint8_t *buf, uint32_t addr, uint32_t len);
 /* read data from sectors of memory */
 uint8_t *dfu_mem_read(uint8_t *buf, uint32_t addr, uint32_t len);
 /* get the status of a given memory and store in buffer */
-uint8_t dfu_mem_getstatus(uint32_t addr, uint8_t cmd, uint8_t *buffer);
+uint8_t dfu_mem_getstatus(uint32_t addr, uint8_t cmd, uint32_t len, uint8_t *buffer);
+/* check whether the memory of an address takes commands in the background */
+uint8_t dfu_mem_pipelined(uint32_t addr);
+/* start an erase or a write, dfu_mem_done() reports the end */
+uint8_t dfu_mem_start(uint8_t cmd, uint8_t *buf, uint32_t addr, uint32_t len);
+/* wait until the memories have ended their work */
+void dfu_mem_flush(void);
+/* report the end of a command of dfu_mem_start(), at the priority of the USB interrupt */
+void dfu_mem_done(uint8_t status);
 
 #endif /* DFU_MEM_H */
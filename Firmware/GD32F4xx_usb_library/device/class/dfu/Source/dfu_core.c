@@ -48,6 +48,9 @@ static uint8_t dfu_ctlx_in(usb_dev *udev);
 
 static void dfu_mode_leave(usb_dev *udev);
 static uint8_t dfu_getstatus_complete(usb_dev *udev);
+static uint8_t dfu_cmd_decode(usbd_dfu_handler *dfu, uint8_t *cmd, uint32_t *addr);
+static uint8_t dfu_poll_set(usbd_dfu_handler *dfu);
+static void dfu_cmd_run(usbd_dfu_handler *dfu);
 
 /* DFU requests management functions */
 static void dfu_detach(usb_dev *udev, usb_req *req);
@@ -264,6 +267,9 @@ usb_desc dfu_desc = {
     .strings     = usbd_dfu_strings
 };
 
+/* device of the memory completions */
+static usb_dev *dfu_mem_udev = NULL;
+
 usb_class_core dfu_class = {
     .init            = dfu_init,
     .deinit          = dfu_deinit,
@@ -287,11 +293,13 @@ static uint8_t dfu_init(usb_dev *udev, uint8_t config_index)
 
     memset((void *)&dfu_handler, 0U, sizeof(usbd_dfu_handler));
 
+    dfu_handler.buf = dfu_handler.block[0];
     dfu_handler.manifest_state = MANIFEST_COMPLETE;
     dfu_handler.bState = STATE_DFU_IDLE;
     dfu_handler.bStatus = STATUS_OK;
 
     udev->dev.class_data[USBD_DFU_INTERFACE] = (void *)&dfu_handler;
+    dfu_mem_udev = udev;
 
     /* create interface string */
     string_to_unicode((uint8_t *)dfu_inter_flash_cb.pstr_desc, udev->dev.desc->strings[STR_IDX_ALT_ITF0]);
@@ -312,9 +320,14 @@ static uint8_t dfu_deinit(usb_dev *udev, uint8_t config_index)
 {
     usbd_dfu_handler *dfu = (usbd_dfu_handler *)udev->dev.class_data[USBD_DFU_INTERFACE];
 
+    /* drop a waiting command and let the memory end the running one */
+    dfu->pending = DFU_CMD_NONE;
+    dfu_mem_flush();
+
     /* restore device default state */
     memset(udev->dev.class_data[USBD_DFU_INTERFACE], 0U, sizeof(usbd_dfu_handler));
 
+    dfu->buf = dfu->block[0];
     dfu->bState = STATE_DFU_IDLE;
     dfu->bStatus = STATUS_OK;
 
@@ -367,6 +380,9 @@ static void dfu_mode_leave(usb_dev *udev)
 
     dfu->manifest_state = MANIFEST_COMPLETE;
 
+    /* the last block is written in the background */
+    dfu_mem_flush();
+
     if(dfu_config_desc.dfu_func.bmAttributes & 0x04U) {
         dfu->bState = STATE_DFU_MANIFEST_SYNC;
     } else {
@@ -388,56 +404,160 @@ static void dfu_mode_leave(usb_dev *udev)
   */
 static uint8_t dfu_getstatus_complete(usb_dev *udev)
 {
-    uint32_t addr;
-
     usbd_dfu_handler *dfu = (usbd_dfu_handler *)udev->dev.class_data[USBD_DFU_INTERFACE];
 
-    if(STATE_DFU_DNBUSY == dfu->bState) {
-        /* decode the special command */
-        if(0U == dfu->block_num) {
-            if(1U == dfu->data_len) {
-                if(GET_COMMANDS == dfu->buf[0]) {
-                    /* no operation */
-                }
-            } else if(5U == dfu->data_len) {
-                if(SET_ADDRESS_POINTER == dfu->buf[0]) {
-                    /* set flash operation address */
-                    dfu->base_addr = *(uint32_t *)(dfu->buf + 1U);
-                } else if(ERASE == dfu->buf[0]) {
-                    dfu->base_addr = *(uint32_t *)(dfu->buf + 1U);
-
-                    dfu_mem_erase(dfu->base_addr);
-                } else {
-                    /* no operation */
-                }
-            } else {
-                /* no operation */
-            }
-        } else if(dfu->block_num > 1U) { /* regular download command */
-            /* decode the required address */
-            addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
+    if(DFU_CMD_RECEIVED == dfu->pending) {
+        /* run the command acknowledged by this status */
+        dfu_cmd_run(dfu);
+    } else if(STATE_DFU_MANIFEST == dfu->bState) { /* manifestation in progress */
+        /* start leaving DFU mode */
+        dfu_mode_leave(udev);
+    } else {
+        /* no operation */
+    }
 
-            dfu_mem_write(dfu->buf, addr, dfu->data_len);
+    return USBD_OK;
+}
 
-            dfu->block_num = 0U;
-        } else {
-            /* no operation */
+/*!
+    \brief      decode the memory operation of the download command in the receive block
+    \param[in]  dfu: pointer to DFU handler
+    \param[out] cmd: CMD_ERASE or CMD_WRITE
+    \param[out] addr: memory address of the operation
+    \retval     1 if the command erases or writes the memory, 0 else
+*/
+static uint8_t dfu_cmd_decode(usbd_dfu_handler *dfu, uint8_t *cmd, uint32_t *addr)
+{
+    if(0U == dfu->block_num) {
+        if((5U == dfu->data_len) && (ERASE == dfu->buf[0])) {
+            *cmd = CMD_ERASE;
+            *addr = *(uint32_t *)(dfu->buf + 1U);
+
+            return 1U;
         }
+    } else if(dfu->block_num > 1U) { /* regular download command */
+        *cmd = CMD_WRITE;
+        *addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
 
-        dfu->data_len = 0U;
+        return 1U;
+    } else {
+        /* no operation */
+    }
 
-        /* update the device state and poll timeout */
-        dfu->bState = STATE_DFU_DNLOAD_SYNC;
+    return 0U;
+}
 
-        return USBD_OK;
-    } else if(STATE_DFU_MANIFEST == dfu->bState) { /* manifestation in progress */
-        /* start leaving DFU mode */
-        dfu_mode_leave(udev);
+/*!
+    \brief      set the poll timeout of the download command in the receive block
+    \param[in]  dfu: pointer to DFU handler
+    \param[out] none
+    \retval     1 if the command runs in the background at once, 0 else
+*/
+static uint8_t dfu_poll_set(usbd_dfu_handler *dfu)
+{
+    uint8_t cmd = CMD_WRITE;
+    uint32_t addr = 0U;
+
+    dfu->bwPollTimeout0 = 0U;
+    dfu->bwPollTimeout1 = 0U;
+    dfu->bwPollTimeout2 = 0U;
+
+    if(0U == dfu_cmd_decode(dfu, &cmd, &addr)) {
+        return 0U;
+    }
+
+    if((0U != dfu_mem_pipelined(addr)) && (0U == dfu->mem_busy)) {
+        return 1U;
+    }
+
+    /* the time of the command itself, or the time until the memory takes it */
+    dfu_mem_getstatus(addr, cmd, dfu->data_len, (uint8_t *)&dfu->bwPollTimeout0);
+
+    return 0U;
+}
+
+/*!
+    \brief      run the download command in the receive block, or leave it waiting while the
+                memory is busy with the previous one
+    \param[in]  dfu: pointer to DFU handler
+    \param[out] none
+    \retval     none
+*/
+static void dfu_cmd_run(usbd_dfu_handler *dfu)
+{
+    uint8_t cmd = CMD_WRITE;
+    uint32_t addr = 0U;
+    uint32_t len = dfu->data_len;
+    uint8_t *buf = dfu->buf;
+    uint8_t mem = dfu_cmd_decode(dfu, &cmd, &addr);
+
+    if((0U != mem) && (0U != dfu->mem_busy)) {
+        /* dfu_mem_done() runs it */
+        dfu->pending = DFU_CMD_WAIT;
+        return;
+    }
+
+    dfu->pending = DFU_CMD_NONE;
+
+    if(0U == dfu->block_num) {
+        if((5U == dfu->data_len) && ((SET_ADDRESS_POINTER == buf[0]) || (ERASE == buf[0]))) {
+            /* set flash operation address */
+            dfu->base_addr = *(uint32_t *)(buf + 1U);
+        }
+    } else if(dfu->block_num > 1U) {
+        /* the host downloads the next block to the other buffer while this one is written */
+        dfu->buf = (dfu->block[0] == buf) ? dfu->block[1] : dfu->block[0];
     } else {
         /* no operation */
     }
 
-    return USBD_OK;
+    dfu->data_len = 0U;
+    dfu->block_num = 0U;
+
+    /* update the device state */
+    if(STATE_DFU_DNBUSY == dfu->bState) {
+        dfu->bState = STATE_DFU_DNLOAD_SYNC;
+    }
+
+    if(0U != mem) {
+        dfu->mem_busy = 1U;
+        dfu->mem_cmd = cmd;
+
+        if(MEM_OK != dfu_mem_start(cmd, buf, addr, len)) {
+            dfu->mem_busy = 0U;
+            dfu->bStatus = STATUS_ERR_ADDRESS;
+            dfu->bState = STATE_DFU_ERROR;
+        }
+    }
+}
+
+/*!
+    \brief      report the end of a command of dfu_mem_start(), at the priority of the USB interrupt
+    \param[in]  status: MEM_OK if the memory was erased or written, MEM_FAIL else
+    \param[out] none
+    \retval     none
+*/
+void dfu_mem_done(uint8_t status)
+{
+    usbd_dfu_handler *dfu;
+
+    if(NULL == dfu_mem_udev) {
+        return;
+    }
+
+    dfu = (usbd_dfu_handler *)dfu_mem_udev->dev.class_data[USBD_DFU_INTERFACE];
+
+    dfu->mem_busy = 0U;
+
+    if(MEM_OK != status) {
+        dfu->bStatus = (CMD_ERASE == dfu->mem_cmd) ? STATUS_ERR_ERASE : STATUS_ERR_PROG;
+        dfu->bState = STATE_DFU_ERROR;
+        dfu->pending = DFU_CMD_NONE;
+    } else if(DFU_CMD_WAIT == dfu->pending) {
+        dfu_cmd_run(dfu);
+    } else {
+        /* no operation */
+    }
 }
 
 /*!
@@ -561,6 +681,9 @@ static void dfu_upload(usb_dev *udev, usb_req *req)
             /* change is accelerated */
             addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
 
+            /* read what the memory has ended writing */
+            dfu_mem_flush();
+
             /* return the physical address where data are stored */
             phy_addr = dfu_mem_read(dfu->buf, addr, dfu->data_len);
 
@@ -594,17 +717,26 @@ static void dfu_getstatus(usb_dev *udev, usb_req *req)
     switch(dfu->bState) {
     case STATE_DFU_DNLOAD_SYNC:
         if(0U != dfu->data_len) {
+            dfu->pending = DFU_CMD_RECEIVED;
             dfu->bState = STATE_DFU_DNBUSY;
 
-            if(0U == dfu->block_num) {
-                if(ERASE == dfu->buf[0]) {
-                    dfu_mem_getstatus(dfu->base_addr, CMD_ERASE, (uint8_t *)&dfu->bwPollTimeout0);
-                } else {
-                    dfu_mem_getstatus(dfu->base_addr, CMD_WRITE, (uint8_t *)&dfu->bwPollTimeout0);
-                }
+            /* a block the memory writes in the background needs no poll, the special
+               commands report busy once as the DfuSe tools expect it */
+            if((0U != dfu_poll_set(dfu)) && (dfu->block_num > 1U)) {
+                dfu->bState = STATE_DFU_DNLOAD_IDLE;
             }
         } else {
             dfu->bState = STATE_DFU_DNLOAD_IDLE;
+            dfu->bwPollTimeout0 = 0U;
+            dfu->bwPollTimeout1 = 0U;
+            dfu->bwPollTimeout2 = 0U;
+        }
+        break;
+
+    case STATE_DFU_DNBUSY:
+        /* the time until the memory takes the waiting command */
+        if(DFU_CMD_NONE != dfu->pending) {
+            dfu_poll_set(dfu);
         }
         break;
 
@@ -612,6 +744,11 @@ static void dfu_getstatus(usb_dev *udev, usb_req *req)
         if(MANIFEST_IN_PROGRESS == dfu->manifest_state) {
             dfu->bState = STATE_DFU_MANIFEST;
             dfu->bwPollTimeout0 = 1U;
+
+            /* the memory ends the last block first */
+            if(0U != dfu_mem_pipelined(dfu->base_addr)) {
+                dfu_mem_getstatus(dfu->base_addr, CMD_WRITE, 0U, (uint8_t *)&dfu->bwPollTimeout0);
+            }
         } else if((MANIFEST_COMPLETE == dfu->manifest_state) && \
                   (dfu_config_desc.dfu_func.bmAttributes & 0x04U)) {
             dfu->bState = STATE_DFU_IDLE;
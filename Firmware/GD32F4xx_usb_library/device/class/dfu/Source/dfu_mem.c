@@ -32,6 +32,7 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 OF SUCH DAMAGE.
 */
 
+#include "dfu_core.h"
 #include "dfu_mem.h"
 #include "usbd_transc.h"
 
@@ -196,28 +197,118 @@ uint8_t *dfu_mem_read(uint8_t *buf, uint32_t addr, uint32_t len)
 /*!
     \brief      get the status of a given memory and store in buffer
     \param[in]  addr: memory sector address/code
-    \param[in]  cmd: 0 for erase and 1 for write
+    \param[in]  cmd: CMD_ERASE or CMD_WRITE
+    \param[in]  len: length of the write
     \param[in]  buffer: pointer to the buffer where the status data will be stored
     \param[out] none
     \retval     MEM_OK if all operations are OK, MEM_FAIL else
 */
-uint8_t dfu_mem_getstatus(uint32_t addr, uint8_t cmd, uint8_t *buffer)
+uint8_t dfu_mem_getstatus(uint32_t addr, uint8_t cmd, uint32_t len, uint8_t *buffer)
 {
     uint32_t mem_index = dfu_mem_checkaddr(addr);
+    uint32_t timeout;
 
     if(mem_index < MAX_USED_MEMORY_MEDIA) {
-        if(cmd & 0x01U) {
-            POLLING_TIMEOUT_SET(mem_tab[mem_index]->write_timeout);
+        if(NULL != mem_tab[mem_index]->mem_timeout) {
+            /* a memory working in the background takes the command once its own work is done */
+            if(0U != dfu_mem_pipelined(addr)) {
+                timeout = mem_tab[mem_index]->mem_timeout(addr, CMD_WRITE, 0U);
+            } else {
+                timeout = mem_tab[mem_index]->mem_timeout(addr, cmd, len);
+            }
+        } else if(CMD_WRITE == cmd) {
+            timeout = mem_tab[mem_index]->write_timeout;
         } else {
-            POLLING_TIMEOUT_SET(mem_tab[mem_index]->erase_timeout);
+            timeout = mem_tab[mem_index]->erase_timeout;
         }
 
+        POLLING_TIMEOUT_SET(timeout);
+
         return MEM_OK;
     } else {
         return MEM_FAIL;
     }
 }
 
+/*!
+    \brief      check whether the memory of an address takes commands in the background
+    \param[in]  addr: memory sector address/code
+    \param[out] none
+    \retval     1 if the memory has start callbacks, 0 else
+*/
+uint8_t dfu_mem_pipelined(uint32_t addr)
+{
+    uint32_t mem_index = dfu_mem_checkaddr(addr);
+
+    if((mem_index < MAX_USED_MEMORY_MEDIA) && (NULL != mem_tab[mem_index]->mem_erase_start) && \
+            (NULL != mem_tab[mem_index]->mem_write_start)) {
+        return 1U;
+    }
+
+    return 0U;
+}
+
+/*!
+    \brief      start an erase or a write, dfu_mem_done() reports the end, for a memory without
+                start callbacks before the return
+    \param[in]  cmd: CMD_ERASE or CMD_WRITE
+    \param[in]  buf: data of the write, it has to stay valid until the end
+    \param[in]  addr: memory sector address/code
+    \param[in]  len: length of the write
+    \param[out] none
+    \retval     MEM_OK if the command was started, MEM_FAIL else
+*/
+uint8_t dfu_mem_start(uint8_t cmd, uint8_t *buf, uint32_t addr, uint32_t len)
+{
+    uint32_t mem_index = dfu_mem_checkaddr(addr);
+    uint8_t status;
+
+    /* check if the address is in protected area */
+    if(IS_PROTECTED_AREA(addr)) {
+        return MEM_FAIL;
+    }
+
+    if((mem_index >= MAX_USED_MEMORY_MEDIA) && (OB_RDPT0 != (addr & MAL_MASK_OB))) {
+        return MEM_FAIL;
+    }
+
+    /* the option bytes are written at once and reset the device */
+    if((0U != dfu_mem_pipelined(addr)) && (OB_RDPT0 != (addr & MAL_MASK_OB))) {
+        if(CMD_ERASE == cmd) {
+            return mem_tab[mem_index]->mem_erase_start(addr);
+        } else {
+            return mem_tab[mem_index]->mem_write_start(buf, addr, len);
+        }
+    }
+
+    if(CMD_ERASE == cmd) {
+        status = dfu_mem_erase(addr);
+    } else {
+        status = dfu_mem_write(buf, addr, len);
+    }
+
+    dfu_mem_done(status);
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      wait until the memories have ended their work
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void dfu_mem_flush(void)
+{
+    uint32_t mem_index = 0U;
+
+    for(mem_index = 0U; mem_index < MAX_USED_MEMORY_MEDIA; mem_index++) {
+        if(NULL != mem_tab[mem_index]->mem_flush) {
+            mem_tab[mem_index]->mem_flush();
+        }
+    }
+}
+
 /*!
     \brief      check the address is supported
     \param[in]  addr: memory sector address/code
@@ -43,11 +43,64 @@ OF SUCH DAMAGE.
 #define NO_CMD                      0xFFU                         /*!< no command */
 #define MAX_PERIPH_NUM              4U                            /*!< maximum peripheral number */
 
+/* polling interval of the report endpoints, frames at full speed and 2^(bInterval-1)
+   microframes at high speed */
+#ifndef CUSTOMHID_INTERVAL
+#define CUSTOMHID_INTERVAL          0x20U
+#endif /* CUSTOMHID_INTERVAL */
+
+/* report queue: IN reports waiting for the host, a power of two */
+#ifndef CUSTOM_HID_IN_QUEUE_LEN
+#define CUSTOM_HID_IN_QUEUE_LEN     8U
+#endif /* CUSTOM_HID_IN_QUEUE_LEN */
+
+/* report queue: OUT reports waiting for the application, a power of two */
+#ifndef CUSTOM_HID_OUT_QUEUE_LEN
+#define CUSTOM_HID_OUT_QUEUE_LEN    8U
+#endif /* CUSTOM_HID_OUT_QUEUE_LEN */
+
+/* report buffer size, whole words for the internal DMA */
+#define CUSTOM_HID_REPORT_SIZE      ((((CUSTOMHID_IN_PACKET > CUSTOMHID_OUT_PACKET) ? CUSTOMHID_IN_PACKET : CUSTOMHID_OUT_PACKET) + 3U) & ~3U)
+
+/* a report of the queue */
 typedef struct {
-    uint8_t data[2];                                              /*!< custom HID data packet buff */
+    uint8_t data[CUSTOM_HID_REPORT_SIZE];                         /*!< report, word aligned */
+    uint32_t len;                                                 /*!< report length */
+    uint32_t stamp;                                               /*!< DWT cycle count when queued (IN) or received (OUT) */
+} custom_hid_report;
+
+/* report queue counters, latencies in DWT cycles */
+typedef struct {
+    uint32_t in_reports;                                          /*!< IN reports the host read */
+    uint32_t in_full;                                             /*!< IN reports refused with a full queue */
+    uint32_t in_latency_last;                                     /*!< from custom_hid_report_queue() to the end of the IN transfer */
+    uint32_t in_latency_min;
+    uint32_t in_latency_max;
+    uint64_t in_latency_sum;
+    uint32_t out_reports;                                         /*!< OUT reports received */
+    uint32_t out_full;                                            /*!< times the OUT endpoint stayed unarmed with a full queue */
+    uint32_t out_latency_last;                                    /*!< from the end of the OUT transfer to custom_hid_report_read() */
+    uint32_t out_latency_min;
+    uint32_t out_latency_max;
+    uint64_t out_latency_sum;
+} custom_hid_queue_stats;
+
+typedef struct {
+    uint8_t data[CUSTOMHID_OUT_PACKET];                           /*!< custom HID data packet buff */
     uint8_t reportID;                                             /*!< custom HID report id */
     uint8_t idlestate;                                            /*!< idle state */
     uint8_t protocol;                                             /*!< HID protocol */
+
+    custom_hid_report in_queue[CUSTOM_HID_IN_QUEUE_LEN];         /*!< report queue of the IN endpoint */
+    custom_hid_report out_queue[CUSTOM_HID_OUT_QUEUE_LEN];       /*!< report queue of the OUT endpoint */
+    uint8_t queue;                                                /*!< report queue started */
+    __IO uint8_t in_busy;                                         /*!< an IN report is in flight */
+    __IO uint8_t out_armed;                                       /*!< the OUT endpoint is armed with a queue report */
+    __IO uint32_t in_head;                                        /*!< IN reports queued */
+    __IO uint32_t in_tail;                                        /*!< IN reports sent */
+    __IO uint32_t out_head;                                       /*!< OUT reports received */
+    __IO uint32_t out_tail;                                       /*!< OUT reports read */
+    custom_hid_queue_stats stats;                                 /*!< report queue counters */
 } custom_hid_handler;
 
 typedef struct {
@@ -62,5 +115,13 @@ extern usb_class_core usbd_custom_hid_cb;
 uint8_t custom_hid_itfop_register(usb_dev *udev, hid_fop_handler *hid_fop);
 /* send custom HID report */
 uint8_t custom_hid_report_send(usb_dev *udev, uint8_t *report, uint32_t len);
+/* start the report queue, no effect if it runs already */
+void custom_hid_queue_start(usb_dev *udev);
+/* queue an IN report */
+uint8_t custom_hid_report_queue(usb_dev *udev, const uint8_t *report, uint32_t len);
+/* take the oldest OUT report */
+uint32_t custom_hid_report_read(usb_dev *udev, uint8_t *report, uint32_t *stamp);
+/* read the report queue counters */
+void custom_hid_queue_stats_get(usb_dev *udev, custom_hid_queue_stats *stats);
 
 #endif /* CUSTOM_HID_CORE_H */
@@ -117,7 +117,7 @@ __ALIGN_BEGIN const usb_hid_desc_config_set custom_hid_config_desc __ALIGN_END =
         .bEndpointAddress     = CUSTOMHID_IN_EP,
         .bmAttributes         = USB_EP_ATTR_INT,
         .wMaxPacketSize       = CUSTOMHID_IN_PACKET,
-        .bInterval            = 0x20U
+        .bInterval            = CUSTOMHID_INTERVAL
     },
 
     .hid_epout =
@@ -130,7 +130,7 @@ __ALIGN_BEGIN const usb_hid_desc_config_set custom_hid_config_desc __ALIGN_END =
         .bEndpointAddress     = CUSTOMHID_OUT_EP,
         .bmAttributes         = USB_EP_ATTR_INT,
         .wMaxPacketSize       = CUSTOMHID_OUT_PACKET,
-        .bInterval            = 0x20U
+        .bInterval            = CUSTOMHID_INTERVAL
     }
 };
 
@@ -261,6 +261,9 @@ static uint8_t custom_hid_req_handler(usb_dev *udev, usb_req *req);
 static uint8_t custom_hid_data_in(usb_dev *udev, uint8_t ep_num);
 static uint8_t custom_hid_data_out(usb_dev *udev, uint8_t ep_num);
 
+static void custom_hid_in_next(usb_dev *udev, custom_hid_handler *hid);
+static void custom_hid_out_arm(usb_dev *udev, custom_hid_handler *hid);
+
 usb_class_core usbd_custom_hid_cb = {
     .command   = NO_CMD,
     .alter_set = 0U,
@@ -307,6 +310,136 @@ uint8_t custom_hid_report_send(usb_dev *udev, uint8_t *report, uint32_t len)
     return USBD_OK;
 }
 
+/*!
+    \brief      start the report queue, no effect if it runs already
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+void custom_hid_queue_start(usb_dev *udev)
+{
+    custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+
+    if((NULL == hid) || (0U != hid->queue)) {
+        return;
+    }
+
+    /* the reports carry the cycle count of the DWT */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    hid->stats.in_latency_min = 0xFFFFFFFFU;
+    hid->stats.out_latency_min = 0xFFFFFFFFU;
+
+    /* the OUT transfer armed by custom_hid_init() still goes to data[], custom_hid_data_out()
+       moves it into the queue */
+    hid->queue = 1U;
+}
+
+/*!
+    \brief      queue an IN report, the application must not queue from a priority above the
+                USB interrupt that ends the IN transfers
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  report: report to send
+    \param[in]  len: report length, up to CUSTOMHID_IN_PACKET
+    \param[out] none
+    \retval     USBD_OK, or USBD_FAIL if the queue is full or not started
+*/
+uint8_t custom_hid_report_queue(usb_dev *udev, const uint8_t *report, uint32_t len)
+{
+    custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+    custom_hid_report *slot;
+
+    if((NULL == hid) || (0U == hid->queue) || (0U == len) || (len > CUSTOMHID_IN_PACKET)) {
+        return USBD_FAIL;
+    }
+
+    if(CUSTOM_HID_IN_QUEUE_LEN == hid->in_head - hid->in_tail) {
+        hid->stats.in_full++;
+        return USBD_FAIL;
+    }
+
+    slot = &hid->in_queue[hid->in_head & (CUSTOM_HID_IN_QUEUE_LEN - 1U)];
+    memcpy(slot->data, report, len);
+    slot->len = len;
+    slot->stamp = DWT->CYCCNT;
+
+    /* publish the report only after it is in the queue */
+    __DMB();
+    hid->in_head++;
+
+    /* with no IN transfer in flight no callback can start one, so start it here */
+    if(0U == hid->in_busy) {
+        custom_hid_in_next(udev, hid);
+    }
+
+    return USBD_OK;
+}
+
+/*!
+    \brief      take the oldest OUT report
+    \param[in]  udev: pointer to USB device instance
+    \param[out] report: buffer of CUSTOMHID_OUT_PACKET bytes for the report
+    \param[out] stamp: DWT cycle count when the report was received, NULL if not needed
+    \retval     report length, 0 if no report is waiting
+*/
+uint32_t custom_hid_report_read(usb_dev *udev, uint8_t *report, uint32_t *stamp)
+{
+    custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+    custom_hid_report *slot;
+    uint32_t len, latency;
+
+    if((NULL == hid) || (0U == hid->queue) || (hid->out_tail == hid->out_head)) {
+        return 0U;
+    }
+
+    slot = &hid->out_queue[hid->out_tail & (CUSTOM_HID_OUT_QUEUE_LEN - 1U)];
+    len = slot->len;
+    memcpy(report, slot->data, len);
+
+    latency = DWT->CYCCNT - slot->stamp;
+    hid->stats.out_latency_last = latency;
+    hid->stats.out_latency_sum += latency;
+    if(latency < hid->stats.out_latency_min) {
+        hid->stats.out_latency_min = latency;
+    }
+    if(latency > hid->stats.out_latency_max) {
+        hid->stats.out_latency_max = latency;
+    }
+    if(NULL != stamp) {
+        *stamp = slot->stamp;
+    }
+
+    /* release the report only after it is copied */
+    __DMB();
+    hid->out_tail++;
+
+    /* the OUT endpoint waited for this report */
+    if(0U == hid->out_armed) {
+        custom_hid_out_arm(udev, hid);
+    }
+
+    return len;
+}
+
+/*!
+    \brief      read the report queue counters
+    \param[in]  udev: pointer to USB device instance
+    \param[out] stats: counters
+    \retval     none
+*/
+void custom_hid_queue_stats_get(usb_dev *udev, custom_hid_queue_stats *stats)
+{
+    custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+
+    if(NULL == hid) {
+        memset(stats, 0U, sizeof(custom_hid_queue_stats));
+        return;
+    }
+
+    *stats = hid->stats;
+}
+
 /*!
     \brief      initialize the HID device
     \param[in]  udev: pointer to USB device instance
@@ -327,7 +460,7 @@ static uint8_t custom_hid_init(usb_dev *udev, uint8_t config_index)
     usbd_ep_setup(udev, &(custom_hid_config_desc.hid_epout));
 
     /* prepare receive data */
-    usbd_ep_recev(udev, CUSTOMHID_OUT_EP, hid_handler.data, 2U);
+    usbd_ep_recev(udev, CUSTOMHID_OUT_EP, hid_handler.data, CUSTOMHID_OUT_PACKET);
 
     udev->dev.class_data[CUSTOM_HID_INTERFACE] = (void *)&hid_handler;
 
@@ -420,6 +553,30 @@ static uint8_t custom_hid_req_handler(usb_dev *udev, usb_req *req)
 */
 static uint8_t custom_hid_data_in(usb_dev *udev, uint8_t ep_num)
 {
+    custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+    custom_hid_report *slot;
+    uint32_t latency;
+
+    if((0U != hid->queue) && (0U != hid->in_busy)) {
+        slot = &hid->in_queue[hid->in_tail & (CUSTOM_HID_IN_QUEUE_LEN - 1U)];
+
+        latency = DWT->CYCCNT - slot->stamp;
+        hid->stats.in_reports++;
+        hid->stats.in_latency_last = latency;
+        hid->stats.in_latency_sum += latency;
+        if(latency < hid->stats.in_latency_min) {
+            hid->stats.in_latency_min = latency;
+        }
+        if(latency > hid->stats.in_latency_max) {
+            hid->stats.in_latency_max = latency;
+        }
+
+        hid->in_tail++;
+
+        /* the next report goes out at the next poll of the host */
+        custom_hid_in_next(udev, hid);
+    }
+
     return USBD_OK;
 }
 
@@ -433,6 +590,29 @@ static uint8_t custom_hid_data_in(usb_dev *udev, uint8_t ep_num)
 static uint8_t custom_hid_data_out(usb_dev *udev, uint8_t ep_num)
 {
     custom_hid_handler *hid = (custom_hid_handler *)udev->dev.class_data[CUSTOM_HID_INTERFACE];
+    custom_hid_report *slot;
+
+    if(0U != hid->queue) {
+        slot = &hid->out_queue[hid->out_head & (CUSTOM_HID_OUT_QUEUE_LEN - 1U)];
+
+        if(0U != hid->out_armed) {
+            slot->len = udev->dev.transc_out[ep_num].xfer_count;
+        } else {
+            /* the last report received into data[] before the queue started, there is room
+               for it since the queue is empty */
+            slot->len = USB_MIN(udev->dev.transc_out[ep_num].xfer_count, sizeof(hid->data));
+            memcpy(slot->data, hid->data, slot->len);
+        }
+        slot->stamp = DWT->CYCCNT;
+
+        hid->out_head++;
+        hid->stats.out_reports++;
+
+        /* the host may send the next report at its next poll */
+        custom_hid_out_arm(udev, hid);
+
+        return USBD_OK;
+    }
 
     /* light the LED */
     switch(hid->data[0]) {
@@ -467,7 +647,51 @@ static uint8_t custom_hid_data_out(usb_dev *udev, uint8_t ep_num)
         break;
     }
 
-    usbd_ep_recev(udev, CUSTOMHID_OUT_EP, hid->data, 2U);
+    usbd_ep_recev(udev, CUSTOMHID_OUT_EP, hid->data, CUSTOMHID_OUT_PACKET);
 
     return USBD_OK;
 }
+
+/*!
+    \brief      start the IN transfer of the oldest queued report
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  hid: HID handler
+    \param[out] none
+    \retval     none
+*/
+static void custom_hid_in_next(usb_dev *udev, custom_hid_handler *hid)
+{
+    custom_hid_report *slot;
+
+    if(hid->in_tail == hid->in_head) {
+        hid->in_busy = 0U;
+        return;
+    }
+
+    slot = &hid->in_queue[hid->in_tail & (CUSTOM_HID_IN_QUEUE_LEN - 1U)];
+    hid->in_busy = 1U;
+
+    usbd_ep_send(udev, CUSTOMHID_IN_EP, slot->data, slot->len);
+}
+
+/*!
+    \brief      arm the OUT endpoint with the next free report of the queue
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  hid: HID handler
+    \param[out] none
+    \retval     none
+*/
+static void custom_hid_out_arm(usb_dev *udev, custom_hid_handler *hid)
+{
+    if(CUSTOM_HID_OUT_QUEUE_LEN == hid->out_head - hid->out_tail) {
+        /* the host gets NAKs until custom_hid_report_read() frees a report */
+        hid->out_armed = 0U;
+        hid->stats.out_full++;
+        return;
+    }
+
+    hid->out_armed = 1U;
+
+    usbd_ep_recev(udev, CUSTOMHID_OUT_EP, hid->out_queue[hid->out_head & (CUSTOM_HID_OUT_QUEUE_LEN - 1U)].data, \
+                  CUSTOMHID_OUT_PACKET);
+}
@@ -39,13 +39,20 @@ OF SUCH DAMAGE.
 #include "msc_scsi.h"
 #include "usbd_msc_scsi.h"
 
+/* buffers of MSC_MEDIA_PACKET_SIZE for READ10 and WRITE10, the storage works on one while USB
+   moves another */
+#ifndef MSC_MEDIA_BUFFERS
+#define MSC_MEDIA_BUFFERS                   2U
+#endif /* MSC_MEDIA_BUFFERS */
+
 /* MSC BBB state */
 enum msc_bbb_state {
     BBB_IDLE = 0U,          /*!< idle state  */
     BBB_DATA_OUT,           /*!< data OUT state */
     BBB_DATA_IN,            /*!< data IN state */
     BBB_LAST_DATA_IN,       /*!< last data IN state */
-    BBB_SEND_DATA           /*!< send immediate data state */
+    BBB_SEND_DATA,          /*!< send immediate data state */
+    BBB_MEDIA_WAIT          /*!< the CSW waits for the storage */
 };
 
 /* MSC BBB status */
@@ -56,7 +63,7 @@ enum msc_bbb_status {
 };
 
 typedef struct {
-    uint8_t bbb_data[MSC_MEDIA_PACKET_SIZE];                                    /*!< MSC BBB data buff */
+    uint8_t bbb_data[MSC_MEDIA_PACKET_SIZE * MSC_MEDIA_BUFFERS];                 /*!< MSC BBB data buff */
 
     uint8_t max_lun;                                                            /*!< maximum LUN */
 
@@ -77,6 +84,15 @@ typedef struct {
     uint32_t scsi_blk_addr;                                                     /*!< SCSI block address */
     uint32_t scsi_blk_len;                                                      /*!< SCSI block length */
     uint32_t scsi_disk_pop;                                                     /*!< SCSI disk pop */
+    uint32_t scsi_usb_len;                                                      /*!< SCSI data bytes USB has still to move */
+
+    uint32_t pipe_len[MSC_MEDIA_BUFFERS];                                       /*!< bytes in each media buffer */
+    uint8_t pipe_media;                                                         /*!< buffer of the next storage transfer */
+    uint8_t pipe_usb;                                                           /*!< buffer of the next USB transfer */
+    uint8_t pipe_used;                                                          /*!< buffers in use */
+    uint8_t pipe_ready;                                                         /*!< buffers handed over to the other side */
+    uint8_t pipe_busy;                                                          /*!< storage and USB transfers in flight */
+    uint8_t pipe_error;                                                         /*!< a storage transfer failed */
 
     msc_scsi_sense scsi_sense[SENSE_LIST_DEEPTH];                               /*!< MSC SCSI sense structural buff */
 } usbd_msc_handler;
@@ -51,8 +51,23 @@ typedef struct {
     uint8_t *mem_inquiry_data[MEM_LUN_NUM];                /*!< memory inquiry data buff */
     uint32_t mem_block_size[MEM_LUN_NUM];                  /*!< memory block size buff */
     uint32_t mem_block_len[MEM_LUN_NUM];                   /*!< memory block length buff */
+
+    /* optional, start a transfer and return at once, the storage reports its end through
+       usbd_msc_mem_done(); block_addr is a block number here and a byte address in
+       mem_read/mem_write, which are used for NULL */
+    int8_t (*mem_read_start)(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len);
+    int8_t (*mem_write_start)(uint8_t lun, uint8_t *buf, uint32_t block_addr, uint16_t block_len);
+
+    /* optional, write back cached data on SYNCHRONIZE CACHE and START STOP UNIT, returns 0 when
+       done, 1 when usbd_msc_mem_done() follows after the return, negative on an error; NULL for
+       no cache */
+    int8_t (*mem_sync)(uint8_t lun);
 }usbd_mem_cb;
 
 extern usbd_mem_cb *usbd_mem_fops;
 
+/* function declarations */
+/* report the end of a transfer started by mem_read_start, mem_write_start or mem_sync */
+void usbd_msc_mem_done(int8_t status);
+
 #endif /* USBD_MSC_MEM_H */
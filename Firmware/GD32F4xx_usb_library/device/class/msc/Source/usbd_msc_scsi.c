@@ -71,6 +71,15 @@ const uint8_t msc_mode_sense10_data[] = {
     0x00U
 };
 
+/* transfers of the media buffer pipeline in flight */
+#define MSC_PIPE_MEDIA                      0x01U
+#define MSC_PIPE_USB                        0x02U
+
+/* READ10 and WRITE10 in progress, for the storage callback usbd_msc_mem_done() */
+static usb_core_driver *msc_pipe_udev = NULL;
+static uint8_t msc_pipe_lun = 0U;
+static uint8_t msc_pipe_pumping = 0U;
+
 /* local function prototypes ('static') */
 static int8_t scsi_test_unit_ready(usb_core_driver *udev, uint8_t lun, uint8_t *params);
 static int8_t scsi_mode_select6(usb_core_driver *udev, uint8_t lun, uint8_t *params);
@@ -85,9 +94,13 @@ static int8_t scsi_mode_sense10(usb_core_driver *udev, uint8_t lun, uint8_t *par
 static int8_t scsi_write10(usb_core_driver *udev, uint8_t lun, uint8_t *params);
 static int8_t scsi_read10(usb_core_driver *udev, uint8_t lun, uint8_t *params);
 static int8_t scsi_verify10(usb_core_driver *udev, uint8_t lun, uint8_t *params);
+static int8_t scsi_synchronize_cache10(usb_core_driver *udev, uint8_t lun, uint8_t *params);
+static int8_t scsi_media_sync(usb_core_driver *udev, uint8_t lun);
 
 static int8_t scsi_process_read(usb_core_driver *udev, uint8_t lun);
 static int8_t scsi_process_write(usb_core_driver *udev, uint8_t lun);
+static void scsi_pipe_init(usb_core_driver *udev, uint8_t lun);
+static void scsi_pipe_media_done(usb_core_driver *udev, uint8_t lun, int8_t status);
 
 static inline int8_t scsi_check_address_range(usb_core_driver *udev, uint8_t lun, uint32_t blk_offset, uint16_t blk_nbr);
 static inline int8_t scsi_format_cmd(usb_core_driver *udev, uint8_t lun);
@@ -141,6 +154,9 @@ int8_t scsi_process_cmd(usb_core_driver *udev, uint8_t lun, uint8_t *params)
     case SCSI_VERIFY10:
         return scsi_verify10(udev, lun, params);
 
+    case SCSI_SYNCHRONIZE_CACHE10:
+        return scsi_synchronize_cache10(udev, lun, params);
+
     case SCSI_FORMAT_UNIT:
         return scsi_format_cmd(udev, lun);
 
@@ -449,7 +465,8 @@ static inline int8_t scsi_start_stop_unit(usb_core_driver *udev, uint8_t lun, ui
     msc->bbb_datalen = 0U;
     msc->scsi_disk_pop = 1U;
 
-    return 0;
+    /* the host stops or ejects the medium, cached data has to be on it */
+    return scsi_media_sync(udev, lun);
 }
 
 /*!
@@ -506,7 +523,7 @@ static int8_t scsi_read10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
 
         msc->bbb_state = BBB_DATA_IN;
 
-        msc->scsi_blk_addr *= msc->scsi_blk_size[lun];
+        /* the address stays in blocks, a byte address would wrap on media over 4GB */
         msc->scsi_blk_len  *= msc->scsi_blk_size[lun];
 
         /* cases 4,5 : Hi <> Dn */
@@ -515,9 +532,21 @@ static int8_t scsi_read10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
 
             return -1;
         }
-    }
 
-    msc->bbb_datalen = MSC_MEDIA_PACKET_SIZE;
+        /* case 1 : Hn = Dn, the CSW follows at once */
+        if(0U == msc->scsi_blk_len) {
+            msc->bbb_state = BBB_IDLE;
+            msc->bbb_datalen = 0U;
+
+            return 0;
+        }
+
+        scsi_pipe_init(udev, lun);
+    } else {
+        /* an IN transfer is done, its buffer is free again */
+        msc->pipe_busy &= (uint8_t)~MSC_PIPE_USB;
+        msc->pipe_used--;
+    }
 
     return scsi_process_read(udev, lun);
 }
@@ -566,7 +595,7 @@ static int8_t scsi_write10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
             return -1; /* error */
         }
 
-        msc->scsi_blk_addr *= msc->scsi_blk_size[lun];
+        /* the address stays in blocks, a byte address would wrap on media over 4GB */
         msc->scsi_blk_len  *= msc->scsi_blk_size[lun];
 
         /* cases 3,11,13 : Hn,Ho <> D0 */
@@ -576,18 +605,28 @@ static int8_t scsi_write10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
             return -1;
         }
 
+        /* case 1 : Hn = Dn, the CSW follows at once */
+        if(0U == msc->scsi_blk_len) {
+            msc->bbb_datalen = 0U;
+
+            return 0;
+        }
+
         /* prepare endpoint to receive first data packet */
         msc->bbb_state = BBB_DATA_OUT;
 
-        usbd_ep_recev(udev, \
-                      MSC_OUT_EP, \
-                      msc->bbb_data, \
-                      USB_MIN(msc->scsi_blk_len, MSC_MEDIA_PACKET_SIZE));
-    } else { /* write process ongoing */
-        return scsi_process_write(udev, lun);
+        scsi_pipe_init(udev, lun);
+    } else { /* write process ongoing, an OUT transfer is done */
+        msc->pipe_busy &= (uint8_t)~MSC_PIPE_USB;
+
+        if(0U != msc->pipe_error) {
+            msc->pipe_used--;
+        } else {
+            msc->pipe_ready++;
+        }
     }
 
-    return 0;
+    return scsi_process_write(udev, lun);
 }
 
 /*!
@@ -617,6 +656,64 @@ static int8_t scsi_verify10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
     return 0;
 }
 
+/*!
+    \brief      process Synchronize Cache10 command
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  lun: logical unit number
+    \param[in]  params: command parameters
+    \param[out] none
+    \retval     status
+*/
+static int8_t scsi_synchronize_cache10(usb_core_driver *udev, uint8_t lun, uint8_t *params)
+{
+    usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
+
+    msc->bbb_datalen = 0U;
+
+    /* the whole cache is written back, the block range is not looked at */
+    return scsi_media_sync(udev, lun);
+}
+
+/*!
+    \brief      write back the cache of the storage, the CSW waits for it
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     status
+*/
+static int8_t scsi_media_sync(usb_core_driver *udev, uint8_t lun)
+{
+    usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
+
+    int8_t status;
+
+    if(NULL == usbd_mem_fops->mem_sync) {
+        return 0;
+    }
+
+    msc_pipe_udev = udev;
+    msc_pipe_lun = lun;
+    msc->pipe_busy = MSC_PIPE_MEDIA;
+    msc->bbb_state = BBB_MEDIA_WAIT;
+
+    status = usbd_mem_fops->mem_sync(lun);
+    if(status > 0) {
+        /* usbd_msc_mem_done() sends the CSW */
+        return 0;
+    }
+
+    msc->pipe_busy = 0U;
+    msc->bbb_state = BBB_IDLE;
+
+    if(status < 0) {
+        scsi_sense_code(udev, lun, HARDWARE_ERROR, WRITE_FAULT);
+
+        return -1;
+    }
+
+    return 0;
+}
+
 /*!
     \brief      check address range
     \param[in]  udev: pointer to USB device instance
@@ -640,7 +737,126 @@ static inline int8_t scsi_check_address_range(usb_core_driver *udev, uint8_t lun
 }
 
 /*!
-    \brief      handle read process
+    \brief      report the end of a transfer started by mem_read_start, mem_write_start or
+                mem_sync, it has to be called at the priority of the USB interrupt
+    \param[in]  status: result of the transfer, negative on an error
+    \param[out] none
+    \retval     none
+*/
+void usbd_msc_mem_done(int8_t status)
+{
+    usb_core_driver *udev = msc_pipe_udev;
+    usbd_msc_handler *msc;
+    int8_t ret;
+
+    if(NULL == udev) {
+        return;
+    }
+
+    msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
+
+    /* the command was aborted by a reset in the meantime */
+    if(((BBB_DATA_IN != msc->bbb_state) && (BBB_DATA_OUT != msc->bbb_state) && (BBB_MEDIA_WAIT != msc->bbb_state)) || \
+            (0U == (msc->pipe_busy & MSC_PIPE_MEDIA))) {
+        return;
+    }
+
+    /* end of a mem_sync */
+    if(BBB_MEDIA_WAIT == msc->bbb_state) {
+        msc->pipe_busy = 0U;
+
+        if(status < 0) {
+            scsi_sense_code(udev, msc_pipe_lun, HARDWARE_ERROR, WRITE_FAULT);
+            msc_bbb_csw_send(udev, CSW_CMD_FAILED);
+        } else {
+            msc_bbb_csw_send(udev, CSW_CMD_PASSED);
+        }
+
+        return;
+    }
+
+    scsi_pipe_media_done(udev, msc_pipe_lun, status);
+
+    /* called from inside mem_read_start or mem_write_start, the running pipeline continues */
+    if(0U != msc_pipe_pumping) {
+        return;
+    }
+
+    if(BBB_DATA_IN == msc->bbb_state) {
+        ret = scsi_process_read(udev, msc_pipe_lun);
+    } else {
+        ret = scsi_process_write(udev, msc_pipe_lun);
+    }
+
+    if(ret < 0) {
+        msc_bbb_csw_send(udev, CSW_CMD_FAILED);
+    }
+}
+
+/*!
+    \brief      prepare the media buffer pipeline for a READ10 or WRITE10
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     none
+*/
+static void scsi_pipe_init(usb_core_driver *udev, uint8_t lun)
+{
+    usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
+
+    msc->scsi_usb_len = msc->scsi_blk_len;
+
+    msc->pipe_media = 0U;
+    msc->pipe_usb = 0U;
+    msc->pipe_used = 0U;
+    msc->pipe_ready = 0U;
+    msc->pipe_busy = 0U;
+    msc->pipe_error = 0U;
+
+    msc_pipe_udev = udev;
+    msc_pipe_lun = lun;
+}
+
+/*!
+    \brief      account a finished storage transfer of the pipeline
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  lun: logical unit number
+    \param[in]  status: result of the transfer, negative on an error
+    \param[out] none
+    \retval     none
+*/
+static void scsi_pipe_media_done(usb_core_driver *udev, uint8_t lun, int8_t status)
+{
+    usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
+
+    uint32_t len = msc->pipe_len[msc->pipe_media];
+
+    msc->pipe_busy &= (uint8_t)~MSC_PIPE_MEDIA;
+    msc->pipe_media = (uint8_t)((msc->pipe_media + 1U) % MSC_MEDIA_BUFFERS);
+
+    if(status < 0) {
+        msc->pipe_error = 1U;
+        msc->pipe_used--;
+
+        if(BBB_DATA_IN == msc->bbb_state) {
+            scsi_sense_code(udev, lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
+        } else {
+            scsi_sense_code(udev, lun, HARDWARE_ERROR, WRITE_FAULT);
+        }
+    } else if(BBB_DATA_IN == msc->bbb_state) {
+        /* the buffer waits for its IN transfer */
+        msc->pipe_ready++;
+    } else {
+        msc->pipe_used--;
+
+        /* case 12 : Ho = Do */
+        msc->bbb_csw.dCSWDataResidue -= len;
+    }
+}
+
+/*!
+    \brief      handle read process, the storage fills the free buffers while USB sends the
+                filled ones
     \param[in]  udev: pointer to USB device instance
     \param[in]  lun: logical unit number
     \param[out] none
@@ -650,34 +866,77 @@ static int8_t scsi_process_read(usb_core_driver *udev, uint8_t lun)
 {
     usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
 
-    uint32_t len = USB_MIN(msc->scsi_blk_len, MSC_MEDIA_PACKET_SIZE);
+    uint8_t *buf;
+    uint32_t addr, len;
+    uint8_t progress;
 
-    if(usbd_mem_fops->mem_read(lun, \
-                               msc->bbb_data, \
-                               msc->scsi_blk_addr, \
-                               (uint16_t)(len / msc->scsi_blk_size[lun])) < 0) {
-        scsi_sense_code(udev, lun, HARDWARE_ERROR, UNRECOVERED_READ_ERROR);
+    msc_pipe_pumping = 1U;
 
-        return -1;
-    }
+    do {
+        progress = 0U;
+
+        /* send the oldest buffer the storage has filled */
+        if((0U == (msc->pipe_busy & MSC_PIPE_USB)) && (msc->pipe_ready > 0U) && (0U == msc->pipe_error)) {
+            buf = &msc->bbb_data[msc->pipe_usb * MSC_MEDIA_PACKET_SIZE];
+            len = msc->pipe_len[msc->pipe_usb];
+
+            msc->pipe_usb = (uint8_t)((msc->pipe_usb + 1U) % MSC_MEDIA_BUFFERS);
+            msc->pipe_ready--;
+            msc->pipe_busy |= MSC_PIPE_USB;
+            msc->scsi_usb_len -= len;
+
+            /* case 6 : Hi = Di */
+            msc->bbb_csw.dCSWDataResidue -= len;
 
-    usbd_ep_send(udev, MSC_IN_EP, msc->bbb_data, len);
+            if(0U == msc->scsi_usb_len) {
+                msc->bbb_state = BBB_LAST_DATA_IN;
+            }
 
-    msc->scsi_blk_addr += len;
-    msc->scsi_blk_len  -= len;
+            usbd_ep_send(udev, MSC_IN_EP, buf, len);
+
+            progress = 1U;
+        }
+
+        /* read the next chunk into a free buffer */
+        if((0U == (msc->pipe_busy & MSC_PIPE_MEDIA)) && (0U == msc->pipe_error) && \
+                (msc->scsi_blk_len > 0U) && (msc->pipe_used < MSC_MEDIA_BUFFERS)) {
+            buf = &msc->bbb_data[msc->pipe_media * MSC_MEDIA_PACKET_SIZE];
+            len = USB_MIN(msc->scsi_blk_len, MSC_MEDIA_PACKET_SIZE);
+            addr = msc->scsi_blk_addr;
+
+            msc->pipe_len[msc->pipe_media] = len;
+            msc->pipe_used++;
+            msc->pipe_busy |= MSC_PIPE_MEDIA;
+            msc->scsi_blk_addr += len / msc->scsi_blk_size[lun];
+            msc->scsi_blk_len  -= len;
+
+            if(NULL != usbd_mem_fops->mem_read_start) {
+                if(usbd_mem_fops->mem_read_start(lun, buf, addr, (uint16_t)(len / msc->scsi_blk_size[lun])) < 0) {
+                    scsi_pipe_media_done(udev, lun, -1);
+                }
+            } else {
+                scsi_pipe_media_done(udev, lun, \
+                                     usbd_mem_fops->mem_read(lun, buf, addr * msc->scsi_blk_size[lun], \
+                                                          (uint16_t)(len / msc->scsi_blk_size[lun])));
+            }
+
+            progress = 1U;
+        }
+    } while(0U != progress);
 
-    /* case 6 : Hi = Di */
-    msc->bbb_csw.dCSWDataResidue -= len;
+    msc_pipe_pumping = 0U;
 
-    if(0U == msc->scsi_blk_len) {
-        msc->bbb_state = BBB_LAST_DATA_IN;
+    /* case 5 : Hi > Di, once the transfers in flight are over, the CSW follows the clear feature */
+    if((0U != msc->pipe_error) && (0U == msc->pipe_busy)) {
+        usbd_ep_stall(udev, MSC_IN_EP);
     }
 
     return 0;
 }
 
 /*!
-    \brief      handle write process
+    \brief      handle write process, USB fills the free buffers while the storage writes the
+                filled ones
     \param[in]  udev: pointer to USB device instance
     \param[in]  lun: logical unit number
     \param[out] none
@@ -687,31 +946,74 @@ static int8_t scsi_process_write(usb_core_driver *udev, uint8_t lun)
 {
     usbd_msc_handler *msc = (usbd_msc_handler *)udev->dev.class_data[USBD_MSC_INTERFACE];
 
-    uint32_t len = USB_MIN(msc->scsi_blk_len, MSC_MEDIA_PACKET_SIZE);
+    uint8_t *buf;
+    uint32_t addr, len;
+    uint8_t progress;
 
-    if(usbd_mem_fops->mem_write(lun, \
-                                msc->bbb_data, \
-                                msc->scsi_blk_addr, \
-                                (uint16_t)(len / msc->scsi_blk_size[lun])) < 0) {
-        scsi_sense_code(udev, lun, HARDWARE_ERROR, WRITE_FAULT);
+    msc_pipe_pumping = 1U;
 
-        return -1;
-    }
+    do {
+        progress = 0U;
+
+        /* after an error the rest of the data is received and dropped */
+        if((0U != msc->pipe_error) && (msc->pipe_ready > 0U)) {
+            msc->pipe_used -= msc->pipe_ready;
+            msc->pipe_ready = 0U;
+        }
 
-    msc->scsi_blk_addr += len;
-    msc->scsi_blk_len  -= len;
+        /* prepare endpoint to receive the next packet into a free buffer */
+        if((0U == (msc->pipe_busy & MSC_PIPE_USB)) && \
+                (msc->scsi_usb_len > 0U) && (msc->pipe_used < MSC_MEDIA_BUFFERS)) {
+            buf = &msc->bbb_data[msc->pipe_usb * MSC_MEDIA_PACKET_SIZE];
+            len = USB_MIN(msc->scsi_usb_len, MSC_MEDIA_PACKET_SIZE);
 
-    /* case 12 : Ho = Do */
-    msc->bbb_csw.dCSWDataResidue -= len;
+            msc->pipe_len[msc->pipe_usb] = len;
+            msc->pipe_usb = (uint8_t)((msc->pipe_usb + 1U) % MSC_MEDIA_BUFFERS);
+            msc->pipe_used++;
+            msc->pipe_busy |= MSC_PIPE_USB;
+            msc->scsi_usb_len -= len;
 
-    if(0U == msc->scsi_blk_len) {
-        msc_bbb_csw_send(udev, CSW_CMD_PASSED);
-    } else {
-        /* prepare endpoint to receive next packet */
-        usbd_ep_recev(udev, \
-                      MSC_OUT_EP, \
-                      msc->bbb_data, \
-                      USB_MIN(msc->scsi_blk_len, MSC_MEDIA_PACKET_SIZE));
+            usbd_ep_recev(udev, MSC_OUT_EP, buf, len);
+
+            progress = 1U;
+        }
+
+        /* write the oldest buffer USB has filled */
+        if((0U == (msc->pipe_busy & MSC_PIPE_MEDIA)) && (0U == msc->pipe_error) && (msc->pipe_ready > 0U)) {
+            buf = &msc->bbb_data[msc->pipe_media * MSC_MEDIA_PACKET_SIZE];
+            len = msc->pipe_len[msc->pipe_media];
+            addr = msc->scsi_blk_addr;
+
+            msc->pipe_ready--;
+            msc->pipe_busy |= MSC_PIPE_MEDIA;
+            msc->scsi_blk_addr += len / msc->scsi_blk_size[lun];
+            msc->scsi_blk_len  -= len;
+
+            if(NULL != usbd_mem_fops->mem_write_start) {
+                if(usbd_mem_fops->mem_write_start(lun, buf, addr, (uint16_t)(len / msc->scsi_blk_size[lun])) < 0) {
+                    scsi_pipe_media_done(udev, lun, -1);
+                }
+            } else {
+                scsi_pipe_media_done(udev, lun, \
+                                     usbd_mem_fops->mem_write(lun, buf, addr * msc->scsi_blk_size[lun], \
+                                                          (uint16_t)(len / msc->scsi_blk_size[lun])));
+            }
+
+            progress = 1U;
+        }
+    } while(0U != progress);
+
+    msc_pipe_pumping = 0U;
+
+    if((0U == msc->pipe_busy) && (0U == msc->scsi_usb_len)) {
+        /* the residue counts the bytes that were not written */
+        if(0U != msc->pipe_error) {
+            return -1;
+        }
+
+        if(0U == msc->scsi_blk_len) {
+            msc_bbb_csw_send(udev, CSW_CMD_PASSED);
+        }
     }
 
     return 0;
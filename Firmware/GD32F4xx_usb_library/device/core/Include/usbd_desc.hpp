@@ -0,0 +1,694 @@
+#ifndef USBD_DESC_HPP
+#define USBD_DESC_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+
+extern "C" {
+#include "usbd_enum.h"
+}
+
+/*
+	Compile-time USB descriptors and composite class dispatch for the device library.
+
+	A configuration is composed of functions, one per class driver, each of interfaces with
+	their class-specific descriptors and endpoints. The builder numbers the interfaces in order,
+	gives every endpoint without a number the lowest one its direction has free, computes the
+	lengths and bNumInterfaces/bNumEndpoints, and adds an interface association descriptor to a
+	function of several interfaces in a composite device. The result is a constexpr byte array
+	that stays in flash; an endpoint number taken twice or beyond the core fails the build.
+
+	dispatch() gives the function of every interface and endpoint number, and composite<> turns
+	it into the usb_class_core of the device: a class request, data stage or endpoint event goes
+	to its class driver through a table index instead of the if-chains of a hand-written wrapper.
+
+		constexpr auto config = usbd::desc::configuration(
+			{0x80U, 0x32U, USBFS_MAX_EP_COUNT},
+			usbd::desc::function(usbd_custom_hid_cb,
+				usbd::desc::interface(0x03U, 0x00U, 0x00U,
+					usbd::desc::hid{0x0111U, DESC_LEN_REPORT},
+					usbd::desc::in(usbd::desc::ep_type::interrupt, 2U, 0x20U),
+					usbd::desc::out(usbd::desc::ep_type::interrupt, 2U, 0x20U))),
+			usbd::desc::function(usbd_printer_cb,
+				usbd::desc::interface(0x07U, 0x01U, 0x02U,
+					usbd::desc::in(usbd::desc::ep_type::bulk, 64U),
+					usbd::desc::out(usbd::desc::ep_type::bulk, 64U))));
+
+		alignas(4) constexpr auto config_desc = config.bytes();
+		constexpr auto config_dispatch = config.dispatch();
+		usb_class_core class_core = usbd::desc::composite<config_dispatch>::core();
+
+	Audio streaming endpoints with bRefresh/bSynchAddress and other descriptors the builder has
+	no type for go in as class_specific() bytes.
+*/
+
+namespace usbd::desc {
+	enum class ep_type : std::uint8_t {
+		isochronous = USB_EP_ATTR_ISO,
+		bulk = USB_EP_ATTR_BULK,
+		interrupt = USB_EP_ATTR_INT,
+	};
+
+	// endpoint number left to the builder
+	inline constexpr std::uint8_t auto_number = 0;
+
+	// no function owns the interface or endpoint
+	inline constexpr std::uint8_t none = 0xFF;
+
+	// interface and endpoint numbers of the USB 2.0 specification
+	inline constexpr std::size_t max_numbers = 16;
+
+	inline constexpr std::uint8_t cs_interface = 0x24;
+
+	// descriptor types of the HID class, usb_hid.h is not part of the core
+	inline constexpr std::uint8_t hid_descriptor = 0x21;
+	inline constexpr std::uint8_t report_descriptor = 0x22;
+
+	namespace detail {
+		// declared only: reaching it while a descriptor is evaluated at compile time is the error
+		auto invalid_descriptor(const char* reason) -> void;
+
+		template <std::size_t N>
+		struct writer {
+			std::array<std::uint8_t, N> data{};
+			std::size_t pos = 0;
+
+			constexpr auto u8(unsigned value) -> void {
+				data[pos++] = static_cast<std::uint8_t>(value);
+			}
+
+			constexpr auto u16(unsigned value) -> void {
+				u8(value & 0xFFU);
+				u8((value >> 8) & 0xFFU);
+			}
+		};
+
+		// numbering while the configuration is walked
+		struct context {
+			std::uint8_t endpoints = max_numbers;   // endpoints of the core, EP0 included
+			std::uint8_t interface = 0;             // next interface number
+			std::uint8_t first_interface = 0;       // of the current function
+			std::uint8_t function = 0;              // index of the current function
+			std::uint16_t in_used = 1;              // endpoint numbers taken, a bit each
+			std::uint16_t out_used = 1;
+			std::array<std::uint8_t, max_numbers> interface_owner{};
+			std::array<std::uint8_t, max_numbers> in_owner{};
+			std::array<std::uint8_t, max_numbers> out_owner{};
+
+			constexpr auto take(bool in, std::uint8_t number) -> void {
+				auto& used = in ? in_used : out_used;
+
+				if (number == 0 || number >= endpoints) {
+					invalid_descriptor("endpoint number beyond the endpoints of the core");
+				}
+				if ((used & (1U << number)) != 0) {
+					invalid_descriptor("endpoint number taken twice");
+				}
+				used = static_cast<std::uint16_t>(used | (1U << number));
+			}
+
+			constexpr auto next_free(bool in) const -> std::uint8_t {
+				const auto used = in ? in_used : out_used;
+
+				for (std::uint8_t number = 1; number < endpoints; ++number) {
+					if ((used & (1U << number)) == 0) {
+						return number;
+					}
+				}
+				invalid_descriptor("no endpoint number left");
+				return 0;
+			}
+		};
+
+		template <typename Tuple, typename F>
+		constexpr auto each(const Tuple& tuple, F&& f) -> void {
+			std::apply([&](const auto&... part) { (f(part), ...); }, tuple);
+		}
+
+		template <typename T>
+		struct is_endpoint : std::false_type {};
+	}  // namespace detail
+
+	struct endpoint {
+		static constexpr std::size_t size = 7;
+
+		bool in;
+		std::uint8_t attributes;
+		std::uint16_t max_packet;
+		std::uint8_t interval;
+		std::uint8_t number;
+
+		constexpr auto reserve(detail::context& ctx) const -> void {
+			if (number != auto_number) {
+				ctx.take(in, number);
+			}
+		}
+
+		template <typename W>
+		constexpr auto write(W& w, detail::context& ctx) const -> void {
+			auto n = number;
+
+			if (n == auto_number) {
+				n = ctx.next_free(in);
+				ctx.take(in, n);
+			}
+			(in ? ctx.in_owner : ctx.out_owner)[n] = ctx.function;
+
+			w.u8(size);
+			w.u8(USB_DESCTYPE_EP);
+			w.u8(in ? (0x80U | n) : n);
+			w.u8(attributes);
+			w.u16(max_packet);
+			w.u8(interval);
+		}
+	};
+
+	namespace detail {
+		template <>
+		struct is_endpoint<endpoint> : std::true_type {};
+	}  // namespace detail
+
+	constexpr auto in(ep_type type, std::uint16_t max_packet, std::uint8_t interval = 0,
+					  std::uint8_t number = auto_number) -> endpoint {
+		return {true, static_cast<std::uint8_t>(type), max_packet, interval, number};
+	}
+
+	constexpr auto out(ep_type type, std::uint16_t max_packet, std::uint8_t interval = 0,
+					   std::uint8_t number = auto_number) -> endpoint {
+		return {false, static_cast<std::uint8_t>(type), max_packet, interval, number};
+	}
+
+	// class-specific descriptor given as its bytes, bLength included
+	template <std::size_t N>
+	struct raw {
+		static constexpr std::size_t size = N;
+
+		std::array<std::uint8_t, N> bytes;
+
+		constexpr auto reserve(detail::context&) const -> void {}
+
+		template <typename W>
+		constexpr auto write(W& w, detail::context&) const -> void {
+			for (auto byte : bytes) {
+				w.u8(byte);
+			}
+		}
+	};
+
+	template <typename... Bytes>
+	constexpr auto class_specific(Bytes... bytes) -> raw<sizeof...(Bytes)> {
+		return {{static_cast<std::uint8_t>(bytes)...}};
+	}
+
+	// HID descriptor with one report descriptor
+	struct hid {
+		static constexpr std::size_t size = 9;
+
+		std::uint16_t bcd_hid;
+		std::uint16_t report_length;
+		std::uint8_t country = 0;
+
+		constexpr auto reserve(detail::context&) const -> void {}
+
+		template <typename W>
+		constexpr auto write(W& w, detail::context&) const -> void {
+			w.u8(size);
+			w.u8(hid_descriptor);
+			w.u16(bcd_hid);
+			w.u8(country);
+			w.u8(1);
+			w.u8(report_descriptor);
+			w.u16(report_length);
+		}
+	};
+
+	// functional descriptors of the CDC communication interface, the data interface is the one
+	// following it in the same function
+	namespace cdc {
+		struct header {
+			static constexpr std::size_t size = 5;
+
+			std::uint16_t bcd_cdc = 0x0110;
+
+			constexpr auto reserve(detail::context&) const -> void {}
+
+			template <typename W>
+			constexpr auto write(W& w, detail::context&) const -> void {
+				w.u8(size);
+				w.u8(cs_interface);
+				w.u8(0x00);
+				w.u16(bcd_cdc);
+			}
+		};
+
+		struct call_management {
+			static constexpr std::size_t size = 5;
+
+			std::uint8_t capabilities = 0;
+
+			constexpr auto reserve(detail::context&) const -> void {}
+
+			template <typename W>
+			constexpr auto write(W& w, detail::context& ctx) const -> void {
+				w.u8(size);
+				w.u8(cs_interface);
+				w.u8(0x01);
+				w.u8(capabilities);
+				w.u8(ctx.first_interface + 1U);
+			}
+		};
+
+		struct acm {
+			static constexpr std::size_t size = 4;
+
+			std::uint8_t capabilities = 0x02;
+
+			constexpr auto reserve(detail::context&) const -> void {}
+
+			template <typename W>
+			constexpr auto write(W& w, detail::context&) const -> void {
+				w.u8(size);
+				w.u8(cs_interface);
+				w.u8(0x02);
+				w.u8(capabilities);
+			}
+		};
+
+		struct union_ {
+			static constexpr std::size_t size = 5;
+
+			constexpr auto reserve(detail::context&) const -> void {}
+
+			template <typename W>
+			constexpr auto write(W& w, detail::context& ctx) const -> void {
+				w.u8(size);
+				w.u8(cs_interface);
+				w.u8(0x06);
+				w.u8(ctx.first_interface);
+				w.u8(ctx.first_interface + 1U);
+			}
+		};
+	}  // namespace cdc
+
+	// an interface, or an alternate setting of the interface before it
+	template <bool Alternate, typename... Parts>
+	struct interface_desc {
+		static constexpr bool alternate = Alternate;
+		static constexpr std::size_t size = 9 + (Parts::size + ... + 0);
+		static constexpr std::uint8_t endpoint_count = (std::uint8_t{detail::is_endpoint<Parts>::value} + ... + 0);
+
+		std::uint8_t setting;
+		std::uint8_t cls;
+		std::uint8_t subclass;
+		std::uint8_t protocol;
+		std::uint8_t string;
+		std::tuple<Parts...> parts;
+
+		// the same interface with a string descriptor index
+		constexpr auto named(std::uint8_t index) const -> interface_desc {
+			auto copy = *this;
+			copy.string = index;
+			return copy;
+		}
+
+		constexpr auto reserve(detail::context& ctx) const -> void {
+			detail::each(parts, [&](const auto& part) { part.reserve(ctx); });
+		}
+
+		template <typename W>
+		constexpr auto write(W& w, detail::context& ctx) const -> void {
+			std::uint8_t number = ctx.interface;
+
+			if constexpr (Alternate) {
+				if (number == 0) {
+					detail::invalid_descriptor("alternate setting without an interface before it");
+				}
+				--number;
+			} else {
+				ctx.interface_owner[number] = ctx.function;
+				++ctx.interface;
+			}
+
+			w.u8(9);
+			w.u8(USB_DESCTYPE_ITF);
+			w.u8(number);
+			w.u8(setting);
+			w.u8(endpoint_count);
+			w.u8(cls);
+			w.u8(subclass);
+			w.u8(protocol);
+			w.u8(string);
+
+			detail::each(parts, [&](const auto& part) { part.write(w, ctx); });
+		}
+	};
+
+	template <typename... Parts>
+	constexpr auto interface(std::uint8_t cls, std::uint8_t subclass, std::uint8_t protocol, Parts... parts)
+		-> interface_desc<false, Parts...> {
+		return {0, cls, subclass, protocol, 0, {parts...}};
+	}
+
+	template <typename... Parts>
+	constexpr auto alternate(std::uint8_t setting, std::uint8_t cls, std::uint8_t subclass, std::uint8_t protocol,
+							 Parts... parts) -> interface_desc<true, Parts...> {
+		return {setting, cls, subclass, protocol, 0, {parts...}};
+	}
+
+	// the interfaces one class driver serves
+	template <typename... Interfaces>
+	struct function_desc {
+		static_assert(sizeof...(Interfaces) > 0, "a function has at least one interface");
+
+		static constexpr std::size_t interface_count = ((Interfaces::alternate ? 0 : 1) + ...);
+		static constexpr std::size_t iad_size = 8;
+
+		// with an interface association descriptor in a composite device
+		template <bool Composite>
+		static constexpr std::size_t size = (Composite && interface_count > 1 ? iad_size : 0) + (Interfaces::size + ...);
+
+		usb_class_core* core;
+		std::tuple<Interfaces...> interfaces;
+
+		constexpr auto reserve(detail::context& ctx) const -> void {
+			detail::each(interfaces, [&](const auto& itf) { itf.reserve(ctx); });
+		}
+
+		template <bool Composite, typename W>
+		constexpr auto write(W& w, detail::context& ctx) const -> void {
+			ctx.first_interface = ctx.interface;
+
+			if constexpr (Composite && interface_count > 1) {
+				const auto& first = std::get<0>(interfaces);
+
+				w.u8(iad_size);
+				w.u8(USB_DESCTYPE_IAD);
+				w.u8(ctx.first_interface);
+				w.u8(interface_count);
+				w.u8(first.cls);
+				w.u8(first.subclass);
+				w.u8(first.protocol);
+				w.u8(0);
+			}
+
+			detail::each(interfaces, [&](const auto& itf) { itf.write(w, ctx); });
+		}
+	};
+
+	template <typename... Interfaces>
+	constexpr auto function(usb_class_core& core, Interfaces... interfaces) -> function_desc<Interfaces...> {
+		return {&core, {interfaces...}};
+	}
+
+	struct config_info {
+		std::uint8_t attributes = 0x80;
+		std::uint8_t max_power = 0x32;
+		std::uint8_t endpoints = max_numbers;       // USBFS_MAX_EP_COUNT or USBHS_MAX_EP_COUNT
+		std::uint8_t value = 1;
+		std::uint8_t string = 0;
+	};
+
+	// function of every interface and endpoint number
+	template <std::size_t Functions>
+	struct dispatch_table {
+		std::array<usb_class_core*, Functions> cores;
+		std::array<std::uint8_t, max_numbers> interface;
+		std::array<std::uint8_t, max_numbers> in;
+		std::array<std::uint8_t, max_numbers> out;
+	};
+
+	template <typename... Functions>
+	struct configuration_desc {
+		static constexpr std::size_t function_count = sizeof...(Functions);
+		static constexpr bool composite = function_count > 1;
+		static constexpr std::size_t interface_count = (Functions::interface_count + ...);
+		static constexpr std::size_t size = 9 + (Functions::template size<composite> + ...);
+
+		static_assert(interface_count <= max_numbers, "too many interfaces");
+		static_assert(size <= 0xFFFF, "configuration longer than wTotalLength");
+
+		config_info info;
+		std::tuple<Functions...> functions;
+
+		constexpr auto bytes() const -> std::array<std::uint8_t, size> {
+			return walk().first.data;
+		}
+
+		constexpr auto dispatch() const -> dispatch_table<function_count> {
+			const auto ctx = walk().second;
+			dispatch_table<function_count> table{};
+
+			std::size_t index = 0;
+			detail::each(functions, [&](const auto& fn) { table.cores[index++] = fn.core; });
+
+			table.interface = ctx.interface_owner;
+			table.in = ctx.in_owner;
+			table.out = ctx.out_owner;
+
+			return table;
+		}
+
+	private:
+		struct result {
+			detail::writer<size> first;
+			detail::context second;
+		};
+
+		constexpr auto walk() const -> result {
+			detail::writer<size> w;
+			detail::context ctx;
+
+			ctx.endpoints = info.endpoints;
+			for (std::size_t i = 0; i < max_numbers; ++i) {
+				ctx.interface_owner[i] = none;
+				ctx.in_owner[i] = none;
+				ctx.out_owner[i] = none;
+			}
+
+			// explicit endpoint numbers first, so that the automatic ones go around them
+			detail::each(functions, [&](const auto& fn) { fn.reserve(ctx); });
+
+			w.u8(9);
+			w.u8(USB_DESCTYPE_CONFIG);
+			w.u16(size);
+			w.u8(interface_count);
+			w.u8(info.value);
+			w.u8(info.string);
+			w.u8(info.attributes);
+			w.u8(info.max_power);
+
+			detail::each(functions, [&](const auto& fn) {
+				fn.template write<composite>(w, ctx);
+				++ctx.function;
+			});
+
+			return {w, ctx};
+		}
+	};
+
+	template <typename... Functions>
+	constexpr auto configuration(const config_info& info, Functions... functions) -> configuration_desc<Functions...> {
+		return {info, {functions...}};
+	}
+
+	struct device_info {
+		std::uint16_t bcd_usb;
+		std::uint8_t cls;
+		std::uint8_t subclass;
+		std::uint8_t protocol;
+		std::uint8_t ep0_size;
+		std::uint16_t vendor;
+		std::uint16_t product;
+		std::uint16_t bcd_device;
+		std::uint8_t manufacturer_string;
+		std::uint8_t product_string;
+		std::uint8_t serial_string;
+		std::uint8_t configurations;
+	};
+
+	constexpr auto device(const device_info& info) -> std::array<std::uint8_t, USB_DEV_DESC_LEN> {
+		detail::writer<USB_DEV_DESC_LEN> w;
+
+		w.u8(USB_DEV_DESC_LEN);
+		w.u8(USB_DESCTYPE_DEV);
+		w.u16(info.bcd_usb);
+		w.u8(info.cls);
+		w.u8(info.subclass);
+		w.u8(info.protocol);
+		w.u8(info.ep0_size);
+		w.u16(info.vendor);
+		w.u16(info.product);
+		w.u16(info.bcd_device);
+		w.u8(info.manufacturer_string);
+		w.u8(info.product_string);
+		w.u8(info.serial_string);
+		w.u8(info.configurations);
+
+		return w.data;
+	}
+
+	constexpr auto language(std::uint16_t langid = ENG_LANGID) -> std::array<std::uint8_t, 4> {
+		return {4, USB_DESCTYPE_STR, static_cast<std::uint8_t>(langid), static_cast<std::uint8_t>(langid >> 8)};
+	}
+
+	// string descriptor of a UTF-16 literal, u"GigaDevice"
+	template <std::size_t N>
+	constexpr auto string(const char16_t (&text)[N]) -> std::array<std::uint8_t, 2 * N> {
+		static_assert(2 * N <= 0xFF, "string longer than bLength");
+
+		detail::writer<2 * N> w;
+
+		w.u8(2 * N);
+		w.u8(USB_DESCTYPE_STR);
+		for (std::size_t i = 0; i + 1 < N; ++i) {
+			w.u16(text[i]);
+		}
+
+		return w.data;
+	}
+
+	// the class driver of a composite device, routing through the dispatch table of its
+	// configuration
+	template <const auto& Table>
+	class composite {
+	public:
+		// the usb_class_core of the device, constant-initialized where it is defined
+		static constexpr auto core() -> usb_class_core {
+			return {
+				0U,
+				0U,
+				init,
+				deinit,
+				req_proc,
+				set_intf,
+				ctlx_in,
+				ctlx_out,
+				data_in,
+				data_out,
+				sof,
+				incomplete_isoc_in,
+				incomplete_isoc_out,
+			};
+		}
+
+	private:
+		static constexpr std::size_t function_count = std::tuple_size_v<decltype(Table.cores)>;
+
+		// function of the last SETUP, its data and status stages go there
+		static inline std::uint8_t control_owner = none;
+
+		static auto owner_core(std::uint8_t function) -> usb_class_core* {
+			return function < function_count ? Table.cores[function] : nullptr;
+		}
+
+		static auto init(usb_dev* udev, std::uint8_t config_index) -> std::uint8_t {
+			std::uint8_t status = USBD_OK;
+
+			for (auto* class_core : Table.cores) {
+				if (class_core->init(udev, config_index) != USBD_OK) {
+					status = USBD_FAIL;
+				}
+			}
+			return status;
+		}
+
+		static auto deinit(usb_dev* udev, std::uint8_t config_index) -> std::uint8_t {
+			for (auto* class_core : Table.cores) {
+				class_core->deinit(udev, config_index);
+			}
+			control_owner = none;
+			return USBD_OK;
+		}
+
+		static auto req_proc(usb_dev* udev, usb_req* req) -> std::uint8_t {
+			const auto index = static_cast<std::uint8_t>(req->wIndex & 0xFFU);
+			const auto number = index & 0x0FU;
+
+			if ((req->bmRequestType & USB_RECPTYPE_MASK) == USB_RECPTYPE_EP) {
+				control_owner = (index & 0x80U) != 0 ? Table.in[number] : Table.out[number];
+			} else {
+				control_owner = index < max_numbers ? Table.interface[index] : none;
+			}
+
+			auto* class_core = owner_core(control_owner);
+			return class_core != nullptr ? class_core->req_proc(udev, req) : static_cast<std::uint8_t>(REQ_NOTSUPP);
+		}
+
+		static auto set_intf(usb_dev* udev, usb_req* req) -> std::uint8_t {
+			const auto index = static_cast<std::uint8_t>(req->wIndex & 0xFFU);
+			auto* class_core = owner_core(index < max_numbers ? Table.interface[index] : none);
+
+			if (class_core != nullptr && class_core->set_intf != nullptr) {
+				return class_core->set_intf(udev, req);
+			}
+			return USBD_OK;
+		}
+
+		static auto ctlx_in(usb_dev* udev) -> std::uint8_t {
+			auto* class_core = owner_core(control_owner);
+
+			if (class_core != nullptr && class_core->ctlx_in != nullptr) {
+				return class_core->ctlx_in(udev);
+			}
+			return USBD_OK;
+		}
+
+		static auto ctlx_out(usb_dev* udev) -> std::uint8_t {
+			auto* class_core = owner_core(control_owner);
+
+			if (class_core != nullptr && class_core->ctlx_out != nullptr) {
+				return class_core->ctlx_out(udev);
+			}
+			return USBD_OK;
+		}
+
+		static auto data_in(usb_dev* udev, std::uint8_t ep_num) -> std::uint8_t {
+			auto* class_core = owner_core(Table.in[ep_num & 0x0FU]);
+
+			if (class_core != nullptr && class_core->data_in != nullptr) {
+				return class_core->data_in(udev, ep_num);
+			}
+			return USBD_OK;
+		}
+
+		static auto data_out(usb_dev* udev, std::uint8_t ep_num) -> std::uint8_t {
+			auto* class_core = owner_core(Table.out[ep_num & 0x0FU]);
+
+			if (class_core != nullptr && class_core->data_out != nullptr) {
+				return class_core->data_out(udev, ep_num);
+			}
+			return USBD_OK;
+		}
+
+		static auto sof(usb_dev* udev) -> std::uint8_t {
+			for (auto* class_core : Table.cores) {
+				if (class_core->SOF != nullptr) {
+					class_core->SOF(udev);
+				}
+			}
+			return USBD_OK;
+		}
+
+		static auto incomplete_isoc_in(usb_dev* udev) -> std::uint8_t {
+			for (auto* class_core : Table.cores) {
+				if (class_core->incomplete_isoc_in != nullptr) {
+					class_core->incomplete_isoc_in(udev);
+				}
+			}
+			return USBD_OK;
+		}
+
+		static auto incomplete_isoc_out(usb_dev* udev) -> std::uint8_t {
+			for (auto* class_core : Table.cores) {
+				if (class_core->incomplete_isoc_out != nullptr) {
+					class_core->incomplete_isoc_out(udev);
+				}
+			}
+			return USBD_OK;
+		}
+	};
+}  // namespace usbd::desc
+
+#endif /* USBD_DESC_HPP */
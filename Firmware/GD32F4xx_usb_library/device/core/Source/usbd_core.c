@@ -204,6 +204,21 @@ uint32_t usbd_ep_send(usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uin
 
     if((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
         transc->dma_addr = (uint32_t)pbuf;
+
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+        /* the DMA reads words, endpoint 0 also answers from single bytes of the core and the
+           classes (status, configuration, alternate setting), it sends one packet at a time */
+        if((0U == EP_ID(ep_addr)) && (0U != ((uint32_t)pbuf & 0x3U))) {
+            uint8_t *dst = (uint8_t *)udev->dev.control.in_buf;
+            uint32_t i, n = USB_MIN(len, (uint32_t)sizeof(udev->dev.control.in_buf));
+
+            for(i = 0U; i < n; i++) {
+                dst[i] = pbuf[i];
+            }
+
+            transc->dma_addr = (uint32_t)dst;
+        }
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
     }
 
     /* start the transfer */
@@ -117,6 +117,11 @@ typedef struct _usb_pm {
 
 /* USB control information */
 typedef struct _usb_control {
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+    uint32_t   setup_buf[6];                                                    /*!< DMA destination of up to 3 back-to-back SETUP packets */
+    uint32_t   in_buf[USB_FS_EP0_MAX_LEN / 4U];                                 /*!< word aligned copy of endpoint 0 IN data the DMA cannot read */
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
+
     usb_req    req;                                                             /*!< USB standard device request */
 
     uint8_t    ctl_state;                                                       /*!< USB control transfer state */
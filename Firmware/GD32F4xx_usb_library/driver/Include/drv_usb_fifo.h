@@ -0,0 +1,381 @@
+/*!
+    \file    drv_usb_fifo.h
+    \brief   copy kernels between the data FIFOs of the USB cores and memory
+
+    A FIFO moves 32 bit words, the buffers of the class drivers are byte arrays at any address.
+    Word aligned buffers are copied with aligned loads and stores, unrolled USB_FIFO_UNROLL
+    times. A buffer that does not start on a word boundary is read or written with aligned
+    accesses too: the bytes up to the next boundary go through a carry word, every aligned
+    word of the buffer is shifted into place against the carry. The last 1 to 3 bytes are
+    copied one by one, so neither direction reads or writes beyond the buffer, unlike a
+    __packed word access per FIFO word.
+
+    usb_fifo_write() and usb_fifo_read() pick the kernel by the address of the buffer. The
+    transfer buffers of the class drivers and the packed SETUP request give no alignment by
+    their type, so the check is made at run time, a test and a branch per packet.
+*/
+
+#ifndef DRV_USB_FIFO_H
+#define DRV_USB_FIFO_H
+
+#include "drv_usb_regs.h"
+
+/* aligned kernels copy 8 or 4 words per loop */
+#ifndef USB_FIFO_UNROLL
+    #define USB_FIFO_UNROLL                 8U
+#endif /* USB_FIFO_UNROLL */
+
+/* access to the FIFO register, a host test replaces them with a model of the FIFO */
+#ifndef USB_FIFO_PUT
+    #define USB_FIFO_PUT(fifo, word)        (*(fifo) = (word))
+#endif /* USB_FIFO_PUT */
+
+#ifndef USB_FIFO_GET
+    #define USB_FIFO_GET(fifo)              (*(fifo))
+#endif /* USB_FIFO_GET */
+
+/*!
+    \brief      gather up to 4 bytes into a word, the first byte in the low bits
+    \param[in]  src: bytes
+    \param[in]  n: number of bytes, 0 to 4
+    \param[out] none
+    \retval     word
+*/
+__STATIC_INLINE uint32_t usb_fifo_bytes_load(const uint8_t *src, uint32_t n)
+{
+    uint32_t word = 0U;
+
+    switch(n) {
+    case 4U:
+        word |= (uint32_t)src[3] << 24;
+        /* fall through */
+    case 3U:
+        word |= (uint32_t)src[2] << 16;
+        /* fall through */
+    case 2U:
+        word |= (uint32_t)src[1] << 8;
+        /* fall through */
+    case 1U:
+        word |= (uint32_t)src[0];
+        break;
+
+    default:
+        break;
+    }
+
+    return word;
+}
+
+/*!
+    \brief      scatter the low bytes of a word, the low bits to the first byte
+    \param[in]  dst: bytes
+    \param[in]  word: word
+    \param[in]  n: number of bytes, 0 to 4
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_bytes_store(uint8_t *dst, uint32_t word, uint32_t n)
+{
+    switch(n) {
+    case 4U:
+        dst[3] = (uint8_t)(word >> 24);
+        /* fall through */
+    case 3U:
+        dst[2] = (uint8_t)(word >> 16);
+        /* fall through */
+    case 2U:
+        dst[1] = (uint8_t)(word >> 8);
+        /* fall through */
+    case 1U:
+        dst[0] = (uint8_t)word;
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*!
+    \brief      write whole words of an aligned buffer to a FIFO
+    \param[in]  fifo: FIFO register
+    \param[in]  src: aligned buffer
+    \param[in]  words: number of words
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_words_write(__IO uint32_t *fifo, const uint32_t *src, uint32_t words)
+{
+#if (USB_FIFO_UNROLL >= 8U)
+    while(words >= 8U) {
+        USB_FIFO_PUT(fifo, src[0]);
+        USB_FIFO_PUT(fifo, src[1]);
+        USB_FIFO_PUT(fifo, src[2]);
+        USB_FIFO_PUT(fifo, src[3]);
+        USB_FIFO_PUT(fifo, src[4]);
+        USB_FIFO_PUT(fifo, src[5]);
+        USB_FIFO_PUT(fifo, src[6]);
+        USB_FIFO_PUT(fifo, src[7]);
+        src += 8U;
+        words -= 8U;
+    }
+#endif /* USB_FIFO_UNROLL >= 8U */
+
+    while(words >= 4U) {
+        USB_FIFO_PUT(fifo, src[0]);
+        USB_FIFO_PUT(fifo, src[1]);
+        USB_FIFO_PUT(fifo, src[2]);
+        USB_FIFO_PUT(fifo, src[3]);
+        src += 4U;
+        words -= 4U;
+    }
+
+    while(words-- > 0U) {
+        USB_FIFO_PUT(fifo, *src++);
+    }
+}
+
+/*!
+    \brief      read whole words from a FIFO into an aligned buffer
+    \param[in]  fifo: FIFO register
+    \param[in]  dst: aligned buffer
+    \param[in]  words: number of words
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_words_read(__IO uint32_t *fifo, uint32_t *dst, uint32_t words)
+{
+#if (USB_FIFO_UNROLL >= 8U)
+    while(words >= 8U) {
+        dst[0] = USB_FIFO_GET(fifo);
+        dst[1] = USB_FIFO_GET(fifo);
+        dst[2] = USB_FIFO_GET(fifo);
+        dst[3] = USB_FIFO_GET(fifo);
+        dst[4] = USB_FIFO_GET(fifo);
+        dst[5] = USB_FIFO_GET(fifo);
+        dst[6] = USB_FIFO_GET(fifo);
+        dst[7] = USB_FIFO_GET(fifo);
+        dst += 8U;
+        words -= 8U;
+    }
+#endif /* USB_FIFO_UNROLL >= 8U */
+
+    while(words >= 4U) {
+        dst[0] = USB_FIFO_GET(fifo);
+        dst[1] = USB_FIFO_GET(fifo);
+        dst[2] = USB_FIFO_GET(fifo);
+        dst[3] = USB_FIFO_GET(fifo);
+        dst += 4U;
+        words -= 4U;
+    }
+
+    while(words-- > 0U) {
+        *dst++ = USB_FIFO_GET(fifo);
+    }
+}
+
+/*!
+    \brief      write a packet from a word aligned buffer to a FIFO
+    \param[in]  fifo: FIFO register
+    \param[in]  src: aligned buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_write_aligned(__IO uint32_t *fifo, const uint32_t *src, uint32_t bytes)
+{
+    usb_fifo_words_write(fifo, src, bytes / 4U);
+
+    if(0U != (bytes & 3U)) {
+        USB_FIFO_PUT(fifo, usb_fifo_bytes_load((const uint8_t *)&src[bytes / 4U], bytes & 3U));
+    }
+}
+
+/*!
+    \brief      read a packet from a FIFO into a word aligned buffer
+    \param[in]  fifo: FIFO register
+    \param[in]  dst: aligned buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_read_aligned(__IO uint32_t *fifo, uint32_t *dst, uint32_t bytes)
+{
+    usb_fifo_words_read(fifo, dst, bytes / 4U);
+
+    if(0U != (bytes & 3U)) {
+        usb_fifo_bytes_store((uint8_t *)&dst[bytes / 4U], USB_FIFO_GET(fifo), bytes & 3U);
+    }
+}
+
+/*!
+    \brief      write a packet from a buffer that does not start on a word boundary to a FIFO
+    \param[in]  fifo: FIFO register
+    \param[in]  src: unaligned buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_write_unaligned(__IO uint32_t *fifo, const uint8_t *src, uint32_t bytes)
+{
+    /* bytes up to the next word boundary, the carry holds them in its low bits */
+    uint32_t head = 4U - ((uintptr_t)src & 3U);
+    uint32_t shift = 8U * head;
+    uint32_t words, rest, carry, word;
+    const uint32_t *aligned;
+    const uint8_t *tail;
+
+    if(bytes < 4U) {
+        if(0U != bytes) {
+            USB_FIFO_PUT(fifo, usb_fifo_bytes_load(src, bytes));
+        }
+        return;
+    }
+
+    carry = usb_fifo_bytes_load(src, head);
+    aligned = (const uint32_t *)(src + head);
+
+    /* aligned words that lie inside the buffer */
+    words = (bytes - head) / 4U;
+    rest = bytes - head - 4U * words;
+
+    while(words >= 4U) {
+        word = aligned[0];
+        USB_FIFO_PUT(fifo, carry | (word << shift));
+        carry = word >> (32U - shift);
+        word = aligned[1];
+        USB_FIFO_PUT(fifo, carry | (word << shift));
+        carry = word >> (32U - shift);
+        word = aligned[2];
+        USB_FIFO_PUT(fifo, carry | (word << shift));
+        carry = word >> (32U - shift);
+        word = aligned[3];
+        USB_FIFO_PUT(fifo, carry | (word << shift));
+        carry = word >> (32U - shift);
+        aligned += 4U;
+        words -= 4U;
+    }
+
+    while(words-- > 0U) {
+        word = *aligned++;
+        USB_FIFO_PUT(fifo, carry | (word << shift));
+        carry = word >> (32U - shift);
+    }
+
+    /* the carry and the last 0 to 3 bytes make one or two more words */
+    tail = (const uint8_t *)aligned;
+
+    if(rest >= 4U - head) {
+        USB_FIFO_PUT(fifo, carry | (usb_fifo_bytes_load(tail, 4U - head) << shift));
+        tail += 4U - head;
+        rest -= 4U - head;
+
+        if(0U != rest) {
+            USB_FIFO_PUT(fifo, usb_fifo_bytes_load(tail, rest));
+        }
+    } else {
+        USB_FIFO_PUT(fifo, carry | (usb_fifo_bytes_load(tail, rest) << shift));
+    }
+}
+
+/*!
+    \brief      read a packet from a FIFO into a buffer that does not start on a word boundary
+    \param[in]  fifo: FIFO register
+    \param[in]  dst: unaligned buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_read_unaligned(__IO uint32_t *fifo, uint8_t *dst, uint32_t bytes)
+{
+    /* bytes up to the next word boundary, the carry holds the rest of the FIFO word */
+    uint32_t head = 4U - ((uintptr_t)dst & 3U);
+    uint32_t shift = 8U * head;
+    uint32_t words, rest, carry, word;
+    uint32_t *aligned;
+    uint8_t *tail;
+
+    if(bytes < 4U) {
+        if(0U != bytes) {
+            usb_fifo_bytes_store(dst, USB_FIFO_GET(fifo), bytes);
+        }
+        return;
+    }
+
+    word = USB_FIFO_GET(fifo);
+    usb_fifo_bytes_store(dst, word, head);
+    carry = word >> shift;
+    aligned = (uint32_t *)(dst + head);
+
+    /* aligned words that lie inside the buffer */
+    words = (bytes - head) / 4U;
+    rest = bytes - head - 4U * words;
+
+    while(words >= 4U) {
+        word = USB_FIFO_GET(fifo);
+        aligned[0] = carry | (word << (32U - shift));
+        carry = word >> shift;
+        word = USB_FIFO_GET(fifo);
+        aligned[1] = carry | (word << (32U - shift));
+        carry = word >> shift;
+        word = USB_FIFO_GET(fifo);
+        aligned[2] = carry | (word << (32U - shift));
+        carry = word >> shift;
+        word = USB_FIFO_GET(fifo);
+        aligned[3] = carry | (word << (32U - shift));
+        carry = word >> shift;
+        aligned += 4U;
+        words -= 4U;
+    }
+
+    while(words-- > 0U) {
+        word = USB_FIFO_GET(fifo);
+        *aligned++ = carry | (word << (32U - shift));
+        carry = word >> shift;
+    }
+
+    /* the carry holds 4 - head more bytes, a longer rest needs the last FIFO word */
+    tail = (uint8_t *)aligned;
+
+    if(rest <= 4U - head) {
+        usb_fifo_bytes_store(tail, carry, rest);
+    } else {
+        usb_fifo_bytes_store(tail, carry, 4U - head);
+        usb_fifo_bytes_store(tail + 4U - head, USB_FIFO_GET(fifo), rest - (4U - head));
+    }
+}
+
+/*!
+    \brief      write a packet from a byte buffer to a FIFO, the address selects the kernel
+    \param[in]  fifo: FIFO register
+    \param[in]  src: buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_write(__IO uint32_t *fifo, const uint8_t *src, uint32_t bytes)
+{
+    if(0U == ((uintptr_t)src & 3U)) {
+        usb_fifo_write_aligned(fifo, (const uint32_t *)src, bytes);
+    } else {
+        usb_fifo_write_unaligned(fifo, src, bytes);
+    }
+}
+
+/*!
+    \brief      read a packet from a FIFO into a byte buffer, the address selects the kernel
+    \param[in]  fifo: FIFO register
+    \param[in]  dst: buffer
+    \param[in]  bytes: packet length
+    \param[out] none
+    \retval     none
+*/
+__STATIC_INLINE void usb_fifo_read(__IO uint32_t *fifo, uint8_t *dst, uint32_t bytes)
+{
+    if(0U == ((uintptr_t)dst & 3U)) {
+        usb_fifo_read_aligned(fifo, (uint32_t *)dst, bytes);
+    } else {
+        usb_fifo_read_unaligned(fifo, dst, bytes);
+    }
+}
+
+#endif /* DRV_USB_FIFO_H */
@@ -34,6 +34,7 @@ OF SUCH DAMAGE.
 
 #include "drv_usb_core.h"
 #include "drv_usb_hw.h"
+#include "drv_usb_fifo.h"
 
 /* local function prototypes ('static') */
 static void usb_core_reset(usb_core_regs *usb_regs);
@@ -225,40 +226,25 @@ usb_status usb_txfifo_write(usb_core_regs *usb_regs, \
                             uint8_t  fifo_num, \
                             uint16_t byte_count)
 {
-    uint32_t word_count = (byte_count + 3U) / 4U;
-
-    __IO uint32_t *fifo = usb_regs->DFIFO[fifo_num];
-
-    while(word_count-- > 0U) {
-        *fifo = *((__packed uint32_t *)src_buf);
-
-        src_buf += 4U;
-    }
+    usb_fifo_write(usb_regs->DFIFO[fifo_num], src_buf, byte_count);
 
     return USB_OK;
 }
 
 /*!
-    \brief      read a packet from the RX FIFO associated with the endpoint
+    \brief      read a packet from the RX FIFO associated with the endpoint, only byte_count
+                bytes of the destination buffer are written
     \param[in]  usb_regs: pointer to USB core registers
     \param[in]  dest_buf: pointer to destination buffer
     \param[in]  byte_count: packet byte count
     \param[out] none
-    \retval     void type pointer
+    \retval     void type pointer behind the packet
 */
 void *usb_rxfifo_read(usb_core_regs *usb_regs, uint8_t *dest_buf, uint16_t byte_count)
 {
-    uint32_t word_count = (byte_count + 3U) / 4U;
-
-    __IO uint32_t *fifo = usb_regs->DFIFO[0];
-
-    while(word_count-- > 0U) {
-        *(__packed uint32_t *)dest_buf = *fifo;
-
-        dest_buf += 4U;
-    }
+    usb_fifo_read(usb_regs->DFIFO[0], dest_buf, byte_count);
 
-    return ((void *)dest_buf);
+    return ((void *)(dest_buf + byte_count));
 }
 
 /*!
@@ -564,7 +564,11 @@ void usb_ctlep_startout(usb_core_driver *udev)
     udev->regs.er_out[0]->DOEPLEN = DOEP0_TLEN(8U * 3U) | DOEP0_PCNT(1U) | DOEP0_STPCNT(3U);
 
     if((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
-        udev->regs.er_out[0]->DOEPDMAADDR = (uint32_t)&udev->dev.control.req;
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+        /* the DMA stores every SETUP packet of the 3 behind the previous one, usbd_int_epout()
+           copies the last one to the request */
+        udev->regs.er_out[0]->DOEPDMAADDR = (uint32_t)udev->dev.control.setup_buf;
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
 
         /* endpoint enable */
         udev->regs.er_out[0]->DOEPCTL |= DEPCTL_EPACT | DEPCTL_EPEN;
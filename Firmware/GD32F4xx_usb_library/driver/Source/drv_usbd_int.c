@@ -50,6 +50,9 @@ static uint32_t usbd_int_reset(usb_core_driver *udev);
 static uint32_t usbd_int_enumfinish(usb_core_driver *udev);
 static uint32_t usbd_int_suspend(usb_core_driver *udev);
 static uint32_t usbd_emptytxfifo_write(usb_core_driver *udev, uint32_t ep_num);
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+static void usbd_setup_dma_fetch(usb_core_driver *udev);
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
 
 /*!
     \brief      USB device-mode interrupts global service routine handler
@@ -218,6 +221,10 @@ uint32_t usbd_int_dedicated_ep1in(usb_core_driver *udev)
 
         udev->regs.er_in[1]->DIEPINTF = DIEPINTF_TF;
 
+        if(USB_USE_DMA == udev->bp.transfer_mode) {
+            udev->dev.transc_in[1].xfer_count = udev->dev.transc_in[1].xfer_len;
+        }
+
         /* TX complete */
         usbd_in_transc(udev, 1U);
     }
@@ -273,6 +280,12 @@ static uint32_t usbd_int_epout(usb_core_driver *udev)
 
             /* SETUP phase finished interrupt (control endpoints) */
             if(oepintr & DOEPINTF_STPF) {
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+                if((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
+                    usbd_setup_dma_fetch(udev);
+                }
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
+
                 /* inform the upper layer that a SETUP packet is available */
                 (void)usbd_setup_transc(udev);
 
@@ -302,6 +315,11 @@ static uint32_t usbd_int_epin(usb_core_driver *udev)
             if(iepintr & DIEPINTF_TF) {
                 udev->regs.er_in[ep_num]->DIEPINTF = DIEPINTF_TF;
 
+                if((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
+                    /* the DMA sent all of it, the FIFO mode counts it in usbd_emptytxfifo_write() */
+                    udev->dev.transc_in[ep_num].xfer_count = udev->dev.transc_in[ep_num].xfer_len;
+                }
+
                 /* data transmission is completed */
                 (void)usbd_in_transc(udev, ep_num);
 
@@ -589,3 +607,33 @@ static uint32_t usbd_emptytxfifo_write(usb_core_driver *udev, uint32_t ep_num)
 
     return 1U;
 }
+
+#ifdef USB_HS_INTERNAL_DMA_ENABLED
+
+/*!
+    \brief      copy the last SETUP packet the DMA received to the request
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+static void usbd_setup_dma_fetch(usb_core_driver *udev)
+{
+    /* the SETUP count counts down from 3 with every packet, a host that retries a request
+       before the device answered leaves more than one in the buffer */
+    uint32_t count = 3U - ((udev->regs.er_out[0]->DOEPLEN & DOEP0LEN_STPCNT) >> 29U);
+    uint8_t *src, *dst;
+    uint32_t i;
+
+    if(0U == count) {
+        count = 1U;
+    }
+
+    src = (uint8_t *)&udev->dev.control.setup_buf[(count - 1U) * 2U];
+    dst = (uint8_t *)&udev->dev.control.req;
+
+    for(i = 0U; i < USB_SETUP_PACKET_LEN; i++) {
+        dst[i] = src[i];
+    }
+}
+
+#endif /* USB_HS_INTERNAL_DMA_ENABLED */
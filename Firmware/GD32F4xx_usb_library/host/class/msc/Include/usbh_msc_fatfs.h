@@ -0,0 +1,60 @@
+/*!
+    \file    usbh_msc_fatfs.h
+    \brief   FatFs disk I/O driver for the logical units of a USB mass storage device
+*/
+
+#ifndef USBH_MSC_FATFS_H
+#define USBH_MSC_FATFS_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* sectors of the first READ(10) and WRITE(10) commands, halved while the device rejects them */
+#ifndef USBH_MSC_FATFS_MAX_SECTORS
+#define USBH_MSC_FATFS_MAX_SECTORS      128U
+#endif /* USBH_MSC_FATFS_MAX_SECTORS */
+
+/* sectors of the read-ahead window of sequential reads, 0 reads each call from the device */
+#ifndef USBH_MSC_FATFS_READ_SECTORS
+#define USBH_MSC_FATFS_READ_SECTORS     16U
+#endif /* USBH_MSC_FATFS_READ_SECTORS */
+
+/* sectors of the buffer that collects sequential writes until CTRL_SYNC, 0 writes each call through */
+#ifndef USBH_MSC_FATFS_WRITE_SECTORS
+#define USBH_MSC_FATFS_WRITE_SECTORS    32U
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS */
+
+/* statistics of the USB disk driver */
+typedef struct {
+    uint32_t reads;                                     /*!< disk_read calls */
+    uint32_t writes;                                    /*!< disk_write calls */
+    uint32_t read_commands;                             /*!< READ(10) commands */
+    uint32_t write_commands;                            /*!< WRITE(10) commands */
+    uint32_t sectors_read;                              /*!< sectors of the READ(10) commands */
+    uint32_t sectors_written;                           /*!< sectors of the WRITE(10) commands */
+    uint32_t read_hits;                                 /*!< sectors served from the read-ahead window */
+    uint32_t read_ahead;                                /*!< sectors read ahead of the requests */
+    uint32_t write_batches;                             /*!< flushes of the write buffer */
+    uint32_t sectors_copied;                            /*!< sectors copied between FatFs and the buffers */
+    uint32_t rejects;                                   /*!< commands the device rejected as too long */
+    uint32_t max_sectors;                               /*!< sectors per command after the last reject */
+    uint32_t errors;                                    /*!< failed commands */
+} usbh_msc_fatfs_stats_struct;
+
+/* driver for FATFS_LinkDriverEx(), the lun of the link is the logical unit of the device */
+extern const Diskio_drvTypeDef USBH_MSC_Driver;
+
+/* function declarations */
+/* forget the buffered sectors and the state of a removed device */
+void usbh_msc_fatfs_reset(void);
+/* read the statistics of the USB disk driver */
+void usbh_msc_fatfs_stats_get(usbh_msc_fatfs_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USBH_MSC_FATFS_H */
@@ -91,6 +91,7 @@ usbh_status usbh_msc_read(usbh_host *uhost, \
                           uint32_t length)
 {
     uint32_t timeout = 0U;
+    usbh_status status = USBH_BUSY;
     usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
     usb_core_driver *udev = (usb_core_driver *)uhost->data;
 
@@ -108,7 +109,8 @@ usbh_status usbh_msc_read(usbh_host *uhost, \
 
     timeout = uhost->control.timer;
 
-    while(USBH_BUSY == usbh_msc_rdwr_process(uhost, lun)) {
+    /* a failed command ends with its sense data in the unit */
+    while(USBH_BUSY == (status = usbh_msc_rdwr_process(uhost, lun))) {
         if(((uhost->control.timer - timeout) > (10000U * length)) || (0U == udev->host.connect_status)) {
             msc->state = MSC_IDLE;
             return USBH_FAIL;
@@ -117,7 +119,7 @@ usbh_status usbh_msc_read(usbh_host *uhost, \
 
     msc->state = MSC_IDLE;
 
-    return USBH_OK;
+    return status;
 }
 
 /*!
@@ -137,6 +139,7 @@ usbh_status usbh_msc_write(usbh_host *uhost, \
                            uint32_t length)
 {
     uint32_t timeout = 0U;
+    usbh_status status = USBH_BUSY;
     usb_core_driver *udev = (usb_core_driver *)uhost->data;
     usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
 
@@ -154,7 +157,8 @@ usbh_status usbh_msc_write(usbh_host *uhost, \
 
     timeout = uhost->control.timer;
 
-    while(USBH_BUSY == usbh_msc_rdwr_process(uhost, lun)) {
+    /* a failed command ends with its sense data in the unit */
+    while(USBH_BUSY == (status = usbh_msc_rdwr_process(uhost, lun))) {
         if(((uhost->control.timer - timeout) > (10000U * length)) || (0U == udev->host.connect_status)) {
             msc->state = MSC_IDLE;
             return USBH_FAIL;
@@ -163,7 +167,7 @@ usbh_status usbh_msc_write(usbh_host *uhost, \
 
     msc->state = MSC_IDLE;
 
-    return USBH_OK;
+    return status;
 }
 
 /*!
@@ -1,6 +1,15 @@
 /*!
     \file    usbh_msc_fatfs.c
-    \brief   USB MSC host FATFS related functions
+    \brief   FatFs disk I/O driver for the logical units of a USB mass storage device
+
+    Every READ(10) and WRITE(10) is a full BOT transaction with its CBW, data and CSW, so the
+    driver moves as many sectors per command as it can. Calls of FatFs are carried out as
+    commands of up to USBH_MSC_FATFS_MAX_SECTORS, a device that rejects the length with an
+    ILLEGAL REQUEST gets the command again at half the length, and the length it took is kept
+    for the unit. Single sector reads that continue the previous read fill a read-ahead window
+    of USBH_MSC_FATFS_READ_SECTORS, and writes that follow each other are collected up to
+    USBH_MSC_FATFS_WRITE_SECTORS until the buffer is full, a write goes elsewhere, the sectors
+    are read back or FatFs syncs.
 
     \version 2024-12-20, V3.3.1, firmware for GD32F4xx
 */
@@ -32,179 +41,465 @@ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSI
 OF SUCH DAMAGE.
 */
 
-#include "diskio.h"
+#include "usbh_msc_fatfs.h"
 #include "usbh_msc_core.h"
-
-static volatile DSTATUS state = STA_NOINIT; /* disk status */
+#include <string.h>
+
+/* the buffers hold sectors of FatFs, which is built with FF_MAX_SS of 512 */
+#define USBH_MSC_FATFS_SECTOR_SIZE      512U
+
+/* sectors of one logical unit held in a buffer */
+typedef struct {
+    BYTE  lun;                                          /*!< logical unit of the sectors */
+    DWORD sector;                                       /*!< first sector */
+    UINT  count;                                        /*!< number of sectors, 0 if empty */
+} usbh_msc_fatfs_range_struct;
+
+static uint8_t usbh_msc_disk_ready[MSC_MAX_SUPPORTED_LUN];
+static DWORD usbh_msc_disk_sectors[MSC_MAX_SUPPORTED_LUN];
+static UINT usbh_msc_disk_max[MSC_MAX_SUPPORTED_LUN];
+static DWORD usbh_msc_disk_next[MSC_MAX_SUPPORTED_LUN];
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+static usbh_msc_fatfs_range_struct usbh_msc_window;
+static uint32_t usbh_msc_window_buf[USBH_MSC_FATFS_READ_SECTORS * USBH_MSC_FATFS_SECTOR_SIZE / 4U];
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+static usbh_msc_fatfs_range_struct usbh_msc_batch;
+static uint32_t usbh_msc_batch_buf[USBH_MSC_FATFS_WRITE_SECTORS * USBH_MSC_FATFS_SECTOR_SIZE / 4U];
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
+static usbh_msc_fatfs_stats_struct usbh_msc_disk_stats;
 
 extern usbh_host usb_host_msc;
 
+static DSTATUS usbh_msc_disk_initialize(BYTE lun);
+static DSTATUS usbh_msc_disk_status(BYTE lun);
+static DRESULT usbh_msc_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+static DRESULT usbh_msc_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+static DRESULT usbh_msc_disk_ioctl(BYTE lun, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef USBH_MSC_Driver = {
+    usbh_msc_disk_initialize,
+    usbh_msc_disk_status,
+    usbh_msc_disk_read,
+#if _USE_WRITE == 1
+    usbh_msc_disk_write,
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+    usbh_msc_disk_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
 /*!
-    \brief      initialize the disk drive
-    \param[in]  drv: physical drive number (0)
+    \brief      forget the buffered sectors and the state of a removed device
+    \param[in]  none
     \param[out] none
-    \retval     operation status
+    \retval     none
 */
-DSTATUS disk_initialize(BYTE drv)
+void usbh_msc_fatfs_reset(void)
+{
+    memset(usbh_msc_disk_ready, 0U, sizeof(usbh_msc_disk_ready));
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+    usbh_msc_window.count = 0U;
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+    usbh_msc_batch.count = 0U;
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
+}
+
+/*!
+    \brief      read the statistics of the USB disk driver
+    \param[in]  none
+    \param[out] stats: statistics since the start
+    \retval     none
+*/
+void usbh_msc_fatfs_stats_get(usbh_msc_fatfs_stats_struct *stats)
+{
+    memcpy(stats, &usbh_msc_disk_stats, sizeof(usbh_msc_fatfs_stats_struct));
+}
+
+#if (USBH_MSC_FATFS_READ_SECTORS > 0U) || (USBH_MSC_FATFS_WRITE_SECTORS > 0U)
+
+/*!
+    \brief      check if a buffer holds sectors of a range
+    \param[in]  range: sectors of the buffer
+    \param[in]  lun: logical unit number
+    \param[in]  sector: first sector of the range
+    \param[in]  count: number of sectors of the range
+    \param[out] none
+    \retval     1 if the range overlaps the buffer, 0 otherwise
+*/
+static uint8_t usbh_msc_disk_overlap(const usbh_msc_fatfs_range_struct *range, BYTE lun, DWORD sector, UINT count)
+{
+    return (uint8_t)((0U != range->count) && (lun == range->lun) && \
+                     (sector < range->sector + range->count) && (range->sector < sector + count));
+}
+
+#endif /* (USBH_MSC_FATFS_READ_SECTORS > 0U) || (USBH_MSC_FATFS_WRITE_SECTORS > 0U) */
+
+/*!
+    \brief      check that the host runs the class of the device and set a logical unit up on
+                first use, FatFs initializes a drive only once and a stick may have been
+                replaced after usbh_msc_fatfs_reset() since
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS usbh_msc_disk_check(BYTE lun)
 {
     usb_core_driver *udev = (usb_core_driver *)usb_host_msc.data;
+    msc_lun info;
+
+    if(lun >= MSC_MAX_SUPPORTED_LUN) {
+        return STA_NOINIT;
+    }
+
+    if((0U == udev->host.connect_status) || (HOST_CLASS_HANDLER != usb_host_msc.cur_state)) {
+        usbh_msc_fatfs_reset();
+        return STA_NOINIT;
+    }
+
+    if(0U == usbh_msc_disk_ready[lun]) {
+        /* the error of the unit stays set after any failed command, a unit without a READ
+           CAPACITY(10) has no block size */
+        if((USBH_OK != usbh_msc_lun_info_get(&usb_host_msc, lun, &info)) || \
+           (USBH_MSC_FATFS_SECTOR_SIZE != info.capacity.block_size)) {
+            return STA_NOINIT;
+        }
+
+        /* READ CAPACITY(10) reports the last sector */
+        usbh_msc_disk_sectors[lun] = info.capacity.block_nbr + 1U;
+        usbh_msc_disk_max[lun] = USBH_MSC_FATFS_MAX_SECTORS;
+        usbh_msc_disk_next[lun] = 0xFFFFFFFFU;
+        usbh_msc_disk_stats.max_sectors = USBH_MSC_FATFS_MAX_SECTORS;
+        usbh_msc_disk_ready[lun] = 1U;
+    }
+
+    return 0U;
+}
+
+/*!
+    \brief      move sectors with READ(10) or WRITE(10) commands of the length the device takes
+    \param[in]  lun: logical unit number
+    \param[in]  buff: data of count sectors
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  write: 1 for WRITE(10), 0 for READ(10)
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT usbh_msc_disk_transfer(BYTE lun, BYTE *buff, DWORD sector, UINT count, uint8_t write)
+{
+    usbh_status status;
+    msc_lun info;
+    UINT chunk;
+
+    while(count > 0U) {
+        chunk = (count > usbh_msc_disk_max[lun]) ? usbh_msc_disk_max[lun] : count;
+
+        if(write) {
+            usbh_msc_disk_stats.write_commands++;
+            status = usbh_msc_write(&usb_host_msc, lun, sector, buff, chunk);
+        } else {
+            usbh_msc_disk_stats.read_commands++;
+            status = usbh_msc_read(&usb_host_msc, lun, sector, buff, chunk);
+        }
+
+        if(USBH_OK != status) {
+            /* the stack does not ask for the Block Limits page, a device tells the length it
+               takes only by rejecting longer commands */
+            if((chunk > 1U) && (USBH_OK == usbh_msc_lun_info_get(&usb_host_msc, lun, &info)) && \
+               (ILLEGAL_REQUEST == info.sense.SenseKey) && (ADDRESS_OUT_OF_RANGE != info.sense.ASC)) {
+                usbh_msc_disk_max[lun] = chunk / 2U;
+                usbh_msc_disk_stats.max_sectors = chunk / 2U;
+                usbh_msc_disk_stats.rejects++;
+                continue;
+            }
+
+            usbh_msc_disk_stats.errors++;
+            return RES_ERROR;
+        }
+
+        if(write) {
+            usbh_msc_disk_stats.sectors_written += chunk;
+        } else {
+            usbh_msc_disk_stats.sectors_read += chunk;
+        }
+
+        buff += chunk * USBH_MSC_FATFS_SECTOR_SIZE;
+        sector += chunk;
+        count -= chunk;
+    }
+
+    return RES_OK;
+}
+
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+
+/*!
+    \brief      write the collected sectors to the device
+    \param[in]  none
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT usbh_msc_disk_flush(void)
+{
+    DRESULT res = RES_OK;
 
-    if(udev->host.connect_status) {
-        state &= ~STA_NOINIT;
+    if(0U != usbh_msc_batch.count) {
+        res = usbh_msc_disk_transfer(usbh_msc_batch.lun, (BYTE *)usbh_msc_batch_buf, \
+                                     usbh_msc_batch.sector, usbh_msc_batch.count, 1U);
+        usbh_msc_batch.count = 0U;
+        usbh_msc_disk_stats.write_batches++;
     }
 
-    return state;
+    return res;
 }
 
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
+
 /*!
-    \brief      get disk status
-    \param[in]  drv: physical drive number (0)
+    \brief      initialize a logical unit of the device
+    \param[in]  lun: logical unit number
     \param[out] none
-    \retval     operation status
+    \retval     DSTATUS
 */
-DSTATUS disk_status(BYTE drv)
+static DSTATUS usbh_msc_disk_initialize(BYTE lun)
 {
-    if(drv) {
-        return STA_NOINIT; /* supports only single drive */
+    if(lun < MSC_MAX_SUPPORTED_LUN) {
+        usbh_msc_disk_ready[lun] = 0U;
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+        if(lun == usbh_msc_window.lun) {
+            usbh_msc_window.count = 0U;
+        }
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+        if(lun == usbh_msc_batch.lun) {
+            usbh_msc_batch.count = 0U;
+        }
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
     }
 
-    return state;
+    return usbh_msc_disk_check(lun);
+}
+
+/*!
+    \brief      get the disk status
+    \param[in]  lun: logical unit number
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS usbh_msc_disk_status(BYTE lun)
+{
+    return usbh_msc_disk_check(lun);
 }
 
 /*!
     \brief      read sectors
-    \param[in]  drv: physical drive number (0)
-    \param[in]  buff: pointer to the data buffer to store read data
-    \param[in]  sector: start sector number (LBA)
-    \param[in]  count: sector count (1..255)
+    \param[in]  lun: logical unit number
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
     \param[out] none
-    \retval     operation status
+    \retval     DRESULT
 */
-DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
+static DRESULT usbh_msc_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
-    BYTE status = USBH_OK;
-    usb_core_driver *udev = (usb_core_driver *)usb_host_msc.data;
+    DRESULT res = RES_OK;
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+    UINT fill;
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
 
-    if(drv || (!count)) {
+    if(usbh_msc_disk_check(lun) & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((0U == count) || (sector + count > usbh_msc_disk_sectors[lun]) || (sector + count < sector)) {
         return RES_PARERR;
     }
 
-    if(state & STA_NOINIT) {
-        return RES_NOTRDY;
+    usbh_msc_disk_stats.reads++;
+
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+    if((0U != usbh_msc_window.count) && (lun == usbh_msc_window.lun) && (sector >= usbh_msc_window.sector) && \
+       (sector + count <= usbh_msc_window.sector + usbh_msc_window.count)) {
+        memcpy(buff, (BYTE *)usbh_msc_window_buf + (sector - usbh_msc_window.sector) * USBH_MSC_FATFS_SECTOR_SIZE, \
+               count * USBH_MSC_FATFS_SECTOR_SIZE);
+        usbh_msc_disk_stats.read_hits += count;
+        usbh_msc_disk_stats.sectors_copied += count;
+        usbh_msc_disk_next[lun] = sector + count;
+        return RES_OK;
     }
 
-    if(udev->host.connect_status) {
-        do {
-            status = usbh_msc_read(&usb_host_msc, drv, sector, buff, count);
+    /* a short read right after the previous one or after the window reads the next window,
+       reads of the FAT in between leave the window as the position of a file */
+    if((count < USBH_MSC_FATFS_READ_SECTORS) && ((sector == usbh_msc_disk_next[lun]) || \
+       ((0U != usbh_msc_window.count) && (lun == usbh_msc_window.lun) && \
+        (sector == usbh_msc_window.sector + usbh_msc_window.count)))) {
+        fill = USBH_MSC_FATFS_READ_SECTORS;
+        if(fill > usbh_msc_disk_sectors[lun] - sector) {
+            fill = usbh_msc_disk_sectors[lun] - sector;
+        }
+
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+        if(usbh_msc_disk_overlap(&usbh_msc_batch, lun, sector, fill)) {
+            res = usbh_msc_disk_flush();
+        }
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
 
-            if(!udev->host.connect_status) {
-                return RES_ERROR;
-            }
-        } while(USBH_BUSY == status);
+        usbh_msc_window.count = 0U;
+        if(RES_OK == res) {
+            res = usbh_msc_disk_transfer(lun, (BYTE *)usbh_msc_window_buf, sector, fill, 0U);
+        }
+        if(RES_OK == res) {
+            usbh_msc_window.lun = lun;
+            usbh_msc_window.sector = sector;
+            usbh_msc_window.count = fill;
+            memcpy(buff, usbh_msc_window_buf, count * USBH_MSC_FATFS_SECTOR_SIZE);
+            usbh_msc_disk_stats.read_ahead += fill - count;
+            usbh_msc_disk_stats.sectors_copied += count;
+        }
+
+        usbh_msc_disk_next[lun] = sector + count;
+        return res;
     }
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
 
-    if(USBH_OK == status) {
-        return RES_OK;
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+    /* the device gets the collected sectors before they are read back */
+    if(usbh_msc_disk_overlap(&usbh_msc_batch, lun, sector, count)) {
+        res = usbh_msc_disk_flush();
     }
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
 
-    return RES_ERROR;
+    if(RES_OK == res) {
+        res = usbh_msc_disk_transfer(lun, buff, sector, count, 0U);
+    }
+
+    usbh_msc_disk_next[lun] = sector + count;
+    return res;
 }
 
-#if _READONLY == 0U
+#if _USE_WRITE == 1
 
 /*!
     \brief      write sectors
-    \param[in]  drv: physical drive number (0)
-    \param[in]  buff: pointer to the data buffer to store read data
-    \param[in]  sector: start sector number (LBA)
-    \param[in]  count: sector count (1..255)
+    \param[in]  lun: logical unit number
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
     \param[out] none
-    \retval     operation status
+    \retval     DRESULT
 */
-DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
+static DRESULT usbh_msc_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
-    BYTE status = USBH_OK;
-    usb_core_driver *udev = (usb_core_driver *)usb_host_msc.data;
-
-    if((!count) || drv) {
-        return RES_PARERR;
-    }
-
-    if(state & STA_NOINIT) {
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+    DWORD first, last;
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+    DRESULT res;
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
+
+    if(usbh_msc_disk_check(lun) & STA_NOINIT) {
         return RES_NOTRDY;
     }
-
-    if(state & STA_PROTECT) {
-        return RES_WRPRT;
+    if((0U == count) || (sector + count > usbh_msc_disk_sectors[lun]) || (sector + count < sector)) {
+        return RES_PARERR;
     }
 
-    if(udev->host.connect_status) {
-        do {
-            status = usbh_msc_write(&usb_host_msc, drv, sector, (BYTE *)buff, count);
+    usbh_msc_disk_stats.writes++;
 
-            if(!udev->host.connect_status) {
-                return RES_ERROR;
+#if USBH_MSC_FATFS_READ_SECTORS > 0U
+    /* the window keeps what the device will hold */
+    if(usbh_msc_disk_overlap(&usbh_msc_window, lun, sector, count)) {
+        first = (sector > usbh_msc_window.sector) ? sector : usbh_msc_window.sector;
+        last = sector + count;
+        if(last > usbh_msc_window.sector + usbh_msc_window.count) {
+            last = usbh_msc_window.sector + usbh_msc_window.count;
+        }
+        memcpy((BYTE *)usbh_msc_window_buf + (first - usbh_msc_window.sector) * USBH_MSC_FATFS_SECTOR_SIZE, \
+               buff + (first - sector) * USBH_MSC_FATFS_SECTOR_SIZE, (last - first) * USBH_MSC_FATFS_SECTOR_SIZE);
+        usbh_msc_disk_stats.sectors_copied += last - first;
+    }
+#endif /* USBH_MSC_FATFS_READ_SECTORS > 0U */
+
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+    if(0U != usbh_msc_batch.count) {
+        /* rewrites of the collected sectors and writes right after them join the batch */
+        if((lun == usbh_msc_batch.lun) && (sector >= usbh_msc_batch.sector) && \
+           (sector <= usbh_msc_batch.sector + usbh_msc_batch.count) && \
+           (sector + count <= usbh_msc_batch.sector + USBH_MSC_FATFS_WRITE_SECTORS)) {
+            memcpy((BYTE *)usbh_msc_batch_buf + (sector - usbh_msc_batch.sector) * USBH_MSC_FATFS_SECTOR_SIZE, \
+                   buff, count * USBH_MSC_FATFS_SECTOR_SIZE);
+            if(sector + count > usbh_msc_batch.sector + usbh_msc_batch.count) {
+                usbh_msc_batch.count = sector + count - usbh_msc_batch.sector;
             }
-        } while(USBH_BUSY == status);
+            usbh_msc_disk_stats.sectors_copied += count;
+            return RES_OK;
+        }
+
+        res = usbh_msc_disk_flush();
+        if(RES_OK != res) {
+            return res;
+        }
     }
 
-    if(USBH_OK == status) {
+    if(count < USBH_MSC_FATFS_WRITE_SECTORS) {
+        memcpy(usbh_msc_batch_buf, buff, count * USBH_MSC_FATFS_SECTOR_SIZE);
+        usbh_msc_batch.lun = lun;
+        usbh_msc_batch.sector = sector;
+        usbh_msc_batch.count = count;
+        usbh_msc_disk_stats.sectors_copied += count;
         return RES_OK;
     }
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
 
-    return RES_ERROR;
+    return usbh_msc_disk_transfer(lun, (BYTE *)buff, sector, count, 1U);
 }
 
-#endif /* _READONLY == 0 */
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
 
 /*!
     \brief      I/O control function
-    \param[in]  drv: physical drive number (0)
-    \param[in]  ctrl: control code
-    \param[in]  buff: pointer to the data buffer to store read data
+    \param[in]  lun: logical unit number
+    \param[in]  cmd: control code
+    \param[in]  buff: data of the control code
     \param[out] none
-    \retval     operation status
+    \retval     DRESULT
 */
-DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
+static DRESULT usbh_msc_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
 {
     DRESULT res = RES_OK;
-    msc_lun info;
 
-    if(drv) {
-        return RES_PARERR;
-    }
-
-    res = RES_ERROR;
-
-    if(state & STA_NOINIT) {
+    if(usbh_msc_disk_check(lun) & STA_NOINIT) {
         return RES_NOTRDY;
     }
 
-    switch(ctrl) {
-    /* make sure that no pending write process */
+    switch(cmd) {
+    /* write the collected sectors */
     case CTRL_SYNC:
-        res = RES_OK;
+#if USBH_MSC_FATFS_WRITE_SECTORS > 0U
+        res = usbh_msc_disk_flush();
+#endif /* USBH_MSC_FATFS_WRITE_SECTORS > 0U */
         break;
 
     /* get number of sectors on the disk (dword) */
     case GET_SECTOR_COUNT:
-        if(USBH_OK == usbh_msc_lun_info_get(&usb_host_msc, drv, &info)) {
-            *(DWORD *)buff = (DWORD)info.capacity.block_nbr;
-            res = RES_OK;
-        }
+        *(DWORD *)buff = usbh_msc_disk_sectors[lun];
         break;
 
     /* get r/w sector size (word) */
     case GET_SECTOR_SIZE:
-        if(USBH_OK == usbh_msc_lun_info_get(&usb_host_msc, drv, &info)) {
-            *(WORD *)buff = (DWORD)info.capacity.block_size;
-            res = RES_OK;
-        }
+        *(WORD *)buff = USBH_MSC_FATFS_SECTOR_SIZE;
         break;
 
-    /* get erase block size in unit of sector (dword) */
+    /* get erase block size in unit of sector (dword), not known to a mass storage host */
     case GET_BLOCK_SIZE:
-        *(DWORD *)buff = 512U;
+        *(DWORD *)buff = 1U;
         break;
 
     default:
@@ -215,18 +510,4 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
     return res;
 }
 
-/*!
-    \brief      get fat time
-    \param[in]  none
-    \param[out] none
-    \retval     time value
-*/
-DWORD get_fattime(void)
-{
-    return ((DWORD)(2019U - 1980U) << 25)      /* year 2019 */
-           | ((DWORD)1U << 21)                 /* month 1 */
-           | ((DWORD)1U << 16)                 /* day 1 */
-           | ((DWORD)0U << 11)                 /* hour 0 */
-           | ((DWORD)0U << 5)                  /* min 0 */
-           | ((DWORD)0U >> 1);                 /* sec 0 */
-}
+#endif /* _USE_IOCTL == 1 */
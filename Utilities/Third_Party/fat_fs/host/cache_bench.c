@@ -0,0 +1,302 @@
+/*!
+    \file    cache_bench.c
+    \brief   device operations of typical FatFs workloads with and without the disk cache
+
+    Every workload runs on a freshly formatted disk in memory, once straight on the driver and
+    once through the cache. The disk counts the calls that would reach the SD card or USB stick,
+    the cache attached for the run is flushed before the counters are read. The result is then
+    checked on a fresh mount of the device contents.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "disk_cache.h"
+#include "image_disk.h"
+
+/* 64MB volume */
+#define BENCH_DISK_SECTORS              131072U
+/* cache memory, 120 lines of 4 ways after the staging buffer */
+#define BENCH_CACHE_SIZE                (64U * 1024U)
+
+#define LOG_RECORDS                     4096U
+#define LOG_RECORD_SIZE                 48U
+#define LOG_SYNC_RECORDS                8U
+#define LOG_STATUS_RECORDS              64U
+#define DIR_FILES                       256U
+#define SEQ_FILE_SIZE                   (2U * 1024U * 1024U)
+#define SEQ_READ_SIZE                   512U
+
+typedef struct {
+    const char *name;
+    FRESULT (*prepare)(void);
+    FRESULT (*run)(void);
+    FRESULT (*verify)(void);
+} bench_struct;
+
+static FATFS fs;
+static FIL file;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static BYTE buffer[32768];
+static uint32_t cache_memory[BENCH_CACHE_SIZE / sizeof(uint32_t)];
+
+/*!
+    \brief      append log records with a periodic f_sync and rewrite a small status file now and then
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_log_run(void)
+{
+    FRESULT res;
+    FIL status;
+    UINT bw;
+    uint32_t i;
+
+    res = f_open(&file, "log.txt", FA_WRITE | FA_OPEN_APPEND);
+    for(i = 0U; (FR_OK == res) && (i < LOG_RECORDS); i++) {
+        memset(buffer, 'a' + (int)(i % 26U), LOG_RECORD_SIZE);
+        res = f_write(&file, buffer, LOG_RECORD_SIZE, &bw);
+        if((FR_OK == res) && (0U == (i + 1U) % LOG_SYNC_RECORDS)) {
+            res = f_sync(&file);
+        }
+        if((FR_OK == res) && (0U == (i + 1U) % LOG_STATUS_RECORDS)) {
+            res = f_open(&status, "status.txt", FA_WRITE | FA_CREATE_ALWAYS);
+            if(FR_OK == res) {
+                res = f_write(&status, buffer, 32U, &bw);
+                if(FR_OK == res) {
+                    res = f_close(&status);
+                }
+            }
+        }
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      check the log records on the device
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_log_verify(void)
+{
+    FRESULT res;
+    UINT br;
+    uint32_t i, k;
+
+    res = f_open(&file, "log.txt", FA_READ);
+    if((FR_OK == res) && (LOG_RECORDS * LOG_RECORD_SIZE != f_size(&file))) {
+        res = FR_INT_ERR;
+    }
+    for(i = 0U; (FR_OK == res) && (i < LOG_RECORDS); i++) {
+        res = f_read(&file, buffer, LOG_RECORD_SIZE, &br);
+        for(k = 0U; (FR_OK == res) && (k < LOG_RECORD_SIZE); k++) {
+            if(buffer[k] != (BYTE)('a' + (int)(i % 26U))) {
+                res = FR_INT_ERR;
+            }
+        }
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      create many small files in one directory and look all of them up again
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_dir_run(void)
+{
+    FRESULT res;
+    FILINFO info;
+    char name[32];
+    UINT bw;
+    uint32_t i;
+
+    res = f_mkdir("data");
+    for(i = 0U; (FR_OK == res) && (i < DIR_FILES); i++) {
+        snprintf(name, sizeof(name), "data/sample_%03u.bin", (unsigned)i);
+        res = f_open(&file, name, FA_WRITE | FA_CREATE_NEW);
+        if(FR_OK == res) {
+            res = f_write(&file, buffer, 100U, &bw);
+            if(FR_OK == res) {
+                res = f_close(&file);
+            }
+        }
+    }
+    for(i = 0U; (FR_OK == res) && (i < DIR_FILES); i++) {
+        snprintf(name, sizeof(name), "data/sample_%03u.bin", (unsigned)i);
+        res = f_stat(name, &info);
+    }
+    return res;
+}
+
+/*!
+    \brief      check the directory entries on the device
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_dir_verify(void)
+{
+    FRESULT res = FR_OK;
+    FILINFO info;
+    char name[32];
+    uint32_t i;
+
+    for(i = 0U; (FR_OK == res) && (i < DIR_FILES); i++) {
+        snprintf(name, sizeof(name), "data/sample_%03u.bin", (unsigned)i);
+        res = f_stat(name, &info);
+        if((FR_OK == res) && (100U != info.fsize)) {
+            res = FR_INT_ERR;
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      write the file the sequential read works on
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_seq_prepare(void)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t done;
+
+    res = f_open(&file, "seq.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    for(done = 0U; (FR_OK == res) && (done < SEQ_FILE_SIZE); done += sizeof(buffer)) {
+        res = f_write(&file, buffer, sizeof(buffer), &bw);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      read a file in sector sized pieces, as a parser or a USB transfer would
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_seq_run(void)
+{
+    FRESULT res;
+    UINT br = SEQ_READ_SIZE;
+
+    res = f_open(&file, "seq.bin", FA_READ);
+    while((FR_OK == res) && (SEQ_READ_SIZE == br)) {
+        res = f_read(&file, buffer, SEQ_READ_SIZE, &br);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+static const bench_struct benches[] = {
+    {"log append + sync", NULL, bench_log_run, bench_log_verify},
+    {"create/stat files", NULL, bench_dir_run, bench_dir_verify},
+    {"sequential 512B reads", bench_seq_prepare, bench_seq_run, NULL},
+};
+
+/*!
+    \brief      run one workload on a new volume
+    \param[in]  bench: workload
+    \param[in]  cached: run it through the disk cache
+    \param[out] none
+    \retval     0 on success, -1 otherwise
+*/
+static int bench_run(const bench_struct *bench, int cached)
+{
+    disk_cache_stats_struct cstats;
+    image_disk_stats_struct dstats;
+    FRESULT res;
+
+    if(0 != image_disk_open(0U, NULL, BENCH_DISK_SECTORS, NULL)) {
+        return -1;
+    }
+
+    res = f_mkfs(path, FM_ANY, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    if((FR_OK == res) && (NULL != bench->prepare)) {
+        res = bench->prepare();
+    }
+    if((FR_OK == res) && cached && (RES_OK != disk_cache_attach(0U, cache_memory, sizeof(cache_memory)))) {
+        res = FR_INT_ERR;
+    }
+
+    image_disk_stats_reset(0U);
+    if(FR_OK == res) {
+        res = bench->run();
+    }
+
+    if(cached) {
+        disk_cache_stats_get(0U, &cstats);
+        if(RES_OK != disk_cache_detach(0U)) {
+            res = FR_DISK_ERR;
+        }
+    }
+    image_disk_stats_get(0U, &dstats);
+
+    /* what the cache wrote back has to be a consistent volume on its own */
+    if((FR_OK == res) && (NULL != bench->verify)) {
+        res = f_mount(&fs, path, 1U);
+        if(FR_OK == res) {
+            res = bench->verify();
+        }
+    }
+    f_mount(NULL, path, 0U);
+    image_disk_close(0U);
+
+    if(FR_OK != res) {
+        printf("%-22s %-6s failed, FRESULT %d\n", bench->name, cached ? "cache" : "direct", (int)res);
+        return -1;
+    }
+
+    printf("%-22s %-6s %8u %8u %10u %10u", bench->name, cached ? "cache" : "direct",
+           (unsigned)dstats.reads, (unsigned)dstats.writes,
+           (unsigned)dstats.sectors_read, (unsigned)dstats.sectors_written);
+    if(cached) {
+        printf("   hits %u/%u r, %u/%u w, read-ahead %u/%u, %u write-backs of %u sectors",
+               (unsigned)cstats.read_hits, (unsigned)(cstats.read_hits + cstats.read_misses),
+               (unsigned)cstats.write_hits, (unsigned)(cstats.write_hits + cstats.write_misses),
+               (unsigned)cstats.read_ahead_hits, (unsigned)cstats.read_ahead,
+               (unsigned)cstats.writebacks, (unsigned)cstats.written_back);
+    }
+    printf("\n");
+    return 0;
+}
+
+int main(void)
+{
+    uint32_t i;
+    int ret = 0;
+
+    if(0U != FATFS_LinkDriver(&image_disk_driver, path)) {
+        return 1;
+    }
+
+    printf("%-22s %-6s %8s %8s %10s %10s\n", "workload", "mode", "reads", "writes", "sect rd", "sect wr");
+    for(i = 0U; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        ret |= bench_run(&benches[i], 0);
+        ret |= bench_run(&benches[i], 1);
+    }
+
+    return (0 == ret) ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+/*!
+    \file    cp_check.c
+    \brief   equivalence of the ASCII only code page and the fast up-case conversion
+
+    The host library is built with ffconf.h, FF_CODE_PAGE 1. A second build of ffunicode.c
+    with the CP932 tables and the plain table walk of ff_wtoupper() (symbols renamed to ref_*)
+    is the reference. Every code point is converted by both: up-case conversion has to match
+    everywhere, OEM conversion has to match for ASCII and report no conversion elsewhere. Then
+    names in several scripts are created on a volume, looked up with other letter cases and
+    enumerated, their short names have to be plain ASCII.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "image_disk.h"
+
+#define BENCH_DISK_SECTORS              131072U
+#define TIMING_ROUNDS                   20000U
+
+/* ffunicode.c with FF_CODE_PAGE 932 and FF_WTOUPPER_FAST 0 */
+WCHAR ref_uni2oem(DWORD uni, WORD cp);
+WCHAR ref_oem2uni(WCHAR oem, WORD cp);
+DWORD ref_wtoupper(DWORD uni);
+
+typedef struct {
+    const char *name;                                   /* name the file is created with */
+    const char *other_case;                             /* the same name in other letter cases */
+} name_struct;
+
+static const name_struct names[] = {
+    {"readme.txt",                  "README.TXT"},
+    {"Sensor Log 2024-05-01.csv",   "sensor log 2024-05-01.CSV"},
+    {"Журнал датчика.txt",          "ЖУРНАЛ ДАТЧИКА.TXT"},
+    {"Überlauf_Ölstand.log",        "überlauf_ölstand.LOG"},
+    {"Ελληνικά.dat",                "ελληνικά.DAT"},
+    {"温度ログ.csv",                "温度ログ.CSV"},
+    {"温度ログ2.csv",               "温度ログ2.csv"},
+    {"湿度ログ.csv",                "湿度ログ.csv"},
+    {"ｆｕｌｌｗｉｄｔｈ.bin",      "ＦＵＬＬＷＩＤＴＨ.bin"},
+    {"mixed 混合 Mixed.txt",        "MIXED 混合 MIXED.TXT"},
+};
+
+typedef struct {
+    const char *script;                                 /* script of the name */
+    const char *name;                                   /* UTF-8 name */
+} sample_struct;
+
+static const sample_struct samples[] = {
+    {"Latin",       "sensor_log_00042.csv"},
+    {"Cyrillic",    "журнал_датчика_00042.txt"},
+    {"Japanese",    "温度センサーのログ_00042.csv"},
+};
+
+static FATFS fs;
+static FIL file;
+static DIR dir;
+static FILINFO fno;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+
+/*!
+    \brief      decode the next UTF-8 character of a string
+    \param[in]  str: pointer to the string pointer, advanced past the character
+    \param[out] none
+    \retval     code point, 0 at the end of the string
+*/
+static DWORD utf8_next(const char **str)
+{
+    const BYTE *s = (const BYTE *)*str;
+    DWORD c = s[0];
+    UINT n = 0U;
+
+    if(c >= 0xF0U) {
+        c &= 0x07U;
+        n = 3U;
+    } else if(c >= 0xE0U) {
+        c &= 0x0FU;
+        n = 2U;
+    } else if(c >= 0xC0U) {
+        c &= 0x1FU;
+        n = 1U;
+    }
+    *str += 1U + n;
+    for(s++; n > 0U; n--) {
+        c = (c << 6) | (*s++ & 0x3FU);
+    }
+    return c;
+}
+
+/*!
+    \brief      compare both conversions over every code point
+    \param[in]  none
+    \param[out] none
+    \retval     number of differences
+*/
+static uint32_t check_tables(void)
+{
+    uint32_t errors = 0U, lost = 0U;
+    DWORD c;
+
+    for(c = 0U; c < 0x110000U; c++) {
+        if(ff_wtoupper(c) != ref_wtoupper(c)) {
+            if(errors++ < 8U) {
+                printf("  ff_wtoupper(U+%04X) = U+%04X, table U+%04X\n",
+                       (unsigned)c, (unsigned)ff_wtoupper(c), (unsigned)ref_wtoupper(c));
+            }
+        }
+    }
+    for(c = 0U; c < 0x10000U; c++) {
+        WCHAR oem = ref_uni2oem(c, 932U);
+
+        if(((c < 0x80U) && (ff_uni2oem(c, FF_CODE_PAGE) != oem)) || ((c >= 0x80U) && (0U != ff_uni2oem(c, FF_CODE_PAGE)))) {
+            if(errors++ < 8U) {
+                printf("  ff_uni2oem(U+%04X) = %04X\n", (unsigned)c, (unsigned)ff_uni2oem(c, FF_CODE_PAGE));
+            }
+        }
+        if((c >= 0x80U) && (0U != oem)) {
+            lost++;
+        }
+        if(((c < 0x80U) && (ff_oem2uni((WCHAR)c, FF_CODE_PAGE) != ref_oem2uni((WCHAR)c, 932U))) ||
+           ((c >= 0x80U) && (0U != ff_oem2uni((WCHAR)c, FF_CODE_PAGE)))) {
+            if(errors++ < 8U) {
+                printf("  ff_oem2uni(%04X) = U+%04X\n", (unsigned)c, (unsigned)ff_oem2uni((WCHAR)c, FF_CODE_PAGE));
+            }
+        }
+    }
+    printf("code points: %u differences, %u characters with a CP932 short name form get '_'\n",
+           (unsigned)errors, (unsigned)lost);
+    return errors;
+}
+
+/*!
+    \brief      time the up-case conversion of a name, the way the LFN compare does it
+    \param[in]  name: UTF-8 name
+    \param[in]  upper: conversion to time
+    \param[out] none
+    \retval     nanoseconds per character
+*/
+static double time_upper(const char *name, DWORD (*upper)(DWORD))
+{
+    DWORD chars[64];
+    UINT n = 0U, i, r;
+    struct timespec t0, t1;
+    volatile DWORD sum = 0U;
+
+    while(('\0' != *name) && (n < 64U)) {
+        chars[n++] = utf8_next(&name);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(r = 0U; r < TIMING_ROUNDS; r++) {
+        for(i = 0U; i < n; i++) {
+            sum += upper(chars[i]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    return ((double)(t1.tv_sec - t0.tv_sec) * 1e9 + (double)(t1.tv_nsec - t0.tv_nsec)) / ((double)TIMING_ROUNDS * n);
+}
+
+/*!
+    \brief      check that a short name is plain ASCII
+    \param[in]  sfn: short name from f_readdir
+    \param[out] none
+    \retval     1 when it is
+*/
+static int sfn_ascii(const char *sfn)
+{
+    for(; '\0' != *sfn; sfn++) {
+        if((BYTE)*sfn >= 0x80U) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*!
+    \brief      create, look up and enumerate the names on a fresh volume
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT check_names(void)
+{
+    FRESULT res;
+    UINT i, found = 0U, bw;
+
+    res = f_mkfs(path, FM_FAT32, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    for(i = 0U; (FR_OK == res) && (i < sizeof(names) / sizeof(names[0])); i++) {
+        res = f_open(&file, names[i].name, FA_WRITE | FA_CREATE_NEW);
+        if(FR_OK == res) {
+            res = f_write(&file, &i, sizeof(i), &bw);
+            f_close(&file);
+        }
+    }
+    for(i = 0U; (FR_OK == res) && (i < sizeof(names) / sizeof(names[0])); i++) {
+        UINT value = ~0U, br;
+
+        res = f_open(&file, names[i].other_case, FA_READ);
+        if(FR_OK == res) {
+            res = f_read(&file, &value, sizeof(value), &br);
+            f_close(&file);
+        }
+        if((FR_OK == res) && (value != i)) {
+            res = FR_INT_ERR;
+        }
+        if(FR_OK != res) {
+            printf("  lookup of \"%s\" failed (%d)\n", names[i].other_case, (int)res);
+        }
+    }
+    if(FR_OK == res) {
+        res = f_opendir(&dir, "");
+    }
+    while(FR_OK == res) {
+        res = f_readdir(&dir, &fno);
+        if((FR_OK != res) || ('\0' == fno.fname[0])) {
+            break;
+        }
+        for(i = 0U; i < sizeof(names) / sizeof(names[0]); i++) {
+            if(0 == strcmp(fno.fname, names[i].name)) {
+                found++;
+            }
+        }
+        printf("  %-28s %s\n", fno.altname, fno.fname);
+        if(!sfn_ascii(fno.altname)) {
+            res = FR_INT_ERR;
+        }
+    }
+    if((FR_OK == res) && (found != sizeof(names) / sizeof(names[0]))) {
+        res = FR_NO_FILE;
+    }
+    f_mount(NULL, path, 0U);
+    printf("names: %u of %u found, %s\n", found, (unsigned)(sizeof(names) / sizeof(names[0])),
+           (FR_OK == res) ? "short names are ASCII" : "failed");
+    return res;
+}
+
+int main(void)
+{
+    FRESULT res;
+    uint32_t errors;
+    UINT i;
+
+    if((0U != FATFS_LinkDriver(&image_disk_driver, path)) || (0 != image_disk_open(0U, NULL, BENCH_DISK_SECTORS, NULL))) {
+        return 1;
+    }
+    errors = check_tables();
+
+    printf("%-34s %12s %12s\n", "ff_wtoupper, ns per character", "table walk", "fast");
+    for(i = 0U; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        printf("%-34s %12.2f %12.2f\n", samples[i].script,
+               time_upper(samples[i].name, ref_wtoupper), time_upper(samples[i].name, ff_wtoupper));
+    }
+
+    res = check_names();
+    image_disk_close(0U);
+    if((0U != errors) || (FR_OK != res)) {
+        printf("failed, %u differences, FRESULT %d\n", (unsigned)errors, (int)res);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,438 @@
+/*!
+    \file    dir_bench.c
+    \brief   cost of name lookups in large directories with and without the directory index
+
+    usage: dir_bench [--model ram|sd|usb] [--fs fat|fat32] [--max FILES] [--index KB]
+
+    For directory sizes from 128 up to --max files, a fresh volume gets one directory of small
+    log files with long names (8.3 names in dir_bench_sfn). The benchmark creates them, opens
+    random existing and missing names and reads every file while enumerating the directory,
+    once item by item and once in batches, first with plain FatFs and then with the directory
+    index attached. Device reads and simulated device time are per operation. In
+    dir_bench_tiny the file reads go through the sector window and show what batching saves.
+    A final pass deletes and recreates files, remounts and checks every name through the index
+    and through an index that overflows.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "ff_dirindex.h"
+#include "image_disk.h"
+
+#define BENCH_DISK_SECTORS              524288U
+#define MIN_FILES                       128U
+#define LOOKUPS                         256U
+#define BATCH                           16U
+/* reading every file with linear lookups costs files^2 / 8 sector reads, larger directories
+   skip it */
+#define LINEAR_READ_FILES               2048U
+#define RECORD_SIZE                     32U
+#if FF_USE_LFN
+#define NAME_FORMAT                     "logs/%s_log_%05u.csv"
+#else
+#define NAME_FORMAT                     "logs/%.1s%05u.LOG"
+#endif
+#define OVERFLOW_INDEX_SIZE             4096U
+
+typedef struct {
+    uint32_t ops;
+    uint32_t reads;
+    uint64_t busy_us;
+} cost_struct;
+
+static FATFS fs;
+static FIL file;
+static DIR dir;
+static FILINFO items[BATCH];
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static BYTE format = FM_FAT32;
+static uint32_t lcg = 1U;
+
+/*!
+    \brief      next pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     31 bit random number
+*/
+static uint32_t bench_random(void)
+{
+    lcg = lcg * 1103515245U + 12345U;
+    return (lcg >> 1) & 0x7FFFFFFFU;
+}
+
+/*!
+    \brief      start measuring an operation
+    \param[in]  none
+    \param[out] cost: cleared cost
+    \retval     none
+*/
+static void cost_start(cost_struct *cost)
+{
+    cost->ops = 0U;
+    image_disk_stats_reset(0U);
+}
+
+/*!
+    \brief      stop measuring an operation
+    \param[in]  cost: cost with the number of operations
+    \param[out] cost: device reads and time of the operations
+    \retval     none
+*/
+static void cost_stop(cost_struct *cost)
+{
+    image_disk_stats_struct stats;
+
+    image_disk_stats_get(0U, &stats);
+    cost->reads = stats.sectors_read;
+    cost->busy_us = stats.busy_us;
+}
+
+/*!
+    \brief      print the cost per operation
+    \param[in]  cost: measured cost, NULL for a skipped measurement
+    \param[out] none
+    \retval     none
+*/
+static void cost_print(const cost_struct *cost)
+{
+    if((NULL == cost) || (0U == cost->ops)) {
+        printf(" %8s %9s", "-", "-");
+    } else {
+        printf(" %8.1f %9.1f", (double)cost->reads / cost->ops, (double)cost->busy_us / cost->ops);
+    }
+}
+
+/*!
+    \brief      format and mount the volume and create the log directory
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_format(void)
+{
+    FRESULT res;
+
+    res = f_mkfs(path, format, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK == res) {
+        res = f_mkdir("logs");
+    }
+    return res;
+}
+
+/*!
+    \brief      create or open a file by number, a created file gets a record
+    \param[in]  prefix: name prefix
+    \param[in]  n: file number
+    \param[in]  mode: FA_* access mode
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_open(const char *prefix, uint32_t n, BYTE mode)
+{
+    char record[RECORD_SIZE];
+    FRESULT res;
+    UINT bw;
+
+    memset(record, 0, sizeof(record));
+    snprintf(record, sizeof(record), NAME_FORMAT, prefix, (unsigned)n);
+    res = f_open(&file, record, mode);
+    if((FR_OK == res) && (0U != (mode & FA_WRITE))) {
+        res = f_write(&file, record, sizeof(record), &bw);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      read every file of the log directory while enumerating it
+    \param[in]  batch: items read per call, 1 for f_readdir() item by item
+    \param[out] cost: operations and their cost
+    \retval     FRESULT
+*/
+static FRESULT bench_read_all(UINT batch, cost_struct *cost)
+{
+    char name[8U + FF_LFN_BUF];
+    char record[RECORD_SIZE];
+    FRESULT res;
+    UINT count;
+    UINT br;
+    UINT i;
+
+    cost_start(cost);
+    res = f_opendir(&dir, "logs");
+    while(FR_OK == res) {
+        if(1U == batch) {
+            res = f_readdir(&dir, &items[0]);
+            count = (0 != items[0].fname[0]) ? 1U : 0U;
+        } else {
+            res = ff_dirindex_read_batch(&dir, items, batch, &count);
+        }
+        if((FR_OK != res) || (0U == count)) {
+            break;
+        }
+        for(i = 0U; (i < count) && (FR_OK == res); i++) {
+            snprintf(name, sizeof(name), "logs/%s", items[i].fname);
+            res = f_open(&file, name, FA_READ);
+            if(FR_OK == res) {
+                res = f_read(&file, record, sizeof(record), &br);
+            }
+            if(FR_OK == res) {
+                res = f_close(&file);
+            }
+            /* the record holds the path the file was created with, 8.3 names read back in upper case */
+            if((FR_OK == res) && ((sizeof(record) != br) || (0 != strcasecmp(&record[5], items[i].fname)))) {
+                res = FR_INT_ERR;
+            }
+            cost->ops++;
+        }
+    }
+    if(FR_OK == res) {
+        res = f_closedir(&dir);
+    }
+    cost_stop(cost);
+    return res;
+}
+
+/*!
+    \brief      run all measurements for one directory size
+    \param[in]  files: files in the directory
+    \param[in]  index: memory of the directory index, NULL to run without
+    \param[in]  index_size: size of that memory
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_size(uint32_t files, void *index, uint32_t index_size)
+{
+    cost_struct create, open, missing, read_item, read_batch;
+    FRESULT res;
+    uint32_t i;
+
+    ff_dirindex_detach();
+    if((NULL != index) && (FR_OK != ff_dirindex_attach(index, index_size))) {
+        return FR_NOT_ENOUGH_CORE;
+    }
+    res = bench_format();
+
+    cost_start(&create);
+    for(i = 0U; (i < files) && (FR_OK == res); i++, create.ops++) {
+        res = bench_open("sensor", i, FA_WRITE | FA_CREATE_NEW);
+    }
+    cost_stop(&create);
+
+    cost_start(&open);
+    for(i = 0U; (i < LOOKUPS) && (FR_OK == res); i++, open.ops++) {
+        res = bench_open("sensor", bench_random() % files, FA_READ);
+    }
+    cost_stop(&open);
+
+    cost_start(&missing);
+    for(i = 0U; (i < LOOKUPS) && (FR_OK == res); i++, missing.ops++) {
+        res = bench_open("missing", bench_random() % files, FA_READ);
+        res = (FR_NO_FILE == res) ? FR_OK : FR_INT_ERR;
+    }
+    cost_stop(&missing);
+
+    read_item.ops = 0U;
+    read_batch.ops = 0U;
+    if((FR_OK == res) && ((NULL != index) || (files <= LINEAR_READ_FILES))) {
+        res = bench_read_all(1U, &read_item);
+        if(FR_OK == res) {
+            res = bench_read_all(BATCH, &read_batch);
+        }
+        if((FR_OK == res) && ((files != read_item.ops) || (files != read_batch.ops))) {
+            res = FR_INT_ERR;
+        }
+    }
+
+    if(FR_OK == res) {
+        printf("%6u %-6s", (unsigned)files, (NULL != index) ? "index" : "linear");
+        cost_print(&create);
+        cost_print(&open);
+        cost_print(&missing);
+        cost_print(&read_item);
+        cost_print(&read_batch);
+        printf("\n");
+    }
+    (void)f_mount(NULL, path, 0U);
+    return res;
+}
+
+/*!
+    \brief      check that every name is found or reported missing as it should
+    \param[in]  files: files created with the sensor prefix
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_check_names(uint32_t files)
+{
+    FRESULT res = FR_OK;
+    FRESULT expect;
+    uint32_t i;
+
+    for(i = 0U; (i < files) && (FR_OK == res); i++) {
+        expect = (0U == i % 3U) ? FR_NO_FILE : FR_OK;
+        res = (expect == bench_open("sensor", i, FA_READ)) ? FR_OK : FR_INT_ERR;
+        if(FR_OK == res) {
+            expect = (0U == i % 3U) ? FR_OK : FR_NO_FILE;
+            res = (expect == bench_open("rotated", i, FA_READ)) ? FR_OK : FR_INT_ERR;
+        }
+        if(FR_INT_ERR == res) {
+            printf("name %u found where it should not be or missing\n", (unsigned)i);
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      delete and create files with the index attached and check all names
+    \param[in]  files: files in the directory
+    \param[in]  index: memory of the directory index
+    \param[in]  index_size: size of that memory
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_verify(uint32_t files, void *index, uint32_t index_size)
+{
+    ff_dirindex_stats_struct stats;
+    char name[RECORD_SIZE];
+    FRESULT res;
+    uint32_t i;
+
+    ff_dirindex_detach();
+    res = ff_dirindex_attach(index, index_size);
+    if(FR_OK == res) {
+        res = bench_format();
+    }
+    for(i = 0U; (i < files) && (FR_OK == res); i++) {
+        res = bench_open("sensor", i, FA_WRITE | FA_CREATE_NEW);
+    }
+    /* deleted entries leave holes that the new names partly reuse */
+    for(i = 0U; (i < files) && (FR_OK == res); i += 3U) {
+        snprintf(name, sizeof(name), NAME_FORMAT, "sensor", (unsigned)i);
+        res = f_unlink(name);
+        if(FR_OK == res) {
+            res = bench_open("rotated", i, FA_WRITE | FA_CREATE_NEW);
+        }
+    }
+    if(FR_OK == res) {
+        res = bench_check_names(files);
+    }
+    /* a remount drops the indexes, the next lookups scan the directory again */
+    if(FR_OK == res) {
+        (void)f_mount(NULL, path, 0U);
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK == res) {
+        res = bench_check_names(files);
+    }
+    ff_dirindex_stats_get(&stats);
+    printf("index: %u builds, %u small, %u overflows, %u evictions, %u invalidations, %u inserts, %u removals\n",
+           (unsigned)stats.builds, (unsigned)stats.small, (unsigned)stats.overflows, (unsigned)stats.evictions,
+           (unsigned)stats.invalidations, (unsigned)stats.inserts, (unsigned)stats.removals);
+    printf("       %u lookups, %u absent, %u collisions, %u linear\n", (unsigned)stats.lookups,
+           (unsigned)stats.absent, (unsigned)stats.collisions, (unsigned)stats.linear);
+
+    /* an index too small for the directory falls back to the linear search */
+    if(FR_OK == res) {
+        ff_dirindex_detach();
+        (void)f_mount(NULL, path, 0U);
+        res = ff_dirindex_attach(index, OVERFLOW_INDEX_SIZE);
+        if(FR_OK == res) {
+            res = f_mount(&fs, path, 1U);
+        }
+        if(FR_OK == res) {
+            res = bench_check_names(files);
+        }
+        ff_dirindex_stats_get(&stats);
+        printf("%uKB index: %u overflows\n", (unsigned)(OVERFLOW_INDEX_SIZE / 1024U), (unsigned)stats.overflows);
+    }
+    (void)f_mount(NULL, path, 0U);
+    ff_dirindex_detach();
+    return res;
+}
+
+/*!
+    \brief      print the usage
+    \param[in]  none
+    \param[out] none
+    \retval     exit code
+*/
+static int usage(void)
+{
+    printf("usage: dir_bench [--model ram|sd|usb] [--fs fat|fat32] [--max FILES] [--index KB]\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    const image_disk_model_struct *model = &image_disk_model_sd;
+    uint32_t max_files = 8192U;
+    uint32_t index_kb = 512U;
+    uint32_t files;
+    void *index;
+    FRESULT res = FR_OK;
+    int a;
+
+    for(a = 1; a < argc; a++) {
+        if((0 == strcmp(argv[a], "--model")) && (a + 1 < argc)) {
+            model = image_disk_model_find(argv[++a]);
+            if(NULL == model) {
+                return usage();
+            }
+        } else if((0 == strcmp(argv[a], "--fs")) && (a + 1 < argc)) {
+            a++;
+            if(0 == strcmp(argv[a], "fat")) {
+                format = FM_FAT;
+            } else if(0 == strcmp(argv[a], "fat32")) {
+                format = FM_FAT32;
+            } else {
+                return usage();
+            }
+        } else if((0 == strcmp(argv[a], "--max")) && (a + 1 < argc)) {
+            max_files = (uint32_t)strtoul(argv[++a], NULL, 0);
+        } else if((0 == strcmp(argv[a], "--index")) && (a + 1 < argc)) {
+            index_kb = (uint32_t)strtoul(argv[++a], NULL, 0);
+        } else {
+            return usage();
+        }
+    }
+
+    index = malloc(index_kb * 1024U);
+    if((NULL == index) || (0U != FATFS_LinkDriver(&image_disk_driver, path)) ||
+       (0 != image_disk_open(0U, NULL, BENCH_DISK_SECTORS, model))) {
+        return 1;
+    }
+
+    printf("256MB %s volume, model %s, %uKB index, FF_FS_TINY %d, FF_USE_LFN %d\n",
+           (FM_FAT == format) ? "FAT" : "FAT32", model->name, (unsigned)index_kb, FF_FS_TINY, FF_USE_LFN);
+    printf("sector reads and device us per operation\n");
+    printf("%6s %-6s %18s %18s %18s %18s %18s\n", "files", "", "create", "open", "open missing",
+           "read per item", "read batched");
+    for(files = MIN_FILES; (files <= max_files) && (FR_OK == res); files *= 4U) {
+        res = bench_size(files, NULL, 0U);
+        if(FR_OK == res) {
+            res = bench_size(files, index, index_kb * 1024U);
+        }
+    }
+    if(FR_OK == res) {
+        res = bench_verify(files / 4U, index, index_kb * 1024U);
+    }
+    if(FR_OK != res) {
+        printf("failed, FRESULT %d\n", (int)res);
+    }
+
+    image_disk_close(0U);
+    free(index);
+    return (FR_OK == res) ? 0 : 1;
+}
@@ -0,0 +1,338 @@
+/*!
+    \file    fs_bench.c
+    \brief   FatFs benchmark suite on an image disk with a device model
+
+    usage: fs_bench [--image FILE] [--size MB] [--model ram|sd|usb] [--fs any|fat|fat32|exfat]
+                    [--cache KB] [--only NAME]
+
+    The volume is formatted and the workloads run in order: sequential write and read of a
+    16MB file, creation of 500 small files, scans of their directory, and an append logger once
+    through f_write/f_sync and once through a preallocated ff_stream. Times are simulated
+    device time of the model, so results do not depend on the host. The build directory holds
+    one executable per ffconf.h variant (fs_bench, fs_bench_tiny, fs_bench_sfn), each prints
+    the RAM its FatFs objects take.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "ff_stream.h"
+#include "disk_cache.h"
+#include "image_disk.h"
+
+#define SEQ_SIZE                        (16U * 1024U * 1024U)
+#define SEQ_CHUNK                       (32U * 1024U)
+#define SMALL_FILES                     500U
+#define SCAN_PASSES                     10U
+#define LOG_RECORDS                     10000U
+#define LOG_RECORD_SIZE                 48U
+#define LOG_SYNC_RECORDS                16U
+#define LOG_STREAM_BUFFER               4096U
+
+typedef struct {
+    const char *name;
+    FRESULT (*run)(uint64_t *bytes);
+    const char *unit;
+    double scale;
+} bench_struct;
+
+static FATFS fs;
+static FIL file;
+static DIR dir;
+static ff_stream_struct stream;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static BYTE chunk[SEQ_CHUNK];
+static uint32_t stream_buffers[2U * LOG_STREAM_BUFFER / sizeof(uint32_t)];
+
+/*!
+    \brief      write a large file in big chunks
+    \param[out] bytes: payload moved
+    \retval     FRESULT
+*/
+static FRESULT bench_seq_write(uint64_t *bytes)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t done;
+
+    memset(chunk, 0x5A, sizeof(chunk));
+    res = f_open(&file, "seq.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    for(done = 0U; (FR_OK == res) && (done < SEQ_SIZE); done += SEQ_CHUNK) {
+        res = f_write(&file, chunk, SEQ_CHUNK, &bw);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    *bytes = SEQ_SIZE;
+    return res;
+}
+
+/*!
+    \brief      read the large file back in big chunks
+    \param[out] bytes: payload moved
+    \retval     FRESULT
+*/
+static FRESULT bench_seq_read(uint64_t *bytes)
+{
+    FRESULT res;
+    UINT br = SEQ_CHUNK;
+
+    *bytes = 0U;
+    res = f_open(&file, "seq.bin", FA_READ);
+    while((FR_OK == res) && (SEQ_CHUNK == br)) {
+        res = f_read(&file, chunk, SEQ_CHUNK, &br);
+        *bytes += br;
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      create many small files of 1 to 4KB in one directory
+    \param[out] bytes: payload moved
+    \retval     FRESULT
+*/
+static FRESULT bench_small_files(uint64_t *bytes)
+{
+    char name[24];
+    FRESULT res;
+    UINT bw, size;
+    uint32_t i;
+
+    *bytes = 0U;
+    res = f_mkdir("files");
+    for(i = 0U; (FR_OK == res) && (i < SMALL_FILES); i++) {
+        /* 8.3 names, the suite also runs without LFN */
+        snprintf(name, sizeof(name), "files/F%05u.DAT", (unsigned)i);
+        size = 1024U + (i * 97U) % 3072U;
+        res = f_open(&file, name, FA_WRITE | FA_CREATE_NEW);
+        if(FR_OK == res) {
+            res = f_write(&file, chunk, size, &bw);
+            *bytes += bw;
+            if(FR_OK == res) {
+                res = f_close(&file);
+            }
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      list the directory of small files several times
+    \param[out] bytes: directory entries read
+    \retval     FRESULT
+*/
+static FRESULT bench_dir_scan(uint64_t *bytes)
+{
+    FILINFO info;
+    FRESULT res = FR_OK;
+    uint32_t pass;
+
+    *bytes = 0U;
+    for(pass = 0U; (FR_OK == res) && (pass < SCAN_PASSES); pass++) {
+        res = f_opendir(&dir, "files");
+        while(FR_OK == res) {
+            res = f_readdir(&dir, &info);
+            if((FR_OK != res) || (0 == info.fname[0])) {
+                break;
+            }
+            (*bytes)++;
+        }
+        if(FR_OK == res) {
+            res = f_closedir(&dir);
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      append small records, durable every few records
+    \param[out] bytes: payload moved
+    \retval     FRESULT
+*/
+static FRESULT bench_app_log(uint64_t *bytes)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t i;
+
+    res = f_open(&file, "app.log", FA_WRITE | FA_CREATE_ALWAYS);
+    for(i = 0U; (FR_OK == res) && (i < LOG_RECORDS); i++) {
+        res = f_write(&file, chunk, LOG_RECORD_SIZE, &bw);
+        if((FR_OK == res) && (0U == (i + 1U) % LOG_SYNC_RECORDS)) {
+            res = f_sync(&file);
+        }
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    *bytes = (uint64_t)LOG_RECORDS * LOG_RECORD_SIZE;
+    return res;
+}
+
+/*!
+    \brief      append the same records through a preallocated stream, durable every buffer
+    \param[out] bytes: payload moved
+    \retval     FRESULT
+*/
+static FRESULT bench_stream_log(uint64_t *bytes)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t i;
+
+    res = ff_stream_open(&stream, "stream.log", (FSIZE_t)LOG_RECORDS * LOG_RECORD_SIZE, stream_buffers, LOG_STREAM_BUFFER, LOG_STREAM_BUFFER);
+    for(i = 0U; (FR_OK == res) && (i < LOG_RECORDS); i++) {
+        res = ff_stream_write(&stream, chunk, LOG_RECORD_SIZE, &bw);
+    }
+    if(FR_OK == res) {
+        res = ff_stream_close(&stream);
+    }
+    *bytes = (uint64_t)LOG_RECORDS * LOG_RECORD_SIZE;
+    return res;
+}
+
+static const bench_struct benches[] = {
+    {"seqwrite", bench_seq_write, "KB/s", 1024.0},
+    {"seqread", bench_seq_read, "KB/s", 1024.0},
+    {"smallfiles", bench_small_files, "KB/s", 1024.0},
+    {"dirscan", bench_dir_scan, "entries/s", 1.0},
+    {"applog", bench_app_log, "KB/s", 1024.0},
+    {"streamlog", bench_stream_log, "KB/s", 1024.0},
+};
+
+/*!
+    \brief      print the usage
+    \param[in]  none
+    \param[out] none
+    \retval     exit code
+*/
+static int usage(void)
+{
+    printf("usage: fs_bench [--image FILE] [--size MB] [--model ram|sd|usb] [--fs any|fat|fat32|exfat]\n"
+           "                [--cache KB] [--only NAME]\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    const image_disk_model_struct *model = &image_disk_model_sd;
+    const char *image = NULL;
+    const char *only = NULL;
+    uint32_t size_mb = 256U;
+    uint32_t cache_kb = 0U;
+    BYTE format = FM_ANY;
+    image_disk_stats_struct stats;
+    disk_cache_stats_struct cstats;
+    void *cache = NULL;
+    uint64_t bytes;
+    FRESULT res;
+    uint32_t i;
+    int a;
+
+    for(a = 1; a < argc; a++) {
+        if((0 == strcmp(argv[a], "--image")) && (a + 1 < argc)) {
+            image = argv[++a];
+        } else if((0 == strcmp(argv[a], "--size")) && (a + 1 < argc)) {
+            size_mb = (uint32_t)strtoul(argv[++a], NULL, 0);
+        } else if((0 == strcmp(argv[a], "--model")) && (a + 1 < argc)) {
+            model = image_disk_model_find(argv[++a]);
+            if(NULL == model) {
+                return usage();
+            }
+        } else if((0 == strcmp(argv[a], "--fs")) && (a + 1 < argc)) {
+            a++;
+            if(0 == strcmp(argv[a], "any")) {
+                format = FM_ANY;
+            } else if(0 == strcmp(argv[a], "fat")) {
+                format = FM_FAT;
+            } else if(0 == strcmp(argv[a], "fat32")) {
+                format = FM_FAT32;
+            } else if(0 == strcmp(argv[a], "exfat")) {
+                format = FM_EXFAT;
+            } else {
+                return usage();
+            }
+        } else if((0 == strcmp(argv[a], "--cache")) && (a + 1 < argc)) {
+            cache_kb = (uint32_t)strtoul(argv[++a], NULL, 0);
+        } else if((0 == strcmp(argv[a], "--only")) && (a + 1 < argc)) {
+            only = argv[++a];
+        } else {
+            return usage();
+        }
+    }
+
+    if(0U != FATFS_LinkDriver(&image_disk_driver, path)) {
+        return 1;
+    }
+    if(0 != image_disk_open(0U, image, size_mb * 2048U, model)) {
+        printf("cannot map %s\n", (NULL != image) ? image : "memory");
+        return 1;
+    }
+
+    res = f_mkfs(path, format, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK != res) {
+        printf("format failed, FRESULT %d%s\n", (int)res, FF_FS_EXFAT ? "" : " (exFAT is disabled in this build)");
+        image_disk_close(0U);
+        return 1;
+    }
+    if(0U != cache_kb) {
+        cache = malloc(cache_kb * 1024U);
+        if((NULL == cache) || (RES_OK != disk_cache_attach(0U, cache, cache_kb * 1024U))) {
+            printf("cannot attach a %uKB cache\n", (unsigned)cache_kb);
+            return 1;
+        }
+    }
+
+    printf("%uMB %s volume, %u byte clusters, model %s, cache %uKB\n", (unsigned)size_mb,
+           (FS_EXFAT == fs.fs_type) ? "exFAT" : ((FS_FAT32 == fs.fs_type) ? "FAT32" : ((FS_FAT16 == fs.fs_type) ? "FAT16" : "FAT12")),
+           (unsigned)fs.csize * FF_MAX_SS, model->name, (unsigned)cache_kb);
+    printf("FF_FS_TINY %d, FF_USE_LFN %d, FF_FS_EXFAT %d: FATFS %u, FIL %u, DIR %u, LFN buffer %u bytes\n",
+           FF_FS_TINY, FF_USE_LFN, FF_FS_EXFAT, (unsigned)sizeof(FATFS), (unsigned)sizeof(FIL), (unsigned)sizeof(DIR),
+           (1 == FF_USE_LFN) ? (unsigned)((FF_MAX_LFN + 1) * sizeof(WCHAR)) : 0U);
+    printf("%-11s %10s %20s %8s %8s %8s %8s\n", "workload", "device ms", "rate", "reads", "writes", "merges", "copied");
+
+    for(i = 0U; (FR_OK == res) && (i < sizeof(benches) / sizeof(benches[0])); i++) {
+        if((NULL != only) && (0 != strcmp(only, benches[i].name)) &&
+                !((0 == strcmp(only, "seqread")) && (0 == strcmp(benches[i].name, "seqwrite"))) &&
+                !((0 == strcmp(only, "dirscan")) && (0 == strcmp(benches[i].name, "smallfiles")))) {
+            continue;
+        }
+        image_disk_stats_reset(0U);
+        res = benches[i].run(&bytes);
+        /* what the cache still holds is part of the workload */
+        if((FR_OK == res) && (NULL != cache) && (RES_OK != disk_cache_flush(0U))) {
+            res = FR_DISK_ERR;
+        }
+        if(FR_OK != res) {
+            printf("%-11s failed, FRESULT %d\n", benches[i].name, (int)res);
+            break;
+        }
+        image_disk_stats_get(0U, &stats);
+        printf("%-11s %10.1f %10.0f %-9s %8u %8u %8u %8u\n", benches[i].name, (double)stats.busy_us / 1000.0,
+               (0U != stats.busy_us) ? (double)bytes / benches[i].scale * 1e6 / (double)stats.busy_us : 0.0, benches[i].unit,
+               (unsigned)stats.reads, (unsigned)stats.writes, (unsigned)stats.merges, (unsigned)stats.sectors_copied);
+    }
+
+    if(NULL != cache) {
+        disk_cache_stats_get(0U, &cstats);
+        printf("cache: %u/%u read hits, %u/%u write hits, %u write-backs of %u sectors\n",
+               (unsigned)cstats.read_hits, (unsigned)(cstats.read_hits + cstats.read_misses),
+               (unsigned)cstats.write_hits, (unsigned)(cstats.write_hits + cstats.write_misses),
+               (unsigned)cstats.writebacks, (unsigned)cstats.written_back);
+        disk_cache_detach(0U);
+        free(cache);
+    }
+    f_mount(NULL, path, 0U);
+    image_disk_close(0U);
+    return (FR_OK == res) ? 0 : 1;
+}
@@ -0,0 +1,587 @@
+/*!
+    \file    image_disk.c
+    \brief   disk driver over a memory-mapped image file for running FatFs on the host
+
+    The image is either a file, which can be a dump of a real card and can be inspected with
+    the usual host tools afterwards, or anonymous memory. Every operation is counted, and a
+    device model turns it into simulated device time:
+
+    - each read or write costs a command overhead plus the transfer at the model's rate
+    - with an erase block size, a simple flash translation layer is modelled: the controller
+      keeps a few erase blocks open for writing. Writes that continue an open block only cost
+      the programming. Opening a block in the middle, skipping sectors or writing a block
+      again makes the controller copy the sectors it does not get from the host, and a block
+      that is closed half written is filled up by copying before the old one is erased.
+      Only sectors that hold data are copied: all of them at first, CTRL_TRIM releases
+      sectors until they are written again.
+
+CTRL_TRIM ranges are recorded for the tests and their sectors read back as zeros, so a trim
+that hits live data shows up as corrupted files.
+
+    The numbers of the models are typical, not measured on a particular device.
+*/
+
+/* fallocate() */
+#define _GNU_SOURCE
+
+#include "image_disk.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <linux/falloc.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMAGE_DISK_SECTOR_SIZE          512U
+/* most open erase blocks a model may ask for */
+#define IMAGE_DISK_MAX_OPEN             8U
+#define IMAGE_DISK_PAGE_SIZE            4096U
+
+/* an erase block the controller is writing */
+typedef struct {
+    DWORD block;                                        /*!< erase block number */
+    uint32_t wp;                                        /*!< next sector the controller expects */
+    uint32_t stamp;                                     /*!< last use, for replacement */
+    uint8_t valid;
+} image_disk_open_struct;
+
+typedef struct {
+    BYTE *data;
+    DWORD sectors;
+    int fd;
+    const image_disk_model_struct *model;
+    image_disk_open_struct open[IMAGE_DISK_MAX_OPEN];
+    uint32_t clock;
+    uint8_t *mapped;                                    /*!< one bit per sector that holds data */
+    uint8_t trim;                                       /*!< CTRL_TRIM is carried out */
+    DWORD trim_log[IMAGE_DISK_TRIM_LOG][2];             /*!< first CTRL_TRIM ranges since the last reset */
+    uint32_t trim_logged;
+    image_disk_stats_struct stats;
+} image_disk_struct;
+
+/* counts only */
+const image_disk_model_struct image_disk_model_ram = {"ram", 0U, 0U, 0U, 0U, 0U, 0U, 0U, 0U};
+/* class 10 card in 4-bit high speed mode, 512KB erase blocks, four of them open */
+const image_disk_model_struct image_disk_model_sd = {"sd", 100U, 250U, 20000U, 12000U, 500U, 1024U, 2000U, 4U};
+/* budget USB stick behind the full speed host, 128KB erase blocks, two of them open */
+const image_disk_model_struct image_disk_model_usb = {"usb", 400U, 600U, 1000U, 800U, 1000U, 256U, 3000U, 2U};
+
+static const image_disk_model_struct *const image_disk_models[] = {
+    &image_disk_model_ram, &image_disk_model_sd, &image_disk_model_usb
+};
+
+static image_disk_struct image_disks[IMAGE_DISK_LUNS] = {{NULL, 0U, -1}, {NULL, 0U, -1}};
+
+static DSTATUS image_disk_initialize(BYTE lun);
+static DSTATUS image_disk_status(BYTE lun);
+static DRESULT image_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+static DRESULT image_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+static DRESULT image_disk_ioctl(BYTE lun, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef image_disk_driver = {
+    image_disk_initialize,
+    image_disk_status,
+    image_disk_read,
+#if _USE_WRITE == 1
+    image_disk_write,
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+    image_disk_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/*!
+    \brief      time to move sectors at a rate
+    \param[in]  sectors: number of sectors
+    \param[in]  kbps: rate in KB/s, 0 for free
+    \param[out] none
+    \retval     microseconds
+*/
+static uint64_t image_disk_transfer_us(uint32_t sectors, uint32_t kbps)
+{
+    if(0U == kbps) {
+        return 0U;
+    }
+    return (uint64_t)sectors * IMAGE_DISK_SECTOR_SIZE * 1000000U / ((uint64_t)kbps * 1024U);
+}
+
+/*!
+    \brief      account the sectors of a range the controller copies inside the flash, the ones
+                that hold data
+    \param[in]  disk: disk
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     none
+*/
+static void image_disk_flash_copy(image_disk_struct *disk, DWORD sector, uint32_t count)
+{
+    uint32_t sectors = 0U;
+
+    for(; count > 0U; sector++, count--) {
+        if((sector >= disk->sectors) || (disk->mapped[sector >> 3] & (1U << (sector & 7U)))) {
+            sectors++;
+        }
+    }
+    disk->stats.sectors_copied += sectors;
+    disk->stats.busy_us += image_disk_transfer_us(sectors, disk->model->write_kbps);
+}
+
+/*!
+    \brief      close an open erase block, a partially written one is completed by copying
+    \param[in]  disk: disk
+    \param[in]  slot: open block
+    \param[out] none
+    \retval     none
+*/
+static void image_disk_flash_close(image_disk_struct *disk, image_disk_open_struct *slot)
+{
+    if(slot->valid && (slot->wp < disk->model->erase_block)) {
+        image_disk_flash_copy(disk, slot->block * disk->model->erase_block + slot->wp, disk->model->erase_block - slot->wp);
+        disk->stats.merges++;
+    }
+    if(slot->valid) {
+        disk->stats.busy_us += disk->model->erase_us;
+    }
+    slot->valid = 0U;
+}
+
+/*!
+    \brief      run a write through the flash translation model
+    \param[in]  disk: disk
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     none
+*/
+static void image_disk_flash_write(image_disk_struct *disk, DWORD sector, UINT count)
+{
+    const image_disk_model_struct *model = disk->model;
+    uint32_t blocks = (model->open_blocks < IMAGE_DISK_MAX_OPEN) ? model->open_blocks : IMAGE_DISK_MAX_OPEN;
+    image_disk_open_struct *slot;
+    uint32_t offset, n, i;
+    DWORD block;
+
+    if((0U == model->erase_block) || (0U == blocks)) {
+        return;
+    }
+
+    while(count > 0U) {
+        block = sector / model->erase_block;
+        offset = sector % model->erase_block;
+        n = model->erase_block - offset;
+        if(n > count) {
+            n = count;
+        }
+
+        slot = NULL;
+        for(i = 0U; i < blocks; i++) {
+            if(disk->open[i].valid && (block == disk->open[i].block)) {
+                slot = &disk->open[i];
+                break;
+            }
+        }
+        if(NULL == slot) {
+            /* replace an unused or the least recently written open block */
+            slot = &disk->open[0];
+            for(i = 0U; i < blocks; i++) {
+                if(!disk->open[i].valid) {
+                    slot = &disk->open[i];
+                    break;
+                }
+                if((int32_t)(disk->open[i].stamp - slot->stamp) < 0) {
+                    slot = &disk->open[i];
+                }
+            }
+            image_disk_flash_close(disk, slot);
+            slot->valid = 1U;
+            slot->block = block;
+            slot->wp = 0U;
+        }
+
+        if(offset < slot->wp) {
+            /* written again, the whole block is rebuilt around the new sectors */
+            image_disk_flash_copy(disk, sector - offset, offset);
+            image_disk_flash_copy(disk, sector + n, model->erase_block - offset - n);
+            disk->stats.busy_us += model->erase_us;
+            disk->stats.merges++;
+            slot->wp = model->erase_block;
+        } else {
+            /* skipped sectors keep their old contents, the controller copies them */
+            if(offset > slot->wp) {
+                image_disk_flash_copy(disk, sector - offset + slot->wp, offset - slot->wp);
+            }
+            slot->wp = offset + n;
+        }
+        slot->stamp = ++disk->clock;
+
+        sector += n;
+        count -= n;
+    }
+}
+
+/*!
+    \brief      mark the sectors of a range as holding data or not
+    \param[in]  disk: disk
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[in]  mapped: 1 after a write, 0 after a trim
+    \param[out] none
+    \retval     none
+*/
+static void image_disk_map(image_disk_struct *disk, DWORD sector, uint32_t count, uint8_t mapped)
+{
+    for(; count > 0U; sector++, count--) {
+        if(mapped) {
+            disk->mapped[sector >> 3] |= (uint8_t)(1U << (sector & 7U));
+        } else {
+            disk->mapped[sector >> 3] &= (uint8_t)~(1U << (sector & 7U));
+        }
+    }
+}
+
+/*!
+    \brief      carry out a trim, the sectors read back as zeros and hold no data any more
+    \param[in]  disk: disk
+    \param[in]  start: first sector
+    \param[in]  end: last sector
+    \param[out] none
+    \retval     none
+*/
+static void image_disk_discard(image_disk_struct *disk, DWORD start, DWORD end)
+{
+    size_t first = (size_t)start * IMAGE_DISK_SECTOR_SIZE;
+    size_t last = ((size_t)end + 1U) * IMAGE_DISK_SECTOR_SIZE;
+    size_t page_first = (first + IMAGE_DISK_PAGE_SIZE - 1U) & ~(size_t)(IMAGE_DISK_PAGE_SIZE - 1U);
+    size_t page_last = last & ~(size_t)(IMAGE_DISK_PAGE_SIZE - 1U);
+    int released = 0;
+
+    /* whole pages are given back instead of written, a trim of the whole volume stays cheap */
+    if(page_first < page_last) {
+        if(disk->fd >= 0) {
+            released = (0 == fallocate(disk->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t)page_first, (off_t)(page_last - page_first)));
+        } else {
+            released = (0 == madvise(disk->data + page_first, page_last - page_first, MADV_DONTNEED));
+        }
+    }
+    if(released) {
+        memset(disk->data + first, 0, page_first - first);
+        memset(disk->data + page_last, 0, last - page_last);
+    } else {
+        memset(disk->data + first, 0, last - first);
+    }
+    image_disk_map(disk, start, end - start + 1U, 0U);
+}
+
+/*!
+    \brief      map an image file, or anonymous memory if file is NULL, as a disk
+    \param[in]  lun: disk number
+    \param[in]  file: image file, created if missing, its contents are kept
+    \param[in]  sectors: size in sectors, 0 to take the size of an existing file
+    \param[in]  model: device model, NULL for image_disk_model_ram
+    \param[out] none
+    \retval     0 on success, -1 otherwise
+*/
+int image_disk_open(BYTE lun, const char *file, DWORD sectors, const image_disk_model_struct *model)
+{
+    image_disk_struct *disk;
+    struct stat st;
+    void *data;
+
+    if(lun >= IMAGE_DISK_LUNS) {
+        return -1;
+    }
+    image_disk_close(lun);
+    disk = &image_disks[lun];
+
+    if(NULL == file) {
+        if(0U == sectors) {
+            return -1;
+        }
+        /* untouched pages stay unallocated, large volumes only cost what is written */
+        data = mmap(NULL, (size_t)sectors * IMAGE_DISK_SECTOR_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        disk->fd = open(file, O_RDWR | O_CREAT, 0644);
+        if(disk->fd < 0) {
+            return -1;
+        }
+        if((0U == sectors) && (0 == fstat(disk->fd, &st))) {
+            sectors = (DWORD)(st.st_size / IMAGE_DISK_SECTOR_SIZE);
+        }
+        if((0U == sectors) || (0 != ftruncate(disk->fd, (off_t)sectors * IMAGE_DISK_SECTOR_SIZE))) {
+            close(disk->fd);
+            disk->fd = -1;
+            return -1;
+        }
+        data = mmap(NULL, (size_t)sectors * IMAGE_DISK_SECTOR_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, disk->fd, 0);
+    }
+    if(MAP_FAILED == data) {
+        if(disk->fd >= 0) {
+            close(disk->fd);
+            disk->fd = -1;
+        }
+        return -1;
+    }
+
+    /* the contents of a new disk are unknown to the flash model, every sector holds data */
+    disk->mapped = (uint8_t *)malloc(((size_t)sectors + 7U) / 8U);
+    if(NULL == disk->mapped) {
+        munmap(data, (size_t)sectors * IMAGE_DISK_SECTOR_SIZE);
+        if(disk->fd >= 0) {
+            close(disk->fd);
+            disk->fd = -1;
+        }
+        return -1;
+    }
+    memset(disk->mapped, 0xFF, ((size_t)sectors + 7U) / 8U);
+    disk->trim = 1U;
+
+    disk->data = (BYTE *)data;
+    disk->sectors = sectors;
+    disk->model = (NULL != model) ? model : &image_disk_model_ram;
+    memset(disk->open, 0, sizeof(disk->open));
+    disk->clock = 0U;
+    image_disk_stats_reset(lun);
+    return 0;
+}
+
+/*!
+    \brief      write back and unmap a disk
+    \param[in]  lun: disk number
+    \param[out] none
+    \retval     none
+*/
+void image_disk_close(BYTE lun)
+{
+    image_disk_struct *disk;
+
+    if(lun >= IMAGE_DISK_LUNS) {
+        return;
+    }
+    disk = &image_disks[lun];
+    if(NULL != disk->data) {
+        if(disk->fd >= 0) {
+            msync(disk->data, (size_t)disk->sectors * IMAGE_DISK_SECTOR_SIZE, MS_SYNC);
+        }
+        munmap(disk->data, (size_t)disk->sectors * IMAGE_DISK_SECTOR_SIZE);
+        free(disk->mapped);
+        disk->mapped = NULL;
+        disk->data = NULL;
+        disk->sectors = 0U;
+    }
+    if(disk->fd >= 0) {
+        close(disk->fd);
+        disk->fd = -1;
+    }
+}
+
+/*!
+    \brief      read the device operations of a disk
+    \param[in]  lun: disk number
+    \param[out] stats: copy of the counters
+    \retval     none
+*/
+void image_disk_stats_get(BYTE lun, image_disk_stats_struct *stats)
+{
+    *stats = image_disks[lun].stats;
+}
+
+/*!
+    \brief      clear the device operations of a disk, the open erase blocks stay open
+    \param[in]  lun: disk number
+    \param[out] none
+    \retval     none
+*/
+void image_disk_stats_reset(BYTE lun)
+{
+    memset(&image_disks[lun].stats, 0, sizeof(image_disks[lun].stats));
+    image_disks[lun].trim_logged = 0U;
+}
+
+/*!
+    \brief      read the CTRL_TRIM ranges carried out since the last reset of the statistics
+    \param[in]  lun: disk number
+    \param[in]  max: number of ranges the buffer holds
+    \param[out] ranges: first and last sector of each range, in the order of the requests
+    \retval     number of ranges, more than max or IMAGE_DISK_TRIM_LOG if not all were kept
+*/
+uint32_t image_disk_trims_get(BYTE lun, DWORD (*ranges)[2], uint32_t max)
+{
+    image_disk_struct *disk = &image_disks[lun];
+    uint32_t i;
+
+    for(i = 0U; (i < max) && (i < disk->trim_logged) && (i < IMAGE_DISK_TRIM_LOG); i++) {
+        ranges[i][0] = disk->trim_log[i][0];
+        ranges[i][1] = disk->trim_log[i][1];
+    }
+    return disk->trim_logged;
+}
+
+/*!
+    \brief      let a disk carry out CTRL_TRIM or ignore it like a device without erase commands
+    \param[in]  lun: disk number
+    \param[in]  enable: 1 to carry out trims, 0 to ignore them
+    \param[out] none
+    \retval     none
+*/
+void image_disk_trim_set(BYTE lun, uint8_t enable)
+{
+    image_disks[lun].trim = enable;
+}
+
+/*!
+    \brief      find a device model by name
+    \param[in]  name: "ram", "sd" or "usb"
+    \param[out] none
+    \retval     model, NULL if unknown
+*/
+const image_disk_model_struct *image_disk_model_find(const char *name)
+{
+    uint32_t i;
+
+    for(i = 0U; i < sizeof(image_disk_models) / sizeof(image_disk_models[0]); i++) {
+        if(0 == strcmp(name, image_disk_models[i]->name)) {
+            return image_disk_models[i];
+        }
+    }
+    return NULL;
+}
+
+/*!
+    \brief      initialize a disk
+    \param[in]  lun: disk number
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS image_disk_initialize(BYTE lun)
+{
+    return image_disk_status(lun);
+}
+
+/*!
+    \brief      get the status of a disk
+    \param[in]  lun: disk number
+    \param[out] none
+    \retval     DSTATUS, STA_NOINIT if the disk is not open
+*/
+static DSTATUS image_disk_status(BYTE lun)
+{
+    return ((lun < IMAGE_DISK_LUNS) && (NULL != image_disks[lun].data)) ? 0U : STA_NOINIT;
+}
+
+/*!
+    \brief      read sectors
+    \param[in]  lun: disk number
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT image_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    image_disk_struct *disk = &image_disks[lun];
+
+    if(image_disk_status(lun) & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((sector >= disk->sectors) || (count > disk->sectors - sector)) {
+        return RES_PARERR;
+    }
+    memcpy(buff, disk->data + (size_t)sector * IMAGE_DISK_SECTOR_SIZE, (size_t)count * IMAGE_DISK_SECTOR_SIZE);
+    disk->stats.reads++;
+    disk->stats.sectors_read += count;
+    disk->stats.busy_us += disk->model->read_command_us + image_disk_transfer_us(count, disk->model->read_kbps);
+    return RES_OK;
+}
+
+#if _USE_WRITE == 1
+/*!
+    \brief      write sectors
+    \param[in]  lun: disk number
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT image_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    image_disk_struct *disk = &image_disks[lun];
+
+    if(image_disk_status(lun) & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((sector >= disk->sectors) || (count > disk->sectors - sector)) {
+        return RES_PARERR;
+    }
+    memcpy(disk->data + (size_t)sector * IMAGE_DISK_SECTOR_SIZE, buff, (size_t)count * IMAGE_DISK_SECTOR_SIZE);
+    disk->stats.writes++;
+    disk->stats.sectors_written += count;
+    disk->stats.busy_us += disk->model->write_command_us + image_disk_transfer_us(count, disk->model->write_kbps);
+    image_disk_flash_write(disk, sector, count);
+    image_disk_map(disk, sector, count, 1U);
+    return RES_OK;
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+/*!
+    \brief      I/O control operation
+    \param[in]  lun: disk number
+    \param[in]  cmd: control code
+    \param[in]  buff: buffer to send/receive control data
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT image_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+    image_disk_struct *disk = &image_disks[lun];
+    DWORD *range;
+
+    if(image_disk_status(lun) & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    switch(cmd) {
+    case CTRL_SYNC:
+        disk->stats.syncs++;
+        disk->stats.busy_us += disk->model->sync_us;
+        return RES_OK;
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = disk->sectors;
+        return RES_OK;
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = IMAGE_DISK_SECTOR_SIZE;
+        return RES_OK;
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = (0U != disk->model->erase_block) ? disk->model->erase_block : 1U;
+        return RES_OK;
+    case CTRL_TRIM:
+        range = (DWORD *)buff;
+        if((range[1] < range[0]) || (range[1] >= disk->sectors)) {
+            return RES_PARERR;
+        }
+        if(!disk->trim) {
+            return RES_OK;
+        }
+        if(disk->trim_logged < IMAGE_DISK_TRIM_LOG) {
+            disk->trim_log[disk->trim_logged][0] = range[0];
+            disk->trim_log[disk->trim_logged][1] = range[1];
+        }
+        disk->trim_logged++;
+        disk->stats.trims++;
+        disk->stats.sectors_trimmed += range[1] - range[0] + 1U;
+        disk->stats.busy_us += disk->model->write_command_us;
+        image_disk_discard(disk, range[0], range[1]);
+        return RES_OK;
+    default:
+        return RES_PARERR;
+    }
+}
+#endif /* _USE_IOCTL == 1 */
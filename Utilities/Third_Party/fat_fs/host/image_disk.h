@@ -0,0 +1,75 @@
+/*!
+    \file    image_disk.h
+    \brief   disk driver over a memory-mapped image file for running FatFs on the host
+*/
+
+#ifndef IMAGE_DISK_H
+#define IMAGE_DISK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* number of disks, selected by the lun of FATFS_LinkDriverEx() */
+#define IMAGE_DISK_LUNS                 2U
+
+/* CTRL_TRIM ranges a disk records between resets of its statistics */
+#define IMAGE_DISK_TRIM_LOG             256U
+
+/* timing of a storage device, all zero counts operations only */
+typedef struct {
+    const char *name;
+    uint32_t read_command_us;                           /*!< fixed cost of a read command */
+    uint32_t write_command_us;                          /*!< fixed cost of a write command */
+    uint32_t read_kbps;                                 /*!< read transfer rate in KB/s, 0 for free */
+    uint32_t write_kbps;                                /*!< program rate in KB/s, 0 for free */
+    uint32_t sync_us;                                   /*!< cost of CTRL_SYNC */
+    uint32_t erase_block;                               /*!< sectors per erase block, 0 for no flash model */
+    uint32_t erase_us;                                  /*!< cost of erasing one block */
+    uint32_t open_blocks;                               /*!< erase blocks the controller keeps open for writing */
+} image_disk_model_struct;
+
+/* device operations of one disk */
+typedef struct {
+    uint32_t reads;                                     /*!< disk_read calls */
+    uint32_t writes;                                    /*!< disk_write calls */
+    uint32_t sectors_read;                              /*!< sectors read */
+    uint32_t sectors_written;                           /*!< sectors written */
+    uint32_t syncs;                                     /*!< CTRL_SYNC requests */
+    uint32_t trims;                                     /*!< CTRL_TRIM requests */
+    uint32_t sectors_trimmed;                           /*!< sectors in CTRL_TRIM ranges */
+    uint32_t merges;                                    /*!< erase blocks the flash model had to copy and erase */
+    uint32_t sectors_copied;                            /*!< sectors the merges moved */
+    uint64_t busy_us;                                   /*!< simulated device time */
+} image_disk_stats_struct;
+
+/* models of typical devices */
+extern const image_disk_model_struct image_disk_model_ram;
+extern const image_disk_model_struct image_disk_model_sd;
+extern const image_disk_model_struct image_disk_model_usb;
+
+extern const Diskio_drvTypeDef image_disk_driver;
+
+/* function declarations */
+/* map an image file, or anonymous memory if file is NULL, as a disk */
+int image_disk_open(BYTE lun, const char *file, DWORD sectors, const image_disk_model_struct *model);
+/* write back and unmap a disk */
+void image_disk_close(BYTE lun);
+/* read the device operations of a disk */
+void image_disk_stats_get(BYTE lun, image_disk_stats_struct *stats);
+/* clear the device operations of a disk */
+void image_disk_stats_reset(BYTE lun);
+/* read the CTRL_TRIM ranges carried out since the last reset of the statistics */
+uint32_t image_disk_trims_get(BYTE lun, DWORD (*ranges)[2], uint32_t max);
+/* let a disk carry out CTRL_TRIM or ignore it like a device without erase commands */
+void image_disk_trim_set(BYTE lun, uint8_t enable);
+/* find a device model by name */
+const image_disk_model_struct *image_disk_model_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IMAGE_DISK_H */
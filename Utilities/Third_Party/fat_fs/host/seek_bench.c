@@ -0,0 +1,225 @@
+/*!
+    \file    seek_bench.c
+    \brief   cost of random reads in a large fragmented file with and without a cluster link map
+
+    A 1GB volume gets a 256MB file whose chain is broken into 64KB fragments by a second file
+    growing alongside. Random 512 byte reads over it run through the chain walk of f_lseek, a
+    link map that fits and a pool table that is too small. Finally the file grows while its map
+    is in use and the new data is read back at random.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "ff_fastseek.h"
+#include "image_disk.h"
+
+/* 1GB volume, only the pages that are written take memory */
+#define BENCH_DISK_SECTORS              2097152U
+#define BIG_SIZE                        (256U * 1024U * 1024U)
+#define FRAGMENT_SIZE                   (64U * 1024U)
+#define GROW_SIZE                       (1024U * 1024U)
+#define READS                           4096U
+#define READ_SIZE                       512U
+/* two words per fragment of the big file and some room for its growth */
+#define TABLE_WORDS                     (2U * (BIG_SIZE / FRAGMENT_SIZE) + 64U)
+
+static FATFS fs;
+static FIL other;
+static ff_fastseek_file_struct big;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static uint32_t chunk[FRAGMENT_SIZE / sizeof(uint32_t)];
+static DWORD table[TABLE_WORDS];
+static uint32_t lcg = 1U;
+
+/*!
+    \brief      next pseudo random number
+    \param[in]  none
+    \param[out] none
+    \retval     31 bit random number
+*/
+static uint32_t bench_random(void)
+{
+    lcg = lcg * 1103515245U + 12345U;
+    return (lcg >> 1) & 0x7FFFFFFFU;
+}
+
+/*!
+    \brief      fill the chunk with the file offsets of its words
+    \param[in]  offset: file offset of the chunk
+    \param[out] none
+    \retval     none
+*/
+static void chunk_fill(uint32_t offset)
+{
+    uint32_t i;
+
+    for(i = 0U; i < FRAGMENT_SIZE / sizeof(uint32_t); i++) {
+        chunk[i] = offset + i * sizeof(uint32_t);
+    }
+}
+
+/*!
+    \brief      write the big file in fragments interleaved with a second file
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_prepare(void)
+{
+    FRESULT res;
+    FIL file;
+    UINT bw;
+    uint32_t offset;
+
+    res = f_open(&file, "big.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    if(FR_OK == res) {
+        res = f_open(&other, "other.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    }
+    for(offset = 0U; (FR_OK == res) && (offset < BIG_SIZE); offset += FRAGMENT_SIZE) {
+        chunk_fill(offset);
+        res = f_write(&file, chunk, FRAGMENT_SIZE, &bw);
+        if(FR_OK == res) {
+            res = f_write(&other, chunk, 4096U, &bw);
+        }
+    }
+    if(FR_OK == res) {
+        res = f_close(&other);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      read at random offsets and check the data
+    \param[in]  name: name of the run
+    \param[in]  size: the reads go to offsets below this size
+    \param[in]  base: lowest offset of the reads
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT bench_reads(const char *name, uint32_t base, uint32_t size)
+{
+    image_disk_stats_struct stats;
+    struct timespec t0, t1;
+    uint32_t data[READ_SIZE / sizeof(uint32_t)];
+    uint32_t i, offset;
+    FRESULT res = FR_OK;
+    UINT br;
+    double us;
+
+    image_disk_stats_reset(0U);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(i = 0U; (FR_OK == res) && (i < READS); i++) {
+        offset = base + (bench_random() % ((size - base) / READ_SIZE)) * READ_SIZE;
+        res = ff_fastseek_lseek(&big, offset);
+        if(FR_OK == res) {
+            res = ff_fastseek_read(&big, data, READ_SIZE, &br);
+        }
+        if((FR_OK == res) && ((READ_SIZE != br) || (data[0] != offset) || (data[READ_SIZE / 4U - 1U] != offset + READ_SIZE - 4U))) {
+            printf("  wrong data at %u\n", (unsigned)offset);
+            res = FR_INT_ERR;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    image_disk_stats_get(0U, &stats);
+
+    us = (double)(t1.tv_sec - t0.tv_sec) * 1e6 + (double)(t1.tv_nsec - t0.tv_nsec) / 1e3;
+    printf("%-26s %-9s %10.1f %10.2f\n", name,
+           (FF_FASTSEEK_MAP_VALID == big.map) ? "map" : ((FF_FASTSEEK_MAP_FALLBACK == big.map) ? "fallback" : "chain"),
+           (double)stats.reads / READS, us / READS);
+    return res;
+}
+
+int main(void)
+{
+    ff_fastseek_stats_struct stats;
+    FRESULT res;
+    UINT bw;
+    uint32_t offset;
+
+    if((0U != FATFS_LinkDriver(&image_disk_driver, path)) || (0 != image_disk_open(0U, NULL, BENCH_DISK_SECTORS, NULL))) {
+        return 1;
+    }
+    res = f_mkfs(path, FM_FAT32, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK == res) {
+        res = bench_prepare();
+    }
+    printf("%u random %u byte reads in a %uMB file written in %uKB pieces, %u byte clusters\n",
+           READS, READ_SIZE, BIG_SIZE >> 20, FRAGMENT_SIZE >> 10, (unsigned)fs.csize * FF_MAX_SS);
+    printf("%-26s %-9s %10s %10s\n", "run", "seek", "dev reads", "us/read");
+
+    /* the pool is empty for the first open, a zero sized table of our own keeps it on the chain walk */
+    if(FR_OK == res) {
+        res = ff_fastseek_open(&big, "big.bin", FA_READ, table, 0U);
+    }
+    if(FR_OK == res) {
+        res = bench_reads("f_lseek, no map", 0U, BIG_SIZE);
+        ff_fastseek_close(&big);
+    }
+
+    if(FR_OK == res) {
+        res = ff_fastseek_open(&big, "big.bin", FA_READ, NULL, 0U);
+    }
+    if(FR_OK == res) {
+        res = bench_reads("pool table too small", 0U, BIG_SIZE);
+        printf("  %u fragments, the map needs %u words, the pool table has %u\n",
+               (unsigned)(big.needed - 2U) / 2U, (unsigned)big.needed, FF_FASTSEEK_POOL_WORDS);
+        ff_fastseek_close(&big);
+    }
+
+    if(FR_OK == res) {
+        res = ff_fastseek_open(&big, "big.bin", FA_READ | FA_WRITE, table, TABLE_WORDS);
+    }
+    if(FR_OK == res) {
+        res = bench_reads("link map at open", 0U, BIG_SIZE);
+    }
+
+    /* appending drops the map, the next read builds it over the new clusters */
+    if(FR_OK == res) {
+        res = ff_fastseek_lseek(&big, BIG_SIZE);
+    }
+    if(FR_OK == res) {
+        res = f_open(&other, "other.bin", FA_WRITE | FA_OPEN_APPEND);
+    }
+    for(offset = BIG_SIZE; (FR_OK == res) && (offset < BIG_SIZE + GROW_SIZE); offset += FRAGMENT_SIZE) {
+        chunk_fill(offset);
+        res = ff_fastseek_write(&big, chunk, FRAGMENT_SIZE, &bw);
+        if((FR_OK == res) && (FRAGMENT_SIZE != bw)) {
+            res = FR_DENIED;
+        }
+        if(FR_OK == res) {
+            res = f_write(&other, chunk, 4096U, &bw);
+        }
+    }
+    if(FR_OK == res) {
+        res = bench_reads("link map after growth", BIG_SIZE - GROW_SIZE, BIG_SIZE + GROW_SIZE);
+    }
+    if(FR_OK == res) {
+        res = f_close(&other);
+    }
+    if(FR_OK == res) {
+        res = ff_fastseek_close(&big);
+    }
+
+    ff_fastseek_stats_get(&stats);
+    printf("%u maps built, %u fallbacks, %u invalidations\n",
+           (unsigned)stats.maps, (unsigned)stats.fallbacks, (unsigned)stats.invalidations);
+
+    f_mount(NULL, path, 0U);
+    image_disk_close(0U);
+    if(FR_OK != res) {
+        printf("failed, FRESULT %d\n", (int)res);
+        return 1;
+    }
+    return 0;
+}
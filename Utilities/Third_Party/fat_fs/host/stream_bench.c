@@ -0,0 +1,288 @@
+/*!
+    \file    stream_bench.c
+    \brief   device operations per record of a data logger, f_write against ff_stream
+
+    Both loggers append 4KB records and make the data durable every 64KB, the f_write one with
+    f_sync, the stream one with its commit interval. The spread of device operations per record
+    shows whether the write latency stays flat. Each run is checked on a fresh mount, including
+    an abandoned stream that stands in for a power loss.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "ff_stream.h"
+#include "image_disk.h"
+
+/* 64MB volume */
+#define BENCH_DISK_SECTORS              131072U
+#define RECORD_SIZE                     4096U
+#define RECORDS                         1024U
+#define SYNC_RECORDS                    16U
+#define TAIL_SIZE                       100U
+
+static FATFS fs;
+static FIL file;
+static ff_stream_struct stream;
+static char path[4];
+static BYTE work[FF_MAX_SS];
+static BYTE record[RECORD_SIZE];
+static uint32_t stream_buffers[2U * RECORD_SIZE / sizeof(uint32_t)];
+
+/* device operations per record */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+} ops_struct;
+
+/*!
+    \brief      fill a record with a pattern of its index
+    \param[in]  index: record number
+    \param[out] none
+    \retval     none
+*/
+static void record_fill(uint32_t index)
+{
+    uint32_t i;
+
+    for(i = 0U; i < RECORD_SIZE; i++) {
+        record[i] = (BYTE)(index * 7U + i);
+    }
+}
+
+/*!
+    \brief      count the device operations since the last call
+    \param[in]  ops: statistics to update
+    \param[out] none
+    \retval     none
+*/
+static void ops_sample(ops_struct *ops)
+{
+    image_disk_stats_struct stats;
+    uint32_t n;
+
+    image_disk_stats_get(0U, &stats);
+    image_disk_stats_reset(0U);
+    n = stats.reads + stats.writes + stats.syncs;
+    if(n < ops->min) {
+        ops->min = n;
+    }
+    if(n > ops->max) {
+        ops->max = n;
+    }
+    ops->total += n;
+}
+
+/*!
+    \brief      check size and contents of the log on a fresh mount
+    \param[in]  records: whole records expected
+    \param[in]  tail: bytes of the partial record behind them
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT log_verify(uint32_t records, uint32_t tail)
+{
+    FRESULT res;
+    UINT br;
+    uint32_t i;
+
+    f_mount(NULL, path, 0U);
+    res = f_mount(&fs, path, 1U);
+    if(FR_OK == res) {
+        res = f_open(&file, "log.bin", FA_READ);
+    }
+    if((FR_OK == res) && (f_size(&file) != (FSIZE_t)records * RECORD_SIZE + tail)) {
+        printf("  size %u, expected %u\n", (unsigned)f_size(&file), (unsigned)(records * RECORD_SIZE + tail));
+        res = FR_INT_ERR;
+    }
+    for(i = 0U; (FR_OK == res) && (i <= records); i++) {
+        BYTE data[RECORD_SIZE];
+        UINT len = (i < records) ? RECORD_SIZE : tail;
+
+        record_fill(i);
+        res = f_read(&file, data, len, &br);
+        if((FR_OK == res) && ((br != len) || (0 != memcmp(data, record, len)))) {
+            res = FR_INT_ERR;
+        }
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      log through f_write and f_sync
+    \param[out] ops: device operations per record
+    \retval     FRESULT
+*/
+static FRESULT log_fwrite(ops_struct *ops)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t i;
+
+    res = f_open(&file, "log.bin", FA_WRITE | FA_CREATE_ALWAYS);
+    image_disk_stats_reset(0U);
+    for(i = 0U; (FR_OK == res) && (i < RECORDS); i++) {
+        record_fill(i);
+        res = f_write(&file, record, RECORD_SIZE, &bw);
+        if((FR_OK == res) && (0U == (i + 1U) % SYNC_RECORDS)) {
+            res = f_sync(&file);
+        }
+        ops_sample(ops);
+    }
+    if(FR_OK == res) {
+        record_fill(RECORDS);
+        res = f_write(&file, record, TAIL_SIZE, &bw);
+    }
+    if(FR_OK == res) {
+        res = f_close(&file);
+    }
+    if(FR_OK == res) {
+        res = log_verify(RECORDS, TAIL_SIZE);
+    }
+    return res;
+}
+
+/*!
+    \brief      log through a stream
+    \param[out] ops: device operations per record
+    \retval     FRESULT
+*/
+static FRESULT log_stream(ops_struct *ops)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t i;
+
+    /* one record of headroom for the tail */
+    res = ff_stream_open(&stream, "log.bin", (FSIZE_t)(RECORDS + 1U) * RECORD_SIZE, stream_buffers, RECORD_SIZE, (FSIZE_t)SYNC_RECORDS * RECORD_SIZE);
+    image_disk_stats_reset(0U);
+    for(i = 0U; (FR_OK == res) && (i < RECORDS); i++) {
+        record_fill(i);
+        res = ff_stream_write(&stream, record, RECORD_SIZE, &bw);
+        ops_sample(ops);
+    }
+    if(FR_OK == res) {
+        record_fill(RECORDS);
+        res = ff_stream_write(&stream, record, TAIL_SIZE, &bw);
+    }
+    if(FR_OK == res) {
+        res = ff_stream_close(&stream);
+    }
+    if(FR_OK == res) {
+        res = log_verify(RECORDS, TAIL_SIZE);
+    }
+    return res;
+}
+
+/*!
+    \brief      abandon a stream between two commits and check what a remount finds
+    \param[out] ops: unused
+    \retval     FRESULT
+*/
+static FRESULT log_stream_loss(ops_struct *ops)
+{
+    FRESULT res;
+    UINT bw;
+    uint32_t i;
+    DWORD free_before = 0U, free_after = 0U;
+    FATFS *pfs;
+
+    (void)ops;
+    res = ff_stream_open(&stream, "log.bin", (FSIZE_t)RECORDS * RECORD_SIZE, stream_buffers, RECORD_SIZE, (FSIZE_t)SYNC_RECORDS * RECORD_SIZE);
+    /* the last commit is at 3 * SYNC_RECORDS, the records behind it are lost */
+    for(i = 0U; (FR_OK == res) && (i < 3U * SYNC_RECORDS + SYNC_RECORDS / 2U); i++) {
+        record_fill(i);
+        res = ff_stream_write(&stream, record, RECORD_SIZE, &bw);
+    }
+    if(FR_OK == res) {
+        res = log_verify(3U * SYNC_RECORDS, 0U);
+    }
+
+    /* a clean stream gives the unused extent back, unlike the abandoned one on exFAT */
+    if(FR_OK == res) {
+        res = f_unlink("log.bin");
+    }
+    if(FR_OK == res) {
+        res = f_getfree(path, &free_before, &pfs);
+    }
+    if(FR_OK == res) {
+        res = ff_stream_open(&stream, "log.bin", (FSIZE_t)RECORDS * RECORD_SIZE, stream_buffers, RECORD_SIZE, 0U);
+    }
+    if(FR_OK == res) {
+        res = ff_stream_close(&stream);
+    }
+    if(FR_OK == res) {
+        res = f_getfree(path, &free_after, &pfs);
+    }
+    if((FR_OK == res) && (free_before != free_after)) {
+        printf("  %u free clusters before, %u after\n", (unsigned)free_before, (unsigned)free_after);
+        res = FR_INT_ERR;
+    }
+    return res;
+}
+
+/*!
+    \brief      run one logger on a new volume
+    \param[in]  name: name of the run
+    \param[in]  format: FM_FAT32 or FM_EXFAT
+    \param[in]  logger: logger to run
+    \param[out] none
+    \retval     0 on success, -1 otherwise
+*/
+static int bench_run(const char *name, BYTE format, FRESULT (*logger)(ops_struct *ops))
+{
+    ops_struct ops = {0xFFFFFFFFU, 0U, 0U};
+    FRESULT res;
+
+    if(0 != image_disk_open(0U, NULL, BENCH_DISK_SECTORS, NULL)) {
+        return -1;
+    }
+    res = f_mkfs(path, format, 0U, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK == res) {
+        res = logger(&ops);
+    }
+    f_mount(NULL, path, 0U);
+    image_disk_close(0U);
+
+    printf("%-20s %-6s ", name, (FM_EXFAT == format) ? "exFAT" : "FAT32");
+    if(FR_OK != res) {
+        printf("failed, FRESULT %d\n", (int)res);
+        return -1;
+    }
+    if(0U != ops.total) {
+        printf("%6u %6u %8.2f\n", (unsigned)ops.min, (unsigned)ops.max, (double)ops.total / RECORDS);
+    } else {
+        printf("ok\n");
+    }
+    return 0;
+}
+
+int main(void)
+{
+    static const BYTE formats[] = {FM_FAT32, FM_EXFAT};
+    uint32_t i;
+    int ret = 0;
+
+    if(0U != FATFS_LinkDriver(&image_disk_driver, path)) {
+        return 1;
+    }
+
+    printf("device operations per %u byte record, durable every %u records\n", RECORD_SIZE, SYNC_RECORDS);
+    printf("%-20s %-6s %6s %6s %8s\n", "logger", "fs", "min", "max", "mean");
+    for(i = 0U; i < sizeof(formats); i++) {
+        ret |= bench_run("f_write + f_sync", formats[i], log_fwrite);
+        ret |= bench_run("ff_stream", formats[i], log_stream);
+        ret |= bench_run("ff_stream power loss", formats[i], log_stream_loss);
+    }
+
+    return (0 == ret) ? 0 : 1;
+}
@@ -0,0 +1,535 @@
+/*!
+    \file    trim_bench.c
+    \brief   exact trimmed ranges after file deletes and the effect of trims on sustained writes
+
+    The first part runs file operations on a small FAT16 volume with the trim queue attached
+    and compares the CTRL_TRIM ranges the disk receives with the cluster runs of the deleted
+    files, taken from their link maps before the delete: a contiguous file, two interleaved
+    files deleted one after the other, a deleted file whose clusters are partly written again
+    before the queue is processed and a truncation that is only trimmed after the sync. The
+    disk zeroes trimmed sectors, so the files that remain are read back and checked.
+
+    The second part rotates log files on a 256MB volume with the sd model, keeping the newest
+    ones and deleting the oldest, with a device that ignores trims, with trims sent by FatFs as
+    it frees clusters and with the queue processed between files. The files end inside erase
+    blocks, the flash copies the rest of such a block unless it was trimmed.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff.h"
+#include "ff_gen_drv.h"
+#include "disk_trim.h"
+#include "image_disk.h"
+
+/* 64MB with 4KB clusters is a FAT16 volume, its allocation restarts at cluster 2 after a mount */
+#define TEST_DISK_SECTORS               131072U
+#define TEST_CLUSTER_SIZE               4096U
+#define BENCH_DISK_SECTORS              524288U
+#define PIECE_SIZE                      65536U
+#define CHUNK_SIZE                      32768U
+#define LOG_FILE_SIZE                   (3520U * 1024U)
+#define LOG_FILES_KEPT                  48U
+#define LOG_FILES_WRITTEN               160U
+#define MAX_RANGES                      128U
+
+static FATFS fs;
+static FIL file, other;
+static char path[4];
+static BYTE pdrv;
+static BYTE work[FF_MAX_SS];
+static uint32_t chunk[PIECE_SIZE / sizeof(uint32_t)];
+static DWORD link_map[2U * MAX_RANGES + 1U];
+static DWORD expected[MAX_RANGES][2];
+static DWORD logged[IMAGE_DISK_TRIM_LOG][2];
+static DWORD cut[MAX_RANGES][2];
+
+/*!
+    \brief      fill the chunk with the file offsets of its words, tagged with the file
+    \param[in]  tag: file tag
+    \param[in]  offset: file offset of the chunk
+    \param[in]  size: size of the chunk
+    \param[out] none
+    \retval     none
+*/
+static void chunk_fill(uint32_t tag, uint32_t offset, uint32_t size)
+{
+    uint32_t i;
+
+    for(i = 0U; i < size / sizeof(uint32_t); i++) {
+        chunk[i] = (tag << 24) ^ (offset + i * sizeof(uint32_t));
+    }
+}
+
+/*!
+    \brief      write files of the same size in pieces, alternating between them
+    \param[in]  names: files to write
+    \param[in]  n: number of files, 1 or 2
+    \param[in]  size: size of each file
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT files_write(const char *const *names, uint32_t n, uint32_t size)
+{
+    FIL *files[2] = {&file, &other};
+    FRESULT res = FR_OK;
+    uint32_t i, offset;
+    UINT bw;
+
+    for(i = 0U; (FR_OK == res) && (i < n); i++) {
+        res = f_open(files[i], names[i], FA_WRITE | FA_CREATE_ALWAYS);
+    }
+    for(offset = 0U; (FR_OK == res) && (offset < size); offset += PIECE_SIZE) {
+        for(i = 0U; (FR_OK == res) && (i < n); i++) {
+            chunk_fill((uint32_t)names[i][0], offset, PIECE_SIZE);
+            res = f_write(files[i], chunk, PIECE_SIZE, &bw);
+        }
+    }
+    for(i = 0U; (FR_OK == res) && (i < n); i++) {
+        res = f_close(files[i]);
+    }
+    return res;
+}
+
+/*!
+    \brief      read a file back and check its data
+    \param[in]  name: file
+    \param[in]  size: expected size
+    \param[out] none
+    \retval     FRESULT, FR_INT_ERR on wrong data
+*/
+static FRESULT file_check(const char *name, uint32_t size)
+{
+    uint32_t data[PIECE_SIZE / sizeof(uint32_t)];
+    FRESULT res;
+    uint32_t offset;
+    UINT br;
+
+    res = f_open(&file, name, FA_READ);
+    if((FR_OK == res) && (f_size(&file) != size)) {
+        res = FR_INT_ERR;
+    }
+    for(offset = 0U; (FR_OK == res) && (offset < size); offset += PIECE_SIZE) {
+        res = f_read(&file, data, PIECE_SIZE, &br);
+        chunk_fill((uint32_t)name[0], offset, PIECE_SIZE);
+        if((FR_OK == res) && ((PIECE_SIZE != br) || (0 != memcmp(data, chunk, PIECE_SIZE)))) {
+            printf("  %s: wrong data at %u\n", name, (unsigned)offset);
+            res = FR_INT_ERR;
+        }
+    }
+    f_close(&file);
+    return res;
+}
+
+/*!
+    \brief      append the sector ranges of the clusters of a file, from its link map
+    \param[in]  name: file
+    \param[in]  ranges: list of ranges
+    \param[in]  n: number of ranges in the list
+    \param[out] n: number of ranges with the ones of the file
+    \retval     FRESULT
+*/
+static FRESULT file_ranges(const char *name, DWORD (*ranges)[2], uint32_t *n)
+{
+    FRESULT res;
+    DWORD *run;
+
+    res = f_open(&file, name, FA_READ);
+    if(FR_OK == res) {
+        file.cltbl = link_map;
+        link_map[0] = sizeof(link_map) / sizeof(link_map[0]);
+        res = f_lseek(&file, CREATE_LINKMAP);
+        for(run = &link_map[1]; (FR_OK == res) && (0U != run[0]) && (*n < MAX_RANGES); run += 2) {
+            ranges[*n][0] = fs.database + (run[1] - 2U) * fs.csize;
+            ranges[*n][1] = ranges[*n][0] + run[0] * fs.csize - 1U;
+            (*n)++;
+        }
+        f_close(&file);
+    }
+    return res;
+}
+
+/*!
+    \brief      sort ranges by their first sector and join the overlapping and adjacent ones
+    \param[in]  ranges: list of ranges
+    \param[in]  n: number of ranges
+    \param[out] none
+    \retval     number of ranges after joining
+*/
+static uint32_t ranges_normalize(DWORD (*ranges)[2], uint32_t n)
+{
+    DWORD t0, t1;
+    uint32_t i, j, m = 0U;
+
+    for(i = 1U; i < n; i++) {
+        for(j = i; (j > 0U) && (ranges[j - 1U][0] > ranges[j][0]); j--) {
+            t0 = ranges[j][0];
+            t1 = ranges[j][1];
+            ranges[j][0] = ranges[j - 1U][0];
+            ranges[j][1] = ranges[j - 1U][1];
+            ranges[j - 1U][0] = t0;
+            ranges[j - 1U][1] = t1;
+        }
+    }
+    for(i = 0U; i < n; i++) {
+        if((m > 0U) && (ranges[i][0] <= ranges[m - 1U][1] + 1U)) {
+            if(ranges[i][1] > ranges[m - 1U][1]) {
+                ranges[m - 1U][1] = ranges[i][1];
+            }
+        } else {
+            ranges[m][0] = ranges[i][0];
+            ranges[m][1] = ranges[i][1];
+            m++;
+        }
+    }
+    return m;
+}
+
+/*!
+    \brief      remove the sectors of some ranges from a list of ranges
+    \param[in]  ranges: list of ranges
+    \param[in]  n: number of ranges
+    \param[in]  minus: ranges to remove
+    \param[in]  m: number of ranges to remove
+    \param[out] none
+    \retval     number of ranges left
+*/
+static uint32_t ranges_subtract(DWORD (*ranges)[2], uint32_t n, DWORD (*minus)[2], uint32_t m)
+{
+    uint32_t i, k;
+
+    for(k = 0U; k < m; k++) {
+        for(i = 0U; i < n; i++) {
+            if((ranges[i][1] < minus[k][0]) || (ranges[i][0] > minus[k][1])) {
+                continue;
+            }
+            if((ranges[i][0] < minus[k][0]) && (ranges[i][1] > minus[k][1]) && (n < MAX_RANGES)) {
+                ranges[n][0] = minus[k][1] + 1U;
+                ranges[n][1] = ranges[i][1];
+                ranges[i][1] = minus[k][0] - 1U;
+                n++;
+            } else if(ranges[i][0] < minus[k][0]) {
+                ranges[i][1] = minus[k][0] - 1U;
+            } else if(ranges[i][1] > minus[k][1]) {
+                ranges[i][0] = minus[k][1] + 1U;
+            } else {
+                ranges[i][0] = ranges[i][1] = 0U;
+            }
+        }
+    }
+    /* drop the emptied ranges */
+    for(i = 0U, k = 0U; i < n; i++) {
+        if(0U != ranges[i][1]) {
+            ranges[k][0] = ranges[i][0];
+            ranges[k][1] = ranges[i][1];
+            k++;
+        }
+    }
+    return k;
+}
+
+/*!
+    \brief      compare the trims the disk received with the expected ranges
+    \param[in]  name: name of the case
+    \param[in]  n: number of expected ranges in expected[]
+    \param[out] none
+    \retval     FRESULT, FR_INT_ERR if they differ
+*/
+static FRESULT trims_compare(const char *name, uint32_t n)
+{
+    disk_trim_stats_struct stats;
+    uint32_t i, count;
+    FRESULT res = FR_OK;
+
+    n = ranges_normalize(expected, n);
+    count = image_disk_trims_get(0U, logged, IMAGE_DISK_TRIM_LOG);
+    /* the queue merged what touches, the commands sorted have to match one to one */
+    if(count <= IMAGE_DISK_TRIM_LOG) {
+        for(i = 1U; i < count; i++) {
+            if(logged[i][0] < logged[i - 1U][0]) {
+                ranges_normalize(logged, count);
+                break;
+            }
+        }
+    }
+    if(count != n) {
+        res = FR_INT_ERR;
+    }
+    for(i = 0U; (FR_OK == res) && (i < n); i++) {
+        if((logged[i][0] != expected[i][0]) || (logged[i][1] != expected[i][1])) {
+            res = FR_INT_ERR;
+        }
+    }
+    disk_trim_stats_get(pdrv, &stats);
+    printf("%-30s %8u %9u %9u  %s\n", name, (unsigned)stats.requests, (unsigned)count,
+           (unsigned)stats.sectors_issued, (FR_OK == res) ? "ok" : "FAILED");
+    if(FR_OK != res) {
+        for(i = 0U; (i < n) || ((i < count) && (i < IMAGE_DISK_TRIM_LOG)); i++) {
+            printf("  expected %8u..%-8u trimmed %8u..%-8u\n",
+                   (i < n) ? (unsigned)expected[i][0] : 0U, (i < n) ? (unsigned)expected[i][1] : 0U,
+                   (i < count) ? (unsigned)logged[i][0] : 0U, (i < count) ? (unsigned)logged[i][1] : 0U);
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      format and mount a volume with the trim queue attached and clear the counters
+    \param[in]  sectors: size of the volume
+    \param[in]  format: FM_FAT or FM_FAT32
+    \param[in]  au: cluster size, 0 for the default
+    \param[in]  model: device model
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT volume_prepare(DWORD sectors, BYTE format, DWORD au, const image_disk_model_struct *model)
+{
+    FRESULT res;
+
+    f_mount(NULL, path, 0U);
+    if(0 != image_disk_open(0U, NULL, sectors, model)) {
+        return FR_NOT_READY;
+    }
+    /* the queue is attached after the format, f_mkfs trims the whole volume directly */
+    disk_trim_detach(pdrv);
+    res = f_mkfs(path, format, au, work, sizeof(work));
+    if(FR_OK == res) {
+        res = f_mount(&fs, path, 1U);
+    }
+    disk_trim_attach(pdrv);
+    image_disk_stats_reset(0U);
+    return res;
+}
+
+/*!
+    \brief      compare the trimmed ranges of file deletes with the cluster runs of the files
+    \param[in]  none
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT ranges_test(void)
+{
+    static const char *const one[] = {"a.bin"};
+    static const char *const two[] = {"a.bin", "b.bin"};
+    static const char *const rewrite[] = {"c.bin"};
+    FRESULT res, result = FR_OK;
+    uint32_t n, m;
+
+    printf("%-30s %8s %9s %9s\n", "case", "requests", "commands", "sectors");
+
+    /* a contiguous file is one range */
+    res = volume_prepare(TEST_DISK_SECTORS, FM_FAT, TEST_CLUSTER_SIZE, NULL);
+    n = 0U;
+    if(FR_OK == res) {
+        res = files_write(one, 1U, 1024U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("a.bin", expected, &n);
+    }
+    if(FR_OK == res) {
+        res = f_unlink("a.bin");
+    }
+    if(FR_OK == res) {
+        disk_trim_process(pdrv, 1U);
+        res = trims_compare("contiguous file", n);
+    }
+    result = (FR_OK != res) ? res : result;
+
+    /* two files written in turns free their pieces one by one, together they are one range */
+    res = volume_prepare(TEST_DISK_SECTORS, FM_FAT, TEST_CLUSTER_SIZE, NULL);
+    n = 0U;
+    if(FR_OK == res) {
+        res = files_write(two, 2U, 1024U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("a.bin", expected, &n);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("b.bin", expected, &n);
+    }
+    if(FR_OK == res) {
+        printf("  %u fragments\n", (unsigned)n);
+        res = f_unlink("a.bin");
+    }
+    if(FR_OK == res) {
+        res = f_unlink("b.bin");
+    }
+    if(FR_OK == res) {
+        disk_trim_process(pdrv, 1U);
+        res = trims_compare("interleaved files", n);
+    }
+    result = (FR_OK != res) ? res : result;
+
+    /* after the mount the allocation restarts at cluster 2 and reuses part of the freed range */
+    res = volume_prepare(TEST_DISK_SECTORS, FM_FAT, TEST_CLUSTER_SIZE, NULL);
+    n = 0U;
+    m = 0U;
+    if(FR_OK == res) {
+        res = files_write(two, 2U, 1024U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("a.bin", expected, &n);
+    }
+    if(FR_OK == res) {
+        res = f_unlink("a.bin");
+    }
+    if(FR_OK == res) {
+        f_mount(NULL, path, 0U);
+        res = f_mount(&fs, path, 1U);
+    }
+    if(FR_OK == res) {
+        res = files_write(rewrite, 1U, 256U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("c.bin", cut, &m);
+    }
+    if(FR_OK == res) {
+        n = ranges_subtract(expected, n, cut, m);
+        disk_trim_process(pdrv, 1U);
+        res = trims_compare("freed range written again", n);
+    }
+    if(FR_OK == res) {
+        res = file_check("b.bin", 1024U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_check("c.bin", 256U * 1024U);
+    }
+    result = (FR_OK != res) ? res : result;
+
+    /* a truncation frees clusters before the FAT reaches the device, nothing is trimmed until
+       the close syncs it */
+    res = volume_prepare(TEST_DISK_SECTORS, FM_FAT, TEST_CLUSTER_SIZE, NULL);
+    n = 0U;
+    m = 0U;
+    if(FR_OK == res) {
+        res = files_write(one, 1U, 1024U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("a.bin", expected, &n);
+    }
+    if(FR_OK == res) {
+        res = f_open(&other, "a.bin", FA_WRITE);
+    }
+    if(FR_OK == res) {
+        res = f_lseek(&other, 512U * 1024U);
+    }
+    if(FR_OK == res) {
+        res = f_truncate(&other);
+    }
+    if(FR_OK == res) {
+        disk_trim_process(pdrv, 1U);
+        res = trims_compare("truncation before the sync", 0U);
+    }
+    if(FR_OK == res) {
+        res = f_close(&other);
+    }
+    if(FR_OK == res) {
+        res = file_ranges("a.bin", cut, &m);
+    }
+    if(FR_OK == res) {
+        n = ranges_subtract(expected, n, cut, m);
+        disk_trim_process(pdrv, 1U);
+        res = trims_compare("truncation after the sync", n);
+    }
+    if(FR_OK == res) {
+        res = file_check("a.bin", 512U * 1024U);
+    }
+    result = (FR_OK != res) ? res : result;
+
+    return result;
+}
+
+/*!
+    \brief      rotate log files and report the device cost of the steady state
+    \param[in]  name: name of the run
+    \param[in]  mode: 0 device ignores trims, 1 trims sent by FatFs, 2 trim queue
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT rotation_bench(const char *name, uint32_t mode)
+{
+    image_disk_stats_struct stats, before;
+    char fname[16];
+    FRESULT res;
+    uint32_t i, offset;
+    uint64_t idle_us = 0U;
+    UINT bw;
+
+    res = volume_prepare(BENCH_DISK_SECTORS, FM_FAT32, 0U, &image_disk_model_sd);
+    if(2U != mode) {
+        disk_trim_detach(pdrv);
+    }
+    image_disk_trim_set(0U, (0U != mode) ? 1U : 0U);
+
+    for(i = 0U; (FR_OK == res) && (i < LOG_FILES_WRITTEN); i++) {
+        /* the first round fills the volume, the steady state is measured */
+        if(LOG_FILES_KEPT == i) {
+            image_disk_stats_reset(0U);
+            idle_us = 0U;
+        }
+        if(i >= LOG_FILES_KEPT) {
+            sprintf(fname, "log%03u.bin", (unsigned)(i - LOG_FILES_KEPT));
+            res = f_unlink(fname);
+        }
+        sprintf(fname, "log%03u.bin", (unsigned)i);
+        if(FR_OK == res) {
+            res = f_open(&file, fname, FA_WRITE | FA_CREATE_ALWAYS);
+        }
+        for(offset = 0U; (FR_OK == res) && (offset < LOG_FILE_SIZE); offset += CHUNK_SIZE) {
+            chunk_fill(i, offset, CHUNK_SIZE);
+            res = f_write(&file, chunk, CHUNK_SIZE, &bw);
+        }
+        if(FR_OK == res) {
+            res = f_close(&file);
+        }
+        /* idle time between two files */
+        if((FR_OK == res) && (2U == mode)) {
+            image_disk_stats_get(0U, &before);
+            disk_trim_process(pdrv, 0U);
+            image_disk_stats_get(0U, &stats);
+            idle_us += stats.busy_us - before.busy_us;
+        }
+    }
+    image_disk_stats_get(0U, &stats);
+    printf("%-22s %10.1f %9u %10u %9u %9.1f\n", name,
+           (double)(stats.busy_us - idle_us) / 1000.0 / ((double)(LOG_FILES_WRITTEN - LOG_FILES_KEPT) * LOG_FILE_SIZE / 1048576.0),
+           (unsigned)stats.merges, (unsigned)stats.sectors_copied, (unsigned)stats.trims, (double)idle_us / 1000.0);
+    image_disk_trim_set(0U, 1U);
+    return res;
+}
+
+int main(void)
+{
+    FRESULT res;
+
+    if(0U != FATFS_LinkDriver(&image_disk_driver, path)) {
+        return 1;
+    }
+    pdrv = (BYTE)(path[0] - '0');
+
+    res = ranges_test();
+
+    printf("\n%u files of %uKB rotated on a %uMB volume, model sd, %u kept\n",
+           (unsigned)LOG_FILES_WRITTEN, (unsigned)(LOG_FILE_SIZE >> 10),
+           (unsigned)(BENCH_DISK_SECTORS >> 11), (unsigned)LOG_FILES_KEPT);
+    printf("%-22s %10s %9s %10s %9s %9s\n", "trims", "ms per MB", "merges", "copied", "commands", "idle ms");
+    if(FR_OK == res) {
+        res = rotation_bench("ignored by the device", 0U);
+    }
+    if(FR_OK == res) {
+        res = rotation_bench("sent by FatFs", 1U);
+    }
+    if(FR_OK == res) {
+        res = rotation_bench("queued, sent when idle", 2U);
+    }
+
+    f_mount(NULL, path, 0U);
+    image_disk_close(0U);
+    if(FR_OK != res) {
+        printf("failed, FRESULT %d\n", (int)res);
+        return 1;
+    }
+    return 0;
+}
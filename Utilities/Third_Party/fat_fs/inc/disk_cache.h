@@ -0,0 +1,76 @@
+/*!
+    \file    disk_cache.h
+    \brief   write-back sector cache between diskio.c and the disk drivers
+*/
+
+#ifndef DISK_CACHE_H
+#define DISK_CACHE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* associativity, sectors that share a set compete for this many lines */
+#ifndef DISK_CACHE_WAYS
+#define DISK_CACHE_WAYS                 4U
+#endif /* DISK_CACHE_WAYS */
+
+/* sectors of the contiguous buffer for coalesced write-backs and read-ahead fetches */
+#ifndef DISK_CACHE_STAGING_SECTORS
+#define DISK_CACHE_STAGING_SECTORS      16U
+#endif /* DISK_CACHE_STAGING_SECTORS */
+
+/* sectors fetched beyond a read that continues the previous one */
+#ifndef DISK_CACHE_READ_AHEAD
+#define DISK_CACHE_READ_AHEAD           8U
+#endif /* DISK_CACHE_READ_AHEAD */
+
+/* transfers of at least this many sectors bypass the cache, FatFs moves whole clusters of
+   file data that way and they would only evict the FAT and directory sectors */
+#ifndef DISK_CACHE_BYPASS_SECTORS
+#define DISK_CACHE_BYPASS_SECTORS       8U
+#endif /* DISK_CACHE_BYPASS_SECTORS */
+
+/* statistics of the cache of one volume */
+typedef struct {
+    uint32_t read_hits;                                 /*!< sectors read from the cache */
+    uint32_t read_misses;                               /*!< sectors the device had to deliver */
+    uint32_t write_hits;                                /*!< sectors written into a cached line */
+    uint32_t write_misses;                              /*!< sectors written into a newly allocated line */
+    uint32_t read_ahead;                                /*!< sectors fetched ahead of a sequential read */
+    uint32_t read_ahead_hits;                           /*!< of these, sectors that were read later */
+    uint32_t bypassed;                                  /*!< sectors of large transfers that went around the cache */
+    uint32_t writebacks;                                /*!< device writes of dirty runs */
+    uint32_t written_back;                              /*!< sectors written by them */
+    uint32_t flushes;                                   /*!< CTRL_SYNC requests */
+    uint32_t device_reads;                              /*!< disk_read calls of the driver */
+    uint32_t device_writes;                             /*!< disk_write calls of the driver */
+} disk_cache_stats_struct;
+
+/* function declarations */
+/* attach a cache in the given memory to a volume, the memory may be in EXMC SDRAM */
+DRESULT disk_cache_attach(BYTE pdrv, void *memory, uint32_t size);
+/* write back all dirty sectors and detach the cache of a volume */
+DRESULT disk_cache_detach(BYTE pdrv);
+/* check whether a volume has a cache */
+uint8_t disk_cache_attached(BYTE pdrv);
+/* read sectors through the cache */
+DRESULT disk_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count);
+/* write sectors into the cache */
+DRESULT disk_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count);
+/* write all dirty sectors to the device in coalesced runs */
+DRESULT disk_cache_flush(BYTE pdrv);
+/* drop the cached sectors of a range that is no longer used */
+void disk_cache_trim(BYTE pdrv, DWORD start, DWORD end);
+/* drop all cached sectors, dirty ones included */
+void disk_cache_invalidate(BYTE pdrv);
+/* read the statistics of the cache of a volume */
+void disk_cache_stats_get(BYTE pdrv, disk_cache_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_H */
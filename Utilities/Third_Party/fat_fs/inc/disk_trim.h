@@ -0,0 +1,64 @@
+/*!
+    \file    disk_trim.h
+    \brief   queue of released sector ranges between diskio.c and the disk drivers
+*/
+
+#ifndef DISK_TRIM_H
+#define DISK_TRIM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* pending ranges per volume, a full queue issues its largest range early */
+#ifndef DISK_TRIM_RANGES
+#define DISK_TRIM_RANGES                16U
+#endif /* DISK_TRIM_RANGES */
+
+/* ranges shorter than this stay queued in idle time and wait for their neighbours */
+#ifndef DISK_TRIM_MIN_SECTORS
+#define DISK_TRIM_MIN_SECTORS           64U
+#endif /* DISK_TRIM_MIN_SECTORS */
+
+/* statistics of the trim queue of one volume */
+typedef struct {
+    uint32_t requests;                                  /*!< CTRL_TRIM ranges from FatFs */
+    uint32_t sectors;                                   /*!< sectors in them */
+    uint32_t merged;                                    /*!< requests joined with a pending range */
+    uint32_t issued;                                    /*!< CTRL_TRIM commands sent to the driver */
+    uint32_t sectors_issued;                            /*!< sectors in them */
+    uint32_t forced;                                    /*!< of these, commands sent early by a full queue */
+    uint32_t sectors_cancelled;                         /*!< pending sectors written again before their trim */
+    uint32_t sectors_dropped;                           /*!< pending sectors given up, the device keeps their data */
+    uint32_t errors;                                    /*!< commands the driver failed */
+} disk_trim_stats_struct;
+
+/* function declarations */
+/* queue the CTRL_TRIM requests of a volume instead of passing them to the driver */
+DRESULT disk_trim_attach(BYTE pdrv);
+/* issue all pending ranges and pass CTRL_TRIM through again */
+DRESULT disk_trim_detach(BYTE pdrv);
+/* check whether a volume queues its trims */
+uint8_t disk_trim_attached(BYTE pdrv);
+/* add a released range, it is merged with the pending ranges it touches */
+DRESULT disk_trim_queue(BYTE pdrv, DWORD start, DWORD end);
+/* remove sectors that are written again from the pending ranges */
+DRESULT disk_trim_written(BYTE pdrv, DWORD sector, UINT count);
+/* the device holds everything written so far, pending ranges may be issued */
+void disk_trim_synced(BYTE pdrv);
+/* issue pending ranges when the volume is idle, all of them or the large ones */
+DRESULT disk_trim_process(BYTE pdrv, uint8_t all);
+/* number of sectors waiting for their trim */
+uint32_t disk_trim_pending(BYTE pdrv);
+/* drop all pending ranges, the medium changed */
+void disk_trim_invalidate(BYTE pdrv);
+/* read the statistics of the trim queue of a volume */
+void disk_trim_stats_get(BYTE pdrv, disk_trim_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_TRIM_H */
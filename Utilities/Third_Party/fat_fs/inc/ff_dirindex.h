@@ -0,0 +1,88 @@
+/*!
+    \file    ff_dirindex.h
+    \brief   name index of large FAT directories and batched directory reads
+*/
+
+#ifndef FF_DIRINDEX_H
+#define FF_DIRINDEX_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff.h"
+
+/* directories the index keeps track of, indexed ones and ones marked for linear search,
+   16 bytes each */
+#ifndef FF_DIRINDEX_DIRS
+#define FF_DIRINDEX_DIRS                16U
+#endif /* FF_DIRINDEX_DIRS */
+
+/* directory entries a directory needs before it gets an index, a smaller table is read in a
+   few sectors anyway */
+#ifndef FF_DIRINDEX_MIN_ENTRIES
+#define FF_DIRINDEX_MIN_ENTRIES         64U
+#endif /* FF_DIRINDEX_MIN_ENTRIES */
+
+/* results of ff_dirindex_find() besides the handle of an index */
+#define FF_DIRINDEX_NONE                (-1)            /*!< the directory has not been scanned yet */
+#define FF_DIRINDEX_LINEAR              (-2)            /*!< the directory is searched without an index */
+
+/* statistics of the directory index */
+typedef struct {
+    uint32_t builds;                                    /*!< directories scanned into an index */
+    uint32_t small;                                     /*!< scanned directories too small for an index */
+    uint32_t overflows;                                 /*!< directories that did not fit the memory */
+    uint32_t evictions;                                 /*!< indexes dropped to make room for another directory */
+    uint32_t invalidations;                             /*!< indexes dropped because the directory or volume went away */
+    uint32_t inserts;                                   /*!< names added by created entries */
+    uint32_t removals;                                  /*!< names removed with deleted entries */
+    uint32_t lookups;                                   /*!< name lookups answered by an index */
+    uint32_t absent;                                    /*!< of these, names reported missing */
+    uint32_t collisions;                                /*!< candidate entries that turned out to hold another name */
+    uint32_t linear;                                    /*!< name lookups that searched the directory table */
+} ff_dirindex_stats_struct;
+
+/* function declarations */
+/* give the index its memory and clear it, the memory may be in EXMC SDRAM */
+FRESULT ff_dirindex_attach(void *memory, uint32_t size);
+/* stop using the index, lookups search the directory tables again */
+void ff_dirindex_detach(void);
+/* look up the index of a directory */
+int ff_dirindex_find(WORD fsid, DWORD sclust);
+/* start an empty index for a directory that is about to be scanned */
+int ff_dirindex_create(WORD fsid, DWORD sclust);
+/* finish the scan of a directory */
+int ff_dirindex_built(int dir, DWORD entries);
+/* count entries created in a directory without an index */
+void ff_dirindex_grown(WORD fsid, DWORD sclust, UINT entries);
+/* add a name of an entry block of an indexed directory */
+int ff_dirindex_insert(int dir, DWORD hash, DWORD ofs, DWORD clust);
+/* remove the names of the entry blocks in a range of directory offsets */
+void ff_dirindex_remove(int dir, DWORD first, DWORD last);
+/* iterate over the entry blocks that may hold a name */
+int ff_dirindex_next(int dir, DWORD hash, UINT *pos, DWORD *ofs, DWORD *clust);
+/* count a lookup in the statistics */
+void ff_dirindex_account(int dir, int found, UINT collisions);
+/* forget the index of a directory */
+void ff_dirindex_drop(WORD fsid, DWORD sclust);
+/* forget all indexes of a volume */
+void ff_dirindex_drop_volume(WORD fsid);
+/* hash of a short name in directory entry format */
+DWORD ff_dirindex_hash_sfn(const BYTE *sfn);
+#if FF_USE_LFN
+/* hash of the part of a long name stored in one LFN entry */
+DWORD ff_dirindex_hash_part(const WCHAR *part, UINT len, UINT ord);
+/* hash of a long name, the combination of the hashes of its parts */
+DWORD ff_dirindex_hash_lfn(const WCHAR *lfn);
+#endif /* FF_USE_LFN */
+/* read up to count directory items in one call */
+FRESULT ff_dirindex_read_batch(DIR *dp, FILINFO *fno, UINT count, UINT *read);
+/* read the statistics of the directory index */
+void ff_dirindex_stats_get(ff_dirindex_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_DIRINDEX_H */
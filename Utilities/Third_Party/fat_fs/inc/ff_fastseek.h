@@ -0,0 +1,72 @@
+/*!
+    \file    ff_fastseek.h
+    \brief   files that keep a cluster link map for fast random access
+*/
+
+#ifndef FF_FASTSEEK_H
+#define FF_FASTSEEK_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff.h"
+
+/* link map tables handed out to files opened without a table of their own, 0 disables the pool */
+#ifndef FF_FASTSEEK_POOL_TABLES
+#define FF_FASTSEEK_POOL_TABLES         2U
+#endif /* FF_FASTSEEK_POOL_TABLES */
+
+/* words per pool table, a file in n fragments needs 2 * n + 2 */
+#ifndef FF_FASTSEEK_POOL_WORDS
+#define FF_FASTSEEK_POOL_WORDS          64U
+#endif /* FF_FASTSEEK_POOL_WORDS */
+
+/* state of the link map of a file */
+typedef enum {
+    FF_FASTSEEK_MAP_NONE = 0,                           /*!< not built yet or dropped, built on the next access */
+    FF_FASTSEEK_MAP_VALID,                              /*!< seeks and reads use the map */
+    FF_FASTSEEK_MAP_FALLBACK,                           /*!< no table or too small, seeks walk the FAT chain */
+} ff_fastseek_map_enum;
+
+/* statistics of all fast seek files */
+typedef struct {
+    uint32_t maps;                                      /*!< link maps built */
+    uint32_t fallbacks;                                 /*!< maps that did not fit their table */
+    uint32_t invalidations;                             /*!< maps dropped because the file grew */
+    uint32_t pool_empty;                                /*!< opens that found no free pool table */
+} ff_fastseek_stats_struct;
+
+/* a file with its link map, f_* calls that neither grow nor shrink it may use the file member */
+typedef struct {
+    FIL file;                                           /*!< the file */
+    DWORD *table;                                       /*!< link map table, NULL if none */
+    UINT table_words;                                   /*!< size of the table in words */
+    DWORD needed;                                       /*!< words the last map that did not fit needed */
+    uint8_t pool;                                       /*!< index of the pool table + 1, 0 if the caller's */
+    uint8_t map;                                        /*!< ff_fastseek_map_enum */
+} ff_fastseek_file_struct;
+
+/* function declarations */
+/* open a file and build its link map */
+FRESULT ff_fastseek_open(ff_fastseek_file_struct *fsf, const TCHAR *path, BYTE mode, DWORD *table, UINT table_words);
+/* read from the current position */
+FRESULT ff_fastseek_read(ff_fastseek_file_struct *fsf, void *buff, UINT btr, UINT *br);
+/* write at the current position, a write that needs new clusters drops the map */
+FRESULT ff_fastseek_write(ff_fastseek_file_struct *fsf, const void *buff, UINT btw, UINT *bw);
+/* move the file pointer, through the map when possible */
+FRESULT ff_fastseek_lseek(ff_fastseek_file_struct *fsf, FSIZE_t ofs);
+/* truncate the file at the current position */
+FRESULT ff_fastseek_truncate(ff_fastseek_file_struct *fsf);
+/* drop the map after the file was changed by other means, it is rebuilt on the next access */
+void ff_fastseek_invalidate(ff_fastseek_file_struct *fsf);
+/* close the file and give its pool table back */
+FRESULT ff_fastseek_close(ff_fastseek_file_struct *fsf);
+/* read the statistics of all fast seek files */
+void ff_fastseek_stats_get(ff_fastseek_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_FASTSEEK_H */
@@ -0,0 +1,59 @@
+/*!
+    \file    ff_stream.h
+    \brief   streaming writes into a preallocated contiguous FatFs file
+*/
+
+#ifndef FF_STREAM_H
+#define FF_STREAM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff.h"
+#include "diskio.h"
+
+/* statistics of one stream */
+typedef struct {
+    uint32_t buffers;                                   /*!< buffers written to the device */
+    uint32_t commits;                                   /*!< directory entry updates */
+    uint32_t errors;                                    /*!< failed device writes or commits */
+} ff_stream_stats_struct;
+
+/* a log file written sector-wise into its preallocated extent, owned by the application */
+typedef struct {
+    FIL file;                                           /*!< the file, only used for its directory entry */
+    BYTE pdrv;                                          /*!< physical drive of the volume */
+    DWORD sector;                                       /*!< first sector of the extent */
+    FSIZE_t extent;                                     /*!< bytes preallocated, a multiple of the buffer size */
+    FSIZE_t size;                                       /*!< bytes on the device, full buffers only */
+    FSIZE_t committed;                                  /*!< file size recorded in the directory entry */
+    FSIZE_t commit_interval;                            /*!< bytes between automatic commits, 0 for none */
+    BYTE *buffer[2];                                    /*!< double buffer, one is filled while the other is written */
+    UINT buffer_size;                                   /*!< bytes per buffer, a multiple of the sector size */
+    UINT fill;                                          /*!< bytes in the buffer being filled */
+    uint8_t active;                                     /*!< index of the buffer being filled */
+    ff_stream_stats_struct stats;
+} ff_stream_struct;
+
+/* function declarations */
+/* create a file with a contiguous extent and open it for streaming */
+FRESULT ff_stream_open(ff_stream_struct *stream, const TCHAR *path, FSIZE_t extent, void *buffers, UINT buffer_size, FSIZE_t commit_interval);
+/* get the buffer to be filled next, e.g. the target of a DMA transfer */
+BYTE *ff_stream_buffer_get(ff_stream_struct *stream);
+/* write the completely filled buffer and switch to the other one */
+FRESULT ff_stream_buffer_submit(ff_stream_struct *stream);
+/* copy data into the stream, full buffers are written as they complete */
+FRESULT ff_stream_write(ff_stream_struct *stream, const void *data, UINT btw, UINT *bw);
+/* record the data written so far in the directory entry */
+FRESULT ff_stream_commit(ff_stream_struct *stream);
+/* write the partial buffer, commit the exact size and free the unused part of the extent */
+FRESULT ff_stream_close(ff_stream_struct *stream);
+/* read the statistics of a stream */
+void ff_stream_stats_get(ff_stream_struct *stream, ff_stream_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_STREAM_H */
@@ -0,0 +1,42 @@
+/*!
+    \file    nand_diskio.h
+    \brief   FatFs disk I/O driver for the NAND flash on the EXMC interface
+*/
+
+#ifndef NAND_DISKIO_H
+#define NAND_DISKIO_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* statistics of the NAND disk driver */
+typedef struct {
+    uint32_t reads;                                     /*!< disk_read calls */
+    uint32_t writes;                                    /*!< disk_write calls */
+    uint32_t sectors_read;                              /*!< sectors moved by disk_read */
+    uint32_t sectors_written;                           /*!< sectors moved by disk_write */
+    uint32_t sectors_blank;                             /*!< sectors read from erased blocks without a page read */
+    uint32_t loads;                                     /*!< blocks read into the block buffer */
+    uint32_t loads_skipped;                             /*!< block buffer fills of erased or completely written blocks */
+    uint32_t programs;                                  /*!< block buffers programmed back */
+    uint32_t erases;                                    /*!< blocks erased */
+    uint32_t trims;                                     /*!< CTRL_TRIM ranges */
+    uint32_t blocks_trimmed;                            /*!< blocks erased or dropped from the buffer by them */
+    uint32_t errors;                                    /*!< failed page and erase operations */
+} nand_diskio_stats_struct;
+
+/* driver for FATFS_LinkDriver(), exmc_nandflash_init() has to be called before */
+extern const Diskio_drvTypeDef NAND_Driver;
+
+/* function declarations */
+/* read the statistics of the NAND disk driver */
+void nand_diskio_stats_get(nand_diskio_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NAND_DISKIO_H */
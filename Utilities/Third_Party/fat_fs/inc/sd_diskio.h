@@ -0,0 +1,43 @@
+/*!
+    \file    sd_diskio.h
+    \brief   FatFs disk I/O driver for an SD card on the SDIO interface
+*/
+
+#ifndef SD_DISKIO_H
+#define SD_DISKIO_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "ff_gen_drv.h"
+
+/* sectors of the word aligned buffer that carries transfers from and to unaligned FatFs buffers */
+#ifndef SD_DISKIO_BOUNCE_SECTORS
+#define SD_DISKIO_BOUNCE_SECTORS        8U
+#endif /* SD_DISKIO_BOUNCE_SECTORS */
+
+/* statistics of the SD disk driver */
+typedef struct {
+    uint32_t reads;                                     /*!< disk_read calls */
+    uint32_t writes;                                    /*!< disk_write calls */
+    uint32_t sectors_read;                              /*!< sectors moved by disk_read */
+    uint32_t sectors_written;                           /*!< sectors moved by disk_write */
+    uint32_t sectors_bounced;                           /*!< sectors copied through the bounce buffer */
+    uint32_t trims;                                     /*!< CTRL_TRIM ranges erased on the card */
+    uint32_t errors;                                    /*!< failed transfers and erases */
+} sd_diskio_stats_struct;
+
+/* driver for FATFS_LinkDriver(), the SDIO and DMA1 channel 3 interrupts have to call
+   sd_interrupts_process() and sd_dma_interrupts_process() */
+extern const Diskio_drvTypeDef SD_Driver;
+
+/* function declarations */
+/* read the statistics of the SD disk driver */
+void sd_diskio_stats_get(sd_diskio_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SD_DISKIO_H */
@@ -0,0 +1,566 @@
+/*!
+    \file    disk_cache.c
+    \brief   write-back sector cache between diskio.c and the disk drivers
+
+    FatFs keeps a single sector window per volume, so FAT and directory updates read and write
+    the same few sectors over and over. The cache holds sectors in an N-way set-associative
+    array of lines, the set is the sector number modulo the number of sets, so a run of
+    consecutive sectors spreads over consecutive sets. Lines are replaced least recently used
+    first.
+
+    Writes only mark lines dirty. A dirty line that is evicted is written together with the
+    dirty sectors around it as one multi-sector write, CTRL_SYNC writes all dirty sectors in
+    ascending runs the same way. A read that continues the previous one fetches
+    DISK_CACHE_READ_AHEAD more sectors in the same device read. Transfers of whole clusters
+    bypass the cache. The application hands over the memory, which may be EXMC SDRAM.
+*/
+
+#include "disk_cache.h"
+#include <string.h>
+
+#define DISK_CACHE_SECTOR_SIZE          512U
+
+/* a cached sector */
+typedef struct {
+    DWORD sector;                                       /*!< sector held by the line */
+    uint32_t stamp;                                     /*!< cache clock of the last access */
+    uint8_t valid;                                      /*!< the line holds a sector */
+    uint8_t dirty;                                      /*!< the sector differs from the device */
+    uint8_t prefetched;                                 /*!< fetched ahead and not read yet */
+} disk_cache_line_struct;
+
+/* cache of one volume */
+typedef struct {
+    disk_cache_line_struct *lines;                      /*!< sets * DISK_CACHE_WAYS lines, NULL if detached */
+    BYTE *data;                                         /*!< sector data of the lines */
+    BYTE *staging;                                      /*!< DISK_CACHE_STAGING_SECTORS contiguous sectors */
+    uint32_t sets;                                      /*!< number of sets, a power of two */
+    uint32_t clock;                                     /*!< access counter for the LRU order */
+    DWORD sectors;                                      /*!< size of the volume, 0 if unknown */
+    DWORD next_read;                                    /*!< sector after the previous read */
+    disk_cache_stats_struct stats;
+} disk_cache_struct;
+
+extern Disk_drvTypeDef disk;
+
+static disk_cache_struct disk_cache[_VOLUMES];
+
+/*!
+    \brief      get the data of a line
+    \param[in]  cache: cache of the volume
+    \param[in]  idx: line index
+    \param[out] none
+    \retval     sector data
+*/
+static BYTE *disk_cache_line_data(disk_cache_struct *cache, uint32_t idx)
+{
+    return cache->data + idx * DISK_CACHE_SECTOR_SIZE;
+}
+
+/*!
+    \brief      find the line of a sector
+    \param[in]  cache: cache of the volume
+    \param[in]  sector: sector to look up
+    \param[out] none
+    \retval     line index, -1 if the sector is not cached
+*/
+static int32_t disk_cache_lookup(disk_cache_struct *cache, DWORD sector)
+{
+    uint32_t base = (sector & (cache->sets - 1U)) * DISK_CACHE_WAYS;
+    uint32_t way;
+
+    for(way = 0U; way < DISK_CACHE_WAYS; way++) {
+        if(cache->lines[base + way].valid && (sector == cache->lines[base + way].sector)) {
+            return (int32_t)(base + way);
+        }
+    }
+    return -1;
+}
+
+/*!
+    \brief      choose the line a sector replaces, an empty one or the least recently used one
+    \param[in]  cache: cache of the volume
+    \param[in]  sector: sector to place
+    \param[out] none
+    \retval     line index
+*/
+static uint32_t disk_cache_victim(disk_cache_struct *cache, DWORD sector)
+{
+    uint32_t base = (sector & (cache->sets - 1U)) * DISK_CACHE_WAYS;
+    uint32_t victim = base;
+    uint32_t age, age_max = 0U;
+    uint32_t way;
+
+    for(way = 0U; way < DISK_CACHE_WAYS; way++) {
+        if(!cache->lines[base + way].valid) {
+            return base + way;
+        }
+        /* the age survives the wrap of the clock */
+        age = cache->clock - cache->lines[base + way].stamp;
+        if(age >= age_max) {
+            age_max = age;
+            victim = base + way;
+        }
+    }
+    return victim;
+}
+
+/*!
+    \brief      read sectors from the driver
+    \param[in]  pdrv: physical drive number
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT disk_cache_device_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    disk_cache[pdrv].stats.device_reads++;
+    return disk.drv[pdrv]->disk_read(disk.lun[pdrv], buff, sector, count);
+}
+
+#if _USE_WRITE == 1
+/*!
+    \brief      write sectors to the driver
+    \param[in]  pdrv: physical drive number
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT disk_cache_device_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    disk_cache[pdrv].stats.device_writes++;
+    return disk.drv[pdrv]->disk_write(disk.lun[pdrv], buff, sector, count);
+}
+#endif /* _USE_WRITE == 1 */
+
+/*!
+    \brief      write a dirty line together with the dirty sectors around it in one device write
+    \param[in]  pdrv: physical drive number
+    \param[in]  idx: dirty line
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT disk_cache_writeback(BYTE pdrv, uint32_t idx)
+{
+#if _USE_WRITE == 1
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    DWORD first = cache->lines[idx].sector;
+    DRESULT res;
+    int32_t line;
+    UINT run, i;
+
+    /* start at the lowest dirty neighbour that still leaves the line inside the staging buffer */
+    while((first > 0U) && (cache->lines[idx].sector - first < DISK_CACHE_STAGING_SECTORS - 1U)) {
+        line = disk_cache_lookup(cache, first - 1U);
+        if((line < 0) || !cache->lines[line].dirty) {
+            break;
+        }
+        first--;
+    }
+
+    for(run = 0U; run < DISK_CACHE_STAGING_SECTORS; run++) {
+        line = disk_cache_lookup(cache, first + run);
+        if((line < 0) || !cache->lines[line].dirty) {
+            break;
+        }
+        memcpy(cache->staging + run * DISK_CACHE_SECTOR_SIZE, disk_cache_line_data(cache, (uint32_t)line), DISK_CACHE_SECTOR_SIZE);
+    }
+
+    res = disk_cache_device_write(pdrv, cache->staging, first, run);
+    if(RES_OK == res) {
+        for(i = 0U; i < run; i++) {
+            cache->lines[disk_cache_lookup(cache, first + i)].dirty = 0U;
+        }
+        cache->stats.writebacks++;
+        cache->stats.written_back += run;
+    }
+    return res;
+#else
+    return RES_ERROR;
+#endif /* _USE_WRITE == 1 */
+}
+
+/*!
+    \brief      take a line for a sector, writing back the dirty sector it held
+    \param[in]  pdrv: physical drive number
+    \param[in]  sector: sector to place, must not be cached
+    \param[out] pidx: line index
+    \retval     DRESULT
+*/
+static DRESULT disk_cache_allocate(BYTE pdrv, DWORD sector, uint32_t *pidx)
+{
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    disk_cache_line_struct *line;
+    uint32_t idx = disk_cache_victim(cache, sector);
+    DRESULT res;
+
+    line = &cache->lines[idx];
+    if(line->valid && line->dirty) {
+        res = disk_cache_writeback(pdrv, idx);
+        if(RES_OK != res) {
+            return res;
+        }
+    }
+
+    line->valid = 1U;
+    line->dirty = 0U;
+    line->prefetched = 0U;
+    line->sector = sector;
+    line->stamp = ++cache->clock;
+    *pidx = idx;
+    return RES_OK;
+}
+
+/*!
+    \brief      ask the driver for the size of the volume
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     none
+*/
+static void disk_cache_geometry_get(BYTE pdrv)
+{
+    DWORD sectors = 0U;
+
+    disk_cache[pdrv].sectors = 0U;
+#if _USE_IOCTL == 1
+    if((NULL != disk.drv[pdrv]) && disk.is_initialized[pdrv] &&
+            !(disk.drv[pdrv]->disk_status(disk.lun[pdrv]) & STA_NOINIT) &&
+            (RES_OK == disk.drv[pdrv]->disk_ioctl(disk.lun[pdrv], GET_SECTOR_COUNT, &sectors))) {
+        disk_cache[pdrv].sectors = sectors;
+    }
+#endif /* _USE_IOCTL == 1 */
+}
+
+/*!
+    \brief      attach a cache in the given memory to a volume, the memory may be in EXMC SDRAM
+    \param[in]  pdrv: physical drive number
+    \param[in]  memory: memory of the cache, used until the cache is detached
+    \param[in]  size: size of the memory in bytes
+    \param[out] none
+    \retval     DRESULT, RES_PARERR if the memory holds less lines than the staging buffer sectors
+*/
+DRESULT disk_cache_attach(BYTE pdrv, void *memory, uint32_t size)
+{
+    disk_cache_struct *cache;
+    BYTE *base = (BYTE *)memory;
+    uint32_t offset, lines, sets;
+
+    if((pdrv >= _VOLUMES) || (NULL == memory)) {
+        return RES_PARERR;
+    }
+    cache = &disk_cache[pdrv];
+
+    /* word aligned lines keep the driver DMA off its bounce buffer */
+    offset = (uint32_t)((4U - ((uintptr_t)base & 0x3U)) & 0x3U);
+    if(size < offset + DISK_CACHE_STAGING_SECTORS * DISK_CACHE_SECTOR_SIZE) {
+        return RES_PARERR;
+    }
+    base += offset;
+    size -= offset + DISK_CACHE_STAGING_SECTORS * DISK_CACHE_SECTOR_SIZE;
+
+    lines = size / (DISK_CACHE_SECTOR_SIZE + sizeof(disk_cache_line_struct));
+    sets = lines / DISK_CACHE_WAYS;
+    while(sets & (sets - 1U)) {
+        sets &= sets - 1U;
+    }
+    /* a miss run of a full staging buffer has to find a line for every sector */
+    if(sets * DISK_CACHE_WAYS < DISK_CACHE_STAGING_SECTORS) {
+        return RES_PARERR;
+    }
+
+    cache->data = base;
+    cache->staging = base + sets * DISK_CACHE_WAYS * DISK_CACHE_SECTOR_SIZE;
+    cache->lines = (disk_cache_line_struct *)(void *)(cache->staging + DISK_CACHE_STAGING_SECTORS * DISK_CACHE_SECTOR_SIZE);
+    cache->sets = sets;
+    memset(&cache->stats, 0, sizeof(cache->stats));
+    disk_cache_invalidate(pdrv);
+
+    return RES_OK;
+}
+
+/*!
+    \brief      write back all dirty sectors and detach the cache of a volume
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     DRESULT, the cache stays attached if the write-back fails
+*/
+DRESULT disk_cache_detach(BYTE pdrv)
+{
+    DRESULT res = RES_OK;
+
+    if(disk_cache_attached(pdrv)) {
+        res = disk_cache_flush(pdrv);
+        if(RES_OK == res) {
+            disk_cache[pdrv].lines = NULL;
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      check whether a volume has a cache
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     1 if a cache is attached, 0 otherwise
+*/
+uint8_t disk_cache_attached(BYTE pdrv)
+{
+    return ((pdrv < _VOLUMES) && (NULL != disk_cache[pdrv].lines)) ? 1U : 0U;
+}
+
+/*!
+    \brief      read sectors through the cache
+    \param[in]  pdrv: physical drive number
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_cache_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    uint8_t sequential = (sector == cache->next_read) ? 1U : 0U;
+    DRESULT res = RES_OK;
+    UINT i = 0U, k, run, fetch;
+    uint32_t idx;
+    int32_t line;
+
+    cache->next_read = sector + count;
+
+    if(count >= DISK_CACHE_BYPASS_SECTORS) {
+        cache->stats.bypassed += count;
+        res = disk_cache_device_read(pdrv, buff, sector, count);
+        /* dirty lines are newer than the device */
+        for(i = 0U; (RES_OK == res) && (i < count); i++) {
+            line = disk_cache_lookup(cache, sector + i);
+            if((line >= 0) && cache->lines[line].dirty) {
+                memcpy(buff + i * DISK_CACHE_SECTOR_SIZE, disk_cache_line_data(cache, (uint32_t)line), DISK_CACHE_SECTOR_SIZE);
+            }
+        }
+        return res;
+    }
+
+    while((RES_OK == res) && (i < count)) {
+        line = disk_cache_lookup(cache, sector + i);
+        if(line >= 0) {
+            memcpy(buff + i * DISK_CACHE_SECTOR_SIZE, disk_cache_line_data(cache, (uint32_t)line), DISK_CACHE_SECTOR_SIZE);
+            if(cache->lines[line].prefetched) {
+                cache->lines[line].prefetched = 0U;
+                cache->stats.read_ahead_hits++;
+            }
+            cache->lines[line].stamp = ++cache->clock;
+            cache->stats.read_hits++;
+            i++;
+            continue;
+        }
+
+        /* the missing sectors up to the next cached one are one device read */
+        for(run = 1U; (i + run < count) && (run < DISK_CACHE_STAGING_SECTORS) &&
+                (disk_cache_lookup(cache, sector + i + run) < 0); run++) {
+        }
+        fetch = run;
+        if(sequential && (i + run == count) && (0U != cache->sectors)) {
+            fetch = run + DISK_CACHE_READ_AHEAD;
+            if(fetch > DISK_CACHE_STAGING_SECTORS) {
+                fetch = DISK_CACHE_STAGING_SECTORS;
+            }
+            if(sector + i + fetch > cache->sectors) {
+                fetch = cache->sectors - (sector + i);
+            }
+            if(fetch < run) {
+                fetch = run;
+            }
+        }
+
+        /* take the lines before the fetch, write-backs of evicted lines go through the staging buffer too */
+        for(k = 0U; (RES_OK == res) && (k < run); k++) {
+            res = disk_cache_allocate(pdrv, sector + i + k, &idx);
+        }
+        if(RES_OK == res) {
+            res = disk_cache_device_read(pdrv, cache->staging, sector + i, fetch);
+        }
+        if(RES_OK != res) {
+            /* the lines taken so far hold no data */
+            for(k = 0U; k < run; k++) {
+                line = disk_cache_lookup(cache, sector + i + k);
+                if(line >= 0) {
+                    cache->lines[line].valid = 0U;
+                }
+            }
+            break;
+        }
+
+        for(k = 0U; k < run; k++) {
+            line = disk_cache_lookup(cache, sector + i + k);
+            memcpy(disk_cache_line_data(cache, (uint32_t)line), cache->staging + k * DISK_CACHE_SECTOR_SIZE, DISK_CACHE_SECTOR_SIZE);
+            memcpy(buff + (i + k) * DISK_CACHE_SECTOR_SIZE, cache->staging + k * DISK_CACHE_SECTOR_SIZE, DISK_CACHE_SECTOR_SIZE);
+        }
+        /* sectors read ahead only replace clean lines, speculation must not cost a write */
+        for(k = run; k < fetch; k++) {
+            if(disk_cache_lookup(cache, sector + i + k) >= 0) {
+                continue;
+            }
+            idx = disk_cache_victim(cache, sector + i + k);
+            if(cache->lines[idx].valid && cache->lines[idx].dirty) {
+                continue;
+            }
+            cache->lines[idx].valid = 1U;
+            cache->lines[idx].dirty = 0U;
+            cache->lines[idx].prefetched = 1U;
+            cache->lines[idx].sector = sector + i + k;
+            cache->lines[idx].stamp = ++cache->clock;
+            memcpy(disk_cache_line_data(cache, idx), cache->staging + k * DISK_CACHE_SECTOR_SIZE, DISK_CACHE_SECTOR_SIZE);
+            cache->stats.read_ahead++;
+        }
+
+        cache->stats.read_misses += run;
+        i += run;
+    }
+
+    return res;
+}
+
+/*!
+    \brief      write sectors into the cache
+    \param[in]  pdrv: physical drive number
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_cache_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+#if _USE_WRITE == 1
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    DRESULT res = RES_OK;
+    uint32_t idx;
+    int32_t line;
+    UINT i;
+
+    if(count >= DISK_CACHE_BYPASS_SECTORS) {
+        cache->stats.bypassed += count;
+        res = disk_cache_device_write(pdrv, buff, sector, count);
+        /* the cached copies, dirty or not, are older than what the device holds now */
+        for(i = 0U; (RES_OK == res) && (i < count); i++) {
+            line = disk_cache_lookup(cache, sector + i);
+            if(line >= 0) {
+                cache->lines[line].valid = 0U;
+            }
+        }
+        return res;
+    }
+
+    for(i = 0U; i < count; i++) {
+        line = disk_cache_lookup(cache, sector + i);
+        if(line >= 0) {
+            idx = (uint32_t)line;
+            cache->stats.write_hits++;
+        } else {
+            /* whole sectors are written, the line is not read first */
+            res = disk_cache_allocate(pdrv, sector + i, &idx);
+            if(RES_OK != res) {
+                return res;
+            }
+            cache->stats.write_misses++;
+        }
+        memcpy(disk_cache_line_data(cache, idx), buff + i * DISK_CACHE_SECTOR_SIZE, DISK_CACHE_SECTOR_SIZE);
+        cache->lines[idx].dirty = 1U;
+        cache->lines[idx].prefetched = 0U;
+        cache->lines[idx].stamp = ++cache->clock;
+    }
+
+    return res;
+#else
+    return RES_ERROR;
+#endif /* _USE_WRITE == 1 */
+}
+
+/*!
+    \brief      write all dirty sectors to the device in coalesced runs
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_cache_flush(BYTE pdrv)
+{
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    uint32_t lines = cache->sets * DISK_CACHE_WAYS;
+    uint32_t idx, first;
+    uint8_t found;
+    DRESULT res;
+
+    cache->stats.flushes++;
+    while(1) {
+        /* the lowest dirty sector starts the next run, the write-back collects the ones above it */
+        found = 0U;
+        first = 0U;
+        for(idx = 0U; idx < lines; idx++) {
+            if(cache->lines[idx].valid && cache->lines[idx].dirty &&
+                    (!found || (cache->lines[idx].sector < cache->lines[first].sector))) {
+                first = idx;
+                found = 1U;
+            }
+        }
+        if(!found) {
+            return RES_OK;
+        }
+        res = disk_cache_writeback(pdrv, first);
+        if(RES_OK != res) {
+            return res;
+        }
+    }
+}
+
+/*!
+    \brief      drop the cached sectors of a range that is no longer used
+    \param[in]  pdrv: physical drive number
+    \param[in]  start: first sector of the range
+    \param[in]  end: last sector of the range
+    \param[out] none
+    \retval     none
+*/
+void disk_cache_trim(BYTE pdrv, DWORD start, DWORD end)
+{
+    disk_cache_struct *cache = &disk_cache[pdrv];
+    uint32_t lines = cache->sets * DISK_CACHE_WAYS;
+    uint32_t idx;
+
+    for(idx = 0U; idx < lines; idx++) {
+        if(cache->lines[idx].valid && (cache->lines[idx].sector >= start) && (cache->lines[idx].sector <= end)) {
+            cache->lines[idx].valid = 0U;
+        }
+    }
+}
+
+/*!
+    \brief      drop all cached sectors, dirty ones included, after the medium was (re)initialized
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     none
+*/
+void disk_cache_invalidate(BYTE pdrv)
+{
+    disk_cache_struct *cache = &disk_cache[pdrv];
+
+    memset(cache->lines, 0, cache->sets * DISK_CACHE_WAYS * sizeof(disk_cache_line_struct));
+    cache->clock = 0U;
+    cache->next_read = 0U;
+    disk_cache_geometry_get(pdrv);
+}
+
+/*!
+    \brief      read the statistics of the cache of a volume
+    \param[in]  pdrv: physical drive number
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void disk_cache_stats_get(BYTE pdrv, disk_cache_stats_struct *stats)
+{
+    *stats = disk_cache[pdrv].stats;
+}
@@ -0,0 +1,380 @@
+/*!
+    \file    disk_trim.c
+    \brief   queue of released sector ranges between diskio.c and the disk drivers
+
+    FatFs reports every contiguous run of clusters it frees with CTRL_TRIM, so deleting a
+    fragmented file or a few files in a row becomes a burst of small erase commands in the
+    middle of the file operation. The queue keeps these ranges per volume instead: a new range
+    absorbs the pending ones it overlaps or touches, so runs freed one after another become
+    one large erase. disk_trim_process() sends the ranges to the driver when the application
+    is idle, largest first.
+
+    A range is only sent after the next CTRL_SYNC, when the FAT that frees it is on the device,
+    and sectors written again before that are cut out of the pending ranges. A full queue
+    sends its largest synced range early, or gives up its smallest one if none is synced yet.
+    Trimming is a hint, failed or dropped ranges only cost the device the knowledge.
+*/
+
+#include "disk_trim.h"
+#include <string.h>
+
+/* a released range waiting for its trim */
+typedef struct {
+    DWORD start;                                        /*!< first sector */
+    DWORD end;                                          /*!< last sector */
+    uint8_t synced;                                     /*!< a CTRL_SYNC followed the release */
+} disk_trim_range_struct;
+
+/* trim queue of one volume */
+typedef struct {
+    disk_trim_range_struct ranges[DISK_TRIM_RANGES];
+    uint32_t count;                                     /*!< pending ranges */
+    uint8_t attached;                                   /*!< CTRL_TRIM is queued */
+    disk_trim_stats_struct stats;
+} disk_trim_struct;
+
+extern Disk_drvTypeDef disk;
+
+static disk_trim_struct disk_trim[_VOLUMES];
+
+/*!
+    \brief      send a range to the driver
+    \param[in]  pdrv: physical drive number
+    \param[in]  start: first sector
+    \param[in]  end: last sector
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT disk_trim_issue(BYTE pdrv, DWORD start, DWORD end)
+{
+    disk_trim_struct *trim = &disk_trim[pdrv];
+    DRESULT res = RES_OK;
+#if _USE_IOCTL == 1
+    DWORD range[2];
+
+    range[0] = start;
+    range[1] = end;
+    res = disk.drv[pdrv]->disk_ioctl(disk.lun[pdrv], CTRL_TRIM, range);
+#endif /* _USE_IOCTL == 1 */
+    if(RES_OK == res) {
+        trim->stats.issued++;
+        trim->stats.sectors_issued += end - start + 1U;
+    } else {
+        trim->stats.errors++;
+        trim->stats.sectors_dropped += end - start + 1U;
+    }
+    return res;
+}
+
+/*!
+    \brief      remove a pending range
+    \param[in]  trim: queue of the volume
+    \param[in]  idx: index of the range
+    \param[out] none
+    \retval     none
+*/
+static void disk_trim_remove(disk_trim_struct *trim, uint32_t idx)
+{
+    trim->ranges[idx] = trim->ranges[--trim->count];
+}
+
+/*!
+    \brief      find the largest pending range that may be sent
+    \param[in]  trim: queue of the volume
+    \param[in]  min: smallest number of sectors
+    \param[out] none
+    \retval     index of the range, -1 if there is none
+*/
+static int32_t disk_trim_largest(disk_trim_struct *trim, uint32_t min)
+{
+    int32_t idx = -1;
+    uint32_t i, size, size_max = 0U;
+
+    for(i = 0U; i < trim->count; i++) {
+        size = trim->ranges[i].end - trim->ranges[i].start + 1U;
+        if(trim->ranges[i].synced && (size >= min) && (size > size_max)) {
+            size_max = size;
+            idx = (int32_t)i;
+        }
+    }
+    return idx;
+}
+
+/*!
+    \brief      free an entry of a full queue, by sending the largest synced range or by
+                giving up the smallest range
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     none
+*/
+static void disk_trim_room(BYTE pdrv)
+{
+    disk_trim_struct *trim = &disk_trim[pdrv];
+    int32_t idx;
+    uint32_t i, smallest = 0U;
+
+    idx = disk_trim_largest(trim, 1U);
+    if(idx >= 0) {
+        trim->stats.forced++;
+        disk_trim_issue(pdrv, trim->ranges[idx].start, trim->ranges[idx].end);
+        disk_trim_remove(trim, (uint32_t)idx);
+        return;
+    }
+    for(i = 1U; i < trim->count; i++) {
+        if(trim->ranges[i].end - trim->ranges[i].start < trim->ranges[smallest].end - trim->ranges[smallest].start) {
+            smallest = i;
+        }
+    }
+    trim->stats.sectors_dropped += trim->ranges[smallest].end - trim->ranges[smallest].start + 1U;
+    disk_trim_remove(trim, smallest);
+}
+
+/*!
+    \brief      queue the CTRL_TRIM requests of a volume instead of passing them to the driver
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_trim_attach(BYTE pdrv)
+{
+    if(pdrv >= _VOLUMES) {
+        return RES_PARERR;
+    }
+    memset(&disk_trim[pdrv], 0, sizeof(disk_trim[pdrv]));
+    disk_trim[pdrv].attached = 1U;
+    return RES_OK;
+}
+
+/*!
+    \brief      issue all synced ranges and pass CTRL_TRIM through again, ranges released after
+                the last CTRL_SYNC are given up
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     DRESULT of the last failed trim
+*/
+DRESULT disk_trim_detach(BYTE pdrv)
+{
+    DRESULT res;
+    uint32_t i;
+
+    if((pdrv >= _VOLUMES) || !disk_trim[pdrv].attached) {
+        return RES_PARERR;
+    }
+    res = disk_trim_process(pdrv, 1U);
+    for(i = 0U; i < disk_trim[pdrv].count; i++) {
+        disk_trim[pdrv].stats.sectors_dropped += disk_trim[pdrv].ranges[i].end - disk_trim[pdrv].ranges[i].start + 1U;
+    }
+    disk_trim[pdrv].count = 0U;
+    disk_trim[pdrv].attached = 0U;
+    return res;
+}
+
+/*!
+    \brief      check whether a volume queues its trims
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     1 if it does, 0 otherwise
+*/
+uint8_t disk_trim_attached(BYTE pdrv)
+{
+    return (pdrv < _VOLUMES) ? disk_trim[pdrv].attached : 0U;
+}
+
+/*!
+    \brief      add a released range, it is merged with the pending ranges it touches
+    \param[in]  pdrv: physical drive number
+    \param[in]  start: first sector
+    \param[in]  end: last sector
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_trim_queue(BYTE pdrv, DWORD start, DWORD end)
+{
+    disk_trim_struct *trim;
+    disk_trim_range_struct *range;
+    uint32_t i = 0U;
+    uint8_t merged = 0U;
+
+    if((pdrv >= _VOLUMES) || (end < start)) {
+        return RES_PARERR;
+    }
+    trim = &disk_trim[pdrv];
+    trim->stats.requests++;
+    trim->stats.sectors += end - start + 1U;
+
+    /* the pending ranges are disjoint and not adjacent, the new one may bridge several */
+    while(i < trim->count) {
+        range = &trim->ranges[i];
+        if((range->start <= end + 1U) && (start <= range->end + 1U)) {
+            if(range->start < start) {
+                start = range->start;
+            }
+            if(range->end > end) {
+                end = range->end;
+            }
+            disk_trim_remove(trim, i);
+            merged = 1U;
+        } else {
+            i++;
+        }
+    }
+    if(merged) {
+        trim->stats.merged++;
+    }
+
+    if(trim->count >= DISK_TRIM_RANGES) {
+        disk_trim_room(pdrv);
+    }
+    range = &trim->ranges[trim->count++];
+    range->start = start;
+    range->end = end;
+    range->synced = 0U;
+    return RES_OK;
+}
+
+/*!
+    \brief      remove sectors that are written again from the pending ranges
+    \param[in]  pdrv: physical drive number
+    \param[in]  sector: first sector written
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+DRESULT disk_trim_written(BYTE pdrv, DWORD sector, UINT count)
+{
+    disk_trim_struct *trim;
+    disk_trim_range_struct *range, right;
+    DWORD last;
+    uint32_t i = 0U;
+
+    if((pdrv >= _VOLUMES) || (0U == count)) {
+        return RES_PARERR;
+    }
+    trim = &disk_trim[pdrv];
+    last = sector + count - 1U;
+
+    while(i < trim->count) {
+        range = &trim->ranges[i];
+        if((range->end < sector) || (range->start > last)) {
+            i++;
+        } else if((range->start >= sector) && (range->end <= last)) {
+            /* written completely */
+            trim->stats.sectors_cancelled += range->end - range->start + 1U;
+            disk_trim_remove(trim, i);
+        } else if((range->start < sector) && (range->end > last)) {
+            /* written in the middle, no other range can overlap the write */
+            trim->stats.sectors_cancelled += count;
+            right.start = last + 1U;
+            right.end = range->end;
+            right.synced = range->synced;
+            range->end = sector - 1U;
+            if(trim->count >= DISK_TRIM_RANGES) {
+                disk_trim_room(pdrv);
+            }
+            trim->ranges[trim->count++] = right;
+            break;
+        } else if(range->start < sector) {
+            trim->stats.sectors_cancelled += range->end - sector + 1U;
+            range->end = sector - 1U;
+            i++;
+        } else {
+            trim->stats.sectors_cancelled += last - range->start + 1U;
+            range->start = last + 1U;
+            i++;
+        }
+    }
+    return RES_OK;
+}
+
+/*!
+    \brief      the device holds everything written so far, pending ranges may be issued
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     none
+*/
+void disk_trim_synced(BYTE pdrv)
+{
+    uint32_t i;
+
+    if(pdrv >= _VOLUMES) {
+        return;
+    }
+    for(i = 0U; i < disk_trim[pdrv].count; i++) {
+        disk_trim[pdrv].ranges[i].synced = 1U;
+    }
+}
+
+/*!
+    \brief      issue pending ranges when the volume is idle, largest first
+    \param[in]  pdrv: physical drive number
+    \param[in]  all: 1 to issue every synced range, 0 for the ones of at least
+                DISK_TRIM_MIN_SECTORS sectors
+    \param[out] none
+    \retval     DRESULT of the last failed trim
+*/
+DRESULT disk_trim_process(BYTE pdrv, uint8_t all)
+{
+    disk_trim_struct *trim;
+    DRESULT res = RES_OK;
+    int32_t idx;
+
+    if(pdrv >= _VOLUMES) {
+        return RES_PARERR;
+    }
+    trim = &disk_trim[pdrv];
+
+    while(1) {
+        idx = disk_trim_largest(trim, all ? 1U : DISK_TRIM_MIN_SECTORS);
+        if(idx < 0) {
+            break;
+        }
+        if(RES_OK != disk_trim_issue(pdrv, trim->ranges[idx].start, trim->ranges[idx].end)) {
+            res = RES_ERROR;
+        }
+        disk_trim_remove(trim, (uint32_t)idx);
+    }
+    return res;
+}
+
+/*!
+    \brief      number of sectors waiting for their trim
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     sectors
+*/
+uint32_t disk_trim_pending(BYTE pdrv)
+{
+    uint32_t i, sectors = 0U;
+
+    if(pdrv >= _VOLUMES) {
+        return 0U;
+    }
+    for(i = 0U; i < disk_trim[pdrv].count; i++) {
+        sectors += disk_trim[pdrv].ranges[i].end - disk_trim[pdrv].ranges[i].start + 1U;
+    }
+    return sectors;
+}
+
+/*!
+    \brief      drop all pending ranges, the medium changed
+    \param[in]  pdrv: physical drive number
+    \param[out] none
+    \retval     none
+*/
+void disk_trim_invalidate(BYTE pdrv)
+{
+    if(pdrv < _VOLUMES) {
+        disk_trim[pdrv].count = 0U;
+    }
+}
+
+/*!
+    \brief      read the statistics of the trim queue of a volume
+    \param[in]  pdrv: physical drive number
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void disk_trim_stats_get(BYTE pdrv, disk_trim_stats_struct *stats)
+{
+    *stats = disk_trim[pdrv].stats;
+}
@@ -35,6 +35,8 @@ OF SUCH DAMAGE.
 /* Includes ------------------------------------------------------------------*/
 #include "diskio.h"
 #include "ff_gen_drv.h"
+#include "disk_cache.h"
+#include "disk_trim.h"
 
 #if defined ( __GNUC__ )
 #ifndef __weak
@@ -76,6 +78,13 @@ DSTATUS disk_initialize (
     if (disk.is_initialized[pdrv] == 0) {
         disk.is_initialized[pdrv] = 1;
         stat = disk.drv[pdrv]->disk_initialize(disk.lun[pdrv]);
+        /* whatever was cached belongs to the medium before the initialization */
+        if (disk_cache_attached(pdrv)) {
+            disk_cache_invalidate(pdrv);
+        }
+        if (disk_trim_attached(pdrv)) {
+            disk_trim_invalidate(pdrv);
+        }
     }
 
     return stat;
@@ -99,7 +108,11 @@ DRESULT disk_read (
 {
     DRESULT res;
 
-    res = disk.drv[pdrv]->disk_read(disk.lun[pdrv], buff, sector, count);
+    if (disk_cache_attached(pdrv)) {
+        res = disk_cache_read(pdrv, buff, sector, count);
+    } else {
+        res = disk.drv[pdrv]->disk_read(disk.lun[pdrv], buff, sector, count);
+    }
 
     return res;
 }
@@ -123,7 +136,16 @@ DRESULT disk_write (
 {
     DRESULT res;
 
-    res = disk.drv[pdrv]->disk_write(disk.lun[pdrv], buff, sector, count);
+    /* sectors in use again must not be erased by a pending trim */
+    if (disk_trim_attached(pdrv)) {
+        disk_trim_written(pdrv, sector, count);
+    }
+
+    if (disk_cache_attached(pdrv)) {
+        res = disk_cache_write(pdrv, buff, sector, count);
+    } else {
+        res = disk.drv[pdrv]->disk_write(disk.lun[pdrv], buff, sector, count);
+    }
 
     return res;
 }
@@ -146,8 +168,29 @@ DRESULT disk_ioctl (
 {
     DRESULT res;
 
+    if (disk_cache_attached(pdrv)) {
+        if (CTRL_SYNC == cmd) {
+            /* dirty sectors reach the device before the driver syncs */
+            res = disk_cache_flush(pdrv);
+            if (RES_OK != res) {
+                return res;
+            }
+        } else if (CTRL_TRIM == cmd) {
+            disk_cache_trim(pdrv, ((DWORD *)buff)[0], ((DWORD *)buff)[1]);
+        }
+    }
+
+    /* released ranges wait in the queue for disk_trim_process() */
+    if ((CTRL_TRIM == cmd) && disk_trim_attached(pdrv)) {
+        return disk_trim_queue(pdrv, ((DWORD *)buff)[0], ((DWORD *)buff)[1]);
+    }
+
     res = disk.drv[pdrv]->disk_ioctl(disk.lun[pdrv], cmd, buff);
 
+    if ((CTRL_SYNC == cmd) && (RES_OK == res) && disk_trim_attached(pdrv)) {
+        disk_trim_synced(pdrv);
+    }
+
     return res;
 }
 #endif /* _USE_IOCTL == 1 */
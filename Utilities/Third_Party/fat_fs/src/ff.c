@@ -21,6 +21,9 @@
 
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of device I/O functions */
+#if FF_USE_DIR_INDEX
+#include "ff_dirindex.h"	/* Name index of FAT directories */
+#endif
 
 
 /*--------------------------------------------------------------------------
@@ -553,6 +556,9 @@ static const BYTE Dc936[] = TBL_DC936;
 static const BYTE Dc949[] = TBL_DC949;
 static const BYTE Dc950[] = TBL_DC950;
 
+#elif FF_CODE_PAGE == 1	/* ASCII only configuration, no tables */
+#define CODEPAGE FF_CODE_PAGE
+
 #elif FF_CODE_PAGE < 900	/* Static code page configuration (SBCS) */
 #define CODEPAGE FF_CODE_PAGE
 static const BYTE ExCvt[] = MKCVTBL(TBL_CT, FF_CODE_PAGE);
@@ -2405,6 +2411,242 @@ static FRESULT dir_read (
 
 
 
+#if FF_USE_DIR_INDEX
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Name index of the FAT directory table            */
+/*-----------------------------------------------------------------------*/
+
+static void dir_index_seek (
+	DIR* dp,		/* Pointer to the directory object */
+	DWORD ofs,		/* Offset of the entry in the directory table */
+	DWORD clst		/* Cluster holding the entry (0:static root directory) */
+)
+{
+	FATFS *fs = dp->obj.fs;
+
+
+	dp->dptr = ofs;
+	dp->clust = clst;
+	if (clst == 0) {	/* Static table */
+		dp->sect = fs->dirbase + ofs / SS(fs);
+	} else {			/* Dynamic table */
+		dp->sect = clst2sect(fs, clst) + ofs % ((DWORD)fs->csize * SS(fs)) / SS(fs);
+	}
+	dp->dir = fs->win + ofs % SS(fs);
+}
+
+
+static FRESULT dir_index_match (	/* FR_OK:the entry block at dp has the name, FR_NO_FILE:it has not */
+	DIR* dp							/* Pointer to the directory object pointing the top of the block */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	BYTE c, a;
+#if FF_USE_LFN
+	BYTE ord = 0xFF, sum = 0xFF;
+
+	dp->blk_ofs = 0xFFFFFFFF;
+#endif
+	for (;;) {		/* Same comparison as dir_find() but limited to one entry block */
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) return res;
+		c = dp->dir[DIR_Name];
+		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == 0 || c == DDEM || ((a & AM_VOL) && a != AM_LFN)) return FR_NO_FILE;	/* Not an entry block */
+#if FF_USE_LFN
+		if (a == AM_LFN) {			/* An LFN entry */
+			if (!(dp->fn[NSFLAG] & NS_NOLFN)) {
+				if (c & LLEF) {
+					sum = dp->dir[LDIR_Chksum];
+					c &= (BYTE)~LLEF; ord = c;
+					dp->blk_ofs = dp->dptr;
+				}
+				ord = (c == ord && sum == dp->dir[LDIR_Chksum] && cmp_lfn(fs->lfnbuf, dp->dir)) ? ord - 1 : 0xFF;
+			}
+		} else {					/* The SFN entry ends the block */
+			if (ord == 0 && sum == sum_sfn(dp->dir)) return FR_OK;	/* LFN matched? */
+			if (!(dp->fn[NSFLAG] & NS_LOSS) && !mem_cmp(dp->dir, dp->fn, 11)) return FR_OK;	/* SFN matched? */
+			return FR_NO_FILE;
+		}
+#else
+		return mem_cmp(dp->dir, dp->fn, 11) ? FR_NO_FILE : FR_OK;
+#endif
+		res = dir_next(dp, 0);
+		if (res != FR_OK) return res;
+	}
+}
+
+
+static int dir_index_build (	/* Returns handle of the index, FF_DIRINDEX_NONE or FF_DIRINDEX_LINEAR */
+	DIR* dp						/* Pointer to the directory object */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	int di;
+	DWORD ofs = 0, clst = 0, n = 0;
+	BYTE c, a;
+#if FF_USE_LFN
+	BYTE ord = 0xFF, sum = 0xFF;
+	DWORD hash = 0;
+	WCHAR part[13];
+	UINT s;
+#endif
+
+
+	di = ff_dirindex_create(fs->id, dp->obj.sclust);
+	if (di < 0) return di;
+	res = dir_sdi(dp, 0);
+	while (res == FR_OK) {		/* Put the names of all entry blocks into the index */
+		res = move_window(fs, dp->sect);
+		if (res != FR_OK) break;
+		c = dp->dir[DIR_Name];
+		if (c == 0) break;		/* Reached to end of table */
+		n++;
+		a = dp->dir[DIR_Attr] & AM_MASK;
+		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
+#if FF_USE_LFN
+			ord = 0xFF;
+#endif
+		} else if (a == AM_LFN) {	/* An LFN entry */
+#if FF_USE_LFN
+			if (c & LLEF) {		/* Start of an LFN sequence */
+				sum = dp->dir[LDIR_Chksum];
+				c &= (BYTE)~LLEF; ord = c;
+				ofs = dp->dptr; clst = dp->clust; hash = 0;
+			}
+			if (c == ord && sum == dp->dir[LDIR_Chksum] && ld_word(dp->dir + LDIR_FstClusLO) == 0) {
+				for (s = 0; s < 13 && (part[s] = ld_word(dp->dir + LfnOfs[s])) != 0; s++) ;
+				hash ^= ff_dirindex_hash_part(part, s, c);
+				ord--;
+			} else {
+				ord = 0xFF;
+			}
+#endif
+		} else {					/* An SFN entry ends the block */
+#if FF_USE_LFN
+			if (ord == 0 && sum == sum_sfn(dp->dir)) {	/* With a valid LFN */
+				if (ff_dirindex_insert(di, hash, ofs, clst) != 0) return FF_DIRINDEX_LINEAR;
+			} else
+#endif
+			{
+				ofs = dp->dptr; clst = dp->clust;
+			}
+			if (ff_dirindex_insert(di, ff_dirindex_hash_sfn(dp->dir), ofs, clst) != 0) return FF_DIRINDEX_LINEAR;
+#if FF_USE_LFN
+			ord = 0xFF;
+#endif
+		}
+		res = dir_next(dp, 0);
+	}
+	if (res != FR_OK && res != FR_NO_FILE) {	/* Leave the error to the linear search */
+		ff_dirindex_drop(fs->id, dp->obj.sclust);
+		return FF_DIRINDEX_NONE;
+	}
+	return ff_dirindex_built(di, n);
+}
+
+
+static int dir_index_find (	/* 1:the index answered the lookup, 0:search the table */
+	DIR* dp,				/* Pointer to the directory object with the file name */
+	FRESULT* res			/* Result of the lookup as dir_find() returns it */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	DWORD hash[2], ofs, clst;
+	UINT nh = 0, i, pos, miss = 0;
+	int di;
+
+
+	if (dp->fn[NSFLAG] & NS_DOT) return 0;
+	di = ff_dirindex_find(fs->id, dp->obj.sclust);
+	if (di == FF_DIRINDEX_NONE) {	/* First lookup in the directory */
+		di = dir_index_build(dp);
+		if (di < 0) {				/* Rewind for the linear search */
+			*res = dir_sdi(dp, 0);
+			if (*res != FR_OK) return 1;
+		}
+	}
+	if (di < 0) {
+		ff_dirindex_account(di, 0, 0);
+		return 0;
+	}
+#if FF_USE_LFN
+	if (!(dp->fn[NSFLAG] & NS_NOLFN)) hash[nh++] = ff_dirindex_hash_lfn(fs->lfnbuf);
+	if (!(dp->fn[NSFLAG] & NS_LOSS)) hash[nh++] = ff_dirindex_hash_sfn(dp->fn);
+#else
+	hash[nh++] = ff_dirindex_hash_sfn(dp->fn);
+#endif
+	*res = FR_NO_FILE;
+	for (i = 0; i < nh && *res == FR_NO_FILE; i++) {	/* Compare the candidate blocks */
+		pos = 0;
+		while (*res == FR_NO_FILE && ff_dirindex_next(di, hash[i], &pos, &ofs, &clst)) {
+			dir_index_seek(dp, ofs, clst);
+			*res = dir_index_match(dp);
+			if (*res == FR_NO_FILE) miss++;
+		}
+	}
+	ff_dirindex_account(di, *res == FR_OK, miss);
+	return 1;
+}
+
+
+#if !FF_FS_READONLY
+static void dir_index_insert (
+	DIR* dp,		/* Pointer to the directory object pointing the new SFN entry */
+	DWORD ofs,		/* Offset of the first LFN entry (0xFFFFFFFF:no LFN entry) */
+	DWORD clst		/* Cluster holding the first LFN entry */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	int di;
+
+
+	if (fs->fs_type == FS_EXFAT) return;
+	di = ff_dirindex_find(fs->id, dp->obj.sclust);
+	if (di < 0) {			/* No index to update */
+		ff_dirindex_grown(fs->id, dp->obj.sclust, (ofs == 0xFFFFFFFF) ? 1 : (dp->dptr - ofs) / SZDIRE + 1);
+		return;
+	}
+#if FF_USE_LFN
+	if (ofs != 0xFFFFFFFF) {
+		if (ff_dirindex_insert(di, ff_dirindex_hash_lfn(fs->lfnbuf), ofs, clst) != 0) return;
+	} else
+#endif
+	{
+		ofs = dp->dptr; clst = dp->clust;
+	}
+	(void)ff_dirindex_insert(di, ff_dirindex_hash_sfn(dp->fn), ofs, clst);
+}
+
+
+#if FF_FS_MINIMIZE == 0
+static void dir_index_remove (
+	DIR* dp			/* Directory object pointing the entry to be removed */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	DWORD first = dp->dptr;
+	int di;
+
+
+	if (fs->fs_type == FS_EXFAT) return;
+	di = ff_dirindex_find(fs->id, dp->obj.sclust);
+	if (di < 0) return;
+#if FF_USE_LFN
+	if (dp->blk_ofs != 0xFFFFFFFF) first = dp->blk_ofs;
+#endif
+	ff_dirindex_remove(di, first, dp->dptr);
+}
+#endif	/* FF_FS_MINIMIZE == 0 */
+#endif	/* !FF_FS_READONLY */
+
+#endif	/* FF_USE_DIR_INDEX */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Find an object in the directory                  */
 /*-----------------------------------------------------------------------*/
@@ -2443,6 +2685,9 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	}
 #endif
 	/* On the FAT/FAT32 volume */
+#if FF_USE_DIR_INDEX
+	if (dir_index_find(dp, &res)) return res;	/* Answered by the name index? */
+#endif
 #if FF_USE_LFN
 	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
 #endif
@@ -2496,6 +2741,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 {
 	FRESULT res;
 	FATFS *fs = dp->obj.fs;
+#if FF_USE_DIR_INDEX
+	DWORD iofs = 0xFFFFFFFF, iclst = 0;	/* Top of the LFN entries for the name index */
+#endif
 #if FF_USE_LFN		/* LFN configuration */
 	UINT n, nlen, nent;
 	BYTE sn[12], sum;
@@ -2555,6 +2803,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 	if (res == FR_OK && --nent) {	/* Set LFN entry if needed */
 		res = dir_sdi(dp, dp->dptr - nent * SZDIRE);
 		if (res == FR_OK) {
+#if FF_USE_DIR_INDEX
+			iofs = dp->dptr; iclst = dp->clust;
+#endif
 			sum = sum_sfn(dp->fn);	/* Checksum value of the SFN tied to the LFN */
 			do {					/* Store LFN entries in bottom first */
 				res = move_window(fs, dp->sect);
@@ -2583,6 +2834,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 			fs->wflag = 1;
 		}
 	}
+#if FF_USE_DIR_INDEX
+	if (res == FR_OK) dir_index_insert(dp, iofs, iclst);	/* Add the names to the index of the directory */
+#endif
 
 	return res;
 }
@@ -2605,6 +2859,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 #if FF_USE_LFN		/* LFN configuration */
 	DWORD last = dp->dptr;
 
+#if FF_USE_DIR_INDEX
+	dir_index_remove(dp);	/* Remove the names from the index of the directory */
+#endif
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -2623,6 +2880,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	}
 #else			/* Non LFN configuration */
 
+#if FF_USE_DIR_INDEX
+	dir_index_remove(dp);	/* Remove the name from the index of the directory */
+#endif
 	res = move_window(fs, dp->sect);
 	if (res == FR_OK) {
 		dp->dir[DIR_Name] = DDEM;	/* Mark the entry 'deleted'.*/
@@ -2763,7 +3023,7 @@ static DWORD get_achar (	/* Get a character and advances ptr */
 	if (IsLower(chr)) chr -= 0x20;		/* To upper ASCII char */
 #if FF_CODE_PAGE == 0
 	if (ExCvt && chr >= 0x80) chr = ExCvt[chr - 0x80];	/* To upper SBCS extended char */
-#elif FF_CODE_PAGE < 900
+#elif FF_CODE_PAGE > 1 && FF_CODE_PAGE < 900
 	if (chr >= 0x80) chr = ExCvt[chr - 0x80];	/* To upper SBCS extended char */
 #endif
 #if FF_CODE_PAGE == 0 || FF_CODE_PAGE >= 900
@@ -2907,6 +3167,8 @@ static FRESULT create_name (	/* FR_OK: successful, FR_INVALID_NAME: could not cr
 			} else {		/* At DBCS */
 				wc = ff_uni2oem(ff_wtoupper(wc), CODEPAGE);	/* Unicode ==> Upper convert ==> ANSI/OEM code */
 			}
+#elif FF_CODE_PAGE == 1	/* ASCII cfg */
+			wc = 0;									/* No ASCII code, replaced in the SFN */
 #elif FF_CODE_PAGE < 900	/* SBCS cfg */
 			wc = ff_uni2oem(wc, CODEPAGE);			/* Unicode ==> ANSI/OEM code */
 			if (wc & 0x80) wc = ExCvt[wc & 0x7F];	/* Convert extended character to upper (SBCS) */
@@ -2988,7 +3250,7 @@ static FRESULT create_name (	/* FR_OK: successful, FR_INVALID_NAME: could not cr
 		if (ExCvt && c >= 0x80) {		/* Is SBC extended character? */
 			c = ExCvt[c & 0x7F];		/* To upper SBC extended character */
 		}
-#elif FF_CODE_PAGE < 900
+#elif FF_CODE_PAGE > 1 && FF_CODE_PAGE < 900
 		if (c >= 0x80) {				/* Is SBC extended character? */
 			c = ExCvt[c & 0x7F];		/* To upper SBC extended character */
 		}
@@ -3251,6 +3513,9 @@ static FRESULT find_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 	/* The filesystem object is not valid. */
 	/* Following code attempts to mount the volume. (analyze BPB and initialize the filesystem object) */
 
+#if FF_USE_DIR_INDEX
+	if (fs->fs_type) ff_dirindex_drop_volume(fs->id);	/* Forget the name indexes of the old mount */
+#endif
 	fs->fs_type = 0;					/* Clear the filesystem object */
 	fs->pdrv = LD2PD(vol);				/* Bind the logical drive and a physical drive */
 	stat = disk_initialize(fs->pdrv);	/* Initialize the physical drive */
@@ -3517,6 +3782,9 @@ FRESULT f_mount (
 #endif
 #if FF_FS_REENTRANT						/* Discard sync object of the current volume */
 		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
+#endif
+#if FF_USE_DIR_INDEX
+		if (cfs->fs_type) ff_dirindex_drop_volume(cfs->id);	/* Forget the name indexes of the volume */
 #endif
 		cfs->fs_type = 0;				/* Clear old fs object */
 	}
@@ -4846,6 +5114,9 @@ FRESULT f_unlink (
 					res = remove_chain(&dj.obj, dclst, 0);
 #endif
 				}
+#if FF_USE_DIR_INDEX
+				if (res == FR_OK && (dj.obj.attr & AM_DIR)) ff_dirindex_drop(fs->id, dclst);	/* Forget the name index of the removed directory */
+#endif
 				if (res == FR_OK) res = sync_fs(fs);
 			}
 		}
@@ -5297,7 +5568,7 @@ FRESULT f_setlabel (
 			if (IsLower(wc)) wc -= 0x20;		/* To upper ASCII characters */
 #if FF_CODE_PAGE == 0
 			if (ExCvt && wc >= 0x80) wc = ExCvt[wc - 0x80];	/* To upper extended characters (SBCS cfg) */
-#elif FF_CODE_PAGE < 900
+#elif FF_CODE_PAGE > 1 && FF_CODE_PAGE < 900
 			if (wc >= 0x80) wc = ExCvt[wc - 0x80];	/* To upper extended characters (SBCS cfg) */
 #endif
 #endif
@@ -5554,6 +5825,9 @@ FRESULT f_mkfs (
 	/* Check mounted drive and clear work area */
 	vol = get_ldnumber(&path);					/* Get target logical drive */
 	if (vol < 0) return FR_INVALID_DRIVE;
+#if FF_USE_DIR_INDEX
+	if (FatFs[vol] && FatFs[vol]->fs_type) ff_dirindex_drop_volume(FatFs[vol]->id);	/* Forget the name indexes of the volume */
+#endif
 	if (FatFs[vol]) FatFs[vol]->fs_type = 0;	/* Clear the volume if mounted */
 	pdrv = LD2PD(vol);	/* Physical drive */
 	part = LD2PT(vol);	/* Partition (0:create as new, 1-4:get from partition table) */
@@ -0,0 +1,578 @@
+/*!
+    \file    ff_dirindex.c
+    \brief   name index of large FAT directories and batched directory reads
+
+    FatFs finds a name by reading the directory table from its first entry until the name or
+    the end of the table turns up, so opening or creating a file in a directory of n entries
+    costs n / 16 sector reads and a logger that keeps thousands of files in one directory gets
+    slower with every file. On FAT volumes dir_find() first asks this index: a hash table in
+    memory of the caller that maps the hashes of the long and short names of every entry block
+    to its offset and cluster in the directory table. A lookup then reads the one or two
+    sectors holding the candidate blocks, and a name that is not in the table is reported
+    missing without any read, which also shortens the numbered short name search of
+    dir_register().
+
+    A directory is scanned into the index on the first lookup in it. Directories smaller than
+    FF_DIRINDEX_MIN_ENTRIES and directories that do not fit the memory are only marked and
+    searched linearly as before, a small one is scanned again once enough entries have been
+    created in it. Created and deleted entries update the index in place, an index is dropped
+    when its directory is removed and all indexes of a volume on unmount, remount or f_mkfs().
+    When a new directory needs room, the least recently used index goes. exFAT keeps a name
+    hash in every entry set already and is not indexed.
+
+    The table uses linear probing with backward shift deletion, the long name hash combines
+    the hashes of the 13 character parts of the LFN entries so a scan never has to assemble a
+    name, and the lookup compares the candidates exactly the way dir_find() does.
+*/
+
+#include "ff_dirindex.h"
+#include <string.h>
+
+#if FF_USE_DIR_INDEX
+
+/* smallest table worth using */
+#define FF_DIRINDEX_MIN_SLOTS           16U
+
+/* states of a tracked directory */
+#define FF_DIRINDEX_DIR_FREE            0U
+#define FF_DIRINDEX_DIR_INDEXED         1U
+#define FF_DIRINDEX_DIR_SMALL           2U
+#define FF_DIRINDEX_DIR_LINEAR          3U
+
+typedef struct {
+    DWORD sclust;                                       /* start cluster of the table, 0 for the root */
+    DWORD stamp;                                        /* use clock of the last lookup */
+    DWORD entries;                                      /* entries of a small directory */
+    WORD fsid;                                          /* mount ID of the volume */
+    uint8_t state;
+} ff_dirindex_dir_struct;
+
+typedef struct {
+    DWORD hash;                                         /* name hash */
+    DWORD clust;                                        /* cluster of the first entry of the block */
+    WORD entry;                                         /* index of the first entry in the table */
+    WORD dir;                                           /* tracked directory + 1, 0 for an empty slot */
+} ff_dirindex_slot_struct;
+
+static ff_dirindex_slot_struct *ff_dirindex_slots;
+static UINT ff_dirindex_mask;
+static UINT ff_dirindex_used;
+static UINT ff_dirindex_limit;
+static DWORD ff_dirindex_clock;
+static ff_dirindex_dir_struct ff_dirindex_dirs[FF_DIRINDEX_DIRS];
+static ff_dirindex_stats_struct ff_dirindex_stats;
+
+/*!
+    \brief      home slot of a name of a directory
+    \param[in]  dir: tracked directory + 1
+    \param[in]  hash: name hash
+    \param[out] none
+    \retval     slot index
+*/
+static UINT ff_dirindex_home(WORD dir, DWORD hash)
+{
+    return (UINT)(hash ^ ((DWORD)dir * 0x9E3779B9U)) & ff_dirindex_mask;
+}
+
+/*!
+    \brief      empty a slot and shift the following run of its cluster back into the hole
+    \param[in]  i: slot index
+    \param[out] none
+    \retval     none
+*/
+static void ff_dirindex_slot_delete(UINT i)
+{
+    UINT j = i;
+    UINT home;
+
+    while(1) {
+        ff_dirindex_slots[i].dir = 0U;
+        do {
+            j = (j + 1U) & ff_dirindex_mask;
+            if(0U == ff_dirindex_slots[j].dir) {
+                ff_dirindex_used--;
+                return;
+            }
+            home = ff_dirindex_home(ff_dirindex_slots[j].dir, ff_dirindex_slots[j].hash);
+            /* a slot whose home lies cyclically in (i, j] has to stay */
+        } while((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j)));
+        ff_dirindex_slots[i] = ff_dirindex_slots[j];
+        i = j;
+    }
+}
+
+/*!
+    \brief      remove the names of a tracked directory whose entries lie in a range
+    \param[in]  dir: tracked directory
+    \param[in]  first: first entry index
+    \param[in]  last: last entry index
+    \param[out] none
+    \retval     number of names removed
+*/
+static UINT ff_dirindex_slots_remove(int dir, DWORD first, DWORD last)
+{
+    WORD tag = (WORD)(dir + 1);
+    UINT removed = 0U;
+    UINT i = 0U;
+
+    /* a deletion only moves slots into the hole at i or behind it, so i is checked again */
+    while(i <= ff_dirindex_mask) {
+        if((tag == ff_dirindex_slots[i].dir) && (ff_dirindex_slots[i].entry >= first) && (ff_dirindex_slots[i].entry <= last)) {
+            ff_dirindex_slot_delete(i);
+            removed++;
+        } else {
+            i++;
+        }
+    }
+    return removed;
+}
+
+/*!
+    \brief      stop tracking a directory
+    \param[in]  dir: tracked directory
+    \param[out] none
+    \retval     none
+*/
+static void ff_dirindex_release(int dir)
+{
+    if(FF_DIRINDEX_DIR_INDEXED == ff_dirindex_dirs[dir].state) {
+        (void)ff_dirindex_slots_remove(dir, 0U, 0xFFFFU);
+    }
+    ff_dirindex_dirs[dir].state = FF_DIRINDEX_DIR_FREE;
+}
+
+/*!
+    \brief      give the index its memory and clear it
+    \param[in]  memory: memory for the hash table, word aligned
+    \param[in]  size: size of the memory in bytes, 12 bytes per name and 2 names per long
+                name entry block, a quarter of the table is kept free
+    \param[out] none
+    \retval     FRESULT, FR_INVALID_PARAMETER if the memory is too small
+*/
+FRESULT ff_dirindex_attach(void *memory, uint32_t size)
+{
+    UINT slots = FF_DIRINDEX_MIN_SLOTS;
+    UINT i;
+
+    if((NULL == memory) || ((size / sizeof(ff_dirindex_slot_struct)) < FF_DIRINDEX_MIN_SLOTS)) {
+        return FR_INVALID_PARAMETER;
+    }
+    while((slots * 2U) <= (size / sizeof(ff_dirindex_slot_struct))) {
+        slots *= 2U;
+    }
+
+    ff_dirindex_slots = (ff_dirindex_slot_struct *)memory;
+    memset(ff_dirindex_slots, 0, slots * sizeof(ff_dirindex_slot_struct));
+    ff_dirindex_mask = slots - 1U;
+    ff_dirindex_used = 0U;
+    ff_dirindex_limit = slots - slots / 4U;
+    for(i = 0U; i < FF_DIRINDEX_DIRS; i++) {
+        ff_dirindex_dirs[i].state = FF_DIRINDEX_DIR_FREE;
+    }
+    return FR_OK;
+}
+
+/*!
+    \brief      stop using the index, lookups search the directory tables again
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_detach(void)
+{
+    UINT i;
+
+    ff_dirindex_slots = NULL;
+    for(i = 0U; i < FF_DIRINDEX_DIRS; i++) {
+        ff_dirindex_dirs[i].state = FF_DIRINDEX_DIR_FREE;
+    }
+}
+
+/*!
+    \brief      look up the index of a directory
+    \param[in]  fsid: mount ID of the volume
+    \param[in]  sclust: start cluster of the directory table, 0 for the root
+    \param[out] none
+    \retval     handle of the index, FF_DIRINDEX_NONE or FF_DIRINDEX_LINEAR
+*/
+int ff_dirindex_find(WORD fsid, DWORD sclust)
+{
+    int i;
+
+    if(NULL == ff_dirindex_slots) {
+        return FF_DIRINDEX_LINEAR;
+    }
+    for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+        if((FF_DIRINDEX_DIR_FREE != ff_dirindex_dirs[i].state) && (fsid == ff_dirindex_dirs[i].fsid) && (sclust == ff_dirindex_dirs[i].sclust)) {
+            ff_dirindex_dirs[i].stamp = ++ff_dirindex_clock;
+            return (FF_DIRINDEX_DIR_INDEXED == ff_dirindex_dirs[i].state) ? i : FF_DIRINDEX_LINEAR;
+        }
+    }
+    return FF_DIRINDEX_NONE;
+}
+
+/*!
+    \brief      start an empty index for a directory that is about to be scanned
+    \param[in]  fsid: mount ID of the volume
+    \param[in]  sclust: start cluster of the directory table, 0 for the root
+    \param[out] none
+    \retval     handle of the index, FF_DIRINDEX_LINEAR without memory
+*/
+int ff_dirindex_create(WORD fsid, DWORD sclust)
+{
+    int victim = 0;
+    int i;
+
+    if(NULL == ff_dirindex_slots) {
+        return FF_DIRINDEX_LINEAR;
+    }
+    /* a free slot, else the least recently used one, small directories first since they are
+       rescanned in a few sector reads */
+    for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+        if(FF_DIRINDEX_DIR_FREE == ff_dirindex_dirs[i].state) {
+            victim = i;
+            break;
+        }
+        if(((FF_DIRINDEX_DIR_SMALL == ff_dirindex_dirs[i].state) && (FF_DIRINDEX_DIR_SMALL != ff_dirindex_dirs[victim].state)) ||
+           (((FF_DIRINDEX_DIR_SMALL == ff_dirindex_dirs[i].state) == (FF_DIRINDEX_DIR_SMALL == ff_dirindex_dirs[victim].state)) &&
+            ((ff_dirindex_dirs[i].stamp - ff_dirindex_dirs[victim].stamp) > 0x7FFFFFFFU))) {
+            victim = i;
+        }
+    }
+    if(FF_DIRINDEX_DIR_INDEXED == ff_dirindex_dirs[victim].state) {
+        ff_dirindex_stats.evictions++;
+    }
+    ff_dirindex_release(victim);
+
+    ff_dirindex_dirs[victim].fsid = fsid;
+    ff_dirindex_dirs[victim].sclust = sclust;
+    ff_dirindex_dirs[victim].stamp = ++ff_dirindex_clock;
+    ff_dirindex_dirs[victim].state = FF_DIRINDEX_DIR_INDEXED;
+    return victim;
+}
+
+/*!
+    \brief      finish the scan of a directory
+    \param[in]  dir: handle from ff_dirindex_create()
+    \param[in]  entries: entries of the directory table up to its end mark
+    \param[out] none
+    \retval     the handle, or FF_DIRINDEX_LINEAR if the directory is too small for an index
+*/
+int ff_dirindex_built(int dir, DWORD entries)
+{
+    if(FF_DIRINDEX_DIR_INDEXED != ff_dirindex_dirs[dir].state) {
+        return FF_DIRINDEX_LINEAR;
+    }
+    if(entries < FF_DIRINDEX_MIN_ENTRIES) {
+        (void)ff_dirindex_slots_remove(dir, 0U, 0xFFFFU);
+        ff_dirindex_dirs[dir].state = FF_DIRINDEX_DIR_SMALL;
+        ff_dirindex_dirs[dir].entries = entries;
+        ff_dirindex_stats.small++;
+        return FF_DIRINDEX_LINEAR;
+    }
+    ff_dirindex_stats.builds++;
+    return dir;
+}
+
+/*!
+    \brief      count entries created in a directory without an index
+    \param[in]  fsid: mount ID of the volume
+    \param[in]  sclust: start cluster of the directory table
+    \param[in]  entries: entries created
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_grown(WORD fsid, DWORD sclust, UINT entries)
+{
+    int i;
+
+    if(NULL == ff_dirindex_slots) {
+        return;
+    }
+    for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+        if((FF_DIRINDEX_DIR_SMALL == ff_dirindex_dirs[i].state) && (fsid == ff_dirindex_dirs[i].fsid) && (sclust == ff_dirindex_dirs[i].sclust)) {
+            /* a directory that grew large enough is scanned again on the next lookup */
+            ff_dirindex_dirs[i].entries += entries;
+            if(ff_dirindex_dirs[i].entries >= FF_DIRINDEX_MIN_ENTRIES) {
+                ff_dirindex_dirs[i].state = FF_DIRINDEX_DIR_FREE;
+            }
+        }
+    }
+}
+
+/*!
+    \brief      add a name of an entry block of an indexed directory
+    \param[in]  dir: handle of the index
+    \param[in]  hash: hash of the long or the short name of the block
+    \param[in]  ofs: directory offset of the first entry of the block
+    \param[in]  clust: cluster holding that entry, 0 in the static root directory
+    \param[out] none
+    \retval     0, or -1 if the table is full and the directory was switched to linear search
+*/
+int ff_dirindex_insert(int dir, DWORD hash, DWORD ofs, DWORD clust)
+{
+    WORD tag = (WORD)(dir + 1);
+    int victim;
+    int i;
+    UINT slot;
+
+    /* make room by dropping the least recently used other indexes */
+    while(ff_dirindex_used >= ff_dirindex_limit) {
+        victim = -1;
+        for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+            if((i != dir) && (FF_DIRINDEX_DIR_INDEXED == ff_dirindex_dirs[i].state) &&
+               ((victim < 0) || ((ff_dirindex_dirs[i].stamp - ff_dirindex_dirs[victim].stamp) > 0x7FFFFFFFU))) {
+                victim = i;
+            }
+        }
+        if(victim < 0) {
+            (void)ff_dirindex_slots_remove(dir, 0U, 0xFFFFU);
+            ff_dirindex_dirs[dir].state = FF_DIRINDEX_DIR_LINEAR;
+            ff_dirindex_stats.overflows++;
+            return -1;
+        }
+        ff_dirindex_release(victim);
+        ff_dirindex_stats.evictions++;
+    }
+
+    slot = ff_dirindex_home(tag, hash);
+    while(0U != ff_dirindex_slots[slot].dir) {
+        slot = (slot + 1U) & ff_dirindex_mask;
+    }
+    ff_dirindex_slots[slot].dir = tag;
+    ff_dirindex_slots[slot].hash = hash;
+    ff_dirindex_slots[slot].entry = (WORD)(ofs / 32U);
+    ff_dirindex_slots[slot].clust = clust;
+    ff_dirindex_used++;
+    ff_dirindex_stats.inserts++;
+    return 0;
+}
+
+/*!
+    \brief      remove the names of the entry blocks in a range of directory offsets
+    \param[in]  dir: handle of the index
+    \param[in]  first: directory offset of the first removed entry
+    \param[in]  last: directory offset of the last removed entry
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_remove(int dir, DWORD first, DWORD last)
+{
+    ff_dirindex_stats.removals += ff_dirindex_slots_remove(dir, first / 32U, last / 32U);
+}
+
+/*!
+    \brief      iterate over the entry blocks that may hold a name
+    \param[in]  dir: handle of the index
+    \param[in]  hash: hash of the name
+    \param[in]  pos: iterator, 0 for the first call
+    \param[out] pos: advanced iterator
+    \param[out] ofs: directory offset of the first entry of a candidate block
+    \param[out] clust: cluster holding that entry
+    \retval     1 if a candidate was found, 0 at the end
+*/
+int ff_dirindex_next(int dir, DWORD hash, UINT *pos, DWORD *ofs, DWORD *clust)
+{
+    WORD tag = (WORD)(dir + 1);
+    UINT home = ff_dirindex_home(tag, hash);
+    ff_dirindex_slot_struct *slot;
+
+    while(*pos <= ff_dirindex_mask) {
+        slot = &ff_dirindex_slots[(home + *pos) & ff_dirindex_mask];
+        if(0U == slot->dir) {
+            break;
+        }
+        (*pos)++;
+        if((tag == slot->dir) && (hash == slot->hash)) {
+            *ofs = (DWORD)slot->entry * 32U;
+            *clust = slot->clust;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+    \brief      count a lookup in the statistics
+    \param[in]  dir: handle of the index, negative for a linear search
+    \param[in]  found: nonzero if the name was found
+    \param[in]  collisions: candidates that held another name
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_account(int dir, int found, UINT collisions)
+{
+    if(dir < 0) {
+        ff_dirindex_stats.linear++;
+    } else {
+        ff_dirindex_stats.lookups++;
+        if(!found) {
+            ff_dirindex_stats.absent++;
+        }
+        ff_dirindex_stats.collisions += collisions;
+    }
+}
+
+/*!
+    \brief      forget the index of a directory
+    \param[in]  fsid: mount ID of the volume
+    \param[in]  sclust: start cluster of the directory table
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_drop(WORD fsid, DWORD sclust)
+{
+    int i;
+
+    if(NULL == ff_dirindex_slots) {
+        return;
+    }
+    for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+        if((FF_DIRINDEX_DIR_FREE != ff_dirindex_dirs[i].state) && (fsid == ff_dirindex_dirs[i].fsid) && (sclust == ff_dirindex_dirs[i].sclust)) {
+            ff_dirindex_release(i);
+            ff_dirindex_stats.invalidations++;
+        }
+    }
+}
+
+/*!
+    \brief      forget all indexes of a volume
+    \param[in]  fsid: mount ID of the volume
+    \param[out] none
+    \retval     none
+*/
+void ff_dirindex_drop_volume(WORD fsid)
+{
+    int i;
+
+    if(NULL == ff_dirindex_slots) {
+        return;
+    }
+    for(i = 0; i < (int)FF_DIRINDEX_DIRS; i++) {
+        if((FF_DIRINDEX_DIR_FREE != ff_dirindex_dirs[i].state) && (fsid == ff_dirindex_dirs[i].fsid)) {
+            ff_dirindex_release(i);
+            ff_dirindex_stats.invalidations++;
+        }
+    }
+}
+
+/*!
+    \brief      spread the bits of an FNV-1a hash over the whole word
+    \param[in]  h: hash
+    \param[out] none
+    \retval     mixed hash
+*/
+static DWORD ff_dirindex_mix(DWORD h)
+{
+    h ^= h >> 16;
+    h *= 0x85EBCA6BU;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35U;
+    h ^= h >> 16;
+    return h;
+}
+
+/*!
+    \brief      hash of a short name in directory entry format
+    \param[in]  sfn: 11 byte name as stored in the entry, upper case and space padded
+    \param[out] none
+    \retval     hash
+*/
+DWORD ff_dirindex_hash_sfn(const BYTE *sfn)
+{
+    DWORD h = 2166136261U;
+    UINT i;
+
+    for(i = 0U; i < 11U; i++) {
+        h = (h ^ sfn[i]) * 16777619U;
+    }
+    return ff_dirindex_mix(h);
+}
+
+#if FF_USE_LFN
+/*!
+    \brief      hash of the part of a long name stored in one LFN entry
+    \param[in]  part: characters of the part
+    \param[in]  len: number of characters, up to 13
+    \param[in]  ord: position of the part in the name, 1 for the first 13 characters
+    \param[out] none
+    \retval     hash, names compare without regard to case
+*/
+DWORD ff_dirindex_hash_part(const WCHAR *part, UINT len, UINT ord)
+{
+    DWORD h = (2166136261U ^ ord) * 16777619U;
+    DWORD wc;
+    UINT i;
+
+    for(i = 0U; i < len; i++) {
+        wc = ff_wtoupper(part[i]);
+        h = (h ^ (wc & 0xFFU)) * 16777619U;
+        h = (h ^ ((wc >> 8) & 0xFFU)) * 16777619U;
+    }
+    return ff_dirindex_mix(h);
+}
+
+/*!
+    \brief      hash of a long name, the combination of the hashes of its parts
+    \param[in]  lfn: zero terminated name
+    \param[out] none
+    \retval     hash
+*/
+DWORD ff_dirindex_hash_lfn(const WCHAR *lfn)
+{
+    DWORD h = 0U;
+    UINT ord = 1U;
+    UINT len;
+
+    /* LFN entries come in reverse order, so the parts are combined independent of order */
+    while(0U != *lfn) {
+        for(len = 0U; (len < 13U) && (0U != lfn[len]); len++) {
+        }
+        h ^= ff_dirindex_hash_part(lfn, len, ord);
+        lfn += len;
+        ord++;
+    }
+    return h;
+}
+#endif /* FF_USE_LFN */
+
+/*!
+    \brief      read the statistics of the directory index
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void ff_dirindex_stats_get(ff_dirindex_stats_struct *stats)
+{
+    *stats = ff_dirindex_stats;
+}
+
+#endif /* FF_USE_DIR_INDEX */
+
+#if FF_FS_MINIMIZE <= 1
+/*!
+    \brief      read up to count directory items in one call
+    \param[in]  dp: open directory
+    \param[in]  fno: array of count items
+    \param[in]  count: items to read
+    \param[out] fno: the items read
+    \param[out] read: number of items read, less than count at the end of the directory
+    \retval     FRESULT
+*/
+FRESULT ff_dirindex_read_batch(DIR *dp, FILINFO *fno, UINT count, UINT *read)
+{
+    FRESULT res = FR_OK;
+
+    /* nothing else moves the sector window meanwhile, so each directory sector is read once
+       per batch instead of once per item when the caller opens or stats the items in between */
+    *read = 0U;
+    while(*read < count) {
+        res = f_readdir(dp, &fno[*read]);
+        if((FR_OK != res) || (0 == fno[*read].fname[0])) {
+            break;
+        }
+        (*read)++;
+    }
+    return res;
+}
+#endif /* FF_FS_MINIMIZE <= 1 */
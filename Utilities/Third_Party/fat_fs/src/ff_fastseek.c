@@ -0,0 +1,260 @@
+/*!
+    \file    ff_fastseek.c
+    \brief   files that keep a cluster link map for fast random access
+
+    Without a map, f_lseek() and every cluster change of f_read() behind a backward seek follow
+    the FAT chain from the start of the file, one get_fat() per cluster. With FF_USE_FASTSEEK
+    FatFs can instead look clusters up in a cluster link map table (CLMT), a list of the
+    fragments of the chain, but the application has to build it and FatFs refuses to grow a
+    file while it is set.
+
+    ff_fastseek_open() builds the map into a table of the caller or of a small pool. If the
+    chain has more fragments than the table holds, the file falls back to the chain walk. A
+    write that needs new clusters drops the map and the next read or seek builds it again, so
+    appends and random reads can be mixed on the same file.
+*/
+
+#include "ff_fastseek.h"
+#include <string.h>
+
+#if FF_USE_FASTSEEK
+
+/* size word, one fragment and the terminator */
+#define FF_FASTSEEK_MIN_WORDS           4U
+
+#if FF_FASTSEEK_POOL_TABLES > 0U
+static DWORD ff_fastseek_pool[FF_FASTSEEK_POOL_TABLES][FF_FASTSEEK_POOL_WORDS];
+static uint8_t ff_fastseek_pool_used[FF_FASTSEEK_POOL_TABLES];
+#endif /* FF_FASTSEEK_POOL_TABLES > 0U */
+
+static ff_fastseek_stats_struct ff_fastseek_stats;
+
+/*!
+    \brief      build the link map if the file has none
+    \param[in]  fsf: open file
+    \param[out] none
+    \retval     FRESULT
+*/
+static FRESULT ff_fastseek_map(ff_fastseek_file_struct *fsf)
+{
+    FRESULT res;
+
+    /* an empty file has no chain, the map is built once it has one */
+    if((FF_FASTSEEK_MAP_NONE != fsf->map) || (0U == fsf->file.obj.sclust)) {
+        return FR_OK;
+    }
+    if((NULL == fsf->table) || (fsf->table_words < FF_FASTSEEK_MIN_WORDS)) {
+        fsf->map = FF_FASTSEEK_MAP_FALLBACK;
+        return FR_OK;
+    }
+
+    fsf->table[0] = fsf->table_words;
+    fsf->file.cltbl = fsf->table;
+    res = f_lseek(&fsf->file, CREATE_LINKMAP);
+    if(FR_OK == res) {
+        fsf->map = FF_FASTSEEK_MAP_VALID;
+        ff_fastseek_stats.maps++;
+    } else {
+        fsf->file.cltbl = NULL;
+        if(FR_NOT_ENOUGH_CORE == res) {
+            /* growing never merges fragments, the file stays on the chain walk until it shrinks */
+            fsf->needed = fsf->table[0];
+            fsf->map = FF_FASTSEEK_MAP_FALLBACK;
+            ff_fastseek_stats.fallbacks++;
+            res = FR_OK;
+        }
+    }
+    return res;
+}
+
+/*!
+    \brief      open a file and build its link map
+    \param[in]  fsf: file to open
+    \param[in]  path: file name
+    \param[in]  mode: FA_* access mode
+    \param[in]  table: link map table, NULL to take one from the pool
+    \param[in]  table_words: size of the table in words, 2 * fragments + 2 are used
+    \param[out] none
+    \retval     FRESULT, a table that is missing or too small is not an error
+*/
+FRESULT ff_fastseek_open(ff_fastseek_file_struct *fsf, const TCHAR *path, BYTE mode, DWORD *table, UINT table_words)
+{
+    FRESULT res;
+#if FF_FASTSEEK_POOL_TABLES > 0U
+    uint8_t i;
+#endif /* FF_FASTSEEK_POOL_TABLES > 0U */
+
+    memset(fsf, 0, sizeof(ff_fastseek_file_struct));
+    fsf->table = table;
+    fsf->table_words = table_words;
+
+#if FF_FASTSEEK_POOL_TABLES > 0U
+    if(NULL == table) {
+        for(i = 0U; i < FF_FASTSEEK_POOL_TABLES; i++) {
+            if(!ff_fastseek_pool_used[i]) {
+                ff_fastseek_pool_used[i] = 1U;
+                fsf->table = ff_fastseek_pool[i];
+                fsf->table_words = FF_FASTSEEK_POOL_WORDS;
+                fsf->pool = i + 1U;
+                break;
+            }
+        }
+    }
+#endif /* FF_FASTSEEK_POOL_TABLES > 0U */
+    if(NULL == fsf->table) {
+        ff_fastseek_stats.pool_empty++;
+    }
+
+    res = f_open(&fsf->file, path, mode);
+    if(FR_OK == res) {
+        res = ff_fastseek_map(fsf);
+        if(FR_OK != res) {
+            f_close(&fsf->file);
+        }
+    }
+    if(FR_OK != res) {
+#if FF_FASTSEEK_POOL_TABLES > 0U
+        if(0U != fsf->pool) {
+            ff_fastseek_pool_used[fsf->pool - 1U] = 0U;
+        }
+#endif /* FF_FASTSEEK_POOL_TABLES > 0U */
+        fsf->pool = 0U;
+    }
+    return res;
+}
+
+/*!
+    \brief      read from the current position
+    \param[in]  fsf: open file
+    \param[in]  buff: data buffer to store read data
+    \param[in]  btr: number of bytes to read
+    \param[out] br: number of bytes read
+    \retval     FRESULT
+*/
+FRESULT ff_fastseek_read(ff_fastseek_file_struct *fsf, void *buff, UINT btr, UINT *br)
+{
+    FRESULT res = ff_fastseek_map(fsf);
+
+    if(FR_OK != res) {
+        *br = 0U;
+        return res;
+    }
+    return f_read(&fsf->file, buff, btr, br);
+}
+
+/*!
+    \brief      write at the current position, a write that needs new clusters drops the map
+    \param[in]  fsf: open file
+    \param[in]  buff: data to be written
+    \param[in]  btw: number of bytes to write
+    \param[out] bw: number of bytes written
+    \retval     FRESULT
+*/
+FRESULT ff_fastseek_write(ff_fastseek_file_struct *fsf, const void *buff, UINT btw, UINT *bw)
+{
+    FSIZE_t cluster = (FSIZE_t)fsf->file.obj.fs->csize * FF_MAX_SS;
+    FSIZE_t allocated = ((fsf->file.obj.objsize + cluster - 1U) / cluster) * cluster;
+
+    /* FatFs does not extend a chain in fast seek mode, writes beyond the last cluster go without the map */
+    if(fsf->file.fptr + btw > allocated) {
+        ff_fastseek_invalidate(fsf);
+    } else {
+        FRESULT res = ff_fastseek_map(fsf);
+
+        if(FR_OK != res) {
+            *bw = 0U;
+            return res;
+        }
+    }
+    return f_write(&fsf->file, buff, btw, bw);
+}
+
+/*!
+    \brief      move the file pointer, through the map when possible
+    \param[in]  fsf: open file
+    \param[in]  ofs: new file pointer, beyond the end it extends a file opened for writing
+    \param[out] none
+    \retval     FRESULT
+*/
+FRESULT ff_fastseek_lseek(ff_fastseek_file_struct *fsf, FSIZE_t ofs)
+{
+    FRESULT res;
+
+    if((ofs > fsf->file.obj.objsize) && (fsf->file.flag & FA_WRITE)) {
+        /* an expanding seek allocates clusters, which only the chain walk does */
+        ff_fastseek_invalidate(fsf);
+        return f_lseek(&fsf->file, ofs);
+    }
+
+    res = ff_fastseek_map(fsf);
+    if(FR_OK == res) {
+        res = f_lseek(&fsf->file, ofs);
+    }
+    return res;
+}
+
+/*!
+    \brief      truncate the file at the current position
+    \param[in]  fsf: open file
+    \param[out] none
+    \retval     FRESULT
+*/
+FRESULT ff_fastseek_truncate(ff_fastseek_file_struct *fsf)
+{
+    FRESULT res = f_truncate(&fsf->file);
+
+    /* the map still describes the remaining clusters, a fallback may fit now */
+    if((FR_OK == res) && (FF_FASTSEEK_MAP_FALLBACK == fsf->map)) {
+        fsf->map = FF_FASTSEEK_MAP_NONE;
+    }
+    return res;
+}
+
+/*!
+    \brief      drop the map after the file was changed by other means, it is rebuilt on the next access
+    \param[in]  fsf: open file
+    \param[out] none
+    \retval     none
+*/
+void ff_fastseek_invalidate(ff_fastseek_file_struct *fsf)
+{
+    if(FF_FASTSEEK_MAP_VALID == fsf->map) {
+        fsf->file.cltbl = NULL;
+        fsf->map = FF_FASTSEEK_MAP_NONE;
+        ff_fastseek_stats.invalidations++;
+    }
+}
+
+/*!
+    \brief      close the file and give its pool table back
+    \param[in]  fsf: open file
+    \param[out] none
+    \retval     FRESULT
+*/
+FRESULT ff_fastseek_close(ff_fastseek_file_struct *fsf)
+{
+    FRESULT res = f_close(&fsf->file);
+
+#if FF_FASTSEEK_POOL_TABLES > 0U
+    if(0U != fsf->pool) {
+        ff_fastseek_pool_used[fsf->pool - 1U] = 0U;
+    }
+#endif /* FF_FASTSEEK_POOL_TABLES > 0U */
+    fsf->pool = 0U;
+    fsf->table = NULL;
+    fsf->map = FF_FASTSEEK_MAP_NONE;
+    return res;
+}
+
+/*!
+    \brief      read the statistics of all fast seek files
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void ff_fastseek_stats_get(ff_fastseek_stats_struct *stats)
+{
+    *stats = ff_fastseek_stats;
+}
+
+#endif /* FF_USE_FASTSEEK */
@@ -0,0 +1,257 @@
+/*!
+    \file    ff_stream.c
+    \brief   streaming writes into a preallocated contiguous FatFs file
+
+    A data logger that appends through f_write pays for the sector window, a FAT walk at every
+    new cluster and a directory update at every f_sync, so single writes take anything from a
+    memcpy to several device operations. A stream instead allocates the whole extent of the
+    file with f_expand() when it is opened and chains it on the FAT at once. From then on every
+    filled buffer is one disk_write() of consecutive sectors, straight behind the previous one,
+    and FatFs is only asked to rewrite the directory entry with the new size.
+
+    The buffers form a double buffer: while one is written the other one is filled, by
+    ff_stream_write() or by a DMA transfer that the application points at ff_stream_buffer_get().
+
+    Power loss: the directory entry is only ever updated after a CTRL_SYNC, so the recorded
+    size never covers sectors that have not reached the medium. After a loss the file ends at
+    the last commit and the rest of the extent is still chained to it (FAT) or marked in the
+    allocation bitmap (exFAT), where a disk check reclaims it. ff_stream_close() frees the
+    unused clusters in the regular way.
+*/
+
+#include "ff_stream.h"
+#include <string.h>
+
+#if FF_USE_EXPAND && !FF_FS_READONLY
+
+#if FF_MIN_SS != FF_MAX_SS
+#error ff_stream.c assumes a fixed sector size
+#endif
+
+#define FF_STREAM_SECTOR_SIZE           FF_MAX_SS
+
+/*!
+    \brief      create a file with a contiguous extent and open it for streaming
+    \param[in]  stream: stream to open
+    \param[in]  path: file name, an existing file is replaced
+    \param[in]  extent: bytes to preallocate, rounded up to a multiple of the buffer size
+    \param[in]  buffers: memory of both buffers, 2 * buffer_size bytes, word aligned for DMA
+    \param[in]  buffer_size: bytes per buffer, a multiple of the sector size, ideally of the cluster size
+    \param[in]  commit_interval: bytes after which the size is committed automatically, 0 for none
+    \param[out] none
+    \retval     FRESULT, FR_DENIED if the volume has no contiguous free area of that size
+*/
+FRESULT ff_stream_open(ff_stream_struct *stream, const TCHAR *path, FSIZE_t extent, void *buffers, UINT buffer_size, FSIZE_t commit_interval)
+{
+    FATFS *fs;
+    FRESULT res;
+
+    if((NULL == buffers) || (0U == extent) || (0U == buffer_size) || (0U != buffer_size % FF_STREAM_SECTOR_SIZE)) {
+        return FR_INVALID_PARAMETER;
+    }
+
+    memset(stream, 0, sizeof(ff_stream_struct));
+    stream->buffer[0] = (BYTE *)buffers;
+    stream->buffer[1] = (BYTE *)buffers + buffer_size;
+    stream->buffer_size = buffer_size;
+    stream->extent = ((extent + buffer_size - 1U) / buffer_size) * buffer_size;
+    stream->commit_interval = commit_interval;
+
+    res = f_open(&stream->file, path, FA_WRITE | FA_CREATE_ALWAYS);
+    if(FR_OK != res) {
+        return res;
+    }
+
+    res = f_expand(&stream->file, stream->extent, 1U);
+    if(FR_OK == res) {
+        fs = stream->file.obj.fs;
+        stream->pdrv = fs->pdrv;
+        stream->sector = fs->database + (DWORD)fs->csize * (stream->file.obj.sclust - 2U);
+        /* an empty entry that already owns the extent, the FAT chain reaches the medium with it */
+        res = ff_stream_commit(stream);
+    }
+
+    if(FR_OK != res) {
+        f_close(&stream->file);
+        f_unlink(path);
+    }
+    return res;
+}
+
+/*!
+    \brief      get the buffer to be filled next, e.g. the target of a DMA transfer
+    \param[in]  stream: open stream
+    \param[out] none
+    \retval     buffer of buffer_size bytes
+*/
+BYTE *ff_stream_buffer_get(ff_stream_struct *stream)
+{
+    return stream->buffer[stream->active];
+}
+
+/*!
+    \brief      write the completely filled buffer and switch to the other one
+    \param[in]  stream: open stream
+    \param[out] none
+    \retval     FRESULT, FR_DENIED once the extent is full
+*/
+FRESULT ff_stream_buffer_submit(ff_stream_struct *stream)
+{
+    DWORD sector = stream->sector + (DWORD)(stream->size / FF_STREAM_SECTOR_SIZE);
+
+    if(stream->size + stream->buffer_size > stream->extent) {
+        return FR_DENIED;
+    }
+
+    /* the extent is contiguous, the buffer lands right behind the previous one */
+    if(RES_OK != disk_write(stream->pdrv, stream->buffer[stream->active], sector, stream->buffer_size / FF_STREAM_SECTOR_SIZE)) {
+        stream->stats.errors++;
+        return FR_DISK_ERR;
+    }
+    stream->size += stream->buffer_size;
+    stream->fill = 0U;
+    stream->active ^= 1U;
+    stream->stats.buffers++;
+
+    if((0U != stream->commit_interval) && (stream->size - stream->committed >= stream->commit_interval)) {
+        return ff_stream_commit(stream);
+    }
+    return FR_OK;
+}
+
+/*!
+    \brief      copy data into the stream, full buffers are written as they complete
+    \param[in]  stream: open stream
+    \param[in]  data: data to append
+    \param[in]  btw: number of bytes
+    \param[out] bw: number of bytes taken over by the stream
+    \retval     FRESULT
+*/
+FRESULT ff_stream_write(ff_stream_struct *stream, const void *data, UINT btw, UINT *bw)
+{
+    const BYTE *src = (const BYTE *)data;
+    FRESULT res;
+    UINT n;
+
+    *bw = 0U;
+    while(btw > 0U) {
+        /* a buffer left full by a failed submit is retried first */
+        if(stream->fill == stream->buffer_size) {
+            res = ff_stream_buffer_submit(stream);
+            if(FR_OK != res) {
+                return res;
+            }
+        }
+
+        n = stream->buffer_size - stream->fill;
+        if(n > btw) {
+            n = btw;
+        }
+        memcpy(stream->buffer[stream->active] + stream->fill, src, n);
+        stream->fill += n;
+        src += n;
+        btw -= n;
+        *bw += n;
+    }
+
+    if(stream->fill == stream->buffer_size) {
+        return ff_stream_buffer_submit(stream);
+    }
+    return FR_OK;
+}
+
+/*!
+    \brief      record the data written so far in the directory entry
+    \param[in]  stream: open stream
+    \param[out] none
+    \retval     FRESULT
+*/
+FRESULT ff_stream_commit(ff_stream_struct *stream)
+{
+    FRESULT res;
+    UINT bw;
+
+    /* the data has to be on the medium before the entry covers it */
+    if(RES_OK != disk_ioctl(stream->pdrv, CTRL_SYNC, NULL)) {
+        stream->stats.errors++;
+        return FR_DISK_ERR;
+    }
+
+    stream->file.obj.objsize = stream->size;
+    /* an empty write marks the file modified, f_sync then rewrites size and time stamp */
+    res = f_write(&stream->file, stream->buffer[0], 0U, &bw);
+    if(FR_OK == res) {
+        res = f_sync(&stream->file);
+    }
+
+    if(FR_OK == res) {
+        stream->committed = stream->size;
+        stream->stats.commits++;
+    } else {
+        stream->stats.errors++;
+    }
+    return res;
+}
+
+/*!
+    \brief      write the partial buffer, commit the exact size and free the unused part of the extent
+    \param[in]  stream: open stream
+    \param[out] none
+    \retval     FRESULT
+*/
+FRESULT ff_stream_close(ff_stream_struct *stream)
+{
+    FATFS *fs = stream->file.obj.fs;
+    FSIZE_t cluster = (FSIZE_t)fs->csize * FF_STREAM_SECTOR_SIZE;
+    DWORD sector = stream->sector + (DWORD)(stream->size / FF_STREAM_SECTOR_SIZE);
+    FRESULT res = FR_OK;
+    FRESULT close_res;
+    UINT sectors;
+
+    /* the tail is padded to whole sectors, the file size cuts the padding off again */
+    if((stream->fill > 0U) && (stream->size + stream->fill <= stream->extent)) {
+        sectors = (stream->fill + FF_STREAM_SECTOR_SIZE - 1U) / FF_STREAM_SECTOR_SIZE;
+        memset(stream->buffer[stream->active] + stream->fill, 0, sectors * FF_STREAM_SECTOR_SIZE - stream->fill);
+        if(RES_OK == disk_write(stream->pdrv, stream->buffer[stream->active], sector, sectors)) {
+            stream->size += stream->fill;
+            stream->fill = 0U;
+        } else {
+            stream->stats.errors++;
+            res = FR_DISK_ERR;
+        }
+    }
+
+    if(RES_OK != disk_ioctl(stream->pdrv, CTRL_SYNC, NULL)) {
+        stream->stats.errors++;
+        res = FR_DISK_ERR;
+    }
+
+    if(FR_OK == res) {
+        /* f_truncate() releases the chain behind the file pointer of the whole extent */
+        stream->file.obj.objsize = ((stream->extent + cluster - 1U) / cluster) * cluster;
+        res = f_lseek(&stream->file, stream->size);
+        if(FR_OK == res) {
+            res = f_truncate(&stream->file);
+        }
+    }
+    if(FR_OK != res) {
+        /* keep what is known to be on the medium */
+        stream->file.obj.objsize = stream->committed;
+    }
+
+    close_res = f_close(&stream->file);
+    return (FR_OK != res) ? res : close_res;
+}
+
+/*!
+    \brief      read the statistics of a stream
+    \param[in]  stream: open stream
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void ff_stream_stats_get(ff_stream_struct *stream, ff_stream_stats_struct *stats)
+{
+    *stats = stream->stats;
+}
+
+#endif /* FF_USE_EXPAND && !FF_FS_READONLY */
@@ -34,6 +34,10 @@
 #define MERGE2(a, b) a ## b
 #define CVTBL(tbl, cp) MERGE2(tbl, cp)
 
+#ifndef FF_WTOUPPER_FAST
+#define FF_WTOUPPER_FAST	1	/* 1: ff_wtoupper() skips the table walk where the tables have no entries */
+#endif
+
 
 /*------------------------------------------------------------------------*/
 /* Code Conversion Tables                                                 */
@@ -15217,12 +15221,37 @@ static const WCHAR uc869[] = {	/*  CP869(Greek 2) to Unicode conversion table */
 
 
 
+/*------------------------------------------------------------------------*/
+/* OEM <==> Unicode conversions for ASCII only configuration              */
+/*------------------------------------------------------------------------*/
+
+#if FF_CODE_PAGE == 1
+WCHAR ff_uni2oem (	/* Returns ASCII character, zero on error */
+	DWORD	uni,	/* UTF-16 encoded character to be converted */
+	WORD	cp		/* Code page for the conversion (not used) */
+)
+{
+	return (uni < 0x80) ? (WCHAR)uni : 0;
+}
+
+WCHAR ff_oem2uni (	/* Returns Unicode character, zero on error */
+	WCHAR	oem,	/* ASCII character to be converted */
+	WORD	cp		/* Code page for the conversion (not used) */
+)
+{
+	return (oem < 0x80) ? oem : 0;
+}
+
+#endif
+
+
+
 /*------------------------------------------------------------------------*/
 /* OEM <==> Unicode conversions for static code page configuration        */
 /* SBCS fixed code page                                                   */
 /*------------------------------------------------------------------------*/
 
-#if FF_CODE_PAGE != 0 && FF_CODE_PAGE < 900
+#if FF_CODE_PAGE > 1 && FF_CODE_PAGE < 900
 WCHAR ff_uni2oem (	/* Returns OEM code character, zero on error */
 	DWORD	uni,	/* UTF-16 encoded character to be converted */
 	WORD	cp		/* Code page for the conversion */
@@ -15564,6 +15593,15 @@ DWORD ff_wtoupper (	/* Returns up-converted code point */
 	};
 
 
+#if FF_WTOUPPER_FAST
+	if (uni < 0x80) {	/* ASCII? (most names, no table walk) */
+		if (uni >= 'a' && uni <= 'z') uni -= 0x20;
+		return uni;
+	}
+	if ((uni >= 0x0587 && uni < 0x1D7D) || (uni >= 0x2D26 && uni < 0xFF41)) {	/* No lower case letters in the tables (CJK, Kana, Hangul...) */
+		return uni;
+	}
+#endif
 	if (uni < 0x10000) {	/* Is it in BMP? */
 		uc = (WORD)uni;
 		p = uc < 0x1000 ? cvt1 : cvt2;
@@ -0,0 +1,447 @@
+/*!
+    \file    nand_diskio.c
+    \brief   FatFs disk I/O driver for the NAND flash on the EXMC interface
+
+    Sectors map one to one onto the main areas of the pages, 256 sectors to an erase block. A
+    page can only be programmed once after its block was erased, so writes go to a buffer of
+    one block: the block is read into it, changed there and erased and programmed back when
+    FatFs moves to another block or syncs. Pages that stay blank are not programmed.
+
+    The driver remembers which blocks are erased. A CTRL_TRIM erases the blocks a released
+    range covers completely, while the application is idle when the trim queue of disk_trim.c
+    is attached. Erased blocks read as 0xFF without page reads, are not read into the buffer
+    and are not erased again when it is programmed back, so a freed block costs the next file
+    only its programming. f_mkfs trims the whole volume and leaves every block erased; after a
+    reset all blocks count as programmed until they are trimmed again.
+
+    This is a plain mapping without ECC, bad block handling or wear leveling, and a reset
+    while a block is programmed back loses that block. It suits the demonstration of the
+    example, a product needs a flash translation layer in between.
+*/
+
+#include "nand_diskio.h"
+#include "exmc_nandflash.h"
+#include <string.h>
+
+#define NAND_DISKIO_SECTOR_SIZE         512U
+#define NAND_DISKIO_PAGE_SECTORS        (NAND_PAGE_SIZE / NAND_DISKIO_SECTOR_SIZE)
+#define NAND_DISKIO_BLOCK_SECTORS       (NAND_BLOCK_SIZE * NAND_DISKIO_PAGE_SECTORS)
+#define NAND_DISKIO_BLOCK_BYTES         (NAND_BLOCK_SIZE * NAND_PAGE_SIZE)
+#define NAND_DISKIO_SECTORS             ((DWORD)NAND_BLOCK_COUNT * NAND_DISKIO_BLOCK_SECTORS)
+/* the block buffer holds no block */
+#define NAND_DISKIO_NO_BLOCK            0xFFFFFFFFU
+
+static volatile DSTATUS nand_disk_state = STA_NOINIT;
+static uint32_t nand_disk_buffer[NAND_DISKIO_BLOCK_BYTES / 4U];
+static uint32_t nand_disk_page[NAND_PAGE_SIZE / 4U];
+static uint32_t nand_disk_block = NAND_DISKIO_NO_BLOCK;
+static uint8_t nand_disk_dirty = 0U;
+static uint8_t nand_disk_erased[NAND_BLOCK_COUNT / 8U];
+static nand_diskio_stats_struct nand_disk_stats;
+
+static DSTATUS nand_disk_initialize(BYTE lun);
+static DSTATUS nand_disk_status(BYTE lun);
+static DRESULT nand_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+static DRESULT nand_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+static DRESULT nand_disk_ioctl(BYTE lun, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef NAND_Driver = {
+    nand_disk_initialize,
+    nand_disk_status,
+    nand_disk_read,
+#if _USE_WRITE == 1
+    nand_disk_write,
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+    nand_disk_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/*!
+    \brief      check whether a block is known to be erased
+    \param[in]  block: block number
+    \param[out] none
+    \retval     1 if it is, 0 otherwise
+*/
+static uint8_t nand_disk_erased_get(uint32_t block)
+{
+    return (nand_disk_erased[block >> 3] >> (block & 7U)) & 1U;
+}
+
+/*!
+    \brief      record whether a block is erased
+    \param[in]  block: block number
+    \param[in]  erased: 1 after an erase, 0 after programming
+    \param[out] none
+    \retval     none
+*/
+static void nand_disk_erased_set(uint32_t block, uint8_t erased)
+{
+    if(erased) {
+        nand_disk_erased[block >> 3] |= (uint8_t)(1U << (block & 7U));
+    } else {
+        nand_disk_erased[block >> 3] &= (uint8_t)~(1U << (block & 7U));
+    }
+}
+
+/*!
+    \brief      erase a block and record it
+    \param[in]  block: block number
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_erase(uint32_t block)
+{
+    nand_disk_stats.erases++;
+    if(NAND_OK != nand_block_erase(block)) {
+        nand_disk_stats.errors++;
+        nand_disk_erased_set(block, 0U);
+        return RES_ERROR;
+    }
+    nand_disk_erased_set(block, 1U);
+    return RES_OK;
+}
+
+/*!
+    \brief      check whether a page of data is blank
+    \param[in]  data: NAND_PAGE_SIZE bytes, word aligned
+    \param[out] none
+    \retval     1 if all bytes are 0xFF, 0 otherwise
+*/
+static uint8_t nand_disk_blank(const uint32_t *data)
+{
+    uint32_t i;
+
+    for(i = 0U; i < NAND_PAGE_SIZE / 4U; i++) {
+        if(0xFFFFFFFFU != data[i]) {
+            return 0U;
+        }
+    }
+    return 1U;
+}
+
+/*!
+    \brief      erase the block of the buffer and program it back, if it was changed
+    \param[in]  none
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_flush(void)
+{
+    uint32_t page, first;
+    uint8_t blank = 1U;
+
+    if((NAND_DISKIO_NO_BLOCK == nand_disk_block) || !nand_disk_dirty) {
+        return RES_OK;
+    }
+    /* the block stays in the buffer, a failed write back is retried with the next flush */
+    if(!nand_disk_erased_get(nand_disk_block) && (RES_OK != nand_disk_erase(nand_disk_block))) {
+        return RES_ERROR;
+    }
+    nand_disk_stats.programs++;
+    first = nand_disk_block * NAND_BLOCK_SIZE;
+    for(page = 0U; page < NAND_BLOCK_SIZE; page++) {
+        if(nand_disk_blank(&nand_disk_buffer[page * (NAND_PAGE_SIZE / 4U)])) {
+            continue;
+        }
+        blank = 0U;
+        nand_disk_erased_set(nand_disk_block, 0U);
+        if(NAND_OK != nand_page_write(first + page, (uint8_t *)&nand_disk_buffer[page * (NAND_PAGE_SIZE / 4U)])) {
+            nand_disk_stats.errors++;
+            return RES_ERROR;
+        }
+    }
+    if(blank) {
+        nand_disk_erased_set(nand_disk_block, 1U);
+    }
+    nand_disk_dirty = 0U;
+    return RES_OK;
+}
+
+/*!
+    \brief      bring a block into the buffer, writing back the block it held
+    \param[in]  block: block number
+    \param[in]  whole: 1 if the caller overwrites the whole block, it is not read then
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_load(uint32_t block, uint8_t whole)
+{
+    uint32_t page, first;
+
+    if(block == nand_disk_block) {
+        return RES_OK;
+    }
+    if(RES_OK != nand_disk_flush()) {
+        return RES_ERROR;
+    }
+    nand_disk_block = NAND_DISKIO_NO_BLOCK;
+    nand_disk_dirty = 0U;
+
+    if(whole || nand_disk_erased_get(block)) {
+        nand_disk_stats.loads_skipped++;
+        memset(nand_disk_buffer, 0xFF, sizeof(nand_disk_buffer));
+    } else {
+        nand_disk_stats.loads++;
+        first = block * NAND_BLOCK_SIZE;
+        for(page = 0U; page < NAND_BLOCK_SIZE; page++) {
+            if(NAND_OK != nand_page_read(first + page, (uint8_t *)&nand_disk_buffer[page * (NAND_PAGE_SIZE / 4U)])) {
+                nand_disk_stats.errors++;
+                return RES_ERROR;
+            }
+        }
+    }
+    nand_disk_block = block;
+    return RES_OK;
+}
+
+/*!
+    \brief      initialize the NAND flash, the EXMC has to be configured already
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS nand_disk_initialize(BYTE lun)
+{
+    nand_disk_state = STA_NOINIT;
+    nand_disk_block = NAND_DISKIO_NO_BLOCK;
+    nand_disk_dirty = 0U;
+    /* nothing is known about the blocks until they are trimmed */
+    memset(nand_disk_erased, 0, sizeof(nand_disk_erased));
+
+    if(NAND_OK == nand_reset()) {
+        nand_disk_state &= (DSTATUS)~STA_NOINIT;
+    }
+
+    return nand_disk_state;
+}
+
+/*!
+    \brief      get the disk status
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS nand_disk_status(BYTE lun)
+{
+    return nand_disk_state;
+}
+
+/*!
+    \brief      read sectors
+    \param[in]  lun: not used
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    uint32_t block, page, offset;
+    UINT chunk;
+
+    if(nand_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((0U == count) || (sector + count > NAND_DISKIO_SECTORS) || (sector + count < sector)) {
+        return RES_PARERR;
+    }
+
+    nand_disk_stats.reads++;
+    nand_disk_stats.sectors_read += count;
+
+    while(0U != count) {
+        block = sector / NAND_DISKIO_BLOCK_SECTORS;
+        page = sector / NAND_DISKIO_PAGE_SECTORS;
+        offset = sector % NAND_DISKIO_PAGE_SECTORS;
+        chunk = NAND_DISKIO_PAGE_SECTORS - offset;
+        if(chunk > count) {
+            chunk = count;
+        }
+
+        if(block == nand_disk_block) {
+            memcpy(buff, (uint8_t *)nand_disk_buffer + (sector % NAND_DISKIO_BLOCK_SECTORS) * NAND_DISKIO_SECTOR_SIZE,
+                   chunk * NAND_DISKIO_SECTOR_SIZE);
+        } else if(nand_disk_erased_get(block)) {
+            nand_disk_stats.sectors_blank += chunk;
+            memset(buff, 0xFF, chunk * NAND_DISKIO_SECTOR_SIZE);
+        } else if(NAND_DISKIO_PAGE_SECTORS == chunk) {
+            /* the page is read byte by byte from the data area, any alignment will do */
+            if(NAND_OK != nand_page_read(page, buff)) {
+                nand_disk_stats.errors++;
+                return RES_ERROR;
+            }
+        } else {
+            if(NAND_OK != nand_page_read(page, (uint8_t *)nand_disk_page)) {
+                nand_disk_stats.errors++;
+                return RES_ERROR;
+            }
+            memcpy(buff, (uint8_t *)nand_disk_page + offset * NAND_DISKIO_SECTOR_SIZE, chunk * NAND_DISKIO_SECTOR_SIZE);
+        }
+        buff += chunk * NAND_DISKIO_SECTOR_SIZE;
+        sector += chunk;
+        count -= chunk;
+    }
+
+    return RES_OK;
+}
+
+#if _USE_WRITE == 1
+/*!
+    \brief      write sectors into the block buffer
+    \param[in]  lun: not used
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    uint32_t block, offset;
+    UINT chunk;
+
+    if(nand_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((0U == count) || (sector + count > NAND_DISKIO_SECTORS) || (sector + count < sector)) {
+        return RES_PARERR;
+    }
+
+    nand_disk_stats.writes++;
+    nand_disk_stats.sectors_written += count;
+
+    while(0U != count) {
+        block = sector / NAND_DISKIO_BLOCK_SECTORS;
+        offset = sector % NAND_DISKIO_BLOCK_SECTORS;
+        chunk = NAND_DISKIO_BLOCK_SECTORS - offset;
+        if(chunk > count) {
+            chunk = count;
+        }
+
+        if(RES_OK != nand_disk_load(block, (NAND_DISKIO_BLOCK_SECTORS == chunk) ? 1U : 0U)) {
+            return RES_ERROR;
+        }
+        memcpy((uint8_t *)nand_disk_buffer + offset * NAND_DISKIO_SECTOR_SIZE, buff, chunk * NAND_DISKIO_SECTOR_SIZE);
+        nand_disk_dirty = 1U;
+
+        buff += chunk * NAND_DISKIO_SECTOR_SIZE;
+        sector += chunk;
+        count -= chunk;
+    }
+
+    return RES_OK;
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+/*!
+    \brief      erase the blocks of a released range
+    \param[in]  start: first sector
+    \param[in]  end: last sector
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_trim(DWORD start, DWORD end)
+{
+    DRESULT res = RES_OK;
+    uint32_t block, first, last;
+
+    /* released sectors of the buffered block are blanked, a later write back leaves their
+       pages out; a clean block is not programmed for that alone */
+    if((NAND_DISKIO_NO_BLOCK != nand_disk_block) && (start / NAND_DISKIO_BLOCK_SECTORS <= nand_disk_block) &&
+       (end / NAND_DISKIO_BLOCK_SECTORS >= nand_disk_block)) {
+        first = (start > nand_disk_block * NAND_DISKIO_BLOCK_SECTORS) ? start % NAND_DISKIO_BLOCK_SECTORS : 0U;
+        last = (end < (nand_disk_block + 1U) * NAND_DISKIO_BLOCK_SECTORS) ? end % NAND_DISKIO_BLOCK_SECTORS : NAND_DISKIO_BLOCK_SECTORS - 1U;
+        memset((uint8_t *)nand_disk_buffer + first * NAND_DISKIO_SECTOR_SIZE, 0xFF, (last - first + 1U) * NAND_DISKIO_SECTOR_SIZE);
+    }
+
+    /* blocks with sectors outside the range keep their data */
+    first = (start + NAND_DISKIO_BLOCK_SECTORS - 1U) / NAND_DISKIO_BLOCK_SECTORS;
+    last = (end + 1U) / NAND_DISKIO_BLOCK_SECTORS;
+    for(block = first; block < last; block++) {
+        nand_disk_stats.blocks_trimmed++;
+        if(block == nand_disk_block) {
+            nand_disk_block = NAND_DISKIO_NO_BLOCK;
+            nand_disk_dirty = 0U;
+        }
+        if(!nand_disk_erased_get(block) && (RES_OK != nand_disk_erase(block))) {
+            res = RES_ERROR;
+        }
+    }
+    nand_disk_stats.trims++;
+    return res;
+}
+
+/*!
+    \brief      I/O control operation
+    \param[in]  lun: not used
+    \param[in]  cmd: control code
+    \param[in]  buff: buffer to send/receive control data
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT nand_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+    DRESULT res = RES_OK;
+    DWORD *range;
+
+    if(nand_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    switch(cmd) {
+    /* program the block buffer back */
+    case CTRL_SYNC:
+        res = nand_disk_flush();
+        break;
+
+    /* get number of sectors on the disk (DWORD) */
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = NAND_DISKIO_SECTORS;
+        break;
+
+    /* get r/w sector size (WORD) */
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = NAND_DISKIO_SECTOR_SIZE;
+        break;
+
+    /* get erase block size in unit of sector (DWORD) */
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = NAND_DISKIO_BLOCK_SECTORS;
+        break;
+
+    /* erase the blocks inside range[0] .. range[1] that FatFs no longer uses */
+    case CTRL_TRIM:
+        range = (DWORD *)buff;
+        if((range[1] < range[0]) || (range[1] >= NAND_DISKIO_SECTORS)) {
+            res = RES_PARERR;
+            break;
+        }
+        res = nand_disk_trim(range[0], range[1]);
+        break;
+
+    default:
+        res = RES_PARERR;
+        break;
+    }
+
+    return res;
+}
+#endif /* _USE_IOCTL == 1 */
+
+/*!
+    \brief      read the statistics of the NAND disk driver
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void nand_diskio_stats_get(nand_diskio_stats_struct *stats)
+{
+    *stats = nand_disk_stats;
+}
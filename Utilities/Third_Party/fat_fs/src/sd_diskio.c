@@ -0,0 +1,362 @@
+/*!
+    \file    sd_diskio.c
+    \brief   FatFs disk I/O driver for an SD card on the SDIO interface
+
+    Each disk_read or disk_write is one request of the SD card queue, a multi-sector call is a
+    single CMD18 or ACMD23 + CMD25 DMA transfer instead of one command per sector. ACMD23 lets
+    the card pre-erase the whole range before the data arrives. The DMA needs word aligned
+    memory, buffers FatFs hands over at odd addresses are carried through a bounce buffer in
+    SD_DISKIO_BOUNCE_SECTORS chunks.
+*/
+
+#include "sd_diskio.h"
+#include "sdcard.h"
+#include <string.h>
+
+/* the SDIO data counter takes at most 2^25 - 1 bytes per transfer */
+#define SD_DISKIO_MAX_SECTORS           0xFFFFU
+/* locked bit of the card status */
+#define SD_DISKIO_CARD_LOCKED           0x02000000U
+
+static volatile DSTATUS sd_disk_state = STA_NOINIT;
+static DWORD sd_disk_sectors = 0U;
+static DWORD sd_disk_erase_sectors = 1U;
+static uint32_t sd_disk_bounce[SD_DISKIO_BOUNCE_SECTORS * 128U];
+static sd_diskio_stats_struct sd_disk_stats;
+
+/* erase unit of the SD status AU_SIZE field in sectors, 0 is not defined */
+static const DWORD sd_disk_au_sectors[16] = {
+    0U, 32U, 64U, 128U, 256U, 512U, 1024U, 2048U,
+    4096U, 8192U, 16384U, 24576U, 32768U, 49152U, 65536U, 131072U
+};
+
+static DSTATUS sd_disk_initialize(BYTE lun);
+static DSTATUS sd_disk_status(BYTE lun);
+static DRESULT sd_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+static DRESULT sd_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+static DRESULT sd_disk_ioctl(BYTE lun, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+
+const Diskio_drvTypeDef SD_Driver = {
+    sd_disk_initialize,
+    sd_disk_status,
+    sd_disk_read,
+#if _USE_WRITE == 1
+    sd_disk_write,
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+    sd_disk_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/*!
+    \brief      move sectors between the card and word aligned memory as one queued transfer
+    \param[in]  buffer: word aligned data of count sectors
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors, up to SD_DISKIO_MAX_SECTORS
+    \param[in]  direction: SD_REQUEST_READ or SD_REQUEST_WRITE
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT sd_disk_transfer(uint32_t *buffer, DWORD sector, UINT count, uint8_t direction)
+{
+    sd_request_struct request;
+
+    request.buffer = buffer;
+    request.block = sector;
+    request.count = count;
+    request.direction = direction;
+    request.callback = NULL;
+    request.arg = NULL;
+
+    if(SD_OK != sd_request_submit(&request)) {
+        sd_disk_stats.errors++;
+        return RES_ERROR;
+    }
+    /* writes complete once the card has programmed the data */
+    while(0U == request.done) {
+        sd_queue_process();
+    }
+    if(SD_OK != request.status) {
+        sd_disk_stats.errors++;
+        return RES_ERROR;
+    }
+    return RES_OK;
+}
+
+/*!
+    \brief      wait until the card has programmed all queued writes
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sd_disk_sync(void)
+{
+    while(!sd_queue_idle()) {
+        sd_queue_process();
+    }
+}
+
+/*!
+    \brief      read the erase unit of the card from the SD status
+    \param[in]  none
+    \param[out] none
+    \retval     erase unit in sectors, 1 if the card does not report one
+*/
+static DWORD sd_disk_erase_unit_get(void)
+{
+    uint32_t sdstatus[16];
+    uint32_t au_size;
+
+    if(SD_OK != sd_sdstatus_get(sdstatus)) {
+        return 1U;
+    }
+    /* AU_SIZE are the bits [431:428] of the SD status */
+    au_size = (sdstatus[2] >> 12) & 0x0FU;
+    return (0U != au_size) ? sd_disk_au_sectors[au_size] : 1U;
+}
+
+/*!
+    \brief      initialize the card, use the 4-bit bus, high speed if available and DMA transfers
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS sd_disk_initialize(BYTE lun)
+{
+    sd_card_info_struct cardinfo;
+    sd_error_enum status;
+    uint32_t cardstate = 0U;
+
+    sd_disk_state = STA_NOINIT;
+
+    status = sd_init();
+    if(SD_OK == status) {
+        status = sd_card_information_get(&cardinfo);
+    }
+    if(SD_OK == status) {
+        status = sd_card_select_deselect(cardinfo.card_rca);
+    }
+    if(SD_OK == status) {
+        status = sd_cardstatus_get(&cardstate);
+    }
+    if((SD_OK == status) && (cardstate & SD_DISKIO_CARD_LOCKED)) {
+        status = SD_LOCK_UNLOCK_FAILED;
+    }
+    if(SD_OK == status) {
+        status = sd_bus_mode_config(SDIO_BUSMODE_4BIT);
+    }
+    if(SD_OK == status) {
+        /* cards without CMD6 stay in default speed at the fastest clock they manage */
+        status = sd_high_speed_config();
+        if(SD_FUNCTION_UNSUPPORTED == status) {
+            status = SD_OK;
+        }
+    }
+    if(SD_OK == status) {
+        sd_disk_erase_sectors = sd_disk_erase_unit_get();
+        status = sd_transfer_mode_config(SD_DMA_MODE);
+    }
+    if(SD_OK == status) {
+        sd_disk_sectors = (DWORD)sd_card_capacity_get() * 2U;
+        sd_disk_state &= (DSTATUS)~STA_NOINIT;
+    }
+
+    return sd_disk_state;
+}
+
+/*!
+    \brief      get the disk status
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS
+*/
+static DSTATUS sd_disk_status(BYTE lun)
+{
+    return sd_disk_state;
+}
+
+/*!
+    \brief      read sectors
+    \param[in]  lun: not used
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT sd_disk_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+    UINT chunk;
+
+    if(sd_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if((0U == count) || (sector + count > sd_disk_sectors) || (sector + count < sector)) {
+        return RES_PARERR;
+    }
+
+    sd_disk_stats.reads++;
+    sd_disk_stats.sectors_read += count;
+
+    if(0U == ((uint32_t)buff & 0x3U)) {
+        /* straight into the caller's buffer, one transfer per SD_DISKIO_MAX_SECTORS */
+        while((RES_OK == res) && (0U != count)) {
+            chunk = (count > SD_DISKIO_MAX_SECTORS) ? SD_DISKIO_MAX_SECTORS : count;
+            res = sd_disk_transfer((uint32_t *)buff, sector, chunk, SD_REQUEST_READ);
+            buff += chunk * 512U;
+            sector += chunk;
+            count -= chunk;
+        }
+    } else {
+        while((RES_OK == res) && (0U != count)) {
+            chunk = (count > SD_DISKIO_BOUNCE_SECTORS) ? SD_DISKIO_BOUNCE_SECTORS : count;
+            res = sd_disk_transfer(sd_disk_bounce, sector, chunk, SD_REQUEST_READ);
+            if(RES_OK == res) {
+                memcpy(buff, sd_disk_bounce, chunk * 512U);
+                sd_disk_stats.sectors_bounced += chunk;
+            }
+            buff += chunk * 512U;
+            sector += chunk;
+            count -= chunk;
+        }
+    }
+
+    return res;
+}
+
+#if _USE_WRITE == 1
+/*!
+    \brief      write sectors
+    \param[in]  lun: not used
+    \param[in]  buff: data to be written
+    \param[in]  sector: first sector
+    \param[in]  count: number of sectors
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT sd_disk_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    DRESULT res = RES_OK;
+    UINT chunk;
+
+    if(sd_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+    if(sd_disk_state & STA_PROTECT) {
+        return RES_WRPRT;
+    }
+    if((0U == count) || (sector + count > sd_disk_sectors) || (sector + count < sector)) {
+        return RES_PARERR;
+    }
+
+    sd_disk_stats.writes++;
+    sd_disk_stats.sectors_written += count;
+
+    if(0U == ((uint32_t)buff & 0x3U)) {
+        /* the DMA only reads the buffer */
+        while((RES_OK == res) && (0U != count)) {
+            chunk = (count > SD_DISKIO_MAX_SECTORS) ? SD_DISKIO_MAX_SECTORS : count;
+            res = sd_disk_transfer((uint32_t *)buff, sector, chunk, SD_REQUEST_WRITE);
+            buff += chunk * 512U;
+            sector += chunk;
+            count -= chunk;
+        }
+    } else {
+        while((RES_OK == res) && (0U != count)) {
+            chunk = (count > SD_DISKIO_BOUNCE_SECTORS) ? SD_DISKIO_BOUNCE_SECTORS : count;
+            memcpy(sd_disk_bounce, buff, chunk * 512U);
+            sd_disk_stats.sectors_bounced += chunk;
+            res = sd_disk_transfer(sd_disk_bounce, sector, chunk, SD_REQUEST_WRITE);
+            buff += chunk * 512U;
+            sector += chunk;
+            count -= chunk;
+        }
+    }
+
+    return res;
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+/*!
+    \brief      I/O control operation
+    \param[in]  lun: not used
+    \param[in]  cmd: control code
+    \param[in]  buff: buffer to send/receive control data
+    \param[out] none
+    \retval     DRESULT
+*/
+static DRESULT sd_disk_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+    DRESULT res = RES_OK;
+    DWORD *range;
+    sd_error_enum status;
+
+    if(sd_disk_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    switch(cmd) {
+    /* make sure the card has programmed all writes */
+    case CTRL_SYNC:
+        sd_disk_sync();
+        break;
+
+    /* get number of sectors on the disk (DWORD) */
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = sd_disk_sectors;
+        break;
+
+    /* get r/w sector size (WORD) */
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = 512U;
+        break;
+
+    /* get erase block size in unit of sector (DWORD) */
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = sd_disk_erase_sectors;
+        break;
+
+    /* erase the sectors range[0] .. range[1] that FatFs no longer uses */
+    case CTRL_TRIM:
+        range = (DWORD *)buff;
+        if((range[1] < range[0]) || (range[1] >= sd_disk_sectors)) {
+            res = RES_PARERR;
+            break;
+        }
+        sd_disk_sync();
+        status = sd_blocks_erase(range[0], range[1]);
+        if(SD_OK == status) {
+            sd_disk_stats.trims++;
+        } else if(SD_FUNCTION_UNSUPPORTED == status) {
+            /* trimming is a hint, a card without erase commands keeps the data */
+        } else {
+            sd_disk_stats.errors++;
+            res = RES_ERROR;
+        }
+        break;
+
+    default:
+        res = RES_PARERR;
+        break;
+    }
+
+    return res;
+}
+#endif /* _USE_IOCTL == 1 */
+
+/*!
+    \brief      read the statistics of the SD disk driver
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sd_diskio_stats_get(sd_diskio_stats_struct *stats)
+{
+    *stats = sd_disk_stats;
+}
@@ -0,0 +1,532 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/*
+	Allocation-free C++20 coroutine runtime.
+
+	Coroutine frames come from a static pool, a failed allocation yields an invalid task instead
+	of touching the heap. Interrupt handlers never resume a coroutine themselves; they complete an
+	event, which hands the waiting coroutine to an ISR-safe ready queue that run() drains in
+	thread context. Timer deadlines and polled peripheral flags are checked by run() as well, and
+	the core sleeps in the port's wait() whenever nothing is runnable.
+
+	Everything hardware specific lives behind async::port, so the runtime builds and runs on the
+	host as well. The GD32 port is async_gd32.cpp, Utilities/host/async_test.cpp ports it to the
+	core model of the host build and checks the order of start, await and resume.
+
+		async::task<> log_and_store() {
+			co_await sd.read(lba, buffer);          // overlaps with ...
+			co_await flash.write(page, buffer);     // ... the previous SPI transfer
+			co_await async::sleep_for(1000);
+		}
+
+		async::spawn(log_and_store());
+		async::run();
+*/
+
+#ifndef ASYNC_FRAME_SIZE
+#define ASYNC_FRAME_SIZE 256
+#endif
+
+#ifndef ASYNC_FRAME_COUNT
+#define ASYNC_FRAME_COUNT 16
+#endif
+
+#ifndef ASYNC_READY_DEPTH
+#define ASYNC_READY_DEPTH 32
+#endif
+
+namespace async {
+	// implemented once per target
+	namespace port {
+		// monotonic time in microseconds, wrapping at 2^32
+		auto now() -> std::uint32_t;
+		// enter a section that excludes interrupt handlers, returns the state to restore
+		auto lock() -> std::uint32_t;
+		auto unlock(std::uint32_t state) -> void;
+		// called with the lock held and nothing runnable; returns once an interrupt is pending
+		// or the deadline passed, spurious returns are allowed
+		auto wait(bool timed, std::uint32_t deadline) -> void;
+	}  // namespace port
+
+	inline auto deadline_reached(std::uint32_t deadline) -> bool {
+		return static_cast<std::int32_t>(port::now() - deadline) >= 0;
+	}
+
+	class critical_section {
+	public:
+		critical_section() : state_(port::lock()) {}
+		~critical_section() {
+			port::unlock(state_);
+		}
+
+		critical_section(const critical_section&) = delete;
+		auto operator=(const critical_section&) -> critical_section& = delete;
+
+	private:
+		std::uint32_t state_;
+	};
+
+	// fixed size blocks for coroutine frames, only used from thread context
+	template <std::size_t BlockSize, std::size_t BlockCount>
+	class frame_pool {
+	public:
+		frame_pool() {
+			for (std::size_t i = 0; i < BlockCount; ++i) {
+				blocks_[i].next = i + 1 < BlockCount ? &blocks_[i + 1] : nullptr;
+			}
+			free_ = &blocks_[0];
+		}
+
+		auto allocate(std::size_t size) noexcept -> void* {
+			if (size > BlockSize || free_ == nullptr) {
+				++failures_;
+				return nullptr;
+			}
+
+			auto* block = free_;
+			free_ = block->next;
+			if (++in_use_ > high_water_) {
+				high_water_ = in_use_;
+			}
+			return block->storage;
+		}
+
+		auto release(void* ptr) noexcept -> void {
+			auto* block = static_cast<block_type*>(ptr);
+			block->next = free_;
+			free_ = block;
+			--in_use_;
+		}
+
+		auto in_use() const noexcept -> std::size_t {
+			return in_use_;
+		}
+		auto high_water() const noexcept -> std::size_t {
+			return high_water_;
+		}
+		auto failures() const noexcept -> std::size_t {
+			return failures_;
+		}
+
+	private:
+		union block_type {
+			block_type* next;
+			alignas(std::max_align_t) unsigned char storage[BlockSize];
+		};
+
+		std::array<block_type, BlockCount> blocks_;
+		block_type* free_ = nullptr;
+		std::size_t in_use_ = 0;
+		std::size_t high_water_ = 0;
+		std::size_t failures_ = 0;
+	};
+
+	// coroutines made runnable by interrupt handlers
+	template <std::size_t Depth>
+	class ready_queue {
+	public:
+		auto push(std::coroutine_handle<> handle) noexcept -> bool {
+			critical_section lock;
+
+			if (count_ == Depth) {
+				++overflows_;
+				return false;
+			}
+			slots_[(head_ + count_) % Depth] = handle;
+			count_ = count_ + 1;
+			return true;
+		}
+
+		auto pop() noexcept -> std::coroutine_handle<> {
+			critical_section lock;
+
+			if (count_ == 0) {
+				return {};
+			}
+			auto handle = slots_[head_];
+			head_ = (head_ + 1) % Depth;
+			count_ = count_ - 1;
+			return handle;
+		}
+
+		// only meaningful with the port lock held
+		auto empty() const noexcept -> bool {
+			return count_ == 0;
+		}
+
+		auto overflows() const noexcept -> std::size_t {
+			return overflows_;
+		}
+
+	private:
+		std::array<std::coroutine_handle<>, Depth> slots_{};
+		std::size_t head_ = 0;
+		volatile std::size_t count_ = 0;
+		std::size_t overflows_ = 0;
+	};
+
+	namespace detail {
+		struct timer_node {
+			std::uint32_t deadline;
+			std::coroutine_handle<> handle;
+			timer_node* next;
+		};
+
+		struct poll_node {
+			auto (*ready)(void*) -> bool;
+			void* context;
+			std::coroutine_handle<> handle;
+			poll_node* next;
+		};
+	}  // namespace detail
+
+	inline frame_pool<ASYNC_FRAME_SIZE, ASYNC_FRAME_COUNT> frames;
+	inline ready_queue<ASYNC_READY_DEPTH> ready;
+
+	namespace detail {
+		inline timer_node* timers = nullptr;
+		inline poll_node* pollers = nullptr;
+
+		struct promise_base {
+			std::coroutine_handle<> continuation{};
+			bool detached = false;
+
+			static auto operator new(std::size_t size) noexcept -> void* {
+				return frames.allocate(size);
+			}
+			static auto operator delete(void* ptr) noexcept -> void {
+				frames.release(ptr);
+			}
+
+			struct final_awaiter {
+				auto await_ready() noexcept -> bool {
+					return false;
+				}
+
+				template <typename Promise>
+				auto await_suspend(std::coroutine_handle<Promise> handle) noexcept -> std::coroutine_handle<> {
+					auto& promise = handle.promise();
+					if (promise.continuation) {
+						return promise.continuation;
+					}
+					if (promise.detached) {
+						handle.destroy();
+					}
+					return std::noop_coroutine();
+				}
+
+				auto await_resume() noexcept -> void {}
+			};
+
+			auto initial_suspend() noexcept -> std::suspend_always {
+				return {};
+			}
+			auto final_suspend() noexcept -> final_awaiter {
+				return {};
+			}
+			auto unhandled_exception() noexcept -> void {
+				std::terminate();
+			}
+		};
+
+		template <typename T>
+		struct promise_result {
+			std::optional<T> value;
+
+			template <typename U>
+			auto return_value(U&& result) -> void {
+				value.emplace(std::forward<U>(result));
+			}
+			auto result() -> T {
+				return std::move(*value);
+			}
+		};
+
+		template <>
+		struct promise_result<void> {
+			auto return_void() noexcept -> void {}
+			auto result() noexcept -> void {}
+		};
+	}  // namespace detail
+
+	// lazily started coroutine; an invalid task signals that the frame pool was exhausted
+	template <typename T = void>
+	class [[nodiscard]] task {
+	public:
+		struct promise_type : detail::promise_base, detail::promise_result<T> {
+			auto get_return_object() noexcept -> task {
+				return task{std::coroutine_handle<promise_type>::from_promise(*this)};
+			}
+			static auto get_return_object_on_allocation_failure() noexcept -> task {
+				return task{};
+			}
+		};
+
+		using handle_type = std::coroutine_handle<promise_type>;
+
+		task() noexcept = default;
+		task(task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+		auto operator=(task&& other) noexcept -> task& {
+			if (this != &other) {
+				reset();
+				handle_ = std::exchange(other.handle_, {});
+			}
+			return *this;
+		}
+		~task() {
+			reset();
+		}
+
+		auto valid() const noexcept -> bool {
+			return static_cast<bool>(handle_);
+		}
+		auto done() const noexcept -> bool {
+			return !handle_ || handle_.done();
+		}
+
+		// start the child and continue the awaiting coroutine once it finished; awaiting an
+		// invalid task is a programming error
+		auto operator co_await() && noexcept {
+			struct awaiter {
+				handle_type handle;
+
+				auto await_ready() noexcept -> bool {
+					return handle.done();
+				}
+				auto await_suspend(std::coroutine_handle<> awaiting) noexcept -> std::coroutine_handle<> {
+					handle.promise().continuation = awaiting;
+					return handle;
+				}
+				auto await_resume() -> T {
+					return handle.promise().result();
+				}
+			};
+
+			if (!handle_) {
+				std::terminate();
+			}
+			return awaiter{handle_};
+		}
+
+		auto release() noexcept -> handle_type {
+			return std::exchange(handle_, {});
+		}
+
+	private:
+		explicit task(handle_type handle) noexcept : handle_(handle) {}
+
+		auto reset() noexcept -> void {
+			if (handle_) {
+				handle_.destroy();
+				handle_ = {};
+			}
+		}
+
+		handle_type handle_{};
+	};
+
+	// hand a coroutine to the ready queue, callable from interrupt handlers
+	inline auto schedule(std::coroutine_handle<> handle) noexcept -> bool {
+		return ready.push(handle);
+	}
+
+	// run a task detached from its creator, its frame is released when it finishes
+	template <typename T>
+	auto spawn(task<T>&& work) noexcept -> bool {
+		auto handle = work.release();
+		if (!handle) {
+			return false;
+		}
+
+		handle.promise().detached = true;
+		if (!schedule(handle)) {
+			handle.destroy();
+			return false;
+		}
+		return true;
+	}
+
+	// single waiter completion signal carrying a status word, set() is ISR-safe and latches when
+	// nobody waits yet
+	class event {
+	public:
+		auto set(std::uint32_t value = 0) noexcept -> void {
+			critical_section lock;
+
+			value_ = value;
+			if (waiter_) {
+				schedule(waiter_);
+				waiter_ = {};
+			} else {
+				set_ = true;
+			}
+		}
+
+		auto reset() noexcept -> void {
+			critical_section lock;
+
+			set_ = false;
+			waiter_ = {};
+		}
+
+		auto is_set() const noexcept -> bool {
+			return set_;
+		}
+
+		auto await_ready() const noexcept -> bool {
+			return false;
+		}
+		auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+			critical_section lock;
+
+			if (set_) {
+				set_ = false;
+				return false;
+			}
+			waiter_ = handle;
+			return true;
+		}
+		auto await_resume() const noexcept -> std::uint32_t {
+			return value_;
+		}
+
+	private:
+		std::coroutine_handle<> waiter_{};
+		volatile std::uint32_t value_ = 0;
+		volatile bool set_ = false;
+	};
+
+	class sleep_awaiter {
+	public:
+		explicit sleep_awaiter(std::uint32_t deadline) noexcept : node_{deadline, {}, nullptr} {}
+
+		auto await_ready() const noexcept -> bool {
+			return deadline_reached(node_.deadline);
+		}
+		auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+			node_.handle = handle;
+
+			// sorted by deadline, equal deadlines resume in order of suspension
+			auto** link = &detail::timers;
+			while (*link != nullptr && static_cast<std::int32_t>((*link)->deadline - node_.deadline) <= 0) {
+				link = &(*link)->next;
+			}
+			node_.next = *link;
+			*link = &node_;
+		}
+		auto await_resume() const noexcept -> void {}
+
+	private:
+		detail::timer_node node_;
+	};
+
+	inline auto sleep_until(std::uint32_t deadline) noexcept -> sleep_awaiter {
+		return sleep_awaiter{deadline};
+	}
+
+	inline auto sleep_for(std::uint32_t microseconds) noexcept -> sleep_awaiter {
+		return sleep_awaiter{port::now() + microseconds};
+	}
+
+	// wait for a condition without an interrupt source, e.g. a peripheral status flag; the
+	// predicate is evaluated on every pass of run(), which does not sleep while pollers wait
+	template <typename Predicate>
+	class until_awaiter {
+	public:
+		explicit until_awaiter(Predicate predicate) : predicate_(std::move(predicate)) {}
+
+		auto await_ready() -> bool {
+			return predicate_();
+		}
+		auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+			node_.context = this;
+			node_.handle = handle;
+			node_.next = detail::pollers;
+			detail::pollers = &node_;
+		}
+		auto await_resume() const noexcept -> void {}
+
+	private:
+		static auto check(void* context) -> bool {
+			return static_cast<until_awaiter*>(context)->predicate_();
+		}
+
+		detail::poll_node node_{&check, nullptr, {}, nullptr};
+		Predicate predicate_;
+	};
+
+	template <typename Predicate>
+	auto until(Predicate predicate) -> until_awaiter<Predicate> {
+		return until_awaiter<Predicate>{std::move(predicate)};
+	}
+
+	// resume at most one coroutine: an interrupt completion first, then an expired timer, then a
+	// satisfied poller; returns false if nothing was runnable
+	inline auto run_once() -> bool {
+		if (auto handle = ready.pop()) {
+			handle.resume();
+			return true;
+		}
+
+		if (detail::timers != nullptr && deadline_reached(detail::timers->deadline)) {
+			auto* node = detail::timers;
+			detail::timers = node->next;
+			node->handle.resume();
+			return true;
+		}
+
+		for (auto** link = &detail::pollers; *link != nullptr; link = &(*link)->next) {
+			auto* node = *link;
+			if (node->ready(node->context)) {
+				*link = node->next;
+				node->handle.resume();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// sleep until something becomes runnable
+	inline auto idle() -> void {
+		critical_section lock;
+
+		if (!ready.empty() || detail::pollers != nullptr) {
+			return;
+		}
+		if (detail::timers != nullptr) {
+			port::wait(true, detail::timers->deadline);
+		} else {
+			port::wait(false, 0);
+		}
+	}
+
+	[[noreturn]] inline auto run() -> void {
+		while (true) {
+			if (!run_once()) {
+				idle();
+			}
+		}
+	}
+
+	// drive the runtime until a condition holds, e.g. a flag set by the last coroutine
+	template <typename Predicate>
+	auto run_until(Predicate done) -> void {
+		while (!done()) {
+			if (!run_once()) {
+				idle();
+			}
+		}
+	}
+}  // namespace async
+
+#endif /* ASYNC_HPP */
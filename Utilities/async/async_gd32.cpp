@@ -0,0 +1,69 @@
+#include "async_gd32.hpp"
+
+#include "timebase.h"
+
+namespace {
+	constexpr std::uint32_t dma_completion_flags = DMA_INT_FLAG_FTF | DMA_INT_FLAG_TAE;
+
+	std::array<std::array<async::event, 8>, 2> dma_events;
+
+	auto dma_index(std::uint32_t dma_periph) -> std::size_t {
+		return dma_periph == DMA0 ? 0 : 1;
+	}
+}  // namespace
+
+auto async::port::now() -> std::uint32_t {
+	return timebase_now_us();
+}
+
+auto async::port::lock() -> std::uint32_t {
+	const auto primask = __get_PRIMASK();
+	__disable_irq();
+	return primask;
+}
+
+auto async::port::unlock(std::uint32_t state) -> void {
+	__set_PRIMASK(state);
+}
+
+auto async::port::wait(bool timed, std::uint32_t deadline) -> void {
+	// PRIMASK is set here, a pending interrupt still ends WFI and is taken after unlock()
+	if (timed) {
+		if (timebase_deadline_reached(deadline)) {
+			return;
+		}
+		timebase_wakeup_set(deadline);
+	}
+	__WFI();
+}
+
+auto async::gd32::dma_event(std::uint32_t dma_periph, dma_channel_enum channel) -> event& {
+	return dma_events[dma_index(dma_periph)][channel];
+}
+
+auto async::gd32::dma_arm(std::uint32_t dma_periph, dma_channel_enum channel) -> event& {
+	auto& done = dma_event(dma_periph, channel);
+
+	done.reset();
+	dma_interrupt_flag_clear(dma_periph, channel, dma_completion_flags);
+	dma_interrupt_enable(dma_periph, channel, DMA_INT_FTF | DMA_INT_TAE);
+	return done;
+}
+
+extern "C" void async_dma_irq_handler(uint32_t dma_periph, dma_channel_enum channelx) {
+	std::uint32_t flags = 0;
+
+	if (dma_interrupt_flag_get(dma_periph, channelx, DMA_INT_FLAG_FTF) != RESET) {
+		flags |= DMA_INT_FLAG_FTF;
+	}
+	if (dma_interrupt_flag_get(dma_periph, channelx, DMA_INT_FLAG_TAE) != RESET) {
+		flags |= DMA_INT_FLAG_TAE;
+	}
+	if (flags == 0) {
+		return;
+	}
+
+	dma_interrupt_flag_clear(dma_periph, channelx, flags);
+	dma_interrupt_disable(dma_periph, channelx, DMA_INT_FTF | DMA_INT_TAE);
+	async::gd32::dma_event(dma_periph, channelx).set(flags);
+}
@@ -0,0 +1,23 @@
+/*!
+    \file    async_gd32.h
+    \brief   interrupt hooks of the coroutine runtime for C interrupt handlers
+*/
+
+#ifndef ASYNC_GD32_H
+#define ASYNC_GD32_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+
+/* function declarations */
+/* complete the DMA event of a channel, call from its DMAx_Channely_IRQHandler */
+void async_dma_irq_handler(uint32_t dma_periph, dma_channel_enum channelx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ASYNC_GD32_H */
@@ -0,0 +1,35 @@
+#ifndef ASYNC_GD32_HPP
+#define ASYNC_GD32_HPP
+
+#include <cstdint>
+
+#include "async.hpp"
+#include "async_gd32.h"
+
+/*
+	GD32F4xx awaitables for the coroutine runtime.
+
+	DMA transfers are armed before the channel is enabled, so a transfer that finishes before the
+	coroutine reaches co_await is not lost:
+
+		auto& done = async::gd32::dma_arm(DMA1, DMA_CH3);
+		dma_channel_enable(DMA1, DMA_CH3);
+		if (co_await done != DMA_INT_FLAG_FTF) { ... }
+
+	DMA1_Channel3_IRQHandler has to call async_dma_irq_handler(DMA1, DMA_CH3).
+*/
+
+namespace async::gd32 {
+	// completion event of a DMA channel, resolves to the interrupt flag that ended the transfer
+	auto dma_event(std::uint32_t dma_periph, dma_channel_enum channel) -> event&;
+
+	// reset the completion event and enable the finish and error interrupts of a channel
+	auto dma_arm(std::uint32_t dma_periph, dma_channel_enum channel) -> event&;
+
+	// wait for a status flag, e.g. async::gd32::flag(SPI_STAT(SPI0), SPI_STAT_TBE)
+	inline auto flag(volatile std::uint32_t& reg, std::uint32_t mask) {
+		return until([&reg, mask] { return (reg & mask) != 0U; });
+	}
+}  // namespace async::gd32
+
+#endif /* ASYNC_GD32_HPP */
@@ -0,0 +1,316 @@
+/*!
+    \file    async_test.cpp
+    \brief   order of start, await and resume of the coroutine runtime of async.hpp
+
+    The port below is async_gd32.cpp on the model of cpu_sim.c: PRIMASK for the lock, the
+    compare line of timebase_sim.c for timed waits and WFI. The interrupt handlers of the tests
+    run on another line of the model, either while the core sleeps in port::wait() or in the
+    middle of a coroutine that spends CPU time, and every step logs itself so the tests can
+    compare the order of the steps with the one the runtime promises.
+*/
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "async.hpp"
+#include "timebase.h"
+#include "timebase_sim.h"
+
+auto async::port::now() -> std::uint32_t {
+	return timebase_now_us();
+}
+
+auto async::port::lock() -> std::uint32_t {
+	const auto primask = __get_PRIMASK();
+	__disable_irq();
+	return primask;
+}
+
+auto async::port::unlock(std::uint32_t state) -> void {
+	__set_PRIMASK(state);
+}
+
+auto async::port::wait(bool timed, std::uint32_t deadline) -> void {
+	if (timed) {
+		if (timebase_deadline_reached(deadline)) {
+			return;
+		}
+		timebase_wakeup_set(deadline);
+	}
+	__WFI();
+}
+
+namespace {
+	// line of cpu_sim.c for the interrupt handlers of the tests
+	constexpr std::uint8_t irq_line = 1;
+	constexpr std::uint32_t isr_us = 1;
+
+	int failures = 0;
+
+	auto check(bool ok, const char* what) -> void {
+		if (!ok) {
+			std::printf("FAIL: %s\n", what);
+			++failures;
+		}
+	}
+
+	// steps as "<who> <what>"
+	std::vector<std::string> steps;
+	bool in_handler = false;
+
+	auto step(const char* who, const char* what) -> void {
+		steps.push_back(std::string(who) + " " + what);
+	}
+
+	auto same_steps(std::vector<std::string> expected) -> bool {
+		if (steps == expected) {
+			return true;
+		}
+		for (const auto& s : steps) {
+			std::printf("  %s\n", s.c_str());
+		}
+		return false;
+	}
+
+	auto interrupt_at(std::uint32_t time, cpu_sim_handler handler) -> void {
+		cpu_sim_handler_set(irq_line, handler);
+		cpu_sim_raise_at(irq_line, time);
+	}
+
+	// coroutines of the running test that did not finish yet
+	int pending = 0;
+
+	auto drive() -> void {
+		async::run_until([] { return pending == 0; });
+	}
+
+	async::event completion;
+
+	auto child(int value) -> async::task<int> {
+		step("child", "start");
+		co_return value * 2;
+	}
+
+	auto parent() -> async::task<> {
+		step("parent", "start");
+		auto work = child(21);
+		step("parent", "created");
+		const auto value = co_await std::move(work);
+		step("parent", value == 42 ? "got 42" : "got other");
+		--pending;
+	}
+
+	// a task runs only once spawned or awaited, a child runs inside the await of its parent
+	auto test_await() -> void {
+		steps.clear();
+		pending = 1;
+		check(async::spawn(parent()), "spawn of the parent");
+		check(steps.empty(), "spawned task runs before run()");
+		drive();
+		check(same_steps({"parent start", "parent created", "child start", "parent got 42"}), "order of a task awaiting a child");
+	}
+
+	auto worker(const char* name) -> async::task<> {
+		step(name, "run");
+		--pending;
+		co_return;
+	}
+
+	// spawned tasks start in the order of spawn()
+	auto test_spawn_order() -> void {
+		steps.clear();
+		pending = 3;
+		check(async::spawn(worker("a")) && async::spawn(worker("b")) && async::spawn(worker("c")), "spawn of three workers");
+		drive();
+		check(same_steps({"a run", "b run", "c run"}), "order of spawned tasks");
+	}
+
+	auto completion_irq() -> void {
+		in_handler = true;
+		step("isr", "set");
+		completion.set(7);
+		in_handler = false;
+	}
+
+	std::uint32_t resumed_at = 0;
+
+	auto waiter() -> async::task<> {
+		step("waiter", "wait");
+		const auto value = co_await completion;
+		check(!in_handler, "coroutine resumed inside the interrupt handler");
+		resumed_at = cpu_sim_now();
+		step("waiter", value == 7 ? "got 7" : "got other");
+		--pending;
+	}
+
+	// the handler only completes the event, the waiter resumes in thread context after it
+	auto test_interrupt_completion() -> void {
+		steps.clear();
+		completion.reset();
+		pending = 1;
+		const auto start = cpu_sim_now();
+		const auto idle = cpu_sim_idle();
+		check(async::spawn(waiter()), "spawn of the waiter");
+		interrupt_at(start + 100, completion_irq);
+		drive();
+		check(same_steps({"waiter wait", "isr set", "waiter got 7"}), "order of a completion from an interrupt");
+		check(resumed_at == start + 100 + isr_us, "waiter resumed right after the interrupt");
+		check(cpu_sim_idle() - idle == 100, "core slept until the interrupt");
+	}
+
+	auto busy_waiter() -> async::task<> {
+		step("busy", "start");
+		cpu_sim_spend(200);
+		step("busy", "await");
+		const auto before = cpu_sim_now();
+		const auto value = co_await completion;
+		check(cpu_sim_now() == before, "await of a latched event suspended");
+		step("busy", value == 9 ? "got 9" : "got other");
+		--pending;
+	}
+
+	auto latch_irq() -> void {
+		step("isr", "set");
+		completion.set(9);
+	}
+
+	// a completion that comes before the await is latched and the await does not suspend
+	auto test_latched_completion() -> void {
+		steps.clear();
+		completion.reset();
+		pending = 1;
+		check(async::spawn(busy_waiter()), "spawn of the busy waiter");
+		interrupt_at(cpu_sim_now() + 50, latch_irq);
+		drive();
+		check(same_steps({"busy start", "isr set", "busy await", "busy got 9"}), "order of a completion before the await");
+	}
+
+	std::array<std::uint32_t, 4> deadlines{};
+	std::array<std::uint32_t, 4> woken{};
+
+	auto sleeper(const char* name, std::size_t index, std::uint32_t delay) -> async::task<> {
+		step(name, "sleep");
+		deadlines[index] = cpu_sim_now() + delay;
+		co_await async::sleep_for(delay);
+		woken[index] = cpu_sim_now();
+		step(name, "wake");
+		--pending;
+	}
+
+	// timers resume in deadline order, equal deadlines in the order they were awaited
+	auto test_sleep_order() -> void {
+		steps.clear();
+		pending = 4;
+		check(async::spawn(sleeper("c", 0, 300)) && async::spawn(sleeper("a", 1, 100)) &&
+				  async::spawn(sleeper("b", 2, 200)) && async::spawn(sleeper("d", 3, 200)),
+			"spawn of four sleepers");
+		drive();
+		check(same_steps({"c sleep", "a sleep", "b sleep", "d sleep", "a wake", "b wake", "d wake", "c wake"}),
+			"order of sleeps");
+		for (std::size_t i = 0; i < deadlines.size(); ++i) {
+			check(woken[i] >= deadlines[i] && woken[i] <= deadlines[i] + isr_us, "sleep woke at its deadline");
+		}
+	}
+
+	auto timed(std::uint32_t deadline) -> async::task<> {
+		co_await async::sleep_until(deadline);
+		step("timer", "wake");
+		--pending;
+	}
+
+	auto completed() -> async::task<> {
+		co_await completion;
+		step("event", "wake");
+		--pending;
+	}
+
+	auto quiet_irq() -> void {
+		completion.set();
+	}
+
+	// an interrupt completion runs before a timer that expired at the same time
+	auto test_ready_before_timer() -> void {
+		steps.clear();
+		completion.reset();
+		pending = 2;
+		const auto at = cpu_sim_now() + 100;
+		check(async::spawn(timed(at)) && async::spawn(completed()), "spawn of timer and event waiter");
+		interrupt_at(at, quiet_irq);
+		drive();
+		check(same_steps({"event wake", "timer wake"}), "order of a completion and a timer due together");
+	}
+
+	volatile bool flag = false;
+
+	auto flag_irq() -> void {
+		flag = true;
+	}
+
+	auto poller() -> async::task<> {
+		// every evaluation stands for a register read of a microsecond
+		co_await async::until([] {
+			cpu_sim_spend(1);
+			return flag;
+		});
+		step("poller", "wake");
+		--pending;
+	}
+
+	// a poller resumes once its condition holds, without an event
+	auto test_poller() -> void {
+		steps.clear();
+		flag = false;
+		pending = 1;
+		const auto start = cpu_sim_now();
+		check(async::spawn(poller()), "spawn of the poller");
+		interrupt_at(start + 100, flag_irq);
+		drive();
+		check(same_steps({"poller wake"}), "poller resumed");
+		check(cpu_sim_now() - start <= 100 + isr_us + 2, "poller resumed within a poll of the flag");
+	}
+
+	// frames come from the pool, an exhausted pool gives invalid tasks and nothing leaks
+	auto test_frame_pool() -> void {
+		std::array<async::task<>, ASYNC_FRAME_COUNT + 1> tasks;
+		const auto failed = async::frames.failures();
+
+		for (auto& t : tasks) {
+			t = worker("pool");
+		}
+		check(tasks[ASYNC_FRAME_COUNT - 1].valid(), "last frame of the pool");
+		check(!tasks[ASYNC_FRAME_COUNT].valid(), "task beyond the pool");
+		check(async::frames.failures() == failed + 1, "failed allocation counted");
+		check(!async::spawn(std::move(tasks[ASYNC_FRAME_COUNT])), "spawn of an invalid task");
+		for (auto& t : tasks) {
+			t = async::task<>{};
+		}
+		check(async::frames.in_use() == 0, "frames released with their tasks");
+	}
+}  // namespace
+
+auto main() -> int {
+	cpu_sim_reset(0xF0000000U, isr_us);
+	timebase_sim_config();
+
+	if (setjmp(cpu_sim_exit) == 0) {
+		test_await();
+		test_spawn_order();
+		test_interrupt_completion();
+		test_latched_completion();
+		test_sleep_order();
+		test_ready_before_timer();
+		test_poller();
+		check(async::frames.in_use() == 0, "frames of finished tasks released");
+		test_frame_pool();
+		std::printf("frame pool high water %zu of %d, ready queue overflows %zu\n", async::frames.high_water(),
+			ASYNC_FRAME_COUNT, async::ready.overflows());
+	} else {
+		check(false, "the model ran out of time with coroutines still waiting");
+	}
+
+	std::printf("%s\n", failures == 0 ? "all checks passed" : "checks failed");
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*!
+    \file    cpu_sim.c
+    \brief   discrete event model of the core for the host builds
+
+    Time only moves when the code under test spends CPU time (cpu_sim_spend()) or sleeps
+    (cpu_sim_wfi()). Each line holds the time of its next event. An event that is due runs the
+    handler of its line after an entry cost, unless PRIMASK is set or another handler runs;
+    WFI ends at the next event of any line, like the core does with PRIMASK set. Reaching the
+    end of the run jumps back to cpu_sim_exit.
+*/
+
+#include <stddef.h>
+
+#include "cpu_sim.h"
+
+uint32_t cpu_sim_primask;
+jmp_buf cpu_sim_exit;
+
+static uint32_t sim_now;
+static uint32_t sim_end;
+static uint32_t sim_isr_us;
+static uint64_t sim_idle;
+static uint32_t sim_interrupts;
+static uint8_t sim_in_handler;
+static uint32_t sim_line_time[CPU_SIM_LINES];
+static cpu_sim_handler sim_line_handler[CPU_SIM_LINES];
+
+/*!
+    \brief      find the line with the earliest event
+    \param[in]  none
+    \param[out] none
+    \retval     line, CPU_SIM_LINES if none is pending
+*/
+static uint8_t sim_next_line(void)
+{
+    uint8_t next = CPU_SIM_LINES;
+    uint8_t i;
+
+    for(i = 0U; i < CPU_SIM_LINES; i++) {
+        if((CPU_SIM_NEVER != sim_line_time[i]) &&
+                ((CPU_SIM_LINES == next) || (sim_line_time[i] < sim_line_time[next]))) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+/*!
+    \brief      end the run once its end is reached
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sim_end_check(void)
+{
+    if(sim_now >= sim_end) {
+        longjmp(cpu_sim_exit, 1);
+    }
+}
+
+/*!
+    \brief      take the interrupt of a line, the event is consumed before the handler runs
+    \param[in]  line: line to take
+    \param[out] none
+    \retval     none
+*/
+static void sim_take(uint8_t line)
+{
+    sim_line_time[line] = CPU_SIM_NEVER;
+    sim_interrupts++;
+    sim_in_handler = 1U;
+    sim_now += sim_isr_us;
+    if(NULL != sim_line_handler[line]) {
+        sim_line_handler[line]();
+    }
+    sim_in_handler = 0U;
+}
+
+/*!
+    \brief      take every interrupt that is due now
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sim_take_due(void)
+{
+    uint8_t line;
+
+    while((0U == cpu_sim_primask) && (0U == sim_in_handler)) {
+        line = sim_next_line();
+        if((CPU_SIM_LINES == line) || (sim_line_time[line] > sim_now)) {
+            break;
+        }
+        sim_take(line);
+    }
+}
+
+/*!
+    \brief      start a run at time 0 that ends at the given time, all lines idle
+    \param[in]  end: end of the run in microseconds
+    \param[in]  isr_us: entry and exit cost of an interrupt
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_reset(uint32_t end, uint32_t isr_us)
+{
+    uint8_t i;
+
+    cpu_sim_primask = 0U;
+    sim_now = 0U;
+    sim_end = end;
+    sim_isr_us = isr_us;
+    sim_idle = 0U;
+    sim_interrupts = 0U;
+    sim_in_handler = 0U;
+    for(i = 0U; i < CPU_SIM_LINES; i++) {
+        sim_line_time[i] = CPU_SIM_NEVER;
+        sim_line_handler[i] = NULL;
+    }
+}
+
+/*!
+    \brief      current time in microseconds
+    \param[in]  none
+    \param[out] none
+    \retval     time since cpu_sim_reset()
+*/
+uint32_t cpu_sim_now(void)
+{
+    return sim_now;
+}
+
+/*!
+    \brief      time slept in WFI so far
+    \param[in]  none
+    \param[out] none
+    \retval     microseconds
+*/
+uint64_t cpu_sim_idle(void)
+{
+    return sim_idle;
+}
+
+/*!
+    \brief      number of interrupts taken so far
+    \param[in]  none
+    \param[out] none
+    \retval     count
+*/
+uint32_t cpu_sim_interrupts(void)
+{
+    return sim_interrupts;
+}
+
+/*!
+    \brief      install the handler of a line
+    \param[in]  line: line number
+    \param[in]  handler: handler run for each event
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_handler_set(uint8_t line, cpu_sim_handler handler)
+{
+    sim_line_handler[line] = handler;
+}
+
+/*!
+    \brief      raise a line at a time, CPU_SIM_NEVER clears it
+    \param[in]  line: line number
+    \param[in]  time: time of the event, an event in the past is due at once
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_raise_at(uint8_t line, uint32_t time)
+{
+    sim_line_time[line] = time;
+}
+
+/*!
+    \brief      write PRIMASK, unmasking takes the interrupts that are due
+    \param[in]  primask: new value
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_primask_set(uint32_t primask)
+{
+    cpu_sim_primask = primask;
+    sim_take_due();
+}
+
+/*!
+    \brief      spend CPU time, interrupts that are due meanwhile run unless masked
+    \param[in]  us: CPU time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_spend(uint32_t us)
+{
+    uint32_t done = sim_now + us;
+    uint32_t start;
+    uint8_t line;
+
+    while((0U == cpu_sim_primask) && (0U == sim_in_handler)) {
+        line = sim_next_line();
+        if((CPU_SIM_LINES == line) || (sim_line_time[line] >= done)) {
+            break;
+        }
+        if(sim_line_time[line] > sim_now) {
+            sim_now = sim_line_time[line];
+        }
+        /* the handler delays the rest of the work by its own time */
+        start = sim_now;
+        sim_take(line);
+        done += sim_now - start;
+    }
+    sim_now = done;
+    sim_end_check();
+}
+
+/*!
+    \brief      sleep until the next event of any line, masked or not
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void cpu_sim_wfi(void)
+{
+    uint8_t line = sim_next_line();
+    uint32_t wake = (CPU_SIM_LINES == line) ? sim_end : sim_line_time[line];
+
+    if(wake > sim_end) {
+        wake = sim_end;
+    }
+    if(wake > sim_now) {
+        sim_idle += wake - sim_now;
+        sim_now = wake;
+    }
+    sim_end_check();
+    sim_take_due();
+}
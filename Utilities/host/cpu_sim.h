@@ -0,0 +1,52 @@
+/*!
+    \file    cpu_sim.h
+    \brief   discrete event model of the core for the host builds: time, PRIMASK, WFI and
+             interrupt lines
+*/
+
+#ifndef CPU_SIM_H
+#define CPU_SIM_H
+
+#include <setjmp.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* interrupt lines of the model, lower lines are taken first when several are due */
+#define CPU_SIM_LINES                   4U
+/* time of a line without a pending event */
+#define CPU_SIM_NEVER                   0xFFFFFFFFU
+
+typedef void (*cpu_sim_handler)(void);
+
+/* PRIMASK of the model, 1 holds back every interrupt */
+extern uint32_t cpu_sim_primask;
+/* the end of the run jumps back here */
+extern jmp_buf cpu_sim_exit;
+
+/* start a run at time 0 that ends at the given time, all lines idle */
+void cpu_sim_reset(uint32_t end, uint32_t isr_us);
+/* current time in microseconds */
+uint32_t cpu_sim_now(void);
+/* time slept in WFI so far */
+uint64_t cpu_sim_idle(void);
+/* number of interrupts taken so far */
+uint32_t cpu_sim_interrupts(void);
+/* install the handler of a line */
+void cpu_sim_handler_set(uint8_t line, cpu_sim_handler handler);
+/* raise a line at a time, CPU_SIM_NEVER clears it, one event per line is pending at most */
+void cpu_sim_raise_at(uint8_t line, uint32_t time);
+/* write PRIMASK, unmasking takes the interrupts that are due */
+void cpu_sim_primask_set(uint32_t primask);
+/* spend CPU time, interrupts that are due meanwhile run unless masked */
+void cpu_sim_spend(uint32_t us);
+/* sleep until the next event of any line, masked or not */
+void cpu_sim_wfi(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CPU_SIM_H */
@@ -0,0 +1,33 @@
+/*!
+    \file    gd32f4xx.h
+    \brief   stand-in of the device header for the host builds, the core intrinsics and the
+             timebase counter map to the model of cpu_sim.c
+*/
+
+#ifndef GD32F4XX_H
+#define GD32F4XX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_sim.h"
+
+#define __IO                            volatile
+
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrStatus;
+
+#define __get_PRIMASK()                 (cpu_sim_primask)
+#define __set_PRIMASK(primask)          cpu_sim_primask_set(primask)
+#define __disable_irq()                 cpu_sim_primask_set(1U)
+#define __enable_irq()                  cpu_sim_primask_set(0U)
+#define __WFI()                         cpu_sim_wfi()
+#define __DMB()                         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/* only used as __CLZ(__RBIT(x)), the index of the lowest set bit of a non-zero value */
+#define __RBIT(value)                   (value)
+#define __CLZ(value)                    ((uint32_t)__builtin_ctz(value))
+
+/* the timebase counter is the time of the model */
+#define TIMER_CNT(timerx)               cpu_sim_now()
+
+#endif /* GD32F4XX_H */
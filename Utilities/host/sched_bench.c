@@ -0,0 +1,388 @@
+/*!
+    \file    sched_bench.c
+    \brief   latency and idle time of the Telnet main loop against the scheduler
+
+    Runs the receive path and the lWIP timers of Examples/ENET/Telnet on the model of
+    cpu_sim.c for a minute of simulated time, in the four ways the example could be built:
+    the former while(1) loop with polled reception and with reception in ENET_IRQHandler(),
+    and scheduler.c with the receive task polled every millisecond and posted by the ENET
+    interrupt. Frames arrive at random with a mean rate, the handlers spend the CPU time of
+    the cost model below. The frame latency is the time from the arrival of a frame to its
+    processing, the timer latency the time from the due time of an lwIP timer to its run.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+#include "timebase_sim.h"
+
+/* cost model in microseconds of a 200MHz core */
+#define ISR_US                          1U              /* interrupt entry, exit and flag handling */
+#define POLL_PASS_US                    1U              /* one pass of the loop without work */
+#define DISPATCH_US                     1U              /* scheduler pick and handler call */
+#define FRAME_US                        20U             /* lwip_frame_recv() of one frame */
+#define TIMER_US                        10U             /* one lwIP timer function */
+
+#define RUN_US                          60000000U
+#define SYSTICK_US                      10000U          /* SYSTEMTICK_PERIOD_MS of the former loop */
+#define ENET_POLL_US                    1000U           /* ENET_RX_POLL_PERIOD_US of main.c */
+#define MAX_FRAMES                      200000U
+
+#define ENET_LINE                       1U
+#define SYSTICK_LINE                    2U
+
+typedef enum {
+    LOOP_POLL = 0,
+    LOOP_IRQ,
+    SCHED_POLL,
+    SCHED_IRQ,
+    VARIANTS
+} variant_enum;
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t sum;
+} latency_struct;
+
+typedef struct {
+    uint32_t interval_ms;
+    uint32_t last_ms;
+    uint32_t runs;
+} lwip_timer_struct;
+
+static const char *const variant_name[VARIANTS] = {
+    "loop, polled",
+    "loop, ENET interrupt",
+    "sched, polled 1ms",
+    "sched, ENET interrupt"
+};
+
+static uint32_t arrival[MAX_FRAMES];
+static uint32_t frames;
+static uint32_t frame_next;
+static uint32_t frame_signaled;
+static variant_enum variant;
+static volatile uint32_t g_localtime;
+static latency_struct frame_latency;
+static latency_struct timer_latency;
+/* TCP_TMR_INTERVAL and ARP_TMR_INTERVAL */
+static lwip_timer_struct timers[2];
+static sched_task_struct enet_rx_task;
+static sched_task_struct lwip_timer_task;
+static uint32_t seed;
+
+/*!
+    \brief      add a sample to a latency record
+    \param[in]  record: record to update
+    \param[in]  latency: sample in microseconds
+    \param[out] none
+    \retval     none
+*/
+static void latency_add(latency_struct *record, uint32_t latency)
+{
+    record->count++;
+    record->sum += latency;
+    if(latency > record->max) {
+        record->max = latency;
+    }
+}
+
+/*!
+    \brief      fill the arrival times of the frames, exponential gaps with the given mean
+    \param[in]  mean_us: mean gap between frames
+    \param[out] none
+    \retval     none
+*/
+static void frames_generate(uint32_t mean_us)
+{
+    double time = 0.0;
+    double uniform;
+
+    frames = 0U;
+    while(frames < MAX_FRAMES) {
+        seed = seed * 1664525U + 1013904223U;
+        uniform = ((double)(seed >> 8) + 1.0) / 16777217.0;
+        time += -(double)mean_us * log(uniform);
+        if(time >= (double)RUN_US) {
+            break;
+        }
+        arrival[frames++] = (uint32_t)time;
+    }
+}
+
+/*!
+    \brief      check whether a received frame waits in the descriptors
+    \param[in]  none
+    \param[out] none
+    \retval     1 if a frame is waiting
+*/
+static uint8_t frame_pending(void)
+{
+    return (uint8_t)((frame_next < frames) && (arrival[frame_next] <= cpu_sim_now()));
+}
+
+/*!
+    \brief      process the oldest waiting frame, stands in for lwip_frame_recv()
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void frame_recv(void)
+{
+    latency_add(&frame_latency, cpu_sim_now() - arrival[frame_next]);
+    frame_next++;
+    cpu_sim_spend(FRAME_US);
+}
+
+/*!
+    \brief      raise the ENET line at the first frame that arrives after now
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void enet_irq_rearm(void)
+{
+    while((frame_signaled < frames) && (arrival[frame_signaled] <= cpu_sim_now())) {
+        frame_signaled++;
+    }
+    cpu_sim_raise_at(ENET_LINE, (frame_signaled < frames) ? arrival[frame_signaled] : CPU_SIM_NEVER);
+}
+
+/*!
+    \brief      ENET interrupt, processes the frames or posts the receive task
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void enet_irq(void)
+{
+    if(LOOP_IRQ == variant) {
+        while(frame_pending()) {
+            frame_recv();
+        }
+    } else {
+        sched_post(&enet_rx_task);
+    }
+    enet_irq_rearm();
+}
+
+/*!
+    \brief      SysTick interrupt of the former loop, advances g_localtime
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void systick_irq(void)
+{
+    g_localtime += SYSTICK_US / 1000U;
+    cpu_sim_raise_at(SYSTICK_LINE, g_localtime * 1000U + SYSTICK_US);
+}
+
+/*!
+    \brief      run the lWIP timers that are due, like lwip_timeouts_check()
+    \param[in]  curtime: time in milliseconds
+    \param[out] none
+    \retval     time in ms until the next timer is due
+*/
+static uint32_t timers_check(uint32_t curtime)
+{
+    uint32_t next = timers[1].interval_ms;
+    uint32_t remaining;
+    uint32_t i;
+
+    for(i = 0U; i < 2U; i++) {
+        if(curtime - timers[i].last_ms >= timers[i].interval_ms) {
+            latency_add(&timer_latency, cpu_sim_now() - (timers[i].last_ms + timers[i].interval_ms) * 1000U);
+            timers[i].last_ms = curtime;
+            timers[i].runs++;
+            cpu_sim_spend(TIMER_US);
+        }
+    }
+
+    for(i = 0U; i < 2U; i++) {
+        remaining = timers[i].interval_ms - (curtime - timers[i].last_ms);
+        if(remaining < next) {
+            next = remaining;
+        }
+    }
+    return next;
+}
+
+/*!
+    \brief      receive task of main.c
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void enet_rx_handler(void *arg)
+{
+    (void)arg;
+    cpu_sim_spend(DISPATCH_US);
+
+    while(frame_pending()) {
+        frame_recv();
+    }
+
+    if(SCHED_POLL == variant) {
+        sched_post_in(&enet_rx_task, ENET_POLL_US);
+    }
+}
+
+/*!
+    \brief      lwIP timer task of main.c
+    \param[in]  arg: unused
+    \param[out] none
+    \retval     none
+*/
+static void lwip_timer_handler(void *arg)
+{
+    uint32_t curtime;
+    uint32_t next_ms;
+
+    (void)arg;
+    cpu_sim_spend(DISPATCH_US);
+
+    curtime = timebase_now_us() / 1000U;
+    next_ms = timers_check(curtime);
+    sched_post_at(&lwip_timer_task, (curtime + next_ms) * 1000U);
+}
+
+/*!
+    \brief      the former main loop, one frame and one timer check per pass
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void loop_run(void)
+{
+    while(1) {
+        cpu_sim_spend(POLL_PASS_US);
+
+        if((LOOP_POLL == variant) && frame_pending()) {
+            frame_recv();
+        }
+
+        timers_check(g_localtime);
+    }
+}
+
+/*!
+    \brief      simulate one variant until the end of the run
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void variant_simulate(void)
+{
+    frame_next = 0U;
+    frame_signaled = 0U;
+    g_localtime = 0U;
+    frame_latency = (latency_struct){0U, 0U, 0U};
+    timer_latency = (latency_struct){0U, 0U, 0U};
+    timers[0] = (lwip_timer_struct){250U, 0U, 0U};
+    timers[1] = (lwip_timer_struct){1000U, 0U, 0U};
+
+    cpu_sim_reset(RUN_US, ISR_US);
+    timebase_sim_config();
+    if((LOOP_IRQ == variant) || (SCHED_IRQ == variant)) {
+        cpu_sim_handler_set(ENET_LINE, enet_irq);
+        enet_irq_rearm();
+    }
+
+    if(0 == setjmp(cpu_sim_exit)) {
+        if(variant < SCHED_POLL) {
+            cpu_sim_handler_set(SYSTICK_LINE, systick_irq);
+            cpu_sim_raise_at(SYSTICK_LINE, SYSTICK_US);
+            loop_run();
+        } else {
+            sched_init();
+            sched_task_init(&enet_rx_task, enet_rx_handler, NULL, 0U);
+            sched_task_init(&lwip_timer_task, lwip_timer_handler, NULL, 1U);
+            sched_post(&enet_rx_task);
+            sched_post(&lwip_timer_task);
+            sched_run();
+        }
+    }
+    cpu_sim_primask = 0U;
+}
+
+/*!
+    \brief      run one variant and print its line of the table
+    \param[in]  none
+    \param[out] none
+    \retval     0 if the checks passed
+*/
+static int variant_run(void)
+{
+    sched_stats_struct stats;
+    uint64_t idle;
+    uint32_t done = 0U;
+    uint32_t expected;
+    int64_t idle_diff = 0;
+    int failed = 0;
+    uint32_t i;
+
+    variant_simulate();
+    idle = cpu_sim_idle();
+
+    /* every frame that arrived well before the end is processed, in order by construction */
+    while((done < frames) && (arrival[done] < RUN_US - 2U * ENET_POLL_US)) {
+        done++;
+    }
+    if(frame_next < done) {
+        printf("%s: %u of %u frames processed\n", variant_name[variant], frame_next, done);
+        failed = 1;
+    }
+
+    /* the timers keep their interval, the scheduler loses less than a millisecond per run */
+    for(i = 0U; i < 2U; i++) {
+        expected = RUN_US / 1000U / timers[i].interval_ms;
+        if((timers[i].runs > expected) || (timers[i].runs + expected / 100U + 2U < expected)) {
+            printf("%s: %u runs of the %u ms timer\n", variant_name[variant], timers[i].runs, timers[i].interval_ms);
+            failed = 1;
+        }
+    }
+
+    /* the idle time of the scheduler matches the sleeps of the model, it also counts the
+       interrupts taken when the sleep ends and misses the sleep cut off by the end of the run */
+    if(variant >= SCHED_POLL) {
+        sched_stats_get(&stats);
+        idle_diff = (int64_t)stats.idle_us - (int64_t)idle;
+        if((idle_diff > (int64_t)cpu_sim_interrupts() * ISR_US) ||
+                (-idle_diff > (int64_t)timers[0].interval_ms * 1000)) {
+            printf("%s: scheduler idle %llu us, model %llu us\n", variant_name[variant],
+                   (unsigned long long)stats.idle_us, (unsigned long long)idle);
+            failed = 1;
+        }
+    }
+
+    printf("%-24s %9.1f %9u %9.1f %9u %7.2f%%\n", variant_name[variant],
+           (double)frame_latency.sum / frame_latency.count, frame_latency.max,
+           (double)timer_latency.sum / timer_latency.count, timer_latency.max,
+           100.0 * (double)idle / RUN_US);
+
+    return failed;
+}
+
+int main(void)
+{
+    static const uint32_t mean_gap[] = {5000U, 500U};
+    int failed = 0;
+    uint32_t i;
+
+    for(i = 0U; i < sizeof(mean_gap) / sizeof(mean_gap[0]); i++) {
+        seed = 12345U;
+        frames_generate(mean_gap[i]);
+
+        printf("\n%u frames/s, %u us per frame\n", 1000000U / mean_gap[i], FRAME_US);
+        printf("%-24s %9s %9s %9s %9s %8s\n", "", "frame avg", "frame max", "timer avg", "timer max", "idle");
+        for(variant = LOOP_POLL; variant < VARIANTS; variant++) {
+            failed |= variant_run();
+        }
+    }
+
+    return failed;
+}
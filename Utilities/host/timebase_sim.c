@@ -0,0 +1,88 @@
+/*!
+    \file    timebase_sim.c
+    \brief   timebase.c for the host builds, the compare wakeup is a line of cpu_sim.c
+*/
+
+#include "timebase.h"
+#include "timebase_sim.h"
+
+static timebase_stats_struct timebase_stats;
+
+/*!
+    \brief      compare match, one-shot like timebase_irq_handler()
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void timebase_sim_compare(void)
+{
+    /* taking the interrupt already cleared the line, the sleeping side re-arms it */
+}
+
+/*!
+    \brief      start the timebase of the model
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_sim_config(void)
+{
+    cpu_sim_handler_set(TIMEBASE_SIM_LINE, timebase_sim_compare);
+    timebase_stats_reset();
+}
+
+/*!
+    \brief      arm the compare wakeup for an absolute deadline
+    \param[in]  deadline: absolute time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_wakeup_set(uint32_t deadline)
+{
+    cpu_sim_raise_at(TIMEBASE_SIM_LINE, deadline);
+}
+
+/*!
+    \brief      record the wake latency of a sleep that ended at its deadline
+    \param[in]  deadline: absolute time in microseconds the sleep waited for
+    \param[out] none
+    \retval     none
+*/
+void timebase_stats_record(uint32_t deadline)
+{
+    uint32_t latency = timebase_now_us() - deadline;
+
+    if((0U == timebase_stats.wakeups) || (latency < timebase_stats.latency_min)) {
+        timebase_stats.latency_min = latency;
+    }
+    if(latency > timebase_stats.latency_max) {
+        timebase_stats.latency_max = latency;
+    }
+    timebase_stats.latency_sum += latency;
+    timebase_stats.wakeups++;
+}
+
+/*!
+    \brief      read the wake latency statistics
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void timebase_stats_get(timebase_stats_struct *stats)
+{
+    *stats = timebase_stats;
+}
+
+/*!
+    \brief      reset the wake latency statistics
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_stats_reset(void)
+{
+    timebase_stats.wakeups = 0U;
+    timebase_stats.latency_min = 0U;
+    timebase_stats.latency_max = 0U;
+    timebase_stats.latency_sum = 0U;
+}
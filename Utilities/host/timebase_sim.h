@@ -0,0 +1,23 @@
+/*!
+    \file    timebase_sim.h
+    \brief   timebase of the host builds
+*/
+
+#ifndef TIMEBASE_SIM_H
+#define TIMEBASE_SIM_H
+
+/* line of cpu_sim.c that carries the compare wakeup */
+#define TIMEBASE_SIM_LINE               0U
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* start the timebase of the model, after cpu_sim_reset() */
+void timebase_sim_config(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEBASE_SIM_H */
@@ -0,0 +1,345 @@
+/*!
+    \file    scheduler.c
+    \brief   event-driven run-to-completion scheduler on top of the timebase
+
+    Ready tasks wait in one FIFO per priority, a bit mask tracks the non-empty queues so the
+    most urgent one is found with a single CLZ. Timed posts are kept in a list sorted by
+    deadline whose head arms the timebase compare while the core sleeps in WFI. Queue and list
+    updates are short PRIMASK critical sections, which makes every post ISR-safe.
+*/
+
+#include "scheduler.h"
+
+typedef struct {
+    sched_task_struct *head;
+    sched_task_struct *tail;
+} sched_queue_struct;
+
+static sched_queue_struct sched_ready[SCHED_PRIORITIES];
+static volatile uint32_t sched_ready_mask;
+static sched_task_struct *sched_timers;
+static sched_stats_struct sched_stats;
+
+/*!
+    \brief    append a task to its ready queue, interrupts must be masked
+    \param[in]  task: task to queue
+    \param[in]  post_time: time the task became ready
+    \param[out] none
+    \retval     none
+*/
+static void sched_ready_push(sched_task_struct *task, uint32_t post_time)
+{
+    sched_queue_struct *queue = &sched_ready[task->priority];
+
+    if(task->ready) {
+        return;
+    }
+
+    task->ready = 1U;
+    task->post_time = post_time;
+    task->next = NULL;
+    if(NULL == queue->tail) {
+        queue->head = task;
+    } else {
+        queue->tail->next = task;
+    }
+    queue->tail = task;
+    sched_ready_mask |= (1UL << task->priority);
+}
+
+/*!
+    \brief    remove a task from the deadline list, interrupts must be masked
+    \param[in]  task: task to remove
+    \param[out] none
+    \retval     none
+*/
+static void sched_timer_remove(sched_task_struct *task)
+{
+    sched_task_struct **link = &sched_timers;
+
+    while(NULL != *link) {
+        if(task == *link) {
+            *link = task->timer_next;
+            break;
+        }
+        link = &(*link)->timer_next;
+    }
+    task->timed = 0U;
+}
+
+/*!
+    \brief    move all tasks whose deadline passed to their ready queues
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sched_timers_expire(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    sched_task_struct *task;
+
+    __disable_irq();
+    while((NULL != sched_timers) && timebase_deadline_reached(sched_timers->deadline)) {
+        task = sched_timers;
+        sched_timers = task->timer_next;
+        task->timed = 0U;
+        /* latency of a timed task counts from its deadline */
+        sched_ready_push(task, task->deadline);
+    }
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    sleep until an interrupt or the earliest deadline
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void sched_idle(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t start = timebase_now_us();
+    uint32_t deadline;
+
+    /* a post between the check and WFI leaves its interrupt pending, which ends WFI at once */
+    __disable_irq();
+    if(0U == sched_ready_mask) {
+        if(NULL == sched_timers) {
+            __WFI();
+        } else if(!timebase_deadline_reached(sched_timers->deadline)) {
+            deadline = sched_timers->deadline;
+            timebase_wakeup_set(deadline);
+            __WFI();
+            /* woken by the compare match, not by an earlier interrupt */
+            if(timebase_deadline_reached(deadline)) {
+                timebase_stats_record(deadline);
+            }
+        }
+    }
+    __set_PRIMASK(primask);
+
+    sched_stats.idle_us += timebase_now_us() - start;
+    sched_stats.wakeups++;
+}
+
+/*!
+    \brief    reset the scheduler
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sched_init(void)
+{
+    uint32_t i;
+
+    for(i = 0U; i < SCHED_PRIORITIES; i++) {
+        sched_ready[i].head = NULL;
+        sched_ready[i].tail = NULL;
+    }
+    sched_ready_mask = 0U;
+    sched_timers = NULL;
+
+    sched_stats.idle_us = 0U;
+    sched_stats.busy_us = 0U;
+    sched_stats.dispatches = 0U;
+    sched_stats.wakeups = 0U;
+}
+
+/*!
+    \brief    initialize a task
+    \param[in]  task: task to initialize
+    \param[in]  handler: function run for each post
+    \param[in]  arg: argument handed to the handler
+    \param[in]  priority: 0 .. SCHED_PRIORITIES - 1, lower is more urgent
+    \param[out] none
+    \retval     none
+*/
+void sched_task_init(sched_task_struct *task, sched_handler handler, void *arg, uint8_t priority)
+{
+    task->handler = handler;
+    task->arg = arg;
+    task->priority = (priority < SCHED_PRIORITIES) ? priority : (uint8_t)(SCHED_PRIORITIES - 1U);
+    task->ready = 0U;
+    task->timed = 0U;
+    task->deadline = 0U;
+    task->post_time = 0U;
+    task->next = NULL;
+    task->timer_next = NULL;
+    task->runs = 0U;
+    task->latency_max = 0U;
+    task->latency_sum = 0U;
+}
+
+/*!
+    \brief    make a task ready, callable from interrupts
+    \param[in]  task: task to post, posting an already ready task has no effect
+    \param[out] none
+    \retval     none
+*/
+void sched_post(sched_task_struct *task)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    sched_ready_push(task, timebase_now_us());
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    make a task ready at an absolute timebase deadline, callable from interrupts
+    \param[in]  task: task to post, replaces a pending deadline of the same task
+    \param[in]  deadline: absolute time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void sched_post_at(sched_task_struct *task, uint32_t deadline)
+{
+    uint32_t primask = __get_PRIMASK();
+    sched_task_struct **link = &sched_timers;
+
+    __disable_irq();
+    if(task->timed) {
+        sched_timer_remove(task);
+    }
+
+    /* keep the list sorted, equal deadlines run in posting order */
+    while((NULL != *link) && ((int32_t)((*link)->deadline - deadline) <= 0)) {
+        link = &(*link)->timer_next;
+    }
+    task->deadline = deadline;
+    task->timer_next = *link;
+    task->timed = 1U;
+    *link = task;
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    make a task ready after a time in microseconds, callable from interrupts
+    \param[in]  task: task to post
+    \param[in]  delay_us: delay in microseconds, below 2^31
+    \param[out] none
+    \retval     none
+*/
+void sched_post_in(sched_task_struct *task, uint32_t delay_us)
+{
+    sched_post_at(task, timebase_deadline_us(delay_us));
+}
+
+/*!
+    \brief    remove a task from the ready queue and the deadline list
+    \param[in]  task: task to cancel
+    \param[out] none
+    \retval     none
+*/
+void sched_cancel(sched_task_struct *task)
+{
+    uint32_t primask = __get_PRIMASK();
+    sched_queue_struct *queue = &sched_ready[task->priority];
+    sched_task_struct *prev = NULL;
+    sched_task_struct *cur;
+
+    __disable_irq();
+    if(task->timed) {
+        sched_timer_remove(task);
+    }
+
+    if(task->ready) {
+        for(cur = queue->head; NULL != cur; prev = cur, cur = cur->next) {
+            if(task == cur) {
+                if(NULL == prev) {
+                    queue->head = cur->next;
+                } else {
+                    prev->next = cur->next;
+                }
+                if(queue->tail == cur) {
+                    queue->tail = prev;
+                }
+                break;
+            }
+        }
+        if(NULL == queue->head) {
+            sched_ready_mask &= ~(1UL << task->priority);
+        }
+        task->ready = 0U;
+    }
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    run one ready task
+    \param[in]  none
+    \param[out] none
+    \retval     1 if a task was run, 0 if none was ready
+*/
+uint8_t sched_run_once(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    sched_queue_struct *queue;
+    sched_task_struct *task;
+    uint32_t start;
+    uint32_t latency;
+
+    sched_timers_expire();
+
+    __disable_irq();
+    if(0U == sched_ready_mask) {
+        __set_PRIMASK(primask);
+        return 0U;
+    }
+
+    queue = &sched_ready[__CLZ(__RBIT(sched_ready_mask))];
+    task = queue->head;
+    queue->head = task->next;
+    if(NULL == queue->head) {
+        queue->tail = NULL;
+        sched_ready_mask &= ~(1UL << task->priority);
+    }
+    /* cleared before the run so the handler or an interrupt may post the task again */
+    task->ready = 0U;
+    __set_PRIMASK(primask);
+
+    start = timebase_now_us();
+    latency = start - task->post_time;
+    if(latency > task->latency_max) {
+        task->latency_max = latency;
+    }
+    task->latency_sum += latency;
+
+    task->handler(task->arg);
+
+    task->runs++;
+    sched_stats.busy_us += timebase_now_us() - start;
+    sched_stats.dispatches++;
+
+    return 1U;
+}
+
+/*!
+    \brief    run the scheduler, sleeps whenever no task is ready
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sched_run(void)
+{
+    while(1) {
+        if(0U == sched_run_once()) {
+            sched_idle();
+        }
+    }
+}
+
+/*!
+    \brief    read the scheduler statistics
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void sched_stats_get(sched_stats_struct *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = sched_stats;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,71 @@
+/*!
+    \file    scheduler.h
+    \brief   event-driven run-to-completion scheduler on top of the timebase
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+#include "timebase.h"
+
+/* number of priority levels, 0 is the most urgent one */
+#ifndef SCHED_PRIORITIES
+#define SCHED_PRIORITIES                4U
+#endif /* SCHED_PRIORITIES */
+
+typedef void (*sched_handler)(void *arg);
+
+/* a task is a handler that runs to completion once per post, the struct is owned by the application */
+typedef struct sched_task {
+    sched_handler handler;                              /*!< function run for each post */
+    void *arg;                                          /*!< argument handed to the handler */
+    uint8_t priority;                                   /*!< ready queue, lower is more urgent */
+    volatile uint8_t ready;                             /*!< queued for execution */
+    volatile uint8_t timed;                             /*!< waiting in the deadline list */
+    uint32_t deadline;                                  /*!< timebase deadline while timed */
+    uint32_t post_time;                                 /*!< timebase time the task became ready */
+    struct sched_task *next;                            /*!< ready queue link */
+    struct sched_task *timer_next;                      /*!< deadline list link */
+    uint32_t runs;                                      /*!< number of completed runs */
+    uint32_t latency_max;                               /*!< longest time from ready to run in us */
+    uint64_t latency_sum;                               /*!< sum of all ready to run times in us */
+} sched_task_struct;
+
+/* scheduler wide statistics */
+typedef struct {
+    uint64_t idle_us;                                   /*!< time spent sleeping */
+    uint64_t busy_us;                                   /*!< time spent in task handlers */
+    uint32_t dispatches;                                /*!< number of task runs */
+    uint32_t wakeups;                                   /*!< number of idle sleeps */
+} sched_stats_struct;
+
+/* function declarations */
+/* reset the scheduler */
+void sched_init(void);
+/* initialize a task */
+void sched_task_init(sched_task_struct *task, sched_handler handler, void *arg, uint8_t priority);
+/* make a task ready, callable from interrupts */
+void sched_post(sched_task_struct *task);
+/* make a task ready at an absolute timebase deadline, callable from interrupts */
+void sched_post_at(sched_task_struct *task, uint32_t deadline);
+/* make a task ready after a time in microseconds, callable from interrupts */
+void sched_post_in(sched_task_struct *task, uint32_t delay_us);
+/* remove a task from the ready queue and the deadline list */
+void sched_cancel(sched_task_struct *task);
+/* run one ready task */
+uint8_t sched_run_once(void);
+/* run the scheduler, sleeps whenever no task is ready */
+void sched_run(void);
+/* read the scheduler statistics */
+void sched_stats_get(sched_stats_struct *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEDULER_H */
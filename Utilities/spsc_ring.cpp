@@ -0,0 +1,168 @@
+/*!
+    \file    spsc_ring.cpp
+    \brief   lock-free single-producer single-consumer ring for C drivers
+
+    The C interface of spsc_ring.h over the index handling of SpscRing<T, N> in spsc_ring.hpp,
+    with items of a size set at run time on application supplied storage. spsc_ring_init()
+    constructs the ring in the spsc_ring_struct of the caller, every other function works on
+    that object.
+*/
+
+#include "spsc_ring.h"
+
+#include <new>
+
+#include "spsc_ring.hpp"
+
+namespace {
+	using byte_ring = spsc_detail::ring<spsc_detail::byte_slots>;
+
+	// only constructs the ring, the rest of the interface is the one of spsc_detail::ring
+	class c_ring : public byte_ring {
+	public:
+		c_ring(void* buffer, std::uint32_t item_size, std::uint32_t item_count) {
+			slots_.assign(buffer, item_size, item_count);
+		}
+	};
+
+	static_assert(sizeof(c_ring) == sizeof(spsc_ring_struct), "spsc_ring_struct has to hold the ring");
+	static_assert(alignof(c_ring) <= alignof(spsc_ring_struct), "spsc_ring_struct has to hold the ring");
+	static_assert(std::is_standard_layout_v<c_ring>);
+
+	auto as_ring(spsc_ring_struct* ring) -> c_ring* {
+		return std::launder(reinterpret_cast<c_ring*>(ring));
+	}
+
+	auto as_ring(const spsc_ring_struct* ring) -> const c_ring* {
+		return std::launder(reinterpret_cast<const c_ring*>(ring));
+	}
+}  // namespace
+
+/*!
+    \brief    initialize a ring on application supplied storage
+    \param[in]  ring: ring to initialize
+    \param[in]  buffer: storage of item_size * item_count bytes
+    \param[in]  item_size: size of one item in bytes
+    \param[in]  item_count: number of items, a power of two of at least 2
+    \param[out] none
+    \retval     ErrStatus: SUCCESS or ERROR
+*/
+extern "C" ErrStatus spsc_ring_init(spsc_ring_struct *ring, void *buffer, uint32_t item_size, uint32_t item_count)
+{
+	if ((buffer == nullptr) || (item_size == 0) || (item_count < 2) || ((item_count & (item_count - 1)) != 0)) {
+		return ERROR;
+	}
+
+	new (ring) c_ring(buffer, item_size, item_count);
+	return SUCCESS;
+}
+
+/*!
+    \brief    number of items in the ring, a snapshot when called from the producer
+    \param[in]  ring: ring to check
+    \param[out] none
+    \retval     number of items
+*/
+extern "C" uint32_t spsc_ring_count(const spsc_ring_struct *ring)
+{
+	return as_ring(ring)->size();
+}
+
+/*!
+    \brief    number of free items, a snapshot when called from the consumer
+    \param[in]  ring: ring to check
+    \param[out] none
+    \retval     number of free items
+*/
+extern "C" uint32_t spsc_ring_free(const spsc_ring_struct *ring)
+{
+	return as_ring(ring)->free();
+}
+
+/*!
+    \brief    drop all items, neither side may be active
+    \param[in]  ring: ring to reset
+    \param[out] none
+    \retval     none
+*/
+extern "C" void spsc_ring_reset(spsc_ring_struct *ring)
+{
+	as_ring(ring)->reset();
+}
+
+/*!
+    \brief    append items, producer side
+    \param[in]  ring: ring to write
+    \param[in]  data: items to copy
+    \param[in]  count: number of items
+    \param[out] none
+    \retval     number of items written, less than count if the ring is full
+*/
+extern "C" uint32_t spsc_ring_write(spsc_ring_struct *ring, const void *data, uint32_t count)
+{
+	return as_ring(ring)->push(data, count);
+}
+
+/*!
+    \brief    get the contiguous free region, producer side
+    \param[in]  ring: ring to write
+    \param[out] count: number of items that fit the region, may be less than the free space at the wrap
+    \retval     start of the region
+*/
+extern "C" void *spsc_ring_write_span(spsc_ring_struct *ring, uint32_t *count)
+{
+	const auto span = as_ring(ring)->write_span();
+
+	*count = span.size;
+	return span.data;
+}
+
+/*!
+    \brief    publish items written through spsc_ring_write_span(), producer side
+    \param[in]  ring: ring to write
+    \param[in]  count: number of items written
+    \param[out] none
+    \retval     none
+*/
+extern "C" void spsc_ring_commit(spsc_ring_struct *ring, uint32_t count)
+{
+	as_ring(ring)->commit(count);
+}
+
+/*!
+    \brief    remove items, consumer side
+    \param[in]  ring: ring to read
+    \param[in]  count: number of items requested
+    \param[out] data: copied items
+    \retval     number of items read, less than count if the ring runs empty
+*/
+extern "C" uint32_t spsc_ring_read(spsc_ring_struct *ring, void *data, uint32_t count)
+{
+	return as_ring(ring)->pop(data, count);
+}
+
+/*!
+    \brief    get the contiguous used region, consumer side
+    \param[in]  ring: ring to read
+    \param[out] count: number of items in the region, may be less than the ring count at the wrap
+    \retval     start of the region
+*/
+extern "C" const void *spsc_ring_read_span(spsc_ring_struct *ring, uint32_t *count)
+{
+	const auto span = as_ring(ring)->read_span();
+
+	*count = span.size;
+	return span.data;
+}
+
+/*!
+    \brief    release items read through spsc_ring_read_span(), consumer side
+    \param[in]  ring: ring to read
+    \param[in]  count: number of items consumed
+    \param[out] none
+    \retval     none
+*/
+extern "C" void spsc_ring_consume(spsc_ring_struct *ring, uint32_t count)
+{
+	as_ring(ring)->consume(count);
+}
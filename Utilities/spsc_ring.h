@@ -0,0 +1,51 @@
+/*!
+    \file    spsc_ring.h
+    \brief   lock-free single-producer single-consumer ring for C drivers
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+
+/* ring of fixed size items, the storage is supplied by the application; the fields belong to
+   spsc_ring.cpp, which keeps the ring of spsc_ring.hpp in this struct */
+typedef struct {
+    uint8_t *buffer;                                    /*!< item_count * item_size bytes */
+    uint32_t item_size;                                 /*!< size of one item in bytes */
+    uint32_t mask;                                      /*!< item_count - 1, item_count is a power of two */
+    uint32_t head;                                      /*!< free-running write index, producer only */
+    uint32_t tail;                                      /*!< free-running read index, consumer only */
+} spsc_ring_struct;
+
+/* function declarations */
+/* initialize a ring on application supplied storage */
+ErrStatus spsc_ring_init(spsc_ring_struct *ring, void *buffer, uint32_t item_size, uint32_t item_count);
+/* number of items in the ring, a snapshot when called from the producer */
+uint32_t spsc_ring_count(const spsc_ring_struct *ring);
+/* number of free items, a snapshot when called from the consumer */
+uint32_t spsc_ring_free(const spsc_ring_struct *ring);
+/* drop all items, neither side may be active */
+void spsc_ring_reset(spsc_ring_struct *ring);
+/* append items, producer side */
+uint32_t spsc_ring_write(spsc_ring_struct *ring, const void *data, uint32_t count);
+/* get the contiguous free region, producer side */
+void *spsc_ring_write_span(spsc_ring_struct *ring, uint32_t *count);
+/* publish items written through spsc_ring_write_span(), producer side */
+void spsc_ring_commit(spsc_ring_struct *ring, uint32_t count);
+/* remove items, consumer side */
+uint32_t spsc_ring_read(spsc_ring_struct *ring, void *data, uint32_t count);
+/* get the contiguous used region, consumer side */
+const void *spsc_ring_read_span(spsc_ring_struct *ring, uint32_t *count);
+/* release items read through spsc_ring_read_span(), consumer side */
+void spsc_ring_consume(spsc_ring_struct *ring, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPSC_RING_H */
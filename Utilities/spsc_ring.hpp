@@ -0,0 +1,255 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+	Lock-free single-producer single-consumer ring for handing data from an interrupt handler to
+	thread context or the other way round.
+
+	Head and tail are free-running 32 bit indices, only the producer writes the head and only the
+	consumer writes the tail, so neither side ever masks interrupts. The producer publishes
+	elements with a release store of the head that the consumer reads with acquire, and the
+	consumer hands slots back the same way through the tail. On the Cortex-M4 both compile to a
+	plain LDR/STR paired with a DMB.
+
+	write_span()/commit() and read_span()/consume() expose the contiguous part of the free or used
+	region, a DMA channel can fill the ring directly:
+
+		SpscRing<std::uint8_t, 512> rx;
+
+		auto span = rx.write_span();
+		dma_memory_address_config(DMA1, DMA_CH2, DMA_MEMORY_0, reinterpret_cast<std::uint32_t>(span.data));
+		dma_transfer_number_config(DMA1, DMA_CH2, span.size);
+		...
+		rx.commit(span.size - dma_transfer_number_get(DMA1, DMA_CH2));
+
+	spsc_detail::ring holds the index handling once. SpscRing gives it a typed array of constant
+	size, the C interface of spsc_ring.h wraps it around items of a size set at run time on
+	application supplied storage (spsc_ring.cpp).
+*/
+
+template<typename T>
+struct SpscSpan {
+	T* data;
+	std::uint32_t size;
+};
+
+namespace spsc_detail {
+	// slots of SpscRing, the capacity is a constant
+	template<typename T, std::size_t N>
+	class array_slots {
+	public:
+		using pointer = T*;
+		using const_pointer = const T*;
+
+		static constexpr auto capacity() -> std::uint32_t {
+			return static_cast<std::uint32_t>(N);
+		}
+
+		auto slot(std::uint32_t index) -> T* {
+			return &buffer_[index];
+		}
+
+		auto slot(std::uint32_t index) const -> const T* {
+			return &buffer_[index];
+		}
+
+		// copy count elements from data[offset] on into the slots from index on
+		auto copy_in(std::uint32_t index, const T* data, std::uint32_t offset, std::uint32_t count) -> void {
+			std::copy_n(data + offset, count, &buffer_[index]);
+		}
+
+		// copy count elements from the slots from index on to data[offset] on
+		auto copy_out(std::uint32_t index, T* data, std::uint32_t offset, std::uint32_t count) const -> void {
+			std::copy_n(&buffer_[index], count, data + offset);
+		}
+
+	private:
+		// word alignment lets DMA use 32 bit memory accesses on byte rings
+		alignas(std::max(alignof(T), alignof(std::uint32_t))) std::array<T, N> buffer_{};
+	};
+
+	// slots of the C interface, items of a size set at run time on application supplied storage
+	class byte_slots {
+	public:
+		using pointer = void*;
+		using const_pointer = const void*;
+
+		auto assign(void* buffer, std::uint32_t item_size, std::uint32_t item_count) -> void {
+			buffer_ = static_cast<std::uint8_t*>(buffer);
+			item_size_ = item_size;
+			mask_ = item_count - 1;
+		}
+
+		auto capacity() const -> std::uint32_t {
+			return mask_ + 1;
+		}
+
+		auto slot(std::uint32_t index) -> void* {
+			return buffer_ + index * item_size_;
+		}
+
+		auto slot(std::uint32_t index) const -> const void* {
+			return buffer_ + index * item_size_;
+		}
+
+		auto copy_in(std::uint32_t index, const void* data, std::uint32_t offset, std::uint32_t count) -> void {
+			std::memcpy(buffer_ + index * item_size_, static_cast<const std::uint8_t*>(data) + offset * item_size_,
+				count * item_size_);
+		}
+
+		auto copy_out(std::uint32_t index, void* data, std::uint32_t offset, std::uint32_t count) const -> void {
+			std::memcpy(static_cast<std::uint8_t*>(data) + offset * item_size_, buffer_ + index * item_size_,
+				count * item_size_);
+		}
+
+	private:
+		std::uint8_t* buffer_ = nullptr;
+		std::uint32_t item_size_ = 0;
+		std::uint32_t mask_ = 0;
+	};
+
+	// the index handling of both, Slots supplies the storage and the power of two capacity
+	template<typename Slots>
+	class ring {
+		static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+
+	public:
+		using size_type = std::uint32_t;
+		using pointer = typename Slots::pointer;
+		using const_pointer = typename Slots::const_pointer;
+		using span_type = SpscSpan<std::remove_pointer_t<pointer>>;
+		using const_span_type = SpscSpan<std::remove_pointer_t<const_pointer>>;
+
+		auto capacity() const -> size_type {
+			return slots_.capacity();
+		}
+
+		// both sides: snapshots, exact only when called from the side that would be blocked
+		auto size() const -> size_type {
+			return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+		}
+
+		auto free() const -> size_type {
+			return capacity() - size();
+		}
+
+		auto empty() const -> bool {
+			return size() == 0;
+		}
+
+		auto full() const -> bool {
+			return size() == capacity();
+		}
+
+		// drops all elements, neither side may be active
+		auto reset() -> void {
+			head_.store(0, std::memory_order_relaxed);
+			tail_.store(0, std::memory_order_relaxed);
+		}
+
+		// producer side: copies as many elements as fit, returns the number pushed
+		auto push(const_pointer data, size_type count) -> size_type {
+			const auto head = head_.load(std::memory_order_relaxed);
+			const auto space = capacity() - (head - tail_.load(std::memory_order_acquire));
+			const auto offset = head & (capacity() - 1);
+
+			count = std::min(count, space);
+
+			const auto first = std::min(count, capacity() - offset);
+			slots_.copy_in(offset, data, 0, first);
+			slots_.copy_in(0, data, first, count - first);
+
+			head_.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		// contiguous free region starting at the head, may be shorter than free() at the wrap
+		auto write_span() -> span_type {
+			const auto head = head_.load(std::memory_order_relaxed);
+			const auto space = capacity() - (head - tail_.load(std::memory_order_acquire));
+			const auto offset = head & (capacity() - 1);
+
+			return {slots_.slot(offset), std::min(space, capacity() - offset)};
+		}
+
+		// publish elements written through write_span()
+		auto commit(size_type count) -> void {
+			head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+		}
+
+		// consumer side: copies as many elements as are available, returns the number popped
+		auto pop(pointer data, size_type count) -> size_type {
+			const auto tail = tail_.load(std::memory_order_relaxed);
+			const auto used = head_.load(std::memory_order_acquire) - tail;
+			const auto offset = tail & (capacity() - 1);
+
+			count = std::min(count, used);
+
+			const auto first = std::min(count, capacity() - offset);
+			slots_.copy_out(offset, data, 0, first);
+			slots_.copy_out(0, data, first, count - first);
+
+			tail_.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		// contiguous used region starting at the tail, may be shorter than size() at the wrap
+		auto read_span() const -> const_span_type {
+			const auto tail = tail_.load(std::memory_order_relaxed);
+			const auto used = head_.load(std::memory_order_acquire) - tail;
+			const auto offset = tail & (capacity() - 1);
+
+			return {slots_.slot(offset), std::min(used, capacity() - offset)};
+		}
+
+		// release elements read through read_span()
+		auto consume(size_type count) -> void {
+			tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+		}
+
+	protected:
+		Slots slots_;
+		std::atomic<size_type> head_{0};
+		std::atomic<size_type> tail_{0};
+	};
+}  // namespace spsc_detail
+
+template<typename T, std::size_t N>
+class SpscRing : public spsc_detail::ring<spsc_detail::array_slots<T, N>> {
+	static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size has to be a power of two");
+	static_assert(N <= (std::size_t{1} << 31), "ring size has to fit the index distance");
+	static_assert(std::is_trivially_copyable_v<T>, "elements are copied as raw memory");
+
+	using base = spsc_detail::ring<spsc_detail::array_slots<T, N>>;
+
+public:
+	using typename base::size_type;
+	using base::pop;
+	using base::push;
+
+	static constexpr size_type mask = static_cast<size_type>(N - 1);
+
+	static constexpr auto capacity() -> size_type {
+		return static_cast<size_type>(N);
+	}
+
+	// producer side
+	auto push(const T& value) -> bool {
+		return push(&value, 1) == 1;
+	}
+
+	// consumer side
+	auto pop(T& value) -> bool {
+		return pop(&value, 1) == 1;
+	}
+};
+
+#endif /* SPSC_RING_HPP */
@@ -0,0 +1,289 @@
+/*!
+    \file    timebase.c
+    \brief   tickless microsecond timebase on a free-running 32 bit timer
+
+    The timer counts microseconds over its full 32 bit range. Delays program the channel 0
+    compare value to the deadline and sleep with WFI until the match interrupt, so the core
+    does not spin and SysTick is not needed.
+*/
+
+#include "timebase.h"
+
+/* largest sleep that is requested at once, keeps deadlines well inside the 2^31 us window */
+#define TIMEBASE_MAX_SLEEP_US           1000000U
+
+static volatile uint32_t timebase_overflows;
+static timebase_stats_struct timebase_stats;
+
+/*!
+    \brief    get the clock frequency of the timebase timer
+    \param[in]  none
+    \param[out] none
+    \retval     timer clock in Hz
+*/
+static uint32_t timebase_timer_clock_get(void)
+{
+    uint32_t apb1_psc = RCU_CFG0 & RCU_CFG0_APB1PSC;
+
+    if(RCU_CFG1 & RCU_CFG1_TIMERSEL) {
+        /* timers run on CK_AHB as long as APB1 is divided by 4 at most */
+        if(apb1_psc <= RCU_APB1_CKAHB_DIV4) {
+            return rcu_clock_freq_get(CK_AHB);
+        }
+        return rcu_clock_freq_get(CK_APB1) * 4U;
+    }
+
+    if(apb1_psc < RCU_APB1_CKAHB_DIV2) {
+        return rcu_clock_freq_get(CK_APB1);
+    }
+    return rcu_clock_freq_get(CK_APB1) * 2U;
+}
+
+/*!
+    \brief    start the free-running timebase timer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_config(void)
+{
+    timer_parameter_struct timer_initpara;
+
+    rcu_periph_clock_enable(TIMEBASE_TIMER_CLK);
+    timer_deinit(TIMEBASE_TIMER);
+
+    timer_struct_para_init(&timer_initpara);
+    timer_initpara.prescaler         = (uint16_t)(timebase_timer_clock_get() / TIMEBASE_FREQUENCY - 1U);
+    timer_initpara.alignedmode       = TIMER_COUNTER_EDGE;
+    timer_initpara.counterdirection  = TIMER_COUNTER_UP;
+    timer_initpara.period            = 0xFFFFFFFFU;
+    timer_initpara.clockdivision     = TIMER_CKDIV_DIV1;
+    timer_init(TIMEBASE_TIMER, &timer_initpara);
+
+    /* load the prescaler now instead of at the first overflow */
+    timer_event_software_generate(TIMEBASE_TIMER, TIMER_EVENT_SRC_UPG);
+    timer_interrupt_flag_clear(TIMEBASE_TIMER, TIMER_INT_FLAG_UP | TIMER_INT_FLAG_CH0);
+
+    /* channel 0 stays in compare timing mode, only its match flag is used */
+    timer_channel_output_mode_config(TIMEBASE_TIMER, TIMER_CH_0, TIMER_OC_MODE_TIMING);
+
+    timebase_overflows = 0U;
+    timebase_stats_reset();
+
+    timer_interrupt_enable(TIMEBASE_TIMER, TIMER_INT_UP);
+    nvic_irq_enable(TIMEBASE_TIMER_IRQn, TIMEBASE_IRQ_PRIORITY, 0U);
+
+    timer_enable(TIMEBASE_TIMER);
+}
+
+/*!
+    \brief    stop SysTick, the timebase replaces its tick
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_systick_disable(void)
+{
+    SysTick->CTRL &= ~(SysTick_CTRL_ENABLE_Msk | SysTick_CTRL_TICKINT_Msk);
+    NVIC_ClearPendingIRQ(SysTick_IRQn);
+}
+
+/*!
+    \brief    read the 64 bit microsecond counter
+    \param[in]  none
+    \param[out] none
+    \retval     microseconds since timebase_config()
+*/
+uint64_t timebase_now_us64(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t high;
+    uint32_t low;
+
+    __disable_irq();
+    high = timebase_overflows;
+    low = TIMER_CNT(TIMEBASE_TIMER);
+    /* an overflow that is not serviced yet belongs to a counter value that already wrapped */
+    if((TIMER_INTF(TIMEBASE_TIMER) & TIMER_INTF_UPIF) && (low < 0x80000000U)) {
+        high++;
+    }
+    __set_PRIMASK(primask);
+
+    return ((uint64_t)high << 32) | low;
+}
+
+/*!
+    \brief    read the monotonic millisecond time
+    \param[in]  none
+    \param[out] none
+    \retval     milliseconds since timebase_config(), truncated to 32 bit
+*/
+uint32_t timebase_now_ms(void)
+{
+    return (uint32_t)(timebase_now_us64() / 1000U);
+}
+
+/*!
+    \brief    arm the compare wakeup for an absolute deadline
+    \param[in]  deadline: absolute time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_wakeup_set(uint32_t deadline)
+{
+    TIMER_CH0CV(TIMEBASE_TIMER) = deadline;
+    TIMER_INTF(TIMEBASE_TIMER) = ~(uint32_t)TIMER_INTF_CH0IF;
+    TIMER_DMAINTEN(TIMEBASE_TIMER) |= TIMER_DMAINTEN_CH0IE;
+}
+
+/*!
+    \brief    sleep until the deadline or any other interrupt, whichever comes first
+    \param[in]  deadline: absolute time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_idle_until(uint32_t deadline)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    timebase_wakeup_set(deadline);
+
+    /* with interrupts masked a match between the check and WFI stays pending and wakes the core */
+    __disable_irq();
+    if(!timebase_deadline_reached(deadline)) {
+        __WFI();
+    }
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    sleep until an absolute deadline has passed
+    \param[in]  deadline: absolute time in microseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_sleep_until(uint32_t deadline)
+{
+    while(!timebase_deadline_reached(deadline)) {
+        timebase_idle_until(deadline);
+    }
+
+    timebase_stats_record(deadline);
+}
+
+/*!
+    \brief    sleep for a time in microseconds
+    \param[in]  count: count in microseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_delay_us(uint32_t count)
+{
+    uint32_t deadline = timebase_now_us();
+
+    while(count > TIMEBASE_MAX_SLEEP_US) {
+        deadline += TIMEBASE_MAX_SLEEP_US;
+        count -= TIMEBASE_MAX_SLEEP_US;
+        timebase_sleep_until(deadline);
+    }
+
+    timebase_sleep_until(deadline + count);
+}
+
+/*!
+    \brief    sleep for a time in milliseconds
+    \param[in]  count: count in milliseconds
+    \param[out] none
+    \retval     none
+*/
+void timebase_delay_ms(uint32_t count)
+{
+    uint32_t deadline = timebase_now_us();
+
+    while(0U != count) {
+        uint32_t chunk = (count > (TIMEBASE_MAX_SLEEP_US / 1000U)) ? (TIMEBASE_MAX_SLEEP_US / 1000U) : count;
+
+        deadline += chunk * 1000U;
+        count -= chunk;
+        timebase_sleep_until(deadline);
+    }
+}
+
+/*!
+    \brief    record the wake latency of a sleep that ended at its deadline
+    \param[in]  deadline: absolute time in microseconds the sleep waited for
+    \param[out] none
+    \retval     none
+*/
+void timebase_stats_record(uint32_t deadline)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t latency;
+
+    __disable_irq();
+    latency = timebase_now_us() - deadline;
+    if((0U == timebase_stats.wakeups) || (latency < timebase_stats.latency_min)) {
+        timebase_stats.latency_min = latency;
+    }
+    if(latency > timebase_stats.latency_max) {
+        timebase_stats.latency_max = latency;
+    }
+    timebase_stats.latency_sum += latency;
+    timebase_stats.wakeups++;
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    read the wake latency statistics
+    \param[in]  none
+    \param[out] stats: copy of the statistics
+    \retval     none
+*/
+void timebase_stats_get(timebase_stats_struct *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = timebase_stats;
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    reset the wake latency statistics
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_stats_reset(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    timebase_stats.wakeups = 0U;
+    timebase_stats.latency_min = 0U;
+    timebase_stats.latency_max = 0U;
+    timebase_stats.latency_sum = 0U;
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief    timebase interrupt handler, call from TIMER1_IRQHandler (TIMER4_IRQHandler)
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void timebase_irq_handler(void)
+{
+    uint32_t flags = TIMER_INTF(TIMEBASE_TIMER) & TIMER_DMAINTEN(TIMEBASE_TIMER);
+
+    if(flags & TIMER_INTF_UPIF) {
+        TIMER_INTF(TIMEBASE_TIMER) = ~(uint32_t)TIMER_INTF_UPIF;
+        timebase_overflows++;
+    }
+
+    if(flags & TIMER_INTF_CH0IF) {
+        /* one-shot, the sleeping side re-arms for its next deadline */
+        TIMER_DMAINTEN(TIMEBASE_TIMER) &= ~(uint32_t)TIMER_DMAINTEN_CH0IE;
+        TIMER_INTF(TIMEBASE_TIMER) = ~(uint32_t)TIMER_INTF_CH0IF;
+    }
+}
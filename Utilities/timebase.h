@@ -0,0 +1,81 @@
+/*!
+    \file    timebase.h
+    \brief   tickless microsecond timebase on a free-running 32 bit timer
+*/
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "gd32f4xx.h"
+
+/* TIMER1 and TIMER4 are the only 32 bit timers, TIMER1 is used unless TIMEBASE_USE_TIMER4 is defined */
+#ifdef TIMEBASE_USE_TIMER4
+#define TIMEBASE_TIMER                  TIMER4
+#define TIMEBASE_TIMER_CLK              RCU_TIMER4
+#define TIMEBASE_TIMER_IRQn             TIMER4_IRQn
+#else
+#define TIMEBASE_TIMER                  TIMER1
+#define TIMEBASE_TIMER_CLK              RCU_TIMER1
+#define TIMEBASE_TIMER_IRQn             TIMER1_IRQn
+#endif /* TIMEBASE_USE_TIMER4 */
+
+/* pre-emption priority of the timebase interrupt */
+#ifndef TIMEBASE_IRQ_PRIORITY
+#define TIMEBASE_IRQ_PRIORITY           0U
+#endif /* TIMEBASE_IRQ_PRIORITY */
+
+/* counter frequency, one count per microsecond */
+#define TIMEBASE_FREQUENCY              1000000U
+
+/* wake latency statistics of the timed sleeps, in microseconds past the deadline */
+typedef struct {
+    uint32_t wakeups;                                   /*!< number of completed sleeps */
+    uint32_t latency_min;                               /*!< smallest wake latency */
+    uint32_t latency_max;                               /*!< largest wake latency */
+    uint64_t latency_sum;                               /*!< sum of all wake latencies */
+} timebase_stats_struct;
+
+/* read the 32 bit microsecond counter, wraps after about 71.6 minutes */
+#define timebase_now_us()               (TIMER_CNT(TIMEBASE_TIMER))
+/* check whether an absolute deadline has passed, valid for deadlines up to 2^31 us ahead */
+#define timebase_deadline_reached(deadline)     ((int32_t)(timebase_now_us() - (uint32_t)(deadline)) >= 0)
+/* absolute deadline the given number of microseconds from now */
+#define timebase_deadline_us(us)        (timebase_now_us() + (uint32_t)(us))
+
+/* function declarations */
+/* start the free-running timebase timer */
+void timebase_config(void);
+/* stop SysTick, the timebase replaces its tick */
+void timebase_systick_disable(void);
+/* read the 64 bit microsecond counter */
+uint64_t timebase_now_us64(void);
+/* read the monotonic millisecond time */
+uint32_t timebase_now_ms(void);
+/* arm the compare wakeup for an absolute deadline */
+void timebase_wakeup_set(uint32_t deadline);
+/* sleep until the deadline or any other interrupt, whichever comes first */
+void timebase_idle_until(uint32_t deadline);
+/* sleep until an absolute deadline has passed */
+void timebase_sleep_until(uint32_t deadline);
+/* sleep for a time in microseconds */
+void timebase_delay_us(uint32_t count);
+/* sleep for a time in milliseconds */
+void timebase_delay_ms(uint32_t count);
+/* record the wake latency of a sleep that ended at its deadline */
+void timebase_stats_record(uint32_t deadline);
+/* read the wake latency statistics */
+void timebase_stats_get(timebase_stats_struct *stats);
+/* reset the wake latency statistics */
+void timebase_stats_reset(void);
+/* timebase interrupt handler, call from TIMER1_IRQHandler (TIMER4_IRQHandler) */
+void timebase_irq_handler(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEBASE_H */